@@ -8,6 +8,10 @@ function Scripting:loadScript(name, options)
 	self:_loadScript(name, options or ScriptLoadOptions.Default)
 end
 
+function Scripting:loadPooledScript(name, options)
+	self:_loadPooledScript(name, options or ScriptLoadOptions.Default)
+end
+
 function debugBreak(message)
 	Scripting:_debugBreak(message or "[LUA DEBUG BREAK]")
 end
@@ -31,6 +31,19 @@ engine won't load them correctly.
 
 	go:initialize()
 
+Nearby GameObjects are found through the GameObjectManager without
+iterating all of them. An object is treated as a point unless it gets
+bounds (half the size of its box). The queries return the number of
+found objects, which are then retrieved one by one, starting at 1:
+
+	go:setBounds(Vec3(5.0, 5.0, 5.0))
+	local count = GameObjectManager:findInRadius(position, 50.0)
+	local count = GameObjectManager:findInBox(Vec3(-10, -10, -10), Vec3(10, 10, 10))
+	local count = GameObjectManager:findNearest(position, 3)
+	for i = 1, count do
+		local other = GameObjectManager:getFoundObject(i)
+	end
+
 	
 ### Components
 
@@ -3,6 +3,20 @@ settings = {
 	video = {
 		screenResolution = Vec2i(1280, 720),
 		vsyncEnabled = true,
+		headless = false,
+		headlessFrames = 0,
+		textureBudget = 256,
+	},
+	resources = {
+		numLoaderThreads = 4,
+		archive = "",
+		looseFilesFirst = true,
+	},
+	physics = {
+		useNativeBackend = false,
+	},
+	scripting = {
+		numPooledStates = 0,
 	},
 }
 
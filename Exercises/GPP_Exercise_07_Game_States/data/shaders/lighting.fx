@@ -16,16 +16,21 @@ cbuffer cbChangeOnResize
     matrix Projection;
 };
 
-cbuffer cbChangesEveryFrame
+// has to match Model::MAX_INSTANCES
+#define MAX_INSTANCES 64
+
+cbuffer cbInstances
 {
-    matrix Model;
+    // the model matrices of all instances drawn by one draw call
+    matrix Instances[MAX_INSTANCES];
 };
 
 struct VS_INPUT
 {
     float3 Pos : POSITION;
-	float3 Normal : NORMAL;
+	float2 Normal : NORMAL; // octahedral encoded
 	float2 Tex : TEXCOORD;
+	uint InstanceId : SV_InstanceID;
 };
 
 struct PS_INPUT
@@ -36,17 +41,30 @@ struct PS_INPUT
 };
 
 
+//--------------------------------------------------------------------------------------
+// Has to match MeshCooker::decodeOctahedral
+//--------------------------------------------------------------------------------------
+float3 decodeOctahedral( float2 encoded )
+{
+	float3 n = float3(encoded.xy, 1.0f - abs(encoded.x) - abs(encoded.y));
+	if(n.z < 0)
+		n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0 ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+
 //--------------------------------------------------------------------------------------
 // Vertex Shader
 //--------------------------------------------------------------------------------------
 PS_INPUT VS( VS_INPUT input )
 {
     PS_INPUT output = (PS_INPUT)0;
+    matrix Model = Instances[input.InstanceId];
     output.Pos = mul( float4(input.Pos, 1.0f), Model );
     output.Pos = mul( output.Pos, View );
     output.Pos = mul( output.Pos, Projection );
 	
-	output.Normal = mul( input.Normal, Model );
+	output.Normal = mul( decodeOctahedral(input.Normal), Model );
 	output.Tex = input.Tex;
     
     return output;
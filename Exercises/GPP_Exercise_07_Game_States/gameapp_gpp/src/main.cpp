@@ -5,9 +5,36 @@
 #include "gep/globalManager.h"
 #include "gep/interfaces/logging.h"
 #include "gep/interfaces/updateFramework.h"
+#include "gep/archive.h"
+
+namespace
+{
+    // offline packer, usage: gameapp_gpp --pack <archive>
+    int packDataDirectory(const char* archiveFilename)
+    {
+        try
+        {
+            gep::ArchiveWriter writer;
+            writer.addDirectory("data");
+            writer.write(archiveFilename);
+            std::cout << "packed " << writer.getNumFiles() << " files into '" << archiveFilename << "'" << std::endl;
+        }
+        catch(std::exception& ex)
+        {
+            std::cout << "packing failed: " << ex.what() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+}
 
 int main(int argc, const char* argv[])
 {
+    if(argc == 3 && strcmp(argv[1], "--pack") == 0)
+    {
+        return packDataDirectory(argv[2]);
+    }
+
     gpp::Game e;
     try {
         g_globalManager.initialize();
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "gep/gepmodule.h"
+#include <Windows.h>
+#include "gep/types.h"
+#include "gep/ArrayPtr.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief Maps a whole file read-only into the address space.
+    class GEP_API MemoryMappedFile
+    {
+    public:
+        MemoryMappedFile();
+        ~MemoryMappedFile();
+
+        Result open(const char* filename);
+        void close();
+
+        inline bool isOpen() const { return m_data.getPtr() != nullptr; }
+
+        /// \brief The mapped memory. Must not be written to.
+        inline ArrayPtr<uint8> getData() const { return m_data; }
+
+    private:
+        HANDLE m_fileHandle;
+        HANDLE m_mappingHandle;
+        ArrayPtr<uint8> m_data;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(MemoryMappedFile);
+    };
+
+    /// \brief On-disk layout of a packed archive
+    ///
+    /// [Header][file data, each blob aligned to Header::alignment]
+    /// [Entry * numEntries, sorted by pathHash][path names]
+    namespace archive
+    {
+        static const uint32 MAGIC = 0x4B415047; // "GPAK"
+        static const uint32 VERSION = 1;
+        static const uint32 DEFAULT_ALIGNMENT = 16;
+
+        struct Header
+        {
+            uint32 magic;
+            uint32 version;
+            uint32 alignment;
+            uint32 numEntries;
+            uint64 entriesOffset;
+            uint64 namesOffset;
+        };
+
+        struct Entry
+        {
+            uint32 pathHash;
+            uint32 nameOffset;
+            uint32 nameLength;
+            uint32 padding;
+            uint64 offset;
+            uint64 size;
+        };
+
+        /// \brief Archive paths are case insensitive and use '/' as separator. "data\Base\X.fx" -> "data/base/x.fx"
+        GEP_API std::string normalizePath(const char* path);
+    }
+
+    /// \brief A memory mapped archive created by ArchiveWriter.
+    ///
+    /// Lookups are a binary search over the hashed table of contents.
+    /// The returned data points directly into the mapped file, nothing is copied.
+    /// It stays valid until the archive is closed.
+    class GEP_API PackedArchive
+    {
+    public:
+        PackedArchive();
+        ~PackedArchive();
+
+        /// \remarks Throws a LoadingError if the file is not a valid archive
+        void open(const char* filename);
+        void close();
+
+        inline bool isOpen() const { return m_file.isOpen(); }
+        inline const std::string& getFilename() const { return m_filename; }
+        inline size_t getNumFiles() const { return m_entries.length(); }
+
+        bool contains(const char* path) const;
+        Result tryGetFile(const char* path, ArrayPtr<uint8>& data) const;
+
+    private:
+        std::string m_filename;
+        MemoryMappedFile m_file;
+        ArrayPtr<archive::Entry> m_entries;
+        const char* m_names;
+
+        const archive::Entry* find(const char* path) const;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(PackedArchive);
+    };
+
+    /// \brief Offline packer that writes a PackedArchive
+    class GEP_API ArchiveWriter
+    {
+    public:
+        explicit ArchiveWriter(uint32 alignment = archive::DEFAULT_ALIGNMENT);
+
+        /// \param archivePath the path under which the file can be opened from the archive
+        /// \param filename the file on disk to pack
+        void addFile(const char* archivePath, const char* filename);
+
+        /// \brief Adds all files in the directory and its subdirectories.
+        ///  Archive paths are relative to the working directory, e.g. "data/base/font.fx"
+        void addDirectory(const char* directory);
+
+        inline size_t getNumFiles() const { return m_files.length(); }
+
+        /// \remarks Throws a gep::Exception if a file can not be read or written
+        void write(const char* filename);
+
+    private:
+        struct FileInfo
+        {
+            std::string archivePath;
+            std::string filename;
+        };
+
+        uint32 m_alignment;
+        DynamicArray<FileInfo> m_files;
+    };
+
+    /// \brief The contents of a file opened through the VirtualFileSystem.
+    ///
+    /// Either a view into a mounted archive or a copy of a loose file that is freed with the view.
+    class GEP_API FileView
+    {
+        friend class VirtualFileSystem;
+    public:
+        FileView();
+        ~FileView();
+
+        inline ArrayPtr<uint8> getData() const { return m_data; }
+        inline size_t length() const { return m_data.length(); }
+        inline bool isFromArchive() const { return !m_isOwned; }
+
+        void release();
+
+    private:
+        ArrayPtr<uint8> m_data;
+        bool m_isOwned;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(FileView);
+    };
+
+    /// \brief Looks up files in the mounted archives and on disk.
+    ///
+    /// Archives must be mounted before any loading starts, opening files is thread safe afterwards.
+    /// With loose files first, files on disk shadow the archives, so modified files
+    /// can still be reloaded through the resource manager during development.
+    class GEP_API VirtualFileSystem
+    {
+    public:
+        VirtualFileSystem();
+        ~VirtualFileSystem();
+
+        /// \brief Archives mounted later take precedence.
+        /// \remarks Throws a LoadingError if the archive can not be opened
+        void mountArchive(const char* filename);
+        void unmountAll();
+
+        inline void setLooseFilesFirst(bool value) { m_looseFilesFirst = value; }
+        inline bool getLooseFilesFirst() const { return m_looseFilesFirst; }
+
+        bool exists(const char* path) const;
+
+        /// \brief Opens a file for reading.
+        /// \return FAILURE if the file does neither exist on disk nor in any archive
+        Result open(const char* path, FileView& view) const;
+
+    private:
+        DynamicArray<PackedArchive*> m_archives;
+        bool m_looseFilesFirst;
+
+        Result openFromArchives(const char* path, FileView& view) const;
+        Result openLooseFile(const char* path, FileView& view) const;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(VirtualFileSystem);
+    };
+}
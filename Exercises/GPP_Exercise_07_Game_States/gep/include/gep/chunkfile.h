@@ -3,10 +3,19 @@
 #include "gep/memory/allocator.h"
 #include "gep/file.h"
 #include "gep/container/DynamicArray.h"
+#include "gep/container/hashmap.h"
 #include "gep/traits.h"
+#include "gep/archive.h"
 
 namespace gep
 {
+    /// \brief Reads and writes files made of nested, named chunks.
+    ///
+    /// In read mode the whole file is memory mapped (or read with a single call if mapping fails),
+    /// so reading a value is a bounds check and a copy instead of a call into the C runtime.
+    /// Files written with Operation::write end with a chunk index after the top level chunk
+    /// which allows to jump directly to any chunk with seekToChunk. Readers that do not know
+    /// about the index never get past the top level chunk and ignore it.
     class GEP_API Chunkfile
     {
     public:
@@ -24,8 +33,11 @@ namespace gep
         RawFile m_file;
         std::string m_filename;
         uint32 m_version;
+        MemoryMappedFile m_mappedFile;
+        ArrayPtr<uint8> m_ownedData;
 
         static const uint32 MAX_CHUNK_NAME_LENGTH = 27;
+        static const uint32 CHUNK_INDEX_MAGIC = 0x58444943; // "CIDX"
 
         struct ChunkReadInfo
         {
@@ -40,16 +52,38 @@ namespace gep
         {
             size_t lengthPosition;
             size_t length;
+            uint32 indexEntry;
 
-            ChunkWriteInfo() : lengthPosition(0), length(0) {}
+            ChunkWriteInfo() : lengthPosition(0), length(0), indexEntry(0) {}
+        };
+
+        struct ChunkIndexEntry
+        {
+            char name[MAX_CHUNK_NAME_LENGTH];
+            uint8 nameLength;
+            int32 parent; /// index of the parent entry, -1 for the top level chunk
+            uint32 headerOffset; /// offset of the chunk name from the start of the file
+            uint32 length; /// length of the chunk data
+            int32 nextSamePath; /// next chunk with the same path, -1 if there is none
+
+            /// 64 bit, so that the sum of a corrupt index can not wrap around and pass the bounds checks
+            inline uint64 getDataEnd() const { return uint64(headerOffset) + 1 + nameLength + sizeof(uint32) + length; }
         };
 
         DynamicArray<ChunkReadInfo> m_readInfo;
         DynamicArray<ChunkWriteInfo> m_writeInfo;
+        DynamicArray<ChunkIndexEntry> m_index;
+        Hashmap<std::string, uint32, StringHashPolicy> m_indexLookup; /// path -> first entry with that path
+
+        void openForReading();
+        void readChunkIndex();
+        void writeChunkIndex();
 
     public:
         /// \brief creates or opens a chunkfile
         Chunkfile(const char* filename, Operation operation);
+        /// \brief reads a chunkfile from memory, e.g. a FileView. The data is not copied and has to stay valid.
+        Chunkfile(const char* filename, ArrayPtr<uint8> data);
         ~Chunkfile();
 
         inline Operation getOperation() const
@@ -65,21 +99,16 @@ namespace gep
             static_assert(isArrayPtr<T>::value == false, "for reading arrays use readArray");
             GEP_ASSERT(m_operation != Operation::write, "can not read in write operation");
             GEP_ASSERT(m_readInfo.length() == 0 || m_readInfo.lastElement().bytesLeft >= sizeof(T), "reading over chunk boundary");
-            size_t size = 0;
-            if(m_operation == Operation::read)
+            if(m_readLocation + sizeof(T) > m_oldData.getPtr() + m_oldData.length())
             {
-                size = m_file.read(val);
-            }
-            else
-            {
-                GEP_ASSERT(m_readLocation + sizeof(T) <= m_oldData.getPtr() + m_oldData.length(), "out of bounds");
-                val = *(T*)(m_readLocation);
-                size = sizeof(T);
-                m_readLocation += sizeof(T);
+                GEP_ASSERT(false, "out of bounds");
+                return 0;
             }
+            memcpy(&val, m_readLocation, sizeof(T));
+            m_readLocation += sizeof(T);
             if(m_readInfo.length() > 0)
-                m_readInfo.lastElement().bytesLeft -= (uint32)size;
-            return size;
+                m_readInfo.lastElement().bytesLeft -= sizeof(T);
+            return sizeof(T);
         }
 
         template <typename T>
@@ -87,26 +116,40 @@ namespace gep
         {
             GEP_ASSERT(m_operation != Operation::write, "can not read in write operation");
             GEP_ASSERT(m_readInfo.length() == 0 || m_readInfo.lastElement().bytesLeft >= sizeof(T) * val.length(), "reading over chunk boundary");
-
-            size_t size;
-            if(m_operation == Operation::read)
+            size_t size = sizeof(T) * val.length();
+            if(m_readLocation + size > m_oldData.getPtr() + m_oldData.length())
             {
-                size = m_file.readArray(val.getPtr(), val.length());
+                GEP_ASSERT(false, "out of bounds");
+                return 0;
             }
-            else
+            memcpy(val.getPtr(), m_readLocation, size);
+            m_readLocation += size;
+            if(m_readInfo.length() > 0)
+                m_readInfo.lastElement().bytesLeft -= (uint32)size;
+            return size;
+        }
+
+        /// \brief Reads a array without copying it
+        ///
+        /// \return the array inside the file data or an empty array on error.
+        ///   It stays valid as long as the chunkfile exists and must not be written to.
+        ///   The data is not aligned to anything.
+        template <typename T>
+        ArrayPtr<T> readArrayView(size_t length)
+        {
+            GEP_ASSERT(m_operation != Operation::write, "can not read in write operation");
+            GEP_ASSERT(m_readInfo.length() == 0 || m_readInfo.lastElement().bytesLeft >= sizeof(T) * length, "reading over chunk boundary");
+            size_t size = sizeof(T) * length;
+            if(m_readLocation + size > m_oldData.getPtr() + m_oldData.length())
             {
-                if(m_readLocation + sizeof(T) * val.length() <= m_oldData.getPtr() + m_oldData.length())
-                {
-                    GEP_ASSERT(false, "out of bounds");
-                    return 0;
-                }
-                val.copyFrom(ArrayPtr<T>((T*)m_readLocation, val.length()));
-                size = sizeof(T) * val.length();
-                m_readLocation += size;
+                GEP_ASSERT(false, "out of bounds");
+                return ArrayPtr<T>();
             }
+            ArrayPtr<T> view((T*)m_readLocation, length);
+            m_readLocation += size;
             if(m_readInfo.length() > 0)
                 m_readInfo.lastElement().bytesLeft -= (uint32)size;
-            return size;
+            return view;
         }
 
         /// \brief Allocates and reads a array of a given type from the chunk file
@@ -185,6 +228,26 @@ namespace gep
 
         void endReadChunk();
 
+        /// \brief true if the file ends with a chunk index and seekToChunk can be used
+        inline bool hasChunkIndex() const
+        {
+            return m_index.length() > 0;
+        }
+
+        /// \brief Positions the reader in front of a chunk as if it had been reached by reading sequentially.
+        ///
+        /// All chunks the chunk is nested in are opened, the next startReadChunk opens the chunk itself.
+        /// Afterwards the parent chunks can be left with skipCurrentChunk.
+        /// \param path
+        ///   names of the nested chunks separated by '/', starting with the file type, e.g. "thModel/nodes"
+        /// \param occurrence
+        ///   which of the chunks with this path to use if there is more than one
+        /// \return FAILURE if the file has no chunk index or there is no such chunk
+        Result seekToChunk(const char* path, uint32 occurrence = 0);
+
+        /// \brief number of chunks with the given path, 0 if there is no chunk index
+        uint32 getNumChunks(const char* path);
+
         void startWriteChunk(const char* name);
         size_t endWriteChunk();
 
@@ -200,6 +263,7 @@ namespace gep
 
         void startWriting(const char* filetype, uint32 ver);
 
+        /// \brief ends the top level chunk and, in write operation, appends the chunk index
         void endWriting();
 
         Result startReading(const char* filetype);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "gep/math3d/mat4.h"
+#include "gep/math3d/frustum.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief Bounding volume hierarchy over a tree of nodes, e.g. the nodes of a model, for view frustum culling.
+    ///
+    /// The nodes are stored flat in depth first order, each one with its own bounds and the bounds
+    /// of its whole subtree, all in the space of the root node. Culling skips a subtree as soon as its
+    /// bounds are outside of the frustum and accepts it without further tests if they are inside.
+    /// Only depends on the math types, so it can be used and tested without a renderer.
+    class GEP_API CullingHierarchy
+    {
+    public:
+        static const uint32 NO_PARENT = 0xFFFFFFFF;
+
+        struct Result
+        {
+            uint32 numVisible; /// number of nodes with bounds that were written to the visible nodes
+            uint32 numCulled; /// number of nodes with bounds that are outside of the frustum
+        };
+
+        CullingHierarchy();
+
+        /// \brief removes all nodes
+        void clear();
+
+        /// \brief adds a node
+        ///
+        /// The nodes have to be added in depth first order, i.e. the children of a node (and their children)
+        /// directly after the node itself.
+        /// \param parent
+        ///   index of the parent node or NO_PARENT for the root
+        /// \param transform
+        ///   transformation of the node relative to its parent
+        /// \return the index of the new node
+        uint32 addNode(uint32 parent, const mat4& transform);
+
+        /// \brief grows the bounds of a node by a box given in the space of the node
+        void addBounds(uint32 node, const vec3& min, const vec3& max);
+
+        /// \brief computes the bounds of the subtrees, has to be called after all nodes and bounds were added
+        void finish();
+
+        /// \brief culls the hierarchy against a frustum
+        /// \param frustum
+        ///   the frustum in the space of the root node, see Frustum::toLocalSpace
+        /// \param visibleNodes
+        ///   receives the indices of all visible nodes with bounds, in depth first order.
+        ///   Has to be at least getNumNodesWithBounds() long.
+        Result cull(const Frustum& frustum, ArrayPtr<uint32> visibleNodes) const;
+
+        inline size_t getNumNodes() const { return m_nodes.length(); }
+
+        /// \brief number of nodes that have bounds, nodes without bounds are never reported as visible
+        inline uint32 getNumNodesWithBounds() const { return m_nodes.length() > 0 ? m_nodes[0].numWithBoundsInSubtree : 0; }
+
+        /// \brief transformation of a node relative to the root node
+        inline const mat4& getTransform(uint32 node) const { return m_transforms[node]; }
+
+        inline bool hasBounds(uint32 node) const { return m_nodes[node].hasBounds; }
+
+        /// \brief bounds of a node in the space of the root node
+        void getBounds(uint32 node, vec3& min, vec3& max) const;
+
+    private:
+        struct Node
+        {
+            uint32 parent;
+            uint32 subtreeEnd; /// index behind the last node of the subtree
+            uint32 numWithBoundsInSubtree;
+            bool hasBounds;
+            vec3 min, max;
+            vec3 subtreeMin, subtreeMax;
+        };
+
+        DynamicArray<Node> m_nodes;
+        DynamicArray<mat4> m_transforms;
+        bool m_isFinished;
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "gep/types.h"
+#include "gep/ArrayPtr.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief a list of draws sorted by a 64 bit key to minimize the state changes between them
+    ///
+    /// The key is built from the state a draw needs, the most expensive state change in the highest bits:
+    ///
+    /// | shader (8) | texture set (12) | material (12) | mesh (16) | depth (16) |
+    ///
+    /// Sorting by the key groups the draws by shader, then by textures and so on. Inside of a group of
+    /// draws with the same state they are ordered front to back. The ids are cut to the width of their field,
+    /// so two different draws may end up in the same batch if there are too many ids. Whoever draws a batch
+    /// has to check if the draws can actually be merged.
+    /// Only depends on the basic types, so it can be used and tested without a renderer.
+    class GEP_API DrawList
+    {
+    public:
+        static const uint32 SHADER_BITS = 8;
+        static const uint32 TEXTURE_SET_BITS = 12;
+        static const uint32 MATERIAL_BITS = 12;
+        static const uint32 MESH_BITS = 16;
+        static const uint32 DEPTH_BITS = 16;
+
+        struct Entry
+        {
+            uint64 key;
+            uint32 index; /// index of the draw in the callers data
+        };
+
+        /// \brief builds a sort key, ids which do not fit into their field are wrapped
+        /// \param depth
+        ///   distance to the camera, negative values are treated as 0
+        static uint64 makeKey(uint32 shader, uint32 textureSet, uint32 material, uint32 mesh, float depth);
+
+        /// \brief maps a depth to 16 bits, keeping the order of all positive depths
+        static uint32 quantizeDepth(float depth);
+
+        /// \brief the part of the key which has to be equal for two draws to be in the same batch
+        inline static uint64 getBatchKey(uint64 key) { return key >> DEPTH_BITS; }
+
+        /// \brief removes all entries but keeps the memory
+        void clear();
+
+        inline void add(uint64 key, uint32 index)
+        {
+            Entry entry;
+            entry.key = key;
+            entry.index = index;
+            m_entries.append(entry);
+        }
+
+        /// \brief sorts the entries by their key
+        ///
+        /// A stable LSD radix sort over the 8 bytes of the key. Bytes which are the same in all keys,
+        /// e.g. the upper shader bits, are skipped.
+        void sort();
+
+        /// \brief number of entries starting at start which belong to the same batch, at most maxLength
+        size_t getBatchLength(size_t start, size_t maxLength) const;
+
+        inline size_t length() const { return m_entries.length(); }
+        inline ArrayPtr<Entry> getEntries() { return m_entries.toArray(); }
+        inline const Entry& operator[](size_t index) const { return m_entries[index]; }
+
+    private:
+        DynamicArray<Entry> m_entries;
+        DynamicArray<Entry> m_sortBuffer;
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "gep/types.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/container/hashmap.h"
+
+namespace gep
+{
+    /// \brief places rectangles of different sizes, e.g. the glyphs of a font, in a texture
+    ///
+    /// Shelf packing: the texture is split into horizontal shelves, a rectangle goes right next to the last one
+    /// in the shelf whose height fits it best. When there is no room left, the shelf which was used the longest time ago
+    /// is emptied and reused. Shelves which were used in the current frame are never emptied, so all regions handed out
+    /// during a frame stay valid until its end.
+    /// Only manages the space, copying the pixels is up to the caller. Does not depend on the renderer so it can be tested without one.
+    class GEP_API GlyphAtlas
+    {
+    public:
+        /// at most this many shelves, so that a set of shelves fits into a 64 bit mask
+        static const uint32 MAX_SHELVES = 64;
+        /// free pixels right of and below every rectangle, so that filtering does not bleed into the neighbours
+        static const uint32 PADDING = 1;
+
+        struct Region
+        {
+            uint16 x, y;
+            uint16 width, height;
+            uint32 shelf;
+        };
+
+        GlyphAtlas(uint32 width, uint32 height);
+
+        /// \brief looks up a rectangle and marks its shelf as used in this frame
+        bool find(uint32 key, Region& region);
+
+        /// \brief reserves space for a rectangle which is not in the atlas yet
+        ///
+        /// The space may have been used by evicted rectangles before, the caller has to overwrite all of it.
+        /// \return false if the rectangle does not fit because the atlas is full with rectangles used in this frame
+        bool insert(uint32 key, uint32 width, uint32 height, Region& region);
+
+        /// \brief marks shelves as used in this frame, e.g. all the shelves of a cached text layout
+        void markShelvesUsed(uint64 shelfMask);
+
+        inline void markShelfUsed(uint32 shelf)
+        {
+            GEP_ASSERT(shelf < m_shelves.length(), "invalid shelf", shelf);
+            m_shelves[shelf].lastUsedFrame = m_frame;
+        }
+
+        /// \brief starts a new frame, the shelves which are not used again from now on may be evicted
+        inline void nextFrame() { m_frame++; }
+
+        /// \brief removes all rectangles
+        void clear();
+
+        /// \brief changes whenever rectangles are evicted, so that regions handed out before can be checked
+        inline uint32 getGeneration() const { return m_generation; }
+
+        inline size_t getNumEntries() const { return m_entries.count(); }
+        inline uint32 getNumEvictions() const { return m_numEvictions; }
+        inline uint32 getWidth() const { return m_width; }
+        inline uint32 getHeight() const { return m_height; }
+
+    private:
+        struct Shelf
+        {
+            uint32 y, height;
+            uint32 usedWidth;
+            uint32 lastUsedFrame;
+        };
+
+        uint32 m_width, m_height;
+        uint32 m_usedHeight;
+        uint32 m_frame;
+        uint32 m_generation;
+        uint32 m_numEvictions;
+        DynamicArray<Shelf> m_shelves;
+        Hashmap<uint32, Region, DontHashPolicy> m_entries;
+
+        void evict(uint32 shelf);
+        void place(uint32 key, uint32 shelf, uint32 width, uint32 height, Region& region);
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "gep/types.h"
+#include "gep/ArrayPtr.h"
+
+namespace gep
+{
+    // forward declarations
+    class IAllocator;
+    class TaskQueue;
+
+    /// \brief mipmap generation and block compression of images on the cpu
+    ///
+    /// Images are tightly packed rows of 8 bit pixels, RGBA8 unless noted otherwise.
+    /// The kernels only touch the rows they are given, so an image can be split into bands which are
+    /// processed in parallel. If GEP_MATH_SIMD is set, the 2x2 box filter and the bounding boxes of the blocks use SSE2,
+    /// the results are exactly the same as with the scalar code.
+    /// Does not depend on the renderer so it can be tested without one.
+    namespace image
+    {
+        enum class BlockCompression
+        {
+            None,
+            BC1, ///< DXT1, 8 bytes per 4x4 block of RGB, alpha is ignored
+            BC3, ///< DXT5, 16 bytes per 4x4 block of RGBA, BC1 colors with a BC4 alpha block
+            BC4  ///< 8 bytes per 4x4 block of a single channel, the source has one byte per pixel
+        };
+
+        /// \brief number of mipmaps down to 1x1
+        GEP_API uint32 getNumMipmaps(uint32 width, uint32 height);
+
+        /// \brief size in pixels of the given mipmap of an image side
+        inline uint32 getMipmapSize(uint32 size, uint32 mipmap)
+        {
+            return GEP_MAX(size >> mipmap, 1);
+        }
+
+        /// \brief size in bytes of one mipmap, compressed images consist of whole blocks
+        GEP_API size_t getMipmapBytes(uint32 width, uint32 height, BlockCompression compression);
+
+        /// \brief computes the rows [startRow, endRow) of the next smaller mipmap with a 2x2 box filter
+        ///
+        /// The destination is max(width / 2, 1) x max(height / 2, 1) pixels. If a side is odd, its last
+        /// source row or column is ignored, if it is 1 the pixels are only averaged along the other side.
+        GEP_API void downsampleRGBA8(const uint8* src, uint32 width, uint32 height, uint8* dst, uint32 startRow, uint32 endRow);
+
+        /// \brief compresses the block rows [startBlockRow, endBlockRow) of an image
+        ///
+        /// Endpoints are the bounding box of the block inset a little, the indices come from projecting the
+        /// pixels on the line between them. Fast instead of optimal, meant for textures created at runtime.
+        /// Blocks sticking out of the image repeat its last row and column.
+        /// \param dst
+        ///   receives the whole blocks, (width + 3) / 4 blocks per row
+        GEP_API void compressBlocks(BlockCompression compression, const uint8* src, uint32 width, uint32 height, uint8* dst,
+                                    uint32 startBlockRow, uint32 endBlockRow);
+
+        /// \brief creates all mipmaps of an RGBA8 image and compresses them
+        ///
+        /// The mipmaps are allocated with pAllocator, they and the returned array have to be freed with it,
+        /// e.g. by handing them over to ImageData2D::setData. The smaller mipmaps are computed from the
+        /// uncompressed larger ones, so compression errors do not add up.
+        /// \param pTaskQueue
+        ///   runs the bands of the larger mipmaps in parallel if it is not null
+        GEP_API ArrayPtr<ArrayPtr<uint8>> createMipmaps(IAllocator* pAllocator, ArrayPtr<uint8> rgba, uint32 width, uint32 height,
+                                                       BlockCompression compression, TaskQueue* pTaskQueue = nullptr);
+    }
+}
@@ -35,6 +35,9 @@ namespace gep
         virtual void registerSink(ILogSink* pSink) = 0;
         virtual void deregisterSink(ILogSink* pSink) = 0;
 
+        /// \brief returns after every message logged before was passed to the sinks
+        virtual void flush() = 0;
+
         LUA_BIND_REFERENCE_TYPE_BEGIN
             LUA_BIND_FUNCTION_NAMED(logMessageUnformatted, "message")
             LUA_BIND_FUNCTION_NAMED(logWarningUnformatted, "warning")
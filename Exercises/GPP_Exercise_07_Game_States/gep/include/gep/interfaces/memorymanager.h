@@ -1,19 +1,78 @@
 #pragma once
 
 #include "gep/interfaces/subsystem.h"
+#include "gep/ArrayPtr.h"
+#include <string>
 
 namespace gep
 {
     //forward declarations
     class IAllocatorStatistics;
 
+    /// \brief the subsystems whose memory is budgeted separately
+    enum class MemoryCategory
+    {
+        Scripting,
+        Resources,
+        Extraction,
+        Physics,
+        Events,
+        GameObjects,
+        Count
+    };
+
+    inline const char* getName(MemoryCategory category)
+    {
+        static const char* const names[] = { "Scripting", "Resources", "Extraction", "Physics", "Events", "Game objects" };
+        static_assert(GEP_ARRAY_SIZE(names) == size_t(MemoryCategory::Count), "a memory category has no name");
+        return names[size_t(category)];
+    }
+
+    struct MemoryCategoryStatistics
+    {
+        size_t bytesUsed; ///< at the end of the last frame
+        size_t highWaterMark; ///< the most bytes which were in use at the same time
+        size_t budget; ///< 0 if the category has no budget
+        int64 lastFrameDelta; ///< change of bytesUsed during the last frame
+        bool isOverBudget; ///< bytesUsed is above the budget
+    };
+
     class IMemoryManager : public ISubsystem
     {
     public:
+        /// \brief number of frames the per frame deltas of the memory categories are kept for
+        static const size_t NUM_TRACKED_FRAMES = 120;
+
         /// \brief registers a new allocator with the memory manager
         virtual void registerAllocator(const char* name, IAllocatorStatistics* pAllocator) = 0;
 
         /// \brief deregisters a allocator with the memory manager
         virtual void deregisterAllocator(IAllocatorStatistics* pAllocator) = 0;
+
+        /// \brief Starts sampling the allocations of the standard allocator, discarding the previous profile.
+        /// It costs nothing while it is stopped and is cheap enough for release builds while it runs.
+        /// \param sampleRate Average number of bytes allocated between two samples.
+        virtual void startAllocationProfiling(size_t sampleRate = 512 * 1024) = 0;
+        virtual void stopAllocationProfiling() = 0;
+        virtual bool isAllocationProfilingEnabled() const = 0;
+
+        /// \brief Writes the estimated live and allocated bytes per callstack in the collapsed stack format of flamegraph.pl.
+        /// Can be called while profiling is running.
+        /// \throws Exception if a file could not be opened or profiling was never started.
+        virtual void exportAllocationProfile(const std::string& liveBytesFileName, const std::string& allocatedBytesFileName) = 0;
+
+        /// \brief allocator which attributes its allocations to the given category, the memory comes from the standard allocator
+        /// It can be used from any thread and lives as long as the memory manager.
+        virtual IAllocatorStatistics* getAllocator(MemoryCategory category) = 0;
+
+        /// \brief a warning is logged whenever the category goes over its budget, 0 removes the budget
+        virtual void setBudget(MemoryCategory category, size_t budget) = 0;
+
+        /// \brief the statistics as of the last update
+        virtual MemoryCategoryStatistics getStatistics(MemoryCategory category) const = 0;
+
+        /// \brief copies the changes of the bytes used of the last frames, oldest first
+        /// \return the number of frames copied, at most NUM_TRACKED_FRAMES
+        virtual size_t getFrameDeltas(MemoryCategory category, ArrayPtr<int64> deltas) const = 0;
     };
 }
@@ -155,9 +155,13 @@ namespace gep
     {
     public:
         typedef std::function<void(const IRigidBody*)> PositionChangedCallback;
+        static const uint32 INVALID_WORLD_INDEX = 0xFFFFFFFF;
 
         virtual ~IRigidBody(){}
 
+        /// \brief index into IWorld::getTransforms, INVALID_WORLD_INDEX while the body is not simulated
+        virtual uint32 getWorldIndex() const = 0;
+
         virtual uint32 getCollisionFilterInfo() const = 0;
         virtual void setCollisionFilterInfo(uint32 value) = 0;
 
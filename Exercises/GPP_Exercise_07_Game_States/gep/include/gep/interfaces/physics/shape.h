@@ -1,6 +1,7 @@
 #pragma once
 #include "gep/math3d/vec3.h"
 #include "gep/ReferenceCounting.h"
+#include "gep/container/DynamicArray.h"
 
 namespace gep
 {
@@ -66,4 +67,19 @@ namespace gep
             LUA_BIND_FUNCTION(setRadius)
         LUA_BIND_REFERENCE_TYPE_END
     };
+
+    /// \brief The convex hull of a point cloud, the points don't have to be on the hull.
+    class ConvexVerticesShape : public IShape
+    {
+        DynamicArray<vec3> m_vertices;
+    public:
+        ConvexVerticesShape(const ArrayPtr<vec3>& vertices) : m_vertices(vertices) {}
+
+        inline virtual ShapeType::Enum getShapeType() const override { return ShapeType::ConvexVertices; }
+
+        inline ArrayPtr<vec3> getVertices() const { return m_vertices.toArray(); }
+
+        LUA_BIND_REFERENCE_TYPE_BEGIN
+        LUA_BIND_REFERENCE_TYPE_END
+    };
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gep/math3d/vec3.h"
+#include "gep/math3d/quaternion.h"
+#include "gep/ArrayPtr.h"
+
+namespace gep
+{
+    class IShape;
+    class ICollidable;
+
+    /// \brief Sweeps a shape without rotating it from \a from to \a to.
+    ///
+    /// The result is a RayCastOutput, the hit fraction is where along the sweep the shape first touches.
+    /// Shapes which already overlap something at \a from hit it with a fraction of 0.
+    struct ShapeCastInput
+    {
+        /// not owned, has to stay alive during the query
+        IShape* shape;
+        Quaternion rotation;
+        vec3 from;
+        vec3 to;
+
+        ShapeCastInput() :
+            shape(nullptr),
+            rotation(),
+            from(0.0f),
+            to(0.0f)
+        {
+        }
+    };
+
+    /// \brief Finds everything a shape placed at \a position overlaps.
+    struct OverlapInput
+    {
+        /// not owned, has to stay alive during the query
+        IShape* shape;
+        Quaternion rotation;
+        vec3 position;
+
+        OverlapInput() :
+            shape(nullptr),
+            rotation(),
+            position(0.0f)
+        {
+        }
+    };
+
+    struct OverlapOutput
+    {
+        /// provided by the caller, filled with the first hits
+        ArrayPtr<const ICollidable*> hits;
+        /// the number of overlapped collidables, can be larger than hits.length()
+        size_t numHits;
+
+        OverlapOutput() :
+            hits(),
+            numHits(0)
+        {
+        }
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gep/interfaces/physics/rayCast.h"
+#include "gep/interfaces/physics/shapeCast.h"
 
 #include "gep/interfaces/events.h"
 #include "gep/interfaces/scripting.h"
@@ -30,6 +31,13 @@ namespace gep
         LUA_BIND_VALUE_TYPE_END
     };
 
+    /// \brief Position and rotation of a simulated rigid body.
+    struct RigidBodyTransform
+    {
+        vec3 position;
+        Quaternion rotation;
+    };
+
     class IWorld : public ReferenceCounted
     {
     public:
@@ -53,14 +61,40 @@ namespace gep
         /// The ownership of the character rigid body is transfered to the caller.
         virtual void removeCharacter(ICharacterRigidBody* character) = 0;
 
+        /// \brief The transforms of all rigid bodies in this world, indexed by IRigidBody::getWorldIndex.
+        ///
+        /// They are written in one go after every step and when a body is moved by hand.
+        /// Adding or removing entities moves the transforms of other bodies around.
+        virtual ArrayPtr<const RigidBodyTransform> getTransforms() const = 0;
+
         /// \brief Register a contact listener for all collision events
         virtual Event<ContactPointArgs*>* getContactPointEvent() = 0;
 
         /// \brief Casts a ray defined in \a input into this world. The output is represented by the \a output argument.
         virtual void castRay(const RayCastInput& input, RayCastOutput& output) const = 0;
 
+        /// \brief Casts a batch of rays, outputs[i] is the closest hit of inputs[i].
+        ///
+        /// The queries don't change the world, so a large batch can be split into slices which are cast
+        /// on several workers at once, as long as the world isn't stepped or changed meanwhile.
+        virtual void castRays(ArrayPtr<const RayCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const = 0;
+
+        /// \brief Sweeps a batch of shapes, outputs[i] is the first hit of inputs[i].
+        virtual void castShapes(ArrayPtr<const ShapeCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const = 0;
+
+        /// \brief Finds the overlaps of a batch of shapes, outputs[i] gets the collidables overlapping inputs[i].
+        virtual void overlapShapes(ArrayPtr<const OverlapInput> inputs, ArrayPtr<OverlapOutput> outputs) const = 0;
+
+        /// \brief castRays for scripts.
+        ///
+        /// \a rays is a flat array of numbers, six per ray: from.x, from.y, from.z, to.x, to.y, to.z.
+        /// The hit fraction of every ray is written to \a hitFractions, 1 if the ray hit nothing.
+        /// \return the number of rays which hit something
+        uint32 castRaysFromScript(ScriptTableWrapper rays, ScriptTableWrapper hitFractions) const;
+
         LUA_BIND_REFERENCE_TYPE_BEGIN
             //LUA_BIND_FUNCTION(castRay)
+            LUA_BIND_FUNCTION_NAMED(castRaysFromScript, "castRays")
             LUA_BIND_FUNCTION(getContactPointEvent)
         LUA_BIND_REFERENCE_TYPE_END
     };
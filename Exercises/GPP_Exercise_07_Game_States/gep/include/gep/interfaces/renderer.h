@@ -83,6 +83,9 @@ namespace gep
         virtual ResourcePtr<IModel> loadModel(const char* path) = 0;
         virtual ResourcePtr<IModel> loadModel(ReferenceCounted* pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices) = 0;
         /// \brief creates a new texture generator
+        ///
+        /// The generator fills width * height RGBA8 pixels. The texture gets all mipmaps and is BC3 compressed
+        /// if both sides are a multiple of 4, so it can not be changed afterwards.
         virtual ResourcePtr<IResource> createGeneratedTexture(uint32 width, uint32 height, const char* resourceId, std::function<void(ArrayPtr<uint8>)> generatorFunction) = 0;
 
         virtual uint32 getScreenWidth() const = 0;
@@ -111,12 +114,26 @@ namespace gep
     };
 
 
+    /// \brief how many model nodes the view frustum culling submitted and removed during one extraction
+    struct CullingStats
+    {
+        uint32 numSubmitted;
+        uint32 numCulled;
+    };
+
     /// \brief Renderer extractor interface
     class IRendererExtractor
     {
     public:
         virtual ~IRendererExtractor(){}
         virtual CallbackId registerExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback) = 0;
+
+        /// \brief registers a callback which may run on a worker thread at the same time as other parallel callbacks
+        ///
+        /// Parallel callbacks keep their place among the other callbacks, they see the camera the callbacks registered before them set
+        /// and their commands end up between those of the neighbouring callbacks. They may not set a camera themselves.
+        /// They should only extract their own objects, e.g. a single model.
+        virtual CallbackId registerParallelExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback) = 0;
         virtual void deregisterExtractionCallback(CallbackId callbackId) = 0;
 
         /// \brief runs the extraction
@@ -133,6 +150,13 @@ namespace gep
         virtual void endDebugMarker() = 0;
 
         virtual IAllocator* getCurrentAllocator() = 0;
+
+        /// \brief enables or disables the view frustum culling of models
+        virtual void setCullingEnabled(bool enabled) = 0;
+        virtual bool getCullingEnabled() = 0;
+
+        /// \brief the culling statistics of the last finished extraction
+        virtual CullingStats getCullingStats() = 0;
     };
 
 
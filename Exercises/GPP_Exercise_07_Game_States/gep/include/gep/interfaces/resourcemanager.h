@@ -8,6 +8,7 @@ namespace gep
     //forward reference
     class IResource;
     class IResourceLoader;
+    class VirtualFileSystem;
     template <class T>
     struct ResourcePtr;
 
@@ -28,6 +29,19 @@ namespace gep
         Yes
     };
 
+    /// \brief order in which asynchronous loads are processed
+    struct LoadPriority
+    {
+        enum Enum
+        {
+            Low,
+            Normal,
+            High,
+
+            Count
+        };
+    };
+
     class IResource
         : public WeakReferenced<IResource, WeakReferencedExport>
     {
@@ -113,6 +127,11 @@ namespace gep
             m_ptr.invalidateAndReplace(ptr);
         }
 
+        void invalidate()
+        {
+            m_ptr.invalidate();
+        }
+
     public:
         ResourcePtr() {}
 
@@ -190,7 +209,7 @@ namespace gep
     class IResourceManager : public ISubsystem
     {
     protected:
-        virtual ResourcePtr<IResource> doLoadResource(IResourceLoader& loader, LoadAsync loadAsync) = 0;
+        virtual ResourcePtr<IResource> doLoadResource(IResourceLoader& loader, LoadAsync loadAsync, LoadPriority::Enum priority) = 0;
 
         inline static IResource** begin() { return IResource::begin(); }
         inline static IResource** end() { return IResource::end(); }
@@ -198,6 +217,10 @@ namespace gep
         {
             ptr.invalidateAndReplace(replaceWith);
         }
+        inline static void invalidate(ResourcePtr<IResource>& ptr)
+        {
+            ptr.invalidate();
+        }
 
         inline static ResourcePtr<IResource> makeResourcePtr(IResource* pResource, bool isDummy)
         {
@@ -214,12 +237,19 @@ namespace gep
         virtual void reloadResource(ResourcePtr<IResource> pResource) = 0;
 
         /// \brief loads a resource
+        /// \param priority
+        ///   asynchronous loads with a higher priority are started first
         template <class T>
-        inline ResourcePtr<T> loadResource(IResourceLoader& loader, LoadAsync loadAsync = LoadAsync::Yes)
+        inline ResourcePtr<T> loadResource(IResourceLoader& loader, LoadAsync loadAsync = LoadAsync::Yes, LoadPriority::Enum priority = LoadPriority::Normal)
         {
-            return doLoadResource(loader, loadAsync).castTo<T>();
+            return doLoadResource(loader, loadAsync, priority).castTo<T>();
         }
 
+        /// \brief cancels an asynchronous load that has not been patched in yet
+        ///  all resource pointers to the resource become invalid
+        ///  Loads are only canceled by this call, not when the last pointer to the resource goes away.
+        virtual void cancelLoading(ResourcePtr<IResource> pResource) = 0;
+
         /// \brief deletes a resource
         virtual void deleteResource(IResource* pResource) = 0;
 
@@ -239,5 +269,8 @@ namespace gep
 
         /// \brief deregisters a previously registered resource loader
         virtual void deregisterLoaderForReload(const std::string& filename, IResourceLoader* pLoader) = 0;
+
+        /// \brief file system all resource loaders should read their files from
+        virtual VirtualFileSystem& getFileSystem() = 0;
     };
 }
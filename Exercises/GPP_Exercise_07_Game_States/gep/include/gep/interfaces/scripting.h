@@ -2,6 +2,7 @@
 
 #include "gep/interfaces/subsystem.h"
 #include "gep/scripting/luaHelper.h"
+#include "gep/scripting/scriptStatePool.h"
 #include "gep/container/hashmap.h"
 
 #include "gep/singleton.h"
@@ -73,7 +74,33 @@ namespace gep
         virtual lua_State* getState() = 0;
 
         virtual void debugBreak(const char* message) const = 0;
-        
+
+        /// \brief Starts or stops the script profiler. It costs nothing while it is disabled.
+        virtual void setProfilingEnabled(bool enabled) = 0;
+        virtual bool isProfilingEnabled() const = 0;
+
+        /// \brief Writes what the profiler recorded so far in the collapsed stack format of flamegraph.pl.
+        /// \param samplesFileName Receives the number of samples per Lua call stack.
+        /// \param cFunctionTimesFileName Receives the microseconds spent in C functions (e.g. bindings) per call stack.
+        virtual void exportProfile(const std::string& samplesFileName, const std::string& cFunctionTimesFileName) = 0;
+
+        /// \brief The Lua states that update the pooled objects in parallel.
+        /// \return nullptr if settings.scripting.numPooledStates is 0.
+        virtual ScriptStatePool* getStatePool() = 0;
+
+        /// \brief Loads a script into every pooled state.
+        /// \remarks May throw a ScriptException (ScriptLoadException, ScriptExecutionException)
+        virtual void loadPooledScript(const std::string& filename, LoadOptions::Enum loadOptions = LoadOptions::Default) = 0;
+
+        /// \brief The pooled states call updateFunction(objectName, elapsedTime) for the object every update.
+        virtual void addPooledObject(const std::string& objectName, const std::string& updateFunction) = 0;
+        virtual void removePooledObject(const std::string& objectName) = 0;
+
+        /// \brief Delivered to onMessage(objectName, name, data) of the pooled state that updates the object.
+        ///        The messages the pooled scripts post go to onPooledMessage(objectName, name, data) of the main state.
+        virtual void sendPooledMessage(const std::string& objectName, const std::string& name, const std::string& data) = 0;
+
+        /// \brief Binds the type in the main state only, see bindPooled for the pooled states.
         template <typename T>
         void bind(const char* className, T* instance = nullptr)
         {
@@ -86,6 +113,20 @@ namespace gep
             }
         }
 
+        /// \brief Binds the type in every pooled state, without an instance.
+        /// The pooled states run on the task queue workers, so only types without shared state
+        /// (e.g. the math types) may be bound there, never the engine singletons.
+        template <typename T>
+        void bindPooled(const char* className)
+        {
+            auto pStatePool = getStatePool();
+            if (pStatePool != nullptr)
+            {
+                pStatePool->bind<T>(className);
+            }
+        }
+
+        /// \brief Binds the enum in the main state and in every pooled state, it only consists of constants.
         virtual void bindEnum(const char* enumName, ...) = 0;
 
 #if GEP_VARIADIC_TEMPLATE_ARGUMENTS_ENABLED
@@ -133,6 +174,10 @@ namespace gep
             LUA_BIND_FUNCTION_NAMED(debugBreak, "_debugBreak")
             LUA_BIND_FUNCTION_NAMED(getScriptsRootCopy, "getScriptsRoot")
             LUA_BIND_FUNCTION_NAMED(getImportantScriptsRootCopy, "getImportantScriptsRoot")
+            LUA_BIND_FUNCTION_NAMED(loadPooledScript, "_loadPooledScript")
+            LUA_BIND_FUNCTION(addPooledObject)
+            LUA_BIND_FUNCTION(removePooledObject)
+            LUA_BIND_FUNCTION(sendPooledMessage)
         LUA_BIND_REFERENCE_TYPE_END
 
     private:
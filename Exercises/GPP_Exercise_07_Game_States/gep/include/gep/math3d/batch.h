@@ -0,0 +1,338 @@
+#pragma once
+
+#include "gep/math3d/mat4.h"
+#include "gep/math3d/simd.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief Kernels working on many points, boxes or matrices at once.
+    ///
+    /// Points and boxes are passed in structure of arrays layout (one array per component),
+    /// so the SSE versions handle 4 elements per instruction without any shuffling.
+    /// Positions are transformed exactly like mat4::transformPosition does it.
+    /// None of the arrays has to be aligned and every kernel only touches the range it is given,
+    /// so large arrays can be split into chunks and processed with TaskQueue::runParallel.
+    namespace batch
+    {
+        /// \brief non owning view on 3d points in structure of arrays layout
+        struct Vec3Streams
+        {
+            float* x;
+            float* y;
+            float* z;
+            size_t count;
+
+            inline Vec3Streams() : x(nullptr), y(nullptr), z(nullptr), count(0) {}
+
+            inline Vec3Streams(float* x, float* y, float* z, size_t count) :
+                x(x), y(y), z(z), count(count)
+            {
+            }
+
+            /// \brief returns the view on the elements [start, end)
+            inline Vec3Streams slice(size_t start, size_t end) const
+            {
+                GEP_ASSERT(start <= end && end <= count, "slice out of bounds", start, end, count);
+                return Vec3Streams(x + start, y + start, z + start, end - start);
+            }
+
+            inline const vec3 get(size_t i) const
+            {
+                GEP_ASSERT(i < count, "out of bounds access", i, count);
+                return vec3(x[i], y[i], z[i]);
+            }
+
+            inline void set(size_t i, const vec3& v) const
+            {
+                GEP_ASSERT(i < count, "out of bounds access", i, count);
+                x[i] = v.x;
+                y[i] = v.y;
+                z[i] = v.z;
+            }
+        };
+
+        /// \brief non owning view on axis aligned boxes in structure of arrays layout
+        struct BoxStreams
+        {
+            Vec3Streams min;
+            Vec3Streams max;
+
+            inline BoxStreams() {}
+
+            inline BoxStreams(const Vec3Streams& min, const Vec3Streams& max) : min(min), max(max)
+            {
+                GEP_ASSERT(min.count == max.count, "min and max need the same number of elements", min.count, max.count);
+            }
+
+            inline size_t count() const { return min.count; }
+
+            /// \brief returns the view on the boxes [start, end)
+            inline BoxStreams slice(size_t start, size_t end) const
+            {
+                return BoxStreams(min.slice(start, end), max.slice(start, end));
+            }
+        };
+
+        /// \brief storage for 3d points in structure of arrays layout
+        template <class AllocatorPolicy = StdAllocatorPolicy>
+        class Vec3StreamArray
+        {
+        private:
+            DynamicArray<float, AllocatorPolicy> m_x, m_y, m_z;
+
+        public:
+            inline size_t length() const { return m_x.length(); }
+
+            inline void resize(size_t length)
+            {
+                m_x.resize(length);
+                m_y.resize(length);
+                m_z.resize(length);
+            }
+
+            inline void reserve(size_t length)
+            {
+                m_x.reserve(length);
+                m_y.reserve(length);
+                m_z.reserve(length);
+            }
+
+            inline void clear()
+            {
+                m_x.clear();
+                m_y.clear();
+                m_z.clear();
+            }
+
+            inline void append(const vec3& v)
+            {
+                m_x.append(v.x);
+                m_y.append(v.y);
+                m_z.append(v.z);
+            }
+
+            /// \brief the returned view is invalidated by resizing the array
+            inline Vec3Streams getStreams()
+            {
+                if(length() == 0)
+                    return Vec3Streams();
+                return Vec3Streams(&m_x[0], &m_y[0], &m_z[0], length());
+            }
+        };
+
+        namespace detail
+        {
+            inline void transformPosition(const float* m, float x, float y, float z, float& outX, float& outY, float& outZ)
+            {
+                outX = x * m[0] + y * m[4] + z * m[8]  + m[12];
+                outY = x * m[1] + y * m[5] + z * m[9]  + m[13];
+                outZ = x * m[2] + y * m[6] + z * m[10] + m[14];
+            }
+
+            /// Arvo's method: the transformed center plus the extents projected on the axes
+            inline void transformBox(const float* m, const float* absM, const Vec3Streams& inMin, const Vec3Streams& inMax,
+                                     const Vec3Streams& outMin, const Vec3Streams& outMax, size_t i)
+            {
+                float cx = (inMin.x[i] + inMax.x[i]) * 0.5f;
+                float cy = (inMin.y[i] + inMax.y[i]) * 0.5f;
+                float cz = (inMin.z[i] + inMax.z[i]) * 0.5f;
+                float ex = (inMax.x[i] - inMin.x[i]) * 0.5f;
+                float ey = (inMax.y[i] - inMin.y[i]) * 0.5f;
+                float ez = (inMax.z[i] - inMin.z[i]) * 0.5f;
+                transformPosition(m, cx, cy, cz, cx, cy, cz);
+                float newEx = ex * absM[0] + ey * absM[3] + ez * absM[6];
+                float newEy = ex * absM[1] + ey * absM[4] + ez * absM[7];
+                float newEz = ex * absM[2] + ey * absM[5] + ez * absM[8];
+                outMin.x[i] = cx - newEx;
+                outMin.y[i] = cy - newEy;
+                outMin.z[i] = cz - newEz;
+                outMax.x[i] = cx + newEx;
+                outMax.y[i] = cy + newEy;
+                outMax.z[i] = cz + newEz;
+            }
+        }
+
+        /// \brief out[i] = m.transformPosition(in[i])
+        ///
+        /// in and out may be the same streams.
+        inline void transformPositions(const mat4& m, const Vec3Streams& in, const Vec3Streams& out)
+        {
+            GEP_ASSERT(in.count == out.count, "in and out need the same number of elements", in.count, out.count);
+            const float* d = m.data;
+            size_t i = 0;
+#if GEP_MATH_SIMD
+            __m128 m0 = _mm_set1_ps(d[0]), m4 = _mm_set1_ps(d[4]), m8  = _mm_set1_ps(d[8]),  m12 = _mm_set1_ps(d[12]);
+            __m128 m1 = _mm_set1_ps(d[1]), m5 = _mm_set1_ps(d[5]), m9  = _mm_set1_ps(d[9]),  m13 = _mm_set1_ps(d[13]);
+            __m128 m2 = _mm_set1_ps(d[2]), m6 = _mm_set1_ps(d[6]), m10 = _mm_set1_ps(d[10]), m14 = _mm_set1_ps(d[14]);
+            for(; i + 4 <= in.count; i += 4)
+            {
+                __m128 x = _mm_loadu_ps(in.x + i);
+                __m128 y = _mm_loadu_ps(in.y + i);
+                __m128 z = _mm_loadu_ps(in.z + i);
+                _mm_storeu_ps(out.x + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m0), _mm_mul_ps(y, m4)), _mm_mul_ps(z, m8)),  m12));
+                _mm_storeu_ps(out.y + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m1), _mm_mul_ps(y, m5)), _mm_mul_ps(z, m9)),  m13));
+                _mm_storeu_ps(out.z + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m2), _mm_mul_ps(y, m6)), _mm_mul_ps(z, m10)), m14));
+            }
+#endif
+            for(; i < in.count; i++)
+                detail::transformPosition(d, in.x[i], in.y[i], in.z[i], out.x[i], out.y[i], out.z[i]);
+        }
+
+        /// \brief out[i] = the smallest axis aligned box containing the transformed box in[i]
+        ///
+        /// Unlike transforming only the min and max corners, this is correct for rotations as well.
+        /// in and out may be the same streams.
+        inline void transformBoxes(const mat4& m, const BoxStreams& in, const BoxStreams& out)
+        {
+            GEP_ASSERT(in.count() == out.count(), "in and out need the same number of elements", in.count(), out.count());
+            const float* d = m.data;
+            float absM[9] = {
+                fabsf(d[0]), fabsf(d[1]), fabsf(d[2]),
+                fabsf(d[4]), fabsf(d[5]), fabsf(d[6]),
+                fabsf(d[8]), fabsf(d[9]), fabsf(d[10])
+            };
+            size_t i = 0;
+#if GEP_MATH_SIMD
+            __m128 m0 = _mm_set1_ps(d[0]), m4 = _mm_set1_ps(d[4]), m8  = _mm_set1_ps(d[8]),  m12 = _mm_set1_ps(d[12]);
+            __m128 m1 = _mm_set1_ps(d[1]), m5 = _mm_set1_ps(d[5]), m9  = _mm_set1_ps(d[9]),  m13 = _mm_set1_ps(d[13]);
+            __m128 m2 = _mm_set1_ps(d[2]), m6 = _mm_set1_ps(d[6]), m10 = _mm_set1_ps(d[10]), m14 = _mm_set1_ps(d[14]);
+            __m128 a0 = _mm_set1_ps(absM[0]), a3 = _mm_set1_ps(absM[3]), a6 = _mm_set1_ps(absM[6]);
+            __m128 a1 = _mm_set1_ps(absM[1]), a4 = _mm_set1_ps(absM[4]), a7 = _mm_set1_ps(absM[7]);
+            __m128 a2 = _mm_set1_ps(absM[2]), a5 = _mm_set1_ps(absM[5]), a8 = _mm_set1_ps(absM[8]);
+            __m128 half = _mm_set1_ps(0.5f);
+            for(; i + 4 <= in.count(); i += 4)
+            {
+                __m128 minX = _mm_loadu_ps(in.min.x + i), maxX = _mm_loadu_ps(in.max.x + i);
+                __m128 minY = _mm_loadu_ps(in.min.y + i), maxY = _mm_loadu_ps(in.max.y + i);
+                __m128 minZ = _mm_loadu_ps(in.min.z + i), maxZ = _mm_loadu_ps(in.max.z + i);
+                __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+                __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+                __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+                __m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+                __m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+                __m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+                __m128 newCx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, m0), _mm_mul_ps(cy, m4)), _mm_mul_ps(cz, m8)),  m12);
+                __m128 newCy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, m1), _mm_mul_ps(cy, m5)), _mm_mul_ps(cz, m9)),  m13);
+                __m128 newCz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, m2), _mm_mul_ps(cy, m6)), _mm_mul_ps(cz, m10)), m14);
+                __m128 newEx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, a0), _mm_mul_ps(ey, a3)), _mm_mul_ps(ez, a6));
+                __m128 newEy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, a1), _mm_mul_ps(ey, a4)), _mm_mul_ps(ez, a7));
+                __m128 newEz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, a2), _mm_mul_ps(ey, a5)), _mm_mul_ps(ez, a8));
+                _mm_storeu_ps(out.min.x + i, _mm_sub_ps(newCx, newEx));
+                _mm_storeu_ps(out.min.y + i, _mm_sub_ps(newCy, newEy));
+                _mm_storeu_ps(out.min.z + i, _mm_sub_ps(newCz, newEz));
+                _mm_storeu_ps(out.max.x + i, _mm_add_ps(newCx, newEx));
+                _mm_storeu_ps(out.max.y + i, _mm_add_ps(newCy, newEy));
+                _mm_storeu_ps(out.max.z + i, _mm_add_ps(newCz, newEz));
+            }
+#endif
+            for(; i < in.count(); i++)
+                detail::transformBox(d, absM, in.min, in.max, out.min, out.max, i);
+        }
+
+        /// \brief result[i] = lhs * rhs[i], e.g. for concatenating a parent transformation with many local ones
+        inline void multiply(const mat4& lhs, ArrayPtr<const mat4> rhs, ArrayPtr<mat4> result)
+        {
+            GEP_ASSERT(rhs.length() == result.length(), "rhs and result need the same number of elements", rhs.length(), result.length());
+            for(size_t i = 0; i < rhs.length(); i++)
+                simd::multiply4x4(lhs.data, rhs[i].data, result[i].data);
+        }
+
+        /// \brief result[i] = lhs[i] * rhs[i]
+        inline void multiply(ArrayPtr<const mat4> lhs, ArrayPtr<const mat4> rhs, ArrayPtr<mat4> result)
+        {
+            GEP_ASSERT(lhs.length() == rhs.length() && rhs.length() == result.length(), "all arrays need the same number of elements",
+                       lhs.length(), rhs.length(), result.length());
+            for(size_t i = 0; i < rhs.length(); i++)
+                simd::multiply4x4(lhs[i].data, rhs[i].data, result[i].data);
+        }
+
+        /// \brief grows min and max so that they contain all the given points
+        ///
+        /// Start with min = vec3(FLT_MAX) and max = vec3(-FLT_MAX) to compute the bounds of the points only.
+        inline void extendBounds(const Vec3Streams& points, vec3& min, vec3& max)
+        {
+            size_t i = 0;
+#if GEP_MATH_SIMD
+            if(points.count >= 4)
+            {
+                __m128 minX = _mm_set1_ps(min.x), minY = _mm_set1_ps(min.y), minZ = _mm_set1_ps(min.z);
+                __m128 maxX = _mm_set1_ps(max.x), maxY = _mm_set1_ps(max.y), maxZ = _mm_set1_ps(max.z);
+                for(; i + 4 <= points.count; i += 4)
+                {
+                    __m128 x = _mm_loadu_ps(points.x + i);
+                    __m128 y = _mm_loadu_ps(points.y + i);
+                    __m128 z = _mm_loadu_ps(points.z + i);
+                    minX = _mm_min_ps(minX, x); maxX = _mm_max_ps(maxX, x);
+                    minY = _mm_min_ps(minY, y); maxY = _mm_max_ps(maxY, y);
+                    minZ = _mm_min_ps(minZ, z); maxZ = _mm_max_ps(maxZ, z);
+                }
+                float lanes[6][4];
+                _mm_storeu_ps(lanes[0], minX); _mm_storeu_ps(lanes[1], minY); _mm_storeu_ps(lanes[2], minZ);
+                _mm_storeu_ps(lanes[3], maxX); _mm_storeu_ps(lanes[4], maxY); _mm_storeu_ps(lanes[5], maxZ);
+                for(int lane = 0; lane < 4; lane++)
+                {
+                    for(int axis = 0; axis < 3; axis++)
+                    {
+                        min.data[axis] = GEP_MIN(min.data[axis], lanes[axis][lane]);
+                        max.data[axis] = GEP_MAX(max.data[axis], lanes[axis + 3][lane]);
+                    }
+                }
+            }
+#endif
+            for(; i < points.count; i++)
+            {
+                min.x = GEP_MIN(min.x, points.x[i]); max.x = GEP_MAX(max.x, points.x[i]);
+                min.y = GEP_MIN(min.y, points.y[i]); max.y = GEP_MAX(max.y, points.y[i]);
+                min.z = GEP_MIN(min.z, points.z[i]); max.z = GEP_MAX(max.z, points.z[i]);
+            }
+        }
+
+        /// \brief grows min and max so that they contain all the given points
+        ///
+        /// Same as above for tightly packed vec3 arrays, e.g. the vertex positions of a mesh.
+        inline void extendBounds(ArrayPtr<const vec3> points, vec3& min, vec3& max)
+        {
+            static_assert(sizeof(vec3) == 3 * sizeof(float), "the kernel needs tightly packed vec3");
+            size_t i = 0;
+#if GEP_MATH_SIMD
+            if(points.length() >= 4)
+            {
+                // 4 points are 3 registers: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3)
+                // each register keeps its own minimum and maximum and the lanes are sorted out at the end
+                __m128 min0 = _mm_setr_ps(min.x, min.y, min.z, min.x);
+                __m128 min1 = _mm_setr_ps(min.y, min.z, min.x, min.y);
+                __m128 min2 = _mm_setr_ps(min.z, min.x, min.y, min.z);
+                __m128 max0 = _mm_setr_ps(max.x, max.y, max.z, max.x);
+                __m128 max1 = _mm_setr_ps(max.y, max.z, max.x, max.y);
+                __m128 max2 = _mm_setr_ps(max.z, max.x, max.y, max.z);
+                const float* p = points[0].data;
+                for(; i + 4 <= points.length(); i += 4, p += 12)
+                {
+                    __m128 r0 = _mm_loadu_ps(p);
+                    __m128 r1 = _mm_loadu_ps(p + 4);
+                    __m128 r2 = _mm_loadu_ps(p + 8);
+                    min0 = _mm_min_ps(min0, r0); max0 = _mm_max_ps(max0, r0);
+                    min1 = _mm_min_ps(min1, r1); max1 = _mm_max_ps(max1, r1);
+                    min2 = _mm_min_ps(min2, r2); max2 = _mm_max_ps(max2, r2);
+                }
+                float mins[12], maxs[12];
+                _mm_storeu_ps(mins, min0); _mm_storeu_ps(mins + 4, min1); _mm_storeu_ps(mins + 8, min2);
+                _mm_storeu_ps(maxs, max0); _mm_storeu_ps(maxs + 4, max1); _mm_storeu_ps(maxs + 8, max2);
+                for(int lane = 0; lane < 12; lane++)
+                {
+                    min.data[lane % 3] = GEP_MIN(min.data[lane % 3], mins[lane]);
+                    max.data[lane % 3] = GEP_MAX(max.data[lane % 3], maxs[lane]);
+                }
+            }
+#endif
+            for(; i < points.length(); i++)
+            {
+                const vec3& v = points[i];
+                min.x = GEP_MIN(min.x, v.x); max.x = GEP_MAX(max.x, v.x);
+                min.y = GEP_MIN(min.y, v.y); max.y = GEP_MAX(max.y, v.y);
+                min.z = GEP_MIN(min.z, v.z); max.z = GEP_MAX(max.z, v.z);
+            }
+        }
+    }
+}
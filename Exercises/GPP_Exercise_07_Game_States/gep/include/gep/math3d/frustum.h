@@ -0,0 +1,123 @@
+#pragma once
+
+#include "gep/math3d/vec3.h"
+#include "gep/math3d/mat4.h"
+#include "gep/math3d/plane.h"
+#include "gep/math3d/aabb.h"
+
+namespace gep
+{
+    /// \brief result of testing a volume against a frustum
+    enum class FrustumIntersection
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    /// \brief a view frustum, given by 6 planes whose normals point inwards
+    ///
+    /// The planes are ordered left, right, bottom, top, near, far.
+    template <typename T>
+    struct Frustum_t
+    {
+        static const size_t NUM_PLANES = 6;
+
+        Plane_t<T> planes[NUM_PLANES];
+
+        /// \brief default constructor
+        inline Frustum_t() {}
+
+        /// \brief extracts the planes from a view projection matrix (clip position = viewProjection * position)
+        ///
+        /// The depth range is [0, 1], like the one of mat4::projectionMatrix.
+        /// The planes are not normalized, which is fine for the inside/outside tests.
+        explicit Frustum_t(const mat4_t<T>& viewProjection)
+        {
+            const T* m = viewProjection.data;
+            // the rows of the matrix, the data is column major
+            T row0[4] = { m[0], m[4], m[8],  m[12] };
+            T row1[4] = { m[1], m[5], m[9],  m[13] };
+            T row2[4] = { m[2], m[6], m[10], m[14] };
+            T row3[4] = { m[3], m[7], m[11], m[15] };
+            setPlane(0, row3, row0,  1); // left:   -w <= x
+            setPlane(1, row3, row0, -1); // right:   x <= w
+            setPlane(2, row3, row1,  1); // bottom: -w <= y
+            setPlane(3, row3, row1, -1); // top:     y <= w
+            setPlane(4, row2, row2,  0); // near:    0 <= z
+            setPlane(5, row3, row2, -1); // far:     z <= w
+        }
+
+        /// \brief returns the frustum in the space modelMatrix transforms from
+        ///
+        /// Testing the model space bounds against the transformed frustum is cheaper than transforming
+        /// all bounds into world space and keeps the boxes tight.
+        const Frustum_t<T> toLocalSpace(const mat4_t<T>& modelMatrix) const
+        {
+            // a plane p = (normal, -distance) transforms with the transposed matrix
+            Frustum_t<T> result;
+            const T* m = modelMatrix.data;
+            for(size_t i=0; i < NUM_PLANES; i++)
+            {
+                const Plane_t<T>& p = planes[i];
+                T w = -p.distanceFromOrigin;
+                result.planes[i].normal.x = m[0]  * p.normal.x + m[1]  * p.normal.y + m[2]  * p.normal.z + m[3]  * w;
+                result.planes[i].normal.y = m[4]  * p.normal.x + m[5]  * p.normal.y + m[6]  * p.normal.z + m[7]  * w;
+                result.planes[i].normal.z = m[8]  * p.normal.x + m[9]  * p.normal.y + m[10] * p.normal.z + m[11] * w;
+                result.planes[i].distanceFromOrigin = -(m[12] * p.normal.x + m[13] * p.normal.y + m[14] * p.normal.z + m[15] * w);
+            }
+            return result;
+        }
+
+        /// \brief checks if a point is inside the frustum (or on its border)
+        bool contains(const vec3_t<T>& point) const
+        {
+            for(size_t i=0; i < NUM_PLANES; i++)
+            {
+                if(planes[i].distance(point) < 0)
+                    return false;
+            }
+            return true;
+        }
+
+        /// \brief tests the axis aligned box given by min and max against the frustum
+        ///
+        /// Conservative: boxes near the corners of the frustum may be reported as intersecting
+        /// although they are outside.
+        FrustumIntersection test(const vec3_t<T>& min, const vec3_t<T>& max) const
+        {
+            vec3_t<T> center = (min + max) * static_cast<T>(0.5);
+            vec3_t<T> extents = (max - min) * static_cast<T>(0.5);
+            FrustumIntersection result = FrustumIntersection::Inside;
+            for(size_t i=0; i < NUM_PLANES; i++)
+            {
+                const Plane_t<T>& p = planes[i];
+                T distance = p.distance(center);
+                T radius = std::abs(p.normal.x) * extents.x + std::abs(p.normal.y) * extents.y + std::abs(p.normal.z) * extents.z;
+                if(distance + radius < 0)
+                    return FrustumIntersection::Outside;
+                if(distance - radius < 0)
+                    result = FrustumIntersection::Intersecting;
+            }
+            return result;
+        }
+
+        /// \brief tests a axis aligned box against the frustum
+        inline FrustumIntersection test(const AxisAlignedBox_t<vec3_t<T>>& box) const
+        {
+            return test(box.getMin(), box.getMax());
+        }
+
+    private:
+        void setPlane(size_t index, const T* lhs, const T* rhs, T rhsFactor)
+        {
+            Plane_t<T>& p = planes[index];
+            p.normal.x = lhs[0] + rhs[0] * rhsFactor;
+            p.normal.y = lhs[1] + rhs[1] * rhsFactor;
+            p.normal.z = lhs[2] + rhs[2] * rhsFactor;
+            p.distanceFromOrigin = -(lhs[3] + rhs[3] * rhsFactor);
+        }
+    };
+
+    typedef Frustum_t<float> Frustum;
+}
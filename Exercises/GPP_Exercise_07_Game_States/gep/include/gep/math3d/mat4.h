@@ -2,7 +2,9 @@
 
 #include "gep/math3d/constants.h"
 #include "gep/math3d/vec3.h"
+#include "gep/math3d/vec4.h"
 #include "gep/math3d/mat3.h"
+#include "gep/math3d/simd.h"
 
 namespace gep
 {
@@ -55,12 +57,15 @@ namespace gep
         inline const mat4_t<T> operator * (const mat4_t<T>& m) const
         {
             mat4_t<T> result(DO_NOT_INITIALIZE);
-            for(int i=0;i<4;i++){
-                result.data[i*4]   = this->data[0] * m.data[i*4] + this->data[4] * m.data[i*4+1] + this->data[ 8] * m.data[i*4+2] + this->data[12] * m.data[i*4+3];
-                result.data[i*4+1] = this->data[1] * m.data[i*4] + this->data[5] * m.data[i*4+1] + this->data[ 9] * m.data[i*4+2] + this->data[13] * m.data[i*4+3];
-                result.data[i*4+2] = this->data[2] * m.data[i*4] + this->data[6] * m.data[i*4+1] + this->data[10] * m.data[i*4+2] + this->data[14] * m.data[i*4+3];
-                result.data[i*4+3] = this->data[3] * m.data[i*4] + this->data[7] * m.data[i*4+1] + this->data[11] * m.data[i*4+2] + this->data[15] * m.data[i*4+3];
-            }
+            simd::multiply4x4(this->data, m.data, result.data);
+            return result;
+        }
+
+        /// \brief * operator for multiplying with a 4 component vector
+        inline const vec4_t<T> operator * (const vec4_t<T>& v) const
+        {
+            vec4_t<T> result(DO_NOT_INITIALIZE);
+            simd::transform4(this->data, v.data, result.data);
             return result;
         }
 
@@ -125,40 +130,17 @@ namespace gep
         inline const mat4_t<T> inverse() const
         {
             mat4_t<T> mr(DO_NOT_INITIALIZE);
-            T mdet = this->det();
-            mat3_t<T> mtemp(DO_NOT_INITIALIZE);
-            int sign=0;
+            T mdet = simd::inverse4x4(this->data, mr.data);
             if ( mdet > -GetEpsilon<T>::value() && mdet < GetEpsilon<T>::value() )
-                return mat4::identity();
-            for (int i = 0; i < 4; i++ )
-                for (int j = 0; j < 4; j++ ){
-                    sign = 1 - ( (i +j) % 2 ) * 2;
-                    mtemp = this->submat(i, j);
-                    mr.data[i+j*4] = ( mtemp.det() * sign ) / mdet;
-                }
-                return mr;
+                return mat4_t<T>::identity();
+            return mr;
         }
 
         /// \brief returns the transposed version of this matrix
         inline const mat4_t<T> transposed() const
         {
             mat4_t<T> mr(DO_NOT_INITIALIZE);
-            mr.data[0] = data[0];
-            mr.data[1] = data[4];
-            mr.data[2] = data[8];
-            mr.data[3] = data[12];
-            mr.data[4] = data[1];
-            mr.data[5] = data[5];
-            mr.data[6] = data[9];
-            mr.data[7] = data[13];
-            mr.data[8] = data[2];
-            mr.data[9] = data[6];
-            mr.data[10] = data[10];
-            mr.data[11] = data[14];
-            mr.data[12] = data[3];
-            mr.data[13] = data[7];
-            mr.data[14] = data[11];
-            mr.data[15] = data[15];
+            simd::transpose4x4(this->data, mr.data);
             return mr;
         }
 
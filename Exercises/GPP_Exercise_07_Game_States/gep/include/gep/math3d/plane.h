@@ -16,6 +16,9 @@ namespace gep
         vec3_t<T> normal;
         T distanceFromOrigin;
 
+        /// \brief default constructor
+        Plane_t() : distanceFromOrigin(0) {}
+
         /// \brief constructor
         /// \param pos a point on the plane
         /// \param dir the normal of the plane
@@ -81,7 +84,7 @@ namespace gep
         /// \brief returns a normalized copy of the plane
         const Plane_t<T> normalized() const {
             T length = normal.length();
-            return Plane_t<T>(normal / length, distanceFromOrigin / length);
+            return Plane_t<T>(normal.x / length, normal.y / length, normal.z / length, distanceFromOrigin / length);
         }
     };
 
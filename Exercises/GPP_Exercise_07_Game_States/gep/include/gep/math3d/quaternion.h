@@ -121,27 +121,8 @@ namespace gep
         {
             GEP_ASSERT(isValid(), "quaternion is not valid");
             mat4_t<T> mat(DO_NOT_INITIALIZE);
-            Quaternion norm = normalized();
-            auto xx  = norm.x * norm.x;
-            auto xy  = norm.x * norm.y;
-            auto xz  = norm.x * norm.z;
-            auto xw  = norm.x * norm.angle;
-            auto yy  = norm.y * norm.y;
-            auto yz  = norm.y * norm.z;
-            auto yw  = norm.y * norm.angle;
-            auto zz  = norm.z * norm.z;
-            auto zw  = norm.z * norm.angle;
-            mat.data[0]  = T(1) - T(2) * ( yy + zz );
-            mat.data[1]  =        T(2) * ( xy - zw );
-            mat.data[2]  =        T(2) * ( xz + yw );
-            mat.data[4]  =        T(2) * ( xy + zw );
-            mat.data[5]  = T(1) - T(2) * ( xx + zz );
-            mat.data[6]  =        T(2) * ( yz - xw );
-            mat.data[8]  =        T(2) * ( xz - yw );
-            mat.data[9]  =        T(2) * ( yz + xw );
-            mat.data[10] = T(1) - T(2) * ( xx + yy );
-            mat.data[3]  = mat.data[7] = mat.data[11] = mat.data[12] = mat.data[13] = mat.data[14] = T(0);
-            mat.data[15] = T(1);
+            Quaternion_t<T> norm = normalized();
+            simd::quaternionToMatrix(norm.data, mat.data);
             return mat;
         }
 
@@ -0,0 +1,254 @@
+#pragma once
+
+// GEP_MATH_SIMD is 1 if the float overloads below use SSE.
+// Define GEP_NO_SIMD to build everything with the scalar templates.
+#if !defined(GEP_NO_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__))
+    #define GEP_MATH_SIMD 1
+    #include <xmmintrin.h>
+#else
+    #define GEP_MATH_SIMD 0
+#endif
+
+namespace gep
+{
+    /// \brief Kernels behind the 4x4 matrix, vec4 and quaternion operations.
+    ///
+    /// The templates are the scalar implementation for every component type.
+    /// If GEP_MATH_SIMD is set, there are float overloads using SSE which give exactly the same
+    /// results as the templates, except for inverse4x4 which rounds differently.
+    /// quaternionToMatrix has none, the shuffling costs more than the SSE version saves.
+    /// Matrices are column major (see mat4_t) and none of the pointers has to be aligned,
+    /// so the math types keep their layout and can still live in packed arrays and in
+    /// memory from the engine allocators.
+    namespace simd
+    {
+        /// \brief result = lhs * rhs, result must not overlap with lhs or rhs
+        template <typename T>
+        inline void multiply4x4(const T* lhs, const T* rhs, T* result)
+        {
+            for(int i=0;i<4;i++){
+                result[i*4]   = lhs[0] * rhs[i*4] + lhs[4] * rhs[i*4+1] + lhs[ 8] * rhs[i*4+2] + lhs[12] * rhs[i*4+3];
+                result[i*4+1] = lhs[1] * rhs[i*4] + lhs[5] * rhs[i*4+1] + lhs[ 9] * rhs[i*4+2] + lhs[13] * rhs[i*4+3];
+                result[i*4+2] = lhs[2] * rhs[i*4] + lhs[6] * rhs[i*4+1] + lhs[10] * rhs[i*4+2] + lhs[14] * rhs[i*4+3];
+                result[i*4+3] = lhs[3] * rhs[i*4] + lhs[7] * rhs[i*4+1] + lhs[11] * rhs[i*4+2] + lhs[15] * rhs[i*4+3];
+            }
+        }
+
+        /// \brief result = m * v for a 4 component vector v
+        template <typename T>
+        inline void transform4(const T* m, const T* v, T* result)
+        {
+            T x = v[0], y = v[1], z = v[2], w = v[3];
+            result[0] = m[0] * x + m[4] * y + m[ 8] * z + m[12] * w;
+            result[1] = m[1] * x + m[5] * y + m[ 9] * z + m[13] * w;
+            result[2] = m[2] * x + m[6] * y + m[10] * z + m[14] * w;
+            result[3] = m[3] * x + m[7] * y + m[11] * z + m[15] * w;
+        }
+
+        /// \brief result = transposed m, result must not overlap with m
+        template <typename T>
+        inline void transpose4x4(const T* m, T* result)
+        {
+            for(int i=0;i<4;i++){
+                for(int j=0;j<4;j++){
+                    result[i*4+j] = m[j*4+i];
+                }
+            }
+        }
+
+        /// \brief result = inverse of m, computed from the 2x2 minors
+        ///
+        /// \return the determinant of m. If it is 0 the content of result is undefined.
+        template <typename T>
+        inline T inverse4x4(const T* m, T* result)
+        {
+            // (M^T)^-1 = (M^-1)^T, so the formulas work for either layout
+            T s0 = m[0] * m[5] - m[4] * m[1];
+            T s1 = m[0] * m[6] - m[4] * m[2];
+            T s2 = m[0] * m[7] - m[4] * m[3];
+            T s3 = m[1] * m[6] - m[5] * m[2];
+            T s4 = m[1] * m[7] - m[5] * m[3];
+            T s5 = m[2] * m[7] - m[6] * m[3];
+
+            T c5 = m[10] * m[15] - m[14] * m[11];
+            T c4 = m[ 9] * m[15] - m[13] * m[11];
+            T c3 = m[ 9] * m[14] - m[13] * m[10];
+            T c2 = m[ 8] * m[15] - m[12] * m[11];
+            T c1 = m[ 8] * m[14] - m[12] * m[10];
+            T c0 = m[ 8] * m[13] - m[12] * m[ 9];
+
+            T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+            if(det == 0)
+                return det;
+            T invDet = 1 / det;
+
+            result[ 0] = ( m[ 5] * c5 - m[ 6] * c4 + m[ 7] * c3) * invDet;
+            result[ 1] = (-m[ 1] * c5 + m[ 2] * c4 - m[ 3] * c3) * invDet;
+            result[ 2] = ( m[13] * s5 - m[14] * s4 + m[15] * s3) * invDet;
+            result[ 3] = (-m[ 9] * s5 + m[10] * s4 - m[11] * s3) * invDet;
+
+            result[ 4] = (-m[ 4] * c5 + m[ 6] * c2 - m[ 7] * c1) * invDet;
+            result[ 5] = ( m[ 0] * c5 - m[ 2] * c2 + m[ 3] * c1) * invDet;
+            result[ 6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * invDet;
+            result[ 7] = ( m[ 8] * s5 - m[10] * s2 + m[11] * s1) * invDet;
+
+            result[ 8] = ( m[ 4] * c4 - m[ 5] * c2 + m[ 7] * c0) * invDet;
+            result[ 9] = (-m[ 0] * c4 + m[ 1] * c2 - m[ 3] * c0) * invDet;
+            result[10] = ( m[12] * s4 - m[13] * s2 + m[15] * s0) * invDet;
+            result[11] = (-m[ 8] * s4 + m[ 9] * s2 - m[11] * s0) * invDet;
+
+            result[12] = (-m[ 4] * c3 + m[ 5] * c1 - m[ 6] * c0) * invDet;
+            result[13] = ( m[ 0] * c3 - m[ 1] * c1 + m[ 2] * c0) * invDet;
+            result[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * invDet;
+            result[15] = ( m[ 8] * s3 - m[ 9] * s1 + m[10] * s0) * invDet;
+            return det;
+        }
+
+        /// \brief writes the 4x4 rotation matrix of the normalized quaternion q (x, y, z, w)
+        template <typename T>
+        inline void quaternionToMatrix(const T* q, T* result)
+        {
+            T x = q[0], y = q[1], z = q[2], w = q[3];
+            T xx = x * x, xy = x * y, xz = x * z, xw = x * w;
+            T yy = y * y, yz = y * z, yw = y * w;
+            T zz = z * z, zw = z * w;
+            result[0]  = T(1) - T(2) * ( yy + zz );
+            result[1]  =        T(2) * ( xy - zw );
+            result[2]  =        T(2) * ( xz + yw );
+            result[4]  =        T(2) * ( xy + zw );
+            result[5]  = T(1) - T(2) * ( xx + zz );
+            result[6]  =        T(2) * ( yz - xw );
+            result[8]  =        T(2) * ( xz - yw );
+            result[9]  =        T(2) * ( yz + xw );
+            result[10] = T(1) - T(2) * ( xx + yy );
+            result[3]  = result[7] = result[11] = result[12] = result[13] = result[14] = T(0);
+            result[15] = T(1);
+        }
+
+#if GEP_MATH_SIMD
+        // The overloads for float. The operations are done in the same order as in the
+        // templates and there is no fused multiply add, so the results are bit identical.
+
+        #define GEP_SIMD_SHUFFLE(v, x, y, z, w) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(w, z, y, x))
+
+        inline void multiply4x4(const float* lhs, const float* rhs, float* result)
+        {
+            __m128 c0 = _mm_loadu_ps(lhs);
+            __m128 c1 = _mm_loadu_ps(lhs + 4);
+            __m128 c2 = _mm_loadu_ps(lhs + 8);
+            __m128 c3 = _mm_loadu_ps(lhs + 12);
+            for(int i=0;i<4;i++){
+                __m128 r = _mm_mul_ps(c0, _mm_set1_ps(rhs[i*4]));
+                r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(rhs[i*4+1])));
+                r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(rhs[i*4+2])));
+                r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(rhs[i*4+3])));
+                _mm_storeu_ps(result + i*4, r);
+            }
+        }
+
+        inline void transform4(const float* m, const float* v, float* result)
+        {
+            __m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0]));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+            _mm_storeu_ps(result, r);
+        }
+
+        inline void transpose4x4(const float* m, float* result)
+        {
+            __m128 c0 = _mm_loadu_ps(m);
+            __m128 c1 = _mm_loadu_ps(m + 4);
+            __m128 c2 = _mm_loadu_ps(m + 8);
+            __m128 c3 = _mm_loadu_ps(m + 12);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            _mm_storeu_ps(result, c0);
+            _mm_storeu_ps(result + 4, c1);
+            _mm_storeu_ps(result + 8, c2);
+            _mm_storeu_ps(result + 12, c3);
+        }
+
+        namespace detail
+        {
+            // 2x2 matrices are stored as (m00, m01, m10, m11) in one register
+
+            /// a * b
+            inline __m128 mul2x2(__m128 a, __m128 b)
+            {
+                return _mm_add_ps(_mm_mul_ps(a, GEP_SIMD_SHUFFLE(b, 0,3,0,3)),
+                                  _mm_mul_ps(GEP_SIMD_SHUFFLE(a, 1,0,3,2), GEP_SIMD_SHUFFLE(b, 2,1,2,1)));
+            }
+
+            /// adjugate(a) * b
+            inline __m128 adjMul2x2(__m128 a, __m128 b)
+            {
+                return _mm_sub_ps(_mm_mul_ps(GEP_SIMD_SHUFFLE(a, 3,3,0,0), b),
+                                  _mm_mul_ps(GEP_SIMD_SHUFFLE(a, 1,1,2,2), GEP_SIMD_SHUFFLE(b, 2,3,0,1)));
+            }
+
+            /// a * adjugate(b)
+            inline __m128 mulAdj2x2(__m128 a, __m128 b)
+            {
+                return _mm_sub_ps(_mm_mul_ps(a, GEP_SIMD_SHUFFLE(b, 3,0,3,0)),
+                                  _mm_mul_ps(GEP_SIMD_SHUFFLE(a, 1,0,3,2), GEP_SIMD_SHUFFLE(b, 2,1,2,1)));
+            }
+        }
+
+        /// Blockwise inverse with the 2x2 sub matrices A B / C D of m.
+        inline float inverse4x4(const float* m, float* result)
+        {
+            __m128 c0 = _mm_loadu_ps(m);
+            __m128 c1 = _mm_loadu_ps(m + 4);
+            __m128 c2 = _mm_loadu_ps(m + 8);
+            __m128 c3 = _mm_loadu_ps(m + 12);
+
+            __m128 A = _mm_movelh_ps(c0, c1);
+            __m128 B = _mm_movehl_ps(c1, c0);
+            __m128 C = _mm_movelh_ps(c2, c3);
+            __m128 D = _mm_movehl_ps(c3, c2);
+
+            // (|A|, |B|, |C|, |D|)
+            __m128 detSub = _mm_sub_ps(
+                _mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(3,1,3,1))),
+                _mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(3,1,3,1)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(2,0,2,0))));
+            __m128 detA = GEP_SIMD_SHUFFLE(detSub, 0,0,0,0);
+            __m128 detB = GEP_SIMD_SHUFFLE(detSub, 1,1,1,1);
+            __m128 detC = GEP_SIMD_SHUFFLE(detSub, 2,2,2,2);
+            __m128 detD = GEP_SIMD_SHUFFLE(detSub, 3,3,3,3);
+
+            __m128 D_C = detail::adjMul2x2(D, C);
+            __m128 A_B = detail::adjMul2x2(A, B);
+            __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), detail::mul2x2(B, D_C));
+            __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), detail::mul2x2(C, A_B));
+            __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), detail::mulAdj2x2(D, A_B));
+            __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), detail::mulAdj2x2(A, D_C));
+
+            // |M| = |A||D| + |B||C| - trace(A#B * D#C)
+            __m128 tr = _mm_mul_ps(A_B, GEP_SIMD_SHUFFLE(D_C, 0,2,1,3));
+            tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+            tr = _mm_add_ss(tr, GEP_SIMD_SHUFFLE(tr, 1,1,1,1));
+            __m128 detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+            detM = _mm_sub_ps(detM, GEP_SIMD_SHUFFLE(tr, 0,0,0,0));
+
+            float det = _mm_cvtss_f32(detM);
+            if(det == 0.0f)
+                return det;
+
+            __m128 invDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+            X = _mm_mul_ps(X, invDet);
+            Y = _mm_mul_ps(Y, invDet);
+            Z = _mm_mul_ps(Z, invDet);
+            W = _mm_mul_ps(W, invDet);
+
+            // adjugate the blocks and put them back together
+            _mm_storeu_ps(result,      _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1,3,1,3)));
+            _mm_storeu_ps(result + 4,  _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0,2,0,2)));
+            _mm_storeu_ps(result + 8,  _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1,3,1,3)));
+            _mm_storeu_ps(result + 12, _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0,2,0,2)));
+            return det;
+        }
+
+        #undef GEP_SIMD_SHUFFLE
+#endif
+    }
+}
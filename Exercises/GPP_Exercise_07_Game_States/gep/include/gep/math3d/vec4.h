@@ -1,5 +1,7 @@
 #pragma once
 
+#include "gep/math3d/vec3.h"
+
 namespace gep{
     template <typename T>
     struct vec4_t {
@@ -28,6 +30,45 @@ namespace gep{
             this->z = z;
 			this->w = w;
         }
+
+        /// \brief constructor
+        inline vec4_t(const vec3_t<T>& xyz, T w)
+        {
+            this->x = xyz.x;
+            this->y = xyz.y;
+            this->z = xyz.z;
+            this->w = w;
+        }
+
+        /// \brief + operator for adding another 4 component vector
+        inline const vec4_t<T> operator + (const vec4_t<T>& rh) const
+        {
+            return vec4_t<T>(this->x + rh.x, this->y + rh.y, this->z + rh.z, this->w + rh.w);
+        }
+
+        /// \brief - operator for subtracting another 4 component vector
+        inline const vec4_t<T> operator - (const vec4_t<T>& rh) const
+        {
+            return vec4_t<T>(this->x - rh.x, this->y - rh.y, this->z - rh.z, this->w - rh.w);
+        }
+
+        /// \brief * operator for multiplying with a scalar
+        inline const vec4_t<T> operator * (const T rh) const
+        {
+            return vec4_t<T>(this->x * rh, this->y * rh, this->z * rh, this->w * rh);
+        }
+
+        /// \brief computes the dot product of this and another 4 component vector
+        inline T dot(const vec4_t<T>& rh) const
+        {
+            return this->x * rh.x + this->y * rh.y + this->z * rh.z + this->w * rh.w;
+        }
+
+        /// \brief returns the first 3 components
+        inline const vec3_t<T> xyz() const
+        {
+            return vec3_t<T>(this->x, this->y, this->z);
+        }
     };
     typedef vec4_t<float> vec4;
 }
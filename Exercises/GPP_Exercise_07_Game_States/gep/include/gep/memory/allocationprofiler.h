@@ -0,0 +1,100 @@
+#pragma once
+
+#include "gep/gepmodule.h"
+#include "gep/memory/leakDetection.h"
+#include "gep/container/hashmap.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/threading/mutex.h"
+#include "gep/stackWalker.h"
+#include <ostream>
+
+namespace gep
+{
+    /// \brief Sampling heap profiler, cheap enough to run in release builds.
+    ///
+    /// Unlike the LeakDetector, only a few allocations get a callstack: every thread counts down the bytes it
+    /// allocates and takes a sample when the counter runs out, the distances between two samples are exponentially
+    /// distributed around the sample rate. An allocation of s bytes is sampled with probability 1 - exp(-s / rate),
+    /// so each sample stands for s / (1 - exp(-s / rate)) bytes, which makes the estimates unbiased for small and
+    /// large allocations alike. Allocations which are not sampled only touch thread local data, frees only take
+    /// the lock if the pointer might have been sampled.
+    ///
+    /// Identical callstacks are stored once and referred to by their id. For each of them the profiler estimates
+    /// the bytes which are still alive and the bytes allocated since it was started, both can be written in the
+    /// collapsed stack format of flamegraph.pl (one "outer;inner;leaf value" line per stack), like lua::Profiler does.
+    class GEP_API AllocationProfiler
+    {
+    public:
+        static const size_t DEFAULT_SAMPLE_RATE = 512 * 1024;
+        static const size_t MAX_FRAMES = 32;
+
+        struct StackStatistics
+        {
+            double allocatedBytes; ///< estimated bytes allocated since the profiler was started
+            double allocations; ///< estimated number of allocations since the profiler was started
+            double liveBytes; ///< estimated bytes which have not been freed yet
+            uint32 numSamples; ///< number of samples taken at this callstack
+        };
+
+        /// \param sampleRate average number of bytes allocated between two samples, 1 samples every allocation
+        explicit AllocationProfiler(size_t sampleRate = DEFAULT_SAMPLE_RATE);
+
+        /// \brief should be called for every allocation to profile
+        void trackAllocation(void* mem, size_t size);
+        /// \brief should be called for every free to profile, before the memory is handed back
+        void trackFree(void* mem);
+
+        /// \brief discards everything recorded so far and uses the given sample rate from now on
+        void reset(size_t sampleRate);
+        inline size_t getSampleRate() const { return m_sampleRate; }
+
+        /// \brief number of distinct callstacks sampled so far, the stack ids are [0, getNumStacks())
+        size_t getNumStacks();
+        StackStatistics getStackStatistics(uint32 stackId);
+        /// \brief sums the statistics of all callstacks
+        StackStatistics getTotals();
+
+        /// \brief estimated bytes still alive per callstack
+        void writeLiveBytes(std::ostream& output);
+        /// \brief estimated bytes allocated since the profiler was started per callstack
+        void writeAllocatedBytes(std::ostream& output);
+
+    private:
+        static const size_t FILTER_SIZE = 1 << 16;
+        static const size_t LINE_LENGTH = 1024;
+
+        struct Stack
+        {
+            StackWalker::address_t frames[MAX_FRAMES];
+            uint32 numFrames;
+            uint32 nextWithSameHash; ///< index of the next stack in the same bucket, or uint32(-1)
+            StackStatistics statistics;
+        };
+
+        struct Sample
+        {
+            uint32 stackId;
+            size_t size;
+            double weight;
+        };
+
+        MallocAllocator m_allocator;
+        Mutex m_mutex;
+        size_t m_sampleRate;
+        /// unique for every profiler and reset, tells the threads to draw a new distance with the current sample rate
+        volatile uint32 m_generation;
+        DynamicArray<Stack> m_stacks;
+        Hashmap<uint32, uint32, DontHashPolicy> m_stackIdsByHash;
+        Hashmap<void*, Sample, PointerHashPolicy> m_samples;
+        /// counts the sampled pointers per filter slot, frees of pointers in empty slots don't need the lock
+        /// 32 bit, a slot wrapping around to 0 would make the frees of its live samples skip the lock
+        volatile uint32 m_sampledFilter[FILTER_SIZE];
+
+        static uint32 getFilterSlot(void* mem);
+        void takeSample(void* mem, size_t size, ArrayPtr<StackWalker::address_t> frames);
+        uint32 findOrAddStack(ArrayPtr<StackWalker::address_t> frames);
+        void writeStacks(std::ostream& output, bool liveBytes);
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(AllocationProfiler);
+    };
+}
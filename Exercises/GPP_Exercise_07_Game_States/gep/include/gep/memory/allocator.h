@@ -9,6 +9,9 @@
 
 namespace gep
 {
+    //forward declarations
+    class AllocationProfiler;
+
     /// \brief generic allocator interface
     class IAllocator
     {
@@ -49,6 +52,7 @@ namespace gep
         #endif
 
         static Mutex s_creationMutex;
+        static AllocationProfiler* volatile s_pProfiler;
 
         size_t m_numAllocations;
         size_t m_numFrees;
@@ -79,6 +83,13 @@ namespace gep
         static StdAllocator& globalInstance(); //not using DoubleLockingSingelton because of cyclic dependency
         #endif
         static void destroyInstance();
+
+        /// \brief samples all allocations of the standard allocator with the given profiler, nullptr stops sampling
+        ///
+        /// Allocations which are in flight on other threads may still use the previous profiler,
+        /// so it must not be destroyed while other threads allocate.
+        static void setProfiler(AllocationProfiler* pProfiler);
+        static AllocationProfiler* getProfiler();
     };
 
     /// \brief standard allocation policy
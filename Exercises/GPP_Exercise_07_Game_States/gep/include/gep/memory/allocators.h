@@ -199,6 +199,95 @@ namespace gep
         // returns the memory reserved by the internally used dynamic arrays of both stack allocators
         size_t getDynamicArraysSize() const;
     };
+
+    /// \brief stack allocator which adds another block of memory whenever the current one is full
+    ///
+    /// Single allocations can not be freed, only everything at once with freeAll.
+    /// The blocks are kept for reuse, so once the peak size was reached no more memory is requested.
+    class GEP_API GrowingStackAllocator : public IAllocatorStatistics
+    {
+    private:
+        struct Block
+        {
+            char* pBuffer;
+            size_t size;
+        };
+
+        DynamicArray<Block> m_blocks;
+        size_t m_currentBlock;
+        char* m_pStackPtr;
+        size_t m_blockSize;
+
+        size_t m_numAllocations;
+        size_t m_numFrees;
+        size_t m_numBytesUsed;
+
+        IAllocator* m_pParentAllocator;
+
+        // not accessible
+        GrowingStackAllocator(){}
+        GrowingStackAllocator(const GrowingStackAllocator& other){}
+        GrowingStackAllocator(GrowingStackAllocator&& other){}
+
+    public:
+        // IAllocator interface
+        virtual void* allocateMemory(size_t size) override;
+        // does nothing, the memory is released with freeAll
+        virtual void freeMemory(void* mem) override;
+
+        // frees all allocations at once
+        void freeAll();
+
+        // IAllocatorStatistics Interface
+        virtual size_t getNumAllocations() const override;
+        virtual size_t getNumFrees() const override;
+        virtual size_t getNumBytesReserved() const override;
+        virtual size_t getNumBytesUsed() const override;
+        virtual IAllocatorStatistics* getParentAllocator() const override;
+
+        // allocations bigger than blockSize get a block of their own
+        GrowingStackAllocator(size_t blockSize, IAllocator* pParentAllocator = nullptr);
+        ~GrowingStackAllocator();
+    };
+
+    /// \brief counts what is allocated through it, the memory comes from another allocator
+    ///
+    /// Every allocation carries a small header with its size, so the bytes in use are exact no matter
+    /// where the memory comes from. The counters are updated atomically and can be read from any thread.
+    class GEP_API CountingAllocator : public IAllocatorStatistics
+    {
+    private:
+        /// keeps the alignment of the parent allocator
+        static const size_t HEADER_SIZE = 16;
+
+        IAllocatorStatistics* m_pParentAllocator;
+        volatile LONGLONG m_numAllocations;
+        volatile LONGLONG m_numFrees;
+        volatile LONGLONG m_numBytesUsed;
+        volatile LONGLONG m_numBytesReserved;
+        volatile LONGLONG m_peakBytesUsed;
+
+        // not accessible
+        CountingAllocator(const CountingAllocator& other){}
+
+    public:
+        CountingAllocator(IAllocatorStatistics* pParentAllocator = nullptr);
+
+        // IAllocator interface
+        virtual void* allocateMemory(size_t size) override;
+        virtual void freeMemory(void* mem) override;
+
+        // IAllocatorStatistics Interface
+        virtual size_t getNumAllocations() const override;
+        virtual size_t getNumFrees() const override;
+        /// the bytes currently taken from the parent allocator, including the headers
+        virtual size_t getNumBytesReserved() const override;
+        virtual size_t getNumBytesUsed() const override;
+        virtual IAllocatorStatistics* getParentAllocator() const override;
+
+        /// the most bytes which were in use at the same time
+        size_t getPeakNumBytesUsed() const;
+    };
 }
 
 #define ALIGNMENT AlignmentHelper::__ALIGNMENT
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "gep/modelloader.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief Prepares meshes for the gpu.
+    ///
+    /// Reorders the faces for the post transform vertex cache and for less overdraw,
+    /// reorders the vertices in the order they are first used and quantizes them
+    /// into the interleaved layout described by GpuVertexFormat.
+    class GEP_API MeshCooker
+    {
+    public:
+        /// size of the simulated FIFO cache used for measuring
+        static const uint32 MEASURE_CACHE_SIZE = 16;
+
+        struct Statistics
+        {
+            size_t numTriangles;
+            size_t uncookedVertexBytes; /// with the float layout used for uncooked meshes
+            size_t cookedVertexBytes;
+            size_t uncookedIndexBytes; /// with 32 bit indices
+            size_t cookedIndexBytes;
+            size_t cacheMissesBefore; /// with a simulated cache of MEASURE_CACHE_SIZE vertices
+            size_t cacheMissesAfter;
+
+            Statistics();
+            void add(const Statistics& other);
+
+            /// average cache miss ratio, transformed vertices per triangle
+            inline float getACMRBefore() const { return numTriangles > 0 ? (float)cacheMissesBefore / numTriangles : 0.0f; }
+            inline float getACMRAfter() const { return numTriangles > 0 ? (float)cacheMissesAfter / numTriangles : 0.0f; }
+        };
+
+        /// \brief the vertex format that keeps all data of the mesh the renderer uses
+        static uint32 getVertexFormat(const ModelLoader::MeshData& mesh);
+        /// \brief size of one interleaved vertex in bytes
+        static uint32 getVertexStride(uint32 vertexFormat);
+        /// \brief size of one vertex in the float layout used for uncooked meshes
+        static uint32 getUncookedVertexStride(uint32 vertexFormat);
+        /// \brief 2 if all vertices can be addressed with 16 bit indices, 4 otherwise
+        static uint32 getIndexSize(size_t numVertices);
+
+        /// \brief writes the interleaved vertices of the mesh
+        /// \param destination
+        ///   has to be getVertexStride(vertexFormat) * mesh.vertices.length() bytes big
+        static void encodeVertices(const ModelLoader::MeshData& mesh, uint32 vertexFormat, ArrayPtr<uint8> destination);
+        /// \param destination
+        ///   has to be faces.length() * 3 * indexSize bytes big
+        static void encodeIndices(const ArrayPtr<ModelLoader::FaceData>& faces, uint32 indexSize, ArrayPtr<uint8> destination);
+
+        /// \brief reorders the faces for the post transform vertex cache (Tom Forsyth's algorithm)
+        static void optimizeVertexCache(ArrayPtr<ModelLoader::FaceData> faces, size_t numVertices);
+        /// \brief reorders clusters of faces so that outward facing ones are drawn first
+        /// \param threshold
+        ///   how much worse the cache miss ratio of a cluster may get by splitting it
+        static void optimizeOverdraw(ArrayPtr<ModelLoader::FaceData> faces, const ArrayPtr<vec3>& vertices, float threshold = 1.05f);
+        /// \brief renumbers the vertices in the order the faces use them
+        /// \param newToOld
+        ///   receives the old index for each new vertex index
+        static void optimizeVertexFetch(ArrayPtr<ModelLoader::FaceData> faces, size_t numVertices, DynamicArray<uint32>& newToOld);
+
+        /// \brief number of vertices a FIFO cache of the given size has to transform
+        static size_t countCacheMisses(const ArrayPtr<ModelLoader::FaceData>& faces, size_t numVertices, uint32 cacheSize = MEASURE_CACHE_SIZE);
+
+        static uint32 encodeOctahedral(const vec3& normal);
+        static vec3 decodeOctahedral(uint32 encoded);
+        static uint16 floatToHalf(float value);
+        static float halfToFloat(uint16 value);
+    };
+
+    /// \brief An optimized copy of a mesh together with its gpu data.
+    ///  The returned data stays valid as long as the CookedMesh exists.
+    class GEP_API CookedMesh
+    {
+    private:
+        DynamicArray<vec3> m_vertices;
+        DynamicArray<vec3> m_normals;
+        DynamicArray<vec3> m_tangents;
+        DynamicArray<vec3> m_bitangents;
+        DynamicArray<vec2> m_texcoords[4];
+        DynamicArray<ModelLoader::BoneInfo> m_boneInfos;
+        DynamicArray<ModelLoader::FaceData> m_faces;
+        DynamicArray<uint8> m_gpuVertices;
+        DynamicArray<uint8> m_gpuIndices;
+        ModelLoader::MeshData m_meshData;
+        ModelLoader::GpuMeshData m_gpuMeshData;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(CookedMesh);
+
+    public:
+        /// \param pStatistics
+        ///   optional, the statistics of this mesh are added to it
+        CookedMesh(const ModelLoader::MeshData& source, MeshCooker::Statistics* pStatistics = nullptr);
+
+        inline const ModelLoader::MeshData& getMeshData() const { return m_meshData; }
+        inline const ModelLoader::GpuMeshData& getGpuMeshData() const { return m_gpuMeshData; }
+    };
+}
@@ -35,7 +35,9 @@ namespace gep
         enum Enum {
             Version1 = 1, //Initial version
             Version2 = 2, //saving material names
-            Version3 = 3  //Bones, baby!
+            Version3 = 3, //Bones, baby!
+            Version4 = 4, //Precomputed memory layout, uncompressed streams for bulk reading
+            Version5 = 5  //Cooked interleaved vertices and indices that can be copied to the gpu as they are
         };
     };
 
@@ -53,7 +55,57 @@ namespace gep
         };
     };
 
-    class ModelLoader
+    /// \brief Layout of the interleaved vertices in ModelLoader::GpuMeshData.
+    ///  The channels are stored in the order of the flags.
+    struct GpuVertexFormat
+    {
+        enum Enum {
+            Position  = 0x0001, // 3 floats
+            Normal    = 0x0002, // octahedral encoded, 2 x snorm16
+            Tangent   = 0x0004, // octahedral encoded, 2 x snorm16
+            Bitangent = 0x0008, // octahedral encoded, 2 x snorm16
+            TexCoord0 = 0x0010, // 2 x half float
+            Bones     = 0x0020  // 4 x uint16 bone indices, 4 x unorm8 weights
+        };
+    };
+
+    class Chunkfile;
+
+    /// \brief Header of one mesh in a Version4 thModel file.
+    ///  All meshes are stored in the 'layout' chunk, their streams in the 'streams' chunk.
+    struct ModelMeshLayout
+    {
+        struct Stream
+        {
+            enum Enum {
+                Vertices,   // vec3 per vertex
+                Normals,    // vec3 per vertex
+                Tangents,   // vec3 per vertex
+                Bitangents, // vec3 per vertex
+                TexCoords0, // vec2 per vertex
+                TexCoords1,
+                TexCoords2,
+                TexCoords3,
+                BoneInfos,  // ModelLoader::BoneInfo per vertex
+                Faces,      // ModelLoader::FaceData per face
+
+                Count
+            };
+        };
+
+        static const uint32 NOT_PRESENT = 0xFFFFFFFF;
+
+        uint32 materialIndex;
+        float minBounds[3];
+        float maxBounds[3];
+        uint32 numVertices;
+        uint32 numFaces;
+        uint32 numBones;
+        /// offset of each stream relative to the start of the 'streams' chunk data or NOT_PRESENT
+        uint32 streamOffsets[Stream::Count];
+    };
+
+    class GEP_API ModelLoader
     {
     public:
         struct Load
@@ -70,6 +122,7 @@ namespace gep
                 TexCoords3 = 0x0100,
                 Nodes      = 0x0200,
                 Bones      = 0x0400,
+                GpuMeshes  = 0x0800,
                 Everything = 0xFFFF
             };
         };
@@ -122,6 +175,18 @@ namespace gep
             ArrayPtr<BoneInfo> boneInfos;
         };
 
+        /// \brief vertices and indices of a mesh as they are uploaded to the gpu
+        struct GpuMeshData
+        {
+            uint32 vertexFormat; /// combination of GpuVertexFormat::Enum values
+            uint32 vertexStride; /// in bytes
+            uint32 indexSize; /// 2 or 4 bytes
+            uint32 numVertices;
+            uint32 numIndices;
+            ArrayPtr<uint8> vertices;
+            ArrayPtr<uint8> indices;
+        };
+
         struct NodeData;
 
         struct NodeDrawData
@@ -144,6 +209,7 @@ namespace gep
             ArrayPtr<const char*> textures;
             ArrayPtr<MaterialData> materials;
             ArrayPtr<MeshData> meshes;
+            ArrayPtr<GpuMeshData> gpuMeshes; /// one per mesh, only present in Version5 files
             NodeDrawData* rootNode;
             bool hasData;
 
@@ -158,6 +224,26 @@ namespace gep
         ModelData m_modelData;
         std::string m_filename;
 
+        /// \brief the loading path for files up to Version3, which computes the memory size in a separate pass
+        void loadVersion3(Chunkfile& file, uint32 loadWhat);
+        /// \brief the single pass loading path for Version4 and Version5 files
+        void loadVersion4(Chunkfile& file, uint32 loadWhat);
+
+        /// \brief allocates from the mesh data allocator and throws if the size from the layout was to small
+        template <typename T>
+        ArrayPtr<T> allocateArray(size_t num)
+        {
+            if(num == 0)
+                return ArrayPtr<T>();
+            auto pMemory = static_cast<T*>(m_pMeshDataAllocator->allocateMemory(sizeof(T) * num));
+            if(pMemory == nullptr)
+                throwLayoutTooSmall();
+            ArrayPtr<T> result(pMemory, num);
+            MemoryUtils::uninitializedConstruct(result.getPtr(), result.length());
+            return result;
+        }
+        void throwLayoutTooSmall();
+
         template <typename T>
         uint32 allocationSize(uint32 num)
         {
@@ -236,6 +322,10 @@ namespace gep
         /// \param loadWhat
         ///   which data should be loaded. Combination of Load::Enum values
         void loadFile(const char* pFilename, uint32 loadWhat);
+        /// \brief loads a model from a file that is already in memory
+        /// \param pFilename
+        ///   only used for error messages
+        void loadFromMemory(const char* pFilename, ArrayPtr<uint8> fileData, uint32 loadWhat);
         void loadFromData(SmartPtr<ReferenceCounted> pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices);
     };
 }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gep/modelloader.h"
+#include "gep/meshcooker.h"
+
+namespace gep
+{
+    /// \brief Writes model data in the thModel format.
+    ///
+    /// Used to upgrade existing files to the single pass Version4 layout,
+    /// to cook them into gpu ready Version5 files and to create models from generated data.
+    class GEP_API ModelWriter
+    {
+    public:
+        /// \param version
+        ///   Version3, Version4 or Version5. Version5 needs gpu data for every mesh.
+        static void write(const ModelLoader::ModelData& data, const char* pFilename,
+                          ModelFormatVersion::Enum version = ModelFormatVersion::Version4);
+
+        /// \brief optimizes and quantizes all meshes with the MeshCooker and writes a Version5 file
+        /// \param pStatistics
+        ///   optional, receives the savings of all meshes
+        static void cook(const ModelLoader::ModelData& data, const char* pFilename, MeshCooker::Statistics* pStatistics = nullptr);
+
+        /// \brief the exact number of bytes the Version4 loader allocates for the given data
+        static uint32 computeMeshDataSize(const ModelLoader::ModelData& data,
+                                          ModelFormatVersion::Enum version = ModelFormatVersion::Version4);
+    };
+}
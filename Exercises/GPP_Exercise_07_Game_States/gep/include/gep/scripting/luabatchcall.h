@@ -0,0 +1,51 @@
+#pragma once
+
+#include "gep/scripting/luaHelper.h"
+
+namespace lua
+{
+    /// \brief Calls one script function for a whole array of arguments with a single transition into Lua.
+    ///
+    /// The arguments are stored in a Lua array that is kept alive between calls,
+    /// so they only have to be pushed again when the set of arguments changes.
+    /// A small dispatcher written in Lua iterates the array and calls
+    /// \c func(argument, elapsedTime) for every entry.
+    class GEP_API BatchCall
+    {
+    public:
+        explicit BatchCall(lua_State* L);
+        ~BatchCall();
+
+        void setFunction(FunctionWrapper func);
+        inline FunctionWrapper& getFunction() { return m_function; }
+
+        /// \brief Removes all arguments.
+        void clear();
+
+        template<typename T>
+        void append(T argument)
+        {
+            utils::StackCleaner cleaner(m_L, 0);
+            pushArguments();
+            push<T>(m_L, argument);
+            lua_rawseti(m_L, -2, ++m_numArguments);
+        }
+
+        inline int getNumArguments() const { return m_numArguments; }
+
+        /// \brief Calls the function once for every argument.
+        /// \remarks May throw a ScriptExecutionException, just like IScriptingManager::callFunction.
+        void call(float elapsedTime);
+
+    private:
+        lua_State* m_L;
+        FunctionWrapper m_function;
+        int m_argumentsReference;
+        int m_numArguments;
+
+        void pushArguments();
+        void pushDispatcher();
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(BatchCall);
+    };
+}
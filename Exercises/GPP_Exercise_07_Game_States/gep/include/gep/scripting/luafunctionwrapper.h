@@ -13,7 +13,8 @@ namespace lua
 
         inline explicit FunctionWrapper(lua_State* L = nullptr, int index = 0) :
             m_L(L),
-            m_tableReference(s_invalidReference)
+            m_tableReference(s_invalidReference),
+            m_functionReference(s_invalidReference)
         {
             if(index == 0) return;
 
@@ -31,7 +32,8 @@ namespace lua
 
         inline FunctionWrapper(const FunctionWrapper& other) :
             m_L(other.m_L),
-            m_tableReference(other.m_tableReference)
+            m_tableReference(other.m_tableReference),
+            m_functionReference(other.m_functionReference)
         {
             if (isValid())
             {
@@ -47,6 +49,7 @@ namespace lua
             }
             std::swap(m_L, rhs.m_L);
             std::swap(m_tableReference, rhs.m_tableReference);
+            std::swap(m_functionReference, rhs.m_functionReference);
         }
 
         inline ~FunctionWrapper()
@@ -55,11 +58,17 @@ namespace lua
             {
                 removeReference();
                 m_tableReference = s_invalidReference;
+                m_functionReference = s_invalidReference;
             }
         }
 
+        /// \brief Pushes the referenced function on the stack with a single registry lookup.
         void push();
 
+        /// \brief Identifies the referenced function itself.
+        /// Wrappers created from the same Lua function return the same value.
+        const void* getFunctionPointer();
+
         inline bool isValid() { return m_tableReference != s_invalidReference; }
 
     private:
@@ -71,6 +80,9 @@ namespace lua
         // A reference to a helper table, containing a ref count and the actual function
         int m_tableReference;
 
+        // A direct reference to the function, so pushing it does not need to go through the helper table
+        int m_functionReference;
+
         void addReference();
         void removeReference();
 
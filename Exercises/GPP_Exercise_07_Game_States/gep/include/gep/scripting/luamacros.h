@@ -5,14 +5,16 @@
     template <typename __T>                                                                 \
     static void Lua_Bind(lua_State* L, const char* className)                               \
     {                                                                                       \
-        static bool alreadyBound(false);                                                    \
-        if (alreadyBound) { return; }                                                       \
-        alreadyBound = true;                                                                \
         lua::utils::StackChecker checker(L, 0);                                             \
         /* remember the className */                                                        \
         gep::ScriptTypeInfo<__T>::instance().setClassName(className);                       \
-        /* create new metatable and store it in the registry */                             \
-        luaL_newmetatable(L, gep::ScriptTypeInfo<__T>::instance().getMetaTableName());      \
+        /* create new metatable and store it in the registry. */                            \
+        /* Bind only once per Lua state, there can be more than one. */                     \
+        if (!luaL_newmetatable(L, gep::ScriptTypeInfo<__T>::instance().getMetaTableName())) \
+        {                                                                                   \
+            lua_pop(L, 1);                                                                  \
+            return;                                                                         \
+        }                                                                                   \
                                                                                             \
         /* TODO inheritance */                                                              \
         /* Class_Sub -> setmetatable(Class_Sub_Meta, Class_Meta) */                         \
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gep/timer.h"
+#include "gep/container/hashmap.h"
+#include "gep/container/DynamicArray.h"
+#include <ostream>
+
+namespace lua
+{
+    /// \brief Sampling profiler for a Lua state, based on debug hooks.
+    ///
+    /// While running, a count hook takes a sample of the Lua call stack every
+    /// \c sampleInterval VM instructions. Optionally, call and return hooks measure
+    /// the time spent in C functions, which includes all functions bound with lua::bind.
+    /// Both are aggregated per call stack and can be written in the collapsed stack
+    /// format of flamegraph.pl (one "outer;inner;leaf value" line per stack).
+    ///
+    /// No hooks are installed while the profiler is stopped, so it costs nothing then.
+    class GEP_API Profiler
+    {
+    public:
+        explicit Profiler(lua_State* L);
+        ~Profiler();
+
+        /// \param sampleInterval Number of VM instructions between two samples.
+        /// \param measureCFunctions Also measure the time spent in C functions. This is a lot more expensive.
+        void start(int sampleInterval = 1000, bool measureCFunctions = true);
+        void stop();
+        inline bool isRunning() const { return m_isRunning; }
+
+        /// \brief Discards everything recorded so far.
+        void reset();
+
+        /// \brief Number of samples per call stack.
+        void writeSamples(std::ostream& output);
+        /// \brief Microseconds spent in C functions per call stack.
+        void writeCFunctionTimes(std::ostream& output);
+
+    private:
+        struct CallRecord
+        {
+            const void* function;
+            gep::uint64 startTime;
+        };
+
+        lua_State* m_L;
+        bool m_isRunning;
+        gep::Timer m_timer;
+        gep::Hashmap<std::string, gep::uint32, gep::StringHashPolicy> m_samples;
+        gep::Hashmap<std::string, gep::uint64, gep::StringHashPolicy> m_cFunctionTicks;
+        gep::DynamicArray<CallRecord> m_cFunctionCalls;
+
+        static void hook(lua_State* L, lua_Debug* ar);
+        static Profiler* getInstance(lua_State* L);
+
+        void onSample();
+        void onCall(lua_Debug* ar);
+        void onReturn(lua_Debug* ar);
+
+        /// \brief Builds "outer;inner;leaf" starting at the given stack level.
+        std::string collapseStack(int startLevel);
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(Profiler);
+    };
+}
@@ -75,6 +75,13 @@ namespace lua
             return true;
         }
 
+        /// \brief the length of the array part, like the # operator without metamethods
+        size_t length();
+        /// \brief reads the array entries 1 to out_values.length() in one go, entries which aren't numbers are 0
+        void getNumbers(gep::ArrayPtr<float> out_values);
+        /// \brief writes the values to the array entries 1 to values.length() in one go
+        void setNumbers(gep::ArrayPtr<const float> values);
+
     private:
         static const char* refCountIndex() { return "__refCount"; }
 
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "gep/scripting/luaHelper.h"
+#include "gep/container/DynamicArray.h"
+#include <functional>
+
+namespace gep
+{
+    class IAllocator;
+    class TaskQueue;
+
+    /// \brief A message between a script running in a ScriptStatePool and the game thread.
+    struct ScriptMessage
+    {
+        std::string objectName;
+        std::string name;
+        std::string data;
+    };
+
+    /// \brief Runs scripts in several isolated Lua states in parallel.
+    ///
+    /// Every scripted object is assigned to exactly one of the states.
+    /// During update() each state is processed by a single task,
+    /// so a Lua state is never used by two threads at the same time.
+    ///
+    /// The states only run in parallel to each other, not to the game thread.
+    /// Only types are bound into the states, no instances, so the scripts can not reach the engine singletons.
+    /// Instead they call postMessage(objectName, name, data), and the game thread
+    /// handles those messages in dispatchMessages() after the update.
+    /// Messages sent to a script are delivered to the global function
+    /// onMessage(objectName, name, data) of the state that owns the object.
+    class GEP_API ScriptStatePool
+    {
+    public:
+        typedef std::function<void(const ScriptMessage&)> MessageHandler;
+
+        /// \param pAllocator Used by all states. Uses g_stdAllocator if nullptr.
+        ScriptStatePool(size_t numStates, IAllocator* pAllocator = nullptr);
+        ~ScriptStatePool();
+
+        inline size_t getNumStates() const { return m_shards.length(); }
+        lua_State* getState(size_t index);
+
+        /// \brief Binds a type in every state.
+        template <typename T>
+        void bind(const char* className)
+        {
+            for (size_t i = 0; i < getNumStates(); ++i)
+            {
+                auto L = getState(i);
+                lua::utils::StackChecker check(L, 0);
+                T::Lua_Bind<T>(L, className);
+            }
+        }
+
+        /// \brief Loads and executes a script in every state.
+        /// \remarks May throw a ScriptException (ScriptLoadException, ScriptExecutionException)
+        void loadScript(const std::string& filename);
+
+        /// \brief Executes a piece of Lua code in every state.
+        /// \remarks May throw a ScriptException (ScriptLoadException, ScriptExecutionException)
+        void executeString(const char* source);
+
+        /// \brief Assigns an object to the state with the fewest objects.
+        /// \param updateFunction Name of a global function that is called as updateFunction(objectName, elapsedTime).
+        void addObject(const std::string& objectName, const std::string& updateFunction);
+        void removeObject(const std::string& objectName);
+
+        /// \brief Queues a message for the state that owns the object. It is delivered at the beginning of the next update.
+        void sendMessage(const ScriptMessage& message);
+
+        /// \brief Updates all states in parallel and blocks until all of them are done.
+        /// \remarks Throws a ScriptExecutionException if any of the scripts failed.
+        void update(TaskQueue& taskQueue, float elapsedMS);
+
+        /// \brief Calls the handler for every message the scripts posted during the last update.
+        void dispatchMessages(const MessageHandler& handler);
+
+    private:
+        struct Shard;
+
+        IAllocator* m_pAllocator;
+        DynamicArray<Shard*> m_shards;
+
+        Shard* findShard(const std::string& objectName);
+        void executeInAllStates(const char* chunkName, std::function<int(lua_State*)> load);
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(ScriptStatePool);
+    };
+}
@@ -12,10 +12,57 @@ namespace gep
         {
             ivec2 screenResolution;
             bool vsyncEnabled;
+            /// run without window and GPU, the render commands are only checked and counted
+            bool headless;
+            /// headless runs stop after this many frames, 0 to run until stopped
+            uint32 headlessFrames;
+            /// megabytes of mipmaps the streamed textures may use, 0 to load all mipmaps right away
+            uint32 textureBudget;
 
             Video() :
                 screenResolution(1280, 720),
-                vsyncEnabled(true)
+                vsyncEnabled(true),
+                headless(false),
+                headlessFrames(0),
+                textureBudget(256)
+            {
+            }
+        };
+
+        struct Resources
+        {
+            uint32 numLoaderThreads;
+            /// packed archive to mount, empty to only use loose files
+            std::string archive;
+            /// loose files in data/ shadow the archive, so they can be edited and reloaded
+            bool looseFilesFirst;
+
+            Resources() :
+                numLoaderThreads(4),
+                archive(),
+                looseFilesFirst(true)
+            {
+            }
+        };
+
+        struct Physics
+        {
+            /// simulate with the native physics instead of havok
+            bool useNativeBackend;
+
+            Physics() :
+                useNativeBackend(false)
+            {
+            }
+        };
+
+        struct Scripting
+        {
+            /// Lua states for the scripts added with Scripting:addPooledObject, 0 to turn the pool off
+            uint32 numPooledStates;
+
+            Scripting() :
+                numPooledStates(0)
             {
             }
         };
@@ -32,6 +79,18 @@ namespace gep
         virtual       settings::Video& getVideoSettings()       = 0;
         virtual const settings::Video& getVideoSettings() const = 0;
 
+        virtual void setResourceSettings(const settings::Resources& settings) = 0;
+        virtual       settings::Resources& getResourceSettings()       = 0;
+        virtual const settings::Resources& getResourceSettings() const = 0;
+
+        virtual void setPhysicsSettings(const settings::Physics& settings) = 0;
+        virtual       settings::Physics& getPhysicsSettings()       = 0;
+        virtual const settings::Physics& getPhysicsSettings() const = 0;
+
+        virtual void setScriptingSettings(const settings::Scripting& settings) = 0;
+        virtual       settings::Scripting& getScriptingSettings()       = 0;
+        virtual const settings::Scripting& getScriptingSettings() const = 0;
+
         virtual void loadFromScriptTable(ScriptTableWrapper table) = 0;
 
         LUA_BIND_REFERENCE_TYPE_BEGIN
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "gep/gepmodule.h"
+#include "gep/ArrayPtr.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/container/hashmap.h"
+#include "gep/math3d/vec3.h"
+
+namespace gep
+{
+    /// \brief Loose grid of boxes for proximity queries, e.g. of the game objects.
+    ///
+    /// A proxy is stored in the cell its center is in. Every box reaches at most half a cell over its
+    /// cell, so a query only has to look at the cells overlapping the query box grown by half a cell.
+    /// Larger boxes are kept in a separate list which every query tests.
+    /// Only the occupied cells exist, they are found through a hash map of their coordinates.
+    /// The proxies of a cell form a linked list through the proxy array, proxies and cells are referred
+    /// to by their index and freed ones are reused, so moving a proxy doesn't allocate.
+    /// Only depends on the math types, so it can be used and tested on its own.
+    class GEP_API SpatialGrid
+    {
+    public:
+        static const uint32 INVALID_PROXY = 0xFFFFFFFF;
+
+        SpatialGrid(float cellSize, IAllocator* pAllocator = nullptr);
+
+        /// \brief adds a proxy for a box
+        /// \return the proxy id, stays valid until the proxy is removed
+        uint32 insert(const vec3& min, const vec3& max, void* pUserData);
+        void remove(uint32 proxy);
+        /// \brief moves a proxy, only relinks it if its center moved into another cell
+        void update(uint32 proxy, const vec3& min, const vec3& max);
+        /// \brief removes all proxies
+        void clear();
+
+        /// \brief changes the size of the cells and relinks all proxies
+        void setCellSize(float cellSize);
+        inline float getCellSize() const { return m_cellSize; }
+
+        inline void* getUserData(uint32 proxy) const { return m_proxies[proxy].pUserData; }
+        inline const vec3& getMin(uint32 proxy) const { return m_proxies[proxy].min; }
+        inline const vec3& getMax(uint32 proxy) const { return m_proxies[proxy].max; }
+        inline size_t getNumProxies() const { return m_numProxies; }
+        /// \brief number of cells with proxies in them
+        inline size_t getNumCells() const { return m_cellIndices.count(); }
+
+        /// \brief calls callback(proxy) for every box overlapping the given box
+        ///
+        /// The query stops as soon as the callback returns false.
+        template <typename Callback>
+        void queryAabb(const vec3& min, const vec3& max, Callback& callback) const
+        {
+            auto test = [&](uint32 proxy) -> bool
+            {
+                const Proxy& entry = m_proxies[proxy];
+                if(!overlaps(entry.min, entry.max, min, max))
+                    return true;
+                return callback(proxy);
+            };
+            visitCandidates(min, max, test);
+        }
+
+        /// \brief calls callback(proxy) for every box overlapping the given sphere
+        ///
+        /// The query stops as soon as the callback returns false.
+        template <typename Callback>
+        void queryRadius(const vec3& center, float radius, Callback& callback) const
+        {
+            const float radiusSquared = radius * radius;
+            auto test = [&](uint32 proxy) -> bool
+            {
+                const Proxy& entry = m_proxies[proxy];
+                if(squaredDistance(entry.min, entry.max, center) > radiusSquared)
+                    return true;
+                return callback(proxy);
+            };
+            visitCandidates(center - vec3(radius), center + vec3(radius), test);
+        }
+
+        /// \brief finds the proxies closest to a position, measured to their boxes
+        /// \param proxies
+        ///   receives the closest proxies, the closest one first. Its length is the number of proxies to find.
+        /// \return the number of proxies written, less than requested if there are not enough proxies
+        uint32 queryNearest(const vec3& position, ArrayPtr<uint32> proxies) const;
+
+    private:
+        /// \brief the hash map key of a cell
+        struct CellKey
+        {
+            int32 x, y, z;
+
+            inline bool operator == (const CellKey& rh) const { return x == rh.x && y == rh.y && z == rh.z; }
+            inline unsigned int hash() const
+            {
+                return unsigned(x) * 73856093u ^ unsigned(y) * 19349663u ^ unsigned(z) * 83492791u;
+            }
+        };
+
+        struct Proxy
+        {
+            vec3 min;
+            vec3 max;
+            void* pUserData;
+            /// INVALID_PROXY while the proxy is free
+            uint32 cell;
+            /// the next and previous proxy in the cell, the next free proxy for free proxies
+            uint32 next;
+            uint32 prev;
+        };
+
+        struct Cell
+        {
+            CellKey key;
+            uint32 first;
+            uint32 count;
+        };
+
+        /// the cell of the proxies which are too large for the grid, it is not in the hash map
+        static const uint32 LARGE_CELL = 0;
+
+        IAllocator* m_pAllocator;
+        float m_cellSize;
+        float m_inverseCellSize;
+        DynamicArray<Proxy> m_proxies;
+        uint32 m_freeProxy;
+        size_t m_numProxies;
+        DynamicArray<Cell> m_cells;
+        /// free cells are empty and keep the index of the next free cell in first
+        uint32 m_freeCell;
+        Hashmap<CellKey, uint32, HashMethodPolicy> m_cellIndices;
+
+        CellKey computeKey(const vec3& position) const;
+        /// \brief the cell a box belongs to, created if it doesn't exist yet
+        uint32 findCell(const vec3& min, const vec3& max);
+        void link(uint32 proxy, uint32 cell);
+        void unlink(uint32 proxy);
+
+        static inline bool overlaps(const vec3& minA, const vec3& maxA, const vec3& minB, const vec3& maxB)
+        {
+            return minA.x <= maxB.x && minB.x <= maxA.x &&
+                   minA.y <= maxB.y && minB.y <= maxA.y &&
+                   minA.z <= maxB.z && minB.z <= maxA.z;
+        }
+
+        static inline float squaredDistance(const vec3& min, const vec3& max, const vec3& point)
+        {
+            float result = 0.0f;
+            for(int i = 0; i < 3; i++)
+            {
+                const float d = point.data[i] < min.data[i] ? min.data[i] - point.data[i] :
+                                point.data[i] > max.data[i] ? point.data[i] - max.data[i] : 0.0f;
+                result += d * d;
+            }
+            return result;
+        }
+
+        /// \brief calls test(proxy) for the proxies of all cells which can hold boxes overlapping the given one
+        template <typename Test>
+        void visitCandidates(const vec3& min, const vec3& max, Test& test) const
+        {
+            if(!visitCell(LARGE_CELL, test))
+                return;
+
+            const float looseness = m_cellSize * 0.5f;
+            const CellKey first = computeKey(min - vec3(looseness));
+            const CellKey last = computeKey(max + vec3(looseness));
+            const uint64 numCells = uint64(last.x - first.x + 1) * uint64(last.y - first.y + 1) * uint64(last.z - first.z + 1);
+            if(numCells > m_cellIndices.count())
+            {
+                // large queries walk the occupied cells instead of looking up every cell in the range
+                for(uint32 cell = LARGE_CELL + 1; cell < m_cells.length(); cell++)
+                {
+                    const CellKey& key = m_cells[cell].key;
+                    if(m_cells[cell].count == 0 ||
+                       key.x < first.x || key.x > last.x || key.y < first.y || key.y > last.y || key.z < first.z || key.z > last.z)
+                        continue;
+                    if(!visitCell(cell, test))
+                        return;
+                }
+                return;
+            }
+
+            CellKey key;
+            for(key.x = first.x; key.x <= last.x; key.x++)
+            for(key.y = first.y; key.y <= last.y; key.y++)
+            for(key.z = first.z; key.z <= last.z; key.z++)
+            {
+                uint32 cell;
+                if(m_cellIndices.tryGet(key, cell) == SUCCESS && !visitCell(cell, test))
+                    return;
+            }
+        }
+
+        template <typename Test>
+        bool visitCell(uint32 cell, Test& test) const
+        {
+            for(uint32 proxy = m_cells[cell].first; proxy != INVALID_PROXY; proxy = m_proxies[proxy].next)
+            {
+                if(!test(proxy))
+                    return false;
+            }
+            return true;
+        }
+    };
+}
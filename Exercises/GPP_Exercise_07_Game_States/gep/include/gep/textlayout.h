@@ -0,0 +1,102 @@
+#pragma once
+
+#include "gep/types.h"
+#include "gep/ArrayPtr.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/container/hashmap.h"
+
+namespace gep
+{
+    enum class FontHorizontalOrientation
+    {
+        Left,
+        Centered
+    };
+
+    /// \brief what the text layout needs to know about a glyph, in pixels
+    struct TextGlyph
+    {
+        float left;    ///< space in front of the quad
+        float top;     ///< distance of the quad from the top of the line
+        float width, height;
+        float advance; ///< space after the quad
+        float minTexX, maxTexX;
+        float minTexY, maxTexY;
+        uint32 shelf;  ///< shelf of the glyph atlas the glyph is in
+    };
+
+    /// \brief provides the glyphs for the text layout, e.g. a font which renders them into a glyph atlas when they are first used
+    class ITextGlyphSource
+    {
+    public:
+        virtual ~ITextGlyphSource() {}
+
+        /// \brief the glyph of a unicode code point, nullptr if it can not be drawn right now
+        ///
+        /// The result only has to stay valid until the next call.
+        virtual const TextGlyph* getGlyph(uint32 codepoint) = 0;
+
+        virtual float getLineHeight() const = 0;
+
+        /// \brief changes whenever texture coordinates which were handed out before become invalid
+        virtual uint32 getGlyphGeneration() const = 0;
+
+        /// \brief tells the source that the glyphs in these atlas shelves are used again, see GlyphAtlas::markShelvesUsed
+        virtual void markShelvesUsed(uint64 shelfMask) = 0;
+    };
+
+    /// \brief caches the quads of laid out texts, so that texts which do not change are only looked up
+    ///
+    /// A text is laid out again when the glyph source evicted glyphs since the layout was made, because the texture
+    /// coordinates in the cached quads may point to other glyphs now. Layouts which have not been used for a few frames are dropped.
+    class GEP_API TextLayoutCache
+    {
+    public:
+        /// \brief layouts which were not used for this many frames are dropped
+        static const uint32 MAX_UNUSED_FRAMES = 30;
+        /// \brief floats per quad: 4 vertices with a 2 component position and a 2 component texture coordinate
+        static const uint32 FLOATS_PER_QUAD = 16;
+
+        struct Layout
+        {
+            std::string text;
+            FontHorizontalOrientation orientation;
+            uint32 generation;
+            uint32 lastUsedFrame;
+            uint64 shelfMask;
+            float width;
+            DynamicArray<float> quads; ///< positions relative to the top left corner of the text
+        };
+
+        TextLayoutCache();
+        ~TextLayoutCache();
+
+        /// \brief the quads of a text, only laid out if the text is not cached yet
+        ///
+        /// The reference is valid until the next call.
+        const Layout& getLayout(ITextGlyphSource& source, const char* text, FontHorizontalOrientation orientation);
+
+        /// \brief starts a new frame and drops the layouts which have not been used for MAX_UNUSED_FRAMES
+        void nextFrame();
+
+        /// \brief drops all layouts
+        void clear();
+
+        inline size_t getNumLayouts() const { return m_layouts.count(); }
+        inline uint32 getNumHits() const { return m_numHits; }
+        inline uint32 getNumMisses() const { return m_numMisses; }
+
+        /// \brief lays out a text without caching it
+        static void layout(ITextGlyphSource& source, const char* text, FontHorizontalOrientation orientation, Layout& result);
+
+        /// \brief decodes the next code point of a UTF-8 string and moves past it, invalid sequences become U+FFFD
+        static uint32 decodeUtf8(const char*& text);
+
+    private:
+        Hashmap<uint32, Layout*, DontHashPolicy> m_layouts;
+        DynamicArray<Layout*> m_freeLayouts; ///< dropped layouts, reused so that their memory does not have to be allocated again
+        uint32 m_frame;
+        uint32 m_numHits;
+        uint32 m_numMisses;
+    };
+}
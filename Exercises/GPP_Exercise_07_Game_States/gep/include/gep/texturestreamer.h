@@ -0,0 +1,125 @@
+#pragma once
+
+#include "gep/types.h"
+#include "gep/container/DynamicArray.h"
+
+namespace gep
+{
+    /// \brief decides which mipmaps of streamed textures should be in memory
+    ///
+    /// Every texture always keeps its smallest mipmaps (up to MIN_RESIDENT_SIZE pixels) resident. The larger ones are
+    /// requested when the texture covers enough pixels on screen, the texture which gains the most detail first.
+    /// All resident mipmaps together have to fit into a budget. To make room the larger mipmaps of textures which
+    /// have not been visible for a while are evicted first, then the ones of visible textures which are larger than needed
+    /// and finally the ones of textures which were visible recently, the least recently used first.
+    /// Visible textures are never reduced below the mipmap they need.
+    /// Only does the bookkeeping, loading and evicting the data is up to the caller. Does not depend on the renderer
+    /// so it can be tested without one. Not thread safe.
+    class GEP_API TextureStreamer
+    {
+    public:
+        static const uint32 INVALID_ID = 0xFFFFFFFF;
+        /// mipmaps which are at most this large are always resident
+        static const uint32 MIN_RESIDENT_SIZE = 64;
+        /// textures which were not used for this many frames only keep their always resident mipmaps
+        static const uint32 MAX_UNUSED_FRAMES = 120;
+        /// at most this many loads are in flight at the same time
+        static const uint32 MAX_PENDING_LOADS = 4;
+
+        struct Request
+        {
+            uint32 id;
+            uint32 firstMip; ///< the largest mipmap which should be resident after the request
+            float priority;
+        };
+
+        TextureStreamer(size_t budget);
+
+        /// \brief registers a texture
+        /// \param bytesPerBlock
+        ///   size of a 4x4 block of the texture format
+        /// \param firstResidentMip
+        ///   the largest mipmap which is in memory right now
+        uint32 addTexture(uint32 width, uint32 height, uint32 numMips, uint32 bytesPerBlock, uint32 firstResidentMip);
+
+        /// \brief unregisters a texture, a pending load of it is forgotten
+        void removeTexture(uint32 id);
+
+        /// \brief reports that a texture is drawn in this frame
+        /// \param screenSize
+        ///   how many pixels the texture covers along its larger side
+        void addUsage(uint32 id, float screenSize);
+
+        /// \brief ends the frame and decides what to load and what to evict
+        ///
+        /// The evictions are already accounted for when this returns and have to be done by the caller right away.
+        /// Loads are pending until they are finished by the caller with finishLoad.
+        void update(DynamicArray<Request>& loads, DynamicArray<Request>& evictions);
+
+        /// \brief a load requested by update is done
+        /// \param firstMip
+        ///   the largest mipmap which is resident now. If this is not the requested one
+        ///   the larger mipmaps are treated as not loadable and are not requested again.
+        void finishLoad(uint32 id, uint32 firstMip);
+
+        inline size_t getResidentBytes() const { return m_residentBytes; }
+        inline size_t getPendingBytes() const { return m_pendingBytes; }
+        inline size_t getBudget() const { return m_budget; }
+
+        /// \brief changes the budget, a smaller budget evicts mipmaps in the next update
+        inline void setBudget(size_t budget) { m_budget = budget; }
+
+        inline uint32 getFirstResidentMip(uint32 id) const { return m_textures[id].firstResidentMip; }
+        inline uint32 getWantedMip(uint32 id) const { return m_textures[id].wantedMip; }
+        inline bool isLoadPending(uint32 id) const { return m_textures[id].pendingMip != INVALID_ID; }
+        inline uint32 getNumTextures() const { return m_numTextures; }
+
+        /// \brief the largest mipmap which is not larger than MIN_RESIDENT_SIZE
+        static uint32 getMinResidentMip(uint32 width, uint32 height, uint32 numMips);
+
+        /// \brief bytes of a single mipmap of a block compressed texture
+        static size_t getMipSize(uint32 width, uint32 height, uint32 bytesPerBlock, uint32 mip);
+
+        /// \brief bytes of all mipmaps starting at firstMip
+        static size_t getSize(uint32 width, uint32 height, uint32 numMips, uint32 bytesPerBlock, uint32 firstMip);
+
+        /// \brief the smallest mipmap which still has at least as many pixels as the texture covers on screen
+        static uint32 getMipForScreenSize(uint32 width, uint32 height, uint32 numMips, float screenSize);
+
+    private:
+        struct Texture
+        {
+            uint32 width, height;
+            uint32 numMips;
+            uint32 bytesPerBlock;
+            uint32 minResidentMip;   ///< never evicted
+            uint32 firstResidentMip;
+            uint32 firstLoadableMip; ///< the larger mipmaps failed to load
+            uint32 pendingMip;       ///< INVALID_ID if no load is pending
+            uint32 wantedMip;
+            uint32 lastUsedFrame;
+            float screenSize;        ///< the largest size reported in the current frame
+            bool isUsed;             ///< false if the id is free
+        };
+
+        DynamicArray<Texture> m_textures;
+        DynamicArray<uint32> m_freeIds;
+        DynamicArray<Request> m_loadCandidates;
+        DynamicArray<Request> m_evictionCandidates;
+        uint32 m_numTextures;
+        uint32 m_numPendingLoads;
+        uint32 m_frame;
+        size_t m_budget;
+        size_t m_residentBytes;
+        size_t m_pendingBytes;
+
+        inline size_t getSize(const Texture& texture, uint32 firstMip) const
+        {
+            return getSize(texture.width, texture.height, texture.numMips, texture.bytesPerBlock, firstMip);
+        }
+
+        /// \brief evicts mipmaps of other textures until the given amount of bytes fits into the budget
+        /// \return false without evicting anything if not enough can be freed
+        bool makeRoom(size_t bytes, uint32 requestingId, DynamicArray<Request>& evictions);
+    };
+}
@@ -79,6 +79,8 @@ namespace gep
         Semaphore m_hasWorkSemaphore;
         DynamicArray<ITask*> m_tasks;
         Mutex m_tasksMutex;
+        /// only used by this worker, to move stolen tasks into m_tasks without holding two locks
+        DynamicArray<ITask*> m_stolenTasks;
 
         inline void setActiveGroup(TaskGroup* pGroup) { m_pActiveGroup = pGroup; }
         void addTasks(ArrayPtr<ITask*> tasks);
@@ -105,6 +107,8 @@ namespace gep
         bool m_isRunning;
         TaskGroup* m_currentTaskGroup;
         Mutex m_schedulingMutex;
+        /// held by the thread whose runParallel is currently helped by the workers
+        Mutex m_parallelMutex;
         Queue<TaskGroup*> m_remainingTaskGroups;
         DynamicArray<TaskGroup*> m_unusedTaskGroups;
         DynamicArray<TaskWorker*> m_worker;
@@ -131,6 +135,16 @@ namespace gep
         /// \brief runs tasks until there is no more work
         void runTasks();
 
+        /// \brief splits the range [0, count) into chunks of at least minChunkSize elements
+        ///   and calls work(start, end) for each of them on the workers, blocks until all chunks are done.
+        ///
+        /// Small ranges run directly on the calling thread.
+        /// Must not be called from inside a task of this queue, the chunks are a task group of their own.
+        /// Only one thread at a time gets help from the workers, the calls of other threads
+        /// (e.g. the resource loaders) run the whole range on their own thread.
+        /// The same happens while another task group is executing.
+        void runParallel(size_t count, size_t minChunkSize, const std::function<void(size_t start, size_t end)>& work);
+
         /// \brief stops execution of tasks, blocks until all tasks are stopped
         void stop();
     };
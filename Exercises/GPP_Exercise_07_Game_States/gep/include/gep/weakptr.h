@@ -284,6 +284,21 @@ namespace gep
             #endif
         }
 
+        /// \brief invalidates a weak reference which was previously created with setWithNewIndex
+        ///   all weak pointers sharing the reference will return null afterwards
+        void invalidate()
+        {
+            ScopedLock<Mutex> lock(WeakReferenced<typename T::WeakReferencedBaseType, ExportType>::s_mutex);
+            if(get() == nullptr)
+                return;
+            WeakReferenced<typename T::WeakReferencedBaseType, ExportType>::s_weakTable[m_weakRefIndex.index] = nullptr;
+            WeakReferenced<typename T::WeakReferencedBaseType, ExportType>::s_weakTableNumEntries--;
+            m_weakRefIndex = WeakRefIndex::invalidValue();
+            #ifdef _DEBUG
+            m_pLastLookupResult = nullptr;
+            #endif
+        }
+
         /// \brief gets the weak ref index for debugging purposes
         uint32 getWeakRefIndex()
         {
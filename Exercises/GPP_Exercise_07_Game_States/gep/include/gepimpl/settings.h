@@ -8,6 +8,9 @@ namespace gep
     class Settings : public ISettings
     {
         settings::Video m_video;
+        settings::Resources m_resources;
+        settings::Physics m_physics;
+        settings::Scripting m_scripting;
         ScriptTableWrapper m_scriptTable;
     public:
         Settings();
@@ -19,5 +22,17 @@ namespace gep
         virtual       settings::Video& getVideoSettings()       override { return m_video; }
         virtual const settings::Video& getVideoSettings() const override { return m_video; }
 
+        virtual void setResourceSettings(const settings::Resources& settings) override { m_resources = settings; }
+        virtual       settings::Resources& getResourceSettings()       override { return m_resources; }
+        virtual const settings::Resources& getResourceSettings() const override { return m_resources; }
+
+        virtual void setPhysicsSettings(const settings::Physics& settings) override { m_physics = settings; }
+        virtual       settings::Physics& getPhysicsSettings()       override { return m_physics; }
+        virtual const settings::Physics& getPhysicsSettings() const override { return m_physics; }
+
+        virtual void setScriptingSettings(const settings::Scripting& settings) override { m_scripting = settings; }
+        virtual       settings::Scripting& getScriptingSettings()       override { return m_scripting; }
+        virtual const settings::Scripting& getScriptingSettings() const override { return m_scripting; }
+
     };
 }
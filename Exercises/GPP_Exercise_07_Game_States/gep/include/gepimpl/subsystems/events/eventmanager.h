@@ -10,12 +10,15 @@ namespace gep
 {
     class GlobalEventManager : public IEventManager
     {
+        IAllocator* m_pAllocator;
         Event<float> m_update;
         Hashmap<EventId, Event<ScriptTableWrapper>*> m_scriptEvents;
     public:
-        GlobalEventManager() :
-            m_update(),
-            m_scriptEvents()
+        /// \param pAllocator used for the events and their listeners, the standard allocator if null
+        GlobalEventManager(IAllocator* pAllocator = nullptr) :
+            m_pAllocator(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+            m_update(Event<float>::CInfo(m_pAllocator)),
+            m_scriptEvents(m_pAllocator)
         {
         }
 
@@ -27,7 +30,7 @@ namespace gep
         {
             for (auto evt : m_scriptEvents.values())
             {
-                delete evt;
+                GEP_DELETE(m_pAllocator, evt);
             }
             m_scriptEvents.clear();
         }
@@ -44,7 +47,7 @@ namespace gep
 
         virtual Event<ScriptTableWrapper>* createScriptTableEvent() override
         {
-            auto evt = new Event<ScriptTableWrapper>();
+            auto evt = GEP_NEW(m_pAllocator, Event<ScriptTableWrapper>)(Event<ScriptTableWrapper>::CInfo(m_pAllocator));
             m_scriptEvents[evt->getId()] = evt;
             return evt;
         }
@@ -3,15 +3,100 @@
 #include "gep/interfaces/logging.h"
 #include "gep/container/DynamicArray.h"
 #include "gep/threading/mutex.h"
+#include "gep/threading/semaphore.h"
+#include "gep/threading/thread.h"
+#include <stdarg.h>
 
 namespace gep
 {
-    class Logging
+    /// \brief Logs asynchronously, the formatting and the sinks run on a thread of their own.
+    ///
+    /// A log call only stores the format string pointer and a copy of its arguments as a binary record
+    /// in a ring buffer of the calling thread, which the format thread reads without any locks.
+    /// The format strings have to stay alive, which string literals do. Strings passed as arguments
+    /// and to the unformatted calls are copied. Errors are passed to the sinks before logError returns,
+    /// so they are not lost if the program goes down right after them.
+    /// Every thread only logs the same message a few times per second, the suppressed repetitions are
+    /// counted and reported with the next one that gets through.
+    class GEP_API Logging
         : public ILogging
     {
+    public:
+        /// the ring buffer size of each thread, a thread waits for the format thread if its buffer is full
+        static const uint32 BUFFER_SIZE = 64 * 1024;
+        /// longer records and messages are cut
+        static const uint32 MAX_RECORD_SIZE = 2048;
+        /// threads logging after this many others format their messages themselves
+        static const uint32 MAX_THREADS = 64;
+        static const uint32 NUM_RATE_LIMITS = 64;
+        static const uint32 DEFAULT_MAX_REPEATS_PER_SECOND = 10;
+
     private:
+        struct RateLimit
+        {
+            uint32 key;
+            uint32 second;
+            uint32 count;
+            uint32 numSuppressed;
+        };
+
+        struct ThreadBuffer
+        {
+            char data[BUFFER_SIZE];
+            /// only written by the logging thread
+            volatile int64 writePosition;
+            /// only written by the format thread
+            volatile int64 readPosition;
+            /// only written by the format thread, everything before was passed to the sinks
+            volatile int64 deliveredPosition;
+            DWORD threadId;
+            /// only used by the logging thread
+            RateLimit rateLimits[NUM_RATE_LIMITS];
+        };
+
+        class FormatThread : public Thread
+        {
+        public:
+            FormatThread(Logging& logging) : m_logging(logging) {}
+            virtual void run() override;
+        private:
+            Logging& m_logging;
+            FormatThread(const FormatThread&);
+            void operator = (const FormatThread&);
+        };
+
         DynamicArray<ILogSink*> m_sinks;
         Mutex m_sinkMutex;
+        /// filled up to m_numBuffers, the mutex is only taken by threads logging for the first time
+        ThreadBuffer* m_buffers[MAX_THREADS];
+        volatile LONG m_numBuffers;
+        Mutex m_bufferMutex;
+        uint32 m_generation;
+        volatile uint32 m_maxRepeatsPerSecond;
+
+        volatile int64 m_lastSequence;
+        volatile LONG m_isSignaled;
+        volatile LONG m_isStopping;
+        Semaphore m_wakeUp;
+        volatile DWORD m_formatThreadId;
+        FormatThread m_formatThread;
+
+        void log(LogChannel channel, const char* fmt, va_list args);
+        void logUnformatted(LogChannel channel, const char* message);
+        /// \return nullptr if there are too many threads
+        ThreadBuffer* getThreadBuffer();
+        /// \brief counts the message against the rate limit of the thread
+        /// \return false if the message is suppressed, numSuppressed gets the repetitions suppressed before
+        bool passRateLimit(ThreadBuffer& buffer, uint32 key, uint32& numSuppressed);
+        /// \brief copies a record to the ring buffer, waits for the format thread while the buffer is full
+        void writeRecord(ThreadBuffer& buffer, const void* pHeader, uint32 headerSize, const void* pData, uint32 dataSize);
+        void deliver(LogChannel channel, const char* message);
+        void signal();
+        /// \brief formats all pending records in the order they were logged
+        void formatPending();
+
+        Logging(const Logging&);
+        void operator = (const Logging&);
 
     public:
         Logging();
@@ -26,8 +111,13 @@ namespace gep
         virtual void logErrorUnformatted(const char* message) override;
 
         virtual void registerSink(ILogSink* pSink) override;
+        /// \brief the sink gets all messages logged before and is not called anymore after this returns
         virtual void deregisterSink(ILogSink* pSink) override;
 
+        virtual void flush() override;
+
+        /// \brief how often a thread may log the same message per second, 0 turns the limit off
+        inline void setMaxRepeatsPerSecond(uint32 maxRepeats) { m_maxRepeatsPerSecond = maxRepeats; }
     };
 
     class ConsoleLogSink
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "gep/interfaces/memoryManager.h"
+#include "gep/memory/allocators.h"
 #include "gep/container/DynamicArray.h"
 #include "gep/traits.h"
 
 namespace gep
 {
-    class MemoryManager
+    //forward declarations
+    class AllocationProfiler;
+    class ILogging;
+
+    class GEP_API MemoryManager
         : public IMemoryManager
     {
     private:
@@ -33,9 +38,27 @@ namespace gep
         };
         static_assert(isPod<AllocatorInfo>::value == false, "AllocatorInfo should be non-pod");
 
+        struct Category
+        {
+            CountingAllocator allocator;
+            size_t budget;
+            size_t bytesUsed;
+            bool isOverBudget;
+            int64 frameDeltas[NUM_TRACKED_FRAMES]; ///< ring buffer, the next frame goes to m_numFrames % NUM_TRACKED_FRAMES
+
+            Category();
+        };
+
         DynamicArray<AllocatorInfo> m_allocators;
+        AllocationProfiler* m_pAllocationProfiler;
+        Category m_categories[size_t(MemoryCategory::Count)];
+        size_t m_numFrames;
+        ILogging* m_pLogging;
 
     public:
+        /// \param pLogging receives the budget warnings, may be null
+        MemoryManager(ILogging* pLogging = nullptr);
+
         // ISubsystem interface
         virtual void initialize() override;
         virtual void destroy() override;
@@ -44,5 +67,13 @@ namespace gep
         // IMemoryManager interface
         virtual void registerAllocator(const char* name, IAllocatorStatistics* pAllocator) override;
         virtual void deregisterAllocator(IAllocatorStatistics* pAllocator) override;
+        virtual void startAllocationProfiling(size_t sampleRate = 512 * 1024) override;
+        virtual void stopAllocationProfiling() override;
+        virtual bool isAllocationProfilingEnabled() const override;
+        virtual void exportAllocationProfile(const std::string& liveBytesFileName, const std::string& allocatedBytesFileName) override;
+        virtual IAllocatorStatistics* getAllocator(MemoryCategory category) override;
+        virtual void setBudget(MemoryCategory category, size_t budget) override;
+        virtual MemoryCategoryStatistics getStatistics(MemoryCategory category) const override;
+        virtual size_t getFrameDeltas(MemoryCategory category, ArrayPtr<int64> deltas) const override;
     };
 }
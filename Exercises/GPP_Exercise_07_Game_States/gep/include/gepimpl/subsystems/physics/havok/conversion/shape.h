@@ -30,6 +30,18 @@ namespace hk {
                 result = new hkpSphereShape(sphere->getRadius());
             }
             break;
+        case ShapeType::ConvexVertices:
+            {
+                auto* convex = static_cast<ConvexVerticesShape*>(in_gepShape);
+                GEP_ASSERT(dynamic_cast<ConvexVerticesShape*>(in_gepShape) != nullptr, "Shape type does not match the actual class type!");
+                auto vertices = convex->getVertices();
+                hkStridedVertices stridedVertices;
+                stridedVertices.m_vertices = &vertices[0].x;
+                stridedVertices.m_numVertices = int(vertices.length());
+                stridedVertices.m_striding = sizeof(vec3);
+                result = new hkpConvexVerticesShape(stridedVertices);
+            }
+            break;
         case ShapeType::Triangle:
             {
                 auto* mesh = static_cast<HavokMeshShape*>(in_gepShape);
@@ -72,12 +72,22 @@ namespace gep
 
     };
 
+    class HavokCollidable;
+    class HavokWorld;
+
     class HavokRigidBody : public IRigidBody
     {
+        friend class HavokWorld;
+
         hkpTriggerVolume* m_pTriggerVolume;
         DynamicArray<IRigidBody::PositionChangedCallback> m_positionChangedCallbacks;
         SmartPtr<IShape> m_shape; ///< If != nullptr, we own this shape and must delete it.
         HavokEntity m_entity;
+        /// reported by the queries, created once the body is initialized
+        HavokCollidable* m_pCollidable;
+        /// set while the body is in a world, the index is the slot of the body there
+        HavokWorld* m_pWorld;
+        uint32 m_worldIndex;
     public:
 
         HavokRigidBody(hkpRigidBody* rigidBody = nullptr);
@@ -90,6 +100,9 @@ namespace gep
 
         virtual void initialize() override;
 
+        inline const HavokCollidable* getCollidable() const { return m_pCollidable; }
+        virtual uint32 getWorldIndex() const override { return m_pWorld != nullptr ? m_worldIndex : INVALID_WORLD_INDEX; }
+
         virtual CallbackId registerSimulationCallback(PositionChangedCallback callback) override;
         virtual void deregisterSimulationCallback(CallbackId id) override;
         void triggerSimulationCallbacks() const;
@@ -107,10 +120,10 @@ namespace gep
         virtual void setRestitution(float value) override { getHkpRigidBody()->setRestitution(value); }
 
         virtual vec3 getPosition() const override { return conversion::hk::from(getHkpRigidBody()->getPosition()); }
-        virtual void setPosition(const vec3& value) override { getHkpRigidBody()->setPosition(conversion::hk::to(value)); }
+        virtual void setPosition(const vec3& value) override;
 
         virtual Quaternion getRotation() const override { return conversion::hk::from(getHkpRigidBody()->getRotation()); }
-        virtual void setRotation(const Quaternion& value) override { getHkpRigidBody()->setRotation(conversion::hk::to(value)); }
+        virtual void setRotation(const Quaternion& value) override;
         
         virtual float getFriction() const override { return getHkpRigidBody()->getFriction(); }
         virtual void setFriction(float value) override { return getHkpRigidBody()->setFriction(value); }
@@ -179,7 +192,7 @@ namespace gep
         IShape* m_pShape;
     public:
 
-        HavokCollidable(hkpCollidable* collidable);
+        HavokCollidable(hkpCollidable* collidable, IPhysicsEntity* pOwner, IShape* pShape);
 
         virtual ~HavokCollidable(){}
 
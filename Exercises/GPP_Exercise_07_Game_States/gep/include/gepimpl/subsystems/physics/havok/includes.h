@@ -5,6 +5,9 @@
 #include <Physics2012/Dynamics/Entity/hkpRigidBody.h>
 #include <Physics2012/Collide/Query/CastUtil/hkpWorldRayCastInput.h>
 #include <Physics2012/Collide/Query/CastUtil/hkpWorldRayCastOutput.h>
+#include <Physics2012/Collide/Query/CastUtil/hkpLinearCastInput.h>
+#include <Physics2012/Collide/Query/Collector/PointCollector/hkpClosestCdPointCollector.h>
+#include <Physics2012/Collide/Query/Collector/BodyPairCollector/hkpAllCdBodyPairCollector.h>
 
 // Character Control
 
@@ -8,14 +8,27 @@
 namespace gep
 {
     class IPhysicsEntity;
+    class HavokRigidBody;
+    class HavokRigidBodySyncAction;
 
     class HavokBaseAction;
 
+    /// \brief The entities are stored in slots, removing one moves the last entity into its slot.
+    ///
+    /// After every step the transforms of all bodies are copied into one array in the order of the slots,
+    /// the game objects read them from there instead of asking havok for every body.
     class HavokWorld : public IWorld, public IContactListener
     {
         hkRefPtr<hkpWorld> m_pWorld;
 
-        DynamicArray< SmartPtr<IPhysicsEntity> > m_entities;
+        DynamicArray< SmartPtr<HavokRigidBody> > m_entities;
+        /// parallel to the entities
+        DynamicArray<RigidBodyTransform> m_transforms;
+        DynamicArray<HavokRigidBodySyncAction*> m_syncActions;
+        /// sync actions of removed entities, reused for the next added ones
+        DynamicArray<HavokRigidBodySyncAction*> m_freeSyncActions;
+        /// sync actions of entities removed during a step, havok only removes them after the step
+        DynamicArray<HavokRigidBodySyncAction*> m_removedSyncActions;
         DynamicArray< SmartPtr<ICharacterRigidBody> > m_characters;
         DynamicArray<HavokContactListener*> m_contactListeners;
         HavokContactListener m_actualContactListener;
@@ -35,7 +48,14 @@ namespace gep
 
         void update(float elapsedTime);
 
+        virtual ArrayPtr<const RigidBodyTransform> getTransforms() const override { return m_transforms.toArray(); }
+        /// \brief copies the transform of the body in the given slot, for bodies moved by hand
+        void updateTransform(uint32 index);
+
         virtual void castRay(const RayCastInput& input, RayCastOutput& output) const;
+        virtual void castRays(ArrayPtr<const RayCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const override;
+        virtual void castShapes(ArrayPtr<const ShapeCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const override;
+        virtual void overlapShapes(ArrayPtr<const OverlapInput> inputs, ArrayPtr<OverlapOutput> outputs) const override;
 
         hkpWorld* getHkpWorld() const { return m_pWorld; }
 
@@ -44,5 +64,12 @@ namespace gep
         virtual void contactPointCallback(const ContactPointArgs& evt) override;
         virtual void collisionAddedCallback(const CollisionArgs& evt) override;
         virtual void collisionRemovedCallback(const CollisionArgs& evt) override;
+
+    private:
+        /// \brief detaches a removed sync action from its body and puts it into the pool
+        void recycleSyncAction(HavokRigidBodySyncAction* pAction);
+
+        /// \brief the collidable of the gep rigid body owning a havok collidable, nullptr if there is none
+        static const ICollidable* findCollidable(const hkpCollidable* pHkCollidable);
     };
 }
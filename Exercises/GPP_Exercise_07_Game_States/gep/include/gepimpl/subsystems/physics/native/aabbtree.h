@@ -0,0 +1,202 @@
+#pragma once
+
+#include "gep/gepmodule.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/math3d/vec3.h"
+
+namespace gep
+{
+    /// \brief Dynamic bounding volume hierarchy used as the broadphase of the native physics.
+    ///
+    /// Every proxy is a leaf with a "fat" box, the tight box grown by a margin and the predicted displacement,
+    /// so bodies which move a little don't have to be reinserted every step. Leaves are inserted next to the
+    /// sibling with the lowest surface area cost and the tree is kept balanced with AVL rotations.
+    /// Nodes live in one array and are referred to by their index, freed nodes are reused.
+    class GEP_API AabbTree
+    {
+    public:
+        static const uint32 NULL_NODE = 0xffffffff;
+        static const size_t STACK_SIZE = 64;
+
+        AabbTree(float margin, IAllocator* pAllocator = nullptr);
+
+        /// \brief adds a proxy for the given tight box
+        /// \return the proxy id, stays valid until the proxy is removed
+        uint32 insert(const vec3& min, const vec3& max, void* pUserData);
+        void remove(uint32 proxy);
+
+        /// \brief moves a proxy, does nothing if the new tight box is still inside the fat box
+        /// \return true if the proxy had to be reinserted
+        bool update(uint32 proxy, const vec3& min, const vec3& max, const vec3& displacement);
+
+        inline void* getUserData(uint32 proxy) const { return m_nodes[proxy].pUserData; }
+        inline const vec3& getFatMin(uint32 proxy) const { return m_nodes[proxy].min; }
+        inline const vec3& getFatMax(uint32 proxy) const { return m_nodes[proxy].max; }
+        inline size_t getNumProxies() const { return m_numProxies; }
+
+        /// \brief height of the root, 0 for a single leaf
+        uint32 getHeight() const;
+        /// \brief checks the links, heights and boxes of all nodes
+        void validate() const;
+
+        /// \brief calls callback(proxy) for every fat box overlapping the given box
+        ///
+        /// The query stops as soon as the callback returns false.
+        template <typename Callback>
+        void query(const vec3& min, const vec3& max, Callback& callback) const
+        {
+            uint32 stack[STACK_SIZE];
+            size_t stackSize = 0;
+            if(m_root != NULL_NODE)
+                stack[stackSize++] = m_root;
+            while(stackSize > 0)
+            {
+                const uint32 nodeId = stack[--stackSize];
+                const Node& node = m_nodes[nodeId];
+                if(!overlaps(node.min, node.max, min, max))
+                    continue;
+                if(node.isLeaf())
+                {
+                    if(!callback(nodeId))
+                        return;
+                }
+                else
+                {
+                    GEP_ASSERT(stackSize + 2 <= STACK_SIZE, "the tree is too deep", stackSize);
+                    stack[stackSize++] = node.child1;
+                    stack[stackSize++] = node.child2;
+                }
+            }
+        }
+
+        /// \brief calls callback(proxy, maxFraction) for every fat box hit by the segment from + (to - from) * [0, maxFraction]
+        ///
+        /// The callback returns the new maximum fraction: 0 stops the cast, a smaller value clips the segment
+        /// and maxFraction itself ignores the proxy.
+        template <typename Callback>
+        void castRay(const vec3& from, const vec3& to, float maxFraction, Callback& callback) const
+        {
+            const vec3 direction = to - from;
+            uint32 stack[STACK_SIZE];
+            size_t stackSize = 0;
+            if(m_root != NULL_NODE)
+                stack[stackSize++] = m_root;
+            while(stackSize > 0)
+            {
+                const uint32 nodeId = stack[--stackSize];
+                const Node& node = m_nodes[nodeId];
+                if(!intersectsRay(node.min, node.max, from, direction, maxFraction))
+                    continue;
+                if(node.isLeaf())
+                {
+                    const float fraction = callback(nodeId, maxFraction);
+                    if(fraction == 0.0f)
+                        return;
+                    maxFraction = GEP_MIN(maxFraction, fraction);
+                }
+                else
+                {
+                    GEP_ASSERT(stackSize + 2 <= STACK_SIZE, "the tree is too deep", stackSize);
+                    stack[stackSize++] = node.child1;
+                    stack[stackSize++] = node.child2;
+                }
+            }
+        }
+
+        /// \brief traverses the tree once for a whole batch of queries
+        ///
+        /// Every node is tested only against the queries which passed its parent, nodeTest(query, min, max)
+        /// tells if a query continues into a node and callback(query, proxy) is called for every leaf a query reaches.
+        /// Queries can change between the calls, e.g. ray casts shortening their ray.
+        /// \param queries scratch space, holds the indices of the queries which are still active in the current subtree
+        template <typename NodeTest, typename Callback>
+        void queryBatch(uint32 numQueries, NodeTest& nodeTest, Callback& callback, DynamicArray<uint32>& queries) const
+        {
+            struct Entry
+            {
+                uint32 nodeId;
+                /// the queries which reached the parent
+                uint32 begin;
+                uint32 end;
+            };
+
+            queries.clear();
+            for(uint32 i = 0; i < numQueries; i++)
+                queries.append(i);
+            Entry stack[STACK_SIZE];
+            size_t stackSize = 0;
+            if(m_root != NULL_NODE && numQueries > 0)
+                stack[stackSize++] = Entry{ m_root, 0, numQueries };
+            while(stackSize > 0)
+            {
+                const Entry entry = stack[--stackSize];
+                // the entries are processed depth first, everything after the queries of this one is done
+                queries.resize(entry.end);
+                const Node& node = m_nodes[entry.nodeId];
+                const uint32 begin = uint32(queries.length());
+                for(uint32 i = entry.begin; i < entry.end; i++)
+                {
+                    const uint32 query = queries[i];
+                    if(nodeTest(query, node.min, node.max))
+                        queries.append(query);
+                }
+                const uint32 end = uint32(queries.length());
+                if(begin == end)
+                    continue;
+                if(node.isLeaf())
+                {
+                    for(uint32 i = begin; i < end; i++)
+                        callback(queries[i], entry.nodeId);
+                }
+                else
+                {
+                    GEP_ASSERT(stackSize + 2 <= STACK_SIZE, "the tree is too deep", stackSize);
+                    stack[stackSize++] = Entry{ node.child1, begin, end };
+                    stack[stackSize++] = Entry{ node.child2, begin, end };
+                }
+            }
+        }
+
+        static inline bool overlaps(const vec3& minA, const vec3& maxA, const vec3& minB, const vec3& maxB)
+        {
+            return minA.x <= maxB.x && minB.x <= maxA.x
+                && minA.y <= maxB.y && minB.y <= maxA.y
+                && minA.z <= maxB.z && minB.z <= maxA.z;
+        }
+
+        /// \brief slab test of the segment origin + direction * [0, maxFraction] against a box
+        static bool intersectsRay(const vec3& min, const vec3& max, const vec3& origin, const vec3& direction, float maxFraction);
+
+    private:
+        struct Node
+        {
+            vec3 min;
+            vec3 max;
+            void* pUserData;
+            /// the parent while the node is in the tree, the next free node otherwise
+            uint32 parentOrNext;
+            uint32 child1;
+            uint32 child2;
+            /// 0 for leaves, -1 for free nodes
+            int32 height;
+
+            inline bool isLeaf() const { return child1 == NULL_NODE; }
+        };
+
+        DynamicArray<Node> m_nodes;
+        uint32 m_root;
+        uint32 m_freeList;
+        size_t m_numProxies;
+        float m_margin;
+
+        uint32 allocateNode();
+        void freeNode(uint32 nodeId);
+        void insertLeaf(uint32 leaf);
+        void removeLeaf(uint32 leaf);
+        uint32 balance(uint32 nodeId);
+        void refit(uint32 nodeId);
+        void validate(uint32 nodeId) const;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(AabbTree);
+    };
+}
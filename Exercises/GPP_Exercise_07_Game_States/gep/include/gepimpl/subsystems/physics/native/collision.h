@@ -0,0 +1,140 @@
+#pragma once
+
+#include "gep/gepmodule.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/math3d/vec3.h"
+#include "gep/math3d/mat3.h"
+#include "gep/interfaces/physics/shape.h"
+
+namespace gep {
+namespace native {
+
+    /// \brief Convex polyhedron with its faces and edges, stored in the local space of a body.
+    ///
+    /// The vertices of every face wind counter clockwise when looking at the face from the outside.
+    /// Every edge is stored once together with the two faces it separates.
+    class GEP_API Hull
+    {
+    public:
+        static const size_t MAX_VERTICES = 64;
+
+        struct Face
+        {
+            vec3 normal;
+            /// the face plane is dot(normal, x) == offset
+            float offset;
+            uint16 firstVertex;
+            uint16 numVertices;
+        };
+
+        struct Edge
+        {
+            uint8 vertex0;
+            uint8 vertex1;
+            uint8 face0;
+            uint8 face1;
+        };
+
+        DynamicArray<vec3> vertices;
+        DynamicArray<Face> faces;
+        /// indices into vertices, faces refer to a range of them
+        DynamicArray<uint8> faceVertices;
+        DynamicArray<Edge> edges;
+        vec3 center;
+        vec3 localMin;
+        vec3 localMax;
+
+        Hull(IAllocator* pAllocator = nullptr);
+
+        void setBox(const vec3& halfExtents);
+        /// \brief builds the hull around at most MAX_VERTICES points
+        /// \return FAILURE if there are too many points or all of them lie in a plane
+        Result setConvexHull(const ArrayPtr<vec3>& points);
+
+        inline uint8 getFaceVertex(const Face& face, size_t index) const { return faceVertices[face.firstVertex + index]; }
+        /// \brief the vertex furthest in the given local direction
+        const vec3& getSupport(const vec3& direction) const;
+    };
+
+    struct Transform
+    {
+        vec3 position;
+        mat3 rotation;
+
+        inline const vec3 toWorld(const vec3& point) const { return rotation * point + position; }
+        inline const vec3 toLocal(const vec3& point) const { return rotateInverse(point - position); }
+        inline const vec3 rotateInverse(const vec3& v) const
+        {
+            return vec3(v.x * rotation.data[0] + v.y * rotation.data[1] + v.z * rotation.data[2],
+                        v.x * rotation.data[3] + v.y * rotation.data[4] + v.z * rotation.data[5],
+                        v.x * rotation.data[6] + v.y * rotation.data[7] + v.z * rotation.data[8]);
+        }
+    };
+
+    /// \brief Spheres are stored by radius, boxes and convex vertices as a hull.
+    struct CollisionShape
+    {
+        ShapeType::Enum type;
+        float radius;
+        const Hull* pHull;
+
+        inline bool isSphere() const { return type == ShapeType::Sphere; }
+    };
+
+    struct ContactPoint
+    {
+        /// halfway between the two surfaces, in world space
+        vec3 position;
+        /// negative while the shapes penetrate
+        float separation;
+    };
+
+    struct Manifold
+    {
+        static const size_t MAX_POINTS = 4;
+
+        /// world space, points from the first shape to the second one
+        vec3 normal;
+        ContactPoint points[MAX_POINTS];
+        uint32 numPoints;
+    };
+
+    /// \brief Finds the contact points of two shapes.
+    ///
+    /// Points which are up to \a margin apart are reported as well, the solver keeps the shapes from
+    /// closing this gap within one step (speculative contacts).
+    /// \return false if the shapes are further apart than the margin
+    GEP_API bool collide(const CollisionShape& shapeA, const Transform& transformA,
+                         const CollisionShape& shapeB, const Transform& transformB,
+                         float margin, float linearSlop, Manifold& manifold);
+
+    GEP_API bool collideSpheres(const vec3& centerA, float radiusA, const vec3& centerB, float radiusB, float margin, Manifold& manifold);
+    /// \brief the normal points from the sphere to the hull
+    GEP_API bool collideSphereHull(const vec3& center, float radius, const Hull& hull, const Transform& transform, float margin, Manifold& manifold);
+    /// \brief separating axis test over the faces of both hulls and all pairs of edges, the contact
+    ///   points are the incident face clipped against the reference face, or the closest points of two edges
+    GEP_API bool collideHulls(const Hull& hullA, const Transform& transformA, const Hull& hullB, const Transform& transformB,
+                              float margin, float linearSlop, Manifold& manifold);
+
+    /// \brief casts the segment from + (to - from) * [0, maxFraction] against a shape, rays starting inside don't hit
+    /// \return true and the fraction of the first hit, if there is one
+    GEP_API bool castRay(const CollisionShape& shape, const Transform& transform, const vec3& from, const vec3& to,
+                         float maxFraction, float& fraction);
+
+    /// \brief sweeps shape a from \a from to \a to without rotating it, by conservative advancement against shape b
+    /// \return true and the fraction where the shapes come closer than \a tolerance, 0 if they overlap at the start
+    GEP_API bool castShape(const CollisionShape& shapeA, const mat3& rotationA, const vec3& from, const vec3& to,
+                           const CollisionShape& shapeB, const Transform& transformB,
+                           float maxFraction, float tolerance, float& fraction);
+
+    GEP_API void computeBounds(const CollisionShape& shape, const Transform& transform, vec3& min, vec3& max);
+
+    /// \brief spheres only need their radius, boxes and convex vertices are built into \a hull
+    /// \return FAILURE for other shapes and for convex vertices which have no hull
+    GEP_API Result setCollisionShape(const IShape& shape, Hull& hull, CollisionShape& collisionShape);
+
+    /// \brief inertia tensor of a solid shape around its origin, in local space
+    /// \return the diagonal, hulls are approximated by their local bounding box
+    GEP_API vec3 computeInertia(const CollisionShape& shape, float mass);
+
+}} // namespace gep::native
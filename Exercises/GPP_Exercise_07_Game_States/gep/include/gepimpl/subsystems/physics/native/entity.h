@@ -0,0 +1,197 @@
+#pragma once
+#include "gep/interfaces/physics/entity.h"
+#include "gep/interfaces/physics/contact.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/ReferenceCounting.h"
+
+#include "gepimpl/subsystems/physics/native/collision.h"
+
+namespace gep
+{
+    class NativeWorld;
+
+    /// \brief The contact callbacks of the native world fire after the step, the velocities are always accessible.
+    class NativeContactPointArgs : public ContactPointArgs
+    {
+    public:
+        NativeContactPointArgs(CallbackSource::Enum source, IRigidBody* first, IRigidBody* second) :
+            ContactPointArgs(source, first, second)
+        {
+        }
+
+        virtual void accessVelocities(int32 bodyIndex) const override { GEP_UNUSED(bodyIndex); }
+        virtual void updateVelocities(int32 bodyIndex) const override { GEP_UNUSED(bodyIndex); }
+    };
+
+    class NativeCollidable : public ICollidable
+    {
+        IPhysicsEntity* m_pEntity;
+        IShape* m_pShape;
+    public:
+        NativeCollidable() : m_pEntity(nullptr), m_pShape(nullptr) {}
+
+        virtual ~NativeCollidable(){}
+
+        virtual void setOwner(IPhysicsEntity* owner) override { m_pEntity = owner; }
+        virtual       IPhysicsEntity* getOwner() override       { return m_pEntity; }
+        virtual const IPhysicsEntity* getOwner() const override { return m_pEntity; }
+
+        virtual void setShape(IShape* shape) override { m_pShape = shape; }
+        virtual       IShape* getShape()       override { return m_pShape; }
+        virtual const IShape* getShape() const override { return m_pShape; }
+    };
+
+    /// \brief Rigid body of the native physics, simulated by a NativeWorld.
+    ///
+    /// Boxes and convex vertices are collided as hulls, spheres by their radius.
+    /// The collision filter info, the rolling friction and the time factor are stored but not simulated.
+    class GEP_API NativeRigidBody : public IRigidBody
+    {
+        friend class NativeWorld;
+
+        NativeWorld* m_pWorld;
+        /// index into the bodies of the world
+        uint32 m_index;
+        uint32 m_proxy;
+        /// unique within the world, the contacts are keyed by the ids of their bodies
+        uint32 m_id;
+
+        SmartPtr<IShape> m_shape;
+        native::Hull m_hull;
+        native::CollisionShape m_collisionShape;
+        /// distance of the furthest point of the shape from the center of the body
+        float m_boundingRadius;
+        NativeCollidable m_collidable;
+
+        uint32 m_collisionFilterInfo;
+        float m_mass;
+        MotionType::Enum m_motionType;
+        float m_restitution;
+        float m_friction;
+        float m_linearDamping;
+        float m_angularDamping;
+        float m_gravityFactor;
+        float m_rollingFrictionMultiplier;
+        float m_maxLinearVelocity;
+        float m_maxAngularVelocity;
+        float m_timeFactor;
+        uint16 m_contactPointCallbackDelay;
+        bool m_enableDeactivation;
+        bool m_isTriggerVolume;
+
+        native::Transform m_transform;
+        Quaternion m_rotation;
+        vec3 m_linearVelocity;
+        vec3 m_angularVelocity;
+        float m_inverseMass;
+        /// diagonal of the inverse inertia tensor in local space
+        vec3 m_localInverseInertia;
+
+        bool m_isActive;
+        /// set when the transform was changed from the outside, the broadphase has to be updated
+        bool m_isTransformDirty;
+        float m_sleepTime;
+
+        DynamicArray<IContactListener*> m_contactListeners;
+        DynamicArray<IRigidBody::PositionChangedCallback> m_positionChangedCallbacks;
+
+    public:
+        NativeRigidBody(const RigidBodyCInfo& cinfo, IAllocator* pAllocator = nullptr);
+        virtual ~NativeRigidBody();
+
+        virtual void initialize() override {}
+        virtual uint32 getWorldIndex() const override;
+
+        inline NativeWorld* getWorld() const { return m_pWorld; }
+        inline const native::CollisionShape& getCollisionShape() const { return m_collisionShape; }
+        inline const native::Transform& getTransform() const { return m_transform; }
+        inline float getInverseMass() const { return m_inverseMass; }
+        inline const NativeCollidable* getCollidable() const { return &m_collidable; }
+
+        /// \brief dynamic bodies are moved by forces and contacts
+        bool isDynamic() const;
+        /// \brief world space inverse inertia tensor
+        mat3 computeInverseInertia() const;
+
+        virtual CallbackId registerSimulationCallback(PositionChangedCallback callback) override;
+        virtual void deregisterSimulationCallback(CallbackId id) override;
+        void triggerSimulationCallbacks() const;
+
+        /// \brief calls the listeners of this body, removing listeners while they are called is fine
+        void triggerContactPointCallbacks(const ContactPointArgs& args);
+
+        virtual uint32 getCollisionFilterInfo() const override { return m_collisionFilterInfo; }
+        virtual void setCollisionFilterInfo(uint32 value) override { m_collisionFilterInfo = value; }
+
+        virtual float getMass() const override { return m_mass; }
+        virtual void setMass(float value) override;
+
+        virtual MotionType::Enum getMotionType() const override { return m_motionType; }
+        virtual void setMotionType(MotionType::Enum value) override;
+
+        virtual float getRestitution() const override { return m_restitution; }
+        virtual void setRestitution(float value) override { m_restitution = value; }
+
+        virtual vec3 getPosition() const override { return m_transform.position; }
+        virtual void setPosition(const vec3& value) override;
+
+        virtual Quaternion getRotation() const override { return m_rotation; }
+        virtual void setRotation(const Quaternion& value) override;
+
+        virtual float getFriction() const override { return m_friction; }
+        virtual void setFriction(float value) override { m_friction = value; }
+
+        virtual vec3 getLinearVelocity() const override { return m_linearVelocity; }
+        virtual void setLinearVelocity(const vec3& value) override;
+
+        virtual vec3 getAngularVelocity() const override { return m_angularVelocity; }
+        virtual void setAngularVelocity(const vec3 & value) override;
+
+        virtual float getLinearDamping() const override { return m_linearDamping; }
+        virtual void setLinearDamping(float value) override { m_linearDamping = value; }
+
+        virtual float getAngularDamping() const override { return m_angularDamping; }
+        virtual void setAngularDamping(float value) override { m_angularDamping = value; }
+
+        virtual float getGravityFactor() const override { return m_gravityFactor; }
+        virtual void setGravityFactor(float value) override { m_gravityFactor = value; }
+
+        virtual float getRollingFrictionMultiplier() const override { return m_rollingFrictionMultiplier; }
+        virtual void setRollingFrictionMultiplier(float value) override { m_rollingFrictionMultiplier = value; }
+
+        virtual float getMaxLinearVelocity() const override { return m_maxLinearVelocity; }
+        virtual void setMaxLinearVelocity(float value) override { m_maxLinearVelocity = value; }
+
+        virtual float getMaxAngularVelocity() const override { return m_maxAngularVelocity; }
+        virtual void setMaxAngularVelocity(float value) override { m_maxAngularVelocity = value; }
+
+        virtual float getTimeFactor() const override { return m_timeFactor; }
+        virtual void setTimeFactor(float value) override { m_timeFactor = value; }
+
+        virtual uint16 getContactPointCallbackDelay() const override { return m_contactPointCallbackDelay; }
+        virtual void setContactPointCallbackDelay(uint16 value) override { m_contactPointCallbackDelay = value; }
+
+        virtual void convertToTriggerVolume() override { m_isTriggerVolume = true; }
+        virtual bool isTriggerVolume() const override { return m_isTriggerVolume; }
+
+        virtual void applyForce(float deltaSeconds, const vec3& force) override { applyLinearImpulse(force * deltaSeconds); }
+        virtual void applyForceAt(float deltaSeconds, const vec3& force, const vec3& point) override { applyPointImpulse(force * deltaSeconds, point); }
+        virtual void applyTorque(float deltaSeconds, const vec3& torque) override { applyAngularImpulse(torque * deltaSeconds); }
+
+        virtual void applyLinearImpulse(const vec3& impulse) override;
+        virtual void applyAngularImpulse(const vec3& impulse) override;
+        virtual void applyPointImpulse(const vec3& impulse, const vec3& point) override;
+
+        virtual void addContactListener(IContactListener* listener) override;
+        virtual void removeContactListener(IContactListener* listener) override;
+
+        virtual void activate() override;
+        virtual void requestDeactivation() override;
+        virtual bool isActive() const override { return m_isActive; }
+
+    private:
+        void updateMassProperties();
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(NativeRigidBody);
+    };
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "gep/interfaces/physics/factory.h"
+
+#include "gepimpl/subsystems/physics/native/world.h"
+#include "gepimpl/subsystems/physics/native/entity.h"
+
+namespace gep
+{
+    class TaskQueue;
+
+    /// \brief Creates the worlds and rigid bodies of the native physics.
+    ///
+    /// Character rigid bodies and collision meshes are not supported, asking for them throws.
+    class GEP_API NativePhysicsFactory : public IPhysicsFactory
+    {
+        IAllocator* m_pAllocator;
+        TaskQueue* m_pTaskQueue;
+    public:
+
+        NativePhysicsFactory(IAllocator* allocator, TaskQueue* pTaskQueue = nullptr);
+        virtual ~NativePhysicsFactory();
+
+        virtual void initialize() override;
+        virtual void destroy() override;
+
+        virtual IAllocator* getAllocator() override;
+        virtual void setAllocator(IAllocator* allocator) override;
+
+        virtual IWorld* createWorld(const WorldCInfo& cinfo) const override;
+        virtual IRigidBody* createRigidBody(const RigidBodyCInfo& cinfo) const override;
+        virtual ICharacterRigidBody* createCharacterRigidBody(const CharacterRigidBodyCInfo& cinfo) const override;
+
+        virtual ResourcePtr<ICollisionMesh> loadCollisionMesh(const char* path) override;
+        virtual IShape* loadCollisionMeshFromLua(const char* path) override;
+    };
+}
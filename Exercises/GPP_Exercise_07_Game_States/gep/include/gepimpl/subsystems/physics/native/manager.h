@@ -0,0 +1,34 @@
+#pragma once
+#include "gep/interfaces/physics/system.h"
+#include "gepimpl/subsystems/physics/native/world.h"
+#include "gepimpl/subsystems/physics/native/entity.h"
+#include "gepimpl/subsystems/physics/native/factory.h"
+
+namespace gep
+{
+    /// \brief Physics system which simulates with the native physics instead of havok.
+    class NativePhysicsManager : public IPhysicsSystem
+    {
+        NativePhysicsFactory* m_pFactory;
+        mutable SmartPtr<NativeWorld> m_pWorld;
+        bool m_isDebugDrawingEnabled;
+
+    public:
+        NativePhysicsManager();
+
+        virtual ~NativePhysicsManager();
+
+        virtual void initialize() override;
+        virtual void destroy() override;
+        virtual void update(float elapsedTime) override;
+
+        virtual IWorld* getWorld() override { return m_pWorld.get(); }
+        virtual const IWorld* getWorld() const override { return m_pWorld.get(); }
+        void setWorld(IWorld* value) override;
+
+        virtual void setDebugDrawingEnabled(bool value) override { m_isDebugDrawingEnabled = value; }
+        virtual bool getDebugDrawingEnabled() const override { return m_isDebugDrawingEnabled; }
+
+        virtual IPhysicsFactory* getPhysicsFactory() override { return m_pFactory; }
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "gepimpl/subsystems/physics/native/collision.h"
+
+namespace gep {
+namespace native {
+
+    /// \brief The velocity state the solver works on, bodies with an inverse mass of 0 are never written.
+    struct SolverBody
+    {
+        vec3 linearVelocity;
+        vec3 angularVelocity;
+        float inverseMass;
+        /// world space
+        mat3 inverseInertia;
+    };
+
+    struct ContactConstraintPoint
+    {
+        /// from the centers of the bodies to the contact point
+        vec3 anchorA;
+        vec3 anchorB;
+        float separation;
+        /// the rows of the point are the normal and the two tangents, the angular parts are
+        /// anchor x direction and the inverse inertia times that, computed once per step
+        vec3 angularA[3];
+        vec3 angularB[3];
+        vec3 inertiaAngularA[3];
+        vec3 inertiaAngularB[3];
+        float normalMass;
+        float tangentMass[2];
+        float normalImpulse;
+        float tangentImpulse[2];
+        /// the normal velocity the point is solved for, closes speculative gaps and pushes penetrations apart
+        float velocityBias;
+        /// normal velocity before solving, used for restitution
+        float relativeVelocity;
+        float maxNormalImpulse;
+    };
+
+    struct ContactConstraint
+    {
+        uint32 bodyA;
+        uint32 bodyB;
+        /// from a to b
+        vec3 normal;
+        vec3 tangents[2];
+        float friction;
+        float restitution;
+        uint32 numPoints;
+        ContactConstraintPoint points[Manifold::MAX_POINTS];
+    };
+
+    struct SolverSettings
+    {
+        float linearSlop;
+        /// fraction of the penetration resolved per step
+        float baumgarte;
+        /// bodies approaching slower than this don't bounce
+        float restitutionThreshold;
+        uint32 velocityIterations;
+    };
+
+    /// \brief sequential impulses on one island, the accumulated impulses are used to warm start
+    ///
+    /// The impulses of the constraint points have to be set before, to 0 or to those of the previous step.
+    GEP_API void solveContacts(ArrayPtr<ContactConstraint> constraints, SolverBody* bodies,
+                               float deltaSeconds, const SolverSettings& settings);
+
+}} // namespace gep::native
@@ -0,0 +1,173 @@
+#pragma once
+#include "gep/interfaces/physics/world.h"
+#include "gep/interfaces/physics/contact.h"
+#include "gep/interfaces/events.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/threading/mutex.h"
+
+#include "gepimpl/subsystems/physics/native/aabbTree.h"
+#include "gepimpl/subsystems/physics/native/solver.h"
+#include "gepimpl/subsystems/physics/native/entity.h"
+
+namespace gep
+{
+    class TaskQueue;
+    class IDebugRenderer;
+
+    /// \brief World of the native physics.
+    ///
+    /// Every step integrates the velocities, finds the overlapping pairs in the AABB tree, collides them,
+    /// groups the touching dynamic bodies into islands and solves the islands independently, in parallel
+    /// on the task queue if there is one. Islands whose bodies all rest long enough go to sleep.
+    /// Contact callbacks fire after the step, entities added or removed by them are added or removed
+    /// once all callbacks are done.
+    class GEP_API NativeWorld : public IWorld
+    {
+    public:
+        static const uint32 VELOCITY_ITERATIONS = 8;
+        static const uint32 MAX_SUB_STEPS = 4;
+        static const size_t PAIR_BATCH_SIZE = 64;
+
+        NativeWorld(const WorldCInfo& cinfo, TaskQueue* pTaskQueue = nullptr, IAllocator* pAllocator = nullptr);
+        virtual ~NativeWorld();
+
+        virtual void addEntity(IPhysicsEntity* entity) override;
+        virtual void removeEntity(IPhysicsEntity* entity) override;
+
+        virtual void addCharacter(ICharacterRigidBody* character) override;
+        virtual void removeCharacter(ICharacterRigidBody* character) override;
+
+        virtual Event<ContactPointArgs*>* getContactPointEvent() override { return &m_event_contactPoint; }
+        virtual ArrayPtr<const RigidBodyTransform> getTransforms() const override { return m_transforms.toArray(); }
+
+        virtual void castRay(const RayCastInput& input, RayCastOutput& output) const override;
+        virtual void castRays(ArrayPtr<const RayCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const override;
+        virtual void castShapes(ArrayPtr<const ShapeCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const override;
+        virtual void overlapShapes(ArrayPtr<const OverlapInput> inputs, ArrayPtr<OverlapOutput> outputs) const override;
+
+        /// \brief advances the simulation in fixed steps of 1/60 s
+        void update(float elapsedMilliseconds);
+        /// \brief advances the simulation by one step
+        void step(float deltaSeconds);
+
+        void debugDraw(IDebugRenderer& debugRenderer) const;
+
+        /// \brief writes the transform of a simulated body which was moved by hand
+        void updateTransform(const NativeRigidBody& body);
+
+        /// \brief worker threads for the pairs, the narrowphase and the islands, nullptr to simulate on the calling thread
+        inline void setTaskQueue(TaskQueue* pTaskQueue) { m_pTaskQueue = pTaskQueue; }
+        inline size_t getNumBodies() const { return m_bodies.length(); }
+        inline size_t getNumContacts() const { return m_contacts.length(); }
+        inline size_t getNumIslands() const { return m_islands.length(); }
+        inline const AabbTree& getBroadphase() const { return m_broadphase; }
+
+    private:
+        struct Pair
+        {
+            uint64 key;
+            NativeRigidBody* pBodyA;
+            NativeRigidBody* pBodyB;
+        };
+
+        /// \brief the contact of two bodies which are close to each other, persists as long as their boxes overlap
+        struct Contact
+        {
+            uint64 key;
+            NativeRigidBody* pBodyA;
+            NativeRigidBody* pBodyB;
+            native::Manifold manifold;
+            /// the points in the local space of body a, to recognize them in the next step
+            vec3 localPoints[native::Manifold::MAX_POINTS];
+            float normalImpulses[native::Manifold::MAX_POINTS];
+            float tangentImpulses[native::Manifold::MAX_POINTS][2];
+            uint16 callbackCounter;
+            bool hasNewPoint;
+        };
+
+        struct Island
+        {
+            uint32 firstConstraint;
+            uint32 numConstraints;
+        };
+
+        /// \brief the collision shapes of the query shapes of one batch, queries with the same shape share the hull
+        class QueryShapes
+        {
+        public:
+            QueryShapes(IAllocator* pAllocator);
+            ~QueryShapes();
+
+            native::CollisionShape get(IShape* pShape);
+
+        private:
+            IAllocator* m_pAllocator;
+            DynamicArray<IShape*> m_shapes;
+            DynamicArray<native::Hull*> m_hulls;
+            DynamicArray<native::CollisionShape> m_collisionShapes;
+        };
+
+        struct PendingOperation
+        {
+            SmartPtr<NativeRigidBody> pBody;
+            bool isAdd;
+        };
+
+        IAllocator* m_pAllocator;
+        TaskQueue* m_pTaskQueue;
+        vec3 m_gravity;
+        float m_linearSlop;
+        float m_sleepLinearVelocity;
+        float m_sleepAngularVelocity;
+        float m_accumulatedSeconds;
+        uint32 m_nextBodyId;
+
+        AabbTree m_broadphase;
+        DynamicArray< SmartPtr<NativeRigidBody> > m_bodies;
+        /// parallel to the bodies
+        DynamicArray<RigidBodyTransform> m_transforms;
+        DynamicArray< SmartPtr<ICharacterRigidBody> > m_characters;
+
+        Mutex m_pairMutex;
+        DynamicArray<Pair> m_pairs;
+        /// sorted by key
+        DynamicArray<Contact> m_contacts;
+        DynamicArray<Contact> m_previousContacts;
+
+        DynamicArray<native::SolverBody> m_solverBodies;
+        DynamicArray<native::ContactConstraint> m_constraints;
+        /// the contact of every constraint
+        DynamicArray<uint32> m_constraintContacts;
+        DynamicArray<Island> m_islands;
+        DynamicArray<uint32> m_islandParents;
+        DynamicArray<uint32> m_islandIndices;
+        DynamicArray<float> m_islandSleepTimes;
+
+        /// set while the contact and simulation callbacks run
+        bool m_isLocked;
+        DynamicArray<PendingOperation> m_pendingOperations;
+
+        Event<ContactPointArgs*> m_event_contactPoint;
+
+        void addBody(NativeRigidBody* pBody);
+        void removeBody(NativeRigidBody* pBody);
+        void flushPendingOperations();
+
+        void integrateVelocities(float deltaSeconds);
+        void updateBroadphase(float deltaSeconds);
+        void findPairs();
+        void updateContacts();
+        void collide(float deltaSeconds);
+        void wakeTouchingBodies();
+        void buildIslands();
+        void solveIslands(float deltaSeconds);
+        void integratePositions(float deltaSeconds);
+        void updateSleeping(float deltaSeconds);
+        void triggerCallbacks();
+
+        uint32 findIslandRoot(uint32 index);
+        bool isQuerying(const NativeRigidBody* pBody) const;
+
+        GEP_DISALLOW_COPY_AND_ASSIGNMENT(NativeWorld);
+    };
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "gepimpl/subsystems/physics/native/manager.h"
+#include "gepimpl/subsystems/physics/native/world.h"
+#include "gepimpl/subsystems/physics/native/entity.h"
+#include "gepimpl/subsystems/physics/native/factory.h"
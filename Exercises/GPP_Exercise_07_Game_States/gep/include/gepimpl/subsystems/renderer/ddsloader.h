@@ -3,6 +3,7 @@
 #include "gep/exception.h"
 #include "gep/ArrayPtr.h"
 #include "gep/ReferenceCounting.h"
+#include "gep/archive.h"
 
 
 #define GEP_MAKEFOURCC(ch0, ch1, ch2, ch3) ((int)ch0) | (((int)ch1) << 8) | (((int)ch2) << 16) | (((int)ch3) << 24)
@@ -18,12 +19,17 @@ namespace gep
         DDSLoadingException(std::string msg) : LoadingError(msg) {}
     };
 
+    /// \brief the mipmaps of a dds file
+    ///
+    /// The mipmaps usually point right into the file, which stays open as long as the data is used.
+    /// They must not be written to, files from archives are mapped read-only.
     class DDSData : public ReferenceCounted
     {
     public:
         typedef ArrayPtr<uint8> mipmap_data_t;
         typedef ArrayPtr<mipmap_data_t> image_data_t;
-        mipmap_data_t memory;
+        mipmap_data_t memory; ///< empty if the mipmaps point into the file
+        FileView file;        ///< the file the mipmaps point into, if they were not copied
         image_data_t imageData;
         ArrayPtr<image_data_t> images;
         IAllocator* pAllocator;
@@ -32,8 +38,17 @@ namespace gep
 
         inline DDSData(IAllocator* pAllocator) : pAllocator(pAllocator){}
         GEP_API virtual ~DDSData();
+
+        /// \brief copies the mipmaps of a single image into new data
+        /// \param width
+        ///   width of the first of the given mipmaps
+        GEP_API static DDSData* copyMipmaps(IAllocator* pAllocator, ArrayPtr<mipmap_data_t> mipmaps, uint32 width, uint32 height);
     };
 
+    /// \brief parses dds files
+    ///
+    /// The header is read and checked once, the mipmaps are views into the file instead of copies.
+    /// A loader has no shared state, so the resource loader threads can parse many textures at the same time.
     class DDSLoader
     {
     public:
@@ -136,6 +151,10 @@ namespace gep
         DDS_HEADER m_header;
         std::string m_filename;
         SmartPtr<DDSData> m_data;
+        uint32 m_numMipmaps;
+        uint32 m_firstMipmap;
+
+        void parse(ArrayPtr<uint8> file, uint32 maxSize);
 
     public:
 
@@ -166,10 +185,37 @@ namespace gep
             return (unsigned int)m_header.dwHeight;
         }
 
+        /// \brief number of mipmaps in the file, including the ones which were skipped
+        inline uint32 getNumMipmaps() const
+        {
+            return m_numMipmaps;
+        }
+
+        /// \brief the mipmap of the file which is the first one in the loaded data
+        inline uint32 getFirstMipmap() const
+        {
+            return m_firstMipmap;
+        }
+
         GEP_API DDSLoader(IAllocator* pAllocator);
         GEP_API ~DDSLoader();
 
-        GEP_API void loadFile(const char* filename);
+        /// \brief loads a dds file
+        ///
+        /// Files from archives are mapped into memory, so the mipmaps are never copied.
+        /// Loose files are read into memory once, if mipmaps are skipped the others are copied so that
+        /// the skipped ones do not stay in memory.
+        /// \param maxSize
+        ///   if not 0, mipmaps larger than this are skipped, the smallest mipmap is always loaded.
+        ///   Width and height of the data are the ones of the first loaded mipmap.
+        GEP_API void loadFile(const char* filename, uint32 maxSize = 0);
+
+        /// \brief parses a dds file which is already in memory
+        ///
+        /// The mipmaps point into the given memory, it has to stay valid as long as the data is used.
+        /// \param name
+        ///   used in error messages
+        GEP_API void loadFromMemory(ArrayPtr<uint8> file, const char* name, uint32 maxSize = 0);
     };
 
 }
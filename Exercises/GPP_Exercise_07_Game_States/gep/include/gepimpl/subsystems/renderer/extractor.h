@@ -9,6 +9,8 @@
 #include "gep/math3d/vec3.h"
 #include "gep/math3d/mat4.h"
 #include "gep/math3d/color.h"
+#include "gep/math3d/frustum.h"
+#include "gep/drawList.h"
 #include "gep/traits.h"
 #include "gep/threading/semaphore.h"
 #include "gep/interfaces/updateFramework.h"
@@ -23,7 +25,7 @@ namespace gep
     {
         Invalid,
         FirstCommand,
-        RenderModel,
+        DrawMeshes,
         Text,
         TextBillboard,
         RenderLines,
@@ -38,16 +40,33 @@ namespace gep
         friend class RendererExtractor;
     private:
         CommandType type;
-        uint16 offsetNext;
+        CommandBase* pNext;
     public:
         CommandType getType() const { return type; }
     };
 
-    struct CommandRenderModel : public CommandBase
+    /// \brief a single mesh of a model, the unit in which the draw list sorts and batches
+    struct MeshDraw
     {
-        static const CommandType TYPE = CommandType::RenderModel;
+        uint64 sortKey;
         ResourcePtr<Model> model;
-        mat4 modelMatrix;
+        uint32 meshIndex;
+        mat4 transform;
+    };
+
+    /// \brief a streamed texture drawn in the extracted frame, see TextureStreaming
+    struct TextureUsage
+    {
+        uint32 streamingId;
+        float screenHeight; ///< estimated size of the texture on screen, relative to the height of the screen
+    };
+
+    /// \brief draws the meshes queued since the last camera change, sorted by their keys
+    struct CommandDrawMeshes : public CommandBase
+    {
+        static const CommandType TYPE = CommandType::DrawMeshes;
+        uint32 firstDraw; /// index into the mesh draws of the pool, see RendererExtractor::getMeshDraws
+        uint32 numDraws;
     };
 
     struct LineInfo {
@@ -127,55 +146,113 @@ namespace gep
         void printText(const vec2& screenPositionNormalized, const char* text, Color color = Color::white()) override;
     };
 
+    /// \brief collects the commands for the renderer
+    ///
+    /// Every thread which extracts writes into a context of its own: a linear command buffer, the queued mesh draws,
+    /// the culling statistics and the camera to cull against. The callbacks run in the order they were registered.
+    /// The ones registered with registerParallelExtractionCallback are collected until the next serial callback,
+    /// then they are spread over the workers of the task queue with the camera set so far, and the worker contexts
+    /// are appended to the main context in a fixed order before the serial callback runs. So the renderer always
+    /// sees the same command stream no matter which worker ran what.
     class RendererExtractor : public IRendererExtractor
     {
     private:
+        /// \brief the camera the models are culled and sorted against
+        struct View
+        {
+            bool hasCullingFrustum;
+            Frustum cullingFrustum;
+            mat4 viewMatrix;
+            float projectionScale;
+        };
+
+        struct Context
+        {
+            GrowingStackAllocator allocator;
+            CommandBase* pFirstCommand;
+            CommandBase* pLastCommand;
+            DynamicArray<MeshDraw> queuedDraws;
+            DrawList drawList;
+            CullingStats cullingStats;
+            DynamicArray<TextureUsage> textureUsages;
+            View view;
+
+            Context(IAllocator* pAllocator);
+            void reset();
+        };
+
         struct Pool
         {
-            StackAllocator* pAllocator;
-            void* pStart;
-            bool hasData;
-
-            inline Pool()
-            {
-                pAllocator = new StackAllocator(true, 1024 * 1024 * 1);
-                pStart = pAllocator->getMarker();
-                hasData = false;
-            }
-
-            inline ~Pool()
-            {
-                DELETE_AND_NULL(pAllocator)
-            }
+            /// the first context belongs to the extracting thread, the others to the groups of parallel callbacks
+            DynamicArray<Context*> contexts;
+            /// the commands of the appended contexts stay in their memory, so every group of the frame gets a new one
+            size_t numUsedContexts;
+            /// the sorted mesh draws of all CommandDrawMeshes in this pool
+            DynamicArray<MeshDraw> meshDraws;
+            /// the contexts take their memory from it
+            IAllocator* pAllocator;
+
+            ~Pool();
+            Context& getContext(size_t index);
+        };
+
+        struct Callback
+        {
+            std::function<void(IRendererExtractor& extractor)> function;
+            bool isParallel;
         };
 
         static const uint32 NUM_POOLS = 2;
+        /// the parallel callbacks are split into at most this many groups, each one with a context of its own
+        static const uint32 MAX_PARALLEL_GROUPS = 32;
+        /// fewer callbacks are not worth a task
+        static const uint32 MIN_CALLBACKS_PER_GROUP = 8;
+
+        /// the context the current thread writes to, only set during the extraction
+        static __declspec(thread) Context* s_pCurrentContext;
 
         Pool m_pools[NUM_POOLS];
-        StackAllocator* m_pCurrentAllocator;
-        CommandBase* m_pLastCommand;
-        DynamicArray<std::function<void(IRendererExtractor& extractor)>> m_callbacks;
+        Pool* m_pPoolToFill;
+        Pool* m_pPoolToRead;
+        DynamicArray<Callback> m_callbacks;
+        DynamicArray<const std::function<void(IRendererExtractor& extractor)>*> m_parallelCallbacks;
         bool m_isExtracting;
         uint32 m_nextPoolToFill;
         uint32 m_nextPoolToRead;
         Semaphore m_fullPoolSync;
         Semaphore m_emptyPoolSync;
         Context2D m_context2d;
+        bool m_cullingEnabled;
+        CullingStats m_lastCullingStats;
 
-
-        void* doMakeCommand(size_t size, CommandType type);
+        Context& getCurrentContext();
+        CallbackId addCallback(std::function<void(IRendererExtractor& extractor)> callback, bool isParallel);
+        void* doMakeCommand(size_t size, CommandType type, bool zeroMemory);
+        void runParallelCallbacks(Pool& pool);
+        void appendContext(Context& target, Context& source);
+        void flushMeshDraws();
     public:
-        RendererExtractor();
+        /// \param pAllocator the contexts take their memory from it, the standard allocator if null
+        RendererExtractor(IAllocator* pAllocator = nullptr);
         ~RendererExtractor();
 
         template <class T>
         T& makeCommand()
         {
             static_assert(std::is_convertible<T*, CommandBase*>::value == true, "the given type is not a renderer extractor command");
-            return *(T*)doMakeCommand(sizeof(T), T::TYPE);
+            return *(T*)doMakeCommand(sizeof(T), T::TYPE, true);
+        }
+
+        /// \brief makes a command without clearing its memory, for commands which set all of their members
+        template <class T>
+        T& makeCommand(DoNotInitialize)
+        {
+            static_assert(std::is_convertible<T*, CommandBase*>::value == true, "the given type is not a renderer extractor command");
+            return *(T*)doMakeCommand(sizeof(T), T::TYPE, false);
         }
 
         virtual CallbackId registerExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback) override;
+        virtual CallbackId registerParallelExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback) override;
         virtual void deregisterExtractionCallback(CallbackId callbackId) override;
         virtual void extract() override;
         virtual IContext2D& getContext2D() override;
@@ -186,7 +263,17 @@ namespace gep
 
         CommandBase* startReadCommands();
         void endReadCommands();
-        CommandBase* nextCommand(CommandBase* lastCommand);
+
+        inline CommandBase* nextCommand(CommandBase* lastCommand)
+        {
+            return lastCommand->pNext;
+        }
+
+        /// \brief the sorted draws of a command from the pool which is currently read
+        inline ArrayPtr<MeshDraw> getMeshDraws(const CommandDrawMeshes& cmd)
+        {
+            return m_pPoolToRead->meshDraws.toArray()(cmd.firstDraw, cmd.firstDraw + cmd.numDraws);
+        }
 
         template <class T>
         static T* command_cast(CommandBase* base)
@@ -195,7 +282,51 @@ namespace gep
             return (T*)base;
         }
 
-        virtual IAllocator* getCurrentAllocator() override { return m_pCurrentAllocator; }
+        virtual IAllocator* getCurrentAllocator() override;
+
+        virtual void setCullingEnabled(bool enabled) override { m_cullingEnabled = enabled; }
+        virtual bool getCullingEnabled() override { return m_cullingEnabled; }
+        virtual CullingStats getCullingStats() override { return m_lastCullingStats; }
+
+        /// \brief the frustum of the current camera to cull against, nullptr if culling is disabled or there is no camera yet
+        inline const Frustum* getCullingFrustum()
+        {
+            auto& view = getCurrentContext().view;
+            return (m_cullingEnabled && view.hasCullingFrustum) ? &view.cullingFrustum : nullptr;
+        }
+
+        /// \brief queues a mesh for drawing
+        ///
+        /// The queued meshes are sorted by their key and emitted as one CommandDrawMeshes
+        /// when the camera changes or the extraction ends.
+        void addMeshDraw(uint64 sortKey, ResourcePtr<Model> model, uint32 meshIndex, const mat4& transform);
+
+        /// \brief distance of a world position in front of the current camera, for the depth part of the sort keys
+        inline float getViewDepth(const vec3& position)
+        {
+            // the camera looks down the negative z axis
+            return -getCurrentContext().view.viewMatrix.transformPosition(position).z;
+        }
+
+        /// \brief counts submitted and culled model nodes for the statistics of the current extraction
+        void addCullingStats(uint32 numSubmitted, uint32 numCulled);
+
+        /// \brief how much of the screen height an object of the given size covers at the given view depth, 0 if there is no camera yet
+        inline float getScreenHeight(float size, float depth)
+        {
+            // the projection maps the visible height at depth 1 to 2
+            return size * getCurrentContext().view.projectionScale * 0.5f / GEP_MAX(depth, 0.01f);
+        }
+
+        /// \brief reports that a streamed texture is drawn in this frame
+        /// \param streamingId
+        ///   TextureStreamer::INVALID_ID for textures which are not streamed, those are ignored
+        void addTextureUsage(uint32 streamingId, float screenHeight);
+
+        /// \brief the streamed textures used in the pool which is currently read
+        inline ArrayPtr<TextureUsage> getTextureUsages()
+        {
+            return m_pPoolToRead->contexts[0]->textureUsages.toArray();
+        }
     };
 }
-
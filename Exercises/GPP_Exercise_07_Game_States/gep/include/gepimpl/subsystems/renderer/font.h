@@ -3,10 +3,11 @@
 #include "gep/container/hashmap.h"
 #include "gep/container/DynamicArray.h"
 #include "gep/interfaces/resourceManager.h"
+#include "gep/glyphAtlas.h"
+#include "gep/textLayout.h"
+#include "gep/archive.h"
 #include "gepimpl/subsystems/renderer/texture2d.h"
 
-// forward declrations for freetype
-
 namespace gep
 {
     //forward declarations
@@ -58,49 +59,53 @@ namespace gep
         virtual const char* getResourceId() override;
     };
 
-    enum class FontHorizontalOrientation
-    {
-        Left,
-        Centered
-    };
-
     /// \brief holds a font
-    class Font : public IResource
+    ///
+    /// The glyphs are rendered with freetype when they are used the first time and put into a glyph atlas,
+    /// so any unicode character the font file has can be printed. Glyphs which have not been used for a while
+    /// are evicted when the atlas is full. The layouts of the printed texts are cached.
+    class Font : public IResource, public ITextGlyphSource
     {
         friend class Texture2DFromFontLoader;
     public:
+        /// \brief size of the glyph atlas texture
+        static const uint32 ATLAS_SIZE = 512;
 
-        struct FontGlyph {
-            int m_width;
-            int m_height;
-            int m_top;
-            int m_left;
-            int m_right;
-            float m_minTexX,m_maxTexX;
-            float m_minTexY,m_maxTexY;
-            float m_fWidth,m_realWidth;
-            ImageData2D* m_data;
+    private:
+        struct Glyph
+        {
+            TextGlyph text;
+            uint32 codepoint;
+            uint32 generation; ///< generation of the atlas in which the texture coordinates were checked the last time
+            bool isEmpty;      ///< white space, not in the atlas
         };
 
-    private:
+        /// the glyphs which are put into the atlas when the font is loaded, they also define the line height
         static const wchar_t* s_charsToLoad;
 
         IFontLoader* m_pLoader;
         uint32 m_id;
-        wchar_t m_startIndex;
-        wchar_t m_endIndex;
-        size_t m_anzChars;
-        DynamicArray<FontGlyph> m_glyphs;
+        DynamicArray<Glyph> m_glyphs;
+        Hashmap<uint32, uint32, DontHashPolicy> m_glyphIndices;
+        GlyphAtlas m_atlas;
+        TextLayoutCache m_layoutCache;
         ResourcePtr<Texture2D> m_pFontTexture;
         std::string m_name;
         int m_maxHeight;
-        ArrayPtr<size_t> m_charAsignment;
+        int m_ascent;
         bool m_isPrintable;
+        bool m_isTextureOutOfDate;
         std::string m_filename;
         int m_size;
 
+        // freetype reads from the file view as long as the face is used
+        void* m_pLibrary;
+        void* m_pFace;
+        FileView m_fileView;
+
         void buildTexture(Texture2D& texture);
-        void buildChar(void* pFace, wchar_t c, size_t num);
+        bool renderGlyph(Glyph& glyph, GlyphAtlas::Region& region);
+        void releaseFace();
 
     public:
         /**
@@ -118,9 +123,14 @@ namespace gep
         * and a 2 component texture coordinate
         * Params:
         *        pFontBuffer = the vertex buffer to add the data to
-        *        pFmt the text to print
+        *        pFmt the text to print, UTF-8 encoded
         */
-        void print(Vertexbuffer& pFontBuffer, const char* text, FontHorizontalOrientation orientation = FontHorizontalOrientation::Left) const;
+        void print(Vertexbuffer& pFontBuffer, const char* text, FontHorizontalOrientation orientation = FontHorizontalOrientation::Left);
+
+        /// \brief uploads the glyphs which were added to the atlas and starts a new frame for the atlas and the layout cache
+        ///
+        /// Has to be called after the texts of a frame have been printed and before they are drawn.
+        void finishFrame();
 
         /**
         * gets the size of a text in pixels
@@ -130,7 +140,7 @@ namespace gep
         *        fmt = the text
         * Returns: the formated string
         */
-        void getTextSize(int& width, int& height, const char* text) const;
+        void getTextSize(int& width, int& height, const char* text);
 
         /**
         * gets the index of the char at a certain width
@@ -139,7 +149,7 @@ namespace gep
         *        pWidth = the maximum width
         *        pText = the text to check
         */
-        size_t getCharAtWidth(uint32 width, const char* text) const;
+        size_t getCharAtWidth(uint32 width, const char* text);
 
         /**
         * loads a font from a ttf file
@@ -170,5 +180,11 @@ namespace gep
         virtual void unload() override;
         virtual void finalize() override;
         virtual uint32 getFinalizeOptions() override;
+
+        // ITextGlyphSource interface
+        virtual const TextGlyph* getGlyph(uint32 codepoint) override;
+        virtual float getLineHeight() const override { return (float)m_maxHeight; }
+        virtual uint32 getGlyphGeneration() const override { return m_atlas.getGeneration(); }
+        virtual void markShelvesUsed(uint64 shelfMask) override { m_atlas.markShelvesUsed(shelfMask); }
     };
 }
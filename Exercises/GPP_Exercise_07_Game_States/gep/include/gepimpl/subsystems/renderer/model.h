@@ -5,6 +5,7 @@
 #include "gep/interfaces/resourceManager.h"
 #include "gepimpl/subsystems/renderer/shader.h"
 #include "gep/modelloader.h"
+#include "gep/cullingHierarchy.h"
 #include "gep/ReferenceCounting.h" 
 
 struct ID3D11Device;
@@ -94,6 +95,7 @@ namespace gep
         DynamicArray<TextureSlot> m_textures;
         ResourcePtr<Shader> m_pShader;
         ShaderConstant<mat4> m_modelMatrixConstant;
+        ShaderConstant<mat4> m_instanceMatricesConstant;
         ShaderConstant<mat4> m_viewMatrixConstant;
         ShaderConstant<mat4> m_projectionMatrixConstant;
     public:
@@ -127,6 +129,12 @@ namespace gep
             return m_modelMatrixConstant;
         }
 
+        /// \brief the world matrices of all instances of an instanced draw call, only present in shaders which support instancing
+        inline ShaderConstant<mat4>& getInstanceMatricesConstant()
+        {
+            return m_instanceMatricesConstant;
+        }
+
         inline ShaderConstant<mat4>& getViewMatrixConstant()
         {
             return m_viewMatrixConstant;
@@ -139,6 +147,9 @@ namespace gep
 
         void addTexture(ShaderConstant<Texture2D> constant, ResourcePtr<Texture2D> pTexture);
 
+        /// \brief hash of the textures used by this material, equal for materials with the same textures
+        uint32 getTextureSetId();
+
         /**
         * Removes all Textures from a Material
         */
@@ -148,6 +159,19 @@ namespace gep
     class Model : public IModel
     {
     public:
+        /// \brief maximum number of instances in one draw call, has to match MAX_INSTANCES in the shaders
+        static const uint32 MAX_INSTANCES = 64;
+
+        /// \brief the state set by the previous mesh, so that drawing sorted meshes only changes what differs
+        struct DrawState
+        {
+            Shader* pShader;
+            ModelMaterial* pMaterial;
+            Shader* pMaterialShader; ///< shader of pMaterial, only resolved when the material changes
+            Vertexbuffer* pVertexbuffer;
+
+            inline DrawState() : pShader(nullptr), pMaterial(nullptr), pMaterialShader(nullptr), pVertexbuffer(nullptr) {}
+        };
 
         /**
         * Information about a texture needed by the model
@@ -165,6 +189,7 @@ namespace gep
         {
             Vertexbuffer* vertexbuffer;
             uint32 startIndex, numIndices, materialIndex;
+            int32 baseVertex;
 
             ~MeshDrawData();
         };
@@ -176,12 +201,19 @@ namespace gep
         ID3D11Device* m_pDevice;
         ID3D11DeviceContext* m_pDeviceContext;
         IModelLoader* m_pLoader;
-        ResourcePtr<Shader> m_pLastShader;
+        uint32 m_sortId;
+
+        static volatile uint32 s_nextSortId;
 
         Hashmap<const char*, ModelLoader::NodeDrawData*, StringHashPolicy> m_nodeLookup;
         bool m_needsNodeLookup;
 
-        void drawHelper(ID3D11DeviceContext* pContext, mat4 transformation, const ModelLoader::NodeDrawData* pNode, mat4& view, mat4& projection);
+        /// the nodes in the order of the culling hierarchy
+        DynamicArray<const ModelLoader::NodeDrawData*> m_flatNodes;
+        CullingHierarchy m_cullingHierarchy;
+
+        void buildCullingHierarchy();
+        void addToCullingHierarchy(uint32 parent, const mat4& transformation, const ModelLoader::NodeDrawData* pNode);
         void doFindMinMax(mat4 transformation, const ModelLoader::NodeDrawData* pNode, vec3& min, vec3& max);
 
         void doPrintNodes(const ModelLoader::NodeDrawData* node, int depth = 0);
@@ -192,13 +224,18 @@ namespace gep
         * consructor
         * Params:
         *        pManager = the vertex buffer manage to use by this model
+        *        pDevice, pContext = null for models which are only extracted and never drawn
         */
         Model(ID3D11Device* pDevice, ID3D11DeviceContext* pContext);
 
         ~Model();
 
-        /// \brief draws the model
-        void draw(const mat4& modelMatrix, mat4& viewMatrix, mat4& projectionMatrix, ID3D11DeviceContext* pContext);
+        /// \brief draws one mesh of the model once for every transformation
+        ///
+        /// Uses instanced draw calls if the shader of the material supports them.
+        /// \param state
+        ///   the state left by the previous call, is updated
+        void drawMesh(ID3D11DeviceContext* pContext, uint32 meshIndex, ArrayPtr<mat4> transforms, mat4& viewMatrix, mat4& projectionMatrix, DrawState& state);
 
         /// \brief loads the model from a file
         void loadFile(const char* filename);
@@ -208,6 +245,11 @@ namespace gep
         */
         void generateMeshes();
 
+        /// \brief number of meshes in the loaded model data
+        inline size_t getNumMeshes() const {
+            return m_modelLoader.getModelData().meshes.length();
+        }
+
         /**
         * gets the number of materials used
         */
@@ -256,6 +298,9 @@ namespace gep
         */
         void findMinMax(vec3& min, vec3& max);
 
+        /// \brief the hierarchy of node bounds used for culling, in model space
+        inline const CullingHierarchy& getCullingHierarchy() const { return m_cullingHierarchy; }
+
         inline void printNodes() {
             doPrintNodes(m_modelLoader.getModelData().rootNode);
         }
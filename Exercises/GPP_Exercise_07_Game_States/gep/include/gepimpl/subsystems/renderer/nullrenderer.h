@@ -0,0 +1,58 @@
+#pragma once
+#include "gepimpl/subsystems/renderer/renderer.h"
+
+namespace gep
+{
+    //forward declarations
+    class RendererExtractor;
+    struct CommandBase;
+
+    /// \brief renderer without window and GPU, for benchmarking the extraction and the simulation
+    ///
+    /// Consumes the command stream of the renderer extractor like the real renderer does, but instead of drawing
+    /// it checks the commands and counts what would have been drawn. Models are loaded without GPU resources,
+    /// so their culling and sort keys are still computed during the extraction. Textures and shaders are never
+    /// loaded. Derives from Renderer so that the resource loaders, which create their resources through it, keep working.
+    class NullRenderer : public Renderer
+    {
+    public:
+        struct FrameStats
+        {
+            uint32 numCommands;
+            uint32 numMeshDraws;   ///< instances of meshes
+            uint32 numDrawCalls;   ///< instanced draw calls the mesh draws would have been batched into
+            uint32 numLines;
+            uint32 numLines2D;
+            uint32 numTextGlyphs;
+            uint32 numCameras;
+            uint32 numDebugMarkers;
+            uint32 numErrors;      ///< invalid commands, see the log
+            size_t numBytes;       ///< size of the commands and the data they point to
+        };
+
+    private:
+        uint32 m_numFramesToRun;
+        uint32 m_numFrames;
+        FrameStats m_lastFrameStats;
+
+        void consumeCommands(RendererExtractor& extractor, CommandBase* firstCommand, FrameStats& stats);
+        void reportError(FrameStats& stats, const char* message);
+
+    public:
+        NullRenderer(const settings::Video& settings);
+
+        // ISubsystem interface
+        virtual void initialize() override;
+        virtual void destroy() override;
+        virtual void update(float elapsedTime) override;
+
+        // IRenderer interface
+        virtual ResourcePtr<IModel> loadModel(const char* path) override;
+        virtual ResourcePtr<IModel> loadModel(ReferenceCounted* pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices) override;
+        virtual ResourcePtr<IResource> createGeneratedTexture(uint32 width, uint32 height, const char* resourceId, std::function<void(ArrayPtr<uint8>)> generatorFunction) override;
+
+        /// \brief what the commands of the last frame would have drawn
+        inline const FrameStats& getLastFrameStats() const { return m_lastFrameStats; }
+        inline uint32 getNumFrames() const { return m_numFrames; }
+    };
+}
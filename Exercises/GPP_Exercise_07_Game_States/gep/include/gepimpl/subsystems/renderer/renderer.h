@@ -35,9 +35,11 @@ namespace gep
     class Vertexbuffer;
     class Model;
     class RendererExtractor;
+    class TextureStreaming;
     struct CommandBase;
     struct LineInfo;
     struct LineInfo2D;
+    struct MeshDraw;
     namespace settings { struct Video; }
 
     struct RenderTextInfo
@@ -55,12 +57,15 @@ namespace gep
     class Renderer
         : public IRenderer
     {
-    private:
+    protected:
         IDebugRenderer* m_pDebugRenderer;
         uint32 m_width, m_height;
         bool m_vsyncEnabled;
         bool m_requestedVSyncState;
+        Model* m_pDummyModel;
+        volatile uint32 m_dataModelNum;
 
+    private:
         void createWindow();
         void destroyWindow();
         void initD3DDevice();
@@ -68,6 +73,7 @@ namespace gep
         void prepareCommands(RendererExtractor& extractor, CommandBase* firstCommand);
         void executeCommands(RendererExtractor& extractor, CommandBase* firstCommand);
         void execute2DCommands(RendererExtractor& extractor, CommandBase* firstCommand);
+        void drawMeshes(ArrayPtr<MeshDraw> draws);
 
         //windows specific stuff
         HINSTANCE m_hInstance;
@@ -86,7 +92,9 @@ namespace gep
 
         Texture2D* m_pDummyTexture;
         Shader* m_pDummyShader;
-        Model* m_pDummyModel;
+
+        size_t m_textureBudget;
+        TextureStreaming* m_pTextureStreaming;
 
         ResourcePtr<Font> m_pDefaultFont;
 
@@ -123,8 +131,6 @@ namespace gep
         ShaderConstant<Color> m_textBillboardColor;
         ShaderConstant<Texture2D> m_textBillboardTexture;
 
-        volatile uint32 m_dataModelNum;
-
         void BeginDebugMarker(LPCWSTR name);
         void EndDebugMarker();
 
@@ -139,6 +145,9 @@ namespace gep
 
         // Factory methods
         Texture2D* createTexture2D(const char* name, ITexture2DLoader* pLoader, TextureMode mode);
+
+        /// \brief nullptr if there is no texture budget and all mipmaps are loaded right away
+        inline TextureStreaming* getTextureStreaming() { return m_pTextureStreaming; }
         Shader* createShader();
         Model* createModel();
 
@@ -7,6 +7,7 @@
 #include "gep/math3d/mat3.h"
 #include "gep/math3d/mat4.h"
 #include "gep/math3d/color.h"
+#include "gep/ArrayPtr.h"
 
 struct ID3DX11Effect;
 struct ID3D11Device;
@@ -97,6 +98,10 @@ namespace gep
         inline ShaderConstant(){}
         ShaderConstant(const char* name, ResourcePtr<Shader> pShader);
         void set(mat4& value);
+        /// \brief sets the first values.length() elements of a matrix array
+        void setArray(ArrayPtr<mat4> values);
+        /// \brief checks if the shader actually declares a variable with the name of this constant
+        bool isPresent();
     };
 
     template <>
@@ -158,6 +163,9 @@ namespace gep
         ID3D10Blob* m_pByteCode;
         ID3DX11EffectPass* m_pPass;
         Hashmap<uint32, ID3D11InputLayout*, DontHashPolicy> m_inputLayouts;
+        uint32 m_sortId;
+
+        static volatile uint32 s_nextSortId;
 
     public:
         Shader(ID3D11Device* pDevice);
@@ -173,6 +181,12 @@ namespace gep
             return m_pTechnique;
         }
 
+        /// \brief small number which identifies this shader in the sort keys of the draw list
+        inline uint32 getSortId() const
+        {
+            return m_sortId;
+        }
+
         void loadFromFX(const char* filename);
         void use(ID3D11DeviceContext* pContext, Vertexbuffer* pVertexbuffer);
 
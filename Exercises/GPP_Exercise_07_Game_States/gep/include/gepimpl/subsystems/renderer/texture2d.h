@@ -9,6 +9,8 @@ namespace gep
     // forward references
     class Texture2D;
     class Renderer;
+    class TextureStreaming;
+    class DDSData;
 
     /// \brief interface for loading a 2d texture
     class ITexture2DLoader : public IResourceLoader
@@ -64,6 +66,9 @@ namespace gep
     };
 
     /// \brief a 2d texture
+    ///
+    /// If the renderer has a texture budget, textures loaded from dds files are streamed: only their smallest mipmaps
+    /// are loaded at first, the larger ones are loaded and evicted by the TextureStreaming.
     class Texture2D : public IResource
     {
     private:
@@ -79,9 +84,20 @@ namespace gep
         size_t m_gpuWidth, m_gpuHeight;
         ImageFormat m_gpuFormat;
 
+        // streaming
+        TextureStreaming* m_pStreaming;
+        uint32 m_streamingId;
+        bool m_hasNewStreamingInfo;
+        uint32 m_fileWidth, m_fileHeight;
+        uint32 m_numFileMipmaps;
+        uint32 m_firstMipmap; ///< the mipmap of the file which is the first one in the image data
+        uint32 m_bytesPerBlock;
+
+        void upload();
+
     public:
 
-        Texture2D(const char* name, ITexture2DLoader* pLoader, ID3D11Device* pDevice, ID3D11DeviceContext*, TextureMode mode);
+        Texture2D(const char* name, ITexture2DLoader* pLoader, ID3D11Device* pDevice, ID3D11DeviceContext*, TextureMode mode, TextureStreaming* pStreaming = nullptr);
         ~Texture2D();
 
         void createEmpty(uint32 width, uint32 height, ImageFormat format);
@@ -89,6 +105,21 @@ namespace gep
         inline ImageData2D& getImageData() { return m_data; }
         inline void setHasData(bool value) { m_hasData = value; }
         inline ID3D11ShaderResourceView* getResourceView() { return m_pResourceView; }
+        inline const char* getName() const { return m_name.c_str(); }
+
+        /// \brief makes the texture streamed when it is finalized, called by the loader
+        /// \param firstMipmap
+        ///   the mipmap of the file which is the first one in the image data
+        void setStreamingInfo(uint32 fileWidth, uint32 fileHeight, uint32 numFileMipmaps, uint32 firstMipmap, uint32 bytesPerBlock);
+
+        /// \brief id of the texture in the texture streaming, TextureStreamer::INVALID_ID if it is not streamed
+        inline uint32 getStreamingId() const { return m_streamingId; }
+
+        /// \brief replaces the image data by the mipmaps starting at firstMipmap, only called by the texture streaming from the render thread
+        void setStreamedMipmaps(DDSData* pData, uint32 firstMipmap);
+
+        /// \brief drops the mipmaps which are larger than firstMipmap, only called by the texture streaming from the render thread
+        void dropMipmaps(uint32 firstMipmap);
 
         //IResource interface
         virtual IResource* getSuperResource() override;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "gep/textureStreamer.h"
+#include "gep/ArrayPtr.h"
+#include "gep/ReferenceCounting.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/threading/thread.h"
+#include "gep/threading/mutex.h"
+#include "gep/threading/semaphore.h"
+
+namespace gep
+{
+    // forward declarations
+    class Texture2D;
+    class DDSData;
+    class TextureStreamingThread;
+    struct TextureUsage;
+
+    /// \brief loads and evicts the larger mipmaps of streamed textures
+    ///
+    /// The TextureStreamer decides what to do based on the texture usages of the extracted frame, the mipmaps are
+    /// read from the dds files on a thread of its own. Finished loads and evictions are applied to the textures on
+    /// the render thread, which is the only one creating GPU textures.
+    class TextureStreaming
+    {
+        friend class TextureStreamingThread;
+    public:
+        TextureStreaming(size_t budget);
+        ~TextureStreaming();
+
+        void start();
+        void stop(); // stops the loader thread and waits for it, has to be called before the file system goes away
+
+        /// \brief starts streaming a texture, called when the texture is finalized
+        uint32 addTexture(Texture2D* pTexture, uint32 width, uint32 height, uint32 numMipmaps, uint32 bytesPerBlock, uint32 firstMipmap);
+
+        /// \brief stops streaming a texture, a load which is still pending is thrown away when it is done
+        void removeTexture(uint32 id);
+
+        /// \brief applies finished loads, feeds the texture usages of the last frame to the streamer and starts new loads
+        ///
+        /// Has to be called from the render thread.
+        /// \param screenHeight
+        ///   height of the screen in pixels, the usages are relative to it
+        void update(ArrayPtr<TextureUsage> usages, float screenHeight);
+
+        inline size_t getResidentBytes() const { return m_streamer.getResidentBytes(); }
+
+    private:
+        struct Entry
+        {
+            Texture2D* pTexture; ///< nullptr if the id is free
+            uint32 serial;       ///< changes whenever the id is reused, so that old loads can be recognized
+            uint32 width, height;
+            uint32 numMipmaps;
+        };
+
+        struct Load
+        {
+            uint32 id;
+            uint32 serial;
+            std::string filename;
+            uint32 maxSize;
+            uint32 width, height;
+            uint32 numMipmaps;
+            // the result
+            SmartPtr<DDSData> pData;
+            uint32 firstMipmap;
+        };
+
+        TextureStreamer m_streamer;
+        DynamicArray<Entry> m_entries;
+        Mutex m_mutex; ///< protects the streamer and the entries
+        DynamicArray<TextureStreamer::Request> m_loads;
+        DynamicArray<TextureStreamer::Request> m_evictions;
+
+        DynamicArray<Load*> m_requests;
+        DynamicArray<Load*> m_finished;
+        DynamicArray<Load*> m_finishedToApply;
+        Mutex m_queueMutex; ///< protects the requests and the finished loads
+        Semaphore m_requestCounter;
+        TextureStreamingThread* m_pThread;
+        volatile bool m_isRunning;
+
+        bool takeRequest(Load*& pLoad);
+        void load(Load& load);
+    };
+
+    class TextureStreamingThread : public Thread
+    {
+    private:
+        TextureStreaming* m_pStreaming;
+
+    public:
+        TextureStreamingThread(TextureStreaming* pStreaming);
+
+        virtual void run() override;
+    };
+}
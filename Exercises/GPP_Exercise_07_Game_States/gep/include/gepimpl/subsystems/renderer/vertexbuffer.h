@@ -19,7 +19,14 @@ namespace gep
             TANGENT,
             TEXCOORD0,
             BONE_INDICES,
-            BONE_WEIGHTS
+            BONE_WEIGHTS,
+            // packed channels of cooked meshes, see GpuVertexFormat
+            NORMAL_OCTAHEDRAL,
+            BINORMAL_OCTAHEDRAL,
+            TANGENT_OCTAHEDRAL,
+            TEXCOORD0_HALF,
+            BONE_INDICES_16,
+            BONE_WEIGHTS_8
         };
 
         enum class Usage
@@ -33,6 +40,12 @@ namespace gep
             Triangle,
             Line
         };
+
+        enum class IndexFormat
+        {
+            UInt16,
+            UInt32
+        };
     private:
         ID3D11Device* m_pDevice;
         D3D11_BUFFER_DESC m_dataDesc;
@@ -43,9 +56,11 @@ namespace gep
         uint32 m_layoutHash;
         DynamicArray<float> m_data;
         DynamicArray<uint32> m_indices;
+        DynamicArray<uint16> m_indices16;
         uint32 m_elementSize;
         Usage m_usage;
         Primitive m_primitive;
+        IndexFormat m_indexFormat;
         bool m_isDataUploaded;
         bool m_areIndicesUploaded;
         bool m_hasIndexBuffer;
@@ -58,13 +73,29 @@ namespace gep
         uint32 primitiveNumElements(Primitive primitive);
 
     public:
-        Vertexbuffer(ID3D11Device* pDevice, ArrayPtr<DataChannel> dataChannels, Primitive primitive, Usage usage);
+        Vertexbuffer(ID3D11Device* pDevice, ArrayPtr<DataChannel> dataChannels, Primitive primitive, Usage usage,
+                     IndexFormat indexFormat = IndexFormat::UInt32);
         ~Vertexbuffer();
 
         void upload(ID3D11DeviceContext* pDeviceContext);
         void use(ID3D11DeviceContext* pDeviceContext);
         void draw(ID3D11DeviceContext* pDeviceContext);
-        void draw(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices);
+        /// \param startIndex
+        ///   the first index, or the first vertex if there is no index buffer
+        /// \param baseVertex
+        ///   added to each index, so meshes can use their own indices (unused without an index buffer)
+        void draw(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices, int32 baseVertex = 0);
+        /// \brief draws the same range numInstances times, the shader tells the instances apart by SV_InstanceID
+        void drawInstanced(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices, int32 baseVertex, uint32 numInstances);
+
+        /// \brief appends interleaved vertices that already have the layout of this buffer
+        inline void addRawData(ArrayPtr<uint8> vertices)
+        {
+            GEP_ASSERT(vertices.length() % m_elementSize == 0, "data does not match the vertex size", vertices.length(), m_elementSize);
+            size_t cur = m_data.length();
+            m_data.resize(cur + vertices.length() / sizeof(float));
+            memcpy(m_data.toArray().getPtr() + cur, vertices.getPtr(), vertices.length());
+        }
 
         inline void addData(float x, float y)
         {
@@ -95,9 +126,21 @@ namespace gep
 
         inline uint32 getCurrentNumVertices() const { return (uint32)m_data.length() / (m_elementSize / 4); }
         inline DynamicArray<float>& getData() { return m_data; }
-        inline DynamicArray<uint32>& getIndices() { return m_indices; }
+        inline DynamicArray<uint32>& getIndices()
+        {
+            GEP_ASSERT(m_indexFormat == IndexFormat::UInt32, "buffer uses 16 bit indices");
+            return m_indices;
+        }
+        inline DynamicArray<uint16>& getIndices16()
+        {
+            GEP_ASSERT(m_indexFormat == IndexFormat::UInt16, "buffer uses 32 bit indices");
+            return m_indices16;
+        }
+        inline size_t getNumIndices() const { return (m_indexFormat == IndexFormat::UInt16) ? m_indices16.length() : m_indices.length(); }
+        inline IndexFormat getIndexFormat() const { return m_indexFormat; }
         inline const ArrayPtr<D3D11_INPUT_ELEMENT_DESC> getLayout() const { return m_layout; }
         inline uint32 getLayoutHash() const { return m_layoutHash; }
+        /// \brief size of a channel in 32 bit values
         static uint32 getDataChannelSize(DataChannel channel);
     };
 
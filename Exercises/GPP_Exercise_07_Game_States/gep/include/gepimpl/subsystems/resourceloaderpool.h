@@ -0,0 +1,74 @@
+#pragma once
+
+#include "gep/interfaces/resourceManager.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/threading/thread.h"
+#include "gep/threading/mutex.h"
+#include "gep/threading/semaphore.h"
+#include <functional>
+
+namespace gep
+{
+    // forward declarations
+    class ResourceLoaderThread;
+
+    /// \brief loads resources on a pool of threads, in the order of their priority
+    ///
+    /// Requests are only canceled explicitly, by invalidating their resource pointer
+    /// (see IResourceManager::cancelLoading), not when the last pointer to the resource goes away.
+    class GEP_API ResourceLoaderPool
+    {
+        friend class ResourceLoaderThread;
+    public:
+        /// \brief called from a loader thread for every successfully loaded resource
+        typedef std::function<void(ResourcePtr<IResource> ptr, IResource* pResource, IResourceLoader* pLoader)> FinishedCallback;
+
+    private:
+        struct ToLoadInfo
+        {
+            ResourcePtr<IResource> ptr;
+            IResourceLoader* pLoader;
+        };
+        DynamicArray<ToLoadInfo> m_resourcesToLoad[LoadPriority::Count];
+        Mutex m_resourcesToLoadMutex;
+        Semaphore m_toLoadCounter;
+        DynamicArray<ResourceLoaderThread*> m_threads;
+        FinishedCallback m_onFinished;
+        volatile bool m_isRunning;
+
+        // takes the oldest request with the highest priority
+        bool takeNext(ToLoadInfo& info);
+        // the queue and position of a request which was not taken yet, m_resourcesToLoadMutex has to be locked
+        bool findQueued(const char* resourceId, int& priority, size_t& index);
+        void load(ToLoadInfo& info);
+
+    public:
+        ResourceLoaderPool(uint32 numThreads, FinishedCallback onFinished);
+        ~ResourceLoaderPool();
+
+        void start();
+        void stop(); // stops all loader threads and waits for them
+
+        /// \brief queues a request, takes ownership of the loader
+        ///
+        /// A resource is only queued once. Requesting it again while it waits only raises its priority,
+        /// a canceled request for the same resource id is replaced.
+        void loadResource(ResourcePtr<IResource> ptr, IResourceLoader* pLoader, LoadPriority::Enum priority);
+
+        /// \brief moves a pending request for the given resource id to a higher priority
+        void raisePriority(const char* resourceId, LoadPriority::Enum priority);
+
+        inline uint32 getNumThreads() const { return uint32(m_threads.length()); }
+    };
+
+    class ResourceLoaderThread : public Thread
+    {
+    private:
+        ResourceLoaderPool* m_pPool;
+
+    public:
+        ResourceLoaderThread(ResourceLoaderPool* pPool);
+
+        virtual void run() override;
+    };
+}
@@ -4,15 +4,13 @@
 #include "gep/container/hashmap.h"
 #include "gep/container/DynamicArray.h"
 #include "gep/directory.h"
+#include "gep/archive.h"
 #include "gep/threading/thread.h"
-#include "gep/container/queue.h"
 #include "gep/threading/semaphore.h"
+#include "gepimpl/subsystems/resourceLoaderPool.h"
 
 namespace gep
 {
-    // forward declarations
-    class ResourceLoaderThread;
-
     class ResourceManager
         : public IResourceManager
     {
@@ -41,9 +39,10 @@ namespace gep
         Mutex m_newResourceMutex;
         DynamicArray<PatchInfo> m_resourcesToPatch;
         Mutex m_patchResourceMutex;
-        ResourceLoaderThread* m_pResourceLoader;
+        ResourceLoaderPool* m_pResourceLoader;
         Mutex m_loadingResourceMutex;
         DirectoryWatcher m_dataDirWatcher;
+        VirtualFileSystem m_fileSystem;
         float m_timeSinceLastCheck;
         uint32 m_updateNum;
 
@@ -52,7 +51,7 @@ namespace gep
         hkLoader* m_pHkResourceLoader;
 
     protected:
-        virtual ResourcePtr<IResource> doLoadResource(IResourceLoader& loader, LoadAsync loadAsync) override;
+        virtual ResourcePtr<IResource> doLoadResource(IResourceLoader& loader, LoadAsync loadAsync, LoadPriority::Enum priority) override;
 
     public:
         ResourceManager();
@@ -72,6 +71,8 @@ namespace gep
         virtual void registerLoaderForReload(const std::string& filename, IResourceLoader* pLoader, ResourcePtr<IResource> pResource) override;
         virtual void deregisterLoaderForReload(const std::string& filename, IResourceLoader* pLoader) override;
         virtual void reloadResource(ResourcePtr<IResource> pResource);
+        virtual void cancelLoading(ResourcePtr<IResource> pResource) override;
+        virtual VirtualFileSystem& getFileSystem() override { return m_fileSystem; }
 
         void resourceFinishedLoading(ResourcePtr<IResource> ptr, IResource* pResource, IResourceLoader* pLoader);
 
@@ -80,29 +81,4 @@ namespace gep
     };
 
 #define g_resourceManager (*static_cast<ResourceManager*>(g_globalManager.getResourceManager()))
-
-    class ResourceLoaderThread : public Thread
-    {
-    private:
-        struct ToLoadInfo
-        {
-            ResourcePtr<IResource> ptr;
-            IResourceLoader* pLoader;
-        };
-        Queue<ToLoadInfo, MutexLockPolicy> m_resourcesToLoad;
-        Semaphore m_toLoadCounter;
-        ResourceManager* m_pResourceManager;
-        bool m_isRunning;
-
-    public:
-
-        ResourceLoaderThread(ResourceManager* pResourceManager);
-        ~ResourceLoaderThread();
-
-        void loadResource(ResourcePtr<IResource> ptr, IResourceLoader* pLoader);
-
-        virtual void run() override;
-
-        void stop(); // stops the resource loader thread
-    };
 }
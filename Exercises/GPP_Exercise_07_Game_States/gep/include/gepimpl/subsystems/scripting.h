@@ -2,6 +2,7 @@
 
 #include "gep/interfaces/scripting.h"
 #include "gep/container/DynamicArray.h"
+#include "gep/scripting/luaProfiler.h"
 
 namespace gep
 {
@@ -11,7 +12,8 @@ namespace gep
     {
     public:
 
-        ScriptingManager(const std::string& scriptsRoot = "data/scripts/", const std::string& importantScriptsRoot = "data/base/");
+        /// \param pAllocator allocator of the Lua state, the standard allocator if null
+        ScriptingManager(IAllocatorStatistics* pAllocator = nullptr, const std::string& scriptsRoot = "data/scripts/", const std::string& importantScriptsRoot = "data/base/");
         virtual ~ScriptingManager();
         
         /// \brief IScriptingManager interface
@@ -39,19 +41,39 @@ namespace gep
 
         virtual void debugBreak(const char* message) const override;
 
+        virtual void setProfilingEnabled(bool enabled) override;
+        virtual bool isProfilingEnabled() const override;
+        virtual void exportProfile(const std::string& samplesFileName, const std::string& cFunctionTimesFileName) override;
+
+        virtual ScriptStatePool* getStatePool() override { return m_pStatePool; }
+        virtual void loadPooledScript(const std::string& filename, LoadOptions::Enum loadOptions = LoadOptions::Default) override;
+        virtual void addPooledObject(const std::string& objectName, const std::string& updateFunction) override;
+        virtual void removePooledObject(const std::string& objectName) override;
+        virtual void sendPooledMessage(const std::string& objectName, const std::string& name, const std::string& data) override;
+
         void makeBasicBindings();
 
+        /// \brief Creates the pooled states and binds the basic types in them.
+        /// Everything else has to be bound with bindPooled.
+        void createStatePool(size_t numStates);
+
     private:
         IAllocatorStatistics* m_pAllocator;
 
         lua_State* m_L;
         State m_state;
+        lua::Profiler* m_pProfiler;
+        ScriptStatePool* m_pStatePool;
 
         std::string m_scriptsRoot;
         std::string m_importantScriptsRoot;
 
         gep::DynamicArray<std::string> m_scriptsToLoad;
 
+        void makePooledBindings();
+        static void makeEnumTable(lua_State* L, const char* enumName, va_list values);
+        void dispatchPooledMessage(const ScriptMessage& message);
+
         std::string constructFileName(const std::string& filename, LoadOptions::Enum loadOptions = LoadOptions::Default);
 
         virtual void setState(State state) override { m_state = state; }
@@ -0,0 +1,447 @@
+#include "stdafx.h"
+#include "gep/archive.h"
+#include "gep/container/hashmap.h"
+#include "gep/memory/allocator.h"
+#include "gep/exception.h"
+#include "gep/file.h"
+#include "gep/utils.h"
+#include <algorithm>
+
+namespace
+{
+    gep::uint32 hashPath(const std::string& normalizedPath)
+    {
+        return gep::hashOf(normalizedPath.c_str(), normalizedPath.length());
+    }
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+std::string gep::archive::normalizePath(const char* path)
+{
+    std::string result(path);
+    for(auto& c : result)
+    {
+        if(c == '\\')
+            c = '/';
+        else
+            c = (char)tolower((unsigned char)c);
+    }
+    if(result.compare(0, 2, "./") == 0)
+        result.erase(0, 2);
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::MemoryMappedFile::MemoryMappedFile() :
+    m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr),
+    m_data()
+{
+}
+
+gep::MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+gep::Result gep::MemoryMappedFile::open(const char* filename)
+{
+    GEP_ASSERT(!isOpen(), "file is already open");
+
+    m_fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if(m_fileHandle == INVALID_HANDLE_VALUE)
+        return FAILURE;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(m_fileHandle, &size) || size.QuadPart == 0)
+    {
+        close();
+        return FAILURE;
+    }
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mappingHandle == nullptr)
+    {
+        close();
+        return FAILURE;
+    }
+
+    auto pView = static_cast<uint8*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(pView == nullptr)
+    {
+        close();
+        return FAILURE;
+    }
+    m_data = ArrayPtr<uint8>(pView, static_cast<size_t>(size.QuadPart));
+    return SUCCESS;
+}
+
+void gep::MemoryMappedFile::close()
+{
+    if(m_data.getPtr() != nullptr)
+    {
+        UnmapViewOfFile(m_data.getPtr());
+        m_data = ArrayPtr<uint8>();
+    }
+    if(m_mappingHandle != nullptr)
+    {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if(m_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::PackedArchive::PackedArchive() :
+    m_names(nullptr)
+{
+}
+
+gep::PackedArchive::~PackedArchive()
+{
+    close();
+}
+
+void gep::PackedArchive::open(const char* filename)
+{
+    GEP_ASSERT(!isOpen(), "archive is already open");
+    m_filename = filename;
+
+    if(m_file.open(filename) != SUCCESS)
+    {
+        throw LoadingError(format("Couldn't map archive '%s'", filename));
+    }
+
+    auto data = m_file.getData();
+    if(data.length() < sizeof(archive::Header))
+    {
+        close();
+        throw LoadingError(format("The file '%s' is to small to be an archive", filename));
+    }
+
+    auto& header = *reinterpret_cast<const archive::Header*>(data.getPtr());
+    if(header.magic != archive::MAGIC)
+    {
+        close();
+        throw LoadingError(format("The file '%s' is not an archive", filename));
+    }
+    if(header.version != archive::VERSION)
+    {
+        close();
+        throw LoadingError(format("The archive '%s' has version %u, expected %u. Please repack", filename, header.version, archive::VERSION));
+    }
+    // written so that huge values from a corrupt file can't overflow
+    const uint64 fileSize = data.length();
+    if(header.entriesOffset > fileSize ||
+       header.numEntries > (fileSize - header.entriesOffset) / sizeof(archive::Entry) ||
+       header.namesOffset > fileSize)
+    {
+        close();
+        throw LoadingError(format("The table of contents of archive '%s' is corrupt", filename));
+    }
+
+    m_entries = ArrayPtr<archive::Entry>(reinterpret_cast<archive::Entry*>(data.getPtr() + header.entriesOffset), header.numEntries);
+    m_names = reinterpret_cast<const char*>(data.getPtr() + header.namesOffset);
+
+    // lookups hand out the ranges without checking them again
+    const uint64 namesSize = fileSize - header.namesOffset;
+    for(size_t i = 0; i < m_entries.length(); i++)
+    {
+        auto& entry = m_entries[i];
+        if(entry.offset > fileSize || entry.size > fileSize - entry.offset ||
+           entry.nameOffset > namesSize || entry.nameLength > namesSize - entry.nameOffset ||
+           (i > 0 && entry.pathHash < m_entries[i - 1].pathHash))
+        {
+            close();
+            throw LoadingError(format("Entry %u of archive '%s' is corrupt", uint32(i), filename));
+        }
+    }
+}
+
+void gep::PackedArchive::close()
+{
+    m_entries = ArrayPtr<archive::Entry>();
+    m_names = nullptr;
+    m_file.close();
+}
+
+const gep::archive::Entry* gep::PackedArchive::find(const char* path) const
+{
+    auto normalizedPath = archive::normalizePath(path);
+    auto hash = hashPath(normalizedPath);
+
+    auto first = m_entries.getPtr();
+    auto last = first + m_entries.length();
+    auto it = std::lower_bound(first, last, hash, [](const archive::Entry& entry, uint32 hash){
+        return entry.pathHash < hash;
+    });
+
+    // entries with the same hash are next to each other, compare the names to resolve collisions
+    for(; it != last && it->pathHash == hash; ++it)
+    {
+        if(it->nameLength == normalizedPath.length() &&
+           memcmp(m_names + it->nameOffset, normalizedPath.c_str(), it->nameLength) == 0)
+        {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+bool gep::PackedArchive::contains(const char* path) const
+{
+    return isOpen() && find(path) != nullptr;
+}
+
+gep::Result gep::PackedArchive::tryGetFile(const char* path, ArrayPtr<uint8>& data) const
+{
+    if(!isOpen())
+        return FAILURE;
+    auto pEntry = find(path);
+    if(pEntry == nullptr)
+        return FAILURE;
+    data = ArrayPtr<uint8>(m_file.getData().getPtr() + pEntry->offset, static_cast<size_t>(pEntry->size));
+    return SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::ArchiveWriter::ArchiveWriter(uint32 alignment) :
+    m_alignment(alignment)
+{
+    GEP_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0, "alignment has to be a power of two", alignment);
+}
+
+void gep::ArchiveWriter::addFile(const char* archivePath, const char* filename)
+{
+    FileInfo info;
+    info.archivePath = archive::normalizePath(archivePath);
+    info.filename = filename;
+    m_files.append(info);
+}
+
+void gep::ArchiveWriter::addDirectory(const char* directory)
+{
+    std::string pattern = std::string(directory) + "\\*";
+    WIN32_FIND_DATAA findData;
+    HANDLE findHandle = FindFirstFileA(pattern.c_str(), &findData);
+    if(findHandle == INVALID_HANDLE_VALUE)
+    {
+        throw Exception(format("Couldn't open directory '%s'", directory));
+    }
+    SCOPE_EXIT{ FindClose(findHandle); });
+
+    do
+    {
+        if(strcmp(findData.cFileName, ".") == 0 || strcmp(findData.cFileName, "..") == 0)
+            continue;
+
+        std::string path = std::string(directory) + "\\" + findData.cFileName;
+        if(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            addDirectory(path.c_str());
+        else
+            addFile(path.c_str(), path.c_str());
+    }
+    while(FindNextFileA(findHandle, &findData));
+}
+
+void gep::ArchiveWriter::write(const char* filename)
+{
+    RawFile output(filename, "wb");
+    if(!output.isOpen())
+    {
+        throw Exception(format("Couldn't open '%s' for writing", filename));
+    }
+
+    archive::Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = archive::MAGIC;
+    header.version = archive::VERSION;
+    header.alignment = m_alignment;
+    header.numEntries = static_cast<uint32>(m_files.length());
+    output.write(header);
+
+    DynamicArray<archive::Entry> entries;
+    entries.reserve(m_files.length());
+    std::string names;
+
+    const uint8 zeros[256] = {};
+    DynamicArray<uint8> buffer;
+    size_t position = sizeof(header);
+    for(auto& file : m_files)
+    {
+        RawFile input(file.filename.c_str(), "rb");
+        if(!input.isOpen())
+        {
+            throw Exception(format("Couldn't open '%s' for packing", file.filename.c_str()));
+        }
+        buffer.resize(input.getSize());
+        if(input.readArray(buffer.toArray().getPtr(), buffer.length()) != buffer.length())
+        {
+            throw Exception(format("Couldn't read '%s' for packing", file.filename.c_str()));
+        }
+
+        auto alignedPosition = alignUp(position, m_alignment);
+        for(auto padding = alignedPosition - position; padding > 0; )
+        {
+            auto chunk = GEP_MIN(padding, sizeof(zeros));
+            output.writeArray(zeros, chunk);
+            padding -= chunk;
+        }
+        output.writeArray(buffer.toArray().getPtr(), buffer.length());
+
+        archive::Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.pathHash = hashPath(file.archivePath);
+        entry.nameOffset = static_cast<uint32>(names.length());
+        entry.nameLength = static_cast<uint32>(file.archivePath.length());
+        entry.offset = alignedPosition;
+        entry.size = buffer.length();
+        entries.append(entry);
+        names += file.archivePath;
+
+        position = alignedPosition + buffer.length();
+    }
+
+    std::sort(entries.toArray().getPtr(), entries.toArray().getPtr() + entries.length(),
+        [](const archive::Entry& lhs, const archive::Entry& rhs){ return lhs.pathHash < rhs.pathHash; });
+
+    // keep the table of contents 8 byte aligned
+    auto entriesPosition = alignUp(position, 8);
+    output.writeArray(zeros, entriesPosition - position);
+    header.entriesOffset = entriesPosition;
+    output.writeArray(entries.toArray().getPtr(), entries.length());
+    header.namesOffset = entriesPosition + entries.length() * sizeof(archive::Entry);
+    output.writeArray(names.c_str(), names.length());
+
+    output.seek(0);
+    output.write(header);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::FileView::FileView() :
+    m_data(),
+    m_isOwned(false)
+{
+}
+
+gep::FileView::~FileView()
+{
+    release();
+}
+
+void gep::FileView::release()
+{
+    if(m_isOwned)
+    {
+        GEP_DELETE_ARRAY(g_stdAllocator, m_data);
+    }
+    m_data = ArrayPtr<uint8>();
+    m_isOwned = false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::VirtualFileSystem::VirtualFileSystem() :
+    m_archives(),
+    m_looseFilesFirst(true)
+{
+}
+
+gep::VirtualFileSystem::~VirtualFileSystem()
+{
+    unmountAll();
+}
+
+void gep::VirtualFileSystem::mountArchive(const char* filename)
+{
+    auto pArchive = new PackedArchive();
+    try
+    {
+        pArchive->open(filename);
+    }
+    catch(...)
+    {
+        delete pArchive;
+        throw;
+    }
+    m_archives.append(pArchive);
+}
+
+void gep::VirtualFileSystem::unmountAll()
+{
+    for(auto pArchive : m_archives)
+    {
+        delete pArchive;
+    }
+    m_archives.clear();
+}
+
+bool gep::VirtualFileSystem::exists(const char* path) const
+{
+    if(fileExists(path))
+        return true;
+    for(auto pArchive : m_archives)
+    {
+        if(pArchive->contains(path))
+            return true;
+    }
+    return false;
+}
+
+gep::Result gep::VirtualFileSystem::open(const char* path, FileView& view) const
+{
+    view.release();
+    if(m_looseFilesFirst)
+    {
+        if(openLooseFile(path, view) == SUCCESS)
+            return SUCCESS;
+        return openFromArchives(path, view);
+    }
+    if(openFromArchives(path, view) == SUCCESS)
+        return SUCCESS;
+    return openLooseFile(path, view);
+}
+
+gep::Result gep::VirtualFileSystem::openFromArchives(const char* path, FileView& view) const
+{
+    for(size_t i = m_archives.length(); i > 0; --i)
+    {
+        if(m_archives[i - 1]->tryGetFile(path, view.m_data) == SUCCESS)
+        {
+            view.m_isOwned = false;
+            return SUCCESS;
+        }
+    }
+    return FAILURE;
+}
+
+gep::Result gep::VirtualFileSystem::openLooseFile(const char* path, FileView& view) const
+{
+    RawFile file(path, "rb");
+    if(!file.isOpen())
+        return FAILURE;
+
+    auto size = file.getSize();
+    auto data = GEP_NEW_ARRAY(g_stdAllocator, uint8, size);
+    if(file.readArray(data.getPtr(), size) != size)
+    {
+        GEP_DELETE_ARRAY(g_stdAllocator, data);
+        return FAILURE;
+    }
+    view.m_data = data;
+    view.m_isOwned = true;
+    return SUCCESS;
+}
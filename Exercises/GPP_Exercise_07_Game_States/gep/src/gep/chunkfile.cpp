@@ -6,30 +6,137 @@ gep::Chunkfile::Chunkfile(const char* filename, Operation operation)
       m_filename = filename;
       m_operation = operation;
       m_readLocation = nullptr;
+      m_version = 0;
       switch(m_operation)
       {
       case Operation::read:
-          m_file.open(filename, "rb");
+          openForReading();
           break;
       case Operation::write:
           m_file.open(filename, "wb");
           break;
       case Operation::modify:
           m_file.open(filename, "rb");
-          m_oldData = GEP_NEW_ARRAY(g_stdAllocator, uint8, m_file.getSize());
-          m_readLocation = m_oldData.getPtr();
-          m_file.readArray(m_oldData.getPtr(), m_oldData.length());
+          m_ownedData = GEP_NEW_ARRAY(g_stdAllocator, uint8, m_file.getSize());
+          m_file.readArray(m_ownedData.getPtr(), m_ownedData.length());
           m_file.close();
           m_file.open(filename, "wb");
+          m_oldData = m_ownedData;
+          m_readLocation = m_oldData.getPtr();
+          readChunkIndex();
           break;
       }
 }
 
+gep::Chunkfile::Chunkfile(const char* filename, ArrayPtr<uint8> data)
+{
+    m_filename = filename;
+    m_operation = Operation::read;
+    m_version = 0;
+    m_oldData = data;
+    m_readLocation = m_oldData.getPtr();
+    readChunkIndex();
+}
+
 gep::Chunkfile::~Chunkfile()
 {
     GEP_ASSERT(m_readInfo.length() == 0, "there are still chunks open for reading");
     GEP_ASSERT(m_writeInfo.length() == 0, "there are still chunks open for writing");
-    GEP_DELETE_ARRAY(g_stdAllocator, m_oldData);
+    if(m_ownedData.getPtr() != nullptr)
+    {
+        GEP_DELETE_ARRAY(g_stdAllocator, m_ownedData);
+    }
+}
+
+void gep::Chunkfile::openForReading()
+{
+    if(m_mappedFile.open(m_filename.c_str()) == SUCCESS)
+    {
+        m_oldData = m_mappedFile.getData();
+    }
+    else
+    {
+        // mapping fails for empty files and on some network drives, read everything at once instead
+        RawFile file(m_filename.c_str(), "rb");
+        size_t size = file.isOpen() ? file.getSize() : 0;
+        if(size > 0)
+        {
+            m_ownedData = GEP_NEW_ARRAY(g_stdAllocator, uint8, size);
+            if(file.readArray(m_ownedData.getPtr(), size) != size)
+            {
+                GEP_DELETE_ARRAY(g_stdAllocator, m_ownedData);
+            }
+        }
+        m_oldData = m_ownedData;
+    }
+    m_readLocation = m_oldData.getPtr();
+    readChunkIndex();
+}
+
+void gep::Chunkfile::readChunkIndex()
+{
+    // Layout: [top level chunk][chunkindex chunk][uint32 offset of the chunkindex chunk][CHUNK_INDEX_MAGIC]
+    const size_t footerSize = 2 * sizeof(uint32);
+    if(m_oldData.length() < footerSize)
+        return;
+    uint32 footer[2];
+    memcpy(footer, m_oldData.getPtr() + m_oldData.length() - footerSize, footerSize);
+    if(footer[1] != CHUNK_INDEX_MAGIC || footer[0] >= m_oldData.length() - footerSize)
+        return;
+
+    // the index is not part of the file content, when modifying it is dropped
+    ArrayPtr<uint8> fileData = m_oldData;
+    m_oldData = ArrayPtr<uint8>(fileData.getPtr(), footer[0]);
+    if(m_operation != Operation::read)
+        return;
+
+    m_oldData = ArrayPtr<uint8>(fileData.getPtr(), fileData.length() - footerSize);
+    m_readLocation = m_oldData.getPtr() + footer[0];
+    SCOPE_EXIT
+    {
+        m_readInfo.clear();
+        m_oldData = ArrayPtr<uint8>(fileData.getPtr(), footer[0]);
+        m_readLocation = m_oldData.getPtr();
+    });
+
+    uint32 numEntries = 0;
+    if(startReadChunk() != SUCCESS || getCurrentChunkName() != "chunkindex" || read(numEntries) != sizeof(numEntries))
+        return;
+    m_index.reserve(numEntries);
+    for(uint32 i = 0; i < numEntries; i++)
+    {
+        ChunkIndexEntry entry;
+        bool valid = read(entry.nameLength) == sizeof(entry.nameLength) && entry.nameLength <= MAX_CHUNK_NAME_LENGTH &&
+                     readArray(ArrayPtr<char>(entry.name, entry.nameLength)) == entry.nameLength &&
+                     read(entry.parent) == sizeof(entry.parent) &&
+                     read(entry.headerOffset) == sizeof(entry.headerOffset) &&
+                     read(entry.length) == sizeof(entry.length);
+        if(!valid || entry.parent >= (int32)i || entry.getDataEnd() > footer[0] ||
+           (entry.parent >= 0 && entry.getDataEnd() > m_index[entry.parent].getDataEnd()))
+        {
+            GEP_ASSERT(false, "invalid chunk index", m_filename);
+            m_index.clear();
+            return;
+        }
+        entry.nextSamePath = -1;
+        m_index.append(entry);
+    }
+
+    // link the entries with the same path, the lookup ends up pointing to the first one
+    DynamicArray<std::string> paths;
+    paths.resize(m_index.length());
+    for(size_t i = 0; i < m_index.length(); i++)
+    {
+        auto& entry = m_index[i];
+        std::string name(entry.name, entry.nameLength);
+        paths[i] = entry.parent >= 0 ? paths[entry.parent] + "/" + name : name;
+    }
+    for(size_t i = m_index.length(); i > 0; i--)
+    {
+        uint32 next;
+        m_index[i - 1].nextSamePath = m_indexLookup.tryGet(paths[i - 1], next) == SUCCESS ? (int32)next : -1;
+        m_indexLookup[paths[i - 1]] = (uint32)(i - 1);
+    }
 }
 
 void gep::Chunkfile::discardChanges()
@@ -37,7 +144,7 @@ void gep::Chunkfile::discardChanges()
     GEP_ASSERT(m_operation == Operation::modify, "discarding only possible when modifying");
     m_file.close();
     m_file.open(m_filename.c_str(), "wb");
-    m_file.writeArray(m_oldData.getPtr(), m_oldData.length());
+    m_file.writeArray(m_ownedData.getPtr(), m_ownedData.length());
     m_file.close();
 }
 
@@ -87,11 +194,68 @@ void gep::Chunkfile::endReadChunk()
     m_readInfo.removeLastElement();
 }
 
+gep::Result gep::Chunkfile::seekToChunk(const char* path, uint32 occurrence)
+{
+    GEP_ASSERT(m_operation == Operation::read, "seeking is only possible in read operation");
+    uint32 entryIndex;
+    if(m_indexLookup.tryGet(path, entryIndex) != SUCCESS)
+        return FAILURE;
+    for(; occurrence > 0; occurrence--)
+    {
+        if(m_index[entryIndex].nextSamePath < 0)
+            return FAILURE;
+        entryIndex = m_index[entryIndex].nextSamePath;
+    }
+
+    auto& entry = m_index[entryIndex];
+    size_t depth = 0;
+    for(int32 parent = entry.parent; parent >= 0; parent = m_index[parent].parent)
+        depth++;
+
+    // open the parents, each one ends where it would if we had read up to the chunk
+    m_readInfo.resize(depth);
+    for(int32 parent = entry.parent; parent >= 0; parent = m_index[parent].parent)
+    {
+        auto& parentEntry = m_index[parent];
+        auto& info = m_readInfo[--depth];
+        memcpy(info.name, parentEntry.name, parentEntry.nameLength);
+        info.nameLength = parentEntry.nameLength;
+        // readChunkIndex made sure that the chunks end inside the file
+        info.bytesLeft = static_cast<uint32>(parentEntry.getDataEnd() - entry.headerOffset);
+    }
+    m_readLocation = m_oldData.getPtr() + entry.headerOffset;
+    return SUCCESS;
+}
+
+gep::uint32 gep::Chunkfile::getNumChunks(const char* path)
+{
+    uint32 entryIndex;
+    if(m_indexLookup.tryGet(path, entryIndex) != SUCCESS)
+        return 0;
+    uint32 count = 1;
+    for(int32 next = m_index[entryIndex].nextSamePath; next >= 0; next = m_index[next].nextSamePath)
+        count++;
+    return count;
+}
+
 void gep::Chunkfile::startWriteChunk(const char* name)
 {
     GEP_ASSERT(strlen(name) <= MAX_CHUNK_NAME_LENGTH, "chunk name is to long");
-    writeArrayWithLength<char, uint8>(ArrayPtr<char>((char*)name, strlen(name)));
     ChunkWriteInfo info;
+    if(m_operation == Operation::write)
+    {
+        // the chunks copied with keepRestOfCurrentChunk are unknown, so only new files get an index
+        ChunkIndexEntry entry;
+        entry.nameLength = static_cast<uint8>(strlen(name));
+        memcpy(entry.name, name, entry.nameLength);
+        entry.parent = m_writeInfo.length() > 0 ? (int32)m_writeInfo.lastElement().indexEntry : -1;
+        entry.headerOffset = static_cast<uint32>(m_file.position());
+        entry.length = 0;
+        entry.nextSamePath = -1;
+        info.indexEntry = static_cast<uint32>(m_index.length());
+        m_index.append(entry);
+    }
+    writeArrayWithLength<char, uint8>(ArrayPtr<char>((char*)name, strlen(name)));
     info.lengthPosition = m_file.position();
     write<uint32>(0);
     m_writeInfo.append(info);
@@ -104,6 +268,8 @@ size_t gep::Chunkfile::endWriteChunk()
     m_file.seek(m_writeInfo.lastElement().lengthPosition);
     m_file.write<uint32>(static_cast<uint32>(length));
     m_file.seekEnd();
+    if(m_operation == Operation::write)
+        m_index[m_writeInfo.lastElement().indexEntry].length = static_cast<uint32>(length);
     m_writeInfo.removeLastElement();
     if(m_writeInfo.length() > 0)
         m_writeInfo.lastElement().length += length;
@@ -126,15 +292,8 @@ void gep::Chunkfile::skipRead(size_t bytes)
 {
     GEP_ASSERT(m_operation != Operation::write, "can not read in write operation");
     GEP_ASSERT(m_readInfo.length() == 0 || m_readInfo.lastElement().bytesLeft >= bytes, "reading over chunk boundary");
-    if(m_operation == Operation::read)
-    {
-        m_file.skip(bytes);
-    }
-    else
-    {
-        GEP_ASSERT(m_readLocation + bytes <= m_oldData.getPtr() + m_oldData.length(), "out of bounds");
-        m_readLocation += bytes;
-    }
+    GEP_ASSERT(m_readLocation + bytes <= m_oldData.getPtr() + m_oldData.length(), "out of bounds");
+    m_readLocation += bytes;
     if(m_readInfo.length() > 0)
         m_readInfo.lastElement().bytesLeft -= (uint32)bytes;
 }
@@ -142,18 +301,9 @@ void gep::Chunkfile::skipRead(size_t bytes)
 void gep::Chunkfile::skipCurrentChunk()
 {
     GEP_ASSERT(m_operation != Operation::write, "can not skip chunks in write operation");
-    if(m_operation == Operation::read)
-    {
-        m_file.skip(m_readInfo.lastElement().bytesLeft);
-        m_readInfo.lastElement().bytesLeft = 0;
-        endReadChunk();
-    }
-    else
-    {
-        m_readLocation += m_readInfo.lastElement().bytesLeft;
-        m_readInfo.lastElement().bytesLeft = 0;
-        endReadChunk();
-    }
+    m_readLocation += m_readInfo.lastElement().bytesLeft;
+    m_readInfo.lastElement().bytesLeft = 0;
+    endReadChunk();
 }
 
 void gep::Chunkfile::startWriting(const char* filetype, uint32 ver)
@@ -170,6 +320,29 @@ void gep::Chunkfile::endWriting()
     GEP_ASSERT(m_operation != Operation::read, "can't write in reading operation");
     GEP_ASSERT(m_writeInfo.length() == 1, "there is still more then 1 chunk open");
     endWriteChunk();
+    if(m_operation == Operation::write)
+        writeChunkIndex();
+}
+
+void gep::Chunkfile::writeChunkIndex()
+{
+    auto indexOffset = static_cast<uint32>(m_file.position());
+    startWriteChunk("chunkindex");
+    // the last entry is the index chunk itself which is not listed
+    auto numEntries = m_index.length() - 1;
+    write(static_cast<uint32>(numEntries));
+    for(size_t i = 0; i < numEntries; i++)
+    {
+        auto& entry = m_index[i];
+        writeArrayWithLength<char, uint8>(ArrayPtr<char>(entry.name, entry.nameLength));
+        write(entry.parent);
+        write(entry.headerOffset);
+        write(entry.length);
+    }
+    endWriteChunk();
+
+    uint32 footer[2] = { indexOffset, CHUNK_INDEX_MAGIC };
+    writeArray(ArrayPtr<uint32>(footer, 2));
 }
 
 gep::Result gep::Chunkfile::startReading(const char* filetype)
@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "gep/cullingHierarchy.h"
+#include "gep/math3d/batch.h"
+
+gep::CullingHierarchy::CullingHierarchy() :
+    m_isFinished(false)
+{
+}
+
+void gep::CullingHierarchy::clear()
+{
+    m_nodes.resize(0);
+    m_transforms.resize(0);
+    m_isFinished = false;
+}
+
+gep::uint32 gep::CullingHierarchy::addNode(uint32 parent, const mat4& transform)
+{
+    GEP_ASSERT(parent == NO_PARENT || parent < m_nodes.length(), "invalid parent", parent);
+    GEP_ASSERT(parent != NO_PARENT || m_nodes.length() == 0, "there can only be one root node");
+    m_isFinished = false;
+
+    Node node;
+    node.parent = parent;
+    node.subtreeEnd = 0;
+    node.numWithBoundsInSubtree = 0;
+    node.hasBounds = false;
+    m_nodes.append(node);
+    m_transforms.append(parent == NO_PARENT ? transform : m_transforms[parent] * transform);
+    return (uint32)(m_nodes.length() - 1);
+}
+
+void gep::CullingHierarchy::addBounds(uint32 node, const vec3& min, const vec3& max)
+{
+    GEP_ASSERT(node < m_nodes.length(), "invalid node", node);
+    m_isFinished = false;
+
+    // the box has to be moved into the space of the root node
+    vec3 boxMin = min, boxMax = max;
+    batch::BoxStreams box(batch::Vec3Streams(&boxMin.x, &boxMin.y, &boxMin.z, 1), batch::Vec3Streams(&boxMax.x, &boxMax.y, &boxMax.z, 1));
+    batch::transformBoxes(m_transforms[node], box, box);
+
+    auto& n = m_nodes[node];
+    if(!n.hasBounds)
+    {
+        n.hasBounds = true;
+        n.min = boxMin;
+        n.max = boxMax;
+    }
+    else
+    {
+        batch::extendBounds(ArrayPtr<const vec3>(&boxMin, 1), n.min, n.max);
+        batch::extendBounds(ArrayPtr<const vec3>(&boxMax, 1), n.min, n.max);
+    }
+}
+
+void gep::CullingHierarchy::finish()
+{
+    for(size_t i = 0; i < m_nodes.length(); i++)
+    {
+        auto& node = m_nodes[i];
+        node.subtreeEnd = (uint32)(i + 1);
+        node.numWithBoundsInSubtree = node.hasBounds ? 1 : 0;
+        node.subtreeMin = node.min;
+        node.subtreeMax = node.max;
+    }
+
+    // children come after their parents, so walking backwards visits every subtree before its root
+    for(size_t i = m_nodes.length(); i-- > 0; )
+    {
+        auto& node = m_nodes[i];
+        if(node.parent == NO_PARENT)
+            continue;
+        GEP_ASSERT(node.parent < i, "the nodes are not in depth first order", i, node.parent);
+        auto& parent = m_nodes[node.parent];
+        parent.subtreeEnd = GEP_MAX(parent.subtreeEnd, node.subtreeEnd);
+        if(node.numWithBoundsInSubtree == 0)
+            continue;
+        if(parent.numWithBoundsInSubtree == 0)
+        {
+            parent.subtreeMin = node.subtreeMin;
+            parent.subtreeMax = node.subtreeMax;
+        }
+        else
+        {
+            batch::extendBounds(ArrayPtr<const vec3>(&node.subtreeMin, 1), parent.subtreeMin, parent.subtreeMax);
+            batch::extendBounds(ArrayPtr<const vec3>(&node.subtreeMax, 1), parent.subtreeMin, parent.subtreeMax);
+        }
+        parent.numWithBoundsInSubtree += node.numWithBoundsInSubtree;
+    }
+    m_isFinished = true;
+}
+
+gep::CullingHierarchy::Result gep::CullingHierarchy::cull(const Frustum& frustum, ArrayPtr<uint32> visibleNodes) const
+{
+    GEP_ASSERT(m_isFinished, "finish has not been called after the last change");
+    GEP_ASSERT(visibleNodes.length() >= getNumNodesWithBounds(), "not enough space for the visible nodes",
+               visibleNodes.length(), getNumNodesWithBounds());
+
+    Result result;
+    result.numVisible = 0;
+    result.numCulled = 0;
+    uint32 numNodes = (uint32)m_nodes.length();
+    uint32 i = 0;
+    while(i < numNodes)
+    {
+        const Node& node = m_nodes[i];
+        if(node.numWithBoundsInSubtree == 0)
+        {
+            i = node.subtreeEnd;
+            continue;
+        }
+
+        auto intersection = frustum.test(node.subtreeMin, node.subtreeMax);
+        if(intersection == FrustumIntersection::Outside)
+        {
+            result.numCulled += node.numWithBoundsInSubtree;
+            i = node.subtreeEnd;
+        }
+        else if(intersection == FrustumIntersection::Inside)
+        {
+            for(uint32 j = i; j < node.subtreeEnd; j++)
+            {
+                if(m_nodes[j].hasBounds)
+                    visibleNodes[result.numVisible++] = j;
+            }
+            i = node.subtreeEnd;
+        }
+        else
+        {
+            // the subtree is partially visible, test the node itself and continue with its children
+            if(node.hasBounds)
+            {
+                if(frustum.test(node.min, node.max) != FrustumIntersection::Outside)
+                    visibleNodes[result.numVisible++] = i;
+                else
+                    result.numCulled++;
+            }
+            i++;
+        }
+    }
+    return result;
+}
+
+void gep::CullingHierarchy::getBounds(uint32 node, vec3& min, vec3& max) const
+{
+    GEP_ASSERT(node < m_nodes.length(), "invalid node", node);
+    GEP_ASSERT(m_nodes[node].hasBounds, "the node has no bounds", node);
+    min = m_nodes[node].min;
+    max = m_nodes[node].max;
+}
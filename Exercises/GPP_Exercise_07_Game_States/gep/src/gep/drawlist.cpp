@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "gep/drawList.h"
+
+gep::uint64 gep::DrawList::makeKey(uint32 shader, uint32 textureSet, uint32 material, uint32 mesh, float depth)
+{
+    uint64 key = shader & ((1 << SHADER_BITS) - 1);
+    key = (key << TEXTURE_SET_BITS) | (textureSet & ((1 << TEXTURE_SET_BITS) - 1));
+    key = (key << MATERIAL_BITS) | (material & ((1 << MATERIAL_BITS) - 1));
+    key = (key << MESH_BITS) | (mesh & ((1 << MESH_BITS) - 1));
+    key = (key << DEPTH_BITS) | quantizeDepth(depth);
+    return key;
+}
+
+gep::uint32 gep::DrawList::quantizeDepth(float depth)
+{
+    if(!(depth > 0.0f))
+        return 0;
+    // the bits of a positive float sort like the float itself, the upper 16 bits keep the exponent
+    // and 7 bits of the mantissa which is enough to sort the draws roughly front to back
+    uint32 bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - DEPTH_BITS);
+}
+
+void gep::DrawList::clear()
+{
+    m_entries.resize(0);
+}
+
+void gep::DrawList::sort()
+{
+    const size_t count = m_entries.length();
+    if(count < 2)
+        return;
+
+    // all 8 histograms in one pass over the keys
+    static const size_t NUM_PASSES = sizeof(uint64);
+    uint32 histograms[NUM_PASSES][256];
+    memset(histograms, 0, sizeof(histograms));
+    for(size_t i = 0; i < count; i++)
+    {
+        uint64 key = m_entries[i].key;
+        for(size_t pass = 0; pass < NUM_PASSES; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    m_sortBuffer.resize(count);
+    Entry* pSource = m_entries.toArray().getPtr();
+    Entry* pDestination = m_sortBuffer.toArray().getPtr();
+    for(size_t pass = 0; pass < NUM_PASSES; pass++)
+    {
+        uint32* histogram = histograms[pass];
+        const uint32 shift = (uint32)(pass * 8);
+
+        // nothing to do if all keys have the same value in this byte
+        if(histogram[(pSource[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        uint32 offset = 0;
+        for(size_t digit = 0; digit < 256; digit++)
+        {
+            uint32 numInBucket = histogram[digit];
+            histogram[digit] = offset;
+            offset += numInBucket;
+        }
+        for(size_t i = 0; i < count; i++)
+        {
+            const Entry& entry = pSource[i];
+            pDestination[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        std::swap(pSource, pDestination);
+    }
+
+    if(pSource != m_entries.toArray().getPtr())
+        memcpy(m_entries.toArray().getPtr(), pSource, count * sizeof(Entry));
+}
+
+size_t gep::DrawList::getBatchLength(size_t start, size_t maxLength) const
+{
+    GEP_ASSERT(start < m_entries.length(), "start out of bounds", start, m_entries.length());
+    const uint64 batchKey = getBatchKey(m_entries[start].key);
+    const size_t end = GEP_MIN(m_entries.length(), start + maxLength);
+    size_t i = start + 1;
+    while(i < end && getBatchKey(m_entries[i].key) == batchKey)
+        i++;
+    return i - start;
+}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "gep/globalManager.h"
 #include "gepimpl/subsystems/renderer/renderer.h"
+#include "gepimpl/subsystems/renderer/nullRenderer.h"
 #include "gepimpl/subsystems/renderer/extractor.h"
 #include "gepimpl/subsystems/updateFramework.h"
 #include "gepimpl/subsystems/logging.h"
@@ -12,6 +13,7 @@
 
 #include "gepimpl/subsystems/havok.h"
 #include "gepimpl/subsystems/physics/havokPhysics.h"
+#include "gepimpl/subsystems/physics/nativePhysics.h"
 #include "gepimpl/subsystems/scripting.h"
 #include "gepimpl/subsystems/cameraManager.h"
 #include "gepimpl/settings.h"
@@ -59,6 +61,14 @@ void gep::GlobalManager::initialize()
 
     m_pLogging->logMessage("\n==================================================");
 
+    // first, so the other subsystems can take their allocators from it
+    m_pLogging->logMessage("initializing memory manager");
+    m_pMemoryManager = new gep::MemoryManager(m_pLogging);
+    m_pMemoryManager->initialize();
+    m_pLogging->logMessage("memory manager initialized");
+
+    m_pLogging->logMessage("\n==================================================");
+
 
     m_pLogging->logMessage("initializing settings");
     m_pSettings = new Settings();
@@ -67,7 +77,7 @@ void gep::GlobalManager::initialize()
 
     m_pLogging->logMessage("initializing scripting manager");
     {
-        auto scripting = new ScriptingManager();
+        auto scripting = new ScriptingManager(m_pMemoryManager->getAllocator(MemoryCategory::Scripting));
         scripting->makeBasicBindings();
         m_pScriptingManager = scripting;
     }
@@ -77,13 +87,12 @@ void gep::GlobalManager::initialize()
     m_pLogging->logMessage("loading settings");
     m_pScriptingManager->loadScript("data/settings.lua", IScriptingManager::LoadOptions::PathIsAbsolute);
     m_pLogging->logMessage("settings loaded");
-    m_pLogging->logMessage("\n==================================================");
-
-    m_pLogging->logMessage("initializing memory manager");
-    m_pMemoryManager = new gep::MemoryManager();
-    m_pMemoryManager->initialize();
-    m_pLogging->logMessage("memory manager initialized");
 
+    if(m_pSettings->getScriptingSettings().numPooledStates > 0)
+    {
+        m_pLogging->logMessage("creating %u pooled script states", m_pSettings->getScriptingSettings().numPooledStates);
+        static_cast<ScriptingManager*>(m_pScriptingManager)->createStatePool(m_pSettings->getScriptingSettings().numPooledStates);
+    }
     m_pLogging->logMessage("\n==================================================");
 
     m_pLogging->logMessage("initializing timer");
@@ -95,6 +104,14 @@ void gep::GlobalManager::initialize()
     m_pLogging->logMessage("initializing update framework");
     m_pUpdateFramework = new gep::UpdateFramework();
     m_pLogging->logMessage("update framework initialized");
+    m_pUpdateFramework->registerUpdateCallback([&](float elapsedMilliseconds)
+    {
+        m_pMemoryManager->update(elapsedMilliseconds);
+    });
+    m_pUpdateFramework->registerUpdateCallback([&](float elapsedMilliseconds)
+    {
+        m_pScriptingManager->update(elapsedMilliseconds);
+    });
 
     m_pLogging->logMessage("\n==================================================");
 
@@ -143,13 +160,16 @@ void gep::GlobalManager::initialize()
     m_pLogging->logMessage("\n==================================================");
 
     m_pLogging->logMessage("initializing renderer extractor");
-    m_pRendererExtractor = new gep::RendererExtractor();
+    m_pRendererExtractor = new gep::RendererExtractor(m_pMemoryManager->getAllocator(MemoryCategory::Extraction));
     m_pLogging->logMessage("renderer extractor initialized");
 
     m_pLogging->logMessage("\n==================================================");
 
     m_pLogging->logMessage("initializing renderer");
-    m_pRenderer = new gep::Renderer(m_pSettings->getVideoSettings());
+    if(m_pSettings->getVideoSettings().headless)
+        m_pRenderer = new gep::NullRenderer(m_pSettings->getVideoSettings());
+    else
+        m_pRenderer = new gep::Renderer(m_pSettings->getVideoSettings());
     m_pRenderer->initialize();
     m_pLogging->logMessage("renderer initialized");
 
@@ -171,7 +191,10 @@ void gep::GlobalManager::initialize()
     m_pUpdateFramework->registerInitializeCallback([&]()
     {
         m_pLogging->logMessage("initializing physics system");
-        m_pPhysicsSystem = new HavokPhysicsManager();
+        if(m_pSettings->getPhysicsSettings().useNativeBackend)
+            m_pPhysicsSystem = new NativePhysicsManager();
+        else
+            m_pPhysicsSystem = new HavokPhysicsManager();
         m_pPhysicsSystem->initialize();
         m_pLogging->logMessage("physics system initialized");
     });
@@ -185,7 +208,7 @@ void gep::GlobalManager::initialize()
     
     m_pUpdateFramework->registerInitializeCallback([&]()
     {
-        m_pEventManager = new GlobalEventManager();
+        m_pEventManager = new GlobalEventManager(m_pMemoryManager->getAllocator(MemoryCategory::Events));
         m_pEventManager->initialize();
     });
     m_pUpdateFramework->registerDestroyCallback([&]()
@@ -268,13 +291,6 @@ void gep::GlobalManager::destroy()
 
     m_pLogging->logMessage("\n==================================================");
 
-    m_pLogging->logMessage("destroying memory manager");
-    if(m_pMemoryManager) m_pMemoryManager->destroy();
-    DELETE_AND_NULL(m_pMemoryManager);
-    m_pLogging->logMessage("memory manager destroyed");
-
-    m_pLogging->logMessage("\n==================================================");
-
     m_pLogging->logMessage("destroying task queue");
     DELETE_AND_NULL(m_pTaskQueue);
     m_pLogging->logMessage("task queue destroyed");
@@ -291,6 +307,13 @@ void gep::GlobalManager::destroy()
     m_pLogging->logMessage("settings destroyed");
     m_pLogging->logMessage("\n==================================================");
 
+    // last, the allocators of the memory categories have to outlive everything allocated from them
+    m_pLogging->logMessage("destroying memory manager");
+    if(m_pMemoryManager) m_pMemoryManager->destroy();
+    DELETE_AND_NULL(m_pMemoryManager);
+    m_pLogging->logMessage("memory manager destroyed");
+    m_pLogging->logMessage("\n==================================================");
+
     m_pLogging->logMessage("destroying log system");
     m_pLogging->deregisterSink(m_FileLogSink);
     DELETE_AND_NULL(m_FileLogSink);
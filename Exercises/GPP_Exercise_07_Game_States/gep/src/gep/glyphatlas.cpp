@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include "gep/glyphAtlas.h"
+
+namespace
+{
+    /// new shelves are made a bit higher than needed, so that glyphs of similar height can share them
+    const gep::uint32 SHELF_HEIGHT_STEP = 4;
+    const gep::uint32 NO_SHELF = 0xFFFFFFFF;
+}
+
+gep::GlyphAtlas::GlyphAtlas(uint32 width, uint32 height) :
+    m_width(width),
+    m_height(height),
+    m_usedHeight(0),
+    m_frame(1),
+    m_generation(0),
+    m_numEvictions(0)
+{
+    GEP_ASSERT(width > 0 && width <= 0xFFFF && height > 0 && height <= 0xFFFF, "invalid atlas size", width, height);
+}
+
+bool gep::GlyphAtlas::find(uint32 key, Region& region)
+{
+    if(m_entries.tryGet(key, region) != SUCCESS)
+        return false;
+    markShelfUsed(region.shelf);
+    return true;
+}
+
+bool gep::GlyphAtlas::insert(uint32 key, uint32 width, uint32 height, Region& region)
+{
+    GEP_ASSERT(!m_entries.exists(key), "the key is already in the atlas", key);
+    const uint32 paddedWidth = width + PADDING;
+    const uint32 paddedHeight = height + PADDING;
+    if(paddedWidth > m_width || paddedHeight > m_height)
+        return false;
+
+    // the shelf with the least wasted height which still has room
+    uint32 bestShelf = NO_SHELF;
+    for(uint32 i = 0; i < m_shelves.length(); i++)
+    {
+        const Shelf& shelf = m_shelves[i];
+        if(shelf.height < paddedHeight || shelf.usedWidth + paddedWidth > m_width)
+            continue;
+        if(bestShelf == NO_SHELF || shelf.height < m_shelves[bestShelf].height)
+            bestShelf = i;
+    }
+
+    // a new shelf if there is none or it would waste too much
+    const uint32 newShelfHeight = GEP_MIN((paddedHeight + SHELF_HEIGHT_STEP - 1) / SHELF_HEIGHT_STEP * SHELF_HEIGHT_STEP, m_height - m_usedHeight);
+    const bool isWasteful = bestShelf != NO_SHELF && m_shelves[bestShelf].height > paddedHeight + paddedHeight / 2;
+    if((bestShelf == NO_SHELF || isWasteful) && m_shelves.length() < MAX_SHELVES && newShelfHeight >= paddedHeight)
+    {
+        Shelf shelf;
+        shelf.y = m_usedHeight;
+        shelf.height = newShelfHeight;
+        shelf.usedWidth = 0;
+        shelf.lastUsedFrame = m_frame;
+        m_shelves.append(shelf);
+        m_usedHeight += newShelfHeight;
+        bestShelf = (uint32)(m_shelves.length() - 1);
+    }
+
+    // empty the shelf which was used the longest time ago, among the ones which are high enough
+    if(bestShelf == NO_SHELF)
+    {
+        for(uint32 i = 0; i < m_shelves.length(); i++)
+        {
+            const Shelf& shelf = m_shelves[i];
+            if(shelf.height < paddedHeight || shelf.lastUsedFrame == m_frame)
+                continue;
+            if(bestShelf == NO_SHELF ||
+               shelf.lastUsedFrame < m_shelves[bestShelf].lastUsedFrame ||
+               (shelf.lastUsedFrame == m_shelves[bestShelf].lastUsedFrame && shelf.height < m_shelves[bestShelf].height))
+            {
+                bestShelf = i;
+            }
+        }
+        if(bestShelf == NO_SHELF)
+            return false;
+        evict(bestShelf);
+    }
+
+    place(key, bestShelf, width, height, region);
+    return true;
+}
+
+void gep::GlyphAtlas::markShelvesUsed(uint64 shelfMask)
+{
+    GEP_ASSERT(m_shelves.length() == MAX_SHELVES || (shelfMask >> m_shelves.length()) == 0, "invalid shelf in mask");
+    for(uint32 shelf = 0; shelfMask != 0; shelf++, shelfMask >>= 1)
+    {
+        if(shelfMask & 1)
+            m_shelves[shelf].lastUsedFrame = m_frame;
+    }
+}
+
+void gep::GlyphAtlas::clear()
+{
+    m_entries.clear();
+    m_shelves.resize(0);
+    m_usedHeight = 0;
+    m_generation++;
+}
+
+void gep::GlyphAtlas::evict(uint32 shelf)
+{
+    m_entries.removeWhere([shelf](uint32& key, Region& region){ return region.shelf == shelf; });
+    m_shelves[shelf].usedWidth = 0;
+    m_generation++;
+    m_numEvictions++;
+}
+
+void gep::GlyphAtlas::place(uint32 key, uint32 shelf, uint32 width, uint32 height, Region& region)
+{
+    Shelf& s = m_shelves[shelf];
+    region.x = (uint16)s.usedWidth;
+    region.y = (uint16)s.y;
+    region.width = (uint16)width;
+    region.height = (uint16)height;
+    region.shelf = shelf;
+    s.usedWidth += width + PADDING;
+    s.lastUsedFrame = m_frame;
+    m_entries[key] = region;
+}
@@ -0,0 +1,375 @@
+#include "stdafx.h"
+#include "gep/imageProcessing.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/math3d/simd.h"
+
+// the integer instructions need SSE2, GEP_MATH_SIMD only guarantees SSE
+#if GEP_MATH_SIMD && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+    #define GEP_IMAGE_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define GEP_IMAGE_SSE2 0
+#endif
+
+namespace
+{
+    using namespace gep;
+
+    // the smallest bands which are worth a task of their own
+    const size_t DOWNSAMPLE_ROWS_PER_TASK = 32;
+    const size_t COMPRESS_BLOCK_ROWS_PER_TASK = 8;
+
+    inline void averagePixels(const uint8* a, const uint8* b, const uint8* c, const uint8* d, uint8* result)
+    {
+        for(int i = 0; i < 4; i++)
+            result[i] = uint8((a[i] + b[i] + c[i] + d[i] + 2) >> 2);
+    }
+
+    /// copies a 4x4 block, the pixels outside of the image repeat its last row and column
+    inline void loadBlock(const uint8* src, uint32 width, uint32 height, uint32 bytesPerPixel, uint32 blockX, uint32 blockY, uint8* block)
+    {
+        const uint32 x0 = blockX * 4;
+        const uint32 y0 = blockY * 4;
+        const size_t pitch = size_t(width) * bytesPerPixel;
+        if(x0 + 4 <= width && y0 + 4 <= height)
+        {
+            for(uint32 y = 0; y < 4; y++)
+                memcpy(block + y * 4 * bytesPerPixel, src + (y0 + y) * pitch + x0 * bytesPerPixel, 4 * bytesPerPixel);
+            return;
+        }
+        for(uint32 y = 0; y < 4; y++)
+        {
+            const uint32 srcY = GEP_MIN(y0 + y, height - 1);
+            for(uint32 x = 0; x < 4; x++)
+            {
+                const uint32 srcX = GEP_MIN(x0 + x, width - 1);
+                memcpy(block + (y * 4 + x) * bytesPerPixel, src + srcY * pitch + srcX * bytesPerPixel, bytesPerPixel);
+            }
+        }
+    }
+
+    /// per channel minimum and maximum of the 16 RGBA pixels of a block
+    inline void getBounds(const uint8* block, uint8* minColor, uint8* maxColor)
+    {
+#if GEP_IMAGE_SSE2
+        const __m128i r0 = _mm_loadu_si128((const __m128i*)block);
+        const __m128i r1 = _mm_loadu_si128((const __m128i*)(block + 16));
+        const __m128i r2 = _mm_loadu_si128((const __m128i*)(block + 32));
+        const __m128i r3 = _mm_loadu_si128((const __m128i*)(block + 48));
+        __m128i mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+        __m128i mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+        // fold the 4 pixels of the register
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+        const int minBits = _mm_cvtsi128_si32(mn);
+        const int maxBits = _mm_cvtsi128_si32(mx);
+        memcpy(minColor, &minBits, 4);
+        memcpy(maxColor, &maxBits, 4);
+#else
+        for(int c = 0; c < 4; c++)
+        {
+            minColor[c] = maxColor[c] = block[c];
+        }
+        for(int i = 1; i < 16; i++)
+        {
+            for(int c = 0; c < 4; c++)
+            {
+                minColor[c] = GEP_MIN(minColor[c], block[i * 4 + c]);
+                maxColor[c] = GEP_MAX(maxColor[c], block[i * 4 + c]);
+            }
+        }
+#endif
+    }
+
+    /// minimum and maximum of the 16 values of a single channel block
+    inline void getBounds1(const uint8* block, uint8& minValue, uint8& maxValue)
+    {
+#if GEP_IMAGE_SSE2
+        __m128i mn = _mm_loadu_si128((const __m128i*)block);
+        __m128i mx = mn;
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+        minValue = uint8(_mm_cvtsi128_si32(mn));
+        maxValue = uint8(_mm_cvtsi128_si32(mx));
+#else
+        minValue = maxValue = block[0];
+        for(int i = 1; i < 16; i++)
+        {
+            minValue = GEP_MIN(minValue, block[i]);
+            maxValue = GEP_MAX(maxValue, block[i]);
+        }
+#endif
+    }
+
+    inline uint16 toRGB565(const uint8* color)
+    {
+        return uint16((((color[0] * 31 + 127) / 255) << 11) |
+                      (((color[1] * 63 + 127) / 255) << 5) |
+                       ((color[2] * 31 + 127) / 255));
+    }
+
+    inline void fromRGB565(uint16 color, int* result)
+    {
+        const int r = (color >> 11) & 31;
+        const int g = (color >> 5) & 63;
+        const int b = color & 31;
+        result[0] = (r << 3) | (r >> 2);
+        result[1] = (g << 2) | (g >> 4);
+        result[2] = (b << 3) | (b >> 2);
+    }
+
+    inline void writeUint16(uint8* dst, uint16 value)
+    {
+        dst[0] = uint8(value);
+        dst[1] = uint8(value >> 8);
+    }
+
+    /// writes the 8 byte BC1 block of 16 RGBA pixels with the given bounding box
+    void encodeColorBlock(const uint8* block, const uint8* minColor, const uint8* maxColor, uint8* dst)
+    {
+        // inset the bounding box a little, the extremes are usually single noisy pixels
+        uint8 endpoints[2][3];
+        for(int c = 0; c < 3; c++)
+        {
+            const uint8 inset = uint8((maxColor[c] - minColor[c]) >> 4);
+            endpoints[0][c] = maxColor[c] - inset;
+            endpoints[1][c] = minColor[c] + inset;
+        }
+        // color0 >= color1 because every channel of the maximum is at least the one of the minimum
+        const uint16 color0 = toRGB565(endpoints[0]);
+        const uint16 color1 = toRGB565(endpoints[1]);
+        writeUint16(dst, color0);
+        writeUint16(dst + 2, color1);
+        if(color0 == color1)
+        {
+            // a single color, color0 > color1 is not needed because index 0 is color0 in both modes
+            memset(dst + 4, 0, 4);
+            return;
+        }
+
+        // project on the line between the colors which are actually decoded
+        int end0[3], end1[3];
+        fromRGB565(color0, end0);
+        fromRGB565(color1, end1);
+        const int dir[3] = { end0[0] - end1[0], end0[1] - end1[1], end0[2] - end1[2] };
+        const int lengthSquared = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+        // palette entries from color1 to color0
+        static const uint32 indexForStep[4] = { 1, 3, 2, 0 };
+        uint32 indices = 0;
+        for(int i = 0; i < 16; i++)
+        {
+            const uint8* pixel = block + i * 4;
+            const int t = (pixel[0] - end1[0]) * dir[0] + (pixel[1] - end1[1]) * dir[1] + (pixel[2] - end1[2]) * dir[2];
+            // round(3 * t / lengthSquared), clamped to the line
+            const int step = (t <= 0) ? 0 : GEP_MIN((6 * t + lengthSquared) / (2 * lengthSquared), 3);
+            indices |= indexForStep[step] << (2 * i);
+        }
+        dst[4] = uint8(indices);
+        dst[5] = uint8(indices >> 8);
+        dst[6] = uint8(indices >> 16);
+        dst[7] = uint8(indices >> 24);
+    }
+
+    /// writes the 8 byte BC4 block of 16 values which are stride bytes apart
+    void encodeSingleChannelBlock(const uint8* block, uint32 stride, uint8 minValue, uint8 maxValue, uint8* dst)
+    {
+        // the extremes are kept exactly, fully transparent and opaque pixels stay what they are
+        dst[0] = maxValue;
+        dst[1] = minValue;
+        uint64 indices = 0;
+        if(maxValue != minValue)
+        {
+            // value0 > value1: 6 values between the extremes
+            const int range = maxValue - minValue;
+            for(int i = 0; i < 16; i++)
+            {
+                const int step = ((block[i * stride] - minValue) * 14 + range) / (2 * range);
+                const uint64 index = (step == 7) ? 0 : (step == 0) ? 1 : 8 - step;
+                indices |= index << (3 * i);
+            }
+        }
+        for(int i = 0; i < 6; i++)
+            dst[2 + i] = uint8(indices >> (8 * i));
+    }
+
+    template <typename Work>
+    inline void runBands(TaskQueue* pTaskQueue, size_t count, size_t minChunkSize, const Work& work)
+    {
+        if(pTaskQueue == nullptr)
+            work(0, count);
+        else
+            pTaskQueue->runParallel(count, minChunkSize, work);
+    }
+}
+
+gep::uint32 gep::image::getNumMipmaps(uint32 width, uint32 height)
+{
+    uint32 size = GEP_MAX(width, height);
+    uint32 numMipmaps = 1;
+    while(size > 1)
+    {
+        size >>= 1;
+        numMipmaps++;
+    }
+    return numMipmaps;
+}
+
+size_t gep::image::getMipmapBytes(uint32 width, uint32 height, BlockCompression compression)
+{
+    const size_t numBlocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+    switch(compression)
+    {
+    case BlockCompression::BC1:
+    case BlockCompression::BC4:
+        return numBlocks * 8;
+    case BlockCompression::BC3:
+        return numBlocks * 16;
+    default:
+        return size_t(width) * height * 4;
+    }
+}
+
+void gep::image::downsampleRGBA8(const uint8* src, uint32 width, uint32 height, uint8* dst, uint32 startRow, uint32 endRow)
+{
+    const uint32 dstWidth = getMipmapSize(width, 1);
+    GEP_ASSERT(startRow <= endRow && endRow <= getMipmapSize(height, 1), "rows out of bounds", startRow, endRow);
+    const size_t pitch = size_t(width) * 4;
+
+    for(uint32 y = startRow; y < endRow; y++)
+    {
+        const uint8* row0 = src + 2 * y * pitch;
+        const uint8* row1 = (height > 1) ? row0 + pitch : row0;
+        uint8* out = dst + size_t(y) * dstWidth * 4;
+        if(width == 1)
+        {
+            averagePixels(row0, row0, row1, row1, out);
+            continue;
+        }
+
+        uint32 x = 0;
+#if GEP_IMAGE_SSE2
+        // 4 destination pixels from 8 source pixels of both rows
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for(; x + 4 <= dstWidth; x += 4)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+            const __m128i b = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+            const __m128i d = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16));
+            // vertical sums with 16 bit per channel, two pixels per register
+            const __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero));
+            const __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero));
+            const __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(d, zero));
+            const __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(d, zero));
+            // horizontal sums of the pixel pairs
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+            __m128i hi = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+            _mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for(; x < dstWidth; x++)
+            averagePixels(row0 + x * 8, row0 + x * 8 + 4, row1 + x * 8, row1 + x * 8 + 4, out + x * 4);
+    }
+}
+
+void gep::image::compressBlocks(BlockCompression compression, const uint8* src, uint32 width, uint32 height, uint8* dst,
+                                uint32 startBlockRow, uint32 endBlockRow)
+{
+    GEP_ASSERT(compression != BlockCompression::None, "nothing to compress");
+    const uint32 numBlocksX = (width + 3) / 4;
+    GEP_ASSERT(startBlockRow <= endBlockRow && endBlockRow <= (height + 3) / 4, "block rows out of bounds", startBlockRow, endBlockRow);
+    const uint32 bytesPerPixel = (compression == BlockCompression::BC4) ? 1 : 4;
+    const size_t bytesPerBlock = (compression == BlockCompression::BC3) ? 16 : 8;
+
+    uint8 block[64];
+    uint8 minColor[4], maxColor[4];
+    for(uint32 blockY = startBlockRow; blockY < endBlockRow; blockY++)
+    {
+        for(uint32 blockX = 0; blockX < numBlocksX; blockX++)
+        {
+            loadBlock(src, width, height, bytesPerPixel, blockX, blockY, block);
+            uint8* out = dst + (size_t(blockY) * numBlocksX + blockX) * bytesPerBlock;
+            switch(compression)
+            {
+            case BlockCompression::BC1:
+                getBounds(block, minColor, maxColor);
+                encodeColorBlock(block, minColor, maxColor, out);
+                break;
+            case BlockCompression::BC3:
+                getBounds(block, minColor, maxColor);
+                encodeSingleChannelBlock(block + 3, 4, minColor[3], maxColor[3], out);
+                encodeColorBlock(block, minColor, maxColor, out + 8);
+                break;
+            case BlockCompression::BC4:
+                getBounds1(block, minColor[0], maxColor[0]);
+                encodeSingleChannelBlock(block, 1, minColor[0], maxColor[0], out);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+gep::ArrayPtr<gep::ArrayPtr<gep::uint8>> gep::image::createMipmaps(IAllocator* pAllocator, ArrayPtr<uint8> rgba, uint32 width, uint32 height,
+                                                                 BlockCompression compression, TaskQueue* pTaskQueue)
+{
+    GEP_ASSERT(width > 0 && height > 0);
+    GEP_ASSERT(rgba.length() >= size_t(width) * height * 4, "not enough pixels", rgba.length(), width, height);
+    GEP_ASSERT(compression != BlockCompression::BC4, "BC4 needs a single channel image");
+
+    const uint32 numMipmaps = getNumMipmaps(width, height);
+    auto mipmaps = GEP_NEW_ARRAY(pAllocator, ArrayPtr<uint8>, numMipmaps);
+    // uncompressed mipmaps are downsampled right into the result, otherwise two buffers take turns
+    DynamicArray<uint8> buffers[2];
+    const uint8* pLevel = rgba.getPtr();
+    for(uint32 mipmap = 0; mipmap < numMipmaps; mipmap++)
+    {
+        const uint32 mipWidth = getMipmapSize(width, mipmap);
+        const uint32 mipHeight = getMipmapSize(height, mipmap);
+        mipmaps[mipmap] = GEP_NEW_ARRAY(pAllocator, uint8, getMipmapBytes(mipWidth, mipHeight, compression));
+
+        if(mipmap > 0)
+        {
+            uint8* pDst = mipmaps[mipmap].getPtr();
+            if(compression != BlockCompression::None)
+            {
+                auto& buffer = buffers[mipmap % 2];
+                buffer.resize(size_t(mipWidth) * mipHeight * 4);
+                pDst = buffer.toArray().getPtr();
+            }
+            const uint32 srcWidth = getMipmapSize(width, mipmap - 1);
+            const uint32 srcHeight = getMipmapSize(height, mipmap - 1);
+            runBands(pTaskQueue, mipHeight, DOWNSAMPLE_ROWS_PER_TASK, [&](size_t start, size_t end){
+                downsampleRGBA8(pLevel, srcWidth, srcHeight, pDst, uint32(start), uint32(end));
+            });
+            pLevel = pDst;
+        }
+
+        if(compression == BlockCompression::None)
+        {
+            if(mipmap == 0)
+                memcpy(mipmaps[0].getPtr(), pLevel, mipmaps[0].length());
+        }
+        else
+        {
+            uint8* pDst = mipmaps[mipmap].getPtr();
+            runBands(pTaskQueue, (mipHeight + 3) / 4, COMPRESS_BLOCK_ROWS_PER_TASK, [&](size_t start, size_t end){
+                compressBlocks(compression, pLevel, mipWidth, mipHeight, pDst, uint32(start), uint32(end));
+            });
+        }
+    }
+    return mipmaps;
+}
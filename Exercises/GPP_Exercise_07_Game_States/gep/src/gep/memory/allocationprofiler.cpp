@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "gep/memory/allocationProfiler.h"
+#include <cmath>
+
+namespace
+{
+    struct ThreadState
+    {
+        gep::uint32 generation;
+        gep::int64 bytesUntilSample;
+        gep::uint64 random;
+    };
+
+    // plain data, zero initialized for every thread without running any code
+    __declspec(thread) ThreadState t_threadState;
+
+    // 0 is never handed out, so the zero initialized thread states are not mistaken for a running profiler
+    volatile LONG g_lastGeneration = 0;
+
+    /// exponentially distributed with the given mean, xorshift64* is plenty for picking samples
+    gep::int64 drawBytesUntilSample(ThreadState& state, size_t sampleRate)
+    {
+        if(sampleRate == 1)
+            return 1;
+        if(state.random == 0)
+            state.random = (gep::uint64(GetCurrentThreadId()) << 32) ^ gep::uint64(&state) ^ 0x9E3779B97F4A7C15ULL;
+        state.random ^= state.random >> 12;
+        state.random ^= state.random << 25;
+        state.random ^= state.random >> 27;
+        // uniform in (0, 1]
+        const double uniform = double(((state.random * 2685821657736338717ULL) >> 11) + 1) * (1.0 / 9007199254740992.0);
+        return gep::int64(-log(uniform) * double(sampleRate)) + 1;
+    }
+}
+
+gep::AllocationProfiler::AllocationProfiler(size_t sampleRate) :
+    m_sampleRate(sampleRate),
+    m_generation(uint32(InterlockedIncrement(&g_lastGeneration))),
+    m_stacks(&m_allocator),
+    m_stackIdsByHash(&m_allocator),
+    m_samples(&m_allocator)
+{
+    GEP_ASSERT(sampleRate > 0, "the sample rate has to be at least one byte");
+    for(size_t i = 0; i < FILTER_SIZE; i++)
+        m_sampledFilter[i] = 0;
+}
+
+gep::uint32 gep::AllocationProfiler::getFilterSlot(void* mem)
+{
+    // fibonacci hashing, the upper bits depend on all bits of the address
+    return uint32(size_t(mem) >> 4) * 2654435761u >> 16;
+}
+
+void gep::AllocationProfiler::trackAllocation(void* mem, size_t size)
+{
+    auto& state = t_threadState;
+    if(state.generation != m_generation)
+    {
+        // the distances are memoryless, so starting over does not bias the samples
+        state.generation = m_generation;
+        state.bytesUntilSample = drawBytesUntilSample(state, m_sampleRate);
+    }
+    state.bytesUntilSample -= int64(size);
+    if(state.bytesUntilSample > 0)
+        return;
+    state.bytesUntilSample = drawBytesUntilSample(state, m_sampleRate);
+
+    StackWalker::address_t frames[MAX_FRAMES];
+    const size_t numFrames = StackWalker::getCallstack(2, ArrayPtr<StackWalker::address_t>(frames));
+    takeSample(mem, size, ArrayPtr<StackWalker::address_t>(frames, numFrames));
+}
+
+void gep::AllocationProfiler::takeSample(void* mem, size_t size, ArrayPtr<StackWalker::address_t> frames)
+{
+    const double weight = 1.0 / (1.0 - exp(-double(size) / double(m_sampleRate)));
+
+    ScopedLock<Mutex> lock(m_mutex);
+    Sample previous;
+    if(m_samples.tryGet(mem, previous))
+    {
+        // freed while the profiler was not listening
+        m_stacks[previous.stackId].statistics.liveBytes -= previous.size * previous.weight;
+    }
+    else
+    {
+        m_sampledFilter[getFilterSlot(mem)]++;
+    }
+
+    Sample sample;
+    sample.stackId = findOrAddStack(frames);
+    sample.size = size;
+    sample.weight = weight;
+    m_samples[mem] = sample;
+
+    auto& statistics = m_stacks[sample.stackId].statistics;
+    statistics.allocatedBytes += size * weight;
+    statistics.allocations += weight;
+    statistics.liveBytes += size * weight;
+    statistics.numSamples++;
+}
+
+void gep::AllocationProfiler::trackFree(void* mem)
+{
+    const uint32 slot = getFilterSlot(mem);
+    if(m_sampledFilter[slot] == 0)
+        return;
+
+    ScopedLock<Mutex> lock(m_mutex);
+    Sample sample;
+    if(!m_samples.tryGet(mem, sample))
+        return;
+    m_samples.remove(mem);
+    m_sampledFilter[slot]--;
+    m_stacks[sample.stackId].statistics.liveBytes -= sample.size * sample.weight;
+}
+
+gep::uint32 gep::AllocationProfiler::findOrAddStack(ArrayPtr<StackWalker::address_t> frames)
+{
+    const uint32 hash = hashOf(frames.getPtr(), frames.length() * sizeof(StackWalker::address_t));
+    uint32 firstWithSameHash = uint32(-1);
+    if(m_stackIdsByHash.tryGet(hash, firstWithSameHash))
+    {
+        for(uint32 id = firstWithSameHash; id != uint32(-1); id = m_stacks[id].nextWithSameHash)
+        {
+            const auto& stack = m_stacks[id];
+            if(stack.numFrames == frames.length() && memcmp(stack.frames, frames.getPtr(), frames.length() * sizeof(StackWalker::address_t)) == 0)
+                return id;
+        }
+    }
+
+    Stack stack;
+    memcpy(stack.frames, frames.getPtr(), frames.length() * sizeof(StackWalker::address_t));
+    stack.numFrames = uint32(frames.length());
+    stack.nextWithSameHash = firstWithSameHash;
+    memset(&stack.statistics, 0, sizeof(StackStatistics));
+    const uint32 id = uint32(m_stacks.length());
+    m_stacks.append(stack);
+    m_stackIdsByHash[hash] = id;
+    return id;
+}
+
+void gep::AllocationProfiler::reset(size_t sampleRate)
+{
+    GEP_ASSERT(sampleRate > 0, "the sample rate has to be at least one byte");
+    ScopedLock<Mutex> lock(m_mutex);
+    m_sampleRate = sampleRate;
+    m_generation = uint32(InterlockedIncrement(&g_lastGeneration));
+    m_stacks.resize(0);
+    m_stackIdsByHash.clear();
+    m_samples.clear();
+    for(size_t i = 0; i < FILTER_SIZE; i++)
+        m_sampledFilter[i] = 0;
+}
+
+size_t gep::AllocationProfiler::getNumStacks()
+{
+    ScopedLock<Mutex> lock(m_mutex);
+    return m_stacks.length();
+}
+
+gep::AllocationProfiler::StackStatistics gep::AllocationProfiler::getStackStatistics(uint32 stackId)
+{
+    ScopedLock<Mutex> lock(m_mutex);
+    GEP_ASSERT(stackId < m_stacks.length(), "invalid stack id", stackId);
+    return m_stacks[stackId].statistics;
+}
+
+gep::AllocationProfiler::StackStatistics gep::AllocationProfiler::getTotals()
+{
+    StackStatistics totals;
+    memset(&totals, 0, sizeof(StackStatistics));
+    ScopedLock<Mutex> lock(m_mutex);
+    for(auto& stack : m_stacks)
+    {
+        totals.allocatedBytes += stack.statistics.allocatedBytes;
+        totals.allocations += stack.statistics.allocations;
+        totals.liveBytes += stack.statistics.liveBytes;
+        totals.numSamples += stack.statistics.numSamples;
+    }
+    return totals;
+}
+
+void gep::AllocationProfiler::writeLiveBytes(std::ostream& output)
+{
+    writeStacks(output, true);
+}
+
+void gep::AllocationProfiler::writeAllocatedBytes(std::ostream& output)
+{
+    writeStacks(output, false);
+}
+
+void gep::AllocationProfiler::writeStacks(std::ostream& output, bool liveBytes)
+{
+    // resolving symbols and writing to the stream allocates, so the lock must not be held while doing so
+    DynamicArray<Stack> stacks(&m_allocator);
+    {
+        ScopedLock<Mutex> lock(m_mutex);
+        stacks.append(m_stacks.toArray());
+    }
+
+    Hashmap<StackWalker::address_t, std::string, StdHashPolicy> functionNames(&m_allocator);
+    char* resolved = (char*)m_allocator.allocateMemory(LINE_LENGTH);
+    SCOPE_EXIT { m_allocator.freeMemory(resolved); });
+
+    for(auto& stack : stacks)
+    {
+        const double value = liveBytes ? stack.statistics.liveBytes : stack.statistics.allocatedBytes;
+        if(value < 0.5 || stack.numFrames == 0)
+            continue;
+
+        // outermost frame first
+        for(uint32 i = stack.numFrames; i-- > 0; )
+        {
+            auto address = stack.frames[i];
+            if(!functionNames.exists(address))
+            {
+                StackWalker::resolveCallstack(ArrayPtr<StackWalker::address_t>(&address, 1), resolved, LINE_LENGTH);
+                // only keep the function of "file(line): function"
+                const char* functionName = strstr(resolved, "): ");
+                std::string name(functionName != nullptr ? functionName + 3 : resolved);
+                for(auto& c : name)
+                {
+                    if(c == ';')
+                        c = ':';
+                }
+                functionNames[address] = std::move(name);
+            }
+            output << functionNames[address];
+            if(i > 0)
+                output << ';';
+        }
+        output << ' ' << uint64(value + 0.5) << '\n';
+    }
+}
@@ -3,6 +3,7 @@
 #include "gep/threading/mutex.h"
 #include "gep/exit.h"
 #include "gep/memory/leakDetection.h"
+#include "gep/memory/allocationProfiler.h"
 #include <fstream>
 
 #include "gep/memory/newdelete.inl"
@@ -14,19 +15,32 @@ volatile gep::StdAllocator* gep::StdAllocator::s_globalInstance = nullptr;
 #endif
 
 gep::Mutex gep::StdAllocator::s_creationMutex;
+gep::AllocationProfiler* volatile gep::StdAllocator::s_pProfiler = nullptr;
 
 void* gep::StdAllocator::allocateMemory(size_t size)
 {
-    ScopedLock<Mutex> lock(m_allocationLock);
-    m_bytesAllocated += size;
-    if(m_bytesAllocated > m_peakBytesAllocated)
-        m_peakBytesAllocated = m_bytesAllocated;
-    m_numAllocations++;
-    return malloc(size);
+    void* result = nullptr;
+    {
+        ScopedLock<Mutex> lock(m_allocationLock);
+        m_bytesAllocated += size;
+        if(m_bytesAllocated > m_peakBytesAllocated)
+            m_peakBytesAllocated = m_bytesAllocated;
+        m_numAllocations++;
+        result = malloc(size);
+    }
+    // the profiler has its own lock, taking a sample must not hold up the other threads
+    auto pProfiler = s_pProfiler;
+    if(pProfiler != nullptr && result != nullptr)
+        pProfiler->trackAllocation(result, size);
+    return result;
 }
 
 void gep::StdAllocator::freeMemory(void* mem)
 {
+    auto pProfiler = s_pProfiler;
+    if(pProfiler != nullptr && mem != nullptr)
+        pProfiler->trackFree(mem);
+
     ScopedLock<Mutex> lock(m_allocationLock);
     if(mem != nullptr)
     {
@@ -115,6 +129,16 @@ void gep::StdAllocator::destroyInstance()
     }
 }
 
+void gep::StdAllocator::setProfiler(AllocationProfiler* pProfiler)
+{
+    s_pProfiler = pProfiler;
+}
+
+gep::AllocationProfiler* gep::StdAllocator::getProfiler()
+{
+    return s_pProfiler;
+}
+
 gep::IAllocatorStatistics* gep::StdAllocatorPolicy::getAllocator()
 {
     return &StdAllocator::globalInstance();
@@ -426,3 +426,171 @@ size_t gep::DoubleEndedStackAllocator::getDynamicArraysSize() const
 {
     return m_Front.m_StackAllocator.getDynamicArraySize() + m_Back.m_StackAllocator.getDynamicArraySize();
 }
+
+gep::GrowingStackAllocator::GrowingStackAllocator(size_t blockSize, IAllocator* pParentAllocator)
+{
+    if (pParentAllocator==nullptr)
+        pParentAllocator = &StdAllocator::globalInstance();
+    m_pParentAllocator = pParentAllocator;
+
+    GEP_ASSERT(blockSize>0);
+    m_blockSize = alignedSize(blockSize);
+    m_currentBlock = 0;
+    m_pStackPtr = nullptr;
+
+    m_numAllocations = 0;
+    m_numFrees = 0;
+    m_numBytesUsed = 0;
+}
+
+gep::GrowingStackAllocator::~GrowingStackAllocator()
+{
+    for (auto& block : m_blocks)
+        m_pParentAllocator->freeMemory(block.pBuffer);
+}
+
+void* gep::GrowingStackAllocator::allocateMemory(size_t size)
+{
+    GEP_ASSERT(size>0);
+    size = alignedSize(size);
+    while (m_currentBlock < m_blocks.length())
+    {
+        const Block& block = m_blocks[m_currentBlock];
+        if (m_pStackPtr+size <= block.pBuffer+block.size)
+        {
+            char* pBuffer = m_pStackPtr;
+            m_pStackPtr += size;
+            m_numBytesUsed += size;
+            ++m_numAllocations;
+            return pBuffer;
+        }
+        // the rest of the block stays unused, continue with the next one
+        ++m_currentBlock;
+        if (m_currentBlock < m_blocks.length())
+            m_pStackPtr = m_blocks[m_currentBlock].pBuffer;
+    }
+
+    Block block;
+    block.size = GEP_MAX(m_blockSize, size);
+    block.pBuffer = (char*)m_pParentAllocator->allocateMemory(block.size);
+    GEP_ASSERT(block.pBuffer!=nullptr);
+    GEP_ASSERT(isAligned(block.pBuffer));
+    m_blocks.append(block);
+    m_currentBlock = m_blocks.length()-1;
+    m_pStackPtr = block.pBuffer+size;
+    m_numBytesUsed += size;
+    ++m_numAllocations;
+    return block.pBuffer;
+}
+
+void gep::GrowingStackAllocator::freeMemory(void* mem)
+{
+}
+
+void gep::GrowingStackAllocator::freeAll()
+{
+    m_currentBlock = 0;
+    m_pStackPtr = (m_blocks.length() > 0) ? m_blocks[0].pBuffer : nullptr;
+    m_numFrees = m_numAllocations;
+    m_numBytesUsed = 0;
+}
+
+size_t gep::GrowingStackAllocator::getNumAllocations() const
+{
+    return m_numAllocations;
+}
+
+size_t gep::GrowingStackAllocator::getNumFrees() const
+{
+    return m_numFrees;
+}
+
+size_t gep::GrowingStackAllocator::getNumBytesReserved() const
+{
+    size_t reserved = 0;
+    for (size_t i=0; i<m_blocks.length(); ++i)
+        reserved += m_blocks[i].size;
+    return reserved;
+}
+
+size_t gep::GrowingStackAllocator::getNumBytesUsed() const
+{
+    return m_numBytesUsed;
+}
+
+gep::IAllocatorStatistics* gep::GrowingStackAllocator::getParentAllocator() const
+{
+    return dynamic_cast<IAllocatorStatistics*>(m_pParentAllocator);
+}
+
+gep::CountingAllocator::CountingAllocator(IAllocatorStatistics* pParentAllocator) :
+    m_pParentAllocator(pParentAllocator != nullptr ? pParentAllocator : &StdAllocator::globalInstance()),
+    m_numAllocations(0),
+    m_numFrees(0),
+    m_numBytesUsed(0),
+    m_numBytesReserved(0),
+    m_peakBytesUsed(0)
+{
+}
+
+void* gep::CountingAllocator::allocateMemory(size_t size)
+{
+    char* pBuffer = (char*)m_pParentAllocator->allocateMemory(size + HEADER_SIZE);
+    if (pBuffer == nullptr)
+        return nullptr;
+    *(size_t*)pBuffer = size;
+
+    InterlockedIncrement64(&m_numAllocations);
+    InterlockedExchangeAdd64(&m_numBytesReserved, LONGLONG(size + HEADER_SIZE));
+    const LONGLONG bytesUsed = InterlockedExchangeAdd64(&m_numBytesUsed, LONGLONG(size)) + LONGLONG(size);
+    LONGLONG peak = m_peakBytesUsed;
+    while (bytesUsed > peak)
+    {
+        const LONGLONG previousPeak = InterlockedCompareExchange64(&m_peakBytesUsed, bytesUsed, peak);
+        if (previousPeak == peak)
+            break;
+        peak = previousPeak;
+    }
+    return pBuffer + HEADER_SIZE;
+}
+
+void gep::CountingAllocator::freeMemory(void* mem)
+{
+    if (mem == nullptr)
+        return;
+    char* pBuffer = (char*)mem - HEADER_SIZE;
+    InterlockedIncrement64(&m_numFrees);
+    InterlockedExchangeAdd64(&m_numBytesUsed, -LONGLONG(*(size_t*)pBuffer));
+    InterlockedExchangeAdd64(&m_numBytesReserved, -LONGLONG(*(size_t*)pBuffer + HEADER_SIZE));
+    m_pParentAllocator->freeMemory(pBuffer);
+}
+
+size_t gep::CountingAllocator::getNumAllocations() const
+{
+    return size_t(m_numAllocations);
+}
+
+size_t gep::CountingAllocator::getNumFrees() const
+{
+    return size_t(m_numFrees);
+}
+
+size_t gep::CountingAllocator::getNumBytesReserved() const
+{
+    return size_t(m_numBytesReserved);
+}
+
+size_t gep::CountingAllocator::getNumBytesUsed() const
+{
+    return size_t(m_numBytesUsed);
+}
+
+size_t gep::CountingAllocator::getPeakNumBytesUsed() const
+{
+    return size_t(m_peakBytesUsed);
+}
+
+gep::IAllocatorStatistics* gep::CountingAllocator::getParentAllocator() const
+{
+    return m_pParentAllocator;
+}
@@ -0,0 +1,719 @@
+#include "stdafx.h"
+#include "gep/meshcooker.h"
+#include <algorithm>
+
+namespace
+{
+    typedef gep::ModelLoader::FaceData FaceData;
+    typedef gep::ModelLoader::MeshData MeshData;
+
+    // scoring parameters from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    const gep::uint32 FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    /// clusters are not split into parts smaller than this
+    const size_t MIN_CLUSTER_SIZE = 16;
+
+    const gep::uint32 UNUSED_VERTEX = 0xFFFFFFFF;
+
+    float vertexScore(gep::int32 cachePosition, gep::uint32 remainingValence)
+    {
+        if(remainingValence == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if(cachePosition >= 0)
+        {
+            if(cachePosition < 3)
+            {
+                // the vertices of the last triangle get a fixed score, so that strips are not preferred
+                score = LAST_TRIANGLE_SCORE;
+            }
+            else
+            {
+                const float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = powf(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+            }
+        }
+        // vertices with few remaining triangles are preferred, to get rid of them
+        score += VALENCE_BOOST_SCALE * powf((float)remainingValence, -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    /// FIFO cache simulation with time stamps, flushing is done by advancing the time
+    struct CacheSimulation
+    {
+        gep::DynamicArray<size_t> timestamps;
+        size_t time;
+        gep::uint32 cacheSize;
+
+        CacheSimulation(size_t numVertices, gep::uint32 cacheSize) :
+            time(cacheSize + 1),
+            cacheSize(cacheSize)
+        {
+            timestamps.resize(numVertices);
+            for(auto& timestamp : timestamps)
+                timestamp = 0;
+        }
+
+        /// returns the number of vertices that had to be transformed
+        gep::uint32 addFace(const FaceData& face)
+        {
+            gep::uint32 misses = 0;
+            for(auto index : face.indices)
+            {
+                if(time - timestamps[index] > cacheSize)
+                {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void flush()
+        {
+            time += cacheSize + 1;
+        }
+    };
+
+    struct Cluster
+    {
+        size_t start;
+        size_t end;
+        float sortKey;
+    };
+
+    gep::int16 toSnorm16(float value)
+    {
+        value = std::max(-1.0f, std::min(1.0f, value));
+        return (gep::int16)(value * 32767.0f + (value >= 0.0f ? 0.5f : -0.5f));
+    }
+
+    float fromSnorm16(gep::int16 value)
+    {
+        return std::max((float)value / 32767.0f, -1.0f);
+    }
+
+    float signNotZero(float value)
+    {
+        return (value >= 0.0f) ? 1.0f : -1.0f;
+    }
+
+    gep::uint8 toUnorm8(float value)
+    {
+        value = std::max(0.0f, std::min(1.0f, value));
+        return (gep::uint8)(value * 255.0f + 0.5f);
+    }
+
+    template <typename T>
+    void reorder(const gep::ArrayPtr<T>& source, const gep::DynamicArray<gep::uint32>& newToOld, gep::DynamicArray<T>& destination)
+    {
+        if(source.length() == 0)
+            return;
+        destination.resize(newToOld.length());
+        for(size_t i=0; i<newToOld.length(); i++)
+            destination[i] = source[newToOld[i]];
+    }
+}
+
+gep::MeshCooker::Statistics::Statistics() :
+    numTriangles(0),
+    uncookedVertexBytes(0),
+    cookedVertexBytes(0),
+    uncookedIndexBytes(0),
+    cookedIndexBytes(0),
+    cacheMissesBefore(0),
+    cacheMissesAfter(0)
+{
+}
+
+void gep::MeshCooker::Statistics::add(const Statistics& other)
+{
+    numTriangles += other.numTriangles;
+    uncookedVertexBytes += other.uncookedVertexBytes;
+    cookedVertexBytes += other.cookedVertexBytes;
+    uncookedIndexBytes += other.uncookedIndexBytes;
+    cookedIndexBytes += other.cookedIndexBytes;
+    cacheMissesBefore += other.cacheMissesBefore;
+    cacheMissesAfter += other.cacheMissesAfter;
+}
+
+gep::uint32 gep::MeshCooker::getVertexFormat(const ModelLoader::MeshData& mesh)
+{
+    uint32 format = GpuVertexFormat::Position;
+    if(mesh.normals.length() > 0)
+        format |= GpuVertexFormat::Normal;
+    if(mesh.tangents.length() > 0)
+        format |= GpuVertexFormat::Tangent;
+    if(mesh.bitangents.length() > 0)
+        format |= GpuVertexFormat::Bitangent;
+    if(mesh.texcoords[0].length() > 0)
+        format |= GpuVertexFormat::TexCoord0;
+    if(mesh.boneInfos.length() > 0)
+        format |= GpuVertexFormat::Bones;
+    return format;
+}
+
+gep::uint32 gep::MeshCooker::getVertexStride(uint32 vertexFormat)
+{
+    uint32 stride = 0;
+    if(vertexFormat & GpuVertexFormat::Position)
+        stride += sizeof(float) * 3;
+    if(vertexFormat & GpuVertexFormat::Normal)
+        stride += sizeof(int16) * 2;
+    if(vertexFormat & GpuVertexFormat::Tangent)
+        stride += sizeof(int16) * 2;
+    if(vertexFormat & GpuVertexFormat::Bitangent)
+        stride += sizeof(int16) * 2;
+    if(vertexFormat & GpuVertexFormat::TexCoord0)
+        stride += sizeof(uint16) * 2;
+    if(vertexFormat & GpuVertexFormat::Bones)
+        stride += sizeof(uint16) * 4 + sizeof(uint8) * 4;
+    return stride;
+}
+
+gep::uint32 gep::MeshCooker::getUncookedVertexStride(uint32 vertexFormat)
+{
+    uint32 stride = 0;
+    if(vertexFormat & GpuVertexFormat::Position)
+        stride += sizeof(float) * 3;
+    if(vertexFormat & GpuVertexFormat::Normal)
+        stride += sizeof(float) * 3;
+    if(vertexFormat & GpuVertexFormat::Tangent)
+        stride += sizeof(float) * 3;
+    if(vertexFormat & GpuVertexFormat::Bitangent)
+        stride += sizeof(float) * 3;
+    if(vertexFormat & GpuVertexFormat::TexCoord0)
+        stride += sizeof(float) * 2;
+    if(vertexFormat & GpuVertexFormat::Bones)
+        stride += sizeof(uint32) * 4 + sizeof(float) * 4;
+    return stride;
+}
+
+gep::uint32 gep::MeshCooker::getIndexSize(size_t numVertices)
+{
+    return (numVertices <= (size_t)std::numeric_limits<uint16>::max() + 1) ? sizeof(uint16) : sizeof(uint32);
+}
+
+void gep::MeshCooker::encodeVertices(const ModelLoader::MeshData& mesh, uint32 vertexFormat, ArrayPtr<uint8> destination)
+{
+    const uint32 stride = getVertexStride(vertexFormat);
+    GEP_ASSERT(destination.length() == stride * mesh.vertices.length(), "destination has the wrong size", destination.length(), stride);
+
+    uint8* pVertex = destination.getPtr();
+    for(size_t i=0; i<mesh.vertices.length(); i++, pVertex += stride)
+    {
+        uint8* pChannel = pVertex;
+        if(vertexFormat & GpuVertexFormat::Position)
+        {
+            memcpy(pChannel, mesh.vertices[i].data, sizeof(float) * 3);
+            pChannel += sizeof(float) * 3;
+        }
+        if(vertexFormat & GpuVertexFormat::Normal)
+        {
+            uint32 encoded = encodeOctahedral(mesh.normals[i]);
+            memcpy(pChannel, &encoded, sizeof(encoded));
+            pChannel += sizeof(encoded);
+        }
+        if(vertexFormat & GpuVertexFormat::Tangent)
+        {
+            uint32 encoded = encodeOctahedral(mesh.tangents[i]);
+            memcpy(pChannel, &encoded, sizeof(encoded));
+            pChannel += sizeof(encoded);
+        }
+        if(vertexFormat & GpuVertexFormat::Bitangent)
+        {
+            uint32 encoded = encodeOctahedral(mesh.bitangents[i]);
+            memcpy(pChannel, &encoded, sizeof(encoded));
+            pChannel += sizeof(encoded);
+        }
+        if(vertexFormat & GpuVertexFormat::TexCoord0)
+        {
+            uint16 texcoord[2] = { floatToHalf(mesh.texcoords[0][i].x), floatToHalf(mesh.texcoords[0][i].y) };
+            memcpy(pChannel, texcoord, sizeof(texcoord));
+            pChannel += sizeof(texcoord);
+        }
+        if(vertexFormat & GpuVertexFormat::Bones)
+        {
+            auto& boneInfo = mesh.boneInfos[i];
+            uint16 boneIndices[ModelLoader::BoneInfo::NUM_SUPPORTED_BONES];
+            uint8 weights[ModelLoader::BoneInfo::NUM_SUPPORTED_BONES];
+            for(int j=0; j<ModelLoader::BoneInfo::NUM_SUPPORTED_BONES; j++)
+            {
+                GEP_ASSERT(boneInfo.boneIndices[j] <= std::numeric_limits<uint16>::max(), "bone index does not fit into 16 bit", boneInfo.boneIndices[j]);
+                boneIndices[j] = (uint16)boneInfo.boneIndices[j];
+                weights[j] = toUnorm8(boneInfo.weights[j]);
+            }
+            memcpy(pChannel, boneIndices, sizeof(boneIndices));
+            pChannel += sizeof(boneIndices);
+            memcpy(pChannel, weights, sizeof(weights));
+            pChannel += sizeof(weights);
+        }
+        GEP_ASSERT(pChannel == pVertex + stride);
+    }
+}
+
+void gep::MeshCooker::encodeIndices(const ArrayPtr<ModelLoader::FaceData>& faces, uint32 indexSize, ArrayPtr<uint8> destination)
+{
+    GEP_ASSERT(indexSize == sizeof(uint16) || indexSize == sizeof(uint32), "unsupported index size", indexSize);
+    GEP_ASSERT(destination.length() == faces.length() * 3 * indexSize, "destination has the wrong size", destination.length());
+
+    if(indexSize == sizeof(uint32))
+    {
+        memcpy(destination.getPtr(), faces.getPtr(), destination.length());
+        return;
+    }
+
+    uint16* pIndex = reinterpret_cast<uint16*>(destination.getPtr());
+    for(auto& face : faces)
+    {
+        for(auto index : face.indices)
+        {
+            GEP_ASSERT(index <= std::numeric_limits<uint16>::max(), "index does not fit into 16 bit", index);
+            *pIndex++ = (uint16)index;
+        }
+    }
+}
+
+void gep::MeshCooker::optimizeVertexCache(ArrayPtr<ModelLoader::FaceData> faces, size_t numVertices)
+{
+    const size_t numFaces = faces.length();
+    if(numFaces == 0)
+        return;
+
+    // the faces of each vertex, the ones that are not emitted yet are kept at the front
+    DynamicArray<uint32> valence;
+    valence.resize(numVertices);
+    for(auto& count : valence)
+        count = 0;
+    for(auto& face : faces)
+    {
+        for(auto index : face.indices)
+        {
+            GEP_ASSERT(index < numVertices, "index out of range", index, numVertices);
+            valence[index]++;
+        }
+    }
+
+    DynamicArray<uint32> adjacencyOffsets;
+    adjacencyOffsets.resize(numVertices);
+    uint32 offset = 0;
+    for(size_t i=0; i<numVertices; i++)
+    {
+        adjacencyOffsets[i] = offset;
+        offset += valence[i];
+        valence[i] = 0;
+    }
+    DynamicArray<uint32> adjacency;
+    adjacency.resize(offset);
+    for(size_t i=0; i<numFaces; i++)
+    {
+        for(auto index : faces[i].indices)
+            adjacency[adjacencyOffsets[index] + valence[index]++] = (uint32)i;
+    }
+
+    DynamicArray<int32> cachePositions;
+    DynamicArray<float> vertexScores;
+    cachePositions.resize(numVertices);
+    vertexScores.resize(numVertices);
+    for(size_t i=0; i<numVertices; i++)
+    {
+        cachePositions[i] = -1;
+        vertexScores[i] = vertexScore(-1, valence[i]);
+    }
+
+    DynamicArray<uint8> isEmitted;
+    isEmitted.resize(numFaces);
+    for(auto& emitted : isEmitted)
+        emitted = 0;
+
+    DynamicArray<FaceData> result;
+    result.reserve(numFaces);
+
+    uint32 cache[FORSYTH_CACHE_SIZE + 3];
+    size_t cacheLength = 0;
+    size_t nextUnemitted = 0;
+    ptrdiff_t bestFace = -1;
+
+    while(result.length() < numFaces)
+    {
+        if(bestFace < 0)
+        {
+            // dead end, continue with the next face in input order
+            while(isEmitted[nextUnemitted])
+                nextUnemitted++;
+            bestFace = (ptrdiff_t)nextUnemitted;
+        }
+
+        const FaceData face = faces[bestFace];
+        result.append(face);
+        isEmitted[bestFace] = 1;
+
+        for(auto index : face.indices)
+        {
+            uint32* pFaces = adjacency.toArray().getPtr() + adjacencyOffsets[index];
+            uint32 numLiveFaces = valence[index];
+            for(uint32 i=0; i<numLiveFaces; i++)
+            {
+                if(pFaces[i] == (uint32)bestFace)
+                {
+                    std::swap(pFaces[i], pFaces[numLiveFaces - 1]);
+                    break;
+                }
+            }
+            valence[index]--;
+        }
+
+        // the vertices of the face move to the front of the cache
+        uint32 newCache[FORSYTH_CACHE_SIZE + 3];
+        size_t newCacheLength = 0;
+        for(auto index : face.indices)
+        {
+            if(std::find(newCache, newCache + newCacheLength, index) == newCache + newCacheLength)
+                newCache[newCacheLength++] = index;
+        }
+        for(size_t i=0; i<cacheLength; i++)
+        {
+            uint32 index = cache[i];
+            if(std::find(newCache, newCache + newCacheLength, index) != newCache + newCacheLength)
+                continue;
+            if(newCacheLength < GEP_ARRAY_SIZE(newCache))
+                newCache[newCacheLength++] = index;
+            else
+            {
+                // an evicted vertex must not keep the score of its old cache position
+                cachePositions[index] = -1;
+                vertexScores[index] = vertexScore(-1, valence[index]);
+            }
+        }
+
+        for(size_t i=0; i<newCacheLength; i++)
+        {
+            uint32 index = newCache[i];
+            cachePositions[index] = (i < FORSYTH_CACHE_SIZE) ? (int32)i : -1;
+            vertexScores[index] = vertexScore(cachePositions[index], valence[index]);
+        }
+
+        // only faces of vertices in the cache changed their score
+        bestFace = -1;
+        float bestScore = -1.0f;
+        for(size_t i=0; i<newCacheLength; i++)
+        {
+            uint32 index = newCache[i];
+            const uint32* pFaces = adjacency.toArray().getPtr() + adjacencyOffsets[index];
+            for(uint32 j=0; j<valence[index]; j++)
+            {
+                auto& candidate = faces[pFaces[j]];
+                float score = vertexScores[candidate.indices[0]] + vertexScores[candidate.indices[1]] + vertexScores[candidate.indices[2]];
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    bestFace = pFaces[j];
+                }
+            }
+        }
+
+        memcpy(cache, newCache, sizeof(uint32) * newCacheLength);
+        cacheLength = newCacheLength;
+    }
+
+    memcpy(faces.getPtr(), result.toArray().getPtr(), sizeof(FaceData) * numFaces);
+}
+
+void gep::MeshCooker::optimizeOverdraw(ArrayPtr<ModelLoader::FaceData> faces, const ArrayPtr<vec3>& vertices, float threshold)
+{
+    const size_t numFaces = faces.length();
+    if(numFaces <= MIN_CLUSTER_SIZE)
+        return;
+
+    // hard boundaries are where the vertex cache order already starts over
+    DynamicArray<size_t> hardBoundaries;
+    {
+        CacheSimulation cache(vertices.length(), MEASURE_CACHE_SIZE);
+        for(size_t i=0; i<numFaces; i++)
+        {
+            if(cache.addFace(faces[i]) == 3 || i == 0)
+                hardBoundaries.append(i);
+        }
+        hardBoundaries.append(numFaces);
+    }
+
+    // split further as long as the cache miss ratio of each cluster stays within the threshold
+    DynamicArray<Cluster> clusters;
+    CacheSimulation cache(vertices.length(), MEASURE_CACHE_SIZE);
+    for(size_t i=0; i + 1<hardBoundaries.length(); i++)
+    {
+        const size_t start = hardBoundaries[i];
+        const size_t end = hardBoundaries[i + 1];
+
+        cache.flush();
+        size_t misses = 0;
+        for(size_t j=start; j<end; j++)
+            misses += cache.addFace(faces[j]);
+        const float hardClusterACMR = (float)misses / (end - start);
+
+        cache.flush();
+        misses = 0;
+        Cluster cluster = { start, end, 0.0f };
+        for(size_t j=start; j<end; j++)
+        {
+            misses += cache.addFace(faces[j]);
+            size_t clusterSize = j + 1 - cluster.start;
+            if(clusterSize >= MIN_CLUSTER_SIZE && j + 1 < end && (float)misses / clusterSize <= threshold * hardClusterACMR)
+            {
+                cluster.end = j + 1;
+                clusters.append(cluster);
+                cluster.start = j + 1;
+                cache.flush();
+                misses = 0;
+            }
+        }
+        cluster.end = end;
+        clusters.append(cluster);
+    }
+
+    if(clusters.length() < 2)
+        return;
+
+    // clusters that face away from the center of the mesh are likely in front and drawn first
+    vec3 meshCenter;
+    float meshArea = 0.0f;
+    for(auto& face : faces)
+    {
+        auto& a = vertices[face.indices[0]];
+        auto& b = vertices[face.indices[1]];
+        auto& c = vertices[face.indices[2]];
+        float area = (b - a).cross(c - a).length();
+        meshCenter += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if(meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    for(auto& cluster : clusters)
+    {
+        vec3 center;
+        vec3 normal;
+        float area = 0.0f;
+        for(size_t i=cluster.start; i<cluster.end; i++)
+        {
+            auto& a = vertices[faces[i].indices[0]];
+            auto& b = vertices[faces[i].indices[1]];
+            auto& c = vertices[faces[i].indices[2]];
+            vec3 faceNormal = (b - a).cross(c - a);
+            float faceArea = faceNormal.length();
+            center += (a + b + c) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        if(area > 0.0f)
+            center /= area;
+        float normalLength = normal.length();
+        cluster.sortKey = (normalLength > 0.0f) ? (center - meshCenter).dot(normal / normalLength) : 0.0f;
+    }
+
+    std::stable_sort(clusters.toArray().getPtr(), clusters.toArray().getPtr() + clusters.length(),
+        [](const Cluster& lhs, const Cluster& rhs){ return lhs.sortKey > rhs.sortKey; });
+
+    DynamicArray<FaceData> result;
+    result.reserve(numFaces);
+    for(auto& cluster : clusters)
+        result.append(ArrayPtr<FaceData>(faces.getPtr() + cluster.start, cluster.end - cluster.start));
+    memcpy(faces.getPtr(), result.toArray().getPtr(), sizeof(FaceData) * numFaces);
+}
+
+void gep::MeshCooker::optimizeVertexFetch(ArrayPtr<ModelLoader::FaceData> faces, size_t numVertices, DynamicArray<uint32>& newToOld)
+{
+    DynamicArray<uint32> oldToNew;
+    oldToNew.resize(numVertices);
+    for(auto& index : oldToNew)
+        index = UNUSED_VERTEX;
+
+    newToOld.clear();
+    newToOld.reserve(numVertices);
+    for(auto& face : faces)
+    {
+        for(auto& index : face.indices)
+        {
+            GEP_ASSERT(index < numVertices, "index out of range", index, numVertices);
+            if(oldToNew[index] == UNUSED_VERTEX)
+            {
+                oldToNew[index] = (uint32)newToOld.length();
+                newToOld.append(index);
+            }
+            index = oldToNew[index];
+        }
+    }
+
+    // vertices that no face uses are kept at the end
+    for(size_t i=0; i<numVertices; i++)
+    {
+        if(oldToNew[i] == UNUSED_VERTEX)
+            newToOld.append((uint32)i);
+    }
+}
+
+size_t gep::MeshCooker::countCacheMisses(const ArrayPtr<ModelLoader::FaceData>& faces, size_t numVertices, uint32 cacheSize)
+{
+    CacheSimulation cache(numVertices, cacheSize);
+    size_t misses = 0;
+    for(auto& face : faces)
+        misses += cache.addFace(face);
+    return misses;
+}
+
+gep::uint32 gep::MeshCooker::encodeOctahedral(const vec3& normal)
+{
+    float l1Norm = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if(l1Norm == 0.0f)
+        return 0;
+
+    // project onto the octahedron and fold the lower half over the upper one
+    float x = normal.x / l1Norm;
+    float y = normal.y / l1Norm;
+    if(normal.z < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * signNotZero(x);
+        y = (1.0f - fabsf(x)) * signNotZero(y);
+        x = foldedX;
+    }
+    return (uint32)(uint16)toSnorm16(x) | ((uint32)(uint16)toSnorm16(y) << 16);
+}
+
+gep::vec3 gep::MeshCooker::decodeOctahedral(uint32 encoded)
+{
+    // has to match decodeOctahedral in data/shaders/lighting.fx
+    vec3 result(fromSnorm16((int16)(encoded & 0xFFFF)), fromSnorm16((int16)(encoded >> 16)), 0.0f);
+    result.z = 1.0f - fabsf(result.x) - fabsf(result.y);
+    if(result.z < 0.0f)
+    {
+        float unfoldedX = (1.0f - fabsf(result.y)) * signNotZero(result.x);
+        result.y = (1.0f - fabsf(result.x)) * signNotZero(result.y);
+        result.x = unfoldedX;
+    }
+    return result.normalized();
+}
+
+gep::uint16 gep::MeshCooker::floatToHalf(float value)
+{
+    uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32 sign = (bits >> 16) & 0x8000;
+    const uint32 floatExponent = (bits >> 23) & 0xFF;
+    uint32 mantissa = bits & 0x007FFFFF;
+
+    // infinity and NaN
+    if(floatExponent == 0xFF)
+        return (uint16)(sign | 0x7C00 | (mantissa != 0 ? 0x0200 : 0));
+
+    int32 exponent = (int32)floatExponent - 127 + 15;
+    if(exponent >= 31)
+        return (uint16)(sign | 0x7C00);
+
+    if(exponent <= 0)
+    {
+        // denormalized half
+        if(exponent < -10)
+            return (uint16)sign;
+        mantissa |= 0x00800000;
+        const uint32 shift = (uint32)(14 - exponent);
+        uint32 half = mantissa >> shift;
+        const uint32 rest = mantissa & ((1u << shift) - 1);
+        const uint32 halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1) != 0))
+            half++;
+        return (uint16)(sign | half);
+    }
+
+    // round to nearest even, a carry into the exponent is correct
+    uint32 half = ((uint32)exponent << 10) | (mantissa >> 13);
+    const uint32 rest = mantissa & 0x1FFF;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))
+        half++;
+    return (uint16)(sign | half);
+}
+
+float gep::MeshCooker::halfToFloat(uint16 value)
+{
+    const uint32 sign = (uint32)(value & 0x8000) << 16;
+    const uint32 exponent = (value >> 10) & 0x1F;
+    const uint32 mantissa = value & 0x03FF;
+
+    if(exponent == 0)
+    {
+        float result = ldexpf((float)mantissa, -24);
+        return sign ? -result : result;
+    }
+
+    uint32 bits;
+    if(exponent == 31)
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+gep::CookedMesh::CookedMesh(const ModelLoader::MeshData& source, MeshCooker::Statistics* pStatistics)
+{
+    const size_t numVertices = source.vertices.length();
+
+    m_faces.append(source.faces);
+    auto faces = m_faces.toArray();
+    const size_t cacheMissesBefore = MeshCooker::countCacheMisses(faces, numVertices);
+
+    MeshCooker::optimizeVertexCache(faces, numVertices);
+    MeshCooker::optimizeOverdraw(faces, source.vertices);
+    DynamicArray<uint32> newToOld;
+    MeshCooker::optimizeVertexFetch(faces, numVertices, newToOld);
+
+    reorder(source.vertices, newToOld, m_vertices);
+    reorder(source.normals, newToOld, m_normals);
+    reorder(source.tangents, newToOld, m_tangents);
+    reorder(source.bitangents, newToOld, m_bitangents);
+    for(size_t i=0; i<GEP_ARRAY_SIZE(m_texcoords); i++)
+        reorder(source.texcoords[i], newToOld, m_texcoords[i]);
+    reorder(source.boneInfos, newToOld, m_boneInfos);
+
+    m_meshData = source;
+    m_meshData.vertices = m_vertices.toArray();
+    m_meshData.normals = m_normals.toArray();
+    m_meshData.tangents = m_tangents.toArray();
+    m_meshData.bitangents = m_bitangents.toArray();
+    for(size_t i=0; i<GEP_ARRAY_SIZE(m_texcoords); i++)
+        m_meshData.texcoords[i] = m_texcoords[i].toArray();
+    m_meshData.boneInfos = m_boneInfos.toArray();
+    m_meshData.faces = faces;
+
+    m_gpuMeshData.vertexFormat = MeshCooker::getVertexFormat(m_meshData);
+    m_gpuMeshData.vertexStride = MeshCooker::getVertexStride(m_gpuMeshData.vertexFormat);
+    m_gpuMeshData.indexSize = MeshCooker::getIndexSize(numVertices);
+    m_gpuMeshData.numVertices = (uint32)numVertices;
+    m_gpuMeshData.numIndices = (uint32)(faces.length() * 3);
+
+    m_gpuVertices.resize(m_gpuMeshData.vertexStride * numVertices);
+    MeshCooker::encodeVertices(m_meshData, m_gpuMeshData.vertexFormat, m_gpuVertices.toArray());
+    m_gpuIndices.resize(m_gpuMeshData.indexSize * m_gpuMeshData.numIndices);
+    MeshCooker::encodeIndices(faces, m_gpuMeshData.indexSize, m_gpuIndices.toArray());
+    m_gpuMeshData.vertices = m_gpuVertices.toArray();
+    m_gpuMeshData.indices = m_gpuIndices.toArray();
+
+    if(pStatistics != nullptr)
+    {
+        MeshCooker::Statistics statistics;
+        statistics.numTriangles = faces.length();
+        statistics.uncookedVertexBytes = MeshCooker::getUncookedVertexStride(m_gpuMeshData.vertexFormat) * numVertices;
+        statistics.cookedVertexBytes = m_gpuVertices.length();
+        statistics.uncookedIndexBytes = sizeof(uint32) * m_gpuMeshData.numIndices;
+        statistics.cookedIndexBytes = m_gpuIndices.length();
+        statistics.cacheMissesBefore = cacheMissesBefore;
+        statistics.cacheMissesAfter = MeshCooker::countCacheMisses(faces, numVertices);
+        pStatistics->add(statistics);
+    }
+}
@@ -3,6 +3,12 @@
 #include "gep/file.h"
 #include "gep/exception.h"
 #include "gep/chunkfile.h"
+#include "gep/meshcooker.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/archive.h"
+#include "gep/math3d/batch.h"
+#include "gep/globalManager.h"
+#include "gep/interfaces/resourceManager.h"
 #include <sstream>
 
 namespace {
@@ -12,6 +18,55 @@ namespace {
         file.read(data);
         return (float)data / (float)std::numeric_limits<gep::int16>::max();
     }
+
+    void expectChunk(gep::Chunkfile& file, const char* name, const char* pFilename)
+    {
+        if(file.startReadChunk() != gep::SUCCESS || file.getCurrentChunkName() != name)
+        {
+            std::ostringstream msg;
+            msg << "Expected '" << name << "' chunk in file '" << pFilename << "'";
+            throw gep::LoadingError(msg.str());
+        }
+    }
+
+    /// returns the next name from a block of '\0' terminated names
+    const char* nextName(gep::ArrayPtr<char> names, size_t& position, const char* pFilename)
+    {
+        const char* name = names.getPtr() + position;
+        auto maxLength = names.length() - GEP_MIN(position, names.length());
+        auto length = strnlen(name, maxLength);
+        if(length == maxLength)
+        {
+            std::ostringstream msg;
+            msg << "Name table is corrupt in file '" << pFilename << "'";
+            throw gep::LoadingError(msg.str());
+        }
+        position += length + 1;
+        return name;
+    }
+
+    /// reads one stream of a Version4 file with a single bulk read. Streams that are not loaded are skipped.
+    template <typename T>
+    void readStream(gep::Chunkfile& file, size_t& position, gep::uint32 offset, gep::ArrayPtr<T> data, const char* pFilename)
+    {
+        if(offset == gep::ModelMeshLayout::NOT_PRESENT || data.length() == 0)
+            return;
+        if(offset < position)
+        {
+            std::ostringstream msg;
+            msg << "Streams are not in order in file '" << pFilename << "'";
+            throw gep::LoadingError(msg.str());
+        }
+        file.skipRead(offset - position);
+        position = offset;
+        if(file.readArray(data) != sizeof(T) * data.length())
+        {
+            std::ostringstream msg;
+            msg << "Stream data is missing in file '" << pFilename << "'";
+            throw gep::LoadingError(msg.str());
+        }
+        position += sizeof(T) * data.length();
+    }
 }
 
 gep::ModelLoader::ModelLoader(IAllocator* pAllocator) :
@@ -34,17 +89,23 @@ gep::ModelLoader::~ModelLoader()
 
 void gep::ModelLoader::loadFile(const char* pFilename, uint32 loadWhat)
 {
-    GEP_ASSERT(!m_modelData.hasData,"LoadFile can only be called once");
-    m_filename = pFilename;
-
-    if(!fileExists(pFilename))
+    FileView fileView;
+    if(g_globalManager.getResourceManager()->getFileSystem().open(pFilename, fileView) != SUCCESS)
     {
         std::ostringstream msg;
         msg << "File '" << pFilename << "' does not exist";
         throw LoadingError(msg.str());
     }
 
-    Chunkfile file(pFilename, Chunkfile::Operation::read);
+    loadFromMemory(pFilename, fileView.getData(), loadWhat);
+}
+
+void gep::ModelLoader::loadFromMemory(const char* pFilename, ArrayPtr<uint8> fileData, uint32 loadWhat)
+{
+    GEP_ASSERT(!m_modelData.hasData,"LoadFile can only be called once");
+    m_filename = pFilename;
+
+    Chunkfile file(pFilename, fileData);
 
     if(file.startReading("thModel") != SUCCESS)
     {
@@ -53,13 +114,26 @@ void gep::ModelLoader::loadFile(const char* pFilename, uint32 loadWhat)
         throw LoadingError(msg.str());
     }
 
-    if(file.getFileVersion() > ModelFormatVersion::Version3)
+    if(file.getFileVersion() > ModelFormatVersion::Version5)
     {
         std::ostringstream msg;
-        msg << "File '" << pFilename << "' does have a old format, please reexport";
+        msg << "File '" << pFilename << "' does have a newer format than this loader supports";
         throw LoadingError(msg.str());
     }
 
+    if(file.getFileVersion() >= ModelFormatVersion::Version4)
+        loadVersion4(file, loadWhat);
+    else
+        loadVersion3(file, loadWhat);
+
+    file.endReading();
+    m_modelData.hasData = true;
+}
+
+void gep::ModelLoader::loadVersion3(Chunkfile& file, uint32 loadWhat)
+{
+    const char* pFilename = m_filename.c_str();
+
     MemoryStatistics memstat;
 
     uint32 nodeNameMemory;
@@ -714,10 +788,280 @@ void gep::ModelLoader::loadFile(const char* pFilename, uint32 loadWhat)
             file.skipCurrentChunk();
         }
     }
+}
 
-    file.endReading();
-    m_modelData.hasData = true;
+void gep::ModelLoader::throwLayoutTooSmall()
+{
+    std::ostringstream msg;
+    msg << "The layout header of file '" << m_filename << "' does not match its content, please reexport";
+    throw LoadingError(msg.str());
+}
+
+void gep::ModelLoader::loadVersion4(Chunkfile& file, uint32 loadWhat)
+{
+    const char* pFilename = m_filename.c_str();
+    const bool loadMeshes = (loadWhat & Load::Meshes) != 0;
+    const bool loadBones = loadMeshes && (loadWhat & Load::Bones) != 0;
+    Load::Enum loadStreams[] = { Load::Meshes, Load::Normals, Load::Tangents, Load::Bitangents,
+                                 Load::TexCoords0, Load::TexCoords1, Load::TexCoords2, Load::TexCoords3,
+                                 Load::Bones, Load::Meshes };
+    static_assert(GEP_ARRAY_SIZE(loadStreams) == ModelMeshLayout::Stream::Count, "every stream needs a load flag");
+
+    // Read the layout, which has all sizes precomputed
+    uint32 numTextures = 0, texturePathMemory = 0;
+    uint32 numMaterials = 0, materialNameMemory = 0;
+    uint32 numMeshes = 0, boneNameMemory = 0;
+    uint32 numNodes = 0, nodeNameMemory = 0;
+    DynamicArray<ModelMeshLayout> meshLayouts;
+    {
+        expectChunk(file, "layout", pFilename);
+
+        uint32 meshDataSize = 0;
+        file.read(meshDataSize);
+        file.read(numTextures);
+        file.read(texturePathMemory);
+        file.read(numMaterials);
+        file.read(materialNameMemory);
+        file.read(numMeshes);
+        file.read(boneNameMemory);
+        file.read(numNodes);
+        file.read(nodeNameMemory);
+
+        meshLayouts.resize(numMeshes);
+        file.readArray(meshLayouts.toArray());
+        file.endReadChunk();
+
+        // the size always covers everything, even if only parts are loaded
+        m_pMeshDataAllocator = GEP_NEW(m_pAllocator, StackAllocator)(true, meshDataSize, m_pAllocator);
+        m_pStartMarker = m_pMeshDataAllocator->getMarker();
+    }
+
+    // Load textures
+    expectChunk(file, "textures", pFilename);
+    if(loadWhat & Load::Materials)
+    {
+        auto textureNames = allocateArray<char>(texturePathMemory);
+        file.readArray(textureNames);
+        m_modelData.textures = allocateArray<const char*>(numTextures);
+        size_t curNamePos = 0;
+        for(auto& texture : m_modelData.textures)
+        {
+            texture = nextName(textureNames, curNamePos, pFilename);
+        }
+        file.endReadChunk();
+    }
+    else
+    {
+        file.skipCurrentChunk();
+    }
+
+    // Read materials
+    expectChunk(file, "materials", pFilename);
+    if(loadWhat & Load::Materials)
+    {
+        auto materialNames = allocateArray<char>(materialNameMemory);
+        file.readArray(materialNames);
+        m_modelData.materials = allocateArray<MaterialData>(numMaterials);
+        size_t curNamePos = 0;
+        for(auto& material : m_modelData.materials)
+        {
+            material.name = nextName(materialNames, curNamePos, pFilename);
+
+            uint32 numMaterialTextures = 0;
+            file.read(numMaterialTextures);
+            material.textures = allocateArray<TextureReference>(numMaterialTextures);
+            for(auto& texture : material.textures)
+            {
+                uint32 textureIndex = 0;
+                file.read(textureIndex);
+                if(textureIndex >= numTextures)
+                    throwLayoutTooSmall();
+                texture.file = m_modelData.textures[textureIndex];
+
+                uint8 semantic = (uint8)TextureType::UNKNOWN;
+                file.read(semantic);
+                texture.semantic = (TextureType)semantic;
+            }
+        }
+        file.endReadChunk();
+    }
+    else
+    {
+        file.skipCurrentChunk();
+    }
+
+    // Allocate all meshes and their streams up front
+    if(loadMeshes)
+    {
+        m_modelData.meshes = allocateArray<MeshData>(numMeshes);
+        for(uint32 i=0; i<numMeshes; i++)
+        {
+            auto& layout = meshLayouts[i];
+            auto& mesh = m_modelData.meshes[i];
+            auto isLoaded = [&](ModelMeshLayout::Stream::Enum stream){
+                return layout.streamOffsets[stream] != ModelMeshLayout::NOT_PRESENT && (loadWhat & loadStreams[stream]) != 0;
+            };
+
+            mesh.materialIndex = layout.materialIndex;
+            mesh.bbox = AABB(vec3(layout.minBounds), vec3(layout.maxBounds));
+            mesh.numFaces = layout.numFaces;
+            mesh.vertices = allocateArray<vec3>(layout.numVertices);
+            if(isLoaded(ModelMeshLayout::Stream::Normals))
+                mesh.normals = allocateArray<vec3>(layout.numVertices);
+            if(isLoaded(ModelMeshLayout::Stream::Tangents))
+                mesh.tangents = allocateArray<vec3>(layout.numVertices);
+            if(isLoaded(ModelMeshLayout::Stream::Bitangents))
+                mesh.bitangents = allocateArray<vec3>(layout.numVertices);
+            for(uint32 j=0; j<GEP_ARRAY_SIZE(mesh.texcoords); j++)
+            {
+                if(isLoaded((ModelMeshLayout::Stream::Enum)(ModelMeshLayout::Stream::TexCoords0 + j)))
+                    mesh.texcoords[j] = allocateArray<vec2>(layout.numVertices);
+            }
+            if(isLoaded(ModelMeshLayout::Stream::BoneInfos))
+                mesh.boneInfos = allocateArray<BoneInfo>(layout.numVertices);
+            mesh.faces = allocateArray<FaceData>(layout.numFaces);
+        }
+    }
+
+    // Read bones
+    expectChunk(file, "bones", pFilename);
+    if(loadBones)
+    {
+        auto boneNames = allocateArray<char>(boneNameMemory);
+        file.readArray(boneNames);
+        size_t curNamePos = 0;
+        for(uint32 i=0; i<numMeshes; i++)
+        {
+            auto& mesh = m_modelData.meshes[i];
+            mesh.bones = allocateArray<BoneData>(meshLayouts[i].numBones);
+            for(auto& bone : mesh.bones)
+            {
+                bone.name = nextName(boneNames, curNamePos, pFilename);
+                file.read(bone.offsetMatrix);
+            }
+        }
+        file.endReadChunk();
+    }
+    else
+    {
+        file.skipCurrentChunk();
+    }
+
+    // Read the streams, each with a single bulk read
+    expectChunk(file, "streams", pFilename);
+    if(loadMeshes)
+    {
+        size_t position = 0;
+        for(uint32 i=0; i<numMeshes; i++)
+        {
+            auto& offsets = meshLayouts[i].streamOffsets;
+            auto& mesh = m_modelData.meshes[i];
+            readStream(file, position, offsets[ModelMeshLayout::Stream::Vertices], mesh.vertices, pFilename);
+            readStream(file, position, offsets[ModelMeshLayout::Stream::Normals], mesh.normals, pFilename);
+            readStream(file, position, offsets[ModelMeshLayout::Stream::Tangents], mesh.tangents, pFilename);
+            readStream(file, position, offsets[ModelMeshLayout::Stream::Bitangents], mesh.bitangents, pFilename);
+            for(uint32 j=0; j<GEP_ARRAY_SIZE(mesh.texcoords); j++)
+            {
+                readStream(file, position, offsets[ModelMeshLayout::Stream::TexCoords0 + j], mesh.texcoords[j], pFilename);
+            }
+            readStream(file, position, offsets[ModelMeshLayout::Stream::BoneInfos], mesh.boneInfos, pFilename);
+            readStream(file, position, offsets[ModelMeshLayout::Stream::Faces], mesh.faces, pFilename);
+        }
+    }
+    // skips streams that were not loaded as well
+    file.skipCurrentChunk();
+
+    // Read nodes
+    expectChunk(file, "nodes", pFilename);
+    if(loadWhat & Load::Nodes)
+    {
+        auto nodeNames = allocateArray<char>(nodeNameMemory);
+        file.readArray(nodeNames);
+        auto nodesData = allocateArray<NodeData>(numNodes);
+        auto nodes = allocateArray<NodeDrawData>(numNodes);
+
+        size_t curNamePos = 0;
+        for(uint32 i=0; i<numNodes; i++)
+        {
+            auto& node = nodes[i];
+            node.data = &nodesData[i];
+            node.data->name = nextName(nodeNames, curNamePos, pFilename);
+
+            file.read(node.transform);
+            uint32 nodeParentIndex = 0;
+            file.read(nodeParentIndex);
+            if(nodeParentIndex == std::numeric_limits<uint32>::max())
+                node.data->parent = nullptr;
+            else if(nodeParentIndex < numNodes)
+                node.data->parent = &nodes[nodeParentIndex];
+            else
+                throwLayoutTooSmall();
+
+            uint32 numNodeMeshes = 0;
+            file.read(numNodeMeshes);
+            node.meshes = allocateArray<uint32>(numNodeMeshes);
+            file.readArray(node.meshes);
+
+            uint32 numChildren = 0;
+            file.read(numChildren);
+            node.children = allocateArray<NodeDrawData*>(numChildren);
+            for(auto& child : node.children)
+            {
+                uint32 childIndex = 0;
+                file.read(childIndex);
+                if(childIndex >= numNodes)
+                    throwLayoutTooSmall();
+                child = &nodes[childIndex];
+            }
+        }
+        m_modelData.rootNode = (numNodes > 0) ? &nodes[0] : nullptr;
+        file.endReadChunk();
+    }
+    else
+    {
+        file.skipCurrentChunk();
+    }
+
+    if(file.getFileVersion() < ModelFormatVersion::Version5)
+        return;
+
+    // Read the cooked gpu data
+    expectChunk(file, "gpumeshes", pFilename);
+    if(loadWhat & Load::GpuMeshes)
+    {
+        m_modelData.gpuMeshes = allocateArray<GpuMeshData>(numMeshes);
+        for(auto& gpuMesh : m_modelData.gpuMeshes)
+        {
+            file.read(gpuMesh.vertexFormat);
+            file.read(gpuMesh.vertexStride);
+            file.read(gpuMesh.indexSize);
+            file.read(gpuMesh.numVertices);
+            file.read(gpuMesh.numIndices);
+            if(gpuMesh.vertexStride != MeshCooker::getVertexStride(gpuMesh.vertexFormat) ||
+               (gpuMesh.indexSize != sizeof(uint16) && gpuMesh.indexSize != sizeof(uint32)))
+            {
+                std::ostringstream msg;
+                msg << "Invalid gpu mesh format in file '" << pFilename << "'";
+                throw LoadingError(msg.str());
+            }
+            gpuMesh.vertices = allocateArray<uint8>((size_t)gpuMesh.numVertices * gpuMesh.vertexStride);
+            gpuMesh.indices = allocateArray<uint8>((size_t)gpuMesh.numIndices * gpuMesh.indexSize);
+            if(file.readArray(gpuMesh.vertices) != gpuMesh.vertices.length() ||
+               file.readArray(gpuMesh.indices) != gpuMesh.indices.length())
+            {
+                std::ostringstream msg;
+                msg << "Gpu mesh data is missing in file '" << pFilename << "'";
+                throw LoadingError(msg.str());
+            }
+        }
+        file.endReadChunk();
+    }
+    else
+    {
+        file.skipCurrentChunk();
+    }
 }
+
 void gep::ModelLoader::loadFromData(SmartPtr<ReferenceCounted> pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices)
 {
     m_filename = "<from data>";
@@ -745,19 +1089,6 @@ void gep::ModelLoader::loadFromData(SmartPtr<ReferenceCounted> pDataHolder, Arra
     m_modelData.meshes = ArrayPtr<MeshData>(mesh, 1);
     m_modelData.rootNode->data->meshData = GEP_NEW_ARRAY(m_pMeshDataAllocator, MeshData*, 1);
     m_modelData.rootNode->data->meshData[0] = mesh;
-    
-    vec3 vmin(std::numeric_limits<float>::max());
-    vec3 vmax(std::numeric_limits<float>::lowest());
-    for(auto& v : vertices)
-    {
-        if(v.x < vmin.x) vmin.x = v.x;
-        if(v.y < vmin.y) vmin.y = v.y;
-        if(v.z < vmin.z) vmin.z = v.z;
-        if(v.x > vmax.x) vmax.x = v.x;
-        if(v.y > vmax.y) vmax.y = v.y;
-        if(v.z > vmax.z) vmax.z = v.z;
-    }
-    mesh->bbox = AABB(vmin, vmax);
     mesh->faces = GEP_NEW_ARRAY(m_pMeshDataAllocator, FaceData, indices.length() / 3);
 
     size_t i=0;
@@ -780,6 +1111,11 @@ void gep::ModelLoader::loadFromData(SmartPtr<ReferenceCounted> pDataHolder, Arra
         i++;
     }
 
+    vec3 vmin(std::numeric_limits<float>::max());
+    vec3 vmax(std::numeric_limits<float>::lowest());
+    batch::extendBounds(mesh->vertices, vmin, vmax);
+    mesh->bbox = AABB(vmin, vmax);
+
     m_modelData.materials = GEP_NEW_ARRAY(m_pMeshDataAllocator, MaterialData, 1);
     m_modelData.materials[0].name = "dummy material";
     m_modelData.hasData = true;
@@ -0,0 +1,585 @@
+#include "stdafx.h"
+#include "gep/modelwriter.h"
+#include "gep/chunkfile.h"
+#include "gep/meshcooker.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/container/hashmap.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+
+namespace
+{
+    typedef gep::ModelLoader::ModelData ModelData;
+    typedef gep::ModelLoader::MeshData MeshData;
+    typedef gep::ModelLoader::NodeDrawData NodeDrawData;
+    typedef gep::ModelMeshLayout::Stream Stream;
+
+    const size_t STREAM_ALIGNMENT = 16;
+
+    /// all nodes in depth first order, the root node first
+    struct NodeList
+    {
+        gep::DynamicArray<const NodeDrawData*> nodes;
+        gep::Hashmap<const NodeDrawData*, gep::uint32, gep::PointerHashPolicy> indices;
+
+        explicit NodeList(const NodeDrawData* pRoot)
+        {
+            if(pRoot != nullptr)
+                add(pRoot);
+        }
+
+        void add(const NodeDrawData* pNode)
+        {
+            indices[pNode] = (gep::uint32)nodes.length();
+            nodes.append(pNode);
+            for(auto pChild : pNode->children)
+                add(pChild);
+        }
+
+        gep::uint32 indexOf(const NodeDrawData* pNode)
+        {
+            if(pNode == nullptr)
+                return std::numeric_limits<gep::uint32>::max();
+            gep::uint32 index = 0;
+            auto result = indices.tryGet(pNode, index);
+            GEP_ASSERT(result == gep::SUCCESS, "node is not part of the hierarchy");
+            GEP_UNUSED(result);
+            return index;
+        }
+    };
+
+    gep::uint32 textureIndex(const ModelData& data, const char* file)
+    {
+        for(size_t i=0; i<data.textures.length(); i++)
+        {
+            if(data.textures[i] == file || strcmp(data.textures[i], file) == 0)
+                return (gep::uint32)i;
+        }
+        throw gep::Exception(gep::format("texture '%s' is referenced by a material but not in the texture list", file));
+    }
+
+    const NodeDrawData* parentOf(const NodeDrawData* pNode)
+    {
+        return (pNode->data != nullptr) ? pNode->data->parent : nullptr;
+    }
+
+    const char* nameOf(const NodeDrawData* pNode)
+    {
+        return (pNode->data != nullptr && pNode->data->name != nullptr) ? pNode->data->name : "";
+    }
+
+    const char* nameOrEmpty(const char* name)
+    {
+        return (name != nullptr) ? name : "";
+    }
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    /// Size of a block of '\0' terminated names as the Version4 loader allocates it
+    struct NameBlock
+    {
+        size_t length;
+        NameBlock() : length(0) {}
+        void add(const char* name) { length += strlen(nameOrEmpty(name)) + 1; }
+        gep::uint32 size() const { return (gep::uint32)gep::AlignmentHelper::__alignedSize(length); }
+    };
+
+    struct MemoryLayout
+    {
+        NameBlock textureNames;
+        NameBlock materialNames;
+        NameBlock boneNames;
+        NameBlock nodeNames;
+        gep::DynamicArray<gep::ModelMeshLayout> meshes;
+        size_t streamsSize;
+
+        MemoryLayout(const ModelData& data, NodeList& nodeList) : streamsSize(0)
+        {
+            for(auto texture : data.textures)
+                textureNames.add(texture);
+            for(auto& material : data.materials)
+                materialNames.add(material.name);
+            for(auto pNode : nodeList.nodes)
+                nodeNames.add(nameOf(pNode));
+
+            meshes.resize(data.meshes.length());
+            for(size_t i=0; i<data.meshes.length(); i++)
+            {
+                auto& mesh = data.meshes[i];
+                auto& layout = meshes[i];
+                for(auto& bone : mesh.bones)
+                    boneNames.add(bone.name);
+
+                auto numVertices = mesh.vertices.length();
+                layout.materialIndex = mesh.materialIndex;
+                for(int j=0; j<3; j++)
+                {
+                    layout.minBounds[j] = mesh.bbox.getMin().data[j];
+                    layout.maxBounds[j] = mesh.bbox.getMax().data[j];
+                }
+                layout.numVertices = (gep::uint32)numVertices;
+                layout.numFaces = (gep::uint32)mesh.faces.length();
+                layout.numBones = (gep::uint32)mesh.bones.length();
+
+                size_t streamSizes[Stream::Count] = {
+                    mesh.vertices.length() * sizeof(gep::vec3),
+                    mesh.normals.length() * sizeof(gep::vec3),
+                    mesh.tangents.length() * sizeof(gep::vec3),
+                    mesh.bitangents.length() * sizeof(gep::vec3),
+                    mesh.texcoords[0].length() * sizeof(gep::vec2),
+                    mesh.texcoords[1].length() * sizeof(gep::vec2),
+                    mesh.texcoords[2].length() * sizeof(gep::vec2),
+                    mesh.texcoords[3].length() * sizeof(gep::vec2),
+                    mesh.boneInfos.length() * sizeof(gep::ModelLoader::BoneInfo),
+                    mesh.faces.length() * sizeof(gep::ModelLoader::FaceData)
+                };
+                for(int stream = 0; stream < Stream::Count; stream++)
+                {
+                    // vertices and faces are always there, even if empty
+                    bool isPresent = streamSizes[stream] > 0 || stream == Stream::Vertices || stream == Stream::Faces;
+                    if(!isPresent)
+                    {
+                        layout.streamOffsets[stream] = gep::ModelMeshLayout::NOT_PRESENT;
+                        continue;
+                    }
+                    streamsSize = alignUp(streamsSize, STREAM_ALIGNMENT);
+                    layout.streamOffsets[stream] = (gep::uint32)streamsSize;
+                    streamsSize += streamSizes[stream];
+                }
+            }
+        }
+    };
+
+    struct SizeCounter
+    {
+        size_t size;
+        SizeCounter() : size(0) {}
+
+        template <typename T>
+        void add(size_t num)
+        {
+            if(num > 0)
+                size += gep::AlignmentHelper::__alignedSize(sizeof(T) * num);
+        }
+    };
+
+    void writeNameBlock(gep::Chunkfile& file, const NameBlock& block, gep::DynamicArray<const char*>& names)
+    {
+        gep::DynamicArray<char> data;
+        data.resize(block.size());
+        size_t position = 0;
+        for(auto name : names)
+        {
+            auto length = strlen(nameOrEmpty(name)) + 1;
+            memcpy(data.toArray().getPtr() + position, nameOrEmpty(name), length);
+            position += length;
+        }
+        memset(data.toArray().getPtr() + position, 0, data.length() - position);
+        file.writeArray(data.toArray());
+    }
+
+    void writeName(gep::Chunkfile& file, const char* name)
+    {
+        name = nameOrEmpty(name);
+        file.write((gep::uint32)strlen(name));
+        file.writeArray(gep::ArrayPtr<char>((char*)name, strlen(name)));
+    }
+
+    template <typename T>
+    void writeStream(gep::Chunkfile& file, size_t& position, gep::uint32 offset, const gep::ArrayPtr<T>& data)
+    {
+        if(offset == gep::ModelMeshLayout::NOT_PRESENT)
+            return;
+        static const gep::uint8 zeros[STREAM_ALIGNMENT] = {};
+        GEP_ASSERT(offset >= position && offset - position < STREAM_ALIGNMENT);
+        file.writeArray(gep::ArrayPtr<gep::uint8>((gep::uint8*)zeros, offset - position));
+        file.writeArray(gep::ArrayPtr<T>(data.getPtr(), data.length()));
+        position = offset + sizeof(T) * data.length();
+    }
+
+    void writeVersion4(gep::Chunkfile& file, const ModelData& data, gep::ModelFormatVersion::Enum version)
+    {
+        NodeList nodeList(data.rootNode);
+        MemoryLayout layout(data, nodeList);
+
+        file.startWriteChunk("layout");
+        file.write(gep::ModelWriter::computeMeshDataSize(data, version));
+        file.write((gep::uint32)data.textures.length());
+        file.write(layout.textureNames.size());
+        file.write((gep::uint32)data.materials.length());
+        file.write(layout.materialNames.size());
+        file.write((gep::uint32)data.meshes.length());
+        file.write(layout.boneNames.size());
+        file.write((gep::uint32)nodeList.nodes.length());
+        file.write(layout.nodeNames.size());
+        file.writeArray(layout.meshes.toArray());
+        file.endWriteChunk();
+
+        gep::DynamicArray<const char*> names;
+
+        file.startWriteChunk("textures");
+        for(auto texture : data.textures)
+            names.append(texture);
+        writeNameBlock(file, layout.textureNames, names);
+        file.endWriteChunk();
+
+        file.startWriteChunk("materials");
+        names.clear();
+        for(auto& material : data.materials)
+            names.append(material.name);
+        writeNameBlock(file, layout.materialNames, names);
+        for(auto& material : data.materials)
+        {
+            file.write((gep::uint32)material.textures.length());
+            for(auto& texture : material.textures)
+            {
+                file.write(textureIndex(data, texture.file));
+                file.write((gep::uint8)texture.semantic);
+            }
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("bones");
+        names.clear();
+        for(auto& mesh : data.meshes)
+        {
+            for(auto& bone : mesh.bones)
+                names.append(bone.name);
+        }
+        writeNameBlock(file, layout.boneNames, names);
+        for(auto& mesh : data.meshes)
+        {
+            for(auto& bone : mesh.bones)
+                file.write(bone.offsetMatrix);
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("streams");
+        size_t position = 0;
+        for(size_t i=0; i<data.meshes.length(); i++)
+        {
+            auto& mesh = data.meshes[i];
+            auto& offsets = layout.meshes[i].streamOffsets;
+            writeStream(file, position, offsets[Stream::Vertices], mesh.vertices);
+            writeStream(file, position, offsets[Stream::Normals], mesh.normals);
+            writeStream(file, position, offsets[Stream::Tangents], mesh.tangents);
+            writeStream(file, position, offsets[Stream::Bitangents], mesh.bitangents);
+            for(int j=0; j<4; j++)
+                writeStream(file, position, offsets[Stream::TexCoords0 + j], mesh.texcoords[j]);
+            writeStream(file, position, offsets[Stream::BoneInfos], mesh.boneInfos);
+            writeStream(file, position, offsets[Stream::Faces], mesh.faces);
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("nodes");
+        names.clear();
+        for(auto pNode : nodeList.nodes)
+            names.append(nameOf(pNode));
+        writeNameBlock(file, layout.nodeNames, names);
+        for(auto pNode : nodeList.nodes)
+        {
+            file.write(pNode->transform);
+            file.write(nodeList.indexOf(parentOf(pNode)));
+            file.writeArrayWithLength<gep::uint32, gep::uint32>(gep::ArrayPtr<gep::uint32>(pNode->meshes.getPtr(), pNode->meshes.length()));
+            file.write((gep::uint32)pNode->children.length());
+            for(auto pChild : pNode->children)
+                file.write(nodeList.indexOf(pChild));
+        }
+        file.endWriteChunk();
+
+        if(version < gep::ModelFormatVersion::Version5)
+            return;
+
+        file.startWriteChunk("gpumeshes");
+        for(auto& gpuMesh : data.gpuMeshes)
+        {
+            file.write(gpuMesh.vertexFormat);
+            file.write(gpuMesh.vertexStride);
+            file.write(gpuMesh.indexSize);
+            file.write(gpuMesh.numVertices);
+            file.write(gpuMesh.numIndices);
+            file.writeArray(gpuMesh.vertices);
+            file.writeArray(gpuMesh.indices);
+        }
+        file.endWriteChunk();
+    }
+
+    void writeCompressedVectors(gep::Chunkfile& file, const char* chunkName, const gep::ArrayPtr<gep::vec3>& vectors)
+    {
+        if(vectors.length() == 0)
+            return;
+        file.startWriteChunk(chunkName);
+        for(auto& v : vectors)
+        {
+            for(int i=0; i<3; i++)
+                file.write((gep::int16)(v.data[i] * (float)std::numeric_limits<gep::int16>::max()));
+        }
+        file.endWriteChunk();
+    }
+
+    void writeVersion3(gep::Chunkfile& file, const ModelData& data)
+    {
+        NodeList nodeList(data.rootNode);
+
+        gep::uint32 texturePathMemory = 0, materialNameMemory = 0, boneNameMemory = 0;
+        gep::uint32 numBones = 0, numBoneInfos = 0;
+        gep::uint32 numNodeReferences = 0, nodeNameMemory = 0, numMeshReferences = 0, numTextureReferences = 0;
+        for(auto texture : data.textures)
+            texturePathMemory += (gep::uint32)strlen(texture);
+        for(auto& material : data.materials)
+        {
+            materialNameMemory += (gep::uint32)strlen(nameOrEmpty(material.name));
+            numTextureReferences += (gep::uint32)material.textures.length();
+        }
+        for(auto& mesh : data.meshes)
+        {
+            for(auto& bone : mesh.bones)
+                boneNameMemory += (gep::uint32)strlen(nameOrEmpty(bone.name));
+            numBones += (gep::uint32)mesh.bones.length();
+            numBoneInfos += (gep::uint32)mesh.boneInfos.length();
+        }
+        for(auto pNode : nodeList.nodes)
+        {
+            nodeNameMemory += (gep::uint32)strlen(nameOf(pNode));
+            numNodeReferences += (gep::uint32)pNode->children.length();
+            numMeshReferences += (gep::uint32)pNode->meshes.length();
+        }
+
+        file.startWriteChunk("sizeinfo");
+        file.write((gep::uint32)data.textures.length());
+        file.write(texturePathMemory);
+        file.write(materialNameMemory);
+        file.write(boneNameMemory);
+        file.write(numBones);
+        file.write(numBoneInfos);
+        file.write((gep::uint32)data.materials.length());
+        file.write((gep::uint32)data.meshes.length());
+        for(auto& mesh : data.meshes)
+        {
+            gep::uint32 flags = gep::PerVertexData::Position;
+            if(mesh.normals.length() > 0) flags |= gep::PerVertexData::Normal;
+            if(mesh.tangents.length() > 0) flags |= gep::PerVertexData::Tangent;
+            if(mesh.bitangents.length() > 0) flags |= gep::PerVertexData::Bitangent;
+            gep::uint32 numTexCoords = 0;
+            for(int i=0; i<4 && mesh.texcoords[i].length() > 0; i++)
+            {
+                flags |= gep::PerVertexData::TexCoord0 << i;
+                numTexCoords++;
+            }
+            file.write((gep::uint32)mesh.vertices.length());
+            file.write(flags);
+            for(gep::uint32 i=0; i<numTexCoords; i++)
+                file.write((gep::uint8)2);
+            file.write((gep::uint32)mesh.faces.length());
+        }
+        file.write((gep::uint32)nodeList.nodes.length());
+        file.write(numNodeReferences);
+        file.write(nodeNameMemory);
+        file.write(numMeshReferences);
+        file.write(numTextureReferences);
+        file.endWriteChunk();
+
+        file.startWriteChunk("textures");
+        file.write((gep::uint32)data.textures.length());
+        for(auto texture : data.textures)
+            writeName(file, texture);
+        file.endWriteChunk();
+
+        file.startWriteChunk("materials");
+        file.write((gep::uint32)data.materials.length());
+        for(auto& material : data.materials)
+        {
+            file.startWriteChunk("mat");
+            writeName(file, material.name);
+            file.write((gep::uint32)material.textures.length());
+            for(auto& texture : material.textures)
+            {
+                file.write(textureIndex(data, texture.file));
+                file.write((gep::uint8)texture.semantic);
+            }
+            file.endWriteChunk();
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("meshes");
+        file.write((gep::uint32)data.meshes.length());
+        for(auto& mesh : data.meshes)
+        {
+            file.startWriteChunk("mesh");
+            file.write(mesh.materialIndex);
+            // the loader enlarges the box again
+            auto maxBounds = mesh.bbox.getMax() - gep::vec3(0.01f, 0.01f, 0.01f);
+            file.writeArray(gep::ArrayPtr<float>((float*)mesh.bbox.getMin().data, 3));
+            file.writeArray(gep::ArrayPtr<float>(maxBounds.data, 3));
+            file.write((gep::uint32)mesh.vertices.length());
+
+            file.startWriteChunk("vertices");
+            file.writeArray(gep::ArrayPtr<gep::vec3>(mesh.vertices.getPtr(), mesh.vertices.length()));
+            file.endWriteChunk();
+
+            writeCompressedVectors(file, "normals", mesh.normals);
+            writeCompressedVectors(file, "tangents", mesh.tangents);
+            writeCompressedVectors(file, "bitangents", mesh.bitangents);
+
+            if(mesh.texcoords[0].length() > 0)
+            {
+                file.startWriteChunk("texcoords");
+                gep::uint8 numTexCoords = 0;
+                while(numTexCoords < 4 && mesh.texcoords[numTexCoords].length() > 0)
+                    numTexCoords++;
+                file.write(numTexCoords);
+                for(gep::uint8 i=0; i<numTexCoords; i++)
+                {
+                    file.write((gep::uint8)2);
+                    file.writeArray(gep::ArrayPtr<gep::vec2>(mesh.texcoords[i].getPtr(), mesh.texcoords[i].length()));
+                }
+                file.endWriteChunk();
+            }
+
+            if(mesh.bones.length() > 0)
+            {
+                file.startWriteChunk("bones");
+                file.write((gep::uint32)mesh.bones.length());
+                for(auto& bone : mesh.bones)
+                {
+                    writeName(file, bone.name);
+                    file.write(bone.offsetMatrix);
+                }
+                file.write((gep::uint32)mesh.boneInfos.length());
+                for(auto& boneInfo : mesh.boneInfos)
+                {
+                    for(int i=0; i<gep::ModelLoader::BoneInfo::NUM_SUPPORTED_BONES; i++)
+                        file.write((gep::uint16)boneInfo.boneIndices[i]);
+                    for(int i=0; i<gep::ModelLoader::BoneInfo::NUM_SUPPORTED_BONES; i++)
+                        file.write(boneInfo.weights[i]);
+                }
+                file.endWriteChunk();
+            }
+
+            file.startWriteChunk("faces");
+            file.write((gep::uint32)mesh.faces.length());
+            if(mesh.vertices.length() > std::numeric_limits<gep::uint16>::max())
+            {
+                file.writeArray(gep::ArrayPtr<gep::ModelLoader::FaceData>(mesh.faces.getPtr(), mesh.faces.length()));
+            }
+            else
+            {
+                for(auto& face : mesh.faces)
+                {
+                    for(int i=0; i<3; i++)
+                        file.write((gep::uint16)face.indices[i]);
+                }
+            }
+            file.endWriteChunk();
+
+            file.endWriteChunk();
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("nodes");
+        file.write((gep::uint32)nodeList.nodes.length());
+        for(auto pNode : nodeList.nodes)
+        {
+            writeName(file, nameOf(pNode));
+            file.write(pNode->transform);
+            file.write(nodeList.indexOf(parentOf(pNode)));
+            file.writeArrayWithLength<gep::uint32, gep::uint32>(gep::ArrayPtr<gep::uint32>(pNode->meshes.getPtr(), pNode->meshes.length()));
+            file.write((gep::uint32)pNode->children.length());
+            for(auto pChild : pNode->children)
+                file.write(nodeList.indexOf(pChild));
+        }
+        file.endWriteChunk();
+    }
+}
+
+void gep::ModelWriter::write(const ModelLoader::ModelData& data, const char* pFilename, ModelFormatVersion::Enum version)
+{
+    GEP_ASSERT(version >= ModelFormatVersion::Version3 && version <= ModelFormatVersion::Version5, "can only write Version3 to Version5", version);
+    GEP_ASSERT(version < ModelFormatVersion::Version5 || data.gpuMeshes.length() == data.meshes.length(),
+        "Version5 needs gpu data for every mesh, use ModelWriter::cook");
+
+    Chunkfile file(pFilename, Chunkfile::Operation::write);
+    file.startWriting("thModel", version);
+    if(version >= ModelFormatVersion::Version4)
+        writeVersion4(file, data, version);
+    else
+        writeVersion3(file, data);
+    file.endWriting();
+}
+
+void gep::ModelWriter::cook(const ModelLoader::ModelData& data, const char* pFilename, MeshCooker::Statistics* pStatistics)
+{
+    DynamicArray<CookedMesh*> cookedMeshes;
+    SCOPE_EXIT{ for(auto pCookedMesh : cookedMeshes) delete pCookedMesh; });
+
+    DynamicArray<ModelLoader::MeshData> meshes;
+    DynamicArray<ModelLoader::GpuMeshData> gpuMeshes;
+    for(auto& mesh : data.meshes)
+    {
+        cookedMeshes.append(new CookedMesh(mesh, pStatistics));
+        meshes.append(cookedMeshes.lastElement()->getMeshData());
+        gpuMeshes.append(cookedMeshes.lastElement()->getGpuMeshData());
+    }
+
+    // nodes reference meshes by index, so they stay valid
+    ModelLoader::ModelData cookedData = data;
+    cookedData.meshes = meshes.toArray();
+    cookedData.gpuMeshes = gpuMeshes.toArray();
+    write(cookedData, pFilename, ModelFormatVersion::Version5);
+}
+
+gep::uint32 gep::ModelWriter::computeMeshDataSize(const ModelLoader::ModelData& data, ModelFormatVersion::Enum version)
+{
+    NodeList nodeList(data.rootNode);
+    MemoryLayout layout(data, nodeList);
+
+    // has to match the allocations in ModelLoader::loadVersion4
+    SizeCounter counter;
+    counter.add<char>(layout.textureNames.size());
+    counter.add<const char*>(data.textures.length());
+
+    counter.add<char>(layout.materialNames.size());
+    counter.add<ModelLoader::MaterialData>(data.materials.length());
+    for(auto& material : data.materials)
+        counter.add<ModelLoader::TextureReference>(material.textures.length());
+
+    counter.add<ModelLoader::MeshData>(data.meshes.length());
+    for(auto& mesh : data.meshes)
+    {
+        counter.add<vec3>(mesh.vertices.length());
+        counter.add<vec3>(mesh.normals.length());
+        counter.add<vec3>(mesh.tangents.length());
+        counter.add<vec3>(mesh.bitangents.length());
+        for(auto& texcoords : mesh.texcoords)
+            counter.add<vec2>(texcoords.length());
+        counter.add<ModelLoader::BoneInfo>(mesh.boneInfos.length());
+        counter.add<ModelLoader::FaceData>(mesh.faces.length());
+        counter.add<ModelLoader::BoneData>(mesh.bones.length());
+    }
+    counter.add<char>(layout.boneNames.size());
+
+    counter.add<char>(layout.nodeNames.size());
+    counter.add<ModelLoader::NodeData>(nodeList.nodes.length());
+    counter.add<NodeDrawData>(nodeList.nodes.length());
+    for(auto pNode : nodeList.nodes)
+    {
+        counter.add<uint32>(pNode->meshes.length());
+        counter.add<NodeDrawData*>(pNode->children.length());
+    }
+
+    if(version >= ModelFormatVersion::Version5)
+    {
+        counter.add<ModelLoader::GpuMeshData>(data.gpuMeshes.length());
+        for(auto& gpuMesh : data.gpuMeshes)
+        {
+            counter.add<uint8>(gpuMesh.vertices.length());
+            counter.add<uint8>(gpuMesh.indices.length());
+        }
+    }
+
+    GEP_ASSERT(counter.size <= std::numeric_limits<uint32>::max(), "model is to big");
+    return (uint32)counter.size;
+}
@@ -4,7 +4,10 @@
 
 
 gep::Settings::Settings() :
-    m_video()
+    m_video(),
+    m_resources(),
+    m_physics(),
+    m_scripting()
 {
 }
 
@@ -19,6 +22,29 @@ void gep::Settings::loadFromScriptTable(ScriptTableWrapper table)
         table.tryGet("video", videoSettings);
         videoSettings.tryGet("screenResolution", m_video.screenResolution);
         videoSettings.tryGet("vsyncEnabled", m_video.vsyncEnabled);
+        videoSettings.tryGet("headless", m_video.headless);
+        videoSettings.tryGet("headlessFrames", m_video.headlessFrames);
+        videoSettings.tryGet("textureBudget", m_video.textureBudget);
+    }
+
+    {
+        ScriptTableWrapper resourceSettings;
+        table.tryGet("resources", resourceSettings);
+        resourceSettings.tryGet("numLoaderThreads", m_resources.numLoaderThreads);
+        resourceSettings.tryGet("archive", m_resources.archive);
+        resourceSettings.tryGet("looseFilesFirst", m_resources.looseFilesFirst);
+    }
+
+    {
+        ScriptTableWrapper physicsSettings;
+        table.tryGet("physics", physicsSettings);
+        physicsSettings.tryGet("useNativeBackend", m_physics.useNativeBackend);
+    }
+
+    {
+        ScriptTableWrapper scriptingSettings;
+        table.tryGet("scripting", scriptingSettings);
+        scriptingSettings.tryGet("numPooledStates", m_scripting.numPooledStates);
     }
 
     // more ...
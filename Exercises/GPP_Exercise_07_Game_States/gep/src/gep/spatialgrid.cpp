@@ -0,0 +1,310 @@
+#include "stdafx.h"
+#include "gep/spatialGrid.h"
+
+namespace
+{
+    /// cell coordinates are clamped to this, far away positions share the outermost cells
+    const float MAX_CELL_COORDINATE = 1000000.0f;
+
+    /// \brief the distance in cells along the axis where it is largest
+    inline gep::int32 cellDistance(gep::int32 x, gep::int32 y, gep::int32 z)
+    {
+        x = x < 0 ? -x : x;
+        y = y < 0 ? -y : y;
+        z = z < 0 ? -z : z;
+        return GEP_MAX(x, GEP_MAX(y, z));
+    }
+}
+
+gep::SpatialGrid::SpatialGrid(float cellSize, IAllocator* pAllocator) :
+    m_pAllocator(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    m_cellSize(cellSize),
+    m_inverseCellSize(1.0f / cellSize),
+    m_proxies(m_pAllocator),
+    m_freeProxy(INVALID_PROXY),
+    m_numProxies(0),
+    m_cells(m_pAllocator),
+    m_freeCell(INVALID_PROXY),
+    m_cellIndices(m_pAllocator)
+{
+    GEP_ASSERT(cellSize > 0.0f, "the cells need a size", cellSize);
+    Cell largeCell = { { 0, 0, 0 }, INVALID_PROXY, 0 };
+    m_cells.append(largeCell);
+}
+
+gep::uint32 gep::SpatialGrid::insert(const vec3& min, const vec3& max, void* pUserData)
+{
+    uint32 proxy = m_freeProxy;
+    if(proxy != INVALID_PROXY)
+        m_freeProxy = m_proxies[proxy].next;
+    else
+    {
+        proxy = static_cast<uint32>(m_proxies.length());
+        m_proxies.resize(m_proxies.length() + 1);
+    }
+    Proxy& entry = m_proxies[proxy];
+    entry.min = min;
+    entry.max = max;
+    entry.pUserData = pUserData;
+    link(proxy, findCell(min, max));
+    m_numProxies++;
+    return proxy;
+}
+
+void gep::SpatialGrid::remove(uint32 proxy)
+{
+    GEP_ASSERT(proxy < m_proxies.length() && m_proxies[proxy].cell != INVALID_PROXY, "invalid proxy", proxy);
+    unlink(proxy);
+    m_proxies[proxy].pUserData = nullptr;
+    m_proxies[proxy].next = m_freeProxy;
+    m_freeProxy = proxy;
+    m_numProxies--;
+}
+
+void gep::SpatialGrid::update(uint32 proxy, const vec3& min, const vec3& max)
+{
+    GEP_ASSERT(proxy < m_proxies.length() && m_proxies[proxy].cell != INVALID_PROXY, "invalid proxy", proxy);
+    Proxy& entry = m_proxies[proxy];
+    entry.min = min;
+    entry.max = max;
+
+    const uint32 oldCell = entry.cell;
+    const uint32 newCell = findCell(min, max);
+    if(newCell != oldCell)
+    {
+        // the old cell is freed after the new one was found, so a proxy alone in its cell doesn't thrash the hash map
+        unlink(proxy);
+        link(proxy, newCell);
+    }
+}
+
+void gep::SpatialGrid::clear()
+{
+    m_proxies.resize(0);
+    m_freeProxy = INVALID_PROXY;
+    m_numProxies = 0;
+    m_cells.resize(1);
+    m_cells[LARGE_CELL].first = INVALID_PROXY;
+    m_cells[LARGE_CELL].count = 0;
+    m_freeCell = INVALID_PROXY;
+    m_cellIndices.clear();
+}
+
+void gep::SpatialGrid::setCellSize(float cellSize)
+{
+    GEP_ASSERT(cellSize > 0.0f, "the cells need a size", cellSize);
+    m_cellSize = cellSize;
+    m_inverseCellSize = 1.0f / cellSize;
+
+    m_cells.resize(1);
+    m_cells[LARGE_CELL].first = INVALID_PROXY;
+    m_cells[LARGE_CELL].count = 0;
+    m_freeCell = INVALID_PROXY;
+    m_cellIndices.clear();
+    for(uint32 proxy = 0; proxy < m_proxies.length(); proxy++)
+    {
+        Proxy& entry = m_proxies[proxy];
+        if(entry.cell == INVALID_PROXY)
+            continue;
+        link(proxy, findCell(entry.min, entry.max));
+    }
+}
+
+gep::uint32 gep::SpatialGrid::queryNearest(const vec3& position, ArrayPtr<uint32> proxies) const
+{
+    const uint32 maxCount = static_cast<uint32>(proxies.length());
+    if(maxCount == 0)
+        return 0;
+
+    // a max heap of the closest proxies found so far, the distances are recomputed instead of stored
+    // so that the query doesn't need any memory besides the result
+    uint32 count = 0;
+    auto distance = [&](uint32 proxy) { return squaredDistance(m_proxies[proxy].min, m_proxies[proxy].max, position); };
+    auto consider = [&](uint32 proxy) -> bool
+    {
+        const float d = distance(proxy);
+        uint32 index;
+        if(count < maxCount)
+        {
+            index = count++;
+            while(index > 0 && distance(proxies[(index - 1) / 2]) < d)
+            {
+                proxies[index] = proxies[(index - 1) / 2];
+                index = (index - 1) / 2;
+            }
+        }
+        else
+        {
+            if(d >= distance(proxies[0]))
+                return true;
+            index = 0;
+            for(;;)
+            {
+                uint32 child = index * 2 + 1;
+                if(child >= count)
+                    break;
+                if(child + 1 < count && distance(proxies[child + 1]) > distance(proxies[child]))
+                    child++;
+                if(distance(proxies[child]) <= d)
+                    break;
+                proxies[index] = proxies[child];
+                index = child;
+            }
+        }
+        proxies[index] = proxy;
+        return true;
+    };
+
+    visitCell(LARGE_CELL, consider);
+
+    // walk rings of cells around the cell of the position until nothing closer can be found
+    const CellKey center = computeKey(position);
+    size_t numVisited = 0;
+    const size_t numInGrid = m_numProxies - m_cells[LARGE_CELL].count;
+    // how far the position is from the border of its cell
+    float border = m_cellSize;
+    for(int i = 0; i < 3; i++)
+    {
+        const float local = position.data[i] * m_inverseCellSize - float((&center.x)[i]);
+        border = GEP_MIN(border, GEP_MIN(local, 1.0f - local) * m_cellSize);
+    }
+    border = GEP_MAX(border, 0.0f);
+
+    for(int32 ring = 0; numVisited < numInGrid; ring++)
+    {
+        const uint64 ringSize = uint64(2 * ring + 1) * uint64(2 * ring + 1) * uint64(2 * ring + 1);
+        if(ringSize > m_cellIndices.count())
+        {
+            // the rings got larger than the occupied cells, visit the remaining ones directly
+            for(uint32 cell = LARGE_CELL + 1; cell < m_cells.length(); cell++)
+            {
+                const CellKey& key = m_cells[cell].key;
+                const int32 cellRing = cellDistance(key.x - center.x, key.y - center.y, key.z - center.z);
+                if(m_cells[cell].count > 0 && cellRing >= ring)
+                    visitCell(cell, consider);
+            }
+            break;
+        }
+
+        CellKey key;
+        for(key.x = center.x - ring; key.x <= center.x + ring; key.x++)
+        for(key.y = center.y - ring; key.y <= center.y + ring; key.y++)
+        {
+            const bool isSide = cellDistance(key.x - center.x, key.y - center.y, 0) == ring;
+            const int32 step = isSide || ring == 0 ? 1 : 2 * ring;
+            for(key.z = center.z - ring; key.z <= center.z + ring; key.z += step)
+            {
+                uint32 cell;
+                if(m_cellIndices.tryGet(key, cell) == SUCCESS)
+                {
+                    numVisited += m_cells[cell].count;
+                    visitCell(cell, consider);
+                }
+            }
+        }
+
+        // the boxes in the cells outside of the ring are at least this far away
+        const float reach = float(ring) * m_cellSize + border - m_cellSize * 0.5f;
+        if(count == maxCount && reach > 0.0f && distance(proxies[0]) <= reach * reach)
+            break;
+    }
+
+    // heap sort, the closest proxy first
+    for(uint32 end = count; end > 1; end--)
+    {
+        const uint32 last = proxies[end - 1];
+        proxies[end - 1] = proxies[0];
+        const float d = distance(last);
+        uint32 index = 0;
+        for(;;)
+        {
+            uint32 child = index * 2 + 1;
+            if(child >= end - 1)
+                break;
+            if(child + 1 < end - 1 && distance(proxies[child + 1]) > distance(proxies[child]))
+                child++;
+            if(distance(proxies[child]) <= d)
+                break;
+            proxies[index] = proxies[child];
+            index = child;
+        }
+        proxies[index] = last;
+    }
+    return count;
+}
+
+gep::SpatialGrid::CellKey gep::SpatialGrid::computeKey(const vec3& position) const
+{
+    CellKey key;
+    int32* coordinates = &key.x;
+    for(int i = 0; i < 3; i++)
+    {
+        const float coordinate = floorf(position.data[i] * m_inverseCellSize);
+        coordinates[i] = static_cast<int32>(GEP_MAX(-MAX_CELL_COORDINATE, GEP_MIN(coordinate, MAX_CELL_COORDINATE)));
+    }
+    return key;
+}
+
+gep::uint32 gep::SpatialGrid::findCell(const vec3& min, const vec3& max)
+{
+    const vec3 extents = max - min;
+    if(GEP_MAX(extents.x, GEP_MAX(extents.y, extents.z)) > m_cellSize)
+        return LARGE_CELL;
+
+    const CellKey key = computeKey((min + max) * 0.5f);
+    uint32& cellIndex = m_cellIndices[key];
+    if(cellIndex != LARGE_CELL)
+        return cellIndex;
+
+    // operator[] default constructed the index to 0, which is the large cell and never in the map
+    if(m_freeCell != INVALID_PROXY)
+    {
+        cellIndex = m_freeCell;
+        m_freeCell = m_cells[cellIndex].first;
+    }
+    else
+    {
+        cellIndex = static_cast<uint32>(m_cells.length());
+        m_cells.resize(m_cells.length() + 1);
+    }
+    Cell& cell = m_cells[cellIndex];
+    cell.key = key;
+    cell.first = INVALID_PROXY;
+    cell.count = 0;
+    return cellIndex;
+}
+
+void gep::SpatialGrid::link(uint32 proxy, uint32 cell)
+{
+    Proxy& entry = m_proxies[proxy];
+    Cell& target = m_cells[cell];
+    entry.cell = cell;
+    entry.prev = INVALID_PROXY;
+    entry.next = target.first;
+    if(target.first != INVALID_PROXY)
+        m_proxies[target.first].prev = proxy;
+    target.first = proxy;
+    target.count++;
+}
+
+void gep::SpatialGrid::unlink(uint32 proxy)
+{
+    Proxy& entry = m_proxies[proxy];
+    const uint32 cellIndex = entry.cell;
+    Cell& cell = m_cells[cellIndex];
+    if(entry.prev != INVALID_PROXY)
+        m_proxies[entry.prev].next = entry.next;
+    else
+        cell.first = entry.next;
+    if(entry.next != INVALID_PROXY)
+        m_proxies[entry.next].prev = entry.prev;
+    entry.cell = INVALID_PROXY;
+    cell.count--;
+
+    if(cell.count == 0 && cellIndex != LARGE_CELL)
+    {
+        m_cellIndices.remove(cell.key);
+        cell.first = m_freeCell;
+        m_freeCell = cellIndex;
+    }
+}
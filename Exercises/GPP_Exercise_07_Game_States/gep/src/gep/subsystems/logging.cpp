@@ -3,56 +3,524 @@
 #include <stdarg.h>
 #include <stdio.h>
 
-gep::Logging::Logging()
+namespace
 {
+    struct ThreadState
+    {
+        gep::uint32 generation;
+        void* pBuffer;
+    };
+
+    // plain data, zero initialized for every thread without running any code
+    __declspec(thread) ThreadState t_threadState;
+
+    // 0 is never handed out, so the zero initialized thread states don't belong to any logging
+    volatile LONG g_lastGeneration = 0;
+
+    const gep::uint32 WAIT_TIMEOUT_MS = 100;
+
+    struct RecordKind
+    {
+        enum Enum
+        {
+            Formatted,
+            Unformatted,
+            /// fills the end of the ring buffer when the next record doesn't fit anymore
+            Padding
+        };
+    };
+
+    /// all records are a multiple of the header size, so there is always room for a padding header
+    struct RecordHeader
+    {
+        gep::int64 sequence;
+        union
+        {
+            const char* format;
+            gep::uint64 formatStorage;
+        };
+        gep::uint32 size;
+        gep::uint16 kind;
+        gep::uint16 channel;
+        gep::uint32 numSuppressed;
+        /// how many conversions of the format have their arguments in the record
+        gep::uint32 numConversions;
+    };
+    static_assert(sizeof(RecordHeader) == 32, "the records are aligned to the header size");
+
+    struct ArgumentType
+    {
+        enum Enum
+        {
+            Int,
+            UnsignedInt,
+            Double,
+            String,
+            WideString,
+            Pointer,
+            /// %% has no argument
+            Percent,
+            /// unknown conversions and %n, nothing after them is captured
+            Invalid
+        };
+    };
+
+    struct Length
+    {
+        enum Enum
+        {
+            Default,
+            Char,
+            Short,
+            Long,
+            LongLong,
+            Size,
+            LongDouble
+        };
+    };
+
+    /// \brief a printf conversion specification
+    struct Conversion
+    {
+        const char* begin;
+        const char* flags;
+        size_t numFlags;
+        int width;
+        int precision;
+        bool isWidthArgument;
+        bool isPrecisionArgument;
+        Length::Enum length;
+        char type;
+        ArgumentType::Enum argumentType;
+    };
+
+    int parseNumber(const char*& p)
+    {
+        int result = 0;
+        while(*p >= '0' && *p <= '9')
+        {
+            result = result * 10 + (*p - '0');
+            p++;
+        }
+        return result;
+    }
+
+    /// \brief finds the next conversion in the format and moves behind it
+    /// \return false if there is none
+    bool parseConversion(const char*& p, Conversion& conversion)
+    {
+        while(*p != '\0' && *p != '%')
+            p++;
+        if(*p == '\0')
+            return false;
+
+        conversion.begin = p++;
+        conversion.flags = p;
+        while(*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+            p++;
+        conversion.numFlags = p - conversion.flags;
+
+        conversion.width = -1;
+        conversion.isWidthArgument = *p == '*';
+        if(conversion.isWidthArgument)
+            p++;
+        else if(*p >= '0' && *p <= '9')
+            conversion.width = parseNumber(p);
+
+        conversion.precision = -1;
+        conversion.isPrecisionArgument = false;
+        if(*p == '.')
+        {
+            p++;
+            conversion.isPrecisionArgument = *p == '*';
+            if(conversion.isPrecisionArgument)
+                p++;
+            else
+                conversion.precision = parseNumber(p);
+        }
+
+        conversion.length = Length::Default;
+        bool isWide = false;
+        switch(*p)
+        {
+        case 'h':
+            p++;
+            conversion.length = Length::Short;
+            if(*p == 'h') { p++; conversion.length = Length::Char; }
+            break;
+        case 'l':
+            p++;
+            conversion.length = Length::Long;
+            isWide = true;
+            if(*p == 'l') { p++; conversion.length = Length::LongLong; }
+            break;
+        case 'w':
+            p++;
+            isWide = true;
+            break;
+        case 'L':
+            p++;
+            conversion.length = Length::LongDouble;
+            break;
+        case 'z':
+        case 't':
+        case 'j':
+            conversion.length = *p == 'j' ? Length::LongLong : Length::Size;
+            p++;
+            break;
+        case 'I':
+            p++;
+            if(p[0] == '6' && p[1] == '4') { p += 2; conversion.length = Length::LongLong; }
+            else if(p[0] == '3' && p[1] == '2') { p += 2; conversion.length = Length::Default; }
+            else conversion.length = Length::Size;
+            break;
+        }
+
+        conversion.type = *p;
+        switch(*p)
+        {
+        case 'd':
+        case 'i':
+            conversion.argumentType = ArgumentType::Int;
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            conversion.argumentType = ArgumentType::UnsignedInt;
+            break;
+        case 'c':
+        case 'C':
+            conversion.argumentType = ArgumentType::Int;
+            conversion.length = Length::Default;
+            conversion.type = 'c';
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            conversion.argumentType = ArgumentType::Double;
+            break;
+        case 's':
+            conversion.argumentType = isWide ? ArgumentType::WideString : ArgumentType::String;
+            break;
+        case 'S':
+            conversion.argumentType = ArgumentType::WideString;
+            conversion.type = 's';
+            break;
+        case 'p':
+            conversion.argumentType = ArgumentType::Pointer;
+            break;
+        case '%':
+            conversion.argumentType = ArgumentType::Percent;
+            break;
+        default:
+            conversion.argumentType = ArgumentType::Invalid;
+            return true;
+        }
+        p++;
+        return true;
+    }
+
+    /// \brief writes the arguments of the format into the record, strings are copied and cut to fit
+    /// \return the number of conversions whose arguments are in the record
+    gep::uint32 captureArguments(const char* fmt, va_list args, char*& pos, char* end)
+    {
+        gep::uint32 numConversions = 0;
+        Conversion conversion;
+        const char* p = fmt;
+        while(parseConversion(p, conversion))
+        {
+            // enough room for the star arguments and one value
+            if(conversion.argumentType == ArgumentType::Invalid || size_t(end - pos) < 3 * sizeof(gep::int64))
+                break;
+            if(conversion.isWidthArgument)
+            {
+                *reinterpret_cast<gep::int64*>(pos) = va_arg(args, int);
+                pos += sizeof(gep::int64);
+            }
+            if(conversion.isPrecisionArgument)
+            {
+                const int precision = va_arg(args, int);
+                *reinterpret_cast<gep::int64*>(pos) = precision;
+                pos += sizeof(gep::int64);
+                conversion.precision = precision < 0 ? -1 : precision;
+            }
+
+            gep::int64& value = *reinterpret_cast<gep::int64*>(pos);
+            switch(conversion.argumentType)
+            {
+            case ArgumentType::Int:
+                switch(conversion.length)
+                {
+                case Length::Char:     value = static_cast<signed char>(va_arg(args, int)); break;
+                case Length::Short:    value = static_cast<short>(va_arg(args, int)); break;
+                case Length::Long:     value = va_arg(args, long); break;
+                case Length::LongLong: value = va_arg(args, long long); break;
+                case Length::Size:     value = va_arg(args, ptrdiff_t); break;
+                default:               value = va_arg(args, int); break;
+                }
+                pos += sizeof(gep::int64);
+                break;
+            case ArgumentType::UnsignedInt:
+                switch(conversion.length)
+                {
+                case Length::Char:     value = static_cast<unsigned char>(va_arg(args, unsigned int)); break;
+                case Length::Short:    value = static_cast<unsigned short>(va_arg(args, unsigned int)); break;
+                case Length::Long:     value = va_arg(args, unsigned long); break;
+                case Length::LongLong: value = va_arg(args, unsigned long long); break;
+                case Length::Size:     value = va_arg(args, size_t); break;
+                default:               value = va_arg(args, unsigned int); break;
+                }
+                pos += sizeof(gep::int64);
+                break;
+            case ArgumentType::Double:
+                *reinterpret_cast<double*>(pos) = conversion.length == Length::LongDouble ?
+                    static_cast<double>(va_arg(args, long double)) : va_arg(args, double);
+                pos += sizeof(double);
+                break;
+            case ArgumentType::Pointer:
+                value = reinterpret_cast<gep::int64>(va_arg(args, void*));
+                pos += sizeof(gep::int64);
+                break;
+            case ArgumentType::String:
+            case ArgumentType::WideString:
+                {
+                    // the length in front, then the characters including the terminator
+                    char* pLength = pos;
+                    char* pText = pos + sizeof(gep::int64);
+                    const size_t maxLength = GEP_MIN(size_t(end - pText - 1),
+                                                     conversion.precision >= 0 ? size_t(conversion.precision) : size_t(-1));
+                    size_t length = 0;
+                    if(conversion.argumentType == ArgumentType::String)
+                    {
+                        const char* text = va_arg(args, const char*);
+                        if(text == nullptr)
+                            text = "(null)";
+                        for(; length < maxLength && text[length] != '\0'; length++)
+                            pText[length] = text[length];
+                    }
+                    else
+                    {
+                        const wchar_t* text = va_arg(args, const wchar_t*);
+                        if(text == nullptr)
+                            text = L"(null)";
+                        for(; length < maxLength && text[length] != L'\0'; length++)
+                            pText[length] = text[length] < 128 ? char(text[length]) : '?';
+                    }
+                    // the padding is cleared as well, the rate limit hashes the captured bytes
+                    char* pNext = pText + (length + sizeof(gep::int64)) / sizeof(gep::int64) * sizeof(gep::int64);
+                    memset(pText + length, 0, pNext - pText - length);
+                    *reinterpret_cast<gep::int64*>(pLength) = gep::int64(length);
+                    pos = pNext;
+                }
+                break;
+            default:
+                break;
+            }
+            numConversions++;
+        }
+        return numConversions;
+    }
+
+    /// \brief appends to a message and cuts it at its capacity
+    struct MessageWriter
+    {
+        char* text;
+        size_t length;
+        size_t capacity;
+
+        void append(const char* source, size_t count)
+        {
+            count = GEP_MIN(count, capacity - 1 - length);
+            memcpy(text + length, source, count);
+            length += count;
+            text[length] = '\0';
+        }
+
+        template <typename T>
+        void appendFormatted(const char* spec, T value)
+        {
+            const int written = _snprintf_s(text + length, capacity - length, _TRUNCATE, spec, value);
+            length = written < 0 ? capacity - 1 : length + written;
+        }
+    };
+
+    /// \brief formats a record with the arguments captured by captureArguments
+    void formatRecord(const RecordHeader& header, MessageWriter& writer)
+    {
+        const char* pos = reinterpret_cast<const char*>(&header + 1);
+        const char* p = header.format;
+        const char* literal = p;
+        Conversion conversion;
+        for(gep::uint32 i = 0; i < header.numConversions && parseConversion(p, conversion); i++)
+        {
+            writer.append(literal, conversion.begin - literal);
+            literal = p;
+
+            int width = conversion.width;
+            int precision = conversion.precision;
+            if(conversion.isWidthArgument)
+            {
+                width = int(*reinterpret_cast<const gep::int64*>(pos));
+                pos += sizeof(gep::int64);
+            }
+            if(conversion.isPrecisionArgument)
+            {
+                precision = int(*reinterpret_cast<const gep::int64*>(pos));
+                pos += sizeof(gep::int64);
+            }
+
+            // the same conversion with the numbers of the star arguments and the length of the stored value
+            char spec[32];
+            size_t specLength = 0;
+            spec[specLength++] = '%';
+            for(size_t flag = 0; flag < conversion.numFlags && specLength < 8; flag++)
+                spec[specLength++] = conversion.flags[flag];
+            if(width != -1 || conversion.isWidthArgument)
+                specLength += sprintf_s(spec + specLength, sizeof(spec) - specLength, "%d", width);
+            if(precision >= 0)
+                specLength += sprintf_s(spec + specLength, sizeof(spec) - specLength, ".%d", precision);
+
+            const gep::int64 value = *reinterpret_cast<const gep::int64*>(pos);
+            switch(conversion.argumentType)
+            {
+            case ArgumentType::Int:
+            case ArgumentType::UnsignedInt:
+                if(conversion.type == 'c')
+                {
+                    sprintf_s(spec + specLength, sizeof(spec) - specLength, "c");
+                    writer.appendFormatted(spec, int(value));
+                }
+                else
+                {
+                    sprintf_s(spec + specLength, sizeof(spec) - specLength, "ll%c", conversion.type);
+                    writer.appendFormatted(spec, value);
+                }
+                pos += sizeof(gep::int64);
+                break;
+            case ArgumentType::Double:
+                sprintf_s(spec + specLength, sizeof(spec) - specLength, "%c", conversion.type);
+                writer.appendFormatted(spec, *reinterpret_cast<const double*>(pos));
+                pos += sizeof(double);
+                break;
+            case ArgumentType::Pointer:
+                sprintf_s(spec + specLength, sizeof(spec) - specLength, "p");
+                writer.appendFormatted(spec, reinterpret_cast<void*>(value));
+                pos += sizeof(gep::int64);
+                break;
+            case ArgumentType::String:
+            case ArgumentType::WideString:
+                sprintf_s(spec + specLength, sizeof(spec) - specLength, "s");
+                writer.appendFormatted(spec, pos + sizeof(gep::int64));
+                pos += sizeof(gep::int64) + (size_t(value) + sizeof(gep::int64)) / sizeof(gep::int64) * sizeof(gep::int64);
+                break;
+            case ArgumentType::Percent:
+                writer.append("%", 1);
+                break;
+            default:
+                break;
+            }
+        }
+        // the conversions which didn't fit into the record are printed as they are
+        writer.append(literal, strlen(literal));
+    }
+
+    gep::uint32 hashText(const char* text)
+    {
+        gep::uint32 hash = 2166136261u;
+        for(; *text != '\0'; text++)
+            hash = (hash ^ gep::uint8(*text)) * 16777619u;
+        return hash;
+    }
+
+    gep::uint32 hashBytes(const char* begin, const char* end, gep::uint32 hash)
+    {
+        for(; begin != end; begin++)
+            hash = (hash ^ gep::uint8(*begin)) * 16777619u;
+        return hash;
+    }
+
+    gep::uint32 roundToRecordSize(size_t size)
+    {
+        return gep::uint32((size + sizeof(RecordHeader) - 1) / sizeof(RecordHeader) * sizeof(RecordHeader));
+    }
+}
+
+gep::Logging::Logging() :
+    m_numBuffers(0),
+    m_generation(uint32(InterlockedIncrement(&g_lastGeneration))),
+    m_maxRepeatsPerSecond(DEFAULT_MAX_REPEATS_PER_SECOND),
+    m_lastSequence(0),
+    m_isSignaled(0),
+    m_isStopping(0),
+    m_wakeUp(0),
+    m_formatThreadId(0),
+    m_formatThread(*this)
+{
+    for(uint32 i = 0; i < MAX_THREADS; i++)
+        m_buffers[i] = nullptr;
+    m_formatThread.start();
 }
 
 gep::Logging::~Logging()
 {
     // avoid virtual function call in destructor
     this->gep::Logging::logMessage("logging system shutdown");
+
+    InterlockedExchange(&m_isStopping, 1);
+    m_wakeUp.increment();
+    m_formatThread.join();
+    // whatever was logged while the format thread stopped
+    formatPending();
+
+    for(uint32 i = 0; i < MAX_THREADS; i++)
+        delete m_buffers[i];
 }
 
 void gep::Logging::logMessage(const char* fmt, ...)
 {
-    char buffer[2048];
     va_list argptr;
     va_start(argptr, fmt);
-    vsprintf_s(buffer, fmt, argptr);
+    log(LogChannel::message, fmt, argptr);
     va_end(argptr);
-    ScopedLock<Mutex> lock(m_sinkMutex);
-    for(ILogSink* sink : m_sinks)
-    {
-        sink->take(LogChannel::message, buffer);
-    }
 }
 
 void gep::Logging::logWarning(const char* fmt, ...)
 {
-    char buffer[2048];
     va_list argptr;
     va_start(argptr, fmt);
-    vsprintf_s(buffer, fmt, argptr);
+    log(LogChannel::warning, fmt, argptr);
     va_end(argptr);
-    ScopedLock<Mutex> lock(m_sinkMutex);
-    for (ILogSink* sink : m_sinks)
-    {
-        sink->take(LogChannel::warning, buffer);
-    }
 }
 
 void gep::Logging::logError(const char* fmt, ...)
 {
-    char buffer[2048];
     va_list argptr;
     va_start(argptr, fmt);
-    vsprintf_s(buffer, fmt, argptr);
+    log(LogChannel::error, fmt, argptr);
     va_end(argptr);
-    ScopedLock<Mutex> lock(m_sinkMutex);
-    for(ILogSink* sink : m_sinks)
-    {
-        sink->take(LogChannel::error, buffer);
-    }
+    flush();
+}
+
+void gep::Logging::logMessageUnformatted(const char* message)
+{
+    logUnformatted(LogChannel::message, message);
+}
+
+void gep::Logging::logWarningUnformatted(const char* message)
+{
+    logUnformatted(LogChannel::warning, message);
+}
+
+void gep::Logging::logErrorUnformatted(const char* message)
+{
+    logUnformatted(LogChannel::error, message);
+    flush();
 }
 
 void gep::Logging::registerSink(ILogSink* pSink)
@@ -63,6 +531,7 @@ void gep::Logging::registerSink(ILogSink* pSink)
 
 void gep::Logging::deregisterSink(ILogSink* pSink)
 {
+    flush();
     ScopedLock<Mutex> lock(m_sinkMutex);
     size_t i=0;
     for(; i<m_sinks.length(); i++)
@@ -76,30 +545,264 @@ void gep::Logging::deregisterSink(ILogSink* pSink)
     }
 }
 
-void gep::Logging::logMessageUnformatted(const char* message)
+void gep::Logging::flush()
 {
-    ScopedLock<Mutex> lock(m_sinkMutex);
-    for(ILogSink* sink : m_sinks)
+    // a sink logging can't wait for its own thread
+    if(GetCurrentThreadId() == m_formatThreadId)
+        return;
+    // every thread has to wait for its own records, records of other threads can be delivered later
+    const LONG numBuffers = m_numBuffers;
+    for(LONG i = 0; i < numBuffers; i++)
     {
-        sink->take(LogChannel::message, message);
+        ThreadBuffer& buffer = *m_buffers[i];
+        const int64 writePosition = buffer.writePosition;
+        while(buffer.deliveredPosition < writePosition)
+        {
+            signal();
+            Sleep(0);
+        }
     }
 }
 
-void gep::Logging::logWarningUnformatted(const char* message)
+void gep::Logging::log(LogChannel channel, const char* fmt, va_list args)
 {
-    ScopedLock<Mutex> lock(m_sinkMutex);
-    for(ILogSink* sink : m_sinks)
+    ThreadBuffer* pBuffer = getThreadBuffer();
+    if(pBuffer == nullptr)
     {
-        sink->take(LogChannel::message, message);
+        char buffer[MAX_RECORD_SIZE];
+        vsprintf_s(buffer, fmt, args);
+        deliver(channel, buffer);
+        return;
     }
+
+    int64 record[MAX_RECORD_SIZE / sizeof(int64)];
+    RecordHeader& header = *reinterpret_cast<RecordHeader*>(record);
+    char* const pArguments = reinterpret_cast<char*>(&header + 1);
+    char* pos = pArguments;
+    header.numConversions = captureArguments(fmt, args, pos, reinterpret_cast<char*>(record) + sizeof(record));
+
+    // the same format string with the same arguments is the same message
+    uint32 numSuppressed;
+    if(!passRateLimit(*pBuffer, hashBytes(pArguments, pos, uint32(size_t(fmt) >> 2) * 2654435761u), numSuppressed))
+        return;
+
+    header.format = fmt;
+    header.kind = RecordKind::Formatted;
+    header.channel = uint16(channel);
+    header.numSuppressed = numSuppressed;
+    writeRecord(*pBuffer, record, uint32(pos - reinterpret_cast<char*>(record)), nullptr, 0);
 }
 
-void gep::Logging::logErrorUnformatted(const char* message)
+void gep::Logging::logUnformatted(LogChannel channel, const char* message)
+{
+    ThreadBuffer* pBuffer = getThreadBuffer();
+    if(pBuffer == nullptr)
+    {
+        deliver(channel, message);
+        return;
+    }
+
+    // the messages from scripts are different strings every time, so they are compared by their text
+    uint32 numSuppressed;
+    if(!passRateLimit(*pBuffer, hashText(message), numSuppressed))
+        return;
+
+    RecordHeader header;
+    header.format = nullptr;
+    header.kind = RecordKind::Unformatted;
+    header.channel = uint16(channel);
+    header.numSuppressed = numSuppressed;
+    header.numConversions = 0;
+    const size_t length = GEP_MIN(strlen(message), size_t(MAX_RECORD_SIZE - sizeof(header) - 1));
+    writeRecord(*pBuffer, &header, sizeof(header), message, uint32(length));
+}
+
+gep::Logging::ThreadBuffer* gep::Logging::getThreadBuffer()
+{
+    auto& state = t_threadState;
+    if(state.generation == m_generation)
+        return static_cast<ThreadBuffer*>(state.pBuffer);
+
+    ScopedLock<Mutex> lock(m_bufferMutex);
+    const DWORD threadId = GetCurrentThreadId();
+    ThreadBuffer* pBuffer = nullptr;
+    // the thread state only remembers one logging, a thread can already have a buffer if it used another one in between
+    for(LONG i = 0; i < m_numBuffers && pBuffer == nullptr; i++)
+    {
+        if(m_buffers[i]->threadId == threadId)
+            pBuffer = m_buffers[i];
+    }
+    if(pBuffer == nullptr)
+    {
+        if(m_numBuffers == MAX_THREADS)
+            return nullptr;
+        pBuffer = new ThreadBuffer();
+        pBuffer->threadId = threadId;
+        m_buffers[m_numBuffers] = pBuffer;
+        // the format thread only reads up to the count, so the buffer is published after it is set
+        InterlockedIncrement(&m_numBuffers);
+    }
+    state.generation = m_generation;
+    state.pBuffer = pBuffer;
+    return pBuffer;
+}
+
+bool gep::Logging::passRateLimit(ThreadBuffer& buffer, uint32 key, uint32& numSuppressed)
+{
+    numSuppressed = 0;
+    const uint32 maxRepeats = m_maxRepeatsPerSecond;
+    if(maxRepeats == 0)
+        return true;
+
+    const uint32 second = GetTickCount() / 1000;
+    RateLimit& limit = buffer.rateLimits[key % NUM_RATE_LIMITS];
+    if(limit.key != key)
+    {
+        limit.key = key;
+        limit.second = second;
+        limit.count = 0;
+        limit.numSuppressed = 0;
+    }
+    else if(limit.second != second)
+    {
+        limit.second = second;
+        limit.count = 0;
+    }
+
+    if(limit.count >= maxRepeats)
+    {
+        limit.numSuppressed++;
+        return false;
+    }
+    limit.count++;
+    numSuppressed = limit.numSuppressed;
+    limit.numSuppressed = 0;
+    return true;
+}
+
+void gep::Logging::writeRecord(ThreadBuffer& buffer, const void* pHeader, uint32 headerSize, const void* pData, uint32 dataSize)
+{
+    // the unformatted text gets its terminator in the buffer
+    const uint32 size = roundToRecordSize(headerSize + dataSize + (pData != nullptr ? 1 : 0));
+    const int64 writePosition = buffer.writePosition;
+    const uint32 offset = uint32(writePosition % BUFFER_SIZE);
+    const uint32 paddingSize = offset + size > BUFFER_SIZE ? BUFFER_SIZE - offset : 0;
+
+    while(writePosition + paddingSize + size - buffer.readPosition > BUFFER_SIZE)
+    {
+        // a sink logging can't wait for its own thread, its messages get lost instead
+        if(GetCurrentThreadId() == m_formatThreadId)
+            return;
+        signal();
+        Sleep(0);
+    }
+
+    if(paddingSize > 0)
+    {
+        RecordHeader& padding = *reinterpret_cast<RecordHeader*>(buffer.data + offset);
+        padding.size = paddingSize;
+        padding.kind = RecordKind::Padding;
+    }
+    char* pRecord = buffer.data + (offset + paddingSize) % BUFFER_SIZE;
+    memcpy(pRecord, pHeader, headerSize);
+    if(pData != nullptr)
+    {
+        memcpy(pRecord + headerSize, pData, dataSize);
+        pRecord[headerSize + dataSize] = '\0';
+    }
+    RecordHeader& header = *reinterpret_cast<RecordHeader*>(pRecord);
+    header.size = size;
+    header.sequence = InterlockedIncrement64(&m_lastSequence);
+
+    // publishes the record, the exchange is a full barrier
+    InterlockedExchange64(&buffer.writePosition, writePosition + paddingSize + size);
+    signal();
+}
+
+void gep::Logging::deliver(LogChannel channel, const char* message)
 {
     ScopedLock<Mutex> lock(m_sinkMutex);
     for(ILogSink* sink : m_sinks)
     {
-        sink->take(LogChannel::message, message);
+        sink->take(channel, message);
+    }
+}
+
+void gep::Logging::signal()
+{
+    // only the first signal after the format thread woke up needs to touch the semaphore
+    if(InterlockedExchange(&m_isSignaled, 1) == 0)
+        m_wakeUp.increment();
+}
+
+void gep::Logging::formatPending()
+{
+    char text[MAX_RECORD_SIZE + 64];
+    for(;;)
+    {
+        // the oldest record at the front of the buffers, the records of each buffer are in order
+        ThreadBuffer* pNext = nullptr;
+        const RecordHeader* pNextRecord = nullptr;
+        const LONG numBuffers = m_numBuffers;
+        for(LONG i = 0; i < numBuffers; i++)
+        {
+            ThreadBuffer& buffer = *m_buffers[i];
+            int64 readPosition = buffer.readPosition;
+            const int64 writePosition = buffer.writePosition;
+            if(readPosition == writePosition)
+                continue;
+            const RecordHeader* pRecord = reinterpret_cast<const RecordHeader*>(buffer.data + readPosition % BUFFER_SIZE);
+            if(pRecord->kind == RecordKind::Padding)
+            {
+                readPosition += pRecord->size;
+                InterlockedExchange64(&buffer.readPosition, readPosition);
+                // there is nothing to deliver for the padding
+                if(buffer.deliveredPosition < readPosition)
+                    InterlockedExchange64(&buffer.deliveredPosition, readPosition);
+                if(readPosition == writePosition)
+                    continue;
+                pRecord = reinterpret_cast<const RecordHeader*>(buffer.data + readPosition % BUFFER_SIZE);
+            }
+            if(pNextRecord == nullptr || pRecord->sequence < pNextRecord->sequence)
+            {
+                pNext = &buffer;
+                pNextRecord = pRecord;
+            }
+        }
+        if(pNext == nullptr)
+            return;
+
+        const RecordHeader& record = *pNextRecord;
+        MessageWriter writer = { text, 0, MAX_RECORD_SIZE };
+        text[0] = '\0';
+        if(record.kind == RecordKind::Formatted)
+            formatRecord(record, writer);
+        else
+            writer.append(reinterpret_cast<const char*>(&record + 1), strlen(reinterpret_cast<const char*>(&record + 1)));
+        if(record.numSuppressed > 0)
+        {
+            writer.capacity = sizeof(text);
+            writer.appendFormatted(" (%u similar messages suppressed)", record.numSuppressed);
+        }
+        const LogChannel channel = LogChannel(record.channel);
+        const int64 readPosition = pNext->readPosition + record.size;
+        InterlockedExchange64(&pNext->readPosition, readPosition);
+
+        deliver(channel, text);
+        InterlockedExchange64(&pNext->deliveredPosition, readPosition);
+    }
+}
+
+void gep::Logging::FormatThread::run()
+{
+    m_logging.m_formatThreadId = GetCurrentThreadId();
+    for(;;)
+    {
+        m_logging.m_wakeUp.waitAndDecrement(WAIT_TIMEOUT_MS);
+        InterlockedExchange(&m_logging.m_isSignaled, 0);
+        m_logging.formatPending();
+        if(m_logging.m_isStopping != 0)
+            break;
     }
 }
 
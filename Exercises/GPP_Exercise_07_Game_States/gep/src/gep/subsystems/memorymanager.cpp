@@ -1,6 +1,26 @@
 #include "stdafx.h"
 #include "gepimpl/subsystems/memoryManager.h"
 #include "gep/memory/allocator.h"
+#include "gep/memory/allocationProfiler.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+#include "gep/interfaces/logging.h"
+#include <fstream>
+
+gep::MemoryManager::Category::Category() :
+    budget(0),
+    bytesUsed(0),
+    isOverBudget(false)
+{
+    memset(frameDeltas, 0, sizeof(frameDeltas));
+}
+
+gep::MemoryManager::MemoryManager(ILogging* pLogging) :
+    m_pAllocationProfiler(nullptr),
+    m_numFrames(0),
+    m_pLogging(pLogging)
+{
+}
 
 void gep::MemoryManager::initialize()
 {
@@ -10,11 +30,30 @@ void gep::MemoryManager::initialize()
 void gep::MemoryManager::destroy()
 {
     GEP_ASSERT(m_allocators.length() == 0, "not all allocators have been deregistered");
+    stopAllocationProfiling();
+    DELETE_AND_NULL(m_pAllocationProfiler);
 }
 
 void gep::MemoryManager::update(float elapsedTime)
 {
-    //TODO draw statistics here
+    const size_t frame = m_numFrames % NUM_TRACKED_FRAMES;
+    for(size_t i = 0; i < size_t(MemoryCategory::Count); i++)
+    {
+        auto& category = m_categories[i];
+        const size_t bytesUsed = category.allocator.getNumBytesUsed();
+        category.frameDeltas[frame] = int64(bytesUsed) - int64(category.bytesUsed);
+        category.bytesUsed = bytesUsed;
+
+        // only warn when the budget is crossed, not every frame
+        const bool isOverBudget = category.budget > 0 && bytesUsed > category.budget;
+        if(isOverBudget && !category.isOverBudget && m_pLogging != nullptr)
+        {
+            m_pLogging->logWarning("%s is over its memory budget: %u KB of %u KB used",
+                getName(MemoryCategory(i)), uint32(bytesUsed / 1024), uint32(category.budget / 1024));
+        }
+        category.isOverBudget = isOverBudget;
+    }
+    m_numFrames++;
 }
 
 void gep::MemoryManager::registerAllocator(const char* name, IAllocatorStatistics* pAllocator)
@@ -34,3 +73,84 @@ void gep::MemoryManager::deregisterAllocator(IAllocatorStatistics* pAllocator)
         m_allocators.removeAtIndex(i);
 }
 
+
+void gep::MemoryManager::startAllocationProfiling(size_t sampleRate)
+{
+    if (m_pAllocationProfiler == nullptr)
+    {
+        m_pAllocationProfiler = new AllocationProfiler(sampleRate);
+    }
+    else
+    {
+        m_pAllocationProfiler->reset(sampleRate);
+    }
+    StdAllocator::setProfiler(m_pAllocationProfiler);
+}
+
+void gep::MemoryManager::stopAllocationProfiling()
+{
+    // the profiler is kept, allocations in flight on other threads might still use it
+    StdAllocator::setProfiler(nullptr);
+}
+
+bool gep::MemoryManager::isAllocationProfilingEnabled() const
+{
+    return m_pAllocationProfiler != nullptr && StdAllocator::getProfiler() == m_pAllocationProfiler;
+}
+
+void gep::MemoryManager::exportAllocationProfile(const std::string& liveBytesFileName, const std::string& allocatedBytesFileName)
+{
+    if (m_pAllocationProfiler == nullptr)
+    {
+        throw Exception("Allocation profiling has never been started");
+    }
+
+    std::ofstream liveBytesFile(liveBytesFileName, std::ios_base::trunc);
+    if (!liveBytesFile.is_open())
+    {
+        throw Exception(format("Could not open '%s' for writing", liveBytesFileName.c_str()));
+    }
+    m_pAllocationProfiler->writeLiveBytes(liveBytesFile);
+
+    std::ofstream allocatedBytesFile(allocatedBytesFileName, std::ios_base::trunc);
+    if (!allocatedBytesFile.is_open())
+    {
+        throw Exception(format("Could not open '%s' for writing", allocatedBytesFileName.c_str()));
+    }
+    m_pAllocationProfiler->writeAllocatedBytes(allocatedBytesFile);
+}
+
+gep::IAllocatorStatistics* gep::MemoryManager::getAllocator(MemoryCategory category)
+{
+    GEP_ASSERT(category < MemoryCategory::Count, "invalid memory category");
+    return &m_categories[size_t(category)].allocator;
+}
+
+void gep::MemoryManager::setBudget(MemoryCategory category, size_t budget)
+{
+    GEP_ASSERT(category < MemoryCategory::Count, "invalid memory category");
+    m_categories[size_t(category)].budget = budget;
+}
+
+gep::MemoryCategoryStatistics gep::MemoryManager::getStatistics(MemoryCategory category) const
+{
+    GEP_ASSERT(category < MemoryCategory::Count, "invalid memory category");
+    const auto& data = m_categories[size_t(category)];
+    MemoryCategoryStatistics statistics;
+    statistics.bytesUsed = data.bytesUsed;
+    statistics.highWaterMark = data.allocator.getPeakNumBytesUsed();
+    statistics.budget = data.budget;
+    statistics.lastFrameDelta = m_numFrames > 0 ? data.frameDeltas[(m_numFrames - 1) % NUM_TRACKED_FRAMES] : 0;
+    statistics.isOverBudget = data.isOverBudget;
+    return statistics;
+}
+
+size_t gep::MemoryManager::getFrameDeltas(MemoryCategory category, ArrayPtr<int64> deltas) const
+{
+    GEP_ASSERT(category < MemoryCategory::Count, "invalid memory category");
+    const auto& data = m_categories[size_t(category)];
+    const size_t numFrames = GEP_MIN(GEP_MIN(m_numFrames, NUM_TRACKED_FRAMES), deltas.length());
+    for(size_t i = 0; i < numFrames; i++)
+        deltas[i] = data.frameDeltas[(m_numFrames - numFrames + i) % NUM_TRACKED_FRAMES];
+    return numFrames;
+}
@@ -3,13 +3,17 @@
 #include "gep/interfaces/physics/shape.h"
 
 #include "gepimpl/subsystems/physics/havok/entity.h"
+#include "gepimpl/subsystems/physics/havok/world.h"
 #include "gepimpl/subsystems/physics/havok/conversion/shape.h"
 
 gep::HavokRigidBody::HavokRigidBody(hkpRigidBody* rigidBody) :
     m_pTriggerVolume(nullptr),
     m_positionChangedCallbacks(),
     m_shape(),
-    m_entity(rigidBody)
+    m_entity(rigidBody),
+    m_pCollidable(nullptr),
+    m_pWorld(nullptr),
+    m_worldIndex(INVALID_WORLD_INDEX)
 {
     GEP_ASSERT(rigidBody && m_entity.getHkpEntity(), "Must not pass a nullptr!");
 }
@@ -18,7 +22,10 @@ gep::HavokRigidBody::HavokRigidBody(const RigidBodyCInfo& cinfo) :
     m_pTriggerVolume(nullptr),
     m_positionChangedCallbacks(),
     m_shape(cinfo.shape),
-    m_entity(nullptr)
+    m_entity(nullptr),
+    m_pCollidable(nullptr),
+    m_pWorld(nullptr),
+    m_worldIndex(INVALID_WORLD_INDEX)
 {
     hkpRigidBodyCinfo hkcinfo;
 
@@ -68,11 +75,34 @@ gep::HavokRigidBody::~HavokRigidBody()
 {
     m_entity.getHkpEntity()->setUserData(0);
     m_pTriggerVolume = nullptr;
+    DELETE_AND_NULL(m_pCollidable);
 }
 
 void gep::HavokRigidBody::initialize()
 {
     m_entity.getHkpEntity()->setUserData(reinterpret_cast<hkUlong>(this));
+
+    if(m_pCollidable == nullptr)
+    {
+        auto* pHkCollidable = getHkpRigidBody()->getCollidableRw();
+        if(!m_shape)
+            m_shape = conversion::hk::from(const_cast<hkpShape*>(pHkCollidable->getShape()));
+        m_pCollidable = new HavokCollidable(pHkCollidable, this, m_shape.get());
+    }
+}
+
+void gep::HavokRigidBody::setPosition(const vec3& value)
+{
+    getHkpRigidBody()->setPosition(conversion::hk::to(value));
+    if(m_pWorld)
+        m_pWorld->updateTransform(m_worldIndex);
+}
+
+void gep::HavokRigidBody::setRotation(const Quaternion& value)
+{
+    getHkpRigidBody()->setRotation(conversion::hk::to(value));
+    if(m_pWorld)
+        m_pWorld->updateTransform(m_worldIndex);
 }
 
 gep::CallbackId gep::HavokRigidBody::registerSimulationCallback(PositionChangedCallback callback)
@@ -108,13 +138,10 @@ void gep::HavokRigidBody::triggerSimulationCallbacks() const
 
 //////////////////////////////////////////////////////////////////////////
 
-gep::HavokCollidable::HavokCollidable(hkpCollidable* collidable) :
+gep::HavokCollidable::HavokCollidable(hkpCollidable* collidable, IPhysicsEntity* pOwner, IShape* pShape) :
     m_pHkCollidable(collidable),
-    m_pShape(nullptr),
-    m_pEntity(nullptr)
+    m_pEntity(pOwner),
+    m_pShape(pShape)
 {
     GEP_ASSERT(collidable, "The input 'collidable' is not supposed to be null!");
-    m_pEntity = static_cast<IPhysicsEntity*>(collidable->getOwner());
-
-    m_pShape = conversion::hk::from( const_cast<hkpShape*>(collidable->getShape()) );
 }
@@ -4,6 +4,7 @@
 #include "gep/globalManager.h"
 #include "gep/container/DynamicArray.h"
 #include "gep/interfaces/logging.h"
+#include "gep/interfaces/memoryManager.h"
 #include "gep/interfaces/updateFramework.h"
 
 #include "gepimpl/havok/util.h"
@@ -29,7 +30,7 @@ gep::HavokPhysicsManager::~HavokPhysicsManager()
 
 void gep::HavokPhysicsManager::initialize()
 {
-    m_pFactory = new HavokPhysicsFactory(&g_stdAllocator);
+    m_pFactory = new HavokPhysicsFactory(g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Physics));
     m_pFactory->initialize();
 
     // set up display manager
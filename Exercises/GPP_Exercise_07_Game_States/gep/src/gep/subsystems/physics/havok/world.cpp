@@ -2,6 +2,8 @@
 #include "gepimpl/subsystems/physics/havok/world.h"
 #include "gepimpl/subsystems/physics/havok/entity.h"
 #include "gepimpl/subsystems/physics/havok/conversion/vector.h"
+#include "gepimpl/subsystems/physics/havok/conversion/quaternion.h"
+#include "gepimpl/subsystems/physics/havok/conversion/shape.h"
 #include "gepimpl/subsystems/physics/havok/action.h"
 #include "gepimpl/subsystems/physics/havok/contact.h"
 
@@ -14,11 +16,17 @@
 gep::HavokWorld::HavokWorld(const WorldCInfo& cinfo) :
     m_pWorld(nullptr),
     m_entities(),
+    m_transforms(),
+    m_syncActions(),
+    m_freeSyncActions(),
+    m_removedSyncActions(),
     m_characters(),
     m_actualContactListener(this),
     m_event_contactPoint()
 {
     m_entities.reserve(64);
+    m_transforms.reserve(64);
+    m_syncActions.reserve(64);
 
     hkpWorldCinfo worldInfo;
     worldInfo.setupSolverInfo(hkpWorldCinfo::SOLVER_TYPE_4ITERS_MEDIUM);
@@ -38,6 +46,16 @@ gep::HavokWorld::HavokWorld(const WorldCInfo& cinfo) :
 gep::HavokWorld::~HavokWorld()
 {
     m_pWorld->removeContactListener(&m_actualContactListener);
+
+    for(auto& pEntity : m_entities)
+        pEntity->m_pWorld = nullptr;
+    // the havok world holds its own reference to the actions of its entities
+    for(auto* pAction : m_syncActions)
+        pAction->removeReference();
+    for(auto* pAction : m_freeSyncActions)
+        pAction->removeReference();
+    for(auto* pAction : m_removedSyncActions)
+        pAction->removeReference();
 }
 
 void gep::HavokWorld::addEntity(IPhysicsEntity* entity)
@@ -45,17 +63,33 @@ void gep::HavokWorld::addEntity(IPhysicsEntity* entity)
     //TODO: can only add rigid bodies at the moment.
     auto* actualEntity = dynamic_cast<HavokRigidBody*>(entity);
     GEP_ASSERT(actualEntity != nullptr, "Attempted to add wrong kind of entity. (only rigid bodies are supported at the moment)");
-    addEntity(actualEntity->getHkpRigidBody());
-    m_entities.append(entity);
+    GEP_ASSERT(actualEntity->m_pWorld == nullptr, "The rigid body is already in a world");
+
+    auto* pHkRigidBody = actualEntity->getHkpRigidBody();
+    addEntity(pHkRigidBody);
+
+    HavokRigidBodySyncAction* pAction;
+    if(m_freeSyncActions.length() > 0)
+    {
+        pAction = m_freeSyncActions.lastElement();
+        m_freeSyncActions.removeLastElement();
+    }
+    else
+        pAction = new HavokRigidBodySyncAction();
+    pAction->setEntity(pHkRigidBody);
+    m_pWorld->addAction(pAction);
+
+    actualEntity->m_pWorld = this;
+    actualEntity->m_worldIndex = static_cast<uint32>(m_entities.length());
+    m_entities.append(actualEntity);
+    m_syncActions.append(pAction);
+    RigidBodyTransform transform = { actualEntity->getPosition(), actualEntity->getRotation() };
+    m_transforms.append(transform);
 }
 
 void gep::HavokWorld::addEntity(hkpEntity* entity)
 {
     m_pWorld->addEntity(entity);
-    auto* action = new HavokRigidBodySyncAction();
-    action->setEntity(entity);
-    m_pWorld->addAction(action);
-    action->removeReference();
 }
 
 void gep::HavokWorld::removeEntity(IPhysicsEntity* entity)
@@ -65,18 +99,30 @@ void gep::HavokWorld::removeEntity(IPhysicsEntity* entity)
     // TODO Can only remove rigid bodies at the moment.
     auto* actualEntity = dynamic_cast<HavokRigidBody*>(entity);
     GEP_ASSERT(actualEntity != nullptr, "Attempt to remove wrong kind of entity. (only rigid bodies are supported at the moment)");
+    GEP_ASSERT(actualEntity->m_pWorld == this, "Attempt to remove entity from world that does not exist there", actualEntity);
 
-    size_t index;
-    for (index = 0; index < m_entities.length(); ++index)
+    const uint32 index = actualEntity->m_worldIndex;
+    GEP_ASSERT(m_entities[index].get() == actualEntity, "The world index of the rigid body is broken", index, m_entities.length());
+    SmartPtr<HavokRigidBody> pKeepAlive(actualEntity);
+
+    // the action has to go before the entity, havok would remove it with the entity otherwise
+    auto* pAction = m_syncActions[index];
+    m_pWorld->removeAction(pAction);
+    if(m_pWorld->areCriticalOperationsLocked())
     {
-        auto& entityPtr = m_entities[index];
-        if (entityPtr.get() == actualEntity)
-        {
-            break;
-        }
+        // removed from a contact callback, the action stays registered and keeps running until the step is done
+        m_removedSyncActions.append(pAction);
     }
-    GEP_ASSERT(index < m_entities.length(), "Attempt to remove character from world that does not exist there", actualEntity, index, m_entities.length());
-    m_entities.removeAtIndex(index);
+    else
+        recycleSyncAction(pAction);
+
+    m_entities.removeAtIndexUnordered(index);
+    m_syncActions.removeAtIndexUnordered(index);
+    m_transforms.removeAtIndexUnordered(index);
+    if(index < m_entities.length())
+        m_entities[index]->m_worldIndex = index;
+    actualEntity->m_pWorld = nullptr;
+    actualEntity->m_worldIndex = IRigidBody::INVALID_WORLD_INDEX;
 
     // Remove the actual havok entity
     removeEntity(actualEntity->getHkpRigidBody());
@@ -118,6 +164,28 @@ void gep::HavokWorld::update(float elapsedTime)
     GEP_UNUSED(elapsedTime);
     //TODO tweak this value if havok is complaining too hard about the simulation becoming unstable.
     m_pWorld->stepDeltaTime(g_globalManager.getUpdateFramework()->calcElapsedTimeAverage(60) / 1000.0f);
+
+    // havok has executed the removals which were deferred during the step
+    for(auto* pAction : m_removedSyncActions)
+        recycleSyncAction(pAction);
+    m_removedSyncActions.resize(0);
+
+    // write back the transforms of all bodies at once
+    for(uint32 i = 0; i < m_entities.length(); i++)
+        updateTransform(i);
+}
+
+void gep::HavokWorld::recycleSyncAction(HavokRigidBodySyncAction* pAction)
+{
+    pAction->setEntity(HK_NULL);
+    m_freeSyncActions.append(pAction);
+}
+
+void gep::HavokWorld::updateTransform(uint32 index)
+{
+    const auto* pHkRigidBody = m_entities[index]->getHkpRigidBody();
+    conversion::hk::from(pHkRigidBody->getPosition(), m_transforms[index].position);
+    conversion::hk::from(pHkRigidBody->getRotation(), m_transforms[index].rotation);
 }
 
 void gep::HavokWorld::castRay(const RayCastInput& input, RayCastOutput& output) const
@@ -135,13 +203,82 @@ void gep::HavokWorld::castRay(const RayCastInput& input, RayCastOutput& output)
     // Process output
     output.hitFraction = actualOutput.m_hitFraction;
     // TODO: havok uses "collidables", which form a hierarchy. We have to wrap this as well if we want to have something like hit zones.
-    // TODO: Check if it is really ok to const_cast here.
-    if (actualOutput.m_rootCollidable)
+    output.hitEntity = actualOutput.m_rootCollidable ? findCollidable(actualOutput.m_rootCollidable) : nullptr;
+}
+
+void gep::HavokWorld::castRays(ArrayPtr<const RayCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every ray needs an output", inputs.length(), outputs.length());
+    // the havok broadphase is queried per ray, only the native physics traverses once per batch
+    for(size_t i = 0; i < inputs.length(); i++)
+        castRay(inputs[i], outputs[i]);
+}
+
+void gep::HavokWorld::castShapes(ArrayPtr<const ShapeCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every shape cast needs an output", inputs.length(), outputs.length());
+    for(size_t i = 0; i < inputs.length(); i++)
     {
-        output.hitEntity = new HavokCollidable(const_cast<hkpCollidable*>(actualOutput.m_rootCollidable));
+        const auto& input = inputs[i];
+        GEP_ASSERT(input.shape, "Did not supply a valid shape in ShapeCastInput!", i);
+        const hkpShape* pHkShape = conversion::hk::to(input.shape);
+        hkTransform transform(conversion::hk::to(input.rotation), conversion::hk::to(input.from));
+        hkpCollidable collidable(pHkShape, &transform);
+
+        hkpLinearCastInput castInput;
+        conversion::hk::to(input.to, castInput.m_to);
+        hkpClosestCdPointCollector collector;
+        m_pWorld->linearCast(&collidable, castInput, collector);
+
+        outputs[i].hitFraction = 1.0f;
+        outputs[i].hitEntity = nullptr;
+        if(collector.hasHit())
+        {
+            // the distance of a linear cast is the fraction of the path
+            outputs[i].hitFraction = collector.getHitContact().getDistance();
+            outputs[i].hitEntity = findCollidable(collector.getHit().m_rootCollidableB);
+        }
+        // mesh shapes are not created by the conversion, they keep their reference
+        if(input.shape->getShapeType() != ShapeType::Triangle)
+            pHkShape->removeReference();
     }
 }
 
+void gep::HavokWorld::overlapShapes(ArrayPtr<const OverlapInput> inputs, ArrayPtr<OverlapOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every overlap query needs an output", inputs.length(), outputs.length());
+    for(size_t i = 0; i < inputs.length(); i++)
+    {
+        const auto& input = inputs[i];
+        GEP_ASSERT(input.shape, "Did not supply a valid shape in OverlapInput!", i);
+        const hkpShape* pHkShape = conversion::hk::to(input.shape);
+        hkTransform transform(conversion::hk::to(input.rotation), conversion::hk::to(input.position));
+        hkpCollidable collidable(pHkShape, &transform);
+
+        hkpAllCdBodyPairCollector collector;
+        m_pWorld->getPenetrations(&collidable, *m_pWorld->getCollisionInput(), collector);
+
+        auto& output = outputs[i];
+        output.numHits = 0;
+        for(const auto& hit : collector.getHits())
+        {
+            if(output.numHits < output.hits.length())
+                output.hits[output.numHits] = findCollidable(hit.m_rootCollidableB);
+            output.numHits++;
+        }
+        if(input.shape->getShapeType() != ShapeType::Triangle)
+            pHkShape->removeReference();
+    }
+}
+
+const gep::ICollidable* gep::HavokWorld::findCollidable(const hkpCollidable* pHkCollidable)
+{
+    const hkpRigidBody* pHkRigidBody = hkpGetRigidBody(pHkCollidable);
+    if(pHkRigidBody == nullptr || pHkRigidBody->getUserData() == 0)
+        return nullptr;
+    return reinterpret_cast<const HavokRigidBody*>(pHkRigidBody->getUserData())->getCollidable();
+}
+
 void gep::HavokWorld::contactPointCallback(const ContactPointArgs& evt)
 {
     m_event_contactPoint.trigger(&const_cast<gep::ContactPointArgs&>(evt));
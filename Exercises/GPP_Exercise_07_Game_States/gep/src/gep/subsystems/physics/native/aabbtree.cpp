@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/aabbTree.h"
+
+namespace
+{
+    /// the displacement is predicted for this many steps
+    const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+    inline gep::vec3 componentMin(const gep::vec3& a, const gep::vec3& b)
+    {
+        return gep::vec3(GEP_MIN(a.x, b.x), GEP_MIN(a.y, b.y), GEP_MIN(a.z, b.z));
+    }
+
+    inline gep::vec3 componentMax(const gep::vec3& a, const gep::vec3& b)
+    {
+        return gep::vec3(GEP_MAX(a.x, b.x), GEP_MAX(a.y, b.y), GEP_MAX(a.z, b.z));
+    }
+
+    inline float surfaceArea(const gep::vec3& min, const gep::vec3& max)
+    {
+        const gep::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    inline bool contains(const gep::vec3& outerMin, const gep::vec3& outerMax, const gep::vec3& innerMin, const gep::vec3& innerMax)
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z
+            && innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+}
+
+gep::AabbTree::AabbTree(float margin, IAllocator* pAllocator) :
+    m_nodes(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    m_root(NULL_NODE),
+    m_freeList(NULL_NODE),
+    m_numProxies(0),
+    m_margin(margin)
+{
+}
+
+gep::uint32 gep::AabbTree::allocateNode()
+{
+    uint32 nodeId;
+    if(m_freeList != NULL_NODE)
+    {
+        nodeId = m_freeList;
+        m_freeList = m_nodes[nodeId].parentOrNext;
+    }
+    else
+    {
+        nodeId = uint32(m_nodes.length());
+        m_nodes.append(Node());
+    }
+    auto& node = m_nodes[nodeId];
+    node.pUserData = nullptr;
+    node.parentOrNext = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    return nodeId;
+}
+
+void gep::AabbTree::freeNode(uint32 nodeId)
+{
+    auto& node = m_nodes[nodeId];
+    node.height = -1;
+    node.parentOrNext = m_freeList;
+    m_freeList = nodeId;
+}
+
+gep::uint32 gep::AabbTree::insert(const vec3& min, const vec3& max, void* pUserData)
+{
+    const uint32 proxy = allocateNode();
+    auto& node = m_nodes[proxy];
+    node.min = min - vec3(m_margin);
+    node.max = max + vec3(m_margin);
+    node.pUserData = pUserData;
+    insertLeaf(proxy);
+    m_numProxies++;
+    return proxy;
+}
+
+void gep::AabbTree::remove(uint32 proxy)
+{
+    GEP_ASSERT(proxy < m_nodes.length() && m_nodes[proxy].isLeaf() && m_nodes[proxy].height == 0, "invalid proxy", proxy);
+    removeLeaf(proxy);
+    freeNode(proxy);
+    m_numProxies--;
+}
+
+bool gep::AabbTree::update(uint32 proxy, const vec3& min, const vec3& max, const vec3& displacement)
+{
+    GEP_ASSERT(proxy < m_nodes.length() && m_nodes[proxy].isLeaf() && m_nodes[proxy].height == 0, "invalid proxy", proxy);
+
+    vec3 fatMin = min - vec3(m_margin);
+    vec3 fatMax = max + vec3(m_margin);
+    const vec3 predicted = displacement * DISPLACEMENT_MULTIPLIER;
+    fatMin += componentMin(predicted, vec3(0.0f));
+    fatMax += componentMax(predicted, vec3(0.0f));
+
+    const auto& node = m_nodes[proxy];
+    if(contains(node.min, node.max, min, max))
+    {
+        // a body which came to rest after moving fast would keep its huge box forever
+        const vec3 hugeMargin(4.0f * m_margin);
+        if(contains(fatMin - hugeMargin, fatMax + hugeMargin, node.min, node.max))
+            return false;
+    }
+
+    removeLeaf(proxy);
+    m_nodes[proxy].min = fatMin;
+    m_nodes[proxy].max = fatMax;
+    insertLeaf(proxy);
+    return true;
+}
+
+void gep::AabbTree::insertLeaf(uint32 leaf)
+{
+    if(m_root == NULL_NODE)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parentOrNext = NULL_NODE;
+        return;
+    }
+
+    // walk down to the sibling which increases the surface area of the tree the least
+    const vec3 leafMin = m_nodes[leaf].min;
+    const vec3 leafMax = m_nodes[leaf].max;
+    uint32 index = m_root;
+    while(!m_nodes[index].isLeaf())
+    {
+        const auto& node = m_nodes[index];
+        const float area = surfaceArea(node.min, node.max);
+        const float combinedArea = surfaceArea(componentMin(node.min, leafMin), componentMax(node.max, leafMax));
+
+        // creating a new parent for this node and the leaf
+        const float cost = 2.0f * combinedArea;
+        // pushing the leaf further down grows all boxes on the way
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        const uint32 children[2] = { node.child1, node.child2 };
+        for(int i = 0; i < 2; i++)
+        {
+            const auto& child = m_nodes[children[i]];
+            const float childArea = surfaceArea(componentMin(child.min, leafMin), componentMax(child.max, leafMax));
+            childCosts[i] = child.isLeaf() ? childArea + inheritanceCost
+                                           : childArea - surfaceArea(child.min, child.max) + inheritanceCost;
+        }
+
+        if(cost < childCosts[0] && cost < childCosts[1])
+            break;
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    const uint32 sibling = index;
+    const uint32 oldParent = m_nodes[sibling].parentOrNext;
+    const uint32 newParent = allocateNode();
+    {
+        auto& parentNode = m_nodes[newParent];
+        parentNode.parentOrNext = oldParent;
+        parentNode.min = componentMin(leafMin, m_nodes[sibling].min);
+        parentNode.max = componentMax(leafMax, m_nodes[sibling].max);
+        parentNode.height = m_nodes[sibling].height + 1;
+        parentNode.child1 = sibling;
+        parentNode.child2 = leaf;
+    }
+
+    if(oldParent != NULL_NODE)
+    {
+        auto& oldParentNode = m_nodes[oldParent];
+        if(oldParentNode.child1 == sibling)
+            oldParentNode.child1 = newParent;
+        else
+            oldParentNode.child2 = newParent;
+    }
+    else
+    {
+        m_root = newParent;
+    }
+    m_nodes[sibling].parentOrNext = newParent;
+    m_nodes[leaf].parentOrNext = newParent;
+
+    for(index = m_nodes[leaf].parentOrNext; index != NULL_NODE; index = m_nodes[index].parentOrNext)
+    {
+        index = balance(index);
+        refit(index);
+    }
+}
+
+void gep::AabbTree::removeLeaf(uint32 leaf)
+{
+    if(leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const uint32 parent = m_nodes[leaf].parentOrNext;
+    const uint32 grandParent = m_nodes[parent].parentOrNext;
+    const uint32 sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if(grandParent != NULL_NODE)
+    {
+        auto& grandParentNode = m_nodes[grandParent];
+        if(grandParentNode.child1 == parent)
+            grandParentNode.child1 = sibling;
+        else
+            grandParentNode.child2 = sibling;
+        m_nodes[sibling].parentOrNext = grandParent;
+        freeNode(parent);
+
+        for(uint32 index = grandParent; index != NULL_NODE; index = m_nodes[index].parentOrNext)
+        {
+            index = balance(index);
+            refit(index);
+        }
+    }
+    else
+    {
+        m_root = sibling;
+        m_nodes[sibling].parentOrNext = NULL_NODE;
+        freeNode(parent);
+    }
+}
+
+void gep::AabbTree::refit(uint32 nodeId)
+{
+    auto& node = m_nodes[nodeId];
+    const auto& child1 = m_nodes[node.child1];
+    const auto& child2 = m_nodes[node.child2];
+    node.height = 1 + GEP_MAX(child1.height, child2.height);
+    node.min = componentMin(child1.min, child2.min);
+    node.max = componentMax(child1.max, child2.max);
+}
+
+gep::uint32 gep::AabbTree::balance(uint32 iA)
+{
+    auto& a = m_nodes[iA];
+    if(a.isLeaf() || a.height < 2)
+        return iA;
+
+    const uint32 iB = a.child1;
+    const uint32 iC = a.child2;
+    auto& b = m_nodes[iB];
+    auto& c = m_nodes[iC];
+    const int32 heightDifference = c.height - b.height;
+
+    // rotates the higher child up, the lower grandchild takes its place below a
+    auto rotateUp = [&](uint32 iUp, Node& up, uint32 iOther, Node& other, uint32& aSlotOfUp){
+        const uint32 iF = up.child1;
+        const uint32 iG = up.child2;
+        auto& f = m_nodes[iF];
+        auto& g = m_nodes[iG];
+
+        up.child1 = iA;
+        up.parentOrNext = a.parentOrNext;
+        a.parentOrNext = iUp;
+        if(up.parentOrNext != NULL_NODE)
+        {
+            auto& parent = m_nodes[up.parentOrNext];
+            if(parent.child1 == iA)
+                parent.child1 = iUp;
+            else
+                parent.child2 = iUp;
+        }
+        else
+        {
+            m_root = iUp;
+        }
+
+        const bool keepF = f.height > g.height;
+        const uint32 iKept = keepF ? iF : iG;
+        const uint32 iMoved = keepF ? iG : iF;
+        auto& kept = m_nodes[iKept];
+        auto& moved = m_nodes[iMoved];
+        up.child2 = iKept;
+        aSlotOfUp = iMoved;
+        moved.parentOrNext = iA;
+
+        a.min = componentMin(other.min, moved.min);
+        a.max = componentMax(other.max, moved.max);
+        a.height = 1 + GEP_MAX(other.height, moved.height);
+        up.min = componentMin(a.min, kept.min);
+        up.max = componentMax(a.max, kept.max);
+        up.height = 1 + GEP_MAX(a.height, kept.height);
+    };
+
+    if(heightDifference > 1)
+    {
+        rotateUp(iC, c, iB, b, a.child2);
+        return iC;
+    }
+    if(heightDifference < -1)
+    {
+        rotateUp(iB, b, iC, c, a.child1);
+        return iB;
+    }
+    return iA;
+}
+
+gep::uint32 gep::AabbTree::getHeight() const
+{
+    return m_root == NULL_NODE ? 0 : uint32(m_nodes[m_root].height);
+}
+
+void gep::AabbTree::validate() const
+{
+    if(m_root == NULL_NODE)
+    {
+        GEP_ASSERT(m_numProxies == 0, "proxies are missing in the tree", m_numProxies);
+        return;
+    }
+    GEP_ASSERT(m_nodes[m_root].parentOrNext == NULL_NODE, "the root has a parent");
+    validate(m_root);
+
+    size_t numFree = 0;
+    for(uint32 nodeId = m_freeList; nodeId != NULL_NODE; nodeId = m_nodes[nodeId].parentOrNext)
+    {
+        GEP_ASSERT(m_nodes[nodeId].height == -1, "a free node is still in use", nodeId);
+        numFree++;
+    }
+    // a tree with n leaves has n - 1 inner nodes
+    GEP_ASSERT(numFree + 2 * m_numProxies - 1 == m_nodes.length(), "nodes got lost", numFree, m_numProxies, m_nodes.length());
+}
+
+void gep::AabbTree::validate(uint32 nodeId) const
+{
+    const auto& node = m_nodes[nodeId];
+    if(node.isLeaf())
+    {
+        GEP_ASSERT(node.height == 0 && node.child2 == NULL_NODE, "invalid leaf", nodeId);
+        return;
+    }
+    const auto& child1 = m_nodes[node.child1];
+    const auto& child2 = m_nodes[node.child2];
+    GEP_ASSERT(child1.parentOrNext == nodeId && child2.parentOrNext == nodeId, "broken parent link", nodeId);
+    GEP_ASSERT(node.height == 1 + GEP_MAX(child1.height, child2.height), "wrong height", nodeId);
+    GEP_ASSERT(child1.height - child2.height <= 1 && child2.height - child1.height <= 1, "the tree is not balanced", nodeId);
+    GEP_ASSERT(contains(node.min, node.max, child1.min, child1.max) && contains(node.min, node.max, child2.min, child2.max),
+        "the box does not contain the children", nodeId);
+    validate(node.child1);
+    validate(node.child2);
+}
+
+bool gep::AabbTree::intersectsRay(const vec3& min, const vec3& max, const vec3& origin, const vec3& direction, float maxFraction)
+{
+    float tMin = 0.0f;
+    float tMax = maxFraction;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        const float d = direction.data[axis];
+        const float o = origin.data[axis];
+        if(d > -1e-12f && d < 1e-12f)
+        {
+            if(o < min.data[axis] || o > max.data[axis])
+                return false;
+            continue;
+        }
+        const float inverse = 1.0f / d;
+        float t1 = (min.data[axis] - o) * inverse;
+        float t2 = (max.data[axis] - o) * inverse;
+        if(t1 > t2)
+            std::swap(t1, t2);
+        tMin = GEP_MAX(tMin, t1);
+        tMax = GEP_MIN(tMax, t2);
+        if(tMin > tMax)
+            return false;
+    }
+    return true;
+}
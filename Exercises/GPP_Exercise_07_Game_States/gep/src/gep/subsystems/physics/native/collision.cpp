@@ -0,0 +1,890 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/collision.h"
+#include <algorithm>
+
+namespace
+{
+    using namespace gep;
+    using namespace gep::native;
+
+    const float FLOAT_MAX = 3.402823466e+38f;
+    const uint8 NO_FACE = 0xff;
+    /// sutherland hodgman adds at most one vertex per clipping plane
+    const size_t MAX_CLIP_VERTICES = 2 * Hull::MAX_VERTICES;
+    /// an edge pair has to be this much deeper than the best face to be used for the contact, see collideHulls
+    const float RELATIVE_EDGE_TOLERANCE = 0.90f;
+    const float RELATIVE_FACE_TOLERANCE = 0.98f;
+    /// conservative advancement usually converges in a few iterations, stopping early only reports the hit a bit too soon
+    const uint32 MAX_CAST_ITERATIONS = 20;
+
+    inline float clamp(float value, float min, float max)
+    {
+        return value < min ? min : (value > max ? max : value);
+    }
+
+    inline float absolute(float value)
+    {
+        return value < 0.0f ? -value : value;
+    }
+
+    /// the transform which maps the local space of b into the local space of a
+    inline Transform relativeTransform(const Transform& a, const Transform& b)
+    {
+        Transform result;
+        result.rotation = a.rotation.transposed() * b.rotation;
+        result.position = a.toLocal(b.position);
+        return result;
+    }
+
+    inline Transform inverseTransform(const Transform& transform)
+    {
+        Transform result;
+        result.rotation = transform.rotation.transposed();
+        result.position = -(result.rotation * transform.position);
+        return result;
+    }
+
+    struct FaceQuery
+    {
+        float separation;
+        uint32 index;
+    };
+
+    struct EdgeQuery
+    {
+        float separation;
+        uint32 indexA;
+        uint32 indexB;
+        /// points away from hull a
+        vec3 axis;
+    };
+
+    /// the faces of hull a against the support points of hull b, in the local space of a
+    FaceQuery queryFaceDirections(const Hull& hullA, const Hull& hullB, const Transform& bToA)
+    {
+        FaceQuery result = { -FLOAT_MAX, 0 };
+        for(size_t i = 0; i < hullA.faces.length(); i++)
+        {
+            const auto& face = hullA.faces[i];
+            const vec3 support = bToA.toWorld(hullB.getSupport(bToA.rotateInverse(-face.normal)));
+            const float separation = face.normal.dot(support) - face.offset;
+            if(separation > result.separation)
+            {
+                result.separation = separation;
+                result.index = uint32(i);
+            }
+        }
+        return result;
+    }
+
+    /// tests if the arcs ab and cd of the gauss maps intersect, only those edge pairs build a face of the minkowski difference
+    inline bool isMinkowskiFace(const vec3& a, const vec3& b, const vec3& bCrossA, const vec3& c, const vec3& d, const vec3& dCrossC)
+    {
+        const float cba = c.dot(bCrossA);
+        const float dba = d.dot(bCrossA);
+        const float adc = a.dot(dCrossC);
+        const float bdc = b.dot(dCrossC);
+        return cba * dba < 0.0f && adc * bdc < 0.0f && cba * bdc > 0.0f;
+    }
+
+    /// all edge pairs which build a face of the minkowski difference, in the local space of a
+    EdgeQuery queryEdgeDirections(const Hull& hullA, const Hull& hullB, const Transform& bToA)
+    {
+        EdgeQuery result;
+        result.separation = -FLOAT_MAX;
+        result.indexA = 0;
+        result.indexB = 0;
+
+        for(size_t i = 0; i < hullA.edges.length(); i++)
+        {
+            const auto& edgeA = hullA.edges[i];
+            const vec3& a0 = hullA.vertices[edgeA.vertex0];
+            const vec3 directionA = hullA.vertices[edgeA.vertex1] - a0;
+            const vec3& normalA0 = hullA.faces[edgeA.face0].normal;
+            const vec3& normalA1 = hullA.faces[edgeA.face1].normal;
+            const vec3 crossA = normalA1.cross(normalA0);
+
+            for(size_t j = 0; j < hullB.edges.length(); j++)
+            {
+                const auto& edgeB = hullB.edges[j];
+                // the minkowski difference negates the normals of b
+                const vec3 normalB0 = bToA.rotation * -hullB.faces[edgeB.face0].normal;
+                const vec3 normalB1 = bToA.rotation * -hullB.faces[edgeB.face1].normal;
+                if(!isMinkowskiFace(normalA0, normalA1, crossA, normalB0, normalB1, normalB1.cross(normalB0)))
+                    continue;
+
+                const vec3 b0 = bToA.toWorld(hullB.vertices[edgeB.vertex0]);
+                const vec3 directionB = bToA.toWorld(hullB.vertices[edgeB.vertex1]) - b0;
+                vec3 axis = directionA.cross(directionB);
+                const float length = axis.length();
+                // parallel edges are covered by the face queries
+                if(length < 0.005f * gep::sqrt(directionA.squaredLength() * directionB.squaredLength()))
+                    continue;
+                axis /= length;
+                if(axis.dot(a0 - hullA.center) < 0.0f)
+                    axis = -axis;
+
+                const float separation = axis.dot(b0 - a0);
+                if(separation > result.separation)
+                {
+                    result.separation = separation;
+                    result.indexA = uint32(i);
+                    result.indexB = uint32(j);
+                    result.axis = axis;
+                }
+            }
+        }
+        return result;
+    }
+
+    /// keeps the part of the polygon with dot(normal, x) <= offset
+    size_t clipPolygon(const vec3* input, size_t numInput, const vec3& normal, float offset, vec3* output)
+    {
+        if(numInput == 0)
+            return 0;
+        size_t numOutput = 0;
+        vec3 previous = input[numInput - 1];
+        float previousDistance = normal.dot(previous) - offset;
+        for(size_t i = 0; i < numInput; i++)
+        {
+            const vec3& current = input[i];
+            const float distance = normal.dot(current) - offset;
+            if((previousDistance <= 0.0f) != (distance <= 0.0f))
+            {
+                GEP_ASSERT(numOutput < MAX_CLIP_VERTICES, "too many clipped vertices");
+                output[numOutput++] = previous + (current - previous) * (previousDistance / (previousDistance - distance));
+            }
+            if(distance <= 0.0f)
+            {
+                GEP_ASSERT(numOutput < MAX_CLIP_VERTICES, "too many clipped vertices");
+                output[numOutput++] = current;
+            }
+            previous = current;
+            previousDistance = distance;
+        }
+        return numOutput;
+    }
+
+    /// keeps the deepest point and the ones spanning the largest area
+    size_t reduceContactPoints(ContactPoint* points, size_t numPoints, const vec3& normal)
+    {
+        if(numPoints <= Manifold::MAX_POINTS)
+            return numPoints;
+
+        size_t deepest = 0;
+        for(size_t i = 1; i < numPoints; i++)
+        {
+            if(points[i].separation < points[deepest].separation)
+                deepest = i;
+        }
+
+        size_t furthest = deepest;
+        float maxDistance = -1.0f;
+        for(size_t i = 0; i < numPoints; i++)
+        {
+            const float distance = (points[i].position - points[deepest].position).squaredLength();
+            if(distance > maxDistance)
+            {
+                maxDistance = distance;
+                furthest = i;
+            }
+        }
+
+        const vec3 edge = points[furthest].position - points[deepest].position;
+        size_t maxAreaIndex = deepest;
+        size_t minAreaIndex = deepest;
+        float maxArea = 0.0f;
+        float minArea = 0.0f;
+        for(size_t i = 0; i < numPoints; i++)
+        {
+            const float area = edge.cross(points[i].position - points[deepest].position).dot(normal);
+            if(area > maxArea)
+            {
+                maxArea = area;
+                maxAreaIndex = i;
+            }
+            if(area < minArea)
+            {
+                minArea = area;
+                minAreaIndex = i;
+            }
+        }
+
+        ContactPoint reduced[Manifold::MAX_POINTS];
+        size_t numReduced = 0;
+        reduced[numReduced++] = points[deepest];
+        if(furthest != deepest)
+            reduced[numReduced++] = points[furthest];
+        if(maxAreaIndex != deepest)
+            reduced[numReduced++] = points[maxAreaIndex];
+        if(minAreaIndex != deepest)
+            reduced[numReduced++] = points[minAreaIndex];
+        for(size_t i = 0; i < numReduced; i++)
+            points[i] = reduced[i];
+        return numReduced;
+    }
+
+    /// clips the most anti parallel face of the incident hull against the reference face, in the local space of the reference hull
+    size_t createFaceContact(const Hull& reference, uint32 referenceFaceIndex, const Hull& incident, const Transform& incidentToReference,
+                             float margin, ContactPoint* points)
+    {
+        const auto& referenceFace = reference.faces[referenceFaceIndex];
+        const vec3& normal = referenceFace.normal;
+
+        const vec3 incidentDirection = incidentToReference.rotateInverse(normal);
+        size_t incidentFaceIndex = 0;
+        float minDot = FLOAT_MAX;
+        for(size_t i = 0; i < incident.faces.length(); i++)
+        {
+            const float d = incident.faces[i].normal.dot(incidentDirection);
+            if(d < minDot)
+            {
+                minDot = d;
+                incidentFaceIndex = i;
+            }
+        }
+
+        vec3 buffers[2][MAX_CLIP_VERTICES];
+        const auto& incidentFace = incident.faces[incidentFaceIndex];
+        size_t numVertices = incidentFace.numVertices;
+        for(size_t i = 0; i < numVertices; i++)
+            buffers[0][i] = incidentToReference.toWorld(incident.vertices[incident.getFaceVertex(incidentFace, i)]);
+
+        int current = 0;
+        for(size_t i = 0; i < referenceFace.numVertices && numVertices > 0; i++)
+        {
+            const vec3& v0 = reference.vertices[reference.getFaceVertex(referenceFace, i)];
+            const vec3& v1 = reference.vertices[reference.getFaceVertex(referenceFace, (i + 1) % referenceFace.numVertices)];
+            // the faces wind counter clockwise, so this points away from the face
+            const vec3 sideNormal = (v1 - v0).cross(normal);
+            numVertices = clipPolygon(buffers[current], numVertices, sideNormal, sideNormal.dot(v0), buffers[1 - current]);
+            current = 1 - current;
+        }
+
+        ContactPoint candidates[MAX_CLIP_VERTICES];
+        size_t numCandidates = 0;
+        for(size_t i = 0; i < numVertices; i++)
+        {
+            const vec3& point = buffers[current][i];
+            const float separation = normal.dot(point) - referenceFace.offset;
+            if(separation > margin)
+                continue;
+            candidates[numCandidates].position = point - normal * (0.5f * separation);
+            candidates[numCandidates].separation = separation;
+            numCandidates++;
+        }
+
+        numCandidates = reduceContactPoints(candidates, numCandidates, normal);
+        for(size_t i = 0; i < numCandidates; i++)
+            points[i] = candidates[i];
+        return numCandidates;
+    }
+
+    void closestPointsOnSegments(const vec3& p1, const vec3& q1, const vec3& p2, const vec3& q2, vec3& c1, vec3& c2)
+    {
+        const vec3 d1 = q1 - p1;
+        const vec3 d2 = q2 - p2;
+        const vec3 r = p1 - p2;
+        const float a = d1.squaredLength();
+        const float e = d2.squaredLength();
+        const float f = d2.dot(r);
+        const float c = d1.dot(r);
+        const float b = d1.dot(d2);
+        const float denominator = a * e - b * b;
+
+        float s = denominator > 1e-12f ? clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+        float t = e > 1e-12f ? (b * s + f) / e : 0.0f;
+        if(t < 0.0f)
+        {
+            t = 0.0f;
+            s = a > 1e-12f ? clamp(-c / a, 0.0f, 1.0f) : 0.0f;
+        }
+        else if(t > 1.0f)
+        {
+            t = 1.0f;
+            s = a > 1e-12f ? clamp((b - c) / a, 0.0f, 1.0f) : 0.0f;
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    /// the closest point of a face polygon to a point in front of it, in the local space of the hull
+    vec3 closestPointOnFace(const Hull& hull, const Hull::Face& face, const vec3& point)
+    {
+        const vec3 projected = point - face.normal * (face.normal.dot(point) - face.offset);
+        bool isInside = true;
+        for(size_t i = 0; i < face.numVertices && isInside; i++)
+        {
+            const vec3& v0 = hull.vertices[hull.getFaceVertex(face, i)];
+            const vec3& v1 = hull.vertices[hull.getFaceVertex(face, (i + 1) % face.numVertices)];
+            isInside = (v1 - v0).cross(face.normal).dot(projected - v0) <= 0.0f;
+        }
+        if(isInside)
+            return projected;
+
+        vec3 closest = projected;
+        float minDistance = FLOAT_MAX;
+        for(size_t i = 0; i < face.numVertices; i++)
+        {
+            const vec3& v0 = hull.vertices[hull.getFaceVertex(face, i)];
+            const vec3& v1 = hull.vertices[hull.getFaceVertex(face, (i + 1) % face.numVertices)];
+            const vec3 edge = v1 - v0;
+            const float t = clamp(edge.dot(point - v0) / edge.squaredLength(), 0.0f, 1.0f);
+            const vec3 candidate = v0 + edge * t;
+            const float distance = (candidate - point).squaredLength();
+            if(distance < minDistance)
+            {
+                minDistance = distance;
+                closest = candidate;
+            }
+        }
+        return closest;
+    }
+
+    struct Point2D
+    {
+        float x;
+        float y;
+        uint8 index;
+
+        inline bool operator < (const Point2D& rh) const { return x < rh.x || (x == rh.x && y < rh.y); }
+    };
+
+    inline float cross2D(const Point2D& o, const Point2D& a, const Point2D& b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+
+    /// andrew's monotone chain, drops collinear points
+    size_t convexHull2D(Point2D* points, size_t numPoints, Point2D* hull)
+    {
+        if(numPoints < 3)
+            return 0;
+        std::sort(points, points + numPoints);
+        size_t size = 0;
+        for(size_t i = 0; i < numPoints; i++)
+        {
+            while(size >= 2 && cross2D(hull[size - 2], hull[size - 1], points[i]) <= 0.0f)
+                size--;
+            hull[size++] = points[i];
+        }
+        const size_t lowerSize = size + 1;
+        for(size_t i = numPoints - 1; i-- > 0; )
+        {
+            while(size >= lowerSize && cross2D(hull[size - 2], hull[size - 1], points[i]) <= 0.0f)
+                size--;
+            hull[size++] = points[i];
+        }
+        // the first point was added again at the end
+        return size > 1 ? size - 1 : size;
+    }
+}
+
+gep::native::Hull::Hull(IAllocator* pAllocator) :
+    vertices(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    faces(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    faceVertices(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    edges(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    center(0.0f),
+    localMin(0.0f),
+    localMax(0.0f)
+{
+}
+
+void gep::native::Hull::setBox(const vec3& halfExtents)
+{
+    vec3 corners[8];
+    for(int i = 0; i < 8; i++)
+    {
+        corners[i] = vec3((i & 1) ? halfExtents.x : -halfExtents.x,
+                          (i & 2) ? halfExtents.y : -halfExtents.y,
+                          (i & 4) ? halfExtents.z : -halfExtents.z);
+    }
+    const Result result = setConvexHull(ArrayPtr<vec3>(corners));
+    GEP_ASSERT(result == SUCCESS, "invalid box", halfExtents.x, halfExtents.y, halfExtents.z);
+    GEP_UNUSED(result);
+}
+
+gep::Result gep::native::Hull::setConvexHull(const ArrayPtr<vec3>& points)
+{
+    vertices.clear();
+    faces.clear();
+    faceVertices.clear();
+    edges.clear();
+    if(points.length() < 4 || points.length() > MAX_VERTICES)
+        return FAILURE;
+
+    float scale = 0.0f;
+    for(auto& point : points)
+        scale = GEP_MAX(scale, GEP_MAX(absolute(point.x), GEP_MAX(absolute(point.y), absolute(point.z))));
+    const float epsilon = GEP_MAX(1e-4f * scale, 1e-6f);
+
+    // drop duplicates, every unique point gets a slot in uniquePoints
+    vec3 uniquePoints[MAX_VERTICES];
+    size_t numUnique = 0;
+    for(auto& point : points)
+    {
+        bool isDuplicate = false;
+        for(size_t i = 0; i < numUnique && !isDuplicate; i++)
+            isDuplicate = (uniquePoints[i] - point).squaredLength() <= epsilon * epsilon;
+        if(!isDuplicate)
+            uniquePoints[numUnique++] = point;
+    }
+    if(numUnique < 4)
+        return FAILURE;
+
+    // brute force: every plane through three points which has all points behind it is a face
+    const size_t maxFaces = 2 * MAX_VERTICES;
+    vec3 planeNormals[maxFaces];
+    float planeOffsets[maxFaces];
+    size_t numPlanes = 0;
+    bool isFlat = true;
+    for(size_t i = 0; i < numUnique; i++)
+    {
+        for(size_t j = i + 1; j < numUnique; j++)
+        {
+            for(size_t k = j + 1; k < numUnique; k++)
+            {
+                vec3 normal = (uniquePoints[j] - uniquePoints[i]).cross(uniquePoints[k] - uniquePoints[i]);
+                const float length = normal.length();
+                if(length <= epsilon * scale)
+                    continue;
+                normal /= length;
+                float offset = normal.dot(uniquePoints[i]);
+
+                bool hasFront = false;
+                bool hasBack = false;
+                for(size_t p = 0; p < numUnique && !(hasFront && hasBack); p++)
+                {
+                    const float distance = normal.dot(uniquePoints[p]) - offset;
+                    hasFront |= distance > epsilon;
+                    hasBack |= distance < -epsilon;
+                }
+                if(hasFront && hasBack)
+                    continue;
+                if(hasFront || hasBack)
+                    isFlat = false;
+                if(hasFront)
+                {
+                    normal = -normal;
+                    offset = -offset;
+                }
+
+                bool isDuplicate = false;
+                for(size_t p = 0; p < numPlanes && !isDuplicate; p++)
+                    isDuplicate = planeNormals[p].dot(normal) > 0.999f && absolute(planeOffsets[p] - offset) <= epsilon;
+                if(!isDuplicate && numPlanes < maxFaces)
+                {
+                    planeNormals[numPlanes] = normal;
+                    planeOffsets[numPlanes] = offset;
+                    numPlanes++;
+                }
+            }
+        }
+    }
+    if(isFlat)
+        return FAILURE;
+
+    // only points on a face become vertices
+    uint8 vertexIndices[MAX_VERTICES];
+    for(size_t i = 0; i < numUnique; i++)
+        vertexIndices[i] = NO_FACE;
+
+    for(size_t plane = 0; plane < numPlanes; plane++)
+    {
+        const vec3& normal = planeNormals[plane];
+        // v = normal x u, so counter clockwise in (u, v) is counter clockwise seen from the outside
+        const vec3 u = (absolute(normal.x) < 0.6f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f)).cross(normal).normalized();
+        const vec3 v = normal.cross(u);
+
+        Point2D facePoints[MAX_VERTICES];
+        size_t numFacePoints = 0;
+        for(size_t i = 0; i < numUnique; i++)
+        {
+            if(absolute(normal.dot(uniquePoints[i]) - planeOffsets[plane]) > epsilon)
+                continue;
+            Point2D point = { u.dot(uniquePoints[i]), v.dot(uniquePoints[i]), uint8(i) };
+            facePoints[numFacePoints++] = point;
+        }
+
+        Point2D outline[MAX_VERTICES + 1];
+        const size_t numOutline = convexHull2D(facePoints, numFacePoints, outline);
+        if(numOutline < 3 || faces.length() >= NO_FACE)
+            continue;
+
+        Face face;
+        face.normal = normal;
+        face.offset = planeOffsets[plane];
+        face.firstVertex = uint16(faceVertices.length());
+        face.numVertices = uint16(numOutline);
+        for(size_t i = 0; i < numOutline; i++)
+        {
+            const uint8 point = outline[i].index;
+            if(vertexIndices[point] == NO_FACE)
+            {
+                vertexIndices[point] = uint8(vertices.length());
+                vertices.append(uniquePoints[point]);
+            }
+            faceVertices.append(vertexIndices[point]);
+        }
+        faces.append(face);
+    }
+
+    // every edge is shared by two faces which walk it in opposite directions
+    for(size_t f = 0; f < faces.length(); f++)
+    {
+        const auto& face = faces[f];
+        for(size_t i = 0; i < face.numVertices; i++)
+        {
+            const uint8 a = getFaceVertex(face, i);
+            const uint8 b = getFaceVertex(face, (i + 1) % face.numVertices);
+            bool hasTwin = false;
+            for(auto& edge : edges)
+            {
+                if(edge.vertex0 == b && edge.vertex1 == a && edge.face1 == NO_FACE)
+                {
+                    edge.face1 = uint8(f);
+                    hasTwin = true;
+                    break;
+                }
+            }
+            if(!hasTwin)
+            {
+                Edge edge = { a, b, uint8(f), NO_FACE };
+                edges.append(edge);
+            }
+        }
+    }
+
+    bool isClosed = vertices.length() + faces.length() == edges.length() + 2;
+    for(auto& edge : edges)
+        isClosed = isClosed && edge.face1 != NO_FACE;
+    if(!isClosed)
+    {
+        vertices.clear();
+        faces.clear();
+        faceVertices.clear();
+        edges.clear();
+        return FAILURE;
+    }
+
+    center = vec3(0.0f);
+    localMin = vertices[0];
+    localMax = vertices[0];
+    for(auto& vertex : vertices)
+    {
+        center += vertex;
+        localMin = vec3(GEP_MIN(localMin.x, vertex.x), GEP_MIN(localMin.y, vertex.y), GEP_MIN(localMin.z, vertex.z));
+        localMax = vec3(GEP_MAX(localMax.x, vertex.x), GEP_MAX(localMax.y, vertex.y), GEP_MAX(localMax.z, vertex.z));
+    }
+    center /= float(vertices.length());
+    return SUCCESS;
+}
+
+const gep::vec3& gep::native::Hull::getSupport(const vec3& direction) const
+{
+    size_t best = 0;
+    float maxDot = -FLOAT_MAX;
+    for(size_t i = 0; i < vertices.length(); i++)
+    {
+        const float d = vertices[i].dot(direction);
+        if(d > maxDot)
+        {
+            maxDot = d;
+            best = i;
+        }
+    }
+    return vertices[best];
+}
+
+bool gep::native::collideSpheres(const vec3& centerA, float radiusA, const vec3& centerB, float radiusB, float margin, Manifold& manifold)
+{
+    const vec3 offset = centerB - centerA;
+    const float distanceSquared = offset.squaredLength();
+    const float maxDistance = radiusA + radiusB + margin;
+    if(distanceSquared > maxDistance * maxDistance)
+        return false;
+
+    const float distance = gep::sqrt(distanceSquared);
+    manifold.normal = distance > 1e-6f ? offset / distance : vec3(0.0f, 0.0f, 1.0f);
+    const vec3 surfaceA = centerA + manifold.normal * radiusA;
+    const vec3 surfaceB = centerB - manifold.normal * radiusB;
+    manifold.points[0].position = (surfaceA + surfaceB) * 0.5f;
+    manifold.points[0].separation = distance - radiusA - radiusB;
+    manifold.numPoints = 1;
+    return true;
+}
+
+bool gep::native::collideSphereHull(const vec3& center, float radius, const Hull& hull, const Transform& transform, float margin, Manifold& manifold)
+{
+    const vec3 localCenter = transform.toLocal(center);
+
+    size_t deepestFace = 0;
+    float maxSeparation = -FLOAT_MAX;
+    for(size_t i = 0; i < hull.faces.length(); i++)
+    {
+        const float separation = hull.faces[i].normal.dot(localCenter) - hull.faces[i].offset;
+        if(separation > maxSeparation)
+        {
+            maxSeparation = separation;
+            deepestFace = i;
+        }
+    }
+    if(maxSeparation > radius + margin)
+        return false;
+
+    vec3 closest;
+    vec3 localNormal;
+    float separation;
+    if(maxSeparation <= 0.0f)
+    {
+        // the center is inside, push it out through the closest face
+        const auto& face = hull.faces[deepestFace];
+        closest = localCenter - face.normal * maxSeparation;
+        localNormal = -face.normal;
+        separation = maxSeparation - radius;
+    }
+    else
+    {
+        float minDistanceSquared = FLOAT_MAX;
+        for(auto& face : hull.faces)
+        {
+            if(face.normal.dot(localCenter) - face.offset <= 0.0f)
+                continue;
+            const vec3 candidate = closestPointOnFace(hull, face, localCenter);
+            const float distanceSquared = (candidate - localCenter).squaredLength();
+            if(distanceSquared < minDistanceSquared)
+            {
+                minDistanceSquared = distanceSquared;
+                closest = candidate;
+            }
+        }
+        const float distance = gep::sqrt(minDistanceSquared);
+        separation = distance - radius;
+        if(separation > margin)
+            return false;
+        localNormal = distance > 1e-6f ? (closest - localCenter) / distance : -hull.faces[deepestFace].normal;
+    }
+
+    const vec3 surface = localCenter + localNormal * radius;
+    manifold.normal = transform.rotation * localNormal;
+    manifold.points[0].position = transform.toWorld((surface + closest) * 0.5f);
+    manifold.points[0].separation = separation;
+    manifold.numPoints = 1;
+    return true;
+}
+
+bool gep::native::collideHulls(const Hull& hullA, const Transform& transformA, const Hull& hullB, const Transform& transformB,
+                               float margin, float linearSlop, Manifold& manifold)
+{
+    const Transform bToA = relativeTransform(transformA, transformB);
+    const FaceQuery faceQueryA = queryFaceDirections(hullA, hullB, bToA);
+    if(faceQueryA.separation > margin)
+        return false;
+
+    const Transform aToB = inverseTransform(bToA);
+    const FaceQuery faceQueryB = queryFaceDirections(hullB, hullA, aToB);
+    if(faceQueryB.separation > margin)
+        return false;
+
+    const EdgeQuery edgeQuery = queryEdgeDirections(hullA, hullB, bToA);
+    if(edgeQuery.separation > margin)
+        return false;
+
+    // prefer faces over edges and a over b unless the other one is clearly better, so the contact does not flip between steps
+    const float absoluteTolerance = 0.5f * linearSlop;
+    const float maxFaceSeparation = GEP_MAX(faceQueryA.separation, faceQueryB.separation);
+    if(edgeQuery.separation > RELATIVE_EDGE_TOLERANCE * maxFaceSeparation + absoluteTolerance)
+    {
+        const auto& edgeA = hullA.edges[edgeQuery.indexA];
+        const auto& edgeB = hullB.edges[edgeQuery.indexB];
+        vec3 closestA;
+        vec3 closestB;
+        closestPointsOnSegments(hullA.vertices[edgeA.vertex0], hullA.vertices[edgeA.vertex1],
+                                bToA.toWorld(hullB.vertices[edgeB.vertex0]), bToA.toWorld(hullB.vertices[edgeB.vertex1]),
+                                closestA, closestB);
+        manifold.normal = transformA.rotation * edgeQuery.axis;
+        manifold.points[0].position = transformA.toWorld((closestA + closestB) * 0.5f);
+        manifold.points[0].separation = edgeQuery.separation;
+        manifold.numPoints = 1;
+        return true;
+    }
+
+    if(faceQueryB.separation > RELATIVE_FACE_TOLERANCE * faceQueryA.separation + absoluteTolerance)
+    {
+        manifold.numPoints = uint32(createFaceContact(hullB, faceQueryB.index, hullA, aToB, margin, manifold.points));
+        manifold.normal = -(transformB.rotation * hullB.faces[faceQueryB.index].normal);
+        for(uint32 i = 0; i < manifold.numPoints; i++)
+            manifold.points[i].position = transformB.toWorld(manifold.points[i].position);
+    }
+    else
+    {
+        manifold.numPoints = uint32(createFaceContact(hullA, faceQueryA.index, hullB, bToA, margin, manifold.points));
+        manifold.normal = transformA.rotation * hullA.faces[faceQueryA.index].normal;
+        for(uint32 i = 0; i < manifold.numPoints; i++)
+            manifold.points[i].position = transformA.toWorld(manifold.points[i].position);
+    }
+    return manifold.numPoints > 0;
+}
+
+bool gep::native::collide(const CollisionShape& shapeA, const Transform& transformA,
+                          const CollisionShape& shapeB, const Transform& transformB,
+                          float margin, float linearSlop, Manifold& manifold)
+{
+    if(shapeA.isSphere())
+    {
+        if(shapeB.isSphere())
+            return collideSpheres(transformA.position, shapeA.radius, transformB.position, shapeB.radius, margin, manifold);
+        return collideSphereHull(transformA.position, shapeA.radius, *shapeB.pHull, transformB, margin, manifold);
+    }
+    if(shapeB.isSphere())
+    {
+        if(!collideSphereHull(transformB.position, shapeB.radius, *shapeA.pHull, transformA, margin, manifold))
+            return false;
+        manifold.normal = -manifold.normal;
+        return true;
+    }
+    return collideHulls(*shapeA.pHull, transformA, *shapeB.pHull, transformB, margin, linearSlop, manifold);
+}
+
+bool gep::native::castRay(const CollisionShape& shape, const Transform& transform, const vec3& from, const vec3& to,
+                          float maxFraction, float& fraction)
+{
+    if(shape.isSphere())
+    {
+        const vec3 m = from - transform.position;
+        const vec3 d = to - from;
+        const float c = m.squaredLength() - shape.radius * shape.radius;
+        const float b = m.dot(d);
+        if(c <= 0.0f || b >= 0.0f)
+            return false;
+        const float a = d.squaredLength();
+        const float discriminant = b * b - a * c;
+        if(discriminant < 0.0f)
+            return false;
+        const float t = (-b - gep::sqrt(discriminant)) / a;
+        if(t > maxFraction)
+            return false;
+        fraction = GEP_MAX(t, 0.0f);
+        return true;
+    }
+
+    const Hull& hull = *shape.pHull;
+    const vec3 origin = transform.toLocal(from);
+    const vec3 direction = transform.rotateInverse(to - from);
+    float lower = 0.0f;
+    float upper = maxFraction;
+    bool hasEntered = false;
+    for(auto& face : hull.faces)
+    {
+        const float numerator = face.offset - face.normal.dot(origin);
+        const float denominator = face.normal.dot(direction);
+        if(denominator == 0.0f)
+        {
+            if(numerator < 0.0f)
+                return false;
+        }
+        else if(denominator < 0.0f && numerator < lower * denominator)
+        {
+            lower = numerator / denominator;
+            hasEntered = true;
+        }
+        else if(denominator > 0.0f && numerator < upper * denominator)
+        {
+            upper = numerator / denominator;
+        }
+        if(upper < lower)
+            return false;
+    }
+    if(!hasEntered)
+        return false;
+    fraction = lower;
+    return true;
+}
+
+bool gep::native::castShape(const CollisionShape& shapeA, const mat3& rotationA, const vec3& from, const vec3& to,
+                            const CollisionShape& shapeB, const Transform& transformB,
+                            float maxFraction, float tolerance, float& fraction)
+{
+    const vec3 delta = to - from;
+    const float length = delta.length();
+    Transform transformA = { from, rotationA };
+    Manifold manifold;
+    float t = 0.0f;
+    for(uint32 iteration = 0; iteration < MAX_CAST_ITERATIONS; iteration++)
+    {
+        transformA.position = from + delta * t;
+        // the narrowphase only reports shapes within the margin, so the rest of the sweep is the margin
+        if(!collide(shapeA, transformA, shapeB, transformB, (maxFraction - t) * length + tolerance, tolerance, manifold))
+            return false;
+        float distance = FLOAT_MAX;
+        for(uint32 i = 0; i < manifold.numPoints; i++)
+            distance = GEP_MIN(distance, manifold.points[i].separation);
+        if(distance <= tolerance)
+            break;
+
+        // the separation along the normal is a lower bound of the distance, moving until it is used up can't tunnel
+        const float approach = delta.dot(manifold.normal);
+        if(approach <= 0.0f)
+            return false;
+        t += (distance - 0.5f * tolerance) / approach;
+        if(t > maxFraction)
+            return false;
+    }
+    fraction = t;
+    return true;
+}
+
+void gep::native::computeBounds(const CollisionShape& shape, const Transform& transform, vec3& min, vec3& max)
+{
+    if(shape.isSphere())
+    {
+        min = transform.position - vec3(shape.radius);
+        max = transform.position + vec3(shape.radius);
+        return;
+    }
+
+    const Hull& hull = *shape.pHull;
+    const vec3 center = transform.toWorld((hull.localMin + hull.localMax) * 0.5f);
+    const vec3 extents = (hull.localMax - hull.localMin) * 0.5f;
+    const float* r = transform.rotation.data;
+    const vec3 worldExtents(absolute(r[0]) * extents.x + absolute(r[3]) * extents.y + absolute(r[6]) * extents.z,
+                            absolute(r[1]) * extents.x + absolute(r[4]) * extents.y + absolute(r[7]) * extents.z,
+                            absolute(r[2]) * extents.x + absolute(r[5]) * extents.y + absolute(r[8]) * extents.z);
+    min = center - worldExtents;
+    max = center + worldExtents;
+}
+
+gep::vec3 gep::native::computeInertia(const CollisionShape& shape, float mass)
+{
+    if(shape.isSphere())
+        return vec3(0.4f * mass * shape.radius * shape.radius);
+
+    const vec3 size = shape.pHull->localMax - shape.pHull->localMin;
+    const vec3 squared = size * size;
+    return vec3(squared.y + squared.z, squared.x + squared.z, squared.x + squared.y) * (mass / 12.0f);
+}
+
+gep::Result gep::native::setCollisionShape(const IShape& shape, Hull& hull, CollisionShape& collisionShape)
+{
+    collisionShape.type = shape.getShapeType();
+    collisionShape.radius = 0.0f;
+    collisionShape.pHull = nullptr;
+    switch(collisionShape.type)
+    {
+    case ShapeType::Sphere:
+        collisionShape.radius = static_cast<const SphereShape&>(shape).getRadius();
+        return SUCCESS;
+    case ShapeType::Box:
+        hull.setBox(static_cast<const BoxShape&>(shape).getHalfExtents());
+        collisionShape.pHull = &hull;
+        return SUCCESS;
+    case ShapeType::ConvexVertices:
+        if(hull.setConvexHull(static_cast<const ConvexVerticesShape&>(shape).getVertices()) == FAILURE)
+            return FAILURE;
+        collisionShape.pHull = &hull;
+        return SUCCESS;
+    default:
+        return FAILURE;
+    }
+}
@@ -0,0 +1,292 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/entity.h"
+#include "gepimpl/subsystems/physics/native/world.h"
+#include "gepimpl/subsystems/physics/native/aabbTree.h"
+
+#include "gep/interfaces/physics/shape.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+
+gep::NativeRigidBody::NativeRigidBody(const RigidBodyCInfo& cinfo, IAllocator* pAllocator) :
+    m_pWorld(nullptr),
+    m_index(0),
+    m_proxy(AabbTree::NULL_NODE),
+    m_id(0),
+    m_shape(cinfo.shape),
+    m_hull(pAllocator),
+    m_boundingRadius(0.0f),
+    m_collidable(),
+    m_collisionFilterInfo(cinfo.collisionFilterInfo),
+    m_mass(cinfo.mass),
+    m_motionType(cinfo.motionType),
+    m_restitution(cinfo.restitution),
+    m_friction(cinfo.friction),
+    m_linearDamping(cinfo.linearDamping),
+    m_angularDamping(cinfo.angularDamping),
+    m_gravityFactor(cinfo.gravityFactor),
+    m_rollingFrictionMultiplier(cinfo.rollingFrictionMultiplier),
+    m_maxLinearVelocity(cinfo.maxLinearVelocity),
+    m_maxAngularVelocity(cinfo.maxAngularVelocity),
+    m_timeFactor(cinfo.timeFactor),
+    m_contactPointCallbackDelay(cinfo.contactPointCallbackDelay),
+    m_enableDeactivation(cinfo.enableDeactivation),
+    m_isTriggerVolume(cinfo.isTriggerVolume),
+    m_rotation(cinfo.rotation),
+    m_linearVelocity(cinfo.linearVelocity),
+    m_angularVelocity(cinfo.angularVelocity),
+    m_inverseMass(0.0f),
+    m_localInverseInertia(0.0f),
+    m_isActive(false),
+    m_isTransformDirty(false),
+    m_sleepTime(0.0f),
+    m_contactListeners(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    m_positionChangedCallbacks(pAllocator != nullptr ? pAllocator : &g_stdAllocator)
+{
+    GEP_ASSERT(cinfo.shape, "Did not supply valid shape in RigidBodyCInfo!", cinfo.shape);
+
+    if(native::setCollisionShape(*cinfo.shape, m_hull, m_collisionShape) == FAILURE)
+    {
+        if(cinfo.shape->getShapeType() == ShapeType::ConvexVertices)
+            throw Exception("The native physics can't build a hull from these convex vertices (flat or more than 64 points)");
+        throw Exception(format("The native physics doesn't support shapes of type %d", (int)cinfo.shape->getShapeType()));
+    }
+
+    if(m_collisionShape.pHull != nullptr)
+    {
+        for(auto& vertex : m_hull.vertices)
+            m_boundingRadius = GEP_MAX(m_boundingRadius, vertex.length());
+    }
+    else
+        m_boundingRadius = m_collisionShape.radius;
+
+    m_transform.position = cinfo.position;
+    m_transform.rotation = m_rotation.toMat3();
+
+    m_collidable.setOwner(this);
+    m_collidable.setShape(m_shape.get());
+
+    updateMassProperties();
+    m_isActive = m_motionType != MotionType::Fixed;
+}
+
+gep::NativeRigidBody::~NativeRigidBody()
+{
+    GEP_ASSERT(m_pWorld == nullptr, "The rigid body is destroyed while it is still in a world");
+}
+
+bool gep::NativeRigidBody::isDynamic() const
+{
+    switch(m_motionType)
+    {
+    case MotionType::Dynamic:
+    case MotionType::SphereIntertia:
+    case MotionType::BoxInertia:
+    case MotionType::ThinBoxInertia:
+    case MotionType::Character:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void gep::NativeRigidBody::updateMassProperties()
+{
+    if(!isDynamic())
+    {
+        m_inverseMass = 0.0f;
+        m_localInverseInertia = vec3(0.0f);
+        return;
+    }
+
+    GEP_ASSERT(m_mass > 0.0f, "Dynamic rigid bodies need a positive mass", m_mass);
+    const float mass = m_mass > 0.0f ? m_mass : 1.0f;
+    m_inverseMass = 1.0f / mass;
+
+    // characters don't tip over
+    if(m_motionType == MotionType::Character)
+    {
+        m_localInverseInertia = vec3(0.0f);
+        return;
+    }
+    const vec3 inertia = native::computeInertia(m_collisionShape, mass);
+    m_localInverseInertia = vec3(inertia.x > 0.0f ? 1.0f / inertia.x : 0.0f,
+                                 inertia.y > 0.0f ? 1.0f / inertia.y : 0.0f,
+                                 inertia.z > 0.0f ? 1.0f / inertia.z : 0.0f);
+}
+
+gep::mat3 gep::NativeRigidBody::computeInverseInertia() const
+{
+    const mat3& rotation = m_transform.rotation;
+    return rotation * mat3::scaleMatrix(m_localInverseInertia) * rotation.transposed();
+}
+
+void gep::NativeRigidBody::setMass(float value)
+{
+    m_mass = value;
+    updateMassProperties();
+}
+
+void gep::NativeRigidBody::setMotionType(MotionType::Enum value)
+{
+    m_motionType = value;
+    updateMassProperties();
+    if(m_motionType == MotionType::Fixed)
+    {
+        m_linearVelocity = vec3(0.0f);
+        m_angularVelocity = vec3(0.0f);
+        m_isActive = false;
+    }
+    else
+        activate();
+}
+
+gep::uint32 gep::NativeRigidBody::getWorldIndex() const
+{
+    // bodies added during the callbacks of a step are simulated once the callbacks are done
+    return m_proxy != AabbTree::NULL_NODE ? m_index : INVALID_WORLD_INDEX;
+}
+
+void gep::NativeRigidBody::setPosition(const vec3& value)
+{
+    m_transform.position = value;
+    m_isTransformDirty = true;
+    if(m_proxy != AabbTree::NULL_NODE)
+        m_pWorld->updateTransform(*this);
+    if(m_motionType != MotionType::Fixed)
+        activate();
+}
+
+void gep::NativeRigidBody::setRotation(const Quaternion& value)
+{
+    m_rotation = value;
+    m_transform.rotation = m_rotation.toMat3();
+    m_isTransformDirty = true;
+    if(m_proxy != AabbTree::NULL_NODE)
+        m_pWorld->updateTransform(*this);
+    if(m_motionType != MotionType::Fixed)
+        activate();
+}
+
+void gep::NativeRigidBody::setLinearVelocity(const vec3& value)
+{
+    if(m_motionType == MotionType::Fixed)
+        return;
+    m_linearVelocity = value;
+    activate();
+}
+
+void gep::NativeRigidBody::setAngularVelocity(const vec3& value)
+{
+    if(m_motionType == MotionType::Fixed)
+        return;
+    m_angularVelocity = value;
+    activate();
+}
+
+void gep::NativeRigidBody::applyLinearImpulse(const vec3& impulse)
+{
+    if(m_inverseMass == 0.0f)
+        return;
+    m_linearVelocity += impulse * m_inverseMass;
+    activate();
+}
+
+void gep::NativeRigidBody::applyAngularImpulse(const vec3& impulse)
+{
+    if(m_inverseMass == 0.0f)
+        return;
+    m_angularVelocity += computeInverseInertia() * impulse;
+    activate();
+}
+
+void gep::NativeRigidBody::applyPointImpulse(const vec3& impulse, const vec3& point)
+{
+    if(m_inverseMass == 0.0f)
+        return;
+    m_linearVelocity += impulse * m_inverseMass;
+    m_angularVelocity += computeInverseInertia() * (point - m_transform.position).cross(impulse);
+    activate();
+}
+
+void gep::NativeRigidBody::activate()
+{
+    if(m_motionType == MotionType::Fixed)
+        return;
+    m_isActive = true;
+    m_sleepTime = 0.0f;
+}
+
+void gep::NativeRigidBody::requestDeactivation()
+{
+    m_isActive = false;
+}
+
+void gep::NativeRigidBody::addContactListener(IContactListener* listener)
+{
+    GEP_ASSERT(listener);
+    for(auto& pListener : m_contactListeners)
+    {
+        if(pListener == nullptr)
+        {
+            pListener = listener;
+            return;
+        }
+    }
+    m_contactListeners.append(listener);
+}
+
+void gep::NativeRigidBody::removeContactListener(IContactListener* listener)
+{
+    GEP_ASSERT(listener);
+    // only clear the slot, the listeners might currently be called
+    for(auto& pListener : m_contactListeners)
+    {
+        if(pListener == listener)
+        {
+            pListener = nullptr;
+            return;
+        }
+    }
+    GEP_ASSERT(false, "The listener was not registered");
+}
+
+void gep::NativeRigidBody::triggerContactPointCallbacks(const ContactPointArgs& args)
+{
+    for(size_t i = 0; i < m_contactListeners.length(); i++)
+    {
+        auto* pListener = m_contactListeners[i];
+        if(pListener)
+            pListener->contactPointCallback(args);
+    }
+}
+
+gep::CallbackId gep::NativeRigidBody::registerSimulationCallback(PositionChangedCallback callback)
+{
+    GEP_ASSERT(callback);
+    for(size_t i=0; i < m_positionChangedCallbacks.length(); ++i)
+    {
+        if(!m_positionChangedCallbacks[i])
+        {
+            m_positionChangedCallbacks[i] = callback;
+            return CallbackId(i);
+        }
+    }
+    m_positionChangedCallbacks.append(callback);
+    return gep::CallbackId(m_positionChangedCallbacks.length() - 1);
+}
+
+void gep::NativeRigidBody::deregisterSimulationCallback(CallbackId id)
+{
+    GEP_ASSERT(id.id < m_positionChangedCallbacks.length(), "callback id out of bounds");
+    GEP_ASSERT(m_positionChangedCallbacks[id.id], "callback was already deregistered");
+    m_positionChangedCallbacks[id.id] = nullptr;
+}
+
+void gep::NativeRigidBody::triggerSimulationCallbacks() const
+{
+    for (auto& callback : m_positionChangedCallbacks)
+    {
+        if (callback)
+            callback(this);
+    }
+}
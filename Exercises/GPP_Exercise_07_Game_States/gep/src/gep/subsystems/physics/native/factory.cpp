@@ -0,0 +1,64 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/factory.h"
+#include "gep/memory/allocator.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+
+gep::NativePhysicsFactory::NativePhysicsFactory(IAllocator* allocator, TaskQueue* pTaskQueue) :
+    m_pAllocator(allocator),
+    m_pTaskQueue(pTaskQueue)
+{
+    GEP_ASSERT(m_pAllocator, "Allocator cannot be nullptr!");
+}
+
+gep::NativePhysicsFactory::~NativePhysicsFactory()
+{
+}
+
+void gep::NativePhysicsFactory::initialize()
+{
+}
+
+void gep::NativePhysicsFactory::destroy()
+{
+}
+
+gep::IAllocator* gep::NativePhysicsFactory::getAllocator()
+{
+    return m_pAllocator;
+}
+
+void gep::NativePhysicsFactory::setAllocator(IAllocator* allocator)
+{
+    m_pAllocator = allocator;
+}
+
+gep::IWorld* gep::NativePhysicsFactory::createWorld(const WorldCInfo& cinfo) const
+{
+    GEP_ASSERT(m_pAllocator, "Allocator cannot be nullptr!");
+    return GEP_NEW(m_pAllocator, NativeWorld)(cinfo, m_pTaskQueue, m_pAllocator);
+}
+
+gep::IRigidBody* gep::NativePhysicsFactory::createRigidBody(const RigidBodyCInfo& cinfo) const
+{
+    GEP_ASSERT(m_pAllocator, "Allocator cannot be nullptr!");
+    NativeRigidBody* rb = GEP_NEW(m_pAllocator, NativeRigidBody)(cinfo, m_pAllocator);
+    rb->initialize();
+    return rb;
+}
+
+gep::ICharacterRigidBody* gep::NativePhysicsFactory::createCharacterRigidBody(const CharacterRigidBodyCInfo& cinfo) const
+{
+    GEP_UNUSED(cinfo);
+    throw Exception("The native physics has no character controller, use a dynamic rigid body instead");
+}
+
+gep::ResourcePtr<gep::ICollisionMesh> gep::NativePhysicsFactory::loadCollisionMesh(const char* path)
+{
+    throw Exception(format("The native physics can't load the collision mesh '%s', only the havok physics can", path));
+}
+
+gep::IShape* gep::NativePhysicsFactory::loadCollisionMeshFromLua(const char* path)
+{
+    return loadCollisionMesh(path).get()->getShape();
+}
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/manager.h"
+
+#include "gep/globalManager.h"
+#include "gep/interfaces/memoryManager.h"
+#include "gep/interfaces/renderer.h"
+
+gep::NativePhysicsManager::NativePhysicsManager() :
+    m_pFactory(nullptr),
+    m_pWorld(nullptr),
+    m_isDebugDrawingEnabled(false)
+{
+}
+
+gep::NativePhysicsManager::~NativePhysicsManager()
+{
+}
+
+void gep::NativePhysicsManager::initialize()
+{
+    m_pFactory = new NativePhysicsFactory(g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Physics),
+                                          g_globalManager.getTaskQueue());
+    m_pFactory->initialize();
+}
+
+void gep::NativePhysicsManager::destroy()
+{
+    m_pWorld = nullptr;
+    m_pFactory->destroy();
+    DELETE_AND_NULL(m_pFactory);
+}
+
+void gep::NativePhysicsManager::update(float elapsedTime)
+{
+    GEP_ASSERT(m_pWorld, "The physics system cannot be updated without a world!");
+    m_pWorld->update(elapsedTime);
+
+    if(m_isDebugDrawingEnabled)
+        m_pWorld->debugDraw(g_globalManager.getRenderer()->getDebugRenderer());
+}
+
+void gep::NativePhysicsManager::setWorld(IWorld* value)
+{
+    GEP_ASSERT(!m_pWorld, "The physics system does currently not support setting the active world a second time!");
+    GEP_ASSERT(dynamic_cast<NativeWorld*>(value) != nullptr, "Wrong kind of world instance for this kind of physics system!");
+    m_pWorld = static_cast<NativeWorld*>(value);
+}
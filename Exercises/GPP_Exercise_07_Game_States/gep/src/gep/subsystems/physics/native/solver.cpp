@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/solver.h"
+
+namespace
+{
+    using namespace gep;
+    using namespace gep::native;
+
+    /// the velocity of b relative to a along one row of a contact point
+    inline float getRelativeVelocity(const SolverBody& a, const SolverBody& b, const ContactConstraintPoint& point,
+                                     const vec3& direction, int row)
+    {
+        return (b.linearVelocity - a.linearVelocity).dot(direction)
+            + b.angularVelocity.dot(point.angularB[row])
+            - a.angularVelocity.dot(point.angularA[row]);
+    }
+
+    /// bodies with infinite mass are never written, so islands sharing them can be solved in parallel
+    inline void applyImpulse(SolverBody& a, SolverBody& b, const ContactConstraintPoint& point,
+                             const vec3& direction, int row, float impulse)
+    {
+        if(a.inverseMass != 0.0f)
+        {
+            a.linearVelocity -= direction * (impulse * a.inverseMass);
+            a.angularVelocity -= point.inertiaAngularA[row] * impulse;
+        }
+        if(b.inverseMass != 0.0f)
+        {
+            b.linearVelocity += direction * (impulse * b.inverseMass);
+            b.angularVelocity += point.inertiaAngularB[row] * impulse;
+        }
+    }
+
+    inline float prepareRow(const SolverBody& a, const SolverBody& b, ContactConstraintPoint& point, const vec3& direction, int row)
+    {
+        point.angularA[row] = point.anchorA.cross(direction);
+        point.angularB[row] = point.anchorB.cross(direction);
+        point.inertiaAngularA[row] = a.inverseInertia * point.angularA[row];
+        point.inertiaAngularB[row] = b.inverseInertia * point.angularB[row];
+        const float k = a.inverseMass + b.inverseMass
+            + point.angularA[row].dot(point.inertiaAngularA[row])
+            + point.angularB[row].dot(point.inertiaAngularB[row]);
+        return k > 0.0f ? 1.0f / k : 0.0f;
+    }
+
+    inline void computeTangents(const vec3& normal, vec3& tangent0, vec3& tangent1)
+    {
+        // pick the axis which is the least parallel to the normal
+        if(normal.x >= 0.57735f || normal.x <= -0.57735f)
+            tangent0 = vec3(normal.y, -normal.x, 0.0f).normalized();
+        else
+            tangent0 = vec3(0.0f, normal.z, -normal.y).normalized();
+        tangent1 = normal.cross(tangent0);
+    }
+
+    void prepare(ContactConstraint& constraint, SolverBody* bodies, float inverseDeltaSeconds, const SolverSettings& settings)
+    {
+        const SolverBody& a = bodies[constraint.bodyA];
+        const SolverBody& b = bodies[constraint.bodyB];
+        computeTangents(constraint.normal, constraint.tangents[0], constraint.tangents[1]);
+
+        for(uint32 i = 0; i < constraint.numPoints; i++)
+        {
+            auto& point = constraint.points[i];
+            point.normalMass = prepareRow(a, b, point, constraint.normal, 0);
+            point.tangentMass[0] = prepareRow(a, b, point, constraint.tangents[0], 1);
+            point.tangentMass[1] = prepareRow(a, b, point, constraint.tangents[1], 2);
+            point.relativeVelocity = getRelativeVelocity(a, b, point, constraint.normal, 0);
+            point.maxNormalImpulse = 0.0f;
+
+            if(point.separation > 0.0f)
+            {
+                // speculative, the bodies may approach until they touch at the end of the step
+                point.velocityBias = -point.separation * inverseDeltaSeconds;
+            }
+            else
+            {
+                const float penetration = GEP_MIN(point.separation + settings.linearSlop, 0.0f);
+                point.velocityBias = -settings.baumgarte * inverseDeltaSeconds * penetration;
+            }
+        }
+    }
+
+    void warmStart(ContactConstraint& constraint, SolverBody* bodies)
+    {
+        SolverBody& a = bodies[constraint.bodyA];
+        SolverBody& b = bodies[constraint.bodyB];
+        for(uint32 i = 0; i < constraint.numPoints; i++)
+        {
+            const auto& point = constraint.points[i];
+            applyImpulse(a, b, point, constraint.normal, 0, point.normalImpulse);
+            applyImpulse(a, b, point, constraint.tangents[0], 1, point.tangentImpulse[0]);
+            applyImpulse(a, b, point, constraint.tangents[1], 2, point.tangentImpulse[1]);
+        }
+    }
+
+    void solve(ContactConstraint& constraint, SolverBody* bodies)
+    {
+        SolverBody& a = bodies[constraint.bodyA];
+        SolverBody& b = bodies[constraint.bodyB];
+
+        // friction first, the non penetration constraint is more important and comes last
+        for(uint32 i = 0; i < constraint.numPoints; i++)
+        {
+            auto& point = constraint.points[i];
+            const float maxFriction = constraint.friction * point.normalImpulse;
+            for(int t = 0; t < 2; t++)
+            {
+                const vec3& tangent = constraint.tangents[t];
+                const float lambda = -point.tangentMass[t] * getRelativeVelocity(a, b, point, tangent, t + 1);
+                const float oldImpulse = point.tangentImpulse[t];
+                point.tangentImpulse[t] = GEP_MAX(-maxFriction, GEP_MIN(oldImpulse + lambda, maxFriction));
+                applyImpulse(a, b, point, tangent, t + 1, point.tangentImpulse[t] - oldImpulse);
+            }
+        }
+
+        for(uint32 i = 0; i < constraint.numPoints; i++)
+        {
+            auto& point = constraint.points[i];
+            const float normalVelocity = getRelativeVelocity(a, b, point, constraint.normal, 0);
+            const float lambda = -point.normalMass * (normalVelocity - point.velocityBias);
+            const float oldImpulse = point.normalImpulse;
+            point.normalImpulse = GEP_MAX(oldImpulse + lambda, 0.0f);
+            point.maxNormalImpulse = GEP_MAX(point.maxNormalImpulse, point.normalImpulse);
+            applyImpulse(a, b, point, constraint.normal, 0, point.normalImpulse - oldImpulse);
+        }
+    }
+
+    /// done after solving, so speculative contacts don't bounce before the bodies actually touch
+    void applyRestitution(ContactConstraint& constraint, SolverBody* bodies, const SolverSettings& settings)
+    {
+        if(constraint.restitution == 0.0f)
+            return;
+        SolverBody& a = bodies[constraint.bodyA];
+        SolverBody& b = bodies[constraint.bodyB];
+        for(uint32 i = 0; i < constraint.numPoints; i++)
+        {
+            auto& point = constraint.points[i];
+            if(point.relativeVelocity > -settings.restitutionThreshold || point.maxNormalImpulse == 0.0f)
+                continue;
+            const float normalVelocity = getRelativeVelocity(a, b, point, constraint.normal, 0);
+            const float lambda = -point.normalMass * (normalVelocity + constraint.restitution * point.relativeVelocity);
+            const float oldImpulse = point.normalImpulse;
+            point.normalImpulse = GEP_MAX(oldImpulse + lambda, 0.0f);
+            applyImpulse(a, b, point, constraint.normal, 0, point.normalImpulse - oldImpulse);
+        }
+    }
+}
+
+void gep::native::solveContacts(ArrayPtr<ContactConstraint> constraints, SolverBody* bodies,
+                                float deltaSeconds, const SolverSettings& settings)
+{
+    const float inverseDeltaSeconds = 1.0f / deltaSeconds;
+    for(auto& constraint : constraints)
+    {
+        prepare(constraint, bodies, inverseDeltaSeconds, settings);
+        warmStart(constraint, bodies);
+    }
+    for(uint32 iteration = 0; iteration < settings.velocityIterations; iteration++)
+    {
+        for(auto& constraint : constraints)
+            solve(constraint, bodies);
+    }
+    for(auto& constraint : constraints)
+        applyRestitution(constraint, bodies, settings);
+}
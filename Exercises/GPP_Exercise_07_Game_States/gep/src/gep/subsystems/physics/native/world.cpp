@@ -0,0 +1,925 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/physics/native/world.h"
+
+#include "gep/interfaces/physics/characterController.h"
+#include "gep/interfaces/renderer.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    using namespace gep;
+
+    const float STEP_SECONDS = 1.0f / 60.0f;
+    /// islands which rested this long go to sleep
+    const float TIME_TO_SLEEP = 0.5f;
+    /// fraction of the penetration resolved per step
+    const float BAUMGARTE = 0.2f;
+    const uint32 NO_ISLAND = 0xffffffff;
+
+    /// dynamic bodies come first in a contact, then keyframed and fixed ones
+    inline int getMotionRank(const NativeRigidBody* pBody)
+    {
+        if(pBody->isDynamic())
+            return 0;
+        return pBody->getMotionType() == MotionType::Keyframed ? 1 : 2;
+    }
+
+    inline vec3 clampLength(const vec3& v, float maxLength)
+    {
+        const float squaredLength = v.squaredLength();
+        if(squaredLength > maxLength * maxLength)
+            return v * (maxLength / gep::sqrt(squaredLength));
+        return v;
+    }
+
+    inline void runParallel(TaskQueue* pTaskQueue, size_t count, size_t minChunkSize, const std::function<void(size_t start, size_t end)>& work)
+    {
+        if(count == 0)
+            return;
+        if(pTaskQueue != nullptr)
+            pTaskQueue->runParallel(count, minChunkSize, work);
+        else
+            work(0, count);
+    }
+}
+
+gep::NativeWorld::NativeWorld(const WorldCInfo& cinfo, TaskQueue* pTaskQueue, IAllocator* pAllocator) :
+    m_pAllocator(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    m_pTaskQueue(pTaskQueue),
+    m_gravity(cinfo.gravity),
+    m_linearSlop(cinfo.worldSize * 0.0001f),
+    m_sleepLinearVelocity(cinfo.worldSize * 0.0005f),
+    m_sleepAngularVelocity(0.05f),
+    m_accumulatedSeconds(0.0f),
+    m_nextBodyId(0),
+    m_broadphase(cinfo.worldSize * 0.001f, m_pAllocator),
+    m_bodies(m_pAllocator),
+    m_characters(m_pAllocator),
+    m_pairMutex(),
+    m_pairs(m_pAllocator),
+    m_contacts(m_pAllocator),
+    m_previousContacts(m_pAllocator),
+    m_solverBodies(m_pAllocator),
+    m_constraints(m_pAllocator),
+    m_constraintContacts(m_pAllocator),
+    m_islands(m_pAllocator),
+    m_islandParents(m_pAllocator),
+    m_islandIndices(m_pAllocator),
+    m_islandSleepTimes(m_pAllocator),
+    m_isLocked(false),
+    m_pendingOperations(m_pAllocator),
+    m_event_contactPoint(Event<ContactPointArgs*>::CInfo(m_pAllocator))
+{
+    m_bodies.reserve(64);
+    m_transforms.reserve(64);
+}
+
+gep::NativeWorld::~NativeWorld()
+{
+    GEP_ASSERT(!m_isLocked, "The world is destroyed from inside its callbacks");
+    for(auto& pBody : m_bodies)
+    {
+        pBody->m_pWorld = nullptr;
+        pBody->m_proxy = AabbTree::NULL_NODE;
+    }
+    for(auto& operation : m_pendingOperations)
+    {
+        if(operation.pBody->m_pWorld == this)
+            operation.pBody->m_pWorld = nullptr;
+    }
+}
+
+void gep::NativeWorld::addEntity(IPhysicsEntity* entity)
+{
+    auto* pBody = dynamic_cast<NativeRigidBody*>(entity);
+    GEP_ASSERT(pBody != nullptr, "Attempted to add wrong kind of entity. (only native rigid bodies are supported)");
+    GEP_ASSERT(pBody->m_pWorld == nullptr, "The rigid body is already in a world");
+    pBody->m_pWorld = this;
+
+    if(m_isLocked)
+    {
+        PendingOperation operation;
+        operation.pBody = pBody;
+        operation.isAdd = true;
+        m_pendingOperations.append(operation);
+        return;
+    }
+    addBody(pBody);
+}
+
+void gep::NativeWorld::removeEntity(IPhysicsEntity* entity)
+{
+    GEP_ASSERT(entity != nullptr, "Attempt to remove nullptr.");
+    auto* pBody = dynamic_cast<NativeRigidBody*>(entity);
+    GEP_ASSERT(pBody != nullptr, "Attempt to remove wrong kind of entity. (only native rigid bodies are supported)");
+    GEP_ASSERT(pBody->m_pWorld == this, "Attempt to remove an entity which is not in this world");
+    pBody->m_pWorld = nullptr;
+
+    if(m_isLocked)
+    {
+        PendingOperation operation;
+        operation.pBody = pBody;
+        operation.isAdd = false;
+        m_pendingOperations.append(operation);
+        return;
+    }
+    removeBody(pBody);
+}
+
+void gep::NativeWorld::addBody(NativeRigidBody* pBody)
+{
+    GEP_ASSERT(pBody->m_proxy == AabbTree::NULL_NODE, "The rigid body is already simulated");
+    pBody->m_index = static_cast<uint32>(m_bodies.length());
+    pBody->m_id = m_nextBodyId++;
+    m_bodies.append(pBody);
+    RigidBodyTransform transform = { pBody->m_transform.position, pBody->m_rotation };
+    m_transforms.append(transform);
+
+    vec3 min, max;
+    native::computeBounds(pBody->m_collisionShape, pBody->m_transform, min, max);
+    pBody->m_proxy = m_broadphase.insert(min, max, pBody);
+    pBody->m_isTransformDirty = false;
+    pBody->activate();
+}
+
+void gep::NativeWorld::removeBody(NativeRigidBody* pBody)
+{
+    GEP_ASSERT(pBody->m_proxy != AabbTree::NULL_NODE, "The rigid body is not simulated");
+    SmartPtr<NativeRigidBody> pKeepAlive(pBody);
+
+    m_broadphase.remove(pBody->m_proxy);
+    pBody->m_proxy = AabbTree::NULL_NODE;
+
+    // the contacts point to the body
+    size_t numContacts = 0;
+    for(size_t i = 0; i < m_contacts.length(); i++)
+    {
+        if(m_contacts[i].pBodyA != pBody && m_contacts[i].pBodyB != pBody)
+            m_contacts[numContacts++] = m_contacts[i];
+    }
+    m_contacts.resize(numContacts);
+
+    const uint32 index = pBody->m_index;
+    GEP_ASSERT(m_bodies[index].get() == pBody, "The index of the rigid body is broken", index);
+    m_bodies.removeAtIndexUnordered(index);
+    m_transforms.removeAtIndexUnordered(index);
+    if(index < m_bodies.length())
+        m_bodies[index]->m_index = index;
+}
+
+void gep::NativeWorld::flushPendingOperations()
+{
+    for(auto& operation : m_pendingOperations)
+    {
+        if(operation.isAdd)
+            addBody(operation.pBody.get());
+        else
+            removeBody(operation.pBody.get());
+    }
+    m_pendingOperations.clear();
+}
+
+void gep::NativeWorld::addCharacter(ICharacterRigidBody* character)
+{
+    addEntity(character->getRigidBody());
+    m_characters.append(character);
+}
+
+void gep::NativeWorld::removeCharacter(ICharacterRigidBody* character)
+{
+    GEP_ASSERT(character != nullptr);
+
+    size_t index;
+    for (index = 0; index < m_characters.length(); ++index)
+    {
+        if (m_characters[index].get() == character)
+            break;
+    }
+    GEP_ASSERT(index < m_characters.length(), "Attempt to remove character from world that does not exist there", character, index, m_characters.length());
+    m_characters.removeAtIndex(index);
+
+    removeEntity(character->getRigidBody());
+}
+
+void gep::NativeWorld::castRay(const RayCastInput& input, RayCastOutput& output) const
+{
+    castRays(ArrayPtr<const RayCastInput>(&input, 1), ArrayPtr<RayCastOutput>(&output, 1));
+}
+
+void gep::NativeWorld::castRays(ArrayPtr<const RayCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every ray needs an output", inputs.length(), outputs.length());
+    DynamicArray<vec3> directions(m_pAllocator);
+    directions.resize(inputs.length());
+    for(size_t i = 0; i < inputs.length(); i++)
+    {
+        directions[i] = inputs[i].to - inputs[i].from;
+        outputs[i].hitFraction = 1.0f;
+        outputs[i].hitEntity = nullptr;
+    }
+
+    // the hit fraction clips the ray, so boxes behind the closest hit so far are skipped
+    auto nodeTest = [&](uint32 ray, const vec3& min, const vec3& max) -> bool
+    {
+        return AabbTree::intersectsRay(min, max, inputs[ray].from, directions[ray], outputs[ray].hitFraction);
+    };
+    auto callback = [&](uint32 ray, uint32 proxy)
+    {
+        auto* pBody = static_cast<const NativeRigidBody*>(m_broadphase.getUserData(proxy));
+        float fraction;
+        if(native::castRay(pBody->m_collisionShape, pBody->m_transform, inputs[ray].from, inputs[ray].to,
+                           outputs[ray].hitFraction, fraction))
+        {
+            outputs[ray].hitFraction = fraction;
+            outputs[ray].hitEntity = &pBody->m_collidable;
+        }
+    };
+    DynamicArray<uint32> queries(m_pAllocator);
+    m_broadphase.queryBatch(uint32(inputs.length()), nodeTest, callback, queries);
+}
+
+void gep::NativeWorld::castShapes(ArrayPtr<const ShapeCastInput> inputs, ArrayPtr<RayCastOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every shape cast needs an output", inputs.length(), outputs.length());
+    QueryShapes shapes(m_pAllocator);
+    DynamicArray<native::CollisionShape> collisionShapes(m_pAllocator);
+    DynamicArray<mat3> rotations(m_pAllocator);
+    DynamicArray<vec3> sweptMins(m_pAllocator);
+    DynamicArray<vec3> sweptMaxs(m_pAllocator);
+    for(size_t i = 0; i < inputs.length(); i++)
+    {
+        const auto& input = inputs[i];
+        GEP_ASSERT(input.shape, "Did not supply a valid shape in ShapeCastInput!", i);
+        collisionShapes.append(shapes.get(input.shape));
+        rotations.append(input.rotation.toMat3());
+
+        // the box around the start and the end contains the whole sweep
+        const native::Transform start = { input.from, rotations[i] };
+        const native::Transform end = { input.to, rotations[i] };
+        vec3 min, max, endMin, endMax;
+        native::computeBounds(collisionShapes[i], start, min, max);
+        native::computeBounds(collisionShapes[i], end, endMin, endMax);
+        sweptMins.append(vec3(GEP_MIN(min.x, endMin.x), GEP_MIN(min.y, endMin.y), GEP_MIN(min.z, endMin.z)));
+        sweptMaxs.append(vec3(GEP_MAX(max.x, endMax.x), GEP_MAX(max.y, endMax.y), GEP_MAX(max.z, endMax.z)));
+
+        outputs[i].hitFraction = 1.0f;
+        outputs[i].hitEntity = nullptr;
+    }
+
+    auto nodeTest = [&](uint32 query, const vec3& min, const vec3& max) -> bool
+    {
+        return AabbTree::overlaps(min, max, sweptMins[query], sweptMaxs[query]);
+    };
+    auto callback = [&](uint32 query, uint32 proxy)
+    {
+        auto* pBody = static_cast<const NativeRigidBody*>(m_broadphase.getUserData(proxy));
+        float fraction;
+        if(native::castShape(collisionShapes[query], rotations[query], inputs[query].from, inputs[query].to,
+                             pBody->m_collisionShape, pBody->m_transform, outputs[query].hitFraction, m_linearSlop, fraction))
+        {
+            outputs[query].hitFraction = fraction;
+            outputs[query].hitEntity = &pBody->m_collidable;
+        }
+    };
+    DynamicArray<uint32> queries(m_pAllocator);
+    m_broadphase.queryBatch(uint32(inputs.length()), nodeTest, callback, queries);
+}
+
+void gep::NativeWorld::overlapShapes(ArrayPtr<const OverlapInput> inputs, ArrayPtr<OverlapOutput> outputs) const
+{
+    GEP_ASSERT(inputs.length() == outputs.length(), "Every overlap query needs an output", inputs.length(), outputs.length());
+    QueryShapes shapes(m_pAllocator);
+    DynamicArray<native::CollisionShape> collisionShapes(m_pAllocator);
+    DynamicArray<native::Transform> transforms(m_pAllocator);
+    DynamicArray<vec3> mins(m_pAllocator);
+    DynamicArray<vec3> maxs(m_pAllocator);
+    for(size_t i = 0; i < inputs.length(); i++)
+    {
+        const auto& input = inputs[i];
+        GEP_ASSERT(input.shape, "Did not supply a valid shape in OverlapInput!", i);
+        const native::Transform transform = { input.position, input.rotation.toMat3() };
+        collisionShapes.append(shapes.get(input.shape));
+        transforms.append(transform);
+        vec3 min, max;
+        native::computeBounds(collisionShapes[i], transform, min, max);
+        mins.append(min);
+        maxs.append(max);
+        outputs[i].numHits = 0;
+    }
+
+    auto nodeTest = [&](uint32 query, const vec3& min, const vec3& max) -> bool
+    {
+        return AabbTree::overlaps(min, max, mins[query], maxs[query]);
+    };
+    auto callback = [&](uint32 query, uint32 proxy)
+    {
+        auto* pBody = static_cast<const NativeRigidBody*>(m_broadphase.getUserData(proxy));
+        native::Manifold manifold;
+        if(!native::collide(collisionShapes[query], transforms[query], pBody->m_collisionShape, pBody->m_transform,
+                            0.0f, m_linearSlop, manifold))
+            return;
+        auto& output = outputs[query];
+        if(output.numHits < output.hits.length())
+            output.hits[output.numHits] = &pBody->m_collidable;
+        output.numHits++;
+    };
+    DynamicArray<uint32> queries(m_pAllocator);
+    m_broadphase.queryBatch(uint32(inputs.length()), nodeTest, callback, queries);
+}
+
+gep::NativeWorld::QueryShapes::QueryShapes(IAllocator* pAllocator) :
+    m_pAllocator(pAllocator),
+    m_shapes(pAllocator),
+    m_hulls(pAllocator),
+    m_collisionShapes(pAllocator)
+{
+}
+
+gep::NativeWorld::QueryShapes::~QueryShapes()
+{
+    for(auto pHull : m_hulls)
+        GEP_DELETE(m_pAllocator, pHull);
+}
+
+gep::native::CollisionShape gep::NativeWorld::QueryShapes::get(IShape* pShape)
+{
+    for(size_t i = 0; i < m_shapes.length(); i++)
+    {
+        if(m_shapes[i] == pShape)
+            return m_collisionShapes[i];
+    }
+
+    native::Hull* pHull = GEP_NEW(m_pAllocator, native::Hull)(m_pAllocator);
+    native::CollisionShape collisionShape;
+    if(native::setCollisionShape(*pShape, *pHull, collisionShape) == FAILURE)
+    {
+        GEP_DELETE(m_pAllocator, pHull);
+        throw Exception(format("The native physics can't query shapes of type %d", (int)pShape->getShapeType()));
+    }
+    m_shapes.append(pShape);
+    m_hulls.append(pHull);
+    m_collisionShapes.append(collisionShape);
+    return collisionShape;
+}
+
+void gep::NativeWorld::update(float elapsedMilliseconds)
+{
+    // drop the time which can't be caught up, instead of spiraling into more and more steps per frame
+    m_accumulatedSeconds = GEP_MIN(m_accumulatedSeconds + elapsedMilliseconds / 1000.0f, MAX_SUB_STEPS * STEP_SECONDS);
+    while(m_accumulatedSeconds >= STEP_SECONDS)
+    {
+        step(STEP_SECONDS);
+        m_accumulatedSeconds -= STEP_SECONDS;
+    }
+}
+
+void gep::NativeWorld::step(float deltaSeconds)
+{
+    GEP_ASSERT(!m_isLocked, "The world can't be stepped from inside its callbacks");
+    if(deltaSeconds <= 0.0f)
+        return;
+
+    integrateVelocities(deltaSeconds);
+    updateBroadphase(deltaSeconds);
+    findPairs();
+    updateContacts();
+    collide(deltaSeconds);
+    wakeTouchingBodies();
+    buildIslands();
+    solveIslands(deltaSeconds);
+    integratePositions(deltaSeconds);
+
+    m_isLocked = true;
+    triggerCallbacks();
+    updateSleeping(deltaSeconds);
+    m_isLocked = false;
+
+    flushPendingOperations();
+}
+
+void gep::NativeWorld::integrateVelocities(float deltaSeconds)
+{
+    for(auto& pBody : m_bodies)
+    {
+        NativeRigidBody& body = *pBody;
+        if(!body.m_isActive || !body.isDynamic())
+            continue;
+        body.m_linearVelocity += m_gravity * (body.m_gravityFactor * deltaSeconds);
+        body.m_linearVelocity *= 1.0f / (1.0f + deltaSeconds * body.m_linearDamping);
+        body.m_angularVelocity *= 1.0f / (1.0f + deltaSeconds * body.m_angularDamping);
+    }
+}
+
+void gep::NativeWorld::updateBroadphase(float deltaSeconds)
+{
+    for(auto& pBody : m_bodies)
+    {
+        NativeRigidBody& body = *pBody;
+        if(!body.m_isTransformDirty && !isQuerying(&body))
+            continue;
+        vec3 min, max;
+        native::computeBounds(body.m_collisionShape, body.m_transform, min, max);
+        m_broadphase.update(body.m_proxy, min, max, body.m_linearVelocity * deltaSeconds);
+        body.m_isTransformDirty = false;
+    }
+}
+
+bool gep::NativeWorld::isQuerying(const NativeRigidBody* pBody) const
+{
+    return pBody->m_isActive && pBody->m_motionType != MotionType::Fixed;
+}
+
+void gep::NativeWorld::findPairs()
+{
+    m_pairs.clear();
+    const size_t numBodies = m_bodies.length();
+    const size_t numBatches = (numBodies + PAIR_BATCH_SIZE - 1) / PAIR_BATCH_SIZE;
+
+    runParallel(m_pTaskQueue, numBatches, 1, [&](size_t startBatch, size_t endBatch)
+    {
+        // collect the pairs locally and only lock to hand them over
+        const size_t BUFFER_SIZE = 256;
+        Pair buffer[BUFFER_SIZE];
+        size_t numBuffered = 0;
+        auto flush = [&]()
+        {
+            ScopedLock<Mutex> lock(m_pairMutex);
+            m_pairs.append(ArrayPtr<Pair>(buffer, numBuffered));
+            numBuffered = 0;
+        };
+
+        const size_t end = GEP_MIN(endBatch * PAIR_BATCH_SIZE, numBodies);
+        for(size_t i = startBatch * PAIR_BATCH_SIZE; i < end; i++)
+        {
+            NativeRigidBody* pBody = m_bodies[i].get();
+            if(!isQuerying(pBody))
+                continue;
+
+            auto callback = [&](uint32 proxy) -> bool
+            {
+                auto* pOther = static_cast<NativeRigidBody*>(m_broadphase.getUserData(proxy));
+                if(pOther == pBody)
+                    return true;
+                // pairs of two querying bodies are reported by the one with the lower index
+                if(isQuerying(pOther) && pOther->m_index < pBody->m_index)
+                    return true;
+                if(!pBody->isDynamic() && !pOther->isDynamic())
+                    return true;
+
+                Pair& pair = buffer[numBuffered++];
+                const int rank = getMotionRank(pBody);
+                const int otherRank = getMotionRank(pOther);
+                if(rank < otherRank || (rank == otherRank && pBody->m_id < pOther->m_id))
+                {
+                    pair.pBodyA = pBody;
+                    pair.pBodyB = pOther;
+                }
+                else
+                {
+                    pair.pBodyA = pOther;
+                    pair.pBodyB = pBody;
+                }
+                pair.key = (static_cast<uint64>(pair.pBodyA->m_id) << 32) | pair.pBodyB->m_id;
+                if(numBuffered == BUFFER_SIZE)
+                    flush();
+                return true;
+            };
+            m_broadphase.query(m_broadphase.getFatMin(pBody->m_proxy), m_broadphase.getFatMax(pBody->m_proxy), callback);
+        }
+        if(numBuffered > 0)
+            flush();
+    });
+
+    // the order of the batches is random, sorting makes the contacts deterministic again
+    std::sort(m_pairs.begin(), m_pairs.end(), [](const Pair& lhs, const Pair& rhs){ return lhs.key < rhs.key; });
+}
+
+void gep::NativeWorld::updateContacts()
+{
+    std::swap(m_contacts, m_previousContacts);
+    m_contacts.clear();
+    m_contacts.reserve(m_pairs.length());
+
+    size_t previous = 0;
+    for(size_t i = 0; i < m_pairs.length(); i++)
+    {
+        const Pair& pair = m_pairs[i];
+        if(i > 0 && m_pairs[i - 1].key == pair.key)
+            continue;
+
+        while(previous < m_previousContacts.length() && m_previousContacts[previous].key < pair.key)
+            previous++;
+        if(previous < m_previousContacts.length() && m_previousContacts[previous].key == pair.key)
+        {
+            m_contacts.append(m_previousContacts[previous]);
+            continue;
+        }
+
+        Contact contact;
+        contact.key = pair.key;
+        contact.pBodyA = pair.pBodyA;
+        contact.pBodyB = pair.pBodyB;
+        contact.manifold.numPoints = 0;
+        contact.callbackCounter = 0;
+        contact.hasNewPoint = false;
+        m_contacts.append(contact);
+    }
+}
+
+void gep::NativeWorld::collide(float deltaSeconds)
+{
+    runParallel(m_pTaskQueue, m_contacts.length(), 32, [&](size_t start, size_t end)
+    {
+        const float matchDistanceSquared = (5.0f * m_linearSlop) * (5.0f * m_linearSlop);
+        for(size_t i = start; i < end; i++)
+        {
+            Contact& contact = m_contacts[i];
+            const NativeRigidBody& a = *contact.pBodyA;
+            const NativeRigidBody& b = *contact.pBodyB;
+
+            const Contact previous = contact;
+            contact.hasNewPoint = false;
+
+            // how close the bodies can get within this step
+            const float margin = m_linearSlop + deltaSeconds *
+                (a.m_linearVelocity.length() + a.m_angularVelocity.length() * a.m_boundingRadius +
+                 b.m_linearVelocity.length() + b.m_angularVelocity.length() * b.m_boundingRadius);
+            if(!native::collide(a.m_collisionShape, a.m_transform, b.m_collisionShape, b.m_transform,
+                                margin, m_linearSlop, contact.manifold))
+            {
+                contact.manifold.numPoints = 0;
+                continue;
+            }
+
+            for(uint32 p = 0; p < contact.manifold.numPoints; p++)
+            {
+                const vec3 localPoint = a.m_transform.toLocal(contact.manifold.points[p].position);
+                const bool isTouching = contact.manifold.points[p].separation <= m_linearSlop;
+                contact.localPoints[p] = localPoint;
+                contact.normalImpulses[p] = 0.0f;
+                contact.tangentImpulses[p][0] = 0.0f;
+                contact.tangentImpulses[p][1] = 0.0f;
+
+                bool wasTouching = false;
+                for(uint32 q = 0; q < previous.manifold.numPoints; q++)
+                {
+                    if((previous.localPoints[q] - localPoint).squaredLength() > matchDistanceSquared)
+                        continue;
+                    contact.normalImpulses[p] = previous.normalImpulses[q];
+                    contact.tangentImpulses[p][0] = previous.tangentImpulses[q][0];
+                    contact.tangentImpulses[p][1] = previous.tangentImpulses[q][1];
+                    wasTouching = previous.manifold.points[q].separation <= m_linearSlop;
+                    break;
+                }
+                if(isTouching && !wasTouching)
+                    contact.hasNewPoint = true;
+            }
+        }
+    });
+}
+
+void gep::NativeWorld::wakeTouchingBodies()
+{
+    for(auto& contact : m_contacts)
+    {
+        if(contact.manifold.numPoints == 0)
+            continue;
+        NativeRigidBody& a = *contact.pBodyA;
+        NativeRigidBody& b = *contact.pBodyB;
+        if(a.isDynamic() && !a.m_isActive && b.m_isActive)
+            a.activate();
+        else if(b.isDynamic() && !b.m_isActive && a.m_isActive)
+            b.activate();
+    }
+}
+
+gep::uint32 gep::NativeWorld::findIslandRoot(uint32 index)
+{
+    while(m_islandParents[index] != index)
+    {
+        m_islandParents[index] = m_islandParents[m_islandParents[index]];
+        index = m_islandParents[index];
+    }
+    return index;
+}
+
+void gep::NativeWorld::buildIslands()
+{
+    const size_t numBodies = m_bodies.length();
+    m_islandParents.resize(numBodies);
+    m_islandIndices.resize(numBodies);
+    for(uint32 i = 0; i < numBodies; i++)
+    {
+        m_islandParents[i] = i;
+        m_islandIndices[i] = NO_ISLAND;
+    }
+
+    // the index of the solved body of a contact, NO_ISLAND if the contact has no response
+    auto getSolvedBody = [](const Contact& contact) -> uint32
+    {
+        const NativeRigidBody& a = *contact.pBodyA;
+        const NativeRigidBody& b = *contact.pBodyB;
+        if(contact.manifold.numPoints == 0 || a.m_isTriggerVolume || b.m_isTriggerVolume)
+            return NO_ISLAND;
+        if(a.isDynamic() && a.m_isActive)
+            return a.m_index;
+        if(b.isDynamic() && b.m_isActive)
+            return b.m_index;
+        return NO_ISLAND;
+    };
+
+    // fixed and keyframed bodies are never changed by the solver, so they don't connect islands
+    for(auto& contact : m_contacts)
+    {
+        const NativeRigidBody& a = *contact.pBodyA;
+        const NativeRigidBody& b = *contact.pBodyB;
+        if(getSolvedBody(contact) == NO_ISLAND || !b.isDynamic() || !b.m_isActive || !a.m_isActive)
+            continue;
+        const uint32 rootA = findIslandRoot(a.m_index);
+        const uint32 rootB = findIslandRoot(b.m_index);
+        if(rootA != rootB)
+            m_islandParents[rootA] = rootB;
+    }
+
+    // count the constraints per island and sort them by island
+    m_islands.clear();
+    uint32 numConstraints = 0;
+    for(auto& contact : m_contacts)
+    {
+        const uint32 body = getSolvedBody(contact);
+        if(body == NO_ISLAND)
+            continue;
+        const uint32 root = findIslandRoot(body);
+        if(m_islandIndices[root] == NO_ISLAND)
+        {
+            m_islandIndices[root] = static_cast<uint32>(m_islands.length());
+            Island island;
+            island.firstConstraint = 0;
+            island.numConstraints = 0;
+            m_islands.append(island);
+        }
+        m_islands[m_islandIndices[root]].numConstraints++;
+        numConstraints++;
+    }
+
+    uint32 offset = 0;
+    for(auto& island : m_islands)
+    {
+        island.firstConstraint = offset;
+        offset += island.numConstraints;
+        island.numConstraints = 0;
+    }
+
+    m_constraints.resize(numConstraints);
+    m_constraintContacts.resize(numConstraints);
+    for(uint32 i = 0; i < m_contacts.length(); i++)
+    {
+        const Contact& contact = m_contacts[i];
+        const uint32 body = getSolvedBody(contact);
+        if(body == NO_ISLAND)
+            continue;
+        Island& island = m_islands[m_islandIndices[findIslandRoot(body)]];
+        const uint32 slot = island.firstConstraint + island.numConstraints++;
+        m_constraintContacts[slot] = i;
+
+        const NativeRigidBody& a = *contact.pBodyA;
+        const NativeRigidBody& b = *contact.pBodyB;
+        auto& constraint = m_constraints[slot];
+        constraint.bodyA = a.m_index;
+        constraint.bodyB = b.m_index;
+        constraint.normal = contact.manifold.normal;
+        constraint.friction = gep::sqrt(a.m_friction * b.m_friction);
+        constraint.restitution = gep::sqrt(a.m_restitution * b.m_restitution);
+        constraint.numPoints = contact.manifold.numPoints;
+        for(uint32 p = 0; p < constraint.numPoints; p++)
+        {
+            auto& point = constraint.points[p];
+            const vec3& position = contact.manifold.points[p].position;
+            point.anchorA = position - a.m_transform.position;
+            point.anchorB = position - b.m_transform.position;
+            point.separation = contact.manifold.points[p].separation;
+            point.normalImpulse = contact.normalImpulses[p];
+            point.tangentImpulse[0] = contact.tangentImpulses[p][0];
+            point.tangentImpulse[1] = contact.tangentImpulses[p][1];
+        }
+    }
+}
+
+void gep::NativeWorld::solveIslands(float deltaSeconds)
+{
+    const size_t numBodies = m_bodies.length();
+    m_solverBodies.resize(numBodies);
+    for(size_t i = 0; i < numBodies; i++)
+    {
+        const NativeRigidBody& body = *m_bodies[i];
+        auto& solverBody = m_solverBodies[i];
+        if(body.m_isActive)
+        {
+            solverBody.linearVelocity = body.m_linearVelocity;
+            solverBody.angularVelocity = body.m_angularVelocity;
+        }
+        else
+        {
+            solverBody.linearVelocity = vec3(0.0f);
+            solverBody.angularVelocity = vec3(0.0f);
+        }
+        if(body.isDynamic() && body.m_isActive)
+        {
+            solverBody.inverseMass = body.m_inverseMass;
+            solverBody.inverseInertia = body.computeInverseInertia();
+        }
+        else
+        {
+            solverBody.inverseMass = 0.0f;
+            solverBody.inverseInertia = mat3();
+        }
+    }
+
+    native::SolverSettings settings;
+    settings.linearSlop = m_linearSlop;
+    settings.baumgarte = BAUMGARTE;
+    settings.restitutionThreshold = m_linearSlop * 100.0f;
+    settings.velocityIterations = VELOCITY_ITERATIONS;
+
+    native::SolverBody* pSolverBodies = m_solverBodies.toArray().getPtr();
+    native::ContactConstraint* pConstraints = m_constraints.toArray().getPtr();
+    runParallel(m_pTaskQueue, m_islands.length(), 1, [&](size_t start, size_t end)
+    {
+        for(size_t i = start; i < end; i++)
+        {
+            const Island& island = m_islands[i];
+            native::solveContacts(ArrayPtr<native::ContactConstraint>(pConstraints + island.firstConstraint, island.numConstraints),
+                                  pSolverBodies, deltaSeconds, settings);
+        }
+    });
+
+    for(size_t i = 0; i < numBodies; i++)
+    {
+        NativeRigidBody& body = *m_bodies[i];
+        if(m_solverBodies[i].inverseMass == 0.0f)
+            continue;
+        body.m_linearVelocity = m_solverBodies[i].linearVelocity;
+        body.m_angularVelocity = m_solverBodies[i].angularVelocity;
+    }
+
+    // keep the impulses to warm start the next step
+    for(size_t i = 0; i < m_constraints.length(); i++)
+    {
+        const auto& constraint = m_constraints[i];
+        Contact& contact = m_contacts[m_constraintContacts[i]];
+        for(uint32 p = 0; p < constraint.numPoints; p++)
+        {
+            contact.normalImpulses[p] = constraint.points[p].normalImpulse;
+            contact.tangentImpulses[p][0] = constraint.points[p].tangentImpulse[0];
+            contact.tangentImpulses[p][1] = constraint.points[p].tangentImpulse[1];
+        }
+    }
+}
+
+void gep::NativeWorld::integratePositions(float deltaSeconds)
+{
+    for(size_t i = 0; i < m_bodies.length(); i++)
+    {
+        NativeRigidBody& body = *m_bodies[i];
+        if(!isQuerying(&body))
+            continue;
+        body.m_linearVelocity = clampLength(body.m_linearVelocity, body.m_maxLinearVelocity);
+        body.m_angularVelocity = clampLength(body.m_angularVelocity, body.m_maxAngularVelocity);
+
+        body.m_transform.position += body.m_linearVelocity * deltaSeconds;
+        if(body.m_angularVelocity.squaredLength() > 0.0f)
+        {
+            body.m_rotation = (body.m_rotation * Quaternion().Integrate(-body.m_angularVelocity, deltaSeconds)).normalized();
+            body.m_transform.rotation = body.m_rotation.toMat3();
+        }
+        m_transforms[i].position = body.m_transform.position;
+        m_transforms[i].rotation = body.m_rotation;
+    }
+}
+
+void gep::NativeWorld::updateTransform(const NativeRigidBody& body)
+{
+    GEP_ASSERT(m_bodies[body.m_index].get() == &body, "The rigid body is not simulated by this world", body.m_index);
+    m_transforms[body.m_index].position = body.m_transform.position;
+    m_transforms[body.m_index].rotation = body.m_rotation;
+}
+
+void gep::NativeWorld::updateSleeping(float deltaSeconds)
+{
+    const size_t numBodies = m_bodies.length();
+    m_islandSleepTimes.resize(numBodies);
+    for(auto& sleepTime : m_islandSleepTimes)
+        sleepTime = std::numeric_limits<float>::max();
+
+    const float linearToleranceSquared = m_sleepLinearVelocity * m_sleepLinearVelocity;
+    const float angularToleranceSquared = m_sleepAngularVelocity * m_sleepAngularVelocity;
+    for(uint32 i = 0; i < numBodies; i++)
+    {
+        NativeRigidBody& body = *m_bodies[i];
+        if(!body.m_isActive || !body.isDynamic())
+            continue;
+        if(!body.m_enableDeactivation ||
+            body.m_linearVelocity.squaredLength() > linearToleranceSquared ||
+            body.m_angularVelocity.squaredLength() > angularToleranceSquared)
+        {
+            body.m_sleepTime = 0.0f;
+        }
+        else
+            body.m_sleepTime += deltaSeconds;
+
+        float& islandSleepTime = m_islandSleepTimes[findIslandRoot(i)];
+        islandSleepTime = GEP_MIN(islandSleepTime, body.m_sleepTime);
+    }
+
+    // islands only sleep as a whole, otherwise a sleeping body would be pushed through by an awake one
+    for(uint32 i = 0; i < numBodies; i++)
+    {
+        NativeRigidBody& body = *m_bodies[i];
+        if(!body.m_isActive || !body.isDynamic() || m_islandSleepTimes[findIslandRoot(i)] < TIME_TO_SLEEP)
+            continue;
+        body.m_isActive = false;
+        body.m_linearVelocity = vec3(0.0f);
+        body.m_angularVelocity = vec3(0.0f);
+    }
+}
+
+void gep::NativeWorld::triggerCallbacks()
+{
+    for(size_t i = 0; i < m_contacts.length(); i++)
+    {
+        Contact& contact = m_contacts[i];
+        bool hasTouchingPoint = false;
+        for(uint32 p = 0; p < contact.manifold.numPoints; p++)
+            hasTouchingPoint = hasTouchingPoint || contact.manifold.points[p].separation <= m_linearSlop;
+        if(!hasTouchingPoint)
+            continue;
+
+        NativeRigidBody* pBodyA = contact.pBodyA;
+        NativeRigidBody* pBodyB = contact.pBodyB;
+        const uint16 delay = GEP_MIN(pBodyA->m_contactPointCallbackDelay, pBodyB->m_contactPointCallbackDelay);
+        bool fire = contact.hasNewPoint;
+        if(delay != 0xffff)
+        {
+            if(contact.callbackCounter >= delay)
+                fire = true;
+            else
+                contact.callbackCounter++;
+        }
+        if(!fire)
+            continue;
+        contact.callbackCounter = 0;
+
+        // the callbacks may remove the bodies
+        if(pBodyA->m_pWorld != this || pBodyB->m_pWorld != this)
+            continue;
+        pBodyA->triggerContactPointCallbacks(NativeContactPointArgs(CollisionArgs::CallbackSource::A, pBodyA, pBodyB));
+
+        if(pBodyA->m_pWorld != this || pBodyB->m_pWorld != this)
+            continue;
+        pBodyB->triggerContactPointCallbacks(NativeContactPointArgs(CollisionArgs::CallbackSource::B, pBodyA, pBodyB));
+
+        if(pBodyA->m_pWorld != this || pBodyB->m_pWorld != this)
+            continue;
+        NativeContactPointArgs worldArgs(CollisionArgs::CallbackSource::World, pBodyA, pBodyB);
+        m_event_contactPoint.trigger(&worldArgs);
+    }
+
+    for(size_t i = 0; i < m_bodies.length(); i++)
+    {
+        const NativeRigidBody& body = *m_bodies[i];
+        if(body.m_pWorld == this && isQuerying(&body))
+            body.triggerSimulationCallbacks();
+    }
+}
+
+void gep::NativeWorld::debugDraw(IDebugRenderer& debugRenderer) const
+{
+    for(auto& pBody : m_bodies)
+    {
+        const NativeRigidBody& body = *pBody;
+        vec3 min, max;
+        native::computeBounds(body.m_collisionShape, body.m_transform, min, max);
+        Color color = Color::white();
+        if(body.m_isTriggerVolume)
+            color = Color::yellow();
+        else if(body.m_isActive)
+            color = Color::green();
+        else if(body.m_motionType != MotionType::Fixed)
+            color = Color::blue();
+        debugRenderer.drawBox(min, max, color);
+    }
+
+    const float normalLength = m_linearSlop * 100.0f;
+    for(auto& contact : m_contacts)
+    {
+        for(uint32 p = 0; p < contact.manifold.numPoints; p++)
+        {
+            const vec3& position = contact.manifold.points[p].position;
+            debugRenderer.drawArrow(position, position + contact.manifold.normal * normalLength, Color::red());
+        }
+    }
+}
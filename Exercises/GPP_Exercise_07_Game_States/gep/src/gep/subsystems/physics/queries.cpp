@@ -0,0 +1,34 @@
+#include "stdafx.h"
+#include "gep/interfaces/physics/world.h"
+#include "gep/container/DynamicArray.h"
+
+gep::uint32 gep::IWorld::castRaysFromScript(ScriptTableWrapper rays, ScriptTableWrapper hitFractions) const
+{
+    const size_t numRays = rays.length() / 6;
+    DynamicArray<float> numbers;
+    numbers.resize(numRays * 6);
+    rays.getNumbers(numbers.toArray());
+
+    DynamicArray<RayCastInput> inputs;
+    DynamicArray<RayCastOutput> outputs;
+    inputs.resize(numRays);
+    outputs.resize(numRays);
+    for(size_t i = 0; i < numRays; i++)
+    {
+        const float* ray = &numbers[i * 6];
+        inputs[i].from = vec3(ray[0], ray[1], ray[2]);
+        inputs[i].to = vec3(ray[3], ray[4], ray[5]);
+    }
+    castRays(inputs.toArray(), outputs.toArray());
+
+    uint32 numHits = 0;
+    numbers.resize(numRays);
+    for(size_t i = 0; i < numRays; i++)
+    {
+        numbers[i] = outputs[i].hitFraction;
+        if(outputs[i].hasHit())
+            numHits++;
+    }
+    hitFractions.setNumbers(numbers.toArray());
+    return numHits;
+}
@@ -1,7 +1,9 @@
 #include "stdafx.h"
 #include "gepimpl/subsystems/renderer/ddsLoader.h"
 #include "gep/utils.h"
-#include "gep/file.h"
+#include "gep/archive.h"
+#include "gep/globalManager.h"
+#include "gep/interfaces/resourceManager.h"
 #include "gep/math3d/algorithm.h"
 
 namespace
@@ -12,6 +14,9 @@ namespace
             return true;
         return (value % 2 == 0) && isPowerOfTwo(value / 2);
     }
+
+    // more mipmaps than a texture of any supported size can have
+    const size_t MAX_MIPMAPS = 32;
 }
 
 gep::DDSData::~DDSData()
@@ -21,7 +26,33 @@ gep::DDSData::~DDSData()
     GEP_DELETE_ARRAY(pAllocator, images);
 }
 
-gep::DDSLoader::DDSLoader(IAllocator* pAllocator)
+gep::DDSData* gep::DDSData::copyMipmaps(IAllocator* pAllocator, ArrayPtr<mipmap_data_t> mipmaps, uint32 width, uint32 height)
+{
+    size_t memoryNeeded = 0;
+    for(auto& mipmap : mipmaps)
+        memoryNeeded += mipmap.length();
+
+    DDSData* pData = GEP_NEW(pAllocator, DDSData)(pAllocator);
+    pData->width = width;
+    pData->height = height;
+    pData->memory = GEP_NEW_ARRAY(pAllocator, uint8, memoryNeeded);
+    pData->imageData = GEP_NEW_ARRAY(pAllocator, mipmap_data_t, mipmaps.length());
+    pData->images = GEP_NEW_ARRAY(pAllocator, image_data_t, 1);
+    pData->images[0] = pData->imageData;
+
+    size_t memStart = 0;
+    for(size_t i=0; i < mipmaps.length(); i++)
+    {
+        pData->imageData[i] = pData->memory(memStart, memStart + mipmaps[i].length());
+        memcpy(pData->imageData[i].getPtr(), mipmaps[i].getPtr(), mipmaps[i].length());
+        memStart += mipmaps[i].length();
+    }
+    return pData;
+}
+
+gep::DDSLoader::DDSLoader(IAllocator* pAllocator) :
+    m_numMipmaps(0),
+    m_firstMipmap(0)
 {
     m_data = GEP_NEW(pAllocator, DDSData)(pAllocator);
 }
@@ -31,48 +62,66 @@ gep::DDSLoader::~DDSLoader()
 
 }
 
-void gep::DDSLoader::loadFile(const char* filename)
+void gep::DDSLoader::loadFile(const char* filename, uint32 maxSize)
 {
     m_filename = filename;
 
-    RawFile file(filename, "rb");
-    if(!file.isOpen())
+    auto& file = m_data->file;
+    if(g_globalManager.getResourceManager()->getFileSystem().open(filename, file) != SUCCESS)
     {
         throw DDSLoadingException(format("The file '%s' does not exist", filename));
     }
+    parse(file.getData(), maxSize);
 
-    if(file.getSize() < 128)
+    // the copy of a loose file would keep the skipped mipmaps in memory as long as the data is used
+    if(!file.isFromArchive() && m_firstMipmap > 0)
+    {
+        size_t memoryNeeded = 0;
+        for(auto& mipmap : m_data->imageData)
+            memoryNeeded += mipmap.length();
+        m_data->memory = GEP_NEW_ARRAY(m_data->pAllocator, uint8, memoryNeeded);
+        size_t memStart = 0;
+        for(auto& mipmap : m_data->imageData)
+        {
+            auto copy = m_data->memory(memStart, memStart + mipmap.length());
+            copy.copyFrom(mipmap);
+            mipmap = copy;
+            memStart += mipmap.length();
+        }
+        file.release();
+    }
+}
+
+void gep::DDSLoader::loadFromMemory(ArrayPtr<uint8> file, const char* name, uint32 maxSize)
+{
+    m_filename = name;
+    parse(file, maxSize);
+}
+
+void gep::DDSLoader::parse(ArrayPtr<uint8> file, uint32 maxSize)
+{
+    const char* filename = m_filename.c_str();
+
+    // the marker and the header are read and checked at once, all sizes are checked before the first mipmap is looked at
+    const size_t dataStart = sizeof(DWORD) + sizeof(DDS_HEADER);
+    if(file.length() < dataStart)
     {
         throw DDSLoadingException(format("The file '%s' is to small to be a valid dds file", filename));
     }
 
     DWORD ddsMarker;
-    file.read(ddsMarker);
+    memcpy(&ddsMarker, file.getPtr(), sizeof(DWORD));
     if(ddsMarker != 0x20534444)
     {
         throw DDSLoadingException(format("The file '%s' is not an dds file", filename));
     }
 
-    file.read(m_header.dwSize);
+    memcpy(&m_header, file.getPtr() + sizeof(DWORD), sizeof(DDS_HEADER));
     if(m_header.dwSize != sizeof(DDS_HEADER))
     {
         throw DDSLoadingException(format("dds-header size does not match inside file '%s'", filename));
     }
 
-    file.read(m_header.dwFlags);
-    file.read(m_header.dwHeight);
-    file.read(m_header.dwWidth);
-    file.read(m_header.dwPitchOrLinearSize);
-    file.read(m_header.dwDepth);
-    file.read(m_header.dwMipMapCount);
-    file.readArray(m_header.dwReserved1, GEP_ARRAY_SIZE(m_header.dwReserved1));
-    file.read(m_header.ddspf);
-    file.read(m_header.dwCaps);
-    file.read(m_header.dwCaps2);
-    file.read(m_header.dwCaps3);
-    file.read(m_header.dwCaps4);
-    file.read(m_header.dwReserved2);
-
     if((m_header.ddspf.dwFlags & PixelFormatFlags::FOURCC) && (m_header.ddspf.dwFourCC == D3DFORMAT::DX10))
     {
         throw DDSLoadingException(format("Loading DX10 dds file '%s' is not supported yet", filename));
@@ -88,19 +137,33 @@ void gep::DDSLoader::loadFile(const char* filename)
                                         ((m_header.dwFlags & HeaderFlags::PIXELFORMAT) == 0) ? "PIXELFORMAT " : ""));
     }
 
-    m_data->width = m_header.dwWidth;
-    m_data->height = m_header.dwHeight;
-
     size_t numMipmaps = 1;
     size_t numTextures = 1;
     // is it a mipmapped texture
-    if((m_header.dwFlags & HeaderFlags::MIPMAPCOUNT) != 0)
+    if((m_header.dwFlags & HeaderFlags::MIPMAPCOUNT) != 0 && m_header.dwMipMapCount > 0)
     {
         numMipmaps = m_header.dwMipMapCount;
     }
-    size_t* mipmapMemorySize = static_cast<size_t*>(alloca(numMipmaps * sizeof(size_t)));
+    if(numMipmaps > MAX_MIPMAPS)
+    {
+        throw DDSLoadingException(format("The file '%s' has %u mipmaps, which is more than any texture can have", filename, (uint32)numMipmaps));
+    }
+    size_t mipmapMemorySize[MAX_MIPMAPS];
 
-    size_t memoryNeeded = 0;
+    // the mipmaps which are too large are skipped, e.g. when a streamed texture is first loaded
+    size_t firstMipmap = 0;
+    if(maxSize > 0)
+    {
+        while(firstMipmap + 1 < numMipmaps && GEP_MAX(m_header.dwWidth, m_header.dwHeight) >> firstMipmap > maxSize)
+            firstMipmap++;
+    }
+    m_numMipmaps = (uint32)numMipmaps;
+    m_firstMipmap = (uint32)firstMipmap;
+    m_data->width = GEP_MAX(1, m_header.dwWidth >> firstMipmap);
+    m_data->height = GEP_MAX(1, m_header.dwHeight >> firstMipmap);
+    const size_t numLoadedMipmaps = numMipmaps - firstMipmap;
+
+    size_t textureSize = 0;
     if((m_header.ddspf.dwFlags & PixelFormatFlags::FOURCC) != 0)
     {
         // compressed texture
@@ -114,8 +177,6 @@ void gep::DDSLoader::loadFile(const char* filename)
         }
 
         size_t blockSize = (m_header.ddspf.dwFourCC == D3DFORMAT::DXT1) ? 8 : 16;
-        size_t pitch = GEP_MAX(1, ((m_header.dwWidth+3)/4)) * blockSize; //how many bytes one scan line has
-        size_t numScanLines = GEP_MAX(1, ((m_header.dwHeight+3)/4));
 
         if(!isPowerOfTwo(m_header.dwWidth) || !isPowerOfTwo(m_header.dwHeight))
         {
@@ -129,7 +190,7 @@ void gep::DDSLoader::loadFile(const char* filename)
             size_t mipmapPitch = GEP_MAX(1, (mipmapWidth+3)/4) * blockSize;
             size_t mipmapNumScanlines = GEP_MAX(1, (mipmapHeight+3)/4);
             mipmapMemorySize[i] = mipmapPitch * mipmapNumScanlines;
-            memoryNeeded += mipmapMemorySize[i];
+            textureSize += mipmapMemorySize[i];
             mipmapWidth /= 2;
             mipmapHeight /= 2;
         }
@@ -146,31 +207,33 @@ void gep::DDSLoader::loadFile(const char* filename)
             }
 
             numTextures = 6;
-            memoryNeeded *= numTextures;
         }
-        m_data->images = GEP_NEW_ARRAY(m_data->pAllocator, DDSData::image_data_t, numTextures);
-        m_data->imageData = GEP_NEW_ARRAY(m_data->pAllocator, DDSData::mipmap_data_t, numTextures * numMipmaps);
     }
     else
     {
         throw DDSLoadingException(format("Error reading file '%s'. format is not supported", filename));
     }
 
-    m_data->memory = GEP_NEW_ARRAY(m_data->pAllocator, uint8, memoryNeeded);
-    size_t memStart = 0;
+    if(file.length() - dataStart < textureSize * numTextures)
+    {
+        throw DDSLoadingException(format("The file '%s' is truncated, it has %u bytes of image data instead of %u",
+                                         filename, (uint32)(file.length() - dataStart), (uint32)(textureSize * numTextures)));
+    }
+
+    // the faces follow each other, each with all of its mipmaps
+    m_data->images = GEP_NEW_ARRAY(m_data->pAllocator, DDSData::image_data_t, numTextures);
+    m_data->imageData = GEP_NEW_ARRAY(m_data->pAllocator, DDSData::mipmap_data_t, numTextures * numLoadedMipmaps);
+    size_t fileStart = dataStart;
     size_t arrStart = 0;
     for(size_t texture=0; texture < numTextures; texture++)
     {
-        m_data->images[texture] = m_data->imageData(arrStart, arrStart+numMipmaps);
-        arrStart += numMipmaps;
+        m_data->images[texture] = m_data->imageData(arrStart, arrStart+numLoadedMipmaps);
+        arrStart += numLoadedMipmaps;
         for(size_t mipmap=0; mipmap<numMipmaps; mipmap++)
         {
-            m_data->images[texture][mipmap] = m_data->memory(memStart, memStart+mipmapMemorySize[mipmap]);
-            memStart += mipmapMemorySize[mipmap];
-            if( file.readArray(m_data->images[texture][mipmap].getPtr(), m_data->images[texture][mipmap].length()) != mipmapMemorySize[mipmap] )
-            {
-                throw DDSLoadingException(format("Error reading texture %d mipmap level %d of file '%s'", texture, mipmap, filename));
-            }
+            if(mipmap >= firstMipmap)
+                m_data->images[texture][mipmap - firstMipmap] = file(fileStart, fileStart+mipmapMemorySize[mipmap]);
+            fileStart += mipmapMemorySize[mipmap];
         }
     }
 }
@@ -1,56 +1,127 @@
 #include "stdafx.h"
 #include "gepimpl/subsystems/renderer/extractor.h"
 #include "gep/globalManager.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/textureStreamer.h"
 
+__declspec(thread) gep::RendererExtractor::Context* gep::RendererExtractor::s_pCurrentContext = nullptr;
 
-void* gep::RendererExtractor::doMakeCommand(size_t size, CommandType type)
+gep::RendererExtractor::Context::Context(IAllocator* pAllocator) :
+    allocator(256 * 1024, pAllocator),
+    queuedDraws(pAllocator),
+    textureUsages(pAllocator)
 {
-    GEP_ASSERT(m_isExtracting == true, "calling extractor from outside of a extraction callback");
-    void* mem = m_pCurrentAllocator->allocateMemory(size);
-    memset(mem, 0, size);
+    reset();
+}
+
+void gep::RendererExtractor::Context::reset()
+{
+    allocator.freeAll();
+    pFirstCommand = (CommandBase*)allocator.allocateMemory(sizeof(CommandBase));
+    pFirstCommand->type = CommandType::FirstCommand;
+    pFirstCommand->pNext = nullptr;
+    pLastCommand = pFirstCommand;
+    queuedDraws.resize(0);
+    drawList.clear();
+    cullingStats.numSubmitted = cullingStats.numCulled = 0;
+    textureUsages.resize(0);
+    view.hasCullingFrustum = false;
+    view.viewMatrix = mat4::identity();
+    view.projectionScale = 0.0f;
+}
+
+gep::RendererExtractor::Pool::~Pool()
+{
+    for(auto pContext : contexts)
+        delete pContext;
+}
+
+gep::RendererExtractor::Context& gep::RendererExtractor::Pool::getContext(size_t index)
+{
+    while(contexts.length() <= index)
+        contexts.append(new Context(pAllocator));
+    return *contexts[index];
+}
+
+gep::RendererExtractor::Context& gep::RendererExtractor::getCurrentContext()
+{
+    GEP_ASSERT(m_isExtracting == true && s_pCurrentContext != nullptr, "calling extractor from outside of a extraction callback");
+    return *s_pCurrentContext;
+}
+
+void* gep::RendererExtractor::doMakeCommand(size_t size, CommandType type, bool zeroMemory)
+{
+    auto& context = getCurrentContext();
+    void* mem = context.allocator.allocateMemory(size);
+    if(zeroMemory)
+        memset(mem, 0, size);
     auto cmd = (CommandBase*)mem;
     cmd->type = type;
-    GEP_ASSERT((char*)mem > (char*)m_pLastCommand);
-    auto offset = (char*)mem - (char*)m_pLastCommand;
-    GEP_ASSERT(offset < std::numeric_limits<uint16>::max(), "offset overflow");
-    m_pLastCommand->offsetNext = (uint16)offset;
-    m_pLastCommand = cmd;
+    cmd->pNext = nullptr;
+    context.pLastCommand->pNext = cmd;
+    context.pLastCommand = cmd;
     return mem;
 }
 
-gep::CallbackId gep::RendererExtractor::registerExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback)
+gep::IAllocator* gep::RendererExtractor::getCurrentAllocator()
+{
+    return &getCurrentContext().allocator;
+}
+
+gep::CallbackId gep::RendererExtractor::addCallback(std::function<void(IRendererExtractor& extractor)> callback, bool isParallel)
 {
+    GEP_ASSERT(m_isExtracting == false, "callbacks can not be changed during the extraction");
+    Callback entry;
+    entry.function = callback;
+    entry.isParallel = isParallel;
     for(size_t i=0; i <m_callbacks.length(); ++i)
     {
-        if(!m_callbacks[i])
+        if(!m_callbacks[i].function)
         {
-            m_callbacks[i] = callback;
+            m_callbacks[i] = entry;
             return CallbackId(i);
         }
     }
-    m_callbacks.append(callback);
+    m_callbacks.append(entry);
     return CallbackId(m_callbacks.length() - 1);
 }
 
+gep::CallbackId gep::RendererExtractor::registerExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback)
+{
+    return addCallback(callback, false);
+}
+
+gep::CallbackId gep::RendererExtractor::registerParallelExtractionCallback(std::function<void(IRendererExtractor& extractor)> callback)
+{
+    return addCallback(callback, true);
+}
+
 void gep::RendererExtractor::deregisterExtractionCallback(CallbackId callbackId)
 {
+    GEP_ASSERT(m_isExtracting == false, "callbacks can not be changed during the extraction");
     GEP_ASSERT(callbackId.id < m_callbacks.length(), "callback id out of bounds");
-    GEP_ASSERT(m_callbacks[callbackId.id], "callback was already deregistered");
-    m_callbacks[callbackId.id] = nullptr;
+    GEP_ASSERT(m_callbacks[callbackId.id].function, "callback was already deregistered");
+    m_callbacks[callbackId.id].function = nullptr;
 }
 
 
-gep::RendererExtractor::RendererExtractor()
+gep::RendererExtractor::RendererExtractor(IAllocator* pAllocator)
     : m_isExtracting(false),
-    m_pCurrentAllocator(nullptr),
-    m_pLastCommand(nullptr),
+    m_pPoolToFill(nullptr),
+    m_pPoolToRead(nullptr),
     m_nextPoolToFill(0),
     m_nextPoolToRead(0),
     m_fullPoolSync(0),
     m_emptyPoolSync(NUM_POOLS),
-    m_context2d(*this)
+    m_context2d(*this),
+    m_cullingEnabled(true)
 {
-    m_pCurrentAllocator = m_pools[0].pAllocator;
+    m_lastCullingStats.numSubmitted = m_lastCullingStats.numCulled = 0;
+    for(auto& pool : m_pools)
+    {
+        pool.pAllocator = pAllocator != nullptr ? pAllocator : &g_stdAllocator;
+        pool.numUsedContexts = 0;
+    }
 }
 
 gep::RendererExtractor::~RendererExtractor()
@@ -64,26 +135,168 @@ void gep::RendererExtractor::extract()
 
     auto& pool = m_pools[m_nextPoolToFill];
     m_nextPoolToFill = (m_nextPoolToFill + 1) % NUM_POOLS;
-    m_pCurrentAllocator = pool.pAllocator;
-    m_pLastCommand = (CommandBase*)m_pCurrentAllocator->allocateMemory(sizeof(CommandBase));
-    m_pLastCommand->offsetNext = 0;
-    m_pLastCommand->type = CommandType::FirstCommand;
+    m_pPoolToFill = &pool;
+    pool.meshDraws.resize(0);
+    auto& mainContext = pool.getContext(0);
+    mainContext.reset();
+    pool.numUsedContexts = 1;
+    s_pCurrentContext = &mainContext;
 
+    m_parallelCallbacks.resize(0);
     for(auto& callback : m_callbacks)
     {
-        if (callback)
-            callback(*this);
+        if(!callback.function)
+            continue;
+        if(callback.isParallel)
+        {
+            m_parallelCallbacks.append(&callback.function);
+            continue;
+        }
+        // the parallel callbacks registered before this one go into the command stream before it
+        runParallelCallbacks(pool);
+        callback.function(*this);
     }
+    runParallelCallbacks(pool);
 
+    flushMeshDraws();
+    m_lastCullingStats = mainContext.cullingStats;
+    s_pCurrentContext = nullptr;
     m_isExtracting = false;
     m_fullPoolSync.increment();
 }
 
+void gep::RendererExtractor::runParallelCallbacks(Pool& pool)
+{
+    const size_t numCallbacks = m_parallelCallbacks.length();
+    if(numCallbacks == 0)
+        return;
+    SCOPE_EXIT{ m_parallelCallbacks.resize(0); });
+
+    // a single group is not worth a task, it runs in the main context right away
+    if(numCallbacks < MIN_CALLBACKS_PER_GROUP)
+    {
+        for(auto pCallback : m_parallelCallbacks)
+            (*pCallback)(*this);
+        return;
+    }
+
+    // the contexts are handed out by group, not by worker, so the result does not depend on the scheduling
+    const size_t numGroups = GEP_MIN((size_t)MAX_PARALLEL_GROUPS, (numCallbacks + MIN_CALLBACKS_PER_GROUP - 1) / MIN_CALLBACKS_PER_GROUP);
+    const size_t firstContext = pool.numUsedContexts;
+    pool.numUsedContexts += numGroups;
+    Context* pMainContext = s_pCurrentContext;
+    for(size_t group = 0; group < numGroups; group++)
+    {
+        auto& context = pool.getContext(firstContext + group);
+        context.reset();
+        // the callbacks see the camera the serial callbacks before them have set
+        context.view = pMainContext->view;
+    }
+
+    g_globalManager.getTaskQueue()->runParallel(numGroups, 1, [&](size_t start, size_t end){
+        for(size_t group = start; group < end; group++)
+        {
+            s_pCurrentContext = pool.contexts[firstContext + group];
+            const size_t first = numCallbacks * group / numGroups;
+            const size_t last = numCallbacks * (group + 1) / numGroups;
+            for(size_t i = first; i < last; i++)
+                (*m_parallelCallbacks[i])(*this);
+        }
+        s_pCurrentContext = nullptr;
+    });
+    // the calling thread may have run some of the groups itself
+    s_pCurrentContext = pMainContext;
+
+    for(size_t group = 0; group < numGroups; group++)
+        appendContext(*pMainContext, *pool.contexts[firstContext + group]);
+}
+
+void gep::RendererExtractor::appendContext(Context& target, Context& source)
+{
+    // the command buffers stay where they are, only the chains are linked
+    if(source.pFirstCommand->pNext != nullptr)
+    {
+        target.pLastCommand->pNext = source.pFirstCommand->pNext;
+        target.pLastCommand = source.pLastCommand;
+    }
+
+    target.queuedDraws.reserve(target.queuedDraws.length() + source.queuedDraws.length());
+    for(auto& draw : source.queuedDraws)
+    {
+        target.drawList.add(draw.sortKey, (uint32)target.queuedDraws.length());
+        target.queuedDraws.append(draw);
+    }
+
+    target.cullingStats.numSubmitted += source.cullingStats.numSubmitted;
+    target.cullingStats.numCulled += source.cullingStats.numCulled;
+    target.textureUsages.append(source.textureUsages.toArray());
+}
+
 void gep::RendererExtractor::setCamera(ICamera* pCamera)
 {
-    auto& cmd = makeCommand<CommandCamera>();
+    GEP_ASSERT(s_pCurrentContext == m_pPoolToFill->contexts[0], "the camera can not be set from a parallel extraction callback");
+
+    // the meshes queued so far belong to the previous camera
+    flushMeshDraws();
+
+    auto& cmd = makeCommand<CommandCamera>(DO_NOT_INITIALIZE);
     cmd.viewMatrix = pCamera->getViewMatrix();
     cmd.projectionMatrix = pCamera->getProjectionMatrix();
+
+    // models extracted after this command are culled against this camera
+    auto& view = getCurrentContext().view;
+    view.cullingFrustum = Frustum(cmd.projectionMatrix * cmd.viewMatrix);
+    view.hasCullingFrustum = true;
+    view.viewMatrix = cmd.viewMatrix;
+    view.projectionScale = fabs(cmd.projectionMatrix.m11);
+}
+
+void gep::RendererExtractor::addMeshDraw(uint64 sortKey, ResourcePtr<Model> model, uint32 meshIndex, const mat4& transform)
+{
+    auto& context = getCurrentContext();
+    context.drawList.add(sortKey, (uint32)context.queuedDraws.length());
+    MeshDraw draw;
+    draw.sortKey = sortKey;
+    draw.model = model;
+    draw.meshIndex = meshIndex;
+    draw.transform = transform;
+    context.queuedDraws.append(draw);
+}
+
+void gep::RendererExtractor::addCullingStats(uint32 numSubmitted, uint32 numCulled)
+{
+    auto& stats = getCurrentContext().cullingStats;
+    stats.numSubmitted += numSubmitted;
+    stats.numCulled += numCulled;
+}
+
+void gep::RendererExtractor::addTextureUsage(uint32 streamingId, float screenHeight)
+{
+    if(streamingId == TextureStreamer::INVALID_ID || screenHeight <= 0.0f)
+        return;
+    TextureUsage usage;
+    usage.streamingId = streamingId;
+    usage.screenHeight = screenHeight;
+    getCurrentContext().textureUsages.append(usage);
+}
+
+void gep::RendererExtractor::flushMeshDraws()
+{
+    auto& context = getCurrentContext();
+    if(context.queuedDraws.length() == 0)
+        return;
+
+    context.drawList.sort();
+    auto& meshDraws = m_pPoolToFill->meshDraws;
+    auto& cmd = makeCommand<CommandDrawMeshes>(DO_NOT_INITIALIZE);
+    cmd.firstDraw = (uint32)meshDraws.length();
+    cmd.numDraws = (uint32)context.drawList.length();
+    meshDraws.reserve(meshDraws.length() + context.drawList.length());
+    for(auto& entry : context.drawList.getEntries())
+        meshDraws.append(context.queuedDraws[entry.index]);
+
+    context.drawList.clear();
+    context.queuedDraws.resize(0);
 }
 
 gep::CommandBase* gep::RendererExtractor::startReadCommands()
@@ -91,21 +304,22 @@ gep::CommandBase* gep::RendererExtractor::startReadCommands()
     m_fullPoolSync.waitAndDecrement();
     auto& pool = m_pools[m_nextPoolToRead];
     m_nextPoolToRead = (m_nextPoolToRead + 1) % NUM_POOLS;
-    CommandBase* firstCommand = (CommandBase*)pool.pStart;
+    m_pPoolToRead = &pool;
+    CommandBase* firstCommand = pool.contexts[0]->pFirstCommand;
     GEP_ASSERT(firstCommand->type == CommandType::FirstCommand);
     return nextCommand(firstCommand);
 }
 
 void gep::RendererExtractor::endReadCommands()
 {
-    auto& pool = m_pools[(m_nextPoolToRead + NUM_POOLS - 1) % NUM_POOLS];
-    pool.pAllocator->freeToMarker(pool.pStart);
+    // the pool is reset when it is filled the next time
+    m_pPoolToRead = nullptr;
     m_emptyPoolSync.increment();
 }
 
 void gep::RendererExtractor::beginDebugMarker(const char* name)
 {
-    auto& cmd = makeCommand<CommandDebugMarkerBegin>();
+    auto& cmd = makeCommand<CommandDebugMarkerBegin>(DO_NOT_INITIALIZE);
     const size_t len = strlen(name)+1;
     auto wc = (wchar_t*)getCurrentAllocator()->allocateMemory(sizeof(WCHAR) * len);
     mbstowcs (wc, name, len);
@@ -114,14 +328,7 @@ void gep::RendererExtractor::beginDebugMarker(const char* name)
 
 void gep::RendererExtractor::endDebugMarker()
 {
-    auto& cmd = makeCommand<CommandDebugMarkerEnd>();
-}
-
-gep::CommandBase* gep::RendererExtractor::nextCommand(CommandBase* lastCommand)
-{
-    if(lastCommand->offsetNext == 0)
-        return nullptr;
-    return (CommandBase*)((char*)lastCommand + lastCommand->offsetNext);
+    makeCommand<CommandDebugMarkerEnd>(DO_NOT_INITIALIZE);
 }
 
 gep::IContext2D& gep::RendererExtractor::getContext2D()
@@ -141,13 +348,6 @@ void gep::Context2D::printText(const vec2& screenPosition, const char* text, Col
     cmd.color = color;
     auto len = strlen(text);
 
-#ifdef _DEBUG
-    for (size_t i = 0; i < len; i++)
-    {
-        GEP_ASSERT(text[i] > 0, "ascii string contains non-ascii characters. Please use wide char version to print non ascii characters");
-    }
-#endif // _DEBUG
-
     cmd.text = GEP_NEW_ARRAY(m_extractor.getCurrentAllocator(), char, len + 1).getPtr();
     memcpy((void*)cmd.text, text, len + 1);
 }
@@ -2,7 +2,6 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include FT_GLYPH_H
 
 #include "gep/common.h"
 #include "gepimpl/subsystems/renderer/renderer.h"
@@ -13,118 +12,107 @@
 #include "gep/exception.h"
 #include "gep/globalManager.h"
 #include "gep/interfaces/resourceManager.h"
+#include "gep/interfaces/logging.h"
 
 const wchar_t* gep::Font::s_charsToLoad  = L"? 1234567890ABCDEFGHIJKLMNOPQRSTUVWXYZ???abcdefghijklmnopqrstuvwxyz????+*/\\#,.:;_-()[]{}\"'<>|@=!";
 
 void gep::Font::buildTexture(Texture2D& texture)
 {
-    int maxWidth, minY, maxY, maxHeight;
-    maxWidth = m_glyphs[0].m_width;
-    maxY = m_glyphs[0].m_top;
-    minY = m_glyphs[0].m_height - m_glyphs[0].m_top;
-    for(auto& g : m_glyphs)
+    texture.createEmpty(ATLAS_SIZE, ATLAS_SIZE, ImageFormat::R8);
+    ImageData2D& imageData = texture.getImageData();
+    memset(imageData.getData()[0].getPtr(), 0, imageData.getData()[0].length());
+    // the glyphs are put into the atlas again when they are used the next time
+    m_atlas.clear();
+    m_layoutCache.clear();
+}
+
+bool gep::Font::renderGlyph(Glyph& glyph, GlyphAtlas::Region& region)
+{
+    FT_Face face = (FT_Face)m_pFace;
+    if(FT_Load_Char(face, glyph.codepoint, FT_LOAD_RENDER) != 0)
     {
-        maxWidth = (g.m_width > maxWidth) ? g.m_width : maxWidth;
-        maxY = (g.m_top > maxY) ? g.m_top : maxY;
-        minY = (g.m_top - g.m_height< minY) ? g.m_top - g.m_height: minY;
+        g_globalManager.getLogging()->logWarning("Font '%s' could not render character %u", m_name.c_str(), glyph.codepoint);
+        return false;
     }
-    maxHeight = maxY - minY;
-    m_maxHeight = maxHeight;
-
-    int size=64;
-    int x,y;
-    while(size < 2048){
-        x=y=0;
-        for(auto& g : m_glyphs)
-        {
-            if((x + g.m_width + 1) > size)
-            {
-                y += maxHeight;
-                x = 0;
-            }
-            x+=g.m_width + 1;
-        }
-        if(y > size)
-            size*=2;
-        else
-            break;
-    }
-    if(size == 2048){
-        throw Exception("Font texture is to large");
-    }
-
-    texture.createEmpty(size, size, ImageFormat::R8);
-    ImageData2D& ImageData = texture.getImageData();
-    memset(ImageData.getData()[0].getPtr(), 0, ImageData.getData()[0].length());
 
-    x=y=0;
-    for(auto& g : m_glyphs)
+    FT_GlyphSlot slot = face->glyph;
+    const FT_Bitmap& bitmap = slot->bitmap;
+    glyph.text.left = (float)slot->bitmap_left;
+    glyph.text.top = (float)(m_ascent - slot->bitmap_top);
+    glyph.text.width = (float)bitmap.width;
+    glyph.text.height = (float)bitmap.rows;
+    glyph.text.advance = (float)((slot->advance.x >> 6) - slot->bitmap_left - bitmap.width);
+    glyph.isEmpty = bitmap.width == 0 || bitmap.rows == 0;
+    if(glyph.isEmpty)
+        return true;
+
+    if(!m_atlas.insert(glyph.codepoint, bitmap.width, bitmap.rows, region))
+        return false;
+
+    // the padding may still hold pixels of an evicted glyph
+    auto pixels = m_pFontTexture->getImageData().getData()[0];
+    for(uint32 y = 0; y < region.height + GlyphAtlas::PADDING; y++)
     {
-        if((x + g.m_width + 1) > size){
-            y += maxHeight;
-            x=0;
+        uint8* pRow = &pixels[(region.y + y) * ATLAS_SIZE + region.x];
+        if(y < region.height)
+        {
+            memcpy(pRow, bitmap.buffer + y * bitmap.pitch, region.width);
+            memset(pRow + region.width, 0, GlyphAtlas::PADDING);
         }
-        if(g.m_data != nullptr)
+        else
         {
-            ImageData.insert(*g.m_data, x, y + maxHeight - g.m_top + minY);
-            delete g.m_data;
-            g.m_data = nullptr;
+            memset(pRow, 0, region.width + GlyphAtlas::PADDING);
         }
-        float fStep = 1.0f / (float)size;
-        g.m_minTexY = (float)y * fStep;
-        g.m_minTexX = (float)(x) * fStep;
-        x += g.m_width;
-        g.m_maxTexY = (float)(y + maxHeight) * fStep;
-        g.m_maxTexX = (float)(x) * fStep;
-        x++;
-        g.m_fWidth = (float)(g.m_width + g.m_right);
-        g.m_realWidth = (float)g.m_width;
     }
+    m_isTextureOutOfDate = true;
+    return true;
 }
 
-void gep::Font::buildChar(void* pFace, wchar_t c, size_t num){
-    FT_Face face = (FT_Face)pFace;
-    // Load the glyph
-    if(FT_Load_Glyph( face, FT_Get_Char_Index( face, c ), FT_LOAD_DEFAULT ) != 0)
+const gep::TextGlyph* gep::Font::getGlyph(uint32 codepoint)
+{
+    uint32 index;
+    if(m_glyphIndices.tryGet(codepoint, index) != SUCCESS)
     {
-        std::ostringstream msg;
-        msg << "Error loading character " << (uint32)c;
-        throw Exception(msg.str());
+        Glyph glyph;
+        memset(&glyph, 0, sizeof(glyph));
+        glyph.codepoint = codepoint;
+        // a generation the atlas does not have right now, so that the glyph is rendered below
+        glyph.generation = m_atlas.getGeneration() - 1;
+        index = (uint32)m_glyphs.length();
+        m_glyphs.append(glyph);
+        m_glyphIndices[codepoint] = index;
     }
 
-    FT_Glyph glyph;
-    FT_Get_Glyph( face->glyph, &glyph);
-
-    // Convert it to a bitmap
-    FT_Glyph_To_Bitmap( &glyph, FT_RENDER_MODE_NORMAL, nullptr, 1 );
-    FT_BitmapGlyph bitmap_glyph((FT_BitmapGlyph)glyph);
-    FT_Bitmap* bitmap = &bitmap_glyph->bitmap;
-
-    // Allocate the bitmap
-    ImageData2D::image_data_t buffer;
-    if(bitmap->width > 0 || bitmap->rows > 0) {
-        buffer = GEP_NEW_ARRAY(g_stdAllocator, ImageData2D::mipmap_data_t, 1);
-        buffer[0] = GEP_NEW_ARRAY(g_stdAllocator, ImageData2D::channel_data_t, bitmap->rows * bitmap->width);
-        auto& mipmap = buffer[0];
-        for(int i=0; i<bitmap->rows * bitmap->width; i++){
-            mipmap[i] = bitmap->buffer[i];
-        }
+    Glyph& glyph = m_glyphs[index];
+    if(glyph.isEmpty)
+        return &glyph.text;
+    if(glyph.generation == m_atlas.getGeneration())
+    {
+        m_atlas.markShelfUsed(glyph.text.shelf);
+        return &glyph.text;
     }
 
-    auto& g = m_glyphs[num];
-    if(bitmap->width > 0 || bitmap->rows > 0) {
-        g.m_data = GEP_NEW(g_stdAllocator, ImageData2D);
-        g.m_data->setData(&g_stdAllocator, buffer, bitmap->width, bitmap->rows, ImageFormat::R8, ImageCompression::NONE);
-    }
-    else
+    // glyphs have been evicted since this one was used the last time, it might be one of them
+    GlyphAtlas::Region region;
+    if(!m_atlas.find(codepoint, region))
     {
-        g.m_data = nullptr;
+        if(!renderGlyph(glyph, region))
+        {
+            // the atlas is full with glyphs of this frame
+            return (codepoint != '?') ? getGlyph('?') : nullptr;
+        }
+        if(glyph.isEmpty)
+            return &glyph.text;
     }
-    g.m_width = bitmap->width;
-    g.m_height = bitmap->rows;
-    g.m_top = bitmap_glyph->top;
-    g.m_left = bitmap_glyph->left;
-    g.m_right = (face->glyph->advance.x >> 6) - bitmap_glyph->left - bitmap->width;
+
+    const float step = 1.0f / (float)ATLAS_SIZE;
+    glyph.text.minTexX = (float)region.x * step;
+    glyph.text.maxTexX = (float)(region.x + region.width) * step;
+    glyph.text.minTexY = (float)region.y * step;
+    glyph.text.maxTexY = (float)(region.y + region.height) * step;
+    glyph.text.shelf = region.shelf;
+    glyph.generation = m_atlas.getGeneration();
+    return &glyph.text;
 }
 
 void gep::Font::load(const char* filename, int size)
@@ -136,68 +124,82 @@ void gep::Font::load(const char* filename, int size)
     if( FT_Init_FreeType( &library )){
         throw Exception("Couldn't init freetype library");
     }
+    m_pLibrary = library;
+    bool isLoaded = false;
     SCOPE_EXIT
     {
-        FT_Done_FreeType(library);
+        if(!isLoaded)
+            releaseFace();
     });
 
+    // freetype reads from the view until the face is done
+    if(g_globalManager.getResourceManager()->getFileSystem().open(filename, m_fileView) != SUCCESS)
+    {
+        std::ostringstream msg;
+        msg << "Couldn't load font '" << m_name << "', the file '" << filename << "' does not exist";
+        throw Exception(msg.str());
+    }
 
     FT_Face face;
-    if(FT_Error error = FT_New_Face( library, filename, 0, &face ))
+    if(FT_Error error = FT_New_Memory_Face( library, m_fileView.getData().getPtr(), (FT_Long)m_fileView.length(), 0, &face ))
     {
         std::ostringstream msg;
         msg << "Couldn't load font '" << m_name << "' from file '" << filename << " error " << (uint32)error;
         throw Exception(msg.str());
     }
-    SCOPE_EXIT
-    {
-        FT_Done_Face(face);
-    });
+    m_pFace = face;
 
     FT_Set_Char_Size( face, size * 64, size * 64, 72, 72 );
 
-    auto numCharsToLoad = wcslen(s_charsToLoad);
-    m_glyphs.resize(numCharsToLoad);
-
-    //Search for starting character
-    wchar_t sc = s_charsToLoad[0];
-    wchar_t ec = s_charsToLoad[0];
-    for(size_t i=0; i<numCharsToLoad; i++)
+    // the line height is the one of the preloaded characters
+    int maxY = 0, minY = 0;
+    for(const wchar_t* c = s_charsToLoad; *c != L'\0'; c++)
     {
-        auto c = s_charsToLoad[i];
-        if(c < sc)
-            sc = c;
-        if(c > ec)
-            ec = c;
+        if(FT_Load_Char(face, *c, FT_LOAD_RENDER) != 0)
+        {
+            std::ostringstream msg;
+            msg << "Error loading character " << (uint32)*c;
+            throw Exception(msg.str());
+        }
+        maxY = GEP_MAX(maxY, face->glyph->bitmap_top);
+        minY = GEP_MIN(minY, face->glyph->bitmap_top - face->glyph->bitmap.rows);
     }
-    m_startIndex = sc;
-    m_endIndex = ec;
-    m_anzChars = m_glyphs.length();
+    m_ascent = maxY;
+    m_maxHeight = maxY - minY;
+
+    m_pFontTexture = g_globalManager.getResourceManager()->loadResource<Texture2D>(Texture2DFromFontLoader(makeResourcePtrFromThis<Font>()), LoadAsync::No);
+    m_isPrintable = true;
+    isLoaded = true;
+
+    for(const wchar_t* c = s_charsToLoad; *c != L'\0'; c++)
+        getGlyph(*c);
+}
 
-    size_t CharAnz = (size_t)(ec - sc) + 1;
-    m_charAsignment = GEP_NEW_ARRAY(g_stdAllocator, size_t, CharAnz);
-    for(auto& c : m_charAsignment)
+void gep::Font::releaseFace()
+{
+    if(m_pFace != nullptr)
     {
-        c = 0;
+        FT_Done_Face((FT_Face)m_pFace);
+        m_pFace = nullptr;
     }
-
-    //Building the chars
-    for(size_t i=0; i<numCharsToLoad; i++)
+    if(m_pLibrary != nullptr)
     {
-        auto toLoad = s_charsToLoad[i];
-        buildChar(face, toLoad, i);
-        m_charAsignment[toLoad - m_startIndex] = i;
+        FT_Done_FreeType((FT_Library)m_pLibrary);
+        m_pLibrary = nullptr;
     }
-
-    //TODO LoadAsync::no
-    m_pFontTexture = g_globalManager.getResourceManager()->loadResource<Texture2D>(Texture2DFromFontLoader(makeResourcePtrFromThis<Font>()));
-    m_isPrintable = true;
+    m_fileView.release();
 }
 
 gep::Font::Font(const char* name, IFontLoader* pLoader) :
-    m_name(name),
     m_pLoader(pLoader),
-    m_isPrintable(false)
+    m_atlas(ATLAS_SIZE, ATLAS_SIZE),
+    m_name(name),
+    m_maxHeight(0),
+    m_ascent(0),
+    m_isPrintable(false),
+    m_isTextureOutOfDate(false),
+    m_pLibrary(nullptr),
+    m_pFace(nullptr)
 {
 }
 
@@ -206,114 +208,84 @@ gep::Font::~Font()
     unload();
 }
 
-void gep::Font::print(Vertexbuffer& pFontBuffer, const char* text, FontHorizontalOrientation orientation /*= Orientation::Left*/) const
+void gep::Font::print(Vertexbuffer& pFontBuffer, const char* text, FontHorizontalOrientation orientation /*= Orientation::Left*/)
 {
     GEP_ASSERT(m_isPrintable, "font is not printable yet");
-    float TempBuffer[16];
-    float maxHeight = (float)m_maxHeight;
-    float offsetX=0.0f, offsetY = 0.0f;
-    
-    switch (orientation)
+    auto& layout = m_layoutCache.getLayout(*this, text, orientation);
+
+    uint32 startIndex = (uint32)pFontBuffer.getCurrentNumVertices();
+    const uint32 numQuads = (uint32)(layout.quads.length() / TextLayoutCache::FLOATS_PER_QUAD);
+    auto& indices = pFontBuffer.getIndices();
+    indices.reserve(indices.length() + numQuads * 6);
+    for(uint32 i = 0; i < numQuads; i++, startIndex += 4)
     {
-    case gep::FontHorizontalOrientation::Left:
-        break;
-    case gep::FontHorizontalOrientation::Centered:
-        {
-            int width = 0;
-            int height = 0;
-            getTextSize(width, height, text);
-            offsetX = -width / 2.0f;
-        }
-        break;
-    default:
-        GEP_ASSERT(false, "Unsupported orientation type!");
-        break;
+        uint32 quadIndices[] = { startIndex, startIndex + 2, startIndex + 1, //first triangle
+                                 startIndex , startIndex + 3, startIndex + 2 }; // second triangle
+        indices.append(quadIndices);
     }
-    
-    size_t len = strlen(text);
-    for(size_t i=0; i<len; i++)
-    {
-        auto c = text[i];
-        GEP_ASSERT(c > 0, "ascii string contains non-ascii characters. Please use wide char version to print non ascii characters");
-        size_t index = 0;
-        if(c == '\n'){
-            offsetY += floor(maxHeight * 1.5f);
-            offsetX = 0.0;
-            continue;
-        }
-        if(c >= m_startIndex && c <= m_endIndex)
-            index = m_charAsignment[c - m_startIndex];
-            
-        //Print the glyph
-        auto& glyph = m_glyphs[index];
-        offsetX += (float)glyph.m_left;
-
-        TempBuffer[0] = offsetX; TempBuffer[1] = offsetY;
-        TempBuffer[2] = glyph.m_minTexX; TempBuffer[3] = glyph.m_minTexY;
-
-        TempBuffer[4] = offsetX; TempBuffer[5] = maxHeight+offsetY;
-        TempBuffer[6] = glyph.m_minTexX; TempBuffer[7] = glyph.m_maxTexY;
-
-        TempBuffer[8] = glyph.m_realWidth+offsetX; TempBuffer[9] = maxHeight+offsetY;
-        TempBuffer[10] = glyph.m_maxTexX; TempBuffer[11] = glyph.m_maxTexY;
-
-        TempBuffer[12] = glyph.m_realWidth+offsetX; TempBuffer[13] = offsetY;
-        TempBuffer[14] = glyph.m_maxTexX; TempBuffer[15] = glyph.m_minTexY;
-
-        uint32 startIndex = (uint32)pFontBuffer.getCurrentNumVertices();
-        uint32 indices[] = { startIndex, startIndex + 2, startIndex + 1, //first triangle
-                             startIndex , startIndex + 3, startIndex + 2 }; // second triangle
-        pFontBuffer.getIndices().append(indices);
-        pFontBuffer.getData().append(TempBuffer);
+    pFontBuffer.getData().append(layout.quads.toArray());
+}
 
-        offsetX += glyph.m_fWidth;
+void gep::Font::finishFrame()
+{
+    if(m_isTextureOutOfDate)
+    {
+        m_pFontTexture->finalize();
+        m_isTextureOutOfDate = false;
     }
+    m_atlas.nextFrame();
+    m_layoutCache.nextFrame();
 }
 
-void gep::Font::getTextSize(int& width, int& height, const char* text) const
+void gep::Font::getTextSize(int& width, int& height, const char* text)
 {
-    width=0;
-    size_t index = 0;
-
-    if(text[0] > m_startIndex && text[0] <= m_endIndex)
-        index = m_charAsignment[text[0] - m_startIndex];
-
-    int maxY = m_glyphs[index].m_top;
-    int minY = m_glyphs[index].m_height - m_glyphs[index].m_top;
-    size_t len = strlen(text);
-    for(size_t i=0; i<len; ++i)
+    float maxWidth = 0.0f, lineWidth = 0.0f;
+    float minY = 0.0f, maxY = 0.0f;
+    bool hasGlyphs = false;
+    while(*text != '\0')
     {
-        auto c = text[i];
-        index = 0;
-        if(c >= m_startIndex && c <= m_endIndex)
-            index = m_charAsignment[c - m_startIndex];
-
-        auto& g = m_glyphs[index];
-        width += g.m_width + g.m_left + g.m_right;
-        maxY = (g.m_top > maxY) ? g.m_top : maxY;
-        minY = (g.m_top - g.m_height< minY) ? g.m_top - g.m_height: minY;
+        uint32 codepoint = TextLayoutCache::decodeUtf8(text);
+        if(codepoint == '\n')
+        {
+            lineWidth = 0.0f;
+            continue;
+        }
+        auto pGlyph = getGlyph(codepoint);
+        if(pGlyph == nullptr)
+            continue;
+        lineWidth += pGlyph->left + pGlyph->width + pGlyph->advance;
+        maxWidth = GEP_MAX(maxWidth, lineWidth);
+        if(pGlyph->height > 0.0f)
+        {
+            minY = hasGlyphs ? GEP_MIN(minY, pGlyph->top) : pGlyph->top;
+            maxY = hasGlyphs ? GEP_MAX(maxY, pGlyph->top + pGlyph->height) : pGlyph->top + pGlyph->height;
+            hasGlyphs = true;
+        }
     }
-    height = maxY - minY;
+    width = (int)maxWidth;
+    height = (int)(maxY - minY);
 }
 
-size_t gep::Font::getCharAtWidth(uint32 width, const char* text) const
+size_t gep::Font::getCharAtWidth(uint32 width, const char* text)
 {
-    uint32 currentWidth = 0;
-    size_t len = strlen(text);
-    for(size_t i=0; i<len; i++)
+    float currentWidth = 0.0f;
+    const char* start = text;
+    while(*text != '\0')
     {
-        auto c = text[i];
-        size_t index = 0;
-        if(c == '\n')
-            currentWidth = 0;
-        if(c >= m_startIndex && c <= m_endIndex)
-            index = m_charAsignment[c - m_startIndex];
-
-        auto& g = m_glyphs[index];
-        currentWidth += g.m_width + g.m_left + g.m_right;
-
-        if(currentWidth > width)
-            return i;
+        const char* current = text;
+        uint32 codepoint = TextLayoutCache::decodeUtf8(text);
+        if(codepoint == '\n')
+        {
+            currentWidth = 0.0f;
+            continue;
+        }
+        auto pGlyph = getGlyph(codepoint);
+        if(pGlyph == nullptr)
+            continue;
+        currentWidth += pGlyph->left + pGlyph->width + pGlyph->advance;
+
+        if(currentWidth > (float)width)
+            return current - start;
     }
     return -1;
 }
@@ -349,8 +321,11 @@ void gep::Font::unload()
     {
         m_isPrintable = false;
         g_globalManager.getResourceManager()->deleteResource(m_pFontTexture);
-        GEP_DELETE_ARRAY(g_stdAllocator, m_charAsignment);
     }
+    m_layoutCache.clear();
+    m_glyphIndices.clear();
+    m_glyphs.resize(0);
+    releaseFace();
 }
 
 void gep::Font::finalize()
@@ -437,7 +412,7 @@ gep::Texture2D* gep::Texture2DFromFontLoader::loadResource(Texture2D* pInPlace)
     {
         char name[256];
         sprintf_s(name, "%s - font texture", m_pFont->getName().c_str());
-        pInPlace = m_pRenderer->createTexture2D(name, this, TextureMode::Static);
+        pInPlace = m_pRenderer->createTexture2D(name, this, TextureMode::Dynamic);
     }
     m_pFont->buildTexture(*pInPlace);
     pInPlace->setHasData(true);
@@ -279,9 +279,9 @@ DXGI_FORMAT gep::toDxgiFormat(ImageFormat format)
     case ImageFormat::COMPRESSED_RGBA_DXT1:
         return DXGI_FORMAT_BC1_UNORM;
     case ImageFormat::COMPRESSED_RGBA_DXT3:
-        return DXGI_FORMAT_BC3_UNORM;
+        return DXGI_FORMAT_BC2_UNORM;
     case ImageFormat::COMPRESSED_RGBA_DXT5:
-        return DXGI_FORMAT_BC5_UNORM;
+        return DXGI_FORMAT_BC3_UNORM;
     default:
         GEP_ASSERT(false, "not implemented yet");
     }
@@ -7,11 +7,14 @@
 #include "gepimpl/subsystems/renderer/vertexbuffer.h"
 #include "gepimpl/subsystems/renderer/extractor.h"
 #include "gep/exception.h"
+#include "gep/meshcooker.h"
+#include "gep/math3d/batch.h"
 
 void gep::ModelMaterial::setShader(ResourcePtr<Shader> pShader)
 {
     m_pShader = pShader;
     m_modelMatrixConstant = ShaderConstant<mat4>("Model", pShader);
+    m_instanceMatricesConstant = ShaderConstant<mat4>("Instances", pShader);
     m_viewMatrixConstant = ShaderConstant<mat4>("View", pShader);
     m_projectionMatrixConstant = ShaderConstant<mat4>("Projection", pShader);
 }
@@ -21,6 +24,18 @@ void gep::ModelMaterial::addTexture(ShaderConstant<Texture2D> constant, Resource
     m_textures.append(TextureSlot(constant, pTexture));
 }
 
+gep::uint32 gep::ModelMaterial::getTextureSetId()
+{
+    uint32 hash = 0;
+    for(auto& slot : m_textures)
+    {
+        // the texture objects stay the same when they are reloaded, so their addresses identify them
+        size_t address = reinterpret_cast<size_t>(slot.texture.get());
+        hash = hash * 31 + (uint32)(address >> 4);
+    }
+    return hash ^ (hash >> 12);
+}
+
 void gep::ModelMaterial::resetTextures()
 {
     m_textures.resize(0);
@@ -30,6 +45,8 @@ gep::Model::MeshDrawData::~MeshDrawData()
 {
 }
 
+volatile gep::uint32 gep::Model::s_nextSortId = 0;
+
 gep::Model::Model(ID3D11Device* pDevice, ID3D11DeviceContext* pContext) :
     m_needsNodeLookup(false),
     m_pVertexbuffer(nullptr),
@@ -37,8 +54,10 @@ gep::Model::Model(ID3D11Device* pDevice, ID3D11DeviceContext* pContext) :
     m_pDeviceContext(pContext),
     m_pLoader(nullptr)
 {
-    GEP_ASSERT(pDevice != nullptr);
-    GEP_ASSERT(pContext != nullptr);
+    // models of the headless renderer have neither, they are only extracted and never drawn
+    GEP_ASSERT((pDevice == nullptr) == (pContext == nullptr), "either both or none of device and context have to be given");
+    // models are created by the loader threads as well
+    m_sortId = InterlockedIncrement(&s_nextSortId);
 }
 
 gep::Model::~Model()
@@ -52,23 +71,23 @@ void gep::Model::doFindMinMax(mat4 transformation, const ModelLoader::NodeDrawDa
     transformation = transformation * pNode->transform;
     //writefln("pNode = %x",cast(void*)pNode);
     //Search min-max for all meshes inside
-    for(auto meshIndex : pNode->meshes){
-        const ModelLoader::MeshData& meshData = m_modelLoader.getModelData().meshes[meshIndex];
-        vec3 min = transformation.transformPosition(meshData.bbox.getMin());
-        vec3 max = transformation.transformPosition(meshData.bbox.getMax());
-
-        //The transformation may swapped a axis, fix if neccesary
-        if(min.x > max.x) std::swap(min.x,max.x);
-        if(min.y > max.y) std::swap(min.y,max.y);
-        if(min.z > max.z) std::swap(min.z,max.z);
-
-        if(min.x < minOut.x) minOut.x = min.x;
-        if(min.y < minOut.y) minOut.y = min.y;
-        if(min.z < minOut.z) minOut.z = min.z;
-
-        if(max.x > maxOut.x) maxOut.x = max.x;
-        if(max.y > maxOut.y) maxOut.y = max.y;
-        if(max.z > maxOut.z) maxOut.z = max.z;
+    if(pNode->meshes.length() > 0)
+    {
+        //Transforming only the min and max corner is wrong as soon as there is a rotation,
+        //the whole boxes have to be transformed, all boxes of the node at once
+        batch::Vec3StreamArray<> boxMin, boxMax;
+        boxMin.reserve(pNode->meshes.length());
+        boxMax.reserve(pNode->meshes.length());
+        for(auto meshIndex : pNode->meshes)
+        {
+            const ModelLoader::MeshData& meshData = m_modelLoader.getModelData().meshes[meshIndex];
+            boxMin.append(meshData.bbox.getMin());
+            boxMax.append(meshData.bbox.getMax());
+        }
+        batch::BoxStreams boxes(boxMin.getStreams(), boxMax.getStreams());
+        batch::transformBoxes(transformation, boxes, boxes);
+        batch::extendBounds(boxes.min, minOut, maxOut);
+        batch::extendBounds(boxes.max, minOut, maxOut);
     }
 
     //Follow tree
@@ -77,56 +96,92 @@ void gep::Model::doFindMinMax(mat4 transformation, const ModelLoader::NodeDrawDa
     }
 }
 
-void gep::Model::drawHelper(ID3D11DeviceContext* pContext, mat4 transformation, const ModelLoader::NodeDrawData* pNode, mat4& view, mat4& projection)
+void gep::Model::drawMesh(ID3D11DeviceContext* pContext, uint32 meshIndex, ArrayPtr<mat4> transforms, mat4& view, mat4& projection, DrawState& state)
 {
-    GEP_ASSERT(pNode != nullptr,"pNode may not be null");
-    transformation = transformation * pNode->transform;
-
-    //Draw meshes
-    for(auto& meshIndex : pNode->meshes){
-        MeshDrawData& drawData = m_meshDrawData[meshIndex];
-        ModelMaterial& material = m_materials[drawData.materialIndex];
+    GEP_ASSERT(meshIndex < m_meshDrawData.length(), "GenerateMeshes has not been called on this model", meshIndex);
+    MeshDrawData& drawData = m_meshDrawData[meshIndex];
+    ModelMaterial& material = m_materials[drawData.materialIndex];
 
+    // the meshes come sorted by their state, so most of it is still set from the previous one
+    if(drawData.vertexbuffer != state.pVertexbuffer)
+    {
         drawData.vertexbuffer->use(pContext);
-        material.getModelMatrixConstant().set(transformation);
+        state.pVertexbuffer = drawData.vertexbuffer;
+    }
+    if(&material != state.pMaterial)
+    {
         for(auto& slot : material.getTextures())
         {
             slot.constant.set(slot.texture);
         }
+        state.pMaterial = &material;
+        state.pMaterialShader = material.getShader().get();
+    }
+    Shader* pShader = state.pMaterialShader;
+    if(pShader != state.pShader)
+    {
+        material.getViewMatrixConstant().set(view);
+        material.getProjectionMatrixConstant().set(projection);
+        state.pShader = pShader;
+    }
 
-        if(material.getShader().get() != m_pLastShader.get())
+    auto& instanceMatrices = material.getInstanceMatricesConstant();
+    if(instanceMatrices.isPresent())
+    {
+        for(size_t start = 0; start < transforms.length(); start += MAX_INSTANCES)
         {
-            material.getViewMatrixConstant().set(view);
-            material.getProjectionMatrixConstant().set(projection);
-            m_pLastShader = material.getShader();
-            
+            auto instances = transforms(start, GEP_MIN(start + MAX_INSTANCES, transforms.length()));
+            instanceMatrices.setArray(instances);
+            pShader->use(pContext, drawData.vertexbuffer);
+            drawData.vertexbuffer->drawInstanced(pContext, drawData.startIndex, drawData.numIndices, drawData.baseVertex, (uint32)instances.length());
         }
-        material.getShader()->use(pContext, drawData.vertexbuffer);
-        drawData.vertexbuffer->draw(pContext, drawData.startIndex, drawData.numIndices);
     }
-
-    for(auto c : pNode->children){
-        drawHelper(pContext, transformation, c, view, projection);
+    else
+    {
+        // shaders without an instance array get one draw call per instance
+        for(auto& transform : transforms)
+        {
+            material.getModelMatrixConstant().set(transform);
+            pShader->use(pContext, drawData.vertexbuffer);
+            drawData.vertexbuffer->draw(pContext, drawData.startIndex, drawData.numIndices, drawData.baseVertex);
+        }
     }
 }
 
-void gep::Model::draw(const mat4& modelMatrix, mat4& viewMatrix, mat4& projectionMatrix, ID3D11DeviceContext* pContext)
-{
-    GEP_ASSERT(m_meshDrawData.length() > 0, "GenerateMeshes has not been called on this model");
-    mat4 transform = modelMatrix * mat4::identity().right2Left();
-    drawHelper(pContext, transform, m_modelLoader.getModelData().rootNode, viewMatrix, projectionMatrix);
-    m_pLastShader = ResourcePtr<Shader>();
-}
-
 void gep::Model::loadFile(const char* filename)
 {
     m_modelLoader.loadFile(filename, ModelLoader::Load::Everything);
     m_materials.resize(getMaterialInfo().length());
+    buildCullingHierarchy();
 }
 void gep::Model::loadFromData(SmartPtr<ReferenceCounted> pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices)
 {
     m_modelLoader.loadFromData(pDataHolder, vertices, indices);
     m_materials.resize(1);
+    buildCullingHierarchy();
+}
+
+void gep::Model::buildCullingHierarchy()
+{
+    m_cullingHierarchy.clear();
+    m_flatNodes.resize(0);
+    auto pRootNode = m_modelLoader.getModelData().rootNode;
+    if(pRootNode != nullptr)
+        addToCullingHierarchy(CullingHierarchy::NO_PARENT, mat4::identity().right2Left() * pRootNode->transform, pRootNode);
+    m_cullingHierarchy.finish();
+}
+
+void gep::Model::addToCullingHierarchy(uint32 parent, const mat4& transformation, const ModelLoader::NodeDrawData* pNode)
+{
+    uint32 index = m_cullingHierarchy.addNode(parent, transformation);
+    m_flatNodes.append(pNode);
+    for(auto meshIndex : pNode->meshes)
+    {
+        const ModelLoader::MeshData& meshData = m_modelLoader.getModelData().meshes[meshIndex];
+        m_cullingHierarchy.addBounds(index, meshData.bbox.getMin(), meshData.bbox.getMax());
+    }
+    for(auto pChild : pNode->children)
+        addToCullingHierarchy(index, pChild->transform, pChild);
 }
 
 void gep::Model::generateMeshes()
@@ -146,162 +201,95 @@ void gep::Model::generateMeshes()
     }
 #endif
 
-    //Generate Meshes
-    m_meshDrawData.resize(m_modelLoader.getModelData().meshes.length());
-    size_t i = 0;
-    for(auto& mesh : m_modelLoader.getModelData().meshes)
-    {
-
-        // Generate the array of attributes we can use
-        DynamicArray<Vertexbuffer::DataChannel> neededChannels;
-        neededChannels.reserve(5);
+    auto& modelData = m_modelLoader.getModelData();
+    const bool isCooked = modelData.gpuMeshes.length() == modelData.meshes.length() && modelData.meshes.length() > 0;
 
-        neededChannels.append(Vertexbuffer::DataChannel::POSITION);
-        if(mesh.normals.length() > 0)
-        {
-            neededChannels.append(Vertexbuffer::DataChannel::NORMAL);
-        }
-        if(mesh.tangents.length() > 0)
-        {
-            neededChannels.append(Vertexbuffer::DataChannel::TANGENT);
-        }
-        if(mesh.bitangents.length() > 0)
-        {
-            neededChannels.append(Vertexbuffer::DataChannel::BINORMAL);
-        }
-        if(mesh.texcoords[0].length() > 0)
+    //All meshes share one vertex buffer, so they need the same layout
+    uint32 vertexFormat = 0;
+    uint32 indexSize = sizeof(uint16);
+    for(size_t i=0; i<modelData.meshes.length(); i++)
+    {
+        auto& mesh = modelData.meshes[i];
+        uint32 meshFormat = isCooked ? modelData.gpuMeshes[i].vertexFormat : MeshCooker::getVertexFormat(mesh);
+        if(i > 0 && meshFormat != vertexFormat)
         {
-            neededChannels.append(Vertexbuffer::DataChannel::TEXCOORD0);
+            std::ostringstream msg;
+            msg << "Error loading file '" << m_modelLoader.getFilename() << "' mesh number " << i << " has different vertex data than the other meshes";
+            throw LoadingError(msg.str());
         }
-        if(mesh.bones.length() > 0)
+        vertexFormat = meshFormat;
+        indexSize = GEP_MAX(indexSize, MeshCooker::getIndexSize(mesh.vertices.length()));
+    }
+
+    DynamicArray<Vertexbuffer::DataChannel> channels;
+    channels.append(Vertexbuffer::DataChannel::POSITION);
+    if(vertexFormat & GpuVertexFormat::Normal)
+        channels.append(Vertexbuffer::DataChannel::NORMAL_OCTAHEDRAL);
+    if(vertexFormat & GpuVertexFormat::Tangent)
+        channels.append(Vertexbuffer::DataChannel::TANGENT_OCTAHEDRAL);
+    if(vertexFormat & GpuVertexFormat::Bitangent)
+        channels.append(Vertexbuffer::DataChannel::BINORMAL_OCTAHEDRAL);
+    if(vertexFormat & GpuVertexFormat::TexCoord0)
+        channels.append(Vertexbuffer::DataChannel::TEXCOORD0_HALF);
+    if(vertexFormat & GpuVertexFormat::Bones)
+    {
+        channels.append(Vertexbuffer::DataChannel::BONE_INDICES_16);
+        channels.append(Vertexbuffer::DataChannel::BONE_WEIGHTS_8);
+    }
+
+    auto bufferIndexFormat = (indexSize == sizeof(uint16)) ? Vertexbuffer::IndexFormat::UInt16 : Vertexbuffer::IndexFormat::UInt32;
+    m_pVertexbuffer = new Vertexbuffer(m_pDevice, channels.toArray(), Vertexbuffer::Primitive::Triangle, Vertexbuffer::Usage::Static, bufferIndexFormat);
+    Vertexbuffer* vb = m_pVertexbuffer;
+
+    //Cooked meshes are copied as they are, all others are converted into the same layout
+    DynamicArray<uint8> vertexData;
+    DynamicArray<uint8> indexData;
+    m_meshDrawData.resize(modelData.meshes.length());
+    for(size_t i=0; i<modelData.meshes.length(); i++)
+    {
+        auto& mesh = modelData.meshes[i];
+        ArrayPtr<uint8> vertices, indices;
+        uint32 meshIndexSize = 0;
+        if(isCooked)
         {
-            neededChannels.append(Vertexbuffer::DataChannel::BONE_INDICES);
-            neededChannels.append(Vertexbuffer::DataChannel::BONE_WEIGHTS);
+            vertices = modelData.gpuMeshes[i].vertices;
+            indices = modelData.gpuMeshes[i].indices;
+            meshIndexSize = modelData.gpuMeshes[i].indexSize;
         }
-
-        //Lets check if the mesh that we are loading has all the requested data channels
-        int VertexSize = 0;
-        for( auto channel : neededChannels)
+        else
         {
-            switch(channel){
-            case Vertexbuffer::DataChannel::NORMAL:
-                if(mesh.normals.length() == 0){
-                    std::ostringstream msg;
-                    msg << "Error loading file '" << m_modelLoader.getFilename() << "' normal requested but not in mesh number " << i;
-                    throw LoadingError(msg.str());
-                }
-                break;
-            case Vertexbuffer::DataChannel::BINORMAL:
-            case Vertexbuffer::DataChannel::TANGENT:
-                if(mesh.tangents.length() == 0 || mesh.bitangents.length() == 0){
-                    std::ostringstream msg;
-                    msg << "Error loading file '" << m_modelLoader.getFilename() << "' tangent and binormal requested but not in mesh number " << i;
-                    throw LoadingError(msg.str());
-                }
-                break;
-            case Vertexbuffer::DataChannel::TEXCOORD0:
-                if(mesh.texcoords[(uint32)channel - (uint32)(Vertexbuffer::DataChannel::TEXCOORD0)].length() == 0){
-                    std::ostringstream msg;
-                    msg << "Error loading file '" << m_modelLoader.getFilename() << "' texcoord " << ((uint32)channel - (uint32)(Vertexbuffer::DataChannel::TEXCOORD0))
-                        << " requested but not found in mesh number " << i;
-                    throw LoadingError(msg.str());
-                }
-                break;
-            case Vertexbuffer::DataChannel::POSITION:
-                if(mesh.vertices.length() == 0){
-                    std::ostringstream msg;
-                    msg << "Error loading file '" << m_modelLoader.getFilename() << "' position requested but not in mesh number " << i;
-                    throw LoadingError(msg.str());
-                }
-                break;
-            case Vertexbuffer::DataChannel::BONE_INDICES:
-            case Vertexbuffer::DataChannel::BONE_WEIGHTS:
-                if(mesh.bones.length() == 0){
-                    std::ostringstream msg;
-                    msg << "Error loading file '" << m_modelLoader.getFilename() << "' bones requested but there are no bones in mesh number " << i;
-                    throw LoadingError(msg.str());
-                }
-                break;
-            default:
-                {
-                    std::ostringstream msg;
-                    msg << "Error loading '" << m_modelLoader.getFilename() << "' request of not supported data channel (not implemented yet)";
-                    throw LoadingError(msg.str());
-                }
-            }
+            vertexData.resize(MeshCooker::getVertexStride(vertexFormat) * mesh.vertices.length());
+            MeshCooker::encodeVertices(mesh, vertexFormat, vertexData.toArray());
+            indexData.resize(indexSize * mesh.faces.length() * 3);
+            MeshCooker::encodeIndices(mesh.faces, indexSize, indexData.toArray());
+            vertices = vertexData.toArray();
+            indices = indexData.toArray();
+            meshIndexSize = indexSize;
         }
 
-        //Insert the data into the vertex buffer
-        Vertexbuffer* vb = m_pVertexbuffer;
+        auto& drawData = m_meshDrawData[i];
+        drawData.vertexbuffer = vb;
+        drawData.startIndex = (uint32)vb->getNumIndices();
+        drawData.numIndices = (uint32)(indices.length() / meshIndexSize);
+        drawData.baseVertex = (int32)vb->getCurrentNumVertices();
+        drawData.materialIndex = mesh.materialIndex;
 
-        if(vb == nullptr){
-            vb = new Vertexbuffer(m_pDevice, neededChannels.toArray(), Vertexbuffer::Primitive::Triangle, Vertexbuffer::Usage::Static);
-            m_pVertexbuffer = vb;
+        vb->addRawData(vertices);
+        if(bufferIndexFormat == Vertexbuffer::IndexFormat::UInt16)
+        {
+            vb->getIndices16().append(ArrayPtr<uint16>(reinterpret_cast<uint16*>(indices.getPtr()), drawData.numIndices));
         }
-
-        m_meshDrawData[i].vertexbuffer = vb;
-        m_meshDrawData[i].startIndex = (uint32)vb->getIndices().length();
-        m_meshDrawData[i].numIndices = (uint32)(mesh.faces.length() * 3);
-        m_meshDrawData[i].materialIndex = mesh.materialIndex;
-
-        size_t IndexOffset = vb->getCurrentNumVertices();
-
-        for(size_t j=0; j<mesh.vertices.length(); j++)
+        else if(meshIndexSize == sizeof(uint32))
         {
-            for(auto channel : neededChannels)
-            {
-                uint32 dataChannelSize = Vertexbuffer::getDataChannelSize(channel);
-                switch(channel){
-                case Vertexbuffer::DataChannel::POSITION:
-                    GEP_ASSERT(dataChannelSize <= 3 && dataChannelSize > 0);
-                    vb->getData().append(ArrayPtr<float>((float*)mesh.vertices[j].data, dataChannelSize));
-                    break;
-                case Vertexbuffer::DataChannel::NORMAL:
-                    GEP_ASSERT(dataChannelSize <= 3 && dataChannelSize > 0);
-                    vb->getData().append(ArrayPtr<float>((float*)mesh.normals[j].data, dataChannelSize));
-                    break;
-                case Vertexbuffer::DataChannel::BINORMAL:
-                    GEP_ASSERT(dataChannelSize <= 3 && dataChannelSize > 0);
-                    vb->getData().append(ArrayPtr<float>((float*)mesh.bitangents[j].data, dataChannelSize));
-                    break;
-                case Vertexbuffer::DataChannel::TANGENT:
-                    GEP_ASSERT(dataChannelSize <= 3 && dataChannelSize > 0);
-                    vb->getData().append(ArrayPtr<float>((float*)mesh.tangents[j].data, dataChannelSize));
-                    break;
-                case Vertexbuffer::DataChannel::TEXCOORD0:
-                    {
-                        int index = (int)channel - (int)Vertexbuffer::DataChannel::TEXCOORD0;
-                        GEP_ASSERT(index >= 0 && index < 4);
-                        GEP_ASSERT(dataChannelSize == 2); //currently only 2 component uv channels supported
-                        GEP_ASSERT(mesh.texcoords[index].length() > 0);
-                        vb->getData().append(ArrayPtr<float>((float*)mesh.texcoords[index][j].data, dataChannelSize));
-                    }
-                    break;
-                case Vertexbuffer::DataChannel::BONE_INDICES:
-                    {
-                        auto boneIndexData = ArrayPtr<float>((float*)mesh.boneInfos[j].boneIndices, dataChannelSize);
-                        vb->getData().append(boneIndexData);
-                    }
-                    break;
-                case Vertexbuffer::DataChannel::BONE_WEIGHTS:
-                    {
-                        auto boneWeightData = ArrayPtr<float>((float*)mesh.boneInfos[j].weights, dataChannelSize);
-                        vb->getData().append(boneWeightData);
-                    }
-                    break;
-                default:
-                    GEP_ASSERT(0, "Trying to add unsupported data type to vertex buffer");
-                }
-            }
+            vb->getIndices().append(ArrayPtr<uint32>(reinterpret_cast<uint32*>(indices.getPtr()), drawData.numIndices));
         }
-
-        for(auto& face : mesh.faces){
-            uint32 indices[3];
-            for(int c=0;c<3;c++)
-                indices[c] = (uint32)(face.indices[c] + IndexOffset);
-            vb->getIndices().append(indices);
+        else
+        {
+            //a cooked mesh with 16 bit indices in a model that needs 32 bit indices
+            auto indices16 = ArrayPtr<uint16>(reinterpret_cast<uint16*>(indices.getPtr()), drawData.numIndices);
+            for(auto index : indices16)
+                vb->getIndices().append((uint32)index);
         }
-        i++;
     }
 }
 
@@ -359,6 +347,8 @@ void gep::Model::unload()
 void gep::Model::finalize()
 {
     GEP_ASSERT(m_pVertexbuffer == nullptr);
+    if(m_pDevice == nullptr)
+        return;
     generateMeshes();
     m_pVertexbuffer->upload(m_pDeviceContext);
 }
@@ -372,9 +362,82 @@ gep::uint32 gep::Model::getFinalizeOptions()
 
 void gep::Model::extract(IRendererExtractor& extractor, mat4 modelMatrix)
 {
-    auto& cmd = static_cast<RendererExtractor&>(extractor).makeCommand<CommandRenderModel>();
-    cmd.model = this->makeResourcePtrFromThis<Model>();
-    cmd.modelMatrix = modelMatrix;
+    auto& rendererExtractor = static_cast<RendererExtractor&>(extractor);
+    uint32 numNodes = m_cullingHierarchy.getNumNodesWithBounds();
+    if(numNodes == 0)
+        return;
+
+    ArrayPtr<uint32> visibleNodes = GEP_NEW_ARRAY(rendererExtractor.getCurrentAllocator(), uint32, numNodes);
+    auto pFrustum = rendererExtractor.getCullingFrustum();
+    if(pFrustum != nullptr)
+    {
+        // moving the frustum into model space is cheaper than moving all the node bounds out of it
+        auto localFrustum = pFrustum->toLocalSpace(modelMatrix);
+        auto result = m_cullingHierarchy.cull(localFrustum, visibleNodes);
+        rendererExtractor.addCullingStats(result.numVisible, result.numCulled);
+        visibleNodes = visibleNodes(0, result.numVisible);
+    }
+    else
+    {
+        // only the nodes with meshes have bounds
+        uint32 numVisible = 0;
+        for(uint32 node = 0; node < m_cullingHierarchy.getNumNodes(); node++)
+        {
+            if(m_cullingHierarchy.hasBounds(node))
+                visibleNodes[numVisible++] = node;
+        }
+        rendererExtractor.addCullingStats(numNodes, 0);
+    }
+
+    auto pThis = this->makeResourcePtrFromThis<Model>();
+    auto& modelData = m_modelLoader.getModelData();
+    // resolving a resource pointer takes the global weak reference lock,
+    // so the shaders and textures are looked up once per material instead of once per mesh
+    ArrayPtr<uint32> shaderSortIds = GEP_NEW_ARRAY(rendererExtractor.getCurrentAllocator(), uint32, m_materials.length());
+    ArrayPtr<uint32> textureSetIds = GEP_NEW_ARRAY(rendererExtractor.getCurrentAllocator(), uint32, m_materials.length());
+    ArrayPtr<float> textureScreenHeights = GEP_NEW_ARRAY(rendererExtractor.getCurrentAllocator(), float, m_materials.length());
+    for(size_t materialIndex = 0; materialIndex < m_materials.length(); materialIndex++)
+    {
+        Shader* pShader = m_materials[materialIndex].getShader().get();
+        shaderSortIds[materialIndex] = (pShader != nullptr) ? pShader->getSortId() : 0;
+        textureSetIds[materialIndex] = m_materials[materialIndex].getTextureSetId();
+        textureScreenHeights[materialIndex] = 0.0f;
+    }
+    for(auto node : visibleNodes)
+    {
+        // the culling hierarchy already has the transformations relative to the model
+        mat4 transform = modelMatrix * m_cullingHierarchy.getTransform(node);
+        vec3 min, max;
+        m_cullingHierarchy.getBounds(node, min, max);
+        float depth = rendererExtractor.getViewDepth(modelMatrix.transformPosition((min + max) * 0.5f));
+        // the textures are assumed to be stretched over the whole node once
+        float screenHeight = rendererExtractor.getScreenHeight((modelMatrix.transformPosition(max) - modelMatrix.transformPosition(min)).length(), depth);
+
+        for(auto meshIndex : m_flatNodes[node]->meshes)
+        {
+            uint32 materialIndex = modelData.meshes[meshIndex].materialIndex;
+            uint64 sortKey = DrawList::makeKey(shaderSortIds[materialIndex],
+                                               textureSetIds[materialIndex],
+                                               (m_sortId << 6) ^ materialIndex,
+                                               (m_sortId << 10) ^ meshIndex,
+                                               depth);
+            rendererExtractor.addMeshDraw(sortKey, pThis, meshIndex, transform);
+            // the streamer only keeps the largest usage of a texture anyway
+            textureScreenHeights[materialIndex] = GEP_MAX(textureScreenHeights[materialIndex], screenHeight);
+        }
+    }
+
+    for(size_t materialIndex = 0; materialIndex < m_materials.length(); materialIndex++)
+    {
+        if(textureScreenHeights[materialIndex] <= 0.0f)
+            continue;
+        for(auto& slot : m_materials[materialIndex].getTextures())
+        {
+            Texture2D* pTexture = slot.texture.get();
+            if(pTexture != nullptr)
+                rendererExtractor.addTextureUsage(pTexture->getStreamingId(), textureScreenHeights[materialIndex]);
+        }
+    }
 }
 
 gep::IResource* gep::IModelLoader::loadResource(IResource* pInPlace)
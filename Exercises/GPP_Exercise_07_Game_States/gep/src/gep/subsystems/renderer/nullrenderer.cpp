@@ -0,0 +1,241 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/renderer/nullRenderer.h"
+
+#include "gep/globalManager.h"
+#include "gep/interfaces/updateFramework.h"
+#include "gep/interfaces/logging.h"
+#include "gepimpl/subsystems/renderer/model.h"
+#include "gepimpl/subsystems/renderer/extractor.h"
+#include "gep/drawList.h"
+#include "gep/textLayout.h"
+
+#include "gep/settings.h"
+
+namespace
+{
+    /// frame times are averaged over this many frames, the update framework keeps no more
+    const gep::uint32 STATS_INTERVAL = 60;
+
+    /// the font draws a quad for every character but the white space
+    gep::uint32 countGlyphs(const char* text)
+    {
+        gep::uint32 numGlyphs = 0;
+        while(*text != '\0')
+        {
+            gep::uint32 codepoint = gep::TextLayoutCache::decodeUtf8(text);
+            if(codepoint >= 0x80 || !isspace((int)codepoint))
+                numGlyphs++;
+        }
+        return numGlyphs;
+    }
+}
+
+gep::NullRenderer::NullRenderer(const settings::Video& settings) :
+    Renderer(settings),
+    m_numFramesToRun(settings.headlessFrames),
+    m_numFrames(0)
+{
+    memset(&m_lastFrameStats, 0, sizeof(m_lastFrameStats));
+}
+
+void gep::NullRenderer::initialize()
+{
+    m_pDebugRenderer = new DebugRenderer();
+    g_globalManager.getLogging()->logMessage("Running headless, nothing will be drawn");
+
+    // without a device there are no textures and shaders, loading them fails
+    g_globalManager.getResourceManager()->registerResourceType("Texture2D", nullptr);
+    g_globalManager.getResourceManager()->registerResourceType("Shader", nullptr);
+    g_globalManager.getResourceManager()->registerResourceType("Font", nullptr);
+
+    {
+        m_pDummyModel = createModel();
+        m_pDummyModel->loadFile("data/base/dummy.thModel");
+        m_pDummyModel->setLoader(ModelDummyLoader().moveToHeap());
+        m_pDummyModel->getLoader()->loadResource(m_pDummyModel);
+        m_pDummyModel->finalize();
+        g_globalManager.getResourceManager()->registerResourceType("Model", m_pDummyModel);
+    }
+}
+
+void gep::NullRenderer::destroy()
+{
+    m_pDummyModel = nullptr;
+    delete m_pDebugRenderer; m_pDebugRenderer = nullptr;
+}
+
+void gep::NullRenderer::update(float elapsedTime)
+{
+    // only finalizes the models, which do not upload anything without a device
+    g_globalManager.getResourceManager()->finalizeResourcesWithFlags(ResourceFinalize::FromRenderer);
+
+    FrameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    {
+        auto& extractor = *static_cast<RendererExtractor*>(g_globalManager.getRendererExtractor());
+
+        CommandBase* firstCommand = extractor.startReadCommands();
+        SCOPE_EXIT { extractor.endReadCommands(); });
+
+        consumeCommands(extractor, firstCommand, stats);
+    }
+    m_lastFrameStats = stats;
+    m_numFrames++;
+    m_vsyncEnabled = m_requestedVSyncState;
+
+    auto pUpdateFramework = g_globalManager.getUpdateFramework();
+    const bool isLastFrame = m_numFramesToRun > 0 && m_numFrames >= m_numFramesToRun;
+    if(m_numFrames % STATS_INTERVAL == 0 || isLastFrame)
+    {
+        const size_t numFramesToAverage = GEP_MIN(m_numFrames, STATS_INTERVAL);
+        g_globalManager.getLogging()->logMessage("headless frame %u: %.3f ms average over %u frames, "
+            "%u mesh draws in %u draw calls, %u lines, %u 2D lines, %u glyphs, %u cameras, %u commands with %u KB",
+            m_numFrames, pUpdateFramework->calcElapsedTimeAverage(numFramesToAverage), (uint32)numFramesToAverage,
+            stats.numMeshDraws, stats.numDrawCalls, stats.numLines, stats.numLines2D, stats.numTextGlyphs,
+            stats.numCameras, stats.numCommands, (uint32)(stats.numBytes / 1024));
+    }
+    if(isLastFrame)
+        pUpdateFramework->stop();
+}
+
+void gep::NullRenderer::consumeCommands(RendererExtractor& extractor, CommandBase* currentCommand, FrameStats& stats)
+{
+    int32 debugMarkerDepth = 0;
+    while(currentCommand != nullptr)
+    {
+        stats.numCommands++;
+        switch(currentCommand->getType())
+        {
+        case CommandType::DrawMeshes:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandDrawMeshes>(currentCommand);
+                stats.numBytes += sizeof(CommandDrawMeshes) + cmd->numDraws * sizeof(MeshDraw);
+                auto draws = extractor.getMeshDraws(*cmd);
+                // the same batching as Renderer::drawMeshes, to know the number of draw calls
+                size_t batchStart = 0;
+                for(size_t i = 0; i < draws.length(); i++)
+                {
+                    auto& draw = draws[i];
+                    if(!draw.model.isValid())
+                    {
+                        reportError(stats, "mesh draw without a model");
+                        continue;
+                    }
+                    if(draw.meshIndex >= draw.model->getNumMeshes())
+                        reportError(stats, "mesh draw with an invalid mesh index");
+                    if(i > 0 && draws[i - 1].sortKey > draw.sortKey)
+                        reportError(stats, "the mesh draws are not sorted");
+
+                    if(i == batchStart ||
+                       i - batchStart == Model::MAX_INSTANCES ||
+                       DrawList::getBatchKey(draws[batchStart].sortKey) != DrawList::getBatchKey(draw.sortKey) ||
+                       draws[batchStart].model.get() != draw.model.get() ||
+                       draws[batchStart].meshIndex != draw.meshIndex)
+                    {
+                        batchStart = i;
+                        stats.numDrawCalls++;
+                    }
+                    stats.numMeshDraws++;
+                }
+            }
+            break;
+        case CommandType::Text:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandDrawText>(currentCommand);
+                if(cmd->text == nullptr)
+                {
+                    reportError(stats, "text command without text");
+                    break;
+                }
+                stats.numTextGlyphs += countGlyphs(cmd->text);
+                stats.numBytes += sizeof(CommandDrawText) + strlen(cmd->text) + 1;
+            }
+            break;
+        case CommandType::TextBillboard:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandDrawTextBillboard>(currentCommand);
+                if(cmd->text == nullptr)
+                {
+                    reportError(stats, "text billboard command without text");
+                    break;
+                }
+                stats.numTextGlyphs += countGlyphs(cmd->text);
+                stats.numBytes += sizeof(CommandDrawTextBillboard) + strlen(cmd->text) + 1;
+            }
+            break;
+        case CommandType::RenderLines:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandRenderLines>(currentCommand);
+                if(cmd->lines.length() > 0 && cmd->lines.getPtr() == nullptr)
+                    reportError(stats, "lines command without lines");
+                stats.numLines += (uint32)cmd->lines.length();
+                stats.numBytes += sizeof(CommandRenderLines) + cmd->lines.length() * sizeof(LineInfo);
+            }
+            break;
+        case CommandType::RenderLines2D:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandRenderLines2D>(currentCommand);
+                if(cmd->lines.length() > 0 && cmd->lines.getPtr() == nullptr)
+                    reportError(stats, "2D lines command without lines");
+                stats.numLines2D += (uint32)cmd->lines.length();
+                stats.numBytes += sizeof(CommandRenderLines2D) + cmd->lines.length() * sizeof(LineInfo2D);
+            }
+            break;
+        case CommandType::Camera:
+            stats.numCameras++;
+            stats.numBytes += sizeof(CommandCamera);
+            break;
+        case CommandType::DebugMarkerBegin:
+            {
+                auto cmd = RendererExtractor::command_cast<CommandDebugMarkerBegin>(currentCommand);
+                stats.numDebugMarkers++;
+                stats.numBytes += sizeof(CommandDebugMarkerBegin) + (wcslen(cmd->name) + 1) * sizeof(wchar_t);
+                debugMarkerDepth++;
+            }
+            break;
+        case CommandType::DebugMarkerEnd:
+            stats.numBytes += sizeof(CommandDebugMarkerEnd);
+            if(--debugMarkerDepth < 0)
+            {
+                reportError(stats, "debug marker ended which has not begun");
+                debugMarkerDepth = 0;
+            }
+            break;
+        default:
+            reportError(stats, "invalid command type");
+            break;
+        }
+
+        currentCommand = extractor.nextCommand(currentCommand);
+    }
+
+    if(debugMarkerDepth != 0)
+        reportError(stats, "debug marker not ended");
+}
+
+void gep::NullRenderer::reportError(FrameStats& stats, const char* message)
+{
+    // only the first error of a frame, a broken command stream usually breaks every command after it
+    if(stats.numErrors == 0)
+        g_globalManager.getLogging()->logError("headless frame %u: %s", m_numFrames + 1, message);
+    stats.numErrors++;
+}
+
+gep::ResourcePtr<gep::IModel> gep::NullRenderer::loadModel(const char* path)
+{
+    // the materials stay without shaders and textures, they would never be used
+    return g_globalManager.getResourceManager()->loadResource<Model>(ModelFileLoader(path), LoadAsync::No);
+}
+
+gep::ResourcePtr<gep::IModel> gep::NullRenderer::loadModel(ReferenceCounted* pDataHolder, ArrayPtr<vec4> vertices, ArrayPtr<uint32> indices)
+{
+    auto id = InterlockedIncrement(&m_dataModelNum);
+    char idString[256];
+    sprintf(idString, "DataModel%d", id);
+    return g_globalManager.getResourceManager()->loadResource<Model>(ModelLoaderFromData(pDataHolder, vertices, indices, idString), LoadAsync::No);
+}
+
+gep::ResourcePtr<gep::IResource> gep::NullRenderer::createGeneratedTexture(uint32 width, uint32 height, const char* resourceId, std::function<void(ArrayPtr<uint8>)> generatorFunction)
+{
+    return ResourcePtr<IResource>();
+}
@@ -12,6 +12,7 @@
 #include "gepimpl/subsystems/renderer/vertexbuffer.h"
 #include "gepimpl/subsystems/renderer/model.h"
 #include "gepimpl/subsystems/renderer/extractor.h"
+#include "gepimpl/subsystems/renderer/textureStreaming.h"
 #include "gep/modelloader.h"
 #include "gep/math3d/algorithm.h"
 
@@ -37,10 +38,13 @@ extern D3DPERF_BeginEvent_Func D3DPREF_BeginEvent = nullptr;
 #endif
 
 gep::Renderer::Renderer(const settings::Video& settings) :
+    m_pDebugRenderer(nullptr),
     m_width(settings.screenResolution.x),
     m_height(settings.screenResolution.y),
     m_vsyncEnabled(settings.vsyncEnabled),
     m_requestedVSyncState(settings.vsyncEnabled),
+    m_pDummyModel(nullptr),
+    m_dataModelNum(0),
     m_pd3dDevice(nullptr),
     m_pSwapChain(nullptr),
     m_pRenderTargetView(nullptr),
@@ -49,12 +53,13 @@ gep::Renderer::Renderer(const settings::Video& settings) :
     m_pDeviceContext(nullptr),
     m_pDummyTexture(nullptr),
     m_pDummyShader(nullptr),
+    m_textureBudget((size_t)settings.textureBudget * 1024 * 1024),
+    m_pTextureStreaming(nullptr),
     m_pFontBuffer(nullptr),
     m_pLinesBuffer(nullptr),
     m_pLines2DBuffer(nullptr),
     m_isFontBufferOutOfDate(false),
-    m_hWnd(nullptr),
-    m_dataModelNum(0)
+    m_hWnd(nullptr)
 {
 }
 
@@ -72,6 +77,15 @@ void gep::Renderer::initialize()
 
     g_globalManager.getLogging()->logMessage("Using DirectX Version: %d.%d sdk %d", D3D11_MAJOR_VERSION, D3D11_MINOR_VERSION, D3D11_SDK_VERSION);
 
+    if(m_textureBudget > 0)
+    {
+        m_pTextureStreaming = new TextureStreaming(m_textureBudget);
+        m_pTextureStreaming->start();
+        // the streaming thread reads from the file system, so it has to stop before the resource manager is destroyed.
+        // Destroy callbacks run in reverse order, this one runs before the one of the resource manager.
+        g_globalManager.getUpdateFramework()->registerDestroyCallback([&](){ m_pTextureStreaming->stop(); });
+    }
+
     // Create the dummy 2d texture
     {
         m_pDummyTexture = createTexture2D("dummy texture 2d", new DummyTexture2DLoader(), TextureMode::Static);
@@ -192,6 +206,9 @@ void gep::Renderer::destroy()
     m_pDummyShader = nullptr;
     m_pDummyModel = nullptr;
 
+    if(m_pTextureStreaming)
+        m_pTextureStreaming->stop();
+    DELETE_AND_NULL(m_pTextureStreaming);
     DELETE_AND_NULL(m_pFontBuffer);
     DELETE_AND_NULL(m_pLinesBuffer);
     DELETE_AND_NULL(m_pLines2DBuffer);
@@ -442,6 +459,8 @@ void gep::Renderer::render()
         SCOPE_EXIT { extractor.endReadCommands(); });
 
         prepareCommands(extractor, firstCommand);
+        // the glyphs used by the texts of this frame are in the atlas now
+        m_pDefaultFont->finishFrame();
 
         m_pFontBuffer->upload(m_pDeviceContext);
         m_pLinesBuffer->upload(m_pDeviceContext);
@@ -458,6 +477,9 @@ void gep::Renderer::render()
 
         executeCommands(extractor, firstCommand);
         execute2DCommands(extractor, firstCommand);
+
+        if(m_pTextureStreaming)
+            m_pTextureStreaming->update(extractor.getTextureUsages(), (float)m_height);
     }
 
     m_pSwapChain->Present( m_vsyncEnabled ? 1 : 0, 0 );
@@ -546,10 +568,10 @@ void gep::Renderer::executeCommands(RendererExtractor& extractor, CommandBase* c
     {
         switch(currentCommand->getType())
         {
-        case CommandType::RenderModel:
+        case CommandType::DrawMeshes:
             {
-                auto cmd = RendererExtractor::command_cast<CommandRenderModel>(currentCommand);
-                cmd->model->draw(cmd->modelMatrix, m_view, m_projection, m_pDeviceContext);
+                auto cmd = RendererExtractor::command_cast<CommandDrawMeshes>(currentCommand);
+                drawMeshes(extractor.getMeshDraws(*cmd));
             }
             break;
     
@@ -585,6 +607,33 @@ void gep::Renderer::executeCommands(RendererExtractor& extractor, CommandBase* c
     }
 }
 
+void gep::Renderer::drawMeshes(ArrayPtr<MeshDraw> draws)
+{
+    Model::DrawState state;
+    mat4 transforms[Model::MAX_INSTANCES];
+    size_t i = 0;
+    while(i < draws.length())
+    {
+        MeshDraw& first = draws[i];
+        const uint64 batchKey = DrawList::getBatchKey(first.sortKey);
+        // resolving the pointer takes the global weak reference lock, the index identifies the model without it
+        const uint32 modelIndex = first.model.getWeakRefIndex();
+        uint32 numInstances = 0;
+        // the ids in the keys wrap around, so only draws of the very same mesh are merged into one instanced draw
+        while(i < draws.length() && numInstances < Model::MAX_INSTANCES)
+        {
+            MeshDraw& draw = draws[i];
+            if(DrawList::getBatchKey(draw.sortKey) != batchKey || draw.model.getWeakRefIndex() != modelIndex || draw.meshIndex != first.meshIndex)
+                break;
+            transforms[numInstances++] = draw.transform;
+            i++;
+        }
+        Model* pModel = first.model.get();
+        if(pModel != nullptr)
+            pModel->drawMesh(m_pDeviceContext, first.meshIndex, ArrayPtr<mat4>(transforms, numInstances), m_view, m_projection, state);
+    }
+}
+
 void gep::Renderer::execute2DCommands(RendererExtractor& extractor, CommandBase* currentCommand)
 {
     BeginDebugMarker(L"2D Rendering");
@@ -596,7 +645,7 @@ void gep::Renderer::execute2DCommands(RendererExtractor& extractor, CommandBase*
         switch(currentCommand->getType())
         {
         // skip 3d commands
-        case CommandType::RenderModel:
+        case CommandType::DrawMeshes:
         case CommandType::Camera:
             break;
         case CommandType::DebugMarkerBegin:
@@ -685,7 +734,7 @@ LRESULT CALLBACK gep::Renderer::WndProc( HWND hWnd, UINT message, WPARAM wParam,
 
 gep::Texture2D* gep::Renderer::createTexture2D(const char* name, ITexture2DLoader* pLoader, TextureMode mode)
 {
-    return new Texture2D(name, pLoader, m_pd3dDevice, m_pDeviceContext, mode);
+    return new Texture2D(name, pLoader, m_pd3dDevice, m_pDeviceContext, mode, m_pTextureStreaming);
 }
 
 gep::Shader* gep::Renderer::createShader()
@@ -1039,14 +1088,6 @@ void gep::DebugRenderer::extract(IRendererExtractor& extractor)
                 cmd.color = textInfo.color;
 
                 auto len = strlen(textInfo.text);
-
-                #ifdef _DEBUG
-                for (size_t i = 0; i < len; i++)
-                {
-                    GEP_ASSERT(textInfo.text[i] > 0, "ascii string contains non-ascii characters. Please use wide char version to print non ascii characters");
-                }
-                #endif // _DEBUG
-
                 cmd.text = GEP_NEW_ARRAY(extractor.getCurrentAllocator(), char, len + 1).getPtr();
                 memcpy((void*)cmd.text, textInfo.text, len + 1);
             }
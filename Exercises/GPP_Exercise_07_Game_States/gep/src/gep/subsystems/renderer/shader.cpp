@@ -10,6 +10,8 @@
 #include "gep/exception.h"
 #include "gep/globalManager.h"
 #include "gep/interfaces/logging.h"
+#include "gep/interfaces/resourceManager.h"
+#include "gep/archive.h"
 
 #include <d3d11.h>
 #include <D3DX11.h>
@@ -100,6 +102,8 @@ const char* gep::ShaderFileLoader::getResourceId()
     return m_filename.c_str();
 }
 
+volatile gep::uint32 gep::Shader::s_nextSortId = 0;
+
 gep::Shader::Shader(ID3D11Device* pDevice)
     : m_pEffect(nullptr),
     m_pLoader(nullptr),
@@ -107,6 +111,8 @@ gep::Shader::Shader(ID3D11Device* pDevice)
     m_pTechnique(nullptr),
     m_pByteCode(nullptr)
 {
+    // shaders are created by the loader threads as well
+    m_sortId = InterlockedIncrement(&s_nextSortId);
 }
 
 gep::Shader::~Shader()
@@ -179,25 +185,25 @@ gep::uint32 gep::Shader::getFinalizeOptions()
 
 void gep::Shader::loadFromFX(const char* filename)
 {
+    FileView fileView;
+    if(g_globalManager.getResourceManager()->getFileSystem().open(filename, fileView) != SUCCESS)
+    {
+        std::ostringstream msg;
+        msg << "The file '" << filename << "' could not be opened";
+
+        throw LoadingError(msg.str());
+    }
+
     ID3D10Blob* pByteCode = nullptr;
     ID3D10Blob* pErrors = nullptr;
     HRESULT hr;
-    hr = D3DX11CompileFromFileA(filename, nullptr, nullptr, nullptr, "fx_5_0",
+    // the filename is only used in error messages
+    hr = D3DX11CompileFromMemory((LPCSTR)fileView.getData().getPtr(), fileView.length(), filename, nullptr, nullptr, nullptr, "fx_5_0",
         //D3D10_SHADER_OPTIMIZATION_LEVEL2 | D3D10_SHADER_PACK_MATRIX_COLUMN_MAJOR,
         D3D10_SHADER_DEBUG | D3D10_SHADER_PACK_MATRIX_COLUMN_MAJOR,
         0, nullptr, &pByteCode, &pErrors, nullptr);
     if( FAILED(hr) )
     {
-        if(hr == D3D11_ERROR_FILE_NOT_FOUND)
-        {
-            if(pErrors) pErrors->Release();
-            if(pByteCode) pByteCode->Release();
-
-            std::ostringstream msg;
-            msg << "The file '" << filename << "' could not be opened";
-
-            throw LoadingError(msg.str());
-        }
         auto ex = LoadingError(std::string((pErrors != nullptr) ? (char*)pErrors->GetBufferPointer() : nullptr,
                                            (pErrors != nullptr) ? pErrors->GetBufferSize() : 0));
         if(pErrors) pErrors->Release();
@@ -332,6 +338,23 @@ void gep::ShaderConstant<gep::mat4>::set(mat4& value)
     }
 }
 
+void gep::ShaderConstant<gep::mat4>::setArray(ArrayPtr<mat4> values)
+{
+    checkUpToDate();
+    if(m_isValid && values.length() > 0)
+    {
+        static_assert(sizeof(mat4) == sizeof(float) * 16, "the matrices have to be tightly packed");
+        m_pVar->SetMatrixArray(values[0].data, 0, (uint32_t)values.length());
+    }
+}
+
+bool gep::ShaderConstant<gep::mat4>::isPresent()
+{
+    checkUpToDate();
+    // the effect returns a dummy variable for unknown names which ignores all values
+    return m_isValid && m_pVar->IsValid() != FALSE;
+}
+
 void gep::ShaderConstant<gep::Texture2D>::set(ResourcePtr<Texture2D> value)
 {
     checkUpToDate();
@@ -2,8 +2,13 @@
 #include "gepimpl/subsystems/renderer/texture2d.h"
 #include "gep/globalManager.h"
 #include "gep/interfaces/logging.h"
+#include "gep/interfaces/memoryManager.h"
 #include "gepimpl/subsystems/renderer/renderer.h"
 #include "gepimpl/subsystems/renderer/ddsLoader.h"
+#include "gepimpl/subsystems/renderer/textureStreaming.h"
+#include "gep/textureStreamer.h"
+#include "gep/imageProcessing.h"
+#include "gep/threading/taskQueue.h"
 
 gep::IResource* gep::ITexture2DLoader::loadResource(IResource* pInPlace)
 {
@@ -71,8 +76,10 @@ gep::Texture2D* gep::Texture2DFileLoader::loadResource(Texture2D* pInPlace)
         isInPlace = false;
     }
     try {
-        DDSLoader loader(&g_stdAllocator);
-        loader.loadFile(m_filename.c_str());
+        // streamed textures start with their smallest mipmaps, the texture streaming loads the larger ones when they are needed
+        const bool isStreamed = m_pRenderer->getTextureStreaming() != nullptr;
+        DDSLoader loader(g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Resources));
+        loader.loadFile(m_filename.c_str(), isStreamed ? TextureStreamer::MIN_RESIDENT_SIZE : 0);
         if(loader.isCubemap())
         {
             if(!isInPlace)
@@ -99,11 +106,11 @@ gep::Texture2D* gep::Texture2DFileLoader::loadResource(Texture2D* pInPlace)
             compression = ImageCompression::PRECOMPRESSED;
             break;
         case DDSLoader::D3DFORMAT::DXT3:
-            format = ImageFormat::COMPRESSED_RGB_DXT1;
+            format = ImageFormat::COMPRESSED_RGBA_DXT3;
             compression = ImageCompression::PRECOMPRESSED;
             break;
         case DDSLoader::D3DFORMAT::DXT5:
-            format = ImageFormat::COMPRESSED_RGB_DXT1;
+            format = ImageFormat::COMPRESSED_RGBA_DXT5;
             compression = ImageCompression::PRECOMPRESSED;
             break;
         default:
@@ -117,6 +124,11 @@ gep::Texture2D* gep::Texture2DFileLoader::loadResource(Texture2D* pInPlace)
 
         auto data = loader.getData();
         result->getImageData().setData(data, data->imageData, data->width, data->height, format, compression);
+        if(isStreamed)
+        {
+            const uint32 bytesPerBlock = (loader.getDataFormat() == DDSLoader::D3DFORMAT::DXT1) ? 8 : 16;
+            result->setStreamingInfo(loader.getWidth(), loader.getHeight(), loader.getNumMipmaps(), loader.getFirstMipmap(), bytesPerBlock);
+        }
         result->setHasData(true);
         return result;
     }
@@ -164,12 +176,26 @@ gep::Texture2D* gep::GeneratorTextureLoader::loadResource(Texture2D* pInPlace)
     bool isInPlace = true;
     if(pInPlace == nullptr)
     {
-        result = m_pRenderer->createTexture2D(m_resourceId.c_str(), this, TextureMode::Dynamic);
-        result->createEmpty(m_width, m_height, ImageFormat::RGBA8);
+        result = m_pRenderer->createTexture2D(m_resourceId.c_str(), this, TextureMode::Static);
         isInPlace = false;
     }
     try {
-        m_generatorFunction(result->getImageData().getData()[0]);
+        DynamicArray<uint8> pixels;
+        pixels.resize(m_width * m_height * 4);
+        m_generatorFunction(pixels.toArray());
+
+        // block compressed textures have to be a multiple of 4 pixels in size, the others at least get mipmaps
+        const bool isCompressed = (m_width % 4 == 0) && (m_height % 4 == 0);
+        auto pAllocator = g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Resources);
+        auto mipmaps = image::createMipmaps(pAllocator, pixels.toArray(), m_width, m_height,
+                                            isCompressed ? image::BlockCompression::BC3 : image::BlockCompression::None,
+                                            g_globalManager.getTaskQueue());
+        auto& imageData = result->getImageData();
+        imageData.free();
+        if(isCompressed)
+            imageData.setData(pAllocator, mipmaps, m_width, m_height, ImageFormat::COMPRESSED_RGBA_DXT5, ImageCompression::PRECOMPRESSED);
+        else
+            imageData.setData(pAllocator, mipmaps, m_width, m_height, ImageFormat::RGBA8, ImageCompression::NONE);
         if(!isInPlace)
             result->setHasData(true);
         return result;
@@ -197,7 +223,7 @@ const char* gep::GeneratorTextureLoader::getResourceId()
     return m_resourceId.c_str();
 }
 
-gep::Texture2D::Texture2D(const char* name, ITexture2DLoader* pLoader, ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, TextureMode mode) :
+gep::Texture2D::Texture2D(const char* name, ITexture2DLoader* pLoader, ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, TextureMode mode, TextureStreaming* pStreaming) :
     m_pLoader(pLoader),
     m_name(name),
     m_pDevice(pDevice),
@@ -205,7 +231,18 @@ gep::Texture2D::Texture2D(const char* name, ITexture2DLoader* pLoader, ID3D11Dev
     m_pTexture(nullptr),
     m_hasData(false),
     m_pResourceView(nullptr),
-    m_mode(mode)
+    m_mode(mode),
+    m_gpuWidth(0),
+    m_gpuHeight(0),
+    m_gpuFormat(ImageFormat::RGBA8),
+    m_pStreaming(pStreaming),
+    m_streamingId(TextureStreamer::INVALID_ID),
+    m_hasNewStreamingInfo(false),
+    m_fileWidth(0),
+    m_fileHeight(0),
+    m_numFileMipmaps(0),
+    m_firstMipmap(0),
+    m_bytesPerBlock(0)
 {
 }
 
@@ -257,11 +294,63 @@ void gep::Texture2D::createEmpty(uint32 width, uint32 height, ImageFormat format
 
 void gep::Texture2D::unload()
 {
+    if(m_streamingId != TextureStreamer::INVALID_ID)
+    {
+        m_pStreaming->removeTexture(m_streamingId);
+        m_streamingId = TextureStreamer::INVALID_ID;
+    }
     GEP_RELEASE_AND_NULL(m_pResourceView)
     GEP_RELEASE_AND_NULL(m_pTexture)
 }
 
+void gep::Texture2D::setStreamingInfo(uint32 fileWidth, uint32 fileHeight, uint32 numFileMipmaps, uint32 firstMipmap, uint32 bytesPerBlock)
+{
+    m_fileWidth = fileWidth;
+    m_fileHeight = fileHeight;
+    m_numFileMipmaps = numFileMipmaps;
+    m_firstMipmap = firstMipmap;
+    m_bytesPerBlock = bytesPerBlock;
+    m_hasNewStreamingInfo = true;
+}
+
+void gep::Texture2D::setStreamedMipmaps(DDSData* pData, uint32 firstMipmap)
+{
+    m_data.setData(pData, pData->imageData, pData->width, pData->height, m_data.getFormat(), ImageCompression::PRECOMPRESSED);
+    m_firstMipmap = firstMipmap;
+    upload();
+}
+
+void gep::Texture2D::dropMipmaps(uint32 firstMipmap)
+{
+    GEP_ASSERT(firstMipmap > m_firstMipmap && firstMipmap - m_firstMipmap < m_data.getData().length(), "invalid mipmap", firstMipmap, m_firstMipmap);
+    // the remaining mipmaps are copied so that the memory of the dropped ones is freed
+    const uint32 numDropped = firstMipmap - m_firstMipmap;
+    SmartPtr<DDSData> pData = DDSData::copyMipmaps(g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Resources),
+                                                   m_data.getData()(numDropped, m_data.getData().length()),
+                                                   (uint32)GEP_MAX(m_data.getWidth() >> numDropped, 1),
+                                                   (uint32)GEP_MAX(m_data.getHeight() >> numDropped, 1));
+    setStreamedMipmaps(pData.get(), firstMipmap);
+}
+
 void gep::Texture2D::finalize()
+{
+    upload();
+
+    if(m_hasNewStreamingInfo)
+    {
+        m_hasNewStreamingInfo = false;
+        if(m_streamingId != TextureStreamer::INVALID_ID)
+        {
+            m_pStreaming->removeTexture(m_streamingId);
+            m_streamingId = TextureStreamer::INVALID_ID;
+        }
+        // textures which were loaded completely have nothing to stream
+        if(m_pStreaming != nullptr && m_firstMipmap > 0)
+            m_streamingId = m_pStreaming->addTexture(this, m_fileWidth, m_fileHeight, m_numFileMipmaps, m_bytesPerBlock, m_firstMipmap);
+    }
+}
+
+void gep::Texture2D::upload()
 {
     if(m_mode == TextureMode::Dynamic &&
         m_pTexture != nullptr &&
@@ -273,10 +362,12 @@ void gep::Texture2D::finalize()
         D3D11_MAPPED_SUBRESOURCE res;
         auto hr = m_pDeviceContext->Map(m_pTexture, 0, D3D11_MAP_WRITE_DISCARD, 0, &res);
         GEP_ASSERT(SUCCEEDED(hr));
-        res.RowPitch = 0;
-        res.DepthPitch = 0;
+        // the rows of the mapped texture may be padded
         auto newData = m_data.getData()[0];
-        memcpy(res.pData, newData.getPtr(), newData.length());
+        const size_t rowSize = m_data.getWidth() * m_data.getSizeOfComponent() * m_data.getNumberOfComponents();
+        GEP_ASSERT(res.RowPitch >= rowSize && newData.length() >= rowSize * m_data.getHeight());
+        for(size_t y = 0; y < m_data.getHeight(); y++)
+            memcpy((uint8*)res.pData + y * res.RowPitch, newData.getPtr() + y * rowSize, rowSize);
         m_pDeviceContext->Unmap(m_pTexture, 0);
     }
     else
@@ -307,10 +398,11 @@ void gep::Texture2D::finalize()
             buffer[i].pSysMem = mipmapLevel.getPtr();
             if(m_data.isCompressed())
             {
+                // a row of blocks, partial blocks at the right edge count as whole ones
                 if(m_data.getFormat() == ImageFormat::COMPRESSED_RGBA_DXT1 || m_data.getFormat() == ImageFormat::COMPRESSED_RGB_DXT1)
-                    buffer[i].SysMemPitch = (UINT)(8 * GEP_MAX(mipWidth / 4, 1));
+                    buffer[i].SysMemPitch = (UINT)(8 * ((mipWidth + 3) / 4));
                 else
-                    buffer[i].SysMemPitch = (UINT)(16 * GEP_MAX(mipWidth / 4, 1));
+                    buffer[i].SysMemPitch = (UINT)(16 * ((mipWidth + 3) / 4));
             }
             else
             {
@@ -318,7 +410,7 @@ void gep::Texture2D::finalize()
             }
             buffer[i].SysMemSlicePitch = 0;
             i++;
-            mipWidth /= 2;
+            mipWidth = GEP_MAX(mipWidth / 2, 1);
         }
 
         HRESULT hr = m_pDevice->CreateTexture2D(&desc, buffer, &m_pTexture);
@@ -331,5 +423,9 @@ void gep::Texture2D::finalize()
         resDesc.Texture2D.MipLevels = (UINT)m_data.getData().length();
         hr = m_pDevice->CreateShaderResourceView(m_pTexture, &resDesc, &m_pResourceView);
         GEP_ASSERT(SUCCEEDED(hr), "failed to create shader resource view");
+
+        m_gpuWidth = m_data.getWidth();
+        m_gpuHeight = m_data.getHeight();
+        m_gpuFormat = m_data.getFormat();
     }
 }
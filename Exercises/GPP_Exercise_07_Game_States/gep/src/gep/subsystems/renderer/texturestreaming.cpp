@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/renderer/textureStreaming.h"
+#include "gepimpl/subsystems/renderer/texture2d.h"
+#include "gepimpl/subsystems/renderer/ddsLoader.h"
+#include "gepimpl/subsystems/renderer/extractor.h"
+#include "gep/globalManager.h"
+#include "gep/interfaces/logging.h"
+#include "gep/interfaces/memoryManager.h"
+
+gep::TextureStreaming::TextureStreaming(size_t budget) :
+    m_streamer(budget),
+    m_requestCounter(0),
+    m_pThread(nullptr),
+    m_isRunning(false)
+{
+    m_pThread = new TextureStreamingThread(this);
+}
+
+gep::TextureStreaming::~TextureStreaming()
+{
+    GEP_ASSERT(m_isRunning == false, "texture streaming should not be running");
+    delete m_pThread;
+    for(auto pLoad : m_requests)
+        delete pLoad;
+    for(auto pLoad : m_finished)
+        delete pLoad;
+}
+
+void gep::TextureStreaming::start()
+{
+    m_isRunning = true;
+    m_pThread->start();
+}
+
+void gep::TextureStreaming::stop()
+{
+    if(!m_isRunning)
+        return;
+    m_isRunning = false;
+    // wake up the thread so it can notice that it should quit
+    m_requestCounter.increment();
+    m_pThread->join();
+}
+
+gep::uint32 gep::TextureStreaming::addTexture(Texture2D* pTexture, uint32 width, uint32 height, uint32 numMipmaps, uint32 bytesPerBlock, uint32 firstMipmap)
+{
+    ScopedLock<Mutex> lock(m_mutex);
+    uint32 id = m_streamer.addTexture(width, height, numMipmaps, bytesPerBlock, firstMipmap);
+    while(id >= m_entries.length())
+    {
+        Entry entry;
+        entry.pTexture = nullptr;
+        entry.serial = 0;
+        m_entries.append(entry);
+    }
+    auto& entry = m_entries[id];
+    entry.pTexture = pTexture;
+    entry.serial++;
+    entry.width = width;
+    entry.height = height;
+    entry.numMipmaps = numMipmaps;
+    return id;
+}
+
+void gep::TextureStreaming::removeTexture(uint32 id)
+{
+    ScopedLock<Mutex> lock(m_mutex);
+    GEP_ASSERT(id < m_entries.length() && m_entries[id].pTexture != nullptr, "invalid texture streaming id", id);
+    m_streamer.removeTexture(id);
+    m_entries[id].pTexture = nullptr;
+    m_entries[id].serial++;
+}
+
+void gep::TextureStreaming::update(ArrayPtr<TextureUsage> usages, float screenHeight)
+{
+    ScopedLock<Mutex> lock(m_mutex);
+
+    {
+        ScopedLock<Mutex> queueLock(m_queueMutex);
+        m_finishedToApply.append(m_finished.toArray());
+        m_finished.resize(0);
+    }
+    for(auto pLoad : m_finishedToApply)
+    {
+        // the texture may have been deleted while its mipmaps were loaded
+        auto& entry = m_entries[pLoad->id];
+        if(entry.pTexture != nullptr && entry.serial == pLoad->serial)
+        {
+            uint32 firstMipmap = m_streamer.getFirstResidentMip(pLoad->id);
+            if(pLoad->pData.get() != nullptr && pLoad->firstMipmap < firstMipmap)
+            {
+                entry.pTexture->setStreamedMipmaps(pLoad->pData.get(), pLoad->firstMipmap);
+                firstMipmap = pLoad->firstMipmap;
+            }
+            m_streamer.finishLoad(pLoad->id, firstMipmap);
+        }
+        delete pLoad;
+    }
+    m_finishedToApply.resize(0);
+
+    for(auto& usage : usages)
+    {
+        // the id may belong to a texture which was deleted after the frame was extracted
+        if(usage.streamingId < m_entries.length() && m_entries[usage.streamingId].pTexture != nullptr)
+            m_streamer.addUsage(usage.streamingId, usage.screenHeight * screenHeight);
+    }
+
+    m_loads.resize(0);
+    m_evictions.resize(0);
+    m_streamer.update(m_loads, m_evictions);
+
+    for(auto& eviction : m_evictions)
+        m_entries[eviction.id].pTexture->dropMipmaps(eviction.firstMip);
+
+    for(auto& request : m_loads)
+    {
+        auto& entry = m_entries[request.id];
+        Load* pLoad = new Load();
+        pLoad->id = request.id;
+        pLoad->serial = entry.serial;
+        pLoad->filename = entry.pTexture->getName();
+        pLoad->maxSize = GEP_MAX(entry.width, entry.height) >> request.firstMip;
+        pLoad->width = entry.width;
+        pLoad->height = entry.height;
+        pLoad->numMipmaps = entry.numMipmaps;
+        pLoad->firstMipmap = TextureStreamer::INVALID_ID;
+        {
+            ScopedLock<Mutex> queueLock(m_queueMutex);
+            m_requests.append(pLoad);
+        }
+        m_requestCounter.increment();
+    }
+}
+
+bool gep::TextureStreaming::takeRequest(Load*& pLoad)
+{
+    ScopedLock<Mutex> lock(m_queueMutex);
+    if(m_requests.length() == 0)
+        return false;
+    pLoad = m_requests[0];
+    m_requests.removeAtIndex(0);
+    return true;
+}
+
+void gep::TextureStreaming::load(Load& load)
+{
+    try
+    {
+        DDSLoader loader(g_globalManager.getMemoryManager()->getAllocator(MemoryCategory::Resources));
+        loader.loadFile(load.filename.c_str(), load.maxSize);
+        // the file may have been changed since the texture was loaded
+        if(loader.getWidth() != load.width || loader.getHeight() != load.height || loader.getNumMipmaps() != load.numMipmaps)
+        {
+            g_globalManager.getLogging()->logWarning("Texture '%s' changed on disk, its mipmaps are not streamed until it is reloaded", load.filename.c_str());
+        }
+        else
+        {
+            load.pData = loader.getData();
+            load.firstMipmap = loader.getFirstMipmap();
+        }
+    }
+    catch(LoadingError& ex)
+    {
+        g_globalManager.getLogging()->logError("Error streaming mipmaps of texture '%s':\n%s", load.filename.c_str(), ex.what());
+    }
+
+    ScopedLock<Mutex> lock(m_queueMutex);
+    m_finished.append(&load);
+}
+
+gep::TextureStreamingThread::TextureStreamingThread(TextureStreaming* pStreaming) :
+    m_pStreaming(pStreaming)
+{
+}
+
+void gep::TextureStreamingThread::run()
+{
+    while(m_pStreaming->m_isRunning)
+    {
+        m_pStreaming->m_requestCounter.waitAndDecrement();
+        TextureStreaming::Load* pLoad = nullptr;
+        // We might got signaled to quit, check this
+        while(m_pStreaming->m_isRunning && m_pStreaming->takeRequest(pLoad))
+        {
+            m_pStreaming->load(*pLoad);
+        }
+    }
+}
@@ -13,16 +13,22 @@ const char* gep::Vertexbuffer::dataChannelToString(DataChannel channel)
     case DataChannel::COLOR:
         return "COLOR";
     case DataChannel::NORMAL:
+    case DataChannel::NORMAL_OCTAHEDRAL:
         return "NORMAL";
     case DataChannel::BINORMAL:
+    case DataChannel::BINORMAL_OCTAHEDRAL:
         return "BINORMAL";
     case DataChannel::TANGENT:
+    case DataChannel::TANGENT_OCTAHEDRAL:
         return "TANGENT";
     case DataChannel::TEXCOORD0:
+    case DataChannel::TEXCOORD0_HALF:
         return "TEXCOORD";
     case DataChannel::BONE_INDICES:
+    case DataChannel::BONE_INDICES_16:
         return "BONE_INDICES";
     case DataChannel::BONE_WEIGHTS:
+    case DataChannel::BONE_WEIGHTS_8:
         return "BONE_WEIGHTS";
     default:
         GEP_ASSERT(false, "value not handeled");
@@ -61,6 +67,24 @@ void gep::Vertexbuffer::fillInputElementDesc(DataChannel channel, D3D11_INPUT_EL
         desc.Format = DXGI_FORMAT_R32_FLOAT;
         accumulatedOffset += 4 * sizeof(float);
         break;
+    case DataChannel::NORMAL_OCTAHEDRAL:
+    case DataChannel::BINORMAL_OCTAHEDRAL:
+    case DataChannel::TANGENT_OCTAHEDRAL:
+        desc.Format = DXGI_FORMAT_R16G16_SNORM;
+        accumulatedOffset += 2 * sizeof(int16);
+        break;
+    case DataChannel::TEXCOORD0_HALF:
+        desc.Format = DXGI_FORMAT_R16G16_FLOAT;
+        accumulatedOffset += 2 * sizeof(uint16);
+        break;
+    case DataChannel::BONE_INDICES_16:
+        desc.Format = DXGI_FORMAT_R16G16B16A16_UINT;
+        accumulatedOffset += 4 * sizeof(uint16);
+        break;
+    case DataChannel::BONE_WEIGHTS_8:
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        accumulatedOffset += 4 * sizeof(uint8);
+        break;
     default:
         GEP_ASSERT(false, "value not handeled");
     }
@@ -86,6 +110,14 @@ gep::uint32 gep::Vertexbuffer::dataChannelByteCount(DataChannel channel)
         return sizeof(float) * 4;
     case DataChannel::BONE_INDICES:
         return sizeof(uint32) * 4;
+    case DataChannel::NORMAL_OCTAHEDRAL:
+    case DataChannel::BINORMAL_OCTAHEDRAL:
+    case DataChannel::TANGENT_OCTAHEDRAL:
+    case DataChannel::TEXCOORD0_HALF:
+    case DataChannel::BONE_WEIGHTS_8:
+        return sizeof(uint32);
+    case DataChannel::BONE_INDICES_16:
+        return sizeof(uint16) * 4;
     default:
         GEP_ASSERT(false, "value not handeled");
     }
@@ -108,6 +140,14 @@ gep::uint32 gep::Vertexbuffer::getDataChannelSize(DataChannel channel)
     case DataChannel::BONE_WEIGHTS:
     case DataChannel::BONE_INDICES:
         return 4;
+    case DataChannel::NORMAL_OCTAHEDRAL:
+    case DataChannel::BINORMAL_OCTAHEDRAL:
+    case DataChannel::TANGENT_OCTAHEDRAL:
+    case DataChannel::TEXCOORD0_HALF:
+    case DataChannel::BONE_WEIGHTS_8:
+        return 1;
+    case DataChannel::BONE_INDICES_16:
+        return 2;
     default:
         GEP_ASSERT(false, "value not handeled");
     }
@@ -128,10 +168,11 @@ gep::uint32 gep::Vertexbuffer::primitiveNumElements(Primitive primitive)
     return 0;
 }
 
-gep::Vertexbuffer::Vertexbuffer(ID3D11Device* pDevice, ArrayPtr<DataChannel> dataChannels, Primitive primitive, Usage usage) :
+gep::Vertexbuffer::Vertexbuffer(ID3D11Device* pDevice, ArrayPtr<DataChannel> dataChannels, Primitive primitive, Usage usage, IndexFormat indexFormat) :
     m_pDevice(pDevice),
     m_usage(usage),
     m_primitive(primitive),
+    m_indexFormat(indexFormat),
     m_isDataUploaded(false),
     m_areIndicesUploaded(false),
     m_hasIndexBuffer(false),
@@ -209,41 +250,43 @@ void gep::Vertexbuffer::upload(ID3D11DeviceContext* pDeviceContext)
         }
     }
 
-    if(m_areIndicesUploaded && m_uploadedIndices < m_indices.length())
+    const size_t numIndices = getNumIndices();
+    const size_t indexSize = (m_indexFormat == IndexFormat::UInt16) ? sizeof(uint16) : sizeof(uint32);
+    const void* pIndexData = (m_indexFormat == IndexFormat::UInt16) ? (const void*)m_indices16.toArray().getPtr() : (const void*)m_indices.toArray().getPtr();
+    if(m_areIndicesUploaded && m_uploadedIndices < numIndices)
     {
         m_pIndexBuffer->Release();
         m_pIndexBuffer = nullptr;
         m_areIndicesUploaded = false;
     }
-    if(m_indices.length() > 0)
+    if(numIndices > 0)
     {
         m_hasIndexBuffer = true;
         if(!m_areIndicesUploaded)
         {
             m_indexDesc.Usage = (m_usage == Usage::Dynamic) ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
-            m_indexDesc.ByteWidth = (UINT)(m_indices.length() * sizeof( uint32 ));
+            m_indexDesc.ByteWidth = (UINT)(numIndices * indexSize);
             m_indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
             m_indexDesc.CPUAccessFlags = (m_usage == Usage::Dynamic) ? D3D11_CPU_ACCESS_WRITE : 0;
             m_indexDesc.MiscFlags = 0;
 
             HRESULT hr = S_OK;
             D3D11_SUBRESOURCE_DATA initData;
-            initData.pSysMem = m_indices.toArray().getPtr();
+            initData.pSysMem = pIndexData;
             hr = m_pDevice->CreateBuffer(&m_indexDesc, &initData, &m_pIndexBuffer);
             if(FAILED(hr))
                 throw Exception("Failed to create vertex index buffer");
 
             m_areIndicesUploaded = true;
             m_hasIndexBuffer = true;
-            m_uploadedIndices = m_indices.length();
+            m_uploadedIndices = numIndices;
         }
         else
         {
             D3D11_MAPPED_SUBRESOURCE res;
             HRESULT hr = pDeviceContext->Map(m_pIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &res);
             GEP_ASSERT(SUCCEEDED(hr));
-            auto newData = m_indices.toArray();
-            memcpy(res.pData, newData.getPtr(), newData.length() * sizeof(uint32));
+            memcpy(res.pData, pIndexData, numIndices * indexSize);
             pDeviceContext->Unmap(m_pIndexBuffer, 0);
         }
     }
@@ -260,7 +303,7 @@ void gep::Vertexbuffer::use(ID3D11DeviceContext* pDeviceContext)
     UINT offset = 0;
     pDeviceContext->IASetVertexBuffers(0, 1, &m_pDataBuffer, &stride, &offset);
     if(m_hasIndexBuffer)
-        pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, (m_indexFormat == IndexFormat::UInt16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
     switch(m_primitive)
     {
     case Primitive::Triangle:
@@ -278,7 +321,7 @@ void gep::Vertexbuffer::draw(ID3D11DeviceContext* pDeviceContext)
 {
     if(m_hasIndexBuffer)
     {
-        pDeviceContext->DrawIndexed((UINT)m_indices.length(), 0, 0);
+        pDeviceContext->DrawIndexed((UINT)getNumIndices(), 0, 0);
     }
     else
     {
@@ -286,14 +329,26 @@ void gep::Vertexbuffer::draw(ID3D11DeviceContext* pDeviceContext)
     }
 }
 
-void gep::Vertexbuffer::draw(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices)
+void gep::Vertexbuffer::draw(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices, int32 baseVertex)
 {
     if(m_hasIndexBuffer)
     {
-        pDeviceContext->DrawIndexed(numIndices, startIndex, 0);
+        pDeviceContext->DrawIndexed(numIndices, startIndex, baseVertex);
     }
     else
     {
         pDeviceContext->Draw(numIndices, startIndex);
     }
 }
+
+void gep::Vertexbuffer::drawInstanced(ID3D11DeviceContext* pDeviceContext, uint32 startIndex, uint32 numIndices, int32 baseVertex, uint32 numInstances)
+{
+    if(m_hasIndexBuffer)
+    {
+        pDeviceContext->DrawIndexedInstanced(numIndices, numInstances, startIndex, baseVertex, 0);
+    }
+    else
+    {
+        pDeviceContext->DrawInstanced(numIndices, numInstances, startIndex, 0);
+    }
+}
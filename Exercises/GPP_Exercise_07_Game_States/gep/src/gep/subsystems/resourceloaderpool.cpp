@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "gepimpl/subsystems/resourceLoaderPool.h"
+#include "gep/exception.h"
+#include "gep/globalManager.h"
+#include "gep/interfaces/logging.h"
+
+gep::ResourceLoaderPool::ResourceLoaderPool(uint32 numThreads, FinishedCallback onFinished) :
+    m_toLoadCounter(0),
+    m_onFinished(onFinished),
+    m_isRunning(false)
+{
+    GEP_ASSERT(numThreads > 0, "the resource loader needs at least one thread");
+    for(uint32 i=0; i < numThreads; i++)
+    {
+        m_threads.append(new ResourceLoaderThread(this));
+    }
+}
+
+gep::ResourceLoaderPool::~ResourceLoaderPool()
+{
+    GEP_ASSERT(m_isRunning == false, "resource loader should not be running");
+    for(auto pThread : m_threads)
+    {
+        delete pThread;
+    }
+    for(auto& resourcesToLoad : m_resourcesToLoad)
+    {
+        for(auto& info : resourcesToLoad)
+        {
+            info.pLoader->release();
+        }
+    }
+}
+
+void gep::ResourceLoaderPool::start()
+{
+    m_isRunning = true;
+    for(auto pThread : m_threads)
+    {
+        pThread->start();
+    }
+}
+
+void gep::ResourceLoaderPool::stop()
+{
+    m_isRunning = false;
+    // wake up every thread so it can notice that it should quit
+    for(size_t i=0; i < m_threads.length(); i++)
+    {
+        m_toLoadCounter.increment();
+    }
+    for(auto pThread : m_threads)
+    {
+        pThread->join();
+    }
+}
+
+void gep::ResourceLoaderPool::loadResource(ResourcePtr<IResource> ptr, IResourceLoader* pLoader, LoadPriority::Enum priority)
+{
+    GEP_ASSERT(priority >= 0 && priority < LoadPriority::Count, "invalid load priority", priority);
+    ToLoadInfo info;
+    info.ptr = ptr;
+    info.pLoader = pLoader;
+    {
+        ScopedLock<Mutex> lock(m_resourcesToLoadMutex);
+        int queuedPriority = 0;
+        size_t index = 0;
+        if(findQueued(pLoader->getResourceId(), queuedPriority, index))
+        {
+            auto& queued = m_resourcesToLoad[queuedPriority][index];
+            if(queued.ptr.isValid() && queued.ptr.getWeakRefIndex() == ptr.getWeakRefIndex())
+            {
+                // already waiting, a thread has been woken up for it already
+                pLoader->release();
+                if(queuedPriority < priority)
+                {
+                    m_resourcesToLoad[priority].append(queued);
+                    m_resourcesToLoad[queuedPriority].removeAtIndex(index);
+                }
+                return;
+            }
+            if(!queued.ptr.isValid())
+            {
+                // canceled, the new request takes its place
+                queued.pLoader->release();
+                m_resourcesToLoad[queuedPriority].removeAtIndex(index);
+            }
+        }
+        m_resourcesToLoad[priority].append(info);
+    }
+    // The semaphore saturates at 255, this is fine because
+    // the threads keep on loading until all queues are empty.
+    m_toLoadCounter.increment();
+}
+
+void gep::ResourceLoaderPool::raisePriority(const char* resourceId, LoadPriority::Enum priority)
+{
+    ScopedLock<Mutex> lock(m_resourcesToLoadMutex);
+    int queuedPriority = 0;
+    size_t index = 0;
+    if(findQueued(resourceId, queuedPriority, index) && queuedPriority < priority)
+    {
+        m_resourcesToLoad[priority].append(m_resourcesToLoad[queuedPriority][index]);
+        m_resourcesToLoad[queuedPriority].removeAtIndex(index);
+    }
+}
+
+bool gep::ResourceLoaderPool::findQueued(const char* resourceId, int& priority, size_t& index)
+{
+    for(priority = 0; priority < LoadPriority::Count; priority++)
+    {
+        auto& resourcesToLoad = m_resourcesToLoad[priority];
+        for(index = 0; index < resourcesToLoad.length(); index++)
+        {
+            if(strcmp(resourcesToLoad[index].pLoader->getResourceId(), resourceId) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+bool gep::ResourceLoaderPool::takeNext(ToLoadInfo& info)
+{
+    ScopedLock<Mutex> lock(m_resourcesToLoadMutex);
+    for(int priority = LoadPriority::Count - 1; priority >= 0; priority--)
+    {
+        auto& resourcesToLoad = m_resourcesToLoad[priority];
+        if(resourcesToLoad.length() > 0)
+        {
+            info = resourcesToLoad[0];
+            resourcesToLoad.removeAtIndex(0);
+            return true;
+        }
+    }
+    return false;
+}
+
+void gep::ResourceLoaderPool::load(ToLoadInfo& info)
+{
+    // canceled before we got to it
+    if(!info.ptr.isValid())
+    {
+        info.pLoader->release();
+        return;
+    }
+
+    IResource* pResult = nullptr;
+    try
+    {
+        pResult = info.pLoader->loadResource(nullptr);
+        if(pResult != nullptr)
+            pResult->setLoader(info.pLoader);
+    }
+    catch(LoadingError& ex)
+    {
+        g_globalManager.getLogging()->logError("%s", ex.what());
+    }
+
+    if(pResult == nullptr)
+    {
+        info.pLoader->release();
+    }
+    else if(!info.ptr.isValid()) // canceled while loading
+    {
+        pResult->unload();
+        info.pLoader->deleteResource(pResult);
+        info.pLoader->release();
+    }
+    else
+    {
+        m_onFinished(info.ptr, pResult, info.pLoader);
+    }
+}
+
+gep::ResourceLoaderThread::ResourceLoaderThread(ResourceLoaderPool* pPool) :
+    m_pPool(pPool)
+{
+}
+
+void gep::ResourceLoaderThread::run()
+{
+    while(m_pPool->m_isRunning)
+    {
+        m_pPool->m_toLoadCounter.waitAndDecrement();
+        ResourceLoaderPool::ToLoadInfo info;
+        // We might got signaled to quit, check this
+        while(m_pPool->m_isRunning && m_pPool->takeNext(info))
+        {
+            m_pPool->load(info);
+        }
+    }
+}
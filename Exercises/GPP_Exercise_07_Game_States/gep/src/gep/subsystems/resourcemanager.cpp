@@ -4,6 +4,7 @@
 #include "gep/globalManager.h"
 #include "gep/interfaces/logging.h"
 #include "gep/interfaces/updateFramework.h"
+#include "gep/settings.h"
 #include "gep/file.h"
 #include <algorithm>
 
@@ -20,15 +21,26 @@ gep::ResourceManager::ResourceManager()
 
 void gep::ResourceManager::initialize()
 {
-    m_pResourceLoader = new ResourceLoaderThread(this);
+    auto& settings = g_globalManager.getSettings()->getResourceSettings();
+    // mount before the loader threads start, the file system is not modified after that
+    m_fileSystem.setLooseFilesFirst(settings.looseFilesFirst);
+    if(!settings.archive.empty())
+    {
+        m_fileSystem.mountArchive(settings.archive.c_str());
+        g_globalManager.getLogging()->logMessage("mounted archive '%s'", settings.archive.c_str());
+    }
+
+    m_pResourceLoader = new ResourceLoaderPool(settings.numLoaderThreads,
+        [this](ResourcePtr<IResource> ptr, IResource* pResource, IResourceLoader* pLoader){
+            resourceFinishedLoading(ptr, pResource, pLoader);
+        });
     m_pResourceLoader->start();
 }
 
 void gep::ResourceManager::destroy()
 {
     m_pResourceLoader->stop();
-    m_pResourceLoader->join();
-    delete m_pResourceLoader;
+    DELETE_AND_NULL(m_pResourceLoader);
 
     // Make a copy to allow safe iterating
     auto resourceToPatchCopy = m_resourcesToPatch;
@@ -91,7 +103,17 @@ void gep::ResourceManager::update(float elapsedTime)
             {
                 GEP_ASSERT(false, "resource type not registered yet");
             }
-            if(info.pResource == nullptr) // failed load
+            if(!info.ptr.isValid()) // canceled after loading finished
+            {
+                if(info.pResource != nullptr)
+                {
+                    info.pResource->unload();
+                    info.pLoader->deleteResource(info.pResource);
+                }
+                info.pLoader->release();
+                m_resourcesToPatch.removeAtIndexUnordered(i); //instead of i++
+            }
+            else if(info.pResource == nullptr) // failed load
             {
                 if(info.ptr == pDummyResource)
                     m_failedInitialLoad[info.pLoader] = true;
@@ -218,7 +240,7 @@ void gep::ResourceManager::destroyInGameThread()
     DELETE_AND_NULL(m_pHkResourceLoader);
 }
 
-gep::ResourcePtr<gep::IResource> gep::ResourceManager::doLoadResource(IResourceLoader& loader, LoadAsync loadAsync)
+gep::ResourcePtr<gep::IResource> gep::ResourceManager::doLoadResource(IResourceLoader& loader, LoadAsync loadAsync, LoadPriority::Enum priority)
 {
     // Because of the insert and lookup into m_loadedResources we have to lock the entire method
     // This is only going to be a problem for synchronous loads because they will block for a long time
@@ -228,8 +250,23 @@ gep::ResourcePtr<gep::IResource> gep::ResourceManager::doLoadResource(IResourceL
     if(m_loadedResources.tryGet(resourceId, alreadyLoaded))
     {
         g_globalManager.getLogging()->logMessage("Reusing already loaded resource '%s'", resourceId.c_str());
+        // the same resource might still be waiting to be loaded, make sure it is not loaded later than requested now
+        if(loadAsync == LoadAsync::Yes)
+            m_pResourceLoader->raisePriority(resourceId.c_str(), priority);
         return alreadyLoaded;
     }
+    {
+        // finished loading but not patched in yet, loading it again would only produce a second copy
+        ScopedLock<Mutex> lock(m_patchResourceMutex);
+        for(auto& pending : m_resourcesToPatch)
+        {
+            if(pending.ptr.isValid() && pending.pResource != nullptr && resourceId == pending.pLoader->getResourceId())
+            {
+                m_loadedResources[resourceId] = pending.ptr;
+                return pending.ptr;
+            }
+        }
+    }
     IResourceLoader* pLoader = loader.moveToHeap();
     GEP_ASSERT(pLoader != nullptr);
     if(loadAsync == LoadAsync::No)
@@ -269,7 +306,7 @@ gep::ResourcePtr<gep::IResource> gep::ResourceManager::doLoadResource(IResourceL
     if(loadAsync == LoadAsync::Yes)
     {
         GEP_ASSERT(result == pResult);
-        m_pResourceLoader->loadResource(result, pLoader);
+        m_pResourceLoader->loadResource(result, pLoader, priority);
     }
     else
     {
@@ -315,6 +352,31 @@ void gep::ResourceManager::reloadResource(ResourcePtr<IResource> ptr)
         resourceFinishedLoading(ptr, result, pLoader);
 }
 
+void gep::ResourceManager::cancelLoading(ResourcePtr<IResource> ptr)
+{
+    ScopedLock<Mutex> outerLock(m_loadingResourceMutex);
+    if(!ptr.isValid())
+        return;
+
+    IResource* pDummyResource = nullptr;
+    if(!m_resourceDummies.tryGet(ptr->getResourceType(), pDummyResource))
+    {
+        GEP_ASSERT(false, "Resource type not registered yet", ptr->getResourceType());
+    }
+    // only a pointer that still points to the dummy is waiting for its load
+    if(ptr.get() != pDummyResource)
+        return;
+
+    auto weakRefIndex = ptr.getWeakRefIndex();
+    m_loadedResources.removeWhere([=](std::string&, ResourcePtr<IResource>& loaded){
+        return loaded.getWeakRefIndex() == weakRefIndex;
+    });
+
+    // The loader pool skips or discards requests with invalid pointers,
+    // update() does the same for resources that already finished loading.
+    invalidate(ptr);
+}
+
 void gep::ResourceManager::deleteResource(IResource* pResource)
 {
     if(pResource == nullptr)
@@ -438,73 +500,24 @@ void gep::ResourceManager::resourceFinishedLoading(ResourcePtr<IResource> ptr, I
     info.pLoader = pLoader;
     info.isFinalized = (pResource->getFinalizeOptions() == 0);
     ScopedLock<Mutex> lock(m_patchResourceMutex);
-    m_resourcesToPatch.append(info);
-}
-
-gep::ResourceLoaderThread::ResourceLoaderThread(ResourceManager* pResourceManager) :
-    m_toLoadCounter(0),
-    m_pResourceManager(pResourceManager),
-    m_isRunning(false)
-{
-
-}
-
-gep::ResourceLoaderThread::~ResourceLoaderThread()
-{
-    GEP_ASSERT(m_isRunning == false, "resource loader should not be running");
-    while(m_resourcesToLoad.count() > 0)
+    auto weakRefIndex = ptr.getWeakRefIndex();
+    for(size_t i=0; i < m_resourcesToPatch.length(); i++)
     {
-        m_resourcesToLoad.take().pLoader->release();
-    }
-}
-
-void gep::ResourceLoaderThread::loadResource(ResourcePtr<IResource> ptr, IResourceLoader* pLoader)
-{
-    ToLoadInfo info;
-    info.ptr = ptr;
-    info.pLoader = pLoader;
-    m_resourcesToLoad.append(info);
-    m_toLoadCounter.increment();
-}
-
-void gep::ResourceLoaderThread::run()
-{
-    m_isRunning = true;
-    SCOPE_EXIT{ m_isRunning = false; });
-    while(m_isRunning)
-    {
-//        Sleep(100);
-        m_toLoadCounter.waitAndDecrement();
-        // We might got signaled to quit, check this
-        if(!m_isRunning)
-            break;
-        auto info = m_resourcesToLoad.take();
-        IResource* pResult = nullptr;
-        try
-        {
-            pResult = info.pLoader->loadResource(nullptr);
-            if(pResult != nullptr)
-                pResult->setLoader(info.pLoader);
-        }
-        catch(LoadingError& ex)
-        {
-            g_globalManager.getLogging()->logError("%s", ex.what());
-        }
-        if(pResult != nullptr)
-        {
-            m_pResourceManager->resourceFinishedLoading(info.ptr, pResult, info.pLoader);
-        }
-        else
+        auto& pending = m_resourcesToPatch[i];
+        if(pending.ptr.isValid() && pending.ptr.getWeakRefIndex() == weakRefIndex)
         {
-            info.pLoader->release();
+            // the same resource finished loading twice (e.g. reloaded before it was patched in), the newer result wins
+            IResource* pCurrent = ptr;
+            if(pending.pResource != nullptr && pending.pResource != pResource && pending.pResource != pCurrent)
+            {
+                pending.pResource->unload();
+                pending.pLoader->deleteResource(pending.pResource);
+            }
+            if(pending.pLoader != pLoader && pending.pLoader != pCurrent->getLoader())
+                pending.pLoader->release();
+            pending = info;
+            return;
         }
     }
+    m_resourcesToPatch.append(info);
 }
-
-void gep::ResourceLoaderThread::stop()
-{
-    m_isRunning = false;
-    m_toLoadCounter.increment();
-}
-
-
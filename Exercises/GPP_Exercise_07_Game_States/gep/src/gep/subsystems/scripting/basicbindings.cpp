@@ -23,3 +23,16 @@ void gep::ScriptingManager::makeBasicBindings()
 
     scripting->bind<ISettings>("Settings", g_globalManager.getSettings());
 }
+
+void gep::ScriptingManager::makePooledBindings()
+{
+    auto scripting = static_cast<IScriptingManager*>(this);
+
+    // the pooled states run in parallel, they only get the value types
+    scripting->bindPooled<ivec2>("Vec2i");
+    scripting->bindPooled<vec2>("Vec2");
+    scripting->bindPooled<vec3>("Vec3");
+    scripting->bindPooled<Quaternion>("Quaternion");
+    scripting->bindPooled<mat3>("Mat3");
+    scripting->bindPooled<mat4>("Mat4");
+}
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "gep/scripting/luaHelper.h"
+#include "gep/scripting/luaBatchCall.h"
 
 namespace helper
 {
@@ -144,6 +145,7 @@ GEP_API std::string lua::utils::traceback(lua_State* L)
 void lua::FunctionWrapper::initializeTable(int functionIndex)
 {
     utils::StackCleaner cleaner(m_L, 0);
+    functionIndex = lua_absindex(m_L, functionIndex);
 
     // create a table that will store the reference count for us
     lua_createtable(m_L, 2, 0);
@@ -159,6 +161,10 @@ void lua::FunctionWrapper::initializeTable(int functionIndex)
     lua_pushvalue(m_L, functionIndex);
     lua_rawset(m_L, tableIndex);
 
+    // keep a direct reference to the function for fast pushing
+    lua_pushvalue(m_L, functionIndex);
+    m_functionReference = luaL_ref(m_L, LUA_REGISTRYINDEX);
+
     // generate a unique reference to our helper table. Pops the ref'd table.
     m_tableReference = luaL_ref(m_L, LUA_REGISTRYINDEX);
 }
@@ -205,7 +211,9 @@ void lua::FunctionWrapper::removeReference()
 
     if (refCount == 0)
     {
+        luaL_unref(m_L, LUA_REGISTRYINDEX, m_functionReference);
         luaL_unref(m_L, LUA_REGISTRYINDEX, m_tableReference);
+        m_functionReference = s_invalidReference;
         m_tableReference = s_invalidReference;
     }
     else
@@ -218,17 +226,14 @@ void lua::FunctionWrapper::removeReference()
 
 void lua::FunctionWrapper::push()
 {
-    utils::StackCleaner cleaner(m_L, 1);
-
-    // Push the table on the stack
-    pushTable();
-    auto tableIndex = lua_gettop(m_L);
-
-    lua_pushinteger(m_L, s_functionIndex);
-    lua_rawget(m_L, tableIndex);
+    lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_functionReference);
+}
 
-    // Swap the table with the function so that the table is at the top of the stack.
-    lua_insert(m_L, -2);
+const void* lua::FunctionWrapper::getFunctionPointer()
+{
+    utils::StackCleaner cleaner(m_L, 0);
+    push();
+    return lua_topointer(m_L, -1);
 }
 
 void lua::FunctionWrapper::pushTable()
@@ -243,6 +248,38 @@ void lua::TableWrapper::push()
     lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_tableReference);
 }
 
+size_t lua::TableWrapper::length()
+{
+    utils::StackCleaner cleaner(m_L, 0);
+    push();
+    return lua_rawlen(m_L, -1);
+}
+
+void lua::TableWrapper::getNumbers(gep::ArrayPtr<float> out_values)
+{
+    utils::StackCleaner cleaner(m_L, 0);
+    push();
+    const int tableIndex = lua_gettop(m_L);
+    for(size_t i = 0; i < out_values.length(); i++)
+    {
+        lua_rawgeti(m_L, tableIndex, int(i + 1));
+        out_values[i] = float(lua_tonumber(m_L, -1));
+        lua_pop(m_L, 1);
+    }
+}
+
+void lua::TableWrapper::setNumbers(gep::ArrayPtr<const float> values)
+{
+    utils::StackCleaner cleaner(m_L, 0);
+    push();
+    const int tableIndex = lua_gettop(m_L);
+    for(size_t i = 0; i < values.length(); i++)
+    {
+        lua_pushnumber(m_L, lua_Number(values[i]));
+        lua_rawseti(m_L, tableIndex, int(i + 1));
+    }
+}
+
 void lua::TableWrapper::addReference()
 {
     utils::StackCleaner cleaner(m_L, 0);
@@ -312,3 +349,87 @@ void lua::TableWrapper::injectRefCountEntry(int tableIndex)
     // generate a unique reference to our helper table. Pops the ref'd table.
     m_tableReference = luaL_ref(m_L, LUA_REGISTRYINDEX);
 }
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    const char* const g_batchDispatcherKey = "gep_batchDispatcher";
+
+    // Iterates the argument array in Lua so the engine only has to enter the VM once per batch.
+    const char* const g_batchDispatcherSource =
+        "local func, arguments, numArguments, elapsedTime = ...\n"
+        "for i = 1, numArguments do\n"
+        "    func(arguments[i], elapsedTime)\n"
+        "end\n";
+}
+
+lua::BatchCall::BatchCall(lua_State* L) :
+    m_L(L),
+    m_function(),
+    m_argumentsReference(LUA_NOREF),
+    m_numArguments(0)
+{
+    lua_newtable(m_L);
+    m_argumentsReference = luaL_ref(m_L, LUA_REGISTRYINDEX);
+}
+
+lua::BatchCall::~BatchCall()
+{
+    luaL_unref(m_L, LUA_REGISTRYINDEX, m_argumentsReference);
+    m_argumentsReference = LUA_NOREF;
+}
+
+void lua::BatchCall::setFunction(FunctionWrapper func)
+{
+    m_function = func;
+}
+
+void lua::BatchCall::clear()
+{
+    // Replace the array instead of nil-ing every entry. The old one is collected.
+    luaL_unref(m_L, LUA_REGISTRYINDEX, m_argumentsReference);
+    lua_createtable(m_L, m_numArguments, 0);
+    m_argumentsReference = luaL_ref(m_L, LUA_REGISTRYINDEX);
+    m_numArguments = 0;
+}
+
+void lua::BatchCall::call(float elapsedTime)
+{
+    if (m_numArguments == 0 || !m_function.isValid())
+    {
+        return;
+    }
+
+    utils::StackCleaner cleaner(m_L, 0);
+
+    pushDispatcher();
+    m_function.push();
+    pushArguments();
+    lua_pushinteger(m_L, m_numArguments);
+    lua_pushnumber(m_L, elapsedTime);
+
+    lua_call(m_L, 4, 0);
+}
+
+void lua::BatchCall::pushArguments()
+{
+    lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_argumentsReference);
+}
+
+void lua::BatchCall::pushDispatcher()
+{
+    lua_getfield(m_L, LUA_REGISTRYINDEX, g_batchDispatcherKey);
+    if (!lua_isnil(m_L, -1))
+    {
+        return;
+    }
+    lua_pop(m_L, 1);
+
+    // First batch call in this state. Compile the dispatcher and cache it in the registry.
+    auto err = luaL_loadstring(m_L, g_batchDispatcherSource);
+    GEP_ASSERT(err == LUA_OK, "Failed to compile the batch call dispatcher!", err);
+    GEP_UNUSED(err);
+    lua_pushvalue(m_L, -1);
+    lua_setfield(m_L, LUA_REGISTRYINDEX, g_batchDispatcherKey);
+}
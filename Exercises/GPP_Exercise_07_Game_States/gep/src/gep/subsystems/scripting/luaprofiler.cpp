@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include "gep/scripting/luaHelper.h"
+#include "gep/scripting/luaProfiler.h"
+
+namespace
+{
+    // The address of this variable is the registry key of the running profiler.
+    char g_profilerRegistryKey;
+
+    void appendFrameName(std::string& stack, lua_Debug& ar)
+    {
+        if (ar.name != nullptr)
+        {
+            stack += ar.name;
+        }
+        else if (*ar.what == 'm')
+        {
+            stack += "main";
+        }
+        else
+        {
+            stack += "?";
+        }
+
+        if (*ar.what == 'C')
+        {
+            stack += " [C]";
+        }
+        else
+        {
+            stack += gep::format(" (%s:%d)", ar.short_src, ar.linedefined);
+        }
+    }
+}
+
+lua::Profiler::Profiler(lua_State* L) :
+    m_L(L),
+    m_isRunning(false),
+    m_timer(),
+    m_samples(),
+    m_cFunctionTicks(),
+    m_cFunctionCalls()
+{
+}
+
+lua::Profiler::~Profiler()
+{
+    if (m_isRunning)
+    {
+        stop();
+    }
+}
+
+void lua::Profiler::start(int sampleInterval, bool measureCFunctions)
+{
+    GEP_ASSERT(!m_isRunning, "The profiler is already running!");
+    GEP_ASSERT(sampleInterval > 0, "Invalid sample interval!", sampleInterval);
+
+    lua_pushlightuserdata(m_L, this);
+    lua_rawsetp(m_L, LUA_REGISTRYINDEX, &g_profilerRegistryKey);
+
+    int mask = LUA_MASKCOUNT;
+    if (measureCFunctions)
+    {
+        mask |= LUA_MASKCALL | LUA_MASKRET;
+    }
+    lua_sethook(m_L, &Profiler::hook, mask, sampleInterval);
+    m_isRunning = true;
+}
+
+void lua::Profiler::stop()
+{
+    GEP_ASSERT(m_isRunning, "The profiler is not running!");
+
+    lua_sethook(m_L, nullptr, 0, 0);
+    lua_pushnil(m_L);
+    lua_rawsetp(m_L, LUA_REGISTRYINDEX, &g_profilerRegistryKey);
+
+    m_cFunctionCalls.resize(0);
+    m_isRunning = false;
+}
+
+void lua::Profiler::reset()
+{
+    m_samples.clear();
+    m_cFunctionTicks.clear();
+    m_cFunctionCalls.resize(0);
+}
+
+void lua::Profiler::writeSamples(std::ostream& output)
+{
+    for (auto& entry : m_samples)
+    {
+        output << entry.key << ' ' << entry.value << '\n';
+    }
+}
+
+void lua::Profiler::writeCFunctionTimes(std::ostream& output)
+{
+    auto resolution = m_timer.getResolution();
+    for (auto& entry : m_cFunctionTicks)
+    {
+        auto microseconds = gep::uint64(entry.value * resolution * 1000.0);
+        output << entry.key << ' ' << microseconds << '\n';
+    }
+}
+
+lua::Profiler* lua::Profiler::getInstance(lua_State* L)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &g_profilerRegistryKey);
+    auto pProfiler = static_cast<Profiler*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+    return pProfiler;
+}
+
+void lua::Profiler::hook(lua_State* L, lua_Debug* ar)
+{
+    auto pProfiler = getInstance(L);
+    if (pProfiler == nullptr)
+    {
+        return;
+    }
+
+    switch (ar->event)
+    {
+    case LUA_HOOKCOUNT:
+        pProfiler->onSample();
+        break;
+    case LUA_HOOKCALL:
+        pProfiler->onCall(ar);
+        break;
+    case LUA_HOOKRET:
+        pProfiler->onReturn(ar);
+        break;
+    default:
+        break;
+    }
+}
+
+void lua::Profiler::onSample()
+{
+    m_samples[collapseStack(0)]++;
+}
+
+void lua::Profiler::onCall(lua_Debug* ar)
+{
+    lua_getinfo(m_L, "Sf", ar);
+    auto function = lua_topointer(m_L, -1);
+    lua_pop(m_L, 1);
+    if (*ar->what != 'C')
+    {
+        return;
+    }
+
+    CallRecord record;
+    record.function = function;
+    record.startTime = m_timer.getTime();
+    m_cFunctionCalls.append(record);
+}
+
+void lua::Profiler::onReturn(lua_Debug* ar)
+{
+    auto endTime = m_timer.getTime();
+
+    lua_getinfo(m_L, "Sf", ar);
+    auto function = lua_topointer(m_L, -1);
+    lua_pop(m_L, 1);
+    if (*ar->what != 'C')
+    {
+        return;
+    }
+
+    // Calls that were left by a Lua error never return, skip them.
+    while (m_cFunctionCalls.length() > 0)
+    {
+        auto record = m_cFunctionCalls.lastElement();
+        m_cFunctionCalls.resize(m_cFunctionCalls.length() - 1);
+        if (record.function == function)
+        {
+            m_cFunctionTicks[collapseStack(0)] += endTime - record.startTime;
+            return;
+        }
+    }
+}
+
+std::string lua::Profiler::collapseStack(int startLevel)
+{
+    // Collect the frames from the leaf to the root first.
+    lua_Debug frames[64];
+    int numFrames = 0;
+    while (numFrames < int(GEP_ARRAY_SIZE(frames)) && lua_getstack(m_L, startLevel + numFrames, &frames[numFrames]))
+    {
+        lua_getinfo(m_L, "Sn", &frames[numFrames]);
+        ++numFrames;
+    }
+
+    std::string stack;
+    for (int i = numFrames - 1; i >= 0; --i)
+    {
+        appendFrameName(stack, frames[i]);
+        if (i > 0)
+        {
+            stack += ';';
+        }
+    }
+    return stack;
+}
@@ -7,6 +7,8 @@
 #include "gep/memory/leakDetection.h"
 #include "gep/globalManager.h"
 #include "gep/interfaces/logging.h"
+#include "gep/threading/taskQueue.h"
+#include <fstream>
 
 namespace gep
 {
@@ -50,10 +52,12 @@ namespace gep
     }
 }
 
-gep::ScriptingManager::ScriptingManager(const std::string& scriptsRoot, const std::string& importantScriptsRoot) :
-    m_pAllocator(&g_stdAllocator),
+gep::ScriptingManager::ScriptingManager(IAllocatorStatistics* pAllocator, const std::string& scriptsRoot, const std::string& importantScriptsRoot) :
+    m_pAllocator(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
     m_L(nullptr),
     m_state(State::NotAcceptingScriptRegistration),
+    m_pProfiler(nullptr),
+    m_pStatePool(nullptr),
     m_scriptsRoot(scriptsRoot),
     m_importantScriptsRoot(importantScriptsRoot),
     m_scriptsToLoad()
@@ -64,10 +68,14 @@ gep::ScriptingManager::ScriptingManager(const std::string& scriptsRoot, const st
 
     // open all standard libraries
     luaL_openlibs(m_L);
+
+    m_pProfiler = new lua::Profiler(m_L);
 }
 
 gep::ScriptingManager::~ScriptingManager()
 {
+    DELETE_AND_NULL(m_pStatePool);
+    DELETE_AND_NULL(m_pProfiler);
     lua_close(m_L);
     m_L = nullptr;
 }
@@ -82,6 +90,81 @@ void gep::ScriptingManager::destroy()
 
 void gep::ScriptingManager::update(float elapsedTime)
 {
+    if (m_pStatePool == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        m_pStatePool->update(*g_globalManager.getTaskQueue(), elapsedTime);
+    }
+    catch (ScriptExecutionException& e)
+    {
+        g_globalManager.getLogging()->logError("%s", e.what());
+    }
+    m_pStatePool->dispatchMessages(std::bind(&ScriptingManager::dispatchPooledMessage, this, std::placeholders::_1));
+}
+
+void gep::ScriptingManager::createStatePool(size_t numStates)
+{
+    GEP_ASSERT(m_pStatePool == nullptr, "The pooled script states have already been created!");
+    m_pStatePool = new ScriptStatePool(numStates, m_pAllocator);
+    makePooledBindings();
+}
+
+void gep::ScriptingManager::loadPooledScript(const std::string& filename, LoadOptions::Enum loadOptions)
+{
+    GEP_ASSERT(m_pStatePool != nullptr, "There are no pooled script states, see settings.scripting.numPooledStates", filename);
+    if (m_pStatePool != nullptr)
+    {
+        m_pStatePool->loadScript(constructFileName(filename, loadOptions));
+    }
+}
+
+void gep::ScriptingManager::addPooledObject(const std::string& objectName, const std::string& updateFunction)
+{
+    GEP_ASSERT(m_pStatePool != nullptr, "There are no pooled script states, see settings.scripting.numPooledStates", objectName);
+    if (m_pStatePool != nullptr)
+    {
+        m_pStatePool->addObject(objectName, updateFunction);
+    }
+}
+
+void gep::ScriptingManager::removePooledObject(const std::string& objectName)
+{
+    if (m_pStatePool != nullptr)
+    {
+        m_pStatePool->removeObject(objectName);
+    }
+}
+
+void gep::ScriptingManager::sendPooledMessage(const std::string& objectName, const std::string& name, const std::string& data)
+{
+    GEP_ASSERT(m_pStatePool != nullptr, "There are no pooled script states, see settings.scripting.numPooledStates", objectName);
+    if (m_pStatePool != nullptr)
+    {
+        ScriptMessage message;
+        message.objectName = objectName;
+        message.name = name;
+        message.data = data;
+        m_pStatePool->sendMessage(message);
+    }
+}
+
+void gep::ScriptingManager::dispatchPooledMessage(const ScriptMessage& message)
+{
+    lua::utils::StackCleaner cleaner(m_L, 0);
+
+    lua_getglobal(m_L, "onPooledMessage");
+    if (!lua_isfunction(m_L, -1))
+    {
+        return;
+    }
+    lua::push(m_L, message.objectName);
+    lua::push(m_L, message.name);
+    lua::push(m_L, message.data);
+    lua_call(m_L, 3, 0);
 }
 
 void gep::ScriptingManager::loadScript(const std::string& filename, LoadOptions::Enum loadOptions)
@@ -179,20 +262,35 @@ std::string gep::ScriptingManager::constructFileName(const std::string& filename
 
 void gep::ScriptingManager::bindEnum(const char* enumName, ...)
 {
-    lua_newtable(m_L);
-    const char* ename;
-    int         evalue;
     va_list args;
     va_start(args, enumName);
+    makeEnumTable(m_L, enumName, args);
+    va_end(args);
+
+    if (m_pStatePool != nullptr)
+    {
+        for (size_t i = 0; i < m_pStatePool->getNumStates(); ++i)
+        {
+            va_start(args, enumName);
+            makeEnumTable(m_pStatePool->getState(i), enumName, args);
+            va_end(args);
+        }
+    }
+}
+
+void gep::ScriptingManager::makeEnumTable(lua_State* L, const char* enumName, va_list args)
+{
+    lua_newtable(L);
+    const char* ename;
+    int         evalue;
     while ((ename = va_arg(args, const char*)) != 0)
     {
         evalue = va_arg(args, int);
-        lua::push(m_L, ename);
-        lua::push(m_L, evalue);
-        lua_settable(m_L, -3);
+        lua::push(L, ename);
+        lua::push(L, evalue);
+        lua_settable(L, -3);
     }
-    va_end(args);
-    lua_setglobal(m_L, enumName);
+    lua_setglobal(L, enumName);
 }
 
 gep::int32 gep::ScriptingManager::memoryUsed() const
@@ -211,3 +309,42 @@ void gep::ScriptingManager::debugBreak(const char* message) const
     auto trace = lua::utils::traceback(m_L);
     GEP_DEBUG_BREAK;
 }
+
+void gep::ScriptingManager::setProfilingEnabled(bool enabled)
+{
+    if (enabled == m_pProfiler->isRunning())
+    {
+        return;
+    }
+
+    if (enabled)
+    {
+        m_pProfiler->start();
+    }
+    else
+    {
+        m_pProfiler->stop();
+    }
+}
+
+bool gep::ScriptingManager::isProfilingEnabled() const
+{
+    return m_pProfiler->isRunning();
+}
+
+void gep::ScriptingManager::exportProfile(const std::string& samplesFileName, const std::string& cFunctionTimesFileName)
+{
+    std::ofstream samplesFile(samplesFileName, std::ios_base::trunc);
+    if (!samplesFile.is_open())
+    {
+        throw Exception(format("Could not open '%s' for writing", samplesFileName.c_str()));
+    }
+    m_pProfiler->writeSamples(samplesFile);
+
+    std::ofstream cFunctionTimesFile(cFunctionTimesFileName, std::ios_base::trunc);
+    if (!cFunctionTimesFile.is_open())
+    {
+        throw Exception(format("Could not open '%s' for writing", cFunctionTimesFileName.c_str()));
+    }
+    m_pProfiler->writeCFunctionTimes(cFunctionTimesFile);
+}
@@ -0,0 +1,272 @@
+#include "stdafx.h"
+#include "gep/scripting/scriptStatePool.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/memory/allocator.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+
+namespace gep
+{
+    // defined in scriptingManager.cpp
+    void* scriptAllocator(void* userData, void* ptr, size_t originalSize, size_t newSize);
+    int scriptErrorHandler(lua_State* L);
+
+    /// \brief One Lua state together with the objects it owns.
+    /// Only touched by one task at a time, so it needs no locking.
+    struct ScriptStatePool::Shard : public ITask
+    {
+        struct Object
+        {
+            std::string name;
+            std::string updateFunction;
+        };
+
+        lua_State* L;
+        DynamicArray<Object> objects;
+        DynamicArray<ScriptMessage> inbox;
+        DynamicArray<ScriptMessage> outbox;
+        std::string error;
+        float elapsedMS;
+
+        Shard() : L(nullptr), objects(), inbox(), outbox(), error(), elapsedMS(0.0f) {}
+
+        virtual void execute() override;
+
+        /// \brief postMessage(objectName, name [, data]), the shard is the first upvalue.
+        static int postMessage(lua_State* L);
+
+        /// \brief Calls the function on top of the stack. Remembers the error message if it fails.
+        bool protectedCall(int numArguments);
+    };
+}
+
+int gep::ScriptStatePool::Shard::postMessage(lua_State* L)
+{
+    auto pShard = static_cast<Shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+
+    ScriptMessage message;
+    message.objectName = luaL_checkstring(L, 1);
+    message.name = luaL_checkstring(L, 2);
+    message.data = luaL_optstring(L, 3, "");
+    pShard->outbox.append(message);
+    return 0;
+}
+
+bool gep::ScriptStatePool::Shard::protectedCall(int numArguments)
+{
+    if (lua_pcall(L, numArguments, 0, 0) == LUA_OK)
+    {
+        return true;
+    }
+    error = lua_isstring(L, -1) ? lua_tostring(L, -1) : "Unknown error";
+    lua_pop(L, 1);
+    return false;
+}
+
+void gep::ScriptStatePool::Shard::execute()
+{
+    lua::utils::StackCleaner cleaner(L, 0);
+
+    // deliver the messages first, so the scripts see them in this update
+    lua_getglobal(L, "onMessage");
+    auto hasMessageHandler = lua_isfunction(L, -1);
+    lua_pop(L, 1);
+
+    // a failing handler drops the remaining messages, instead of getting all of them again next update
+    SCOPE_EXIT{ inbox.resize(0); });
+
+    for (auto& message : inbox)
+    {
+        if (!hasMessageHandler)
+        {
+            break;
+        }
+        lua_getglobal(L, "onMessage");
+        lua::push(L, message.objectName);
+        lua::push(L, message.name);
+        lua::push(L, message.data);
+        if (!protectedCall(3))
+        {
+            return;
+        }
+    }
+
+    for (auto& object : objects)
+    {
+        lua_getglobal(L, object.updateFunction.c_str());
+        lua::push(L, object.name);
+        lua::push(L, elapsedMS);
+        if (!protectedCall(2))
+        {
+            return;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gep::ScriptStatePool::ScriptStatePool(size_t numStates, IAllocator* pAllocator) :
+    m_pAllocator(pAllocator != nullptr ? pAllocator : &g_stdAllocator),
+    m_shards()
+{
+    GEP_ASSERT(numStates > 0, "A script state pool needs at least one state.");
+
+    m_shards.reserve(numStates);
+    for (size_t i = 0; i < numStates; ++i)
+    {
+        auto pShard = new Shard();
+        pShard->L = lua_newstate(&gep::scriptAllocator, m_pAllocator);
+        lua_atpanic(pShard->L, &gep::scriptErrorHandler);
+        luaL_openlibs(pShard->L);
+
+        // every state posts into its own outbox
+        lua_pushlightuserdata(pShard->L, pShard);
+        lua_pushcclosure(pShard->L, &Shard::postMessage, 1);
+        lua_setglobal(pShard->L, "postMessage");
+
+        m_shards.append(pShard);
+    }
+}
+
+gep::ScriptStatePool::~ScriptStatePool()
+{
+    for (auto pShard : m_shards)
+    {
+        lua_close(pShard->L);
+        DELETE_AND_NULL(pShard);
+    }
+    m_shards.clear();
+}
+
+lua_State* gep::ScriptStatePool::getState(size_t index)
+{
+    return m_shards[index]->L;
+}
+
+void gep::ScriptStatePool::loadScript(const std::string& filename)
+{
+    executeInAllStates(filename.c_str(), [&](lua_State* L){
+        return luaL_loadfile(L, filename.c_str());
+    });
+}
+
+void gep::ScriptStatePool::executeString(const char* source)
+{
+    executeInAllStates("string", [&](lua_State* L){
+        return luaL_loadstring(L, source);
+    });
+}
+
+void gep::ScriptStatePool::executeInAllStates(const char* chunkName, std::function<int(lua_State*)> load)
+{
+    for (auto pShard : m_shards)
+    {
+        auto L = pShard->L;
+        lua::utils::StackCleaner cleaner(L, 0);
+
+        if (load(L) != LUA_OK)
+        {
+            throw ScriptLoadException(format("Error loading Lua chunk \"%s\":\n%s", chunkName, lua_tostring(L, -1)));
+        }
+        if (lua_pcall(L, 0, 0, 0) != LUA_OK)
+        {
+            throw ScriptExecutionException(format("Error executing Lua chunk \"%s\":\n%s", chunkName, lua_tostring(L, -1)));
+        }
+    }
+}
+
+void gep::ScriptStatePool::addObject(const std::string& objectName, const std::string& updateFunction)
+{
+    GEP_ASSERT(findShard(objectName) == nullptr, "The object has already been added!", objectName);
+
+    auto pTarget = m_shards[0];
+    for (auto pShard : m_shards)
+    {
+        if (pShard->objects.length() < pTarget->objects.length())
+        {
+            pTarget = pShard;
+        }
+    }
+
+    Shard::Object object;
+    object.name = objectName;
+    object.updateFunction = updateFunction;
+    pTarget->objects.append(object);
+}
+
+void gep::ScriptStatePool::removeObject(const std::string& objectName)
+{
+    for (auto pShard : m_shards)
+    {
+        for (size_t i = 0; i < pShard->objects.length(); ++i)
+        {
+            if (pShard->objects[i].name == objectName)
+            {
+                pShard->objects.removeAtIndex(i);
+                return;
+            }
+        }
+    }
+}
+
+void gep::ScriptStatePool::sendMessage(const ScriptMessage& message)
+{
+    auto pShard = findShard(message.objectName);
+    GEP_ASSERT(pShard != nullptr, "Sending a message to an unknown object.", message.objectName);
+    if (pShard != nullptr)
+    {
+        pShard->inbox.append(message);
+    }
+}
+
+void gep::ScriptStatePool::update(TaskQueue& taskQueue, float elapsedMS)
+{
+    for (auto pShard : m_shards)
+    {
+        pShard->elapsedMS = elapsedMS;
+        pShard->error.clear();
+    }
+
+    // one state per chunk, this thread helps out and waits for the others
+    taskQueue.runParallel(m_shards.length(), 1, [&](size_t start, size_t end){
+        for (size_t i = start; i < end; ++i)
+        {
+            m_shards[i]->execute();
+        }
+    });
+
+    for (auto pShard : m_shards)
+    {
+        if (!pShard->error.empty())
+        {
+            throw ScriptExecutionException(format("A Lua error occurred in a pooled script state!\n%s", pShard->error.c_str()));
+        }
+    }
+}
+
+void gep::ScriptStatePool::dispatchMessages(const MessageHandler& handler)
+{
+    for (auto pShard : m_shards)
+    {
+        for (auto& message : pShard->outbox)
+        {
+            handler(message);
+        }
+        pShard->outbox.resize(0);
+    }
+}
+
+gep::ScriptStatePool::Shard* gep::ScriptStatePool::findShard(const std::string& objectName)
+{
+    for (auto pShard : m_shards)
+    {
+        for (auto& object : pShard->objects)
+        {
+            if (object.name == objectName)
+            {
+                return pShard;
+            }
+        }
+    }
+    return nullptr;
+}
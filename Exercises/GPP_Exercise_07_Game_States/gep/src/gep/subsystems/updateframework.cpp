@@ -7,6 +7,7 @@
 #include "gep/interfaces/inputHandler.h"
 #include "gep/interfaces/sound.h"
 #include "gep/interfaces/physics.h"
+#include "gep/settings.h"
 
 gep::UpdateFramework::UpdateFramework() :
     m_FrameTimesPtr(m_pFrameTimesArray)
@@ -31,6 +32,10 @@ void gep::UpdateFramework::stop()
 
 void gep::UpdateFramework::run()
 {
+    // headless runs are used as benchmarks, the simulation always advances by the same step
+    // so that every run does the same work, only the measured frame times differ
+    const float fixedTimeStep = g_globalManager.getSettings()->getVideoSettings().headless ? 1000.0f / 60.0f : 0.0f;
+
     m_timeOfLastFrame = g_globalManager.getTimer();
     // start the game simulation
     m_gameThread.start();
@@ -46,7 +51,7 @@ void gep::UpdateFramework::run()
         m_gameThread.m_gameEndLock.waitAndDecrement();
         // From here on only 1 thread runs
 
-        m_gameThread.m_elapsedTime = elapsedTime;
+        m_gameThread.m_elapsedTime = fixedTimeStep > 0.0f ? fixedTimeStep : elapsedTime;
 
         g_globalManager.getInputHandler()->update(elapsedTime);
 
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "gep/textLayout.h"
+
+gep::TextLayoutCache::TextLayoutCache() :
+    m_frame(0),
+    m_numHits(0),
+    m_numMisses(0)
+{
+}
+
+gep::TextLayoutCache::~TextLayoutCache()
+{
+    clear();
+}
+
+const gep::TextLayoutCache::Layout& gep::TextLayoutCache::getLayout(ITextGlyphSource& source, const char* text, FontHorizontalOrientation orientation)
+{
+    const size_t length = strlen(text);
+    const uint32 hash = hashOf(text, length, (uint32)orientation);
+    Layout* pLayout = nullptr;
+    if(m_layouts.tryGet(hash, pLayout) == SUCCESS)
+    {
+        if(pLayout->generation == source.getGlyphGeneration() &&
+           pLayout->orientation == orientation &&
+           pLayout->text.length() == length &&
+           memcmp(pLayout->text.c_str(), text, length) == 0)
+        {
+            pLayout->lastUsedFrame = m_frame;
+            source.markShelvesUsed(pLayout->shelfMask);
+            m_numHits++;
+            return *pLayout;
+        }
+        // either outdated or another text with the same hash, which is replaced
+    }
+    else
+    {
+        if(m_freeLayouts.length() > 0)
+        {
+            pLayout = m_freeLayouts[m_freeLayouts.length() - 1];
+            m_freeLayouts.resize(m_freeLayouts.length() - 1);
+        }
+        else
+        {
+            pLayout = new Layout();
+        }
+        m_layouts[hash] = pLayout;
+    }
+
+    m_numMisses++;
+    pLayout->text.assign(text, length);
+    pLayout->lastUsedFrame = m_frame;
+    layout(source, text, orientation, *pLayout);
+    return *pLayout;
+}
+
+void gep::TextLayoutCache::nextFrame()
+{
+    m_frame++;
+    const uint32 frame = m_frame;
+    auto& freeLayouts = m_freeLayouts;
+    // texts which change every frame would allocate a new layout every frame otherwise
+    m_layouts.removeWhere([frame, &freeLayouts](uint32& hash, Layout*& pLayout)
+    {
+        if(frame - pLayout->lastUsedFrame <= MAX_UNUSED_FRAMES)
+            return false;
+        freeLayouts.append(pLayout);
+        return true;
+    });
+}
+
+void gep::TextLayoutCache::clear()
+{
+    for(auto pLayout : m_layouts.values())
+        delete pLayout;
+    m_layouts.clear();
+    for(auto pLayout : m_freeLayouts)
+        delete pLayout;
+    m_freeLayouts.resize(0);
+}
+
+void gep::TextLayoutCache::layout(ITextGlyphSource& source, const char* text, FontHorizontalOrientation orientation, Layout& result)
+{
+    result.orientation = orientation;
+    result.shelfMask = 0;
+    result.quads.resize(0);
+    // every byte is at most one glyph
+    result.quads.reserve(strlen(text) * FLOATS_PER_QUAD);
+
+    const float lineHeight = source.getLineHeight();
+    float offsetX = 0.0f, offsetY = 0.0f;
+    float width = 0.0f;
+    while(*text != '\0')
+    {
+        uint32 codepoint = decodeUtf8(text);
+        if(codepoint == '\n')
+        {
+            width = GEP_MAX(width, offsetX);
+            offsetY += floor(lineHeight * 1.5f);
+            offsetX = 0.0f;
+            continue;
+        }
+
+        const TextGlyph* pGlyph = source.getGlyph(codepoint);
+        if(pGlyph == nullptr)
+            continue;
+
+        offsetX += pGlyph->left;
+        // white space has no quad
+        if(pGlyph->width > 0.0f && pGlyph->height > 0.0f)
+        {
+            const float minX = offsetX, maxX = offsetX + pGlyph->width;
+            const float minY = offsetY + pGlyph->top, maxY = minY + pGlyph->height;
+            float quad[FLOATS_PER_QUAD] = {
+                minX, minY, pGlyph->minTexX, pGlyph->minTexY,
+                minX, maxY, pGlyph->minTexX, pGlyph->maxTexY,
+                maxX, maxY, pGlyph->maxTexX, pGlyph->maxTexY,
+                maxX, minY, pGlyph->maxTexX, pGlyph->minTexY
+            };
+            result.quads.append(quad);
+            result.shelfMask |= 1ULL << pGlyph->shelf;
+        }
+        offsetX += pGlyph->width + pGlyph->advance;
+    }
+    width = GEP_MAX(width, offsetX);
+    result.width = width;
+
+    if(orientation == FontHorizontalOrientation::Centered)
+    {
+        const float shift = floor(width / 2.0f);
+        for(size_t i = 0; i < result.quads.length(); i += 4)
+            result.quads[i] -= shift;
+    }
+
+    // glyphs used by this layout are not evicted in this frame, so the generation after laying out is the one of all its glyphs
+    result.generation = source.getGlyphGeneration();
+}
+
+gep::uint32 gep::TextLayoutCache::decodeUtf8(const char*& text)
+{
+    const uint8* bytes = reinterpret_cast<const uint8*>(text);
+    uint32 codepoint = bytes[0];
+    if(codepoint < 0x80)
+    {
+        text++;
+        return codepoint;
+    }
+
+    uint32 numFollowing, minCodepoint;
+    if((codepoint & 0xE0) == 0xC0)
+    {
+        numFollowing = 1;
+        minCodepoint = 0x80;
+        codepoint &= 0x1F;
+    }
+    else if((codepoint & 0xF0) == 0xE0)
+    {
+        numFollowing = 2;
+        minCodepoint = 0x800;
+        codepoint &= 0x0F;
+    }
+    else if((codepoint & 0xF8) == 0xF0)
+    {
+        numFollowing = 3;
+        minCodepoint = 0x10000;
+        codepoint &= 0x07;
+    }
+    else
+    {
+        text++;
+        return 0xFFFD;
+    }
+
+    // the terminating 0 is no continuation byte, so this never reads past the end
+    for(uint32 i = 1; i <= numFollowing; i++)
+    {
+        if((bytes[i] & 0xC0) != 0x80)
+        {
+            text += i;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+    }
+    text += numFollowing + 1;
+
+    // overlong encodings and surrogates are invalid
+    if(codepoint < minCodepoint || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        return 0xFFFD;
+    return codepoint;
+}
@@ -0,0 +1,259 @@
+#include "stdafx.h"
+#include "gep/textureStreamer.h"
+#include <algorithm>
+
+namespace
+{
+    /// order in which mipmaps are evicted, lower first
+    enum EvictionTier
+    {
+        TIER_UNUSED = 0,        ///< not used for MAX_UNUSED_FRAMES
+        TIER_LARGER_THAN_NEEDED, ///< visible but with more detail than it covers on screen
+        TIER_RECENTLY_USED       ///< not visible in this frame
+    };
+}
+
+gep::TextureStreamer::TextureStreamer(size_t budget) :
+    m_numTextures(0),
+    m_numPendingLoads(0),
+    m_frame(0),
+    m_budget(budget),
+    m_residentBytes(0),
+    m_pendingBytes(0)
+{
+}
+
+gep::uint32 gep::TextureStreamer::addTexture(uint32 width, uint32 height, uint32 numMips, uint32 bytesPerBlock, uint32 firstResidentMip)
+{
+    GEP_ASSERT(width > 0 && height > 0 && numMips > 0, "invalid texture", width, height, numMips);
+    GEP_ASSERT(firstResidentMip < numMips, "invalid mipmap", firstResidentMip, numMips);
+
+    uint32 id;
+    if(m_freeIds.length() > 0)
+    {
+        id = m_freeIds.lastElement();
+        m_freeIds.removeLastElement();
+    }
+    else
+    {
+        id = (uint32)m_textures.length();
+        m_textures.resize(m_textures.length() + 1);
+    }
+
+    Texture& texture = m_textures[id];
+    texture.width = width;
+    texture.height = height;
+    texture.numMips = numMips;
+    texture.bytesPerBlock = bytesPerBlock;
+    texture.minResidentMip = GEP_MAX(getMinResidentMip(width, height, numMips), firstResidentMip);
+    texture.firstResidentMip = firstResidentMip;
+    texture.firstLoadableMip = 0;
+    texture.pendingMip = INVALID_ID;
+    texture.wantedMip = firstResidentMip;
+    texture.lastUsedFrame = m_frame;
+    texture.screenSize = 0.0f;
+    texture.isUsed = true;
+
+    m_residentBytes += getSize(texture, firstResidentMip);
+    m_numTextures++;
+    return id;
+}
+
+void gep::TextureStreamer::removeTexture(uint32 id)
+{
+    GEP_ASSERT(id < m_textures.length() && m_textures[id].isUsed, "invalid texture id", id);
+    Texture& texture = m_textures[id];
+    if(texture.pendingMip != INVALID_ID)
+    {
+        m_pendingBytes -= getSize(texture, texture.pendingMip) - getSize(texture, texture.firstResidentMip);
+        m_numPendingLoads--;
+    }
+    m_residentBytes -= getSize(texture, texture.firstResidentMip);
+    texture.isUsed = false;
+    m_freeIds.append(id);
+    m_numTextures--;
+}
+
+void gep::TextureStreamer::addUsage(uint32 id, float screenSize)
+{
+    GEP_ASSERT(id < m_textures.length() && m_textures[id].isUsed, "invalid texture id", id);
+    Texture& texture = m_textures[id];
+    texture.screenSize = GEP_MAX(texture.screenSize, screenSize);
+    texture.lastUsedFrame = m_frame;
+}
+
+void gep::TextureStreamer::update(DynamicArray<Request>& loads, DynamicArray<Request>& evictions)
+{
+    m_loadCandidates.resize(0);
+    for(uint32 id = 0; id < m_textures.length(); id++)
+    {
+        Texture& texture = m_textures[id];
+        if(!texture.isUsed)
+            continue;
+
+        // textures which are out of view keep what they needed when they were last seen for a while,
+        // so that turning the camera back and forth does not load the same mipmaps again and again
+        if(texture.lastUsedFrame == m_frame)
+            texture.wantedMip = getMipForScreenSize(texture.width, texture.height, texture.numMips, texture.screenSize);
+        else if(m_frame - texture.lastUsedFrame > MAX_UNUSED_FRAMES)
+            texture.wantedMip = texture.minResidentMip;
+        texture.wantedMip = GEP_MIN(GEP_MAX(texture.wantedMip, texture.firstLoadableMip), texture.minResidentMip);
+
+        if(texture.lastUsedFrame == m_frame && texture.wantedMip < texture.firstResidentMip && texture.pendingMip == INVALID_ID)
+        {
+            // the texture which gains the most detail on screen first
+            Request candidate;
+            candidate.id = id;
+            candidate.firstMip = texture.wantedMip;
+            candidate.priority = texture.screenSize / (float)GEP_MAX(GEP_MAX(texture.width, texture.height) >> texture.firstResidentMip, 1u);
+            m_loadCandidates.append(candidate);
+        }
+        texture.screenSize = 0.0f;
+    }
+
+    // the budget may have been lowered
+    makeRoom(0, INVALID_ID, evictions);
+
+    std::sort(m_loadCandidates.toArray().getPtr(), m_loadCandidates.toArray().getPtr() + m_loadCandidates.length(),
+        [](const Request& lhs, const Request& rhs){ return lhs.priority > rhs.priority; });
+
+    for(auto& candidate : m_loadCandidates)
+    {
+        if(m_numPendingLoads >= MAX_PENDING_LOADS)
+            break;
+        Texture& texture = m_textures[candidate.id];
+        const size_t residentSize = getSize(texture, texture.firstResidentMip);
+        // if the wanted mipmap does not fit any more detail is still better than none
+        for(uint32 mip = candidate.firstMip; mip < texture.firstResidentMip; mip++)
+        {
+            const size_t additionalSize = getSize(texture, mip) - residentSize;
+            if(!makeRoom(additionalSize, candidate.id, evictions))
+                continue;
+            texture.pendingMip = mip;
+            m_pendingBytes += additionalSize;
+            m_numPendingLoads++;
+            candidate.firstMip = mip;
+            loads.append(candidate);
+            break;
+        }
+    }
+    m_frame++;
+}
+
+void gep::TextureStreamer::finishLoad(uint32 id, uint32 firstMip)
+{
+    GEP_ASSERT(id < m_textures.length() && m_textures[id].isUsed, "invalid texture id", id);
+    Texture& texture = m_textures[id];
+    GEP_ASSERT(texture.pendingMip != INVALID_ID, "no load is pending for the texture", id);
+
+    m_pendingBytes -= getSize(texture, texture.pendingMip) - getSize(texture, texture.firstResidentMip);
+    m_numPendingLoads--;
+    if(firstMip < texture.firstResidentMip)
+    {
+        m_residentBytes += getSize(texture, firstMip) - getSize(texture, texture.firstResidentMip);
+        texture.firstResidentMip = firstMip;
+    }
+    if(texture.firstResidentMip > texture.pendingMip)
+        texture.firstLoadableMip = texture.firstResidentMip;
+    texture.pendingMip = INVALID_ID;
+}
+
+bool gep::TextureStreamer::makeRoom(size_t bytes, uint32 requestingId, DynamicArray<Request>& evictions)
+{
+    const size_t usedBytes = m_residentBytes + m_pendingBytes + bytes;
+    if(usedBytes <= m_budget)
+        return true;
+    const size_t neededBytes = usedBytes - m_budget;
+
+    m_evictionCandidates.resize(0);
+    size_t freeableBytes = 0;
+    for(uint32 id = 0; id < m_textures.length(); id++)
+    {
+        const Texture& texture = m_textures[id];
+        if(!texture.isUsed || id == requestingId || texture.pendingMip != INVALID_ID)
+            continue;
+
+        Request candidate;
+        candidate.id = id;
+        if(m_frame - texture.lastUsedFrame > MAX_UNUSED_FRAMES)
+        {
+            candidate.firstMip = texture.minResidentMip;
+            candidate.priority = (float)TIER_UNUSED;
+        }
+        else if(texture.firstResidentMip < texture.wantedMip)
+        {
+            candidate.firstMip = texture.wantedMip;
+            candidate.priority = (float)TIER_LARGER_THAN_NEEDED;
+        }
+        else if(texture.lastUsedFrame != m_frame)
+        {
+            candidate.firstMip = texture.minResidentMip;
+            candidate.priority = (float)TIER_RECENTLY_USED;
+        }
+        else
+        {
+            continue;
+        }
+        if(candidate.firstMip <= texture.firstResidentMip)
+            continue;
+        freeableBytes += getSize(texture, texture.firstResidentMip) - getSize(texture, candidate.firstMip);
+        m_evictionCandidates.append(candidate);
+    }
+    if(freeableBytes < neededBytes)
+        return false;
+
+    const auto& textures = m_textures;
+    std::sort(m_evictionCandidates.toArray().getPtr(), m_evictionCandidates.toArray().getPtr() + m_evictionCandidates.length(),
+        [&textures](const Request& lhs, const Request& rhs)
+        {
+            if(lhs.priority != rhs.priority)
+                return lhs.priority < rhs.priority;
+            return textures[lhs.id].lastUsedFrame < textures[rhs.id].lastUsedFrame;
+        });
+
+    size_t freedBytes = 0;
+    for(auto& candidate : m_evictionCandidates)
+    {
+        if(freedBytes >= neededBytes)
+            break;
+        Texture& texture = m_textures[candidate.id];
+        const size_t size = getSize(texture, texture.firstResidentMip) - getSize(texture, candidate.firstMip);
+        texture.firstResidentMip = candidate.firstMip;
+        m_residentBytes -= size;
+        freedBytes += size;
+        evictions.append(candidate);
+    }
+    return true;
+}
+
+gep::uint32 gep::TextureStreamer::getMinResidentMip(uint32 width, uint32 height, uint32 numMips)
+{
+    uint32 mip = 0;
+    while(mip + 1 < numMips && GEP_MAX(width, height) >> mip > MIN_RESIDENT_SIZE)
+        mip++;
+    return mip;
+}
+
+size_t gep::TextureStreamer::getMipSize(uint32 width, uint32 height, uint32 bytesPerBlock, uint32 mip)
+{
+    const size_t mipWidth = GEP_MAX(width >> mip, 1u);
+    const size_t mipHeight = GEP_MAX(height >> mip, 1u);
+    return ((mipWidth + 3) / 4) * ((mipHeight + 3) / 4) * bytesPerBlock;
+}
+
+size_t gep::TextureStreamer::getSize(uint32 width, uint32 height, uint32 numMips, uint32 bytesPerBlock, uint32 firstMip)
+{
+    size_t size = 0;
+    for(uint32 mip = firstMip; mip < numMips; mip++)
+        size += getMipSize(width, height, bytesPerBlock, mip);
+    return size;
+}
+
+gep::uint32 gep::TextureStreamer::getMipForScreenSize(uint32 width, uint32 height, uint32 numMips, float screenSize)
+{
+    const uint32 size = GEP_MAX(width, height);
+    uint32 mip = 0;
+    while(mip + 1 < numMips && (float)(size >> (mip + 1)) >= screenSize)
+        mip++;
+    return mip;
+}
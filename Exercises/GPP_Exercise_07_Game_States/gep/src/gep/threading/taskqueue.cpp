@@ -30,6 +30,8 @@ void gep::TaskGroup::taskFinished()
     uint32 tasksRemainingInGroup = InterlockedDecrement(&m_numRemainingTasks);
     if(tasksRemainingInGroup == 0)
     {
+        // deleteGroup takes the same lock, so the group isn't reset before it is done here
+        ScopedLock<Mutex> lock(m_pTaskQueue->m_schedulingMutex);
         m_isExecuting = false;
         if(m_finishedCallback)
             m_finishedCallback(m_tasks.toArray());
@@ -100,21 +102,25 @@ gep::Result gep::TaskWorker::stealTasks()
     {
         if(pOtherWorker != this)
         {
-            ScopedLock<Mutex> lock(pOtherWorker->m_tasksMutex);
-            if(pOtherWorker->m_tasks.length() > 0)
             {
+                ScopedLock<Mutex> lock(pOtherWorker->m_tasksMutex);
+                if(pOtherWorker->m_tasks.length() == 0)
+                    continue;
                 // steal half of the tasks, but at least 1
                 size_t tasksToSteal = pOtherWorker->m_tasks.length() / 2;
                 if(tasksToSteal < 1)
                     tasksToSteal = 1;
                 auto otherTasks = pOtherWorker->m_tasks.toArray();
                 size_t otherNewLength = otherTasks.length() - tasksToSteal;
-                // Append a sub array to our task queue
-                m_tasks.append( otherTasks(otherNewLength, otherTasks.length()) );
+                m_stolenTasks.append( otherTasks(otherNewLength, otherTasks.length()) );
                 // remove the stolen tasks from the other task queue
                 pOtherWorker->m_tasks.resize(otherNewLength);
-                return SUCCESS;
             }
+            // others may steal from us meanwhile, holding both locks would deadlock two workers stealing from each other
+            ScopedLock<Mutex> lock(m_tasksMutex);
+            m_tasks.append(m_stolenTasks.toArray());
+            m_stolenTasks.resize(0);
+            return SUCCESS;
         }
     }
     return FAILURE;
@@ -157,6 +163,7 @@ gep::TaskQueue::~TaskQueue()
 gep::TaskGroup* gep::TaskQueue::createGroup()
 {
     TaskGroup* result = nullptr;
+    ScopedLock<Mutex> lock(m_schedulingMutex);
     if(m_unusedTaskGroups.length() > 0)
     {
         result = m_unusedTaskGroups.lastElement();
@@ -170,7 +177,14 @@ gep::TaskGroup* gep::TaskQueue::createGroup()
 void gep::TaskQueue::deleteGroup(TaskGroup* pGroup)
 {
     if(pGroup != nullptr)
+    {
+        // waits for the worker which finished the group to leave taskFinished
+        ScopedLock<Mutex> lock(m_schedulingMutex);
+        GEP_ASSERT(!pGroup->m_isExecuting, "the task group is still executing");
+        // make sure a recycled group does not run the old tasks again
+        pGroup->reset();
         m_unusedTaskGroups.append(pGroup);
+    }
 }
 
 void gep::TaskQueue::scheduleForExecution(TaskGroup* pGroup)
@@ -194,26 +208,21 @@ void gep::TaskQueue::scheduleNextGroup()
     {
         m_currentTaskGroup = m_remainingTaskGroups.take();
         size_t numTasks = m_currentTaskGroup->m_tasks.length();
-        size_t tasksPerWorker = numTasks / m_worker.length();
-        if(tasksPerWorker < 1)
-            tasksPerWorker = 1;
-        size_t taskStart = 0;
+        size_t numWorkers = m_worker.length();
         auto taskArray = m_currentTaskGroup->m_tasks.toArray();
         // set the active task group on all workers
         for(auto pWorker : m_worker)
         {
             pWorker->m_pActiveGroup = m_currentTaskGroup;
         }
-        // distribute the tasks to the workers
-        for(auto pWorker : m_worker)
+        // distribute the tasks to the workers,
+        // spreading the remainder so that no task is left behind
+        for(size_t i=0; i < numWorkers; i++)
         {
-            if(taskStart >= numTasks)
-                break;
-            size_t end = taskStart + tasksPerWorker;
-            if(end > numTasks)
-                end = numTasks;
-            pWorker->addTasks( taskArray(taskStart, end) );
-            taskStart += tasksPerWorker;
+            size_t taskStart = numTasks * i / numWorkers;
+            size_t end = numTasks * (i + 1) / numWorkers;
+            if(taskStart < end)
+                m_worker[i]->addTasks( taskArray(taskStart, end) );
         }
 
         // wakeup all the workers but the first (the first is the local worker)
@@ -236,6 +245,60 @@ void gep::TaskQueue::runTasks()
     m_localWorker.runTasks();
 }
 
+void gep::TaskQueue::runParallel(size_t count, size_t minChunkSize, const std::function<void(size_t, size_t)>& work)
+{
+    if(minChunkSize < 1)
+        minChunkSize = 1;
+    // a few chunks per worker, so that stealing can even out chunks of different cost
+    size_t numChunks = (count + minChunkSize - 1) / minChunkSize;
+    numChunks = GEP_MIN(numChunks, m_worker.length() * 4);
+    if(numChunks <= 1)
+    {
+        if(count > 0)
+            work(0, count);
+        return;
+    }
+    // the local worker can only run the tasks of one calling thread
+    if(m_parallelMutex.tryLock() == FAILURE)
+    {
+        work(0, count);
+        return;
+    }
+    SCOPE_EXIT{ m_parallelMutex.unlock(); });
+
+    // reserved up front, the group keeps pointers to the tasks
+    DynamicArray<StandardTask> tasks;
+    tasks.reserve(numChunks);
+    Semaphore finished(0);
+    auto pGroup = createGroup();
+    SCOPE_EXIT{ deleteGroup(pGroup); });
+    for(size_t i=0; i < numChunks; i++)
+    {
+        size_t start = count * i / numChunks;
+        size_t end = count * (i + 1) / numChunks;
+        tasks.append(StandardTask([&work, start, end](){ work(start, end); }));
+        pGroup->addTask(&tasks.lastElement());
+    }
+    pGroup->setOnFinished([&](ArrayPtr<ITask*>){ finished.increment(); });
+
+    // the chunks of the local worker are only run by this thread,
+    // queued behind another group they would only finish if a worker steals them
+    bool isOtherGroupRunning;
+    {
+        ScopedLock<Mutex> lock(m_schedulingMutex);
+        isOtherGroupRunning = m_currentTaskGroup != nullptr;
+        if(!isOtherGroupRunning)
+            scheduleForExecution(pGroup);
+    }
+    if(isOtherGroupRunning)
+    {
+        work(0, count);
+        return;
+    }
+    runTasks();
+    finished.waitAndDecrement();
+}
+
 void gep::TaskQueue::stop()
 {
     m_isRunning = false;
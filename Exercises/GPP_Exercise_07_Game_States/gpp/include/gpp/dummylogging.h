@@ -23,5 +23,6 @@ namespace gpp
 
         virtual void registerSink(gep::ILogSink* pSink) override {}
         virtual void deregisterSink(gep::ILogSink* pSink) override {}
+        virtual void flush() override {}
     };
 }
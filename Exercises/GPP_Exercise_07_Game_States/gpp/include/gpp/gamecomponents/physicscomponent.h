@@ -67,6 +67,8 @@ namespace gpp
         gep::Event<gep::ContactPointArgs*> m_event_contactPoint;
 
         void setRigidBody(gep::IRigidBody* rigidBody);
+        /// \brief the transform the world wrote for the rigid body, taken from the body while it is not in the world
+        gep::RigidBodyTransform getSimulatedTransform() const;
 
         void activate();
         void deactivate();
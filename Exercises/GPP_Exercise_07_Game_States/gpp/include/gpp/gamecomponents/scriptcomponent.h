@@ -2,6 +2,11 @@
 
 #include "gpp/gameObjectSystem.h"
 
+namespace lua
+{
+    class BatchCall;
+}
+
 namespace gpp
 {
     class ScriptComponent : public Component
@@ -14,8 +19,14 @@ namespace gpp
         virtual void destroy();
         virtual void update(float elapsedMS);
 
+        /// \brief Marks the update batches dirty if the state actually changes.
+        /// Inactive components stay in their batch and are skipped until they are activated again.
+        /// \remarks State changes made from within an update function take effect in the next frame.
+        virtual void setState(State::Enum state) override;
+
         void setInitializationFunction(gep::ScriptFunctionWrapper funcRef);
         void setDestroyFunction(gep::ScriptFunctionWrapper funcRef);
+        /// \brief Moves the component into the batch of the function, an invalid function removes it from its batch.
         void setUpdateFunction(gep::ScriptFunctionWrapper funcRef);
 
         LUA_BIND_REFERENCE_TYPE_BEGIN
@@ -25,17 +36,57 @@ namespace gpp
         LUA_BIND_REFERENCE_TYPE_END
 
     private:
+        friend class ScriptComponentBatches;
 
         gep::ScriptFunctionWrapper m_funcRef_initialize;
         gep::ScriptFunctionWrapper m_funcRef_destroy;
         gep::ScriptFunctionWrapper m_funcRef_update;
+        bool m_isBatched;
+        /// where the component is in ScriptComponentBatches, so that it can be removed without searching
+        size_t m_batchIndex;
+        size_t m_indexInBatch;
+    };
+
+    /// \brief Updates all script components that share the same update function with a single script call.
+    ///
+    /// Script components are not updated by their game object anymore.
+    /// Instead, the game object manager updates all batches once per frame, at the priority of the script components:
+    /// after the components with a lower priority of all game objects, before the ones with a higher priority.
+    class ScriptComponentBatches
+    {
+    public:
+        ScriptComponentBatches();
+        ~ScriptComponentBatches();
+
+        void add(ScriptComponent* pComponent);
+        /// \brief Takes the last component of the batch to the place of the removed one.
+        void remove(ScriptComponent* pComponent);
+
+        /// \brief Rebuilds the argument lists before the next update.
+        inline void setDirty() { m_isDirty = true; }
+
+        void update(float elapsedMS);
+        void clear();
+
+    private:
+        struct Batch
+        {
+            const void* function;
+            lua::BatchCall* pCall;
+            gep::DynamicArray<ScriptComponent*> components;
+        };
+
+        gep::DynamicArray<Batch*> m_batches;
+        bool m_isDirty;
+
+        void rebuild();
     };
 
     template<>
     struct ComponentMetaInfo<ScriptComponent>
     {
         static const char* name(){ return "ScriptComponent"; }
-        static const int priority(){ return 42; }
+        static const int priority(){ return 42; } // updated by ScriptComponentBatches
         static ScriptComponent* create(){ return new ScriptComponent(); }
     };
 }
@@ -8,12 +8,14 @@
 #include "gep/container/DynamicArray.h"
 #include "gep/exception.h"
 #include "gep/weakPtr.h"
+#include "gep/spatialGrid.h"
 
 #include "gep/interfaces/scripting.h"
 
 namespace gpp
 {
     class GameObject;
+    class ScriptComponentBatches;
 
     class GameObjectManager: public gep::DoubleLockingSingleton<GameObjectManager>
     {
@@ -38,17 +40,83 @@ namespace gpp
 
         State::Enum getState() { return m_state; }
 
+        inline ScriptComponentBatches& getScriptComponentBatches() { return *m_pScriptBatches; }
+
+        /// \brief calls callback(GameObject*) for every game object whose bounds overlap the sphere
+        ///
+        /// The query stops as soon as the callback returns false.
+        template<typename Callback>
+        void queryRadius(const gep::vec3& center, float radius, Callback& callback)
+        {
+            updateSpatialIndex();
+            auto toGameObject = [&](gep::uint32 proxy) -> bool
+            {
+                return callback(static_cast<GameObject*>(m_spatialGrid.getUserData(proxy)));
+            };
+            m_spatialGrid.queryRadius(center, radius, toGameObject);
+        }
+
+        /// \brief calls callback(GameObject*) for every game object whose bounds overlap the box
+        ///
+        /// The query stops as soon as the callback returns false.
+        template<typename Callback>
+        void queryAabb(const gep::vec3& min, const gep::vec3& max, Callback& callback)
+        {
+            updateSpatialIndex();
+            auto toGameObject = [&](gep::uint32 proxy) -> bool
+            {
+                return callback(static_cast<GameObject*>(m_spatialGrid.getUserData(proxy)));
+            };
+            m_spatialGrid.queryAabb(min, max, toGameObject);
+        }
+
+        /// \brief finds the game objects closest to a position, the closest one first
+        /// \return the number of game objects written to result
+        size_t queryNearest(const gep::vec3& position, gep::ArrayPtr<GameObject*> result);
+
+        /// \brief script versions of the queries, the results are read with getFoundObject
+        /// \return the number of game objects found
+        gep::uint32 findInRadius(const gep::vec3& center, float radius);
+        gep::uint32 findInBox(const gep::vec3& min, const gep::vec3& max);
+        gep::uint32 findNearest(const gep::vec3& position, gep::uint32 count);
+        /// \brief a game object found by the last script query, starting at 1
+        GameObject* getFoundObject(gep::uint32 index);
+
+        /// \brief should be about the size of the common game objects
+        void setSpatialCellSize(float cellSize);
+
+        /// \brief remembers the game object for the next update of the spatial index
+        void markTransformDirty(GameObject* pGameObject);
+
         LUA_BIND_REFERENCE_TYPE_BEGIN
             LUA_BIND_FUNCTION(createGameObject)
             LUA_BIND_FUNCTION(getGameObject)
+            LUA_BIND_FUNCTION(findInRadius)
+            LUA_BIND_FUNCTION(findInBox)
+            LUA_BIND_FUNCTION(findNearest)
+            LUA_BIND_FUNCTION(getFoundObject)
+            LUA_BIND_FUNCTION(setSpatialCellSize)
         LUA_BIND_REFERENCE_TYPE_END 
 
     protected:
         GameObjectManager();
         virtual ~GameObjectManager();
     private:
+       gep::IAllocator* m_pAllocator;
        gep::Hashmap<std::string, GameObject*, gep::StringHashPolicy> m_gameObjects;
        State::Enum m_state;
+       ScriptComponentBatches* m_pScriptBatches;
+       gep::SpatialGrid m_spatialGrid;
+       /// game objects whose transform or bounds changed since the last update of the spatial index
+       gep::DynamicArray<GameObject*> m_dirtyObjects;
+       /// game objects with a transform of a component, e.g. a rigid body, which moves without telling them
+       gep::DynamicArray<GameObject*> m_simulatedObjects;
+       /// reused by the queries, so that they don't allocate after the first calls
+       gep::DynamicArray<gep::uint32> m_nearestProxies;
+       gep::DynamicArray<GameObject*> m_foundObjects;
+
+       void updateSpatialIndex();
+       void updateSpatialProxy(GameObject* pGameObject);
     };
 
     class IComponent
@@ -162,10 +230,11 @@ namespace gpp
         };
 
     public:
-        GameObject();
+        GameObject(gep::IAllocator* pAllocator);
         ~GameObject();
 
-        void update(float elapsedMs);
+        /// \brief Updates the components with a priority in [minPriority, endPriority).
+        void update(float elapsedMs, int minPriority, int endPriority);
         void initialize();
         void destroy();
 
@@ -205,6 +274,10 @@ namespace gpp
         inline const ITransform& getTransform() const { return *m_transform; }
         inline void setTransform(ITransform& transform) { m_transform = &transform; }
 
+        /// \brief half the size of the box used for the proximity queries of the game object manager, zero by default
+        void setBounds(const gep::vec3& halfExtents);
+        inline const gep::vec3& getBounds() const { return m_boundsHalfExtents; }
+
         LUA_BIND_REFERENCE_TYPE_BEGIN
             LUA_BIND_FUNCTION_NAMED(createComponent<CameraComponent>, "createCameraComponent")
             LUA_BIND_FUNCTION_NAMED(createComponent<RenderComponent>, "createRenderComponent")
@@ -222,6 +295,7 @@ namespace gpp
             LUA_BIND_FUNCTION(getUpDirection)
             LUA_BIND_FUNCTION(getRightDirection)
             LUA_BIND_FUNCTION(setComponentStates)
+            LUA_BIND_FUNCTION(setBounds)
         LUA_BIND_REFERENCE_TYPE_END
 
     private:
@@ -231,6 +305,9 @@ namespace gpp
         ITransform* m_transform;
         gep::Hashmap<const char*, IComponent*> m_components;
         gep::DynamicArray<ComponentWrapper> m_updateQueue;
+        gep::vec3 m_boundsHalfExtents;
+        gep::uint32 m_spatialProxy;
+        bool m_isTransformDirty;
 
         template<typename T>
         void addComponent(T* specializedComponent)
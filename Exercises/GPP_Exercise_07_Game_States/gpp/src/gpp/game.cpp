@@ -11,6 +11,7 @@
 #include "gep/interfaces/renderer.h"
 #include "gep/interfaces/scripting.h"
 #include "gep/interfaces/inputHandler.h"
+#include "gep/interfaces/memoryManager.h"
 
 #include "gep/math3d/vec3.h"
 #include "gep/math3d/color.h"
@@ -51,6 +52,14 @@ void gpp::Game::initialize()
 {
     m_continueRunningGame = true;
 
+    auto memoryManager = g_globalManager.getMemoryManager();
+    memoryManager->setBudget(MemoryCategory::Scripting, 64 * 1024 * 1024);
+    memoryManager->setBudget(MemoryCategory::Resources, 512 * 1024 * 1024);
+    memoryManager->setBudget(MemoryCategory::Extraction, 64 * 1024 * 1024);
+    memoryManager->setBudget(MemoryCategory::Physics, 64 * 1024 * 1024);
+    memoryManager->setBudget(MemoryCategory::Events, 1024 * 1024);
+    memoryManager->setBudget(MemoryCategory::GameObjects, 4 * 1024 * 1024);
+
     // register render callback
     g_globalManager.getRendererExtractor()->registerExtractionCallback(std::bind(&Game::render, this, std::placeholders::_1));
     m_pDummyCam = new FreeCameraHorizon();
@@ -85,14 +94,14 @@ void gpp::Game::initialize()
     {
         auto message = format("Error loading script %s", e.what());
         GEP_ASSERT(false, message.c_str());
-        g_globalManager.getLogging()->logError(message.c_str());
+        g_globalManager.getLogging()->logError("%s", message.c_str());
         throw e;
     }
     catch (ScriptExecutionException& e)
     {
         auto message = format("Error executing script %s", e.what());
         GEP_ASSERT(false, message.c_str());
-        g_globalManager.getLogging()->logError(message.c_str());
+        g_globalManager.getLogging()->logError("%s", message.c_str());
         throw e;
     }
 
@@ -104,13 +113,13 @@ void gpp::Game::initialize()
     {
         auto message = format("Error loading script %s", e.what());
         GEP_ASSERT(false, message.c_str());
-        g_globalManager.getLogging()->logError(message.c_str());
+        g_globalManager.getLogging()->logError("%s", message.c_str());
     }
     catch (ScriptExecutionException& e)
     {
         auto message = format("Error executing script %s", e.what());
         GEP_ASSERT(false, message.c_str());
-        g_globalManager.getLogging()->logError(message.c_str());
+        g_globalManager.getLogging()->logError("%s", message.c_str());
     }
 
     m_pStateMachine->run();
@@ -149,6 +158,32 @@ void gpp::Game::update(float elapsedTime)
         g_globalManager.getScriptingManager()->collectGarbage();
     }
 
+    if (pInputHandler->wasTriggered(gep::Key::F6)) // Toggle script profiling
+    {
+        auto pScripting = g_globalManager.getScriptingManager();
+        pScripting->setProfilingEnabled(!pScripting->isProfilingEnabled());
+        if (!pScripting->isProfilingEnabled())
+        {
+            pScripting->exportProfile("scriptProfile_samples.txt", "scriptProfile_cFunctions.txt");
+            g_globalManager.getLogging()->logMessage("Script profile written to scriptProfile_*.txt");
+        }
+    }
+
+    if (pInputHandler->wasTriggered(gep::Key::F4)) // Toggle allocation profiling
+    {
+        auto pMemoryManager = g_globalManager.getMemoryManager();
+        if (pMemoryManager->isAllocationProfilingEnabled())
+        {
+            pMemoryManager->stopAllocationProfiling();
+            pMemoryManager->exportAllocationProfile("allocationProfile_live.txt", "allocationProfile_allocated.txt");
+            g_globalManager.getLogging()->logMessage("Allocation profile written to allocationProfile_*.txt");
+        }
+        else
+        {
+            pMemoryManager->startAllocationProfiling();
+        }
+    }
+
     /*  
     vec2 mouseDelta;
     if(pInputHandler->getMouseDelta(mouseDelta))
@@ -188,6 +223,11 @@ void gpp::Game::update(float elapsedTime)
         pPhysicsSystem->setDebugDrawingEnabled(!pPhysicsSystem->getDebugDrawingEnabled());
     if (pInputHandler->wasTriggered(gep::Key::F8)) // Toggle VSync
         pRenderer->setVSyncEnabled(!pRenderer->getVSyncEnabled());
+    if (pInputHandler->wasTriggered(gep::Key::F7)) // Toggle view frustum culling
+    {
+        auto pExtractor = g_globalManager.getRendererExtractor();
+        pExtractor->setCullingEnabled(!pExtractor->getCullingEnabled());
+    }
 
     auto& debugRenderer = pRenderer->getDebugRenderer();
     debugRenderer.printText(vec3(0.0f), "Origin");
@@ -213,6 +253,26 @@ void gpp::Game::render(gep::IRendererExtractor& extractor)
 
     context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(10, 5)), gep::format("FPS: %f", fps).c_str());
     context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(10, 20)), gep::format("Memory used by lua: %d KB", g_globalManager.getScriptingManager()->memoryUsed()).c_str());
+    auto cullingStats = extractor.getCullingStats();
+    context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(10, 35)), gep::format("Model nodes: %u submitted, %u culled (F7: culling %s)",
+        cullingStats.numSubmitted, cullingStats.numCulled, extractor.getCullingEnabled() ? "on" : "off").c_str());
+
+    auto memoryManager = g_globalManager.getMemoryManager();
+    int64 deltas[IMemoryManager::NUM_TRACKED_FRAMES];
+    for(size_t i = 0; i < size_t(MemoryCategory::Count); i++)
+    {
+        const auto category = MemoryCategory(i);
+        const auto statistics = memoryManager->getStatistics(category);
+        const size_t numFrames = memoryManager->getFrameDeltas(category, ArrayPtr<int64>(deltas));
+        int64 sum = 0;
+        for(size_t frame = 0; frame < numFrames; frame++)
+            sum += deltas[frame];
+        const float averageDelta = numFrames > 0 ? float(sum) / float(numFrames) / 1024.0f : 0.0f;
+        context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(10, 50 + 15 * int(i))),
+            gep::format("%s: %u KB used, %u KB peak, %u KB budget, %+.2f KB per frame", getName(category),
+                uint32(statistics.bytesUsed / 1024), uint32(statistics.highWaterMark / 1024), uint32(statistics.budget / 1024), averageDelta).c_str(),
+            statistics.isOverBudget ? Color::red() : Color::white());
+    }
     //context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(30, 20)), gep::format("Camera Position: [%f, %f, %f]", camPos.x, camPos.y, camPos.z).c_str());
     //context2D.printText(g_globalManager.getRenderer()->toNormalizedScreenPosition(ivec2(30, 35)), gep::format("Camera View Angle: %f", m_pFreeCamera->getViewAngle()).c_str());
 }
@@ -57,19 +57,20 @@ gep::mat4 gpp::PhysicsComponent::getTransformationMatrix()
 {
     GEP_ASSERT(m_pRigidBody, "When calling this method, the rigid body must not be null!");
     //TODO: Extend for scale
-    return gep::mat4::translationMatrix(m_pRigidBody->getPosition()) * m_pRigidBody->getRotation().toMat4();
+    auto transform = getSimulatedTransform();
+    return gep::mat4::translationMatrix(transform.position) * transform.rotation.toMat4();
 }
 
 gep::vec3 gpp::PhysicsComponent::getPosition()
 {
     GEP_ASSERT(m_pRigidBody, "When calling this method, the rigid body must not be null!");
-    return m_pRigidBody->getPosition();
+    return getSimulatedTransform().position;
 }
 
 gep::Quaternion gpp::PhysicsComponent::getRotation()
 {
     GEP_ASSERT(m_pRigidBody, "When calling this method, the rigid body must not be null!");
-    return m_pRigidBody->getRotation();
+    return getSimulatedTransform().rotation;
 }
 
 gep::vec3 gpp::PhysicsComponent::getScale()
@@ -105,6 +106,15 @@ void gpp::PhysicsComponent::setRigidBody(gep::IRigidBody* rigidBody)
     m_pParentGameObject->setTransform(*this);
 }
 
+gep::RigidBodyTransform gpp::PhysicsComponent::getSimulatedTransform() const
+{
+    const gep::uint32 index = m_pRigidBody->getWorldIndex();
+    if(index != gep::IRigidBody::INVALID_WORLD_INDEX)
+        return m_pWorld->getTransforms()[index];
+    gep::RigidBodyTransform transform = { m_pRigidBody->getPosition(), m_pRigidBody->getRotation() };
+    return transform;
+}
+
 void gpp::PhysicsComponent::contactPointCallback(const gep::ContactPointArgs& evt)
 {
     
@@ -123,15 +133,15 @@ void gpp::PhysicsComponent::collisionRemovedCallback(const gep::CollisionArgs& e
 
 gep::vec3 gpp::PhysicsComponent::getViewDirection()
 {
-    return m_pRigidBody->getRotation().toMat3() * gep::vec3(0,0,1);
+    return getSimulatedTransform().rotation.toMat3() * gep::vec3(0,0,1);
 }
 gep::vec3 gpp::PhysicsComponent::getUpDirection()
 {
-    return m_pRigidBody->getRotation().toMat3() * gep::vec3(0,1,0);
+    return getSimulatedTransform().rotation.toMat3() * gep::vec3(0,1,0);
 }
 gep::vec3 gpp::PhysicsComponent::getRightDirection()
 {
-    return m_pRigidBody->getRotation().toMat3() * gep::vec3(1,0,0);
+    return getSimulatedTransform().rotation.toMat3() * gep::vec3(1,0,0);
 }
 
 void gpp::PhysicsComponent::setState(State::Enum newState)
@@ -63,7 +63,7 @@ void gpp::RenderComponent::setState(State::Enum state)
         {
             if (m_extractionCallbackId.id == 0)
             {
-                m_extractionCallbackId = g_globalManager.getRendererExtractor()->registerExtractionCallback(
+                m_extractionCallbackId = g_globalManager.getRendererExtractor()->registerParallelExtractionCallback(
                     std::bind(&RenderComponent::extract,this,std::placeholders::_1));
             }
             else
@@ -2,12 +2,16 @@
 #include "gpp/gameComponents/scriptComponent.h"
 #include "gep/globalManager.h"
 #include "gep/interfaces/scripting.h"
+#include "gep/scripting/luaBatchCall.h"
 
 
 gpp::ScriptComponent::ScriptComponent() :
     m_funcRef_initialize(),
     m_funcRef_destroy(),
-    m_funcRef_update()
+    m_funcRef_update(),
+    m_isBatched(false),
+    m_batchIndex(0),
+    m_indexInBatch(0)
 {
 }
 
@@ -31,6 +35,11 @@ void gpp::ScriptComponent::initalize()
 
 void gpp::ScriptComponent::destroy()
 {
+    if (m_isBatched)
+    {
+        g_gameObjectManager.getScriptComponentBatches().remove(this);
+    }
+
     if(m_state == State::Inactive) { return; }
     if (m_funcRef_destroy.isValid())
     {
@@ -54,6 +63,15 @@ void gpp::ScriptComponent::update(float elapsedMS)
     }
 }
 
+void gpp::ScriptComponent::setState(State::Enum state)
+{
+    if (m_state != state && m_isBatched)
+    {
+        g_gameObjectManager.getScriptComponentBatches().setDirty();
+    }
+    Component::setState(state);
+}
+
 void gpp::ScriptComponent::setInitializationFunction(gep::ScriptFunctionWrapper funcRef)
 {
     m_funcRef_initialize = funcRef;
@@ -66,5 +84,145 @@ void gpp::ScriptComponent::setDestroyFunction(gep::ScriptFunctionWrapper funcRef
 
 void gpp::ScriptComponent::setUpdateFunction(gep::ScriptFunctionWrapper funcRef)
 {
+    // The component might belong to a different batch now.
+    // Components are batched as soon as they have an update function, whatever their state is,
+    // so that components which are activated later on are updated as well.
+    auto& batches = g_gameObjectManager.getScriptComponentBatches();
+    if (m_isBatched)
+    {
+        batches.remove(this);
+    }
     m_funcRef_update = funcRef;
+    if (m_funcRef_update.isValid())
+    {
+        batches.add(this);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+gpp::ScriptComponentBatches::ScriptComponentBatches() :
+    m_batches(),
+    m_isDirty(false)
+{
+}
+
+gpp::ScriptComponentBatches::~ScriptComponentBatches()
+{
+    clear();
+}
+
+void gpp::ScriptComponentBatches::add(ScriptComponent* pComponent)
+{
+    GEP_ASSERT(pComponent != nullptr);
+    GEP_ASSERT(!pComponent->m_isBatched, "The script component is already batched!", pComponent->getParentGameObject()->getName());
+    GEP_ASSERT(pComponent->m_funcRef_update.isValid(), "Only components with an update function can be batched.");
+
+    // Components sharing a Lua function share a batch, even if they use different wrappers.
+    auto function = pComponent->m_funcRef_update.getFunctionPointer();
+
+    Batch* pBatch = nullptr;
+    size_t batchIndex = 0;
+    for (; batchIndex < m_batches.length(); ++batchIndex)
+    {
+        if (m_batches[batchIndex]->function == function)
+        {
+            pBatch = m_batches[batchIndex];
+            break;
+        }
+    }
+
+    if (pBatch == nullptr)
+    {
+        batchIndex = m_batches.length();
+        pBatch = new Batch();
+        pBatch->function = function;
+        pBatch->pCall = new lua::BatchCall(g_globalManager.getScriptingManager()->getState());
+        pBatch->pCall->setFunction(pComponent->m_funcRef_update);
+        m_batches.append(pBatch);
+    }
+
+    pComponent->m_batchIndex = batchIndex;
+    pComponent->m_indexInBatch = pBatch->components.length();
+    pBatch->components.append(pComponent);
+    pComponent->m_isBatched = true;
+    m_isDirty = true;
+}
+
+void gpp::ScriptComponentBatches::remove(ScriptComponent* pComponent)
+{
+    GEP_ASSERT(pComponent != nullptr);
+    GEP_ASSERT(pComponent->m_isBatched, "The script component is not batched!", pComponent->getParentGameObject()->getName());
+
+    const size_t batchIndex = pComponent->m_batchIndex;
+    auto pBatch = m_batches[batchIndex];
+    auto& components = pBatch->components;
+    GEP_ASSERT(components[pComponent->m_indexInBatch] == pComponent, "The batch index of the script component is out of date.");
+
+    components.removeAtIndexUnordered(pComponent->m_indexInBatch);
+    if (pComponent->m_indexInBatch < components.length())
+    {
+        components[pComponent->m_indexInBatch]->m_indexInBatch = pComponent->m_indexInBatch;
+    }
+    pComponent->m_isBatched = false;
+    m_isDirty = true;
+
+    if (components.length() == 0)
+    {
+        m_batches.removeAtIndexUnordered(batchIndex);
+        if (batchIndex < m_batches.length())
+        {
+            for (auto pMoved : m_batches[batchIndex]->components)
+            {
+                pMoved->m_batchIndex = batchIndex;
+            }
+        }
+        DELETE_AND_NULL(pBatch->pCall);
+        DELETE_AND_NULL(pBatch);
+    }
+}
+
+void gpp::ScriptComponentBatches::update(float elapsedMS)
+{
+    if (m_isDirty)
+    {
+        rebuild();
+    }
+
+    for (auto pBatch : m_batches)
+    {
+        pBatch->pCall->call(elapsedMS);
+    }
+}
+
+void gpp::ScriptComponentBatches::clear()
+{
+    for (auto pBatch : m_batches)
+    {
+        for (auto pComponent : pBatch->components)
+        {
+            pComponent->m_isBatched = false;
+        }
+        DELETE_AND_NULL(pBatch->pCall);
+        DELETE_AND_NULL(pBatch);
+    }
+    m_batches.clear();
+    m_isDirty = false;
+}
+
+void gpp::ScriptComponentBatches::rebuild()
+{
+    for (auto pBatch : m_batches)
+    {
+        pBatch->pCall->clear();
+        for (auto pComponent : pBatch->components)
+        {
+            if (pComponent->getState() != IComponent::State::Active)
+            {
+                continue;
+            }
+            pBatch->pCall->append(pComponent->getParentGameObject()->getName());
+        }
+    }
+    m_isDirty = false;
 }
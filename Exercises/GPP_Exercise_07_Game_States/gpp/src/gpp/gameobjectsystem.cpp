@@ -1,5 +1,14 @@
 #include "stdafx.h"
 #include "gpp/gameObjectSystem.h"
+#include "gpp/gameComponents/scriptComponent.h"
+#include "gep/globalManager.h"
+#include "gep/interfaces/memoryManager.h"
+
+namespace
+{
+    /// a few units, about the size of the common game objects
+    const float DEFAULT_SPATIAL_CELL_SIZE = 16.0f;
+}
 
 //GameObjectManager
 
@@ -8,15 +17,22 @@ gpp::GameObjectManager* volatile gep::DoubleLockingSingleton<gpp::GameObjectMana
 gep::Mutex gep::DoubleLockingSingleton<gpp::GameObjectManager>::s_creationMutex;
 
 gpp::GameObjectManager::GameObjectManager():
+    m_pAllocator(g_globalManager.getMemoryManager()->getAllocator(gep::MemoryCategory::GameObjects)),
     m_gameObjects(),
-    m_state(State::PreInitialization)
+    m_state(State::PreInitialization),
+    m_pScriptBatches(new ScriptComponentBatches()),
+    m_spatialGrid(DEFAULT_SPATIAL_CELL_SIZE, m_pAllocator),
+    m_dirtyObjects(m_pAllocator),
+    m_simulatedObjects(m_pAllocator),
+    m_nearestProxies(m_pAllocator),
+    m_foundObjects(m_pAllocator)
 {
 
 }
 
 gpp::GameObjectManager::~GameObjectManager()
 {
-
+    DELETE_AND_NULL(m_pScriptBatches);
 }
 
 gpp::GameObject* gpp::GameObjectManager::createGameObject(const std::string& guid)
@@ -24,7 +40,7 @@ gpp::GameObject* gpp::GameObjectManager::createGameObject(const std::string& gui
     GEP_ASSERT(m_state == State::PreInitialization, "You are not allowed to create game objects after the initialization process.");
 
     GEP_ASSERT(m_gameObjects[guid] == nullptr, "GameObject %s already exists!", guid.c_str());
-    auto gameObject = new GameObject();
+    auto gameObject = GEP_NEW(m_pAllocator, GameObject)(m_pAllocator);
     gameObject->m_name = guid;
     m_gameObjects[guid] = gameObject;
     return gameObject;
@@ -41,6 +57,19 @@ void gpp::GameObjectManager::initialize()
     {
         pGameObject->initialize();
     }
+
+    // game objects can't be created after the initialization, so every one gets its proxy now
+    for(auto pGameObject : m_gameObjects.values())
+    {
+        const gep::vec3 position = pGameObject->getPosition();
+        pGameObject->m_spatialProxy = m_spatialGrid.insert(position - pGameObject->m_boundsHalfExtents,
+                                                           position + pGameObject->m_boundsHalfExtents,
+                                                           pGameObject);
+        pGameObject->m_isTransformDirty = false;
+        if(&pGameObject->getTransform() != &pGameObject->m_defaultTransform)
+            m_simulatedObjects.append(pGameObject);
+    }
+    m_dirtyObjects.clear();
     m_state = State::PostInitialization;
 }
 
@@ -49,27 +78,129 @@ void gpp::GameObjectManager::destroy()
     for(auto& gameObject : m_gameObjects.values())
     {
         gameObject->destroy();
-        DELETE_AND_NULL(gameObject);
+        GEP_DELETE(m_pAllocator, gameObject);
     }
     m_gameObjects.clear();
+    m_pScriptBatches->clear();
+    m_spatialGrid.clear();
+    m_dirtyObjects.clear();
+    m_simulatedObjects.clear();
+    m_foundObjects.clear();
 }
 
 void gpp::GameObjectManager::update(float elapsedMs)
 {
+    // the physics moved the simulated game objects since the last frame
+    for(auto pGameObject : m_simulatedObjects)
+    {
+        updateSpatialProxy(pGameObject);
+    }
+
+    // the script components of all game objects are updated together, at their place in the update order
+    const int scriptPriority = ComponentMetaInfo<ScriptComponent>::priority();
     for(auto gameObject : m_gameObjects.values())
     {
-        gameObject->update(elapsedMs);
+        gameObject->update(elapsedMs, std::numeric_limits<int>::min(), scriptPriority);
+    }
+    m_pScriptBatches->update(elapsedMs);
+    for(auto gameObject : m_gameObjects.values())
+    {
+        gameObject->update(elapsedMs, scriptPriority + 1, std::numeric_limits<int>::max());
+    }
+}
+
+size_t gpp::GameObjectManager::queryNearest(const gep::vec3& position, gep::ArrayPtr<GameObject*> result)
+{
+    updateSpatialIndex();
+    m_nearestProxies.resize(result.length());
+    const size_t count = m_spatialGrid.queryNearest(position, m_nearestProxies.toArray());
+    for(size_t i = 0; i < count; i++)
+    {
+        result[i] = static_cast<GameObject*>(m_spatialGrid.getUserData(m_nearestProxies[i]));
+    }
+    return count;
+}
+
+gep::uint32 gpp::GameObjectManager::findInRadius(const gep::vec3& center, float radius)
+{
+    m_foundObjects.clear();
+    auto collect = [&](GameObject* pGameObject) -> bool
+    {
+        m_foundObjects.append(pGameObject);
+        return true;
+    };
+    queryRadius(center, radius, collect);
+    return static_cast<gep::uint32>(m_foundObjects.length());
+}
+
+gep::uint32 gpp::GameObjectManager::findInBox(const gep::vec3& min, const gep::vec3& max)
+{
+    m_foundObjects.clear();
+    auto collect = [&](GameObject* pGameObject) -> bool
+    {
+        m_foundObjects.append(pGameObject);
+        return true;
+    };
+    queryAabb(min, max, collect);
+    return static_cast<gep::uint32>(m_foundObjects.length());
+}
+
+gep::uint32 gpp::GameObjectManager::findNearest(const gep::vec3& position, gep::uint32 count)
+{
+    m_foundObjects.resize(count);
+    m_foundObjects.resize(queryNearest(position, m_foundObjects.toArray()));
+    return static_cast<gep::uint32>(m_foundObjects.length());
+}
+
+gpp::GameObject* gpp::GameObjectManager::getFoundObject(gep::uint32 index)
+{
+    GEP_ASSERT(index >= 1 && index <= m_foundObjects.length(), "index out of bounds", index, m_foundObjects.length());
+    return m_foundObjects[index - 1];
+}
+
+void gpp::GameObjectManager::setSpatialCellSize(float cellSize)
+{
+    updateSpatialIndex();
+    m_spatialGrid.setCellSize(cellSize);
+}
+
+void gpp::GameObjectManager::markTransformDirty(GameObject* pGameObject)
+{
+    // before the initialization the game object gets its proxy with its current transform anyway
+    if(pGameObject->m_isTransformDirty || pGameObject->m_spatialProxy == gep::SpatialGrid::INVALID_PROXY)
+        return;
+    pGameObject->m_isTransformDirty = true;
+    m_dirtyObjects.append(pGameObject);
+}
+
+void gpp::GameObjectManager::updateSpatialIndex()
+{
+    for(auto pGameObject : m_dirtyObjects)
+    {
+        updateSpatialProxy(pGameObject);
+        pGameObject->m_isTransformDirty = false;
     }
+    m_dirtyObjects.clear();
 }
 
-gpp::GameObject::GameObject() :
+void gpp::GameObjectManager::updateSpatialProxy(GameObject* pGameObject)
+{
+    const gep::vec3 position = pGameObject->getPosition();
+    m_spatialGrid.update(pGameObject->m_spatialProxy,
+                         position - pGameObject->m_boundsHalfExtents,
+                         position + pGameObject->m_boundsHalfExtents);
+}
+
+gpp::GameObject::GameObject(gep::IAllocator* pAllocator) :
     m_name(),
     m_isActive(true),
     m_defaultTransform(),
     m_transform(&m_defaultTransform),
-    m_components(),
-    m_updateQueue()
-   
+    m_components(pAllocator),
+    m_updateQueue(pAllocator),
+    m_boundsHalfExtents(),
+    m_spatialProxy(gep::SpatialGrid::INVALID_PROXY),
+    m_isTransformDirty(false)
 {
     
 }
@@ -82,11 +213,13 @@ gpp::GameObject::~GameObject()
 void gpp::GameObject::setPosition(const gep::vec3& pos)
 {
     m_transform->setPosition(pos);
+    g_gameObjectManager.markTransformDirty(this);
 }
 
 void gpp::GameObject::setRotation(const gep::Quaternion& rot)
 {
     m_transform->setRotation(rot);
+    g_gameObjectManager.markTransformDirty(this);
 }
 
 void gpp::GameObject::setScale(const gep::vec3& scale)
@@ -94,6 +227,12 @@ void gpp::GameObject::setScale(const gep::vec3& scale)
     m_transform->setScale(scale);
 }
 
+void gpp::GameObject::setBounds(const gep::vec3& halfExtents)
+{
+    m_boundsHalfExtents = halfExtents;
+    g_gameObjectManager.markTransformDirty(this);
+}
+
 gep::vec3 gpp::GameObject::getPosition()
 {
     return m_transform->getPosition();
@@ -109,11 +248,19 @@ gep::vec3 gpp::GameObject::getScale()
     return m_transform->getScale();
 }
 
-void gpp::GameObject::update(float elapsedMs)
+void gpp::GameObject::update(float elapsedMs, int minPriority, int endPriority)
 {
+    // the update queue is sorted by priority
     for(auto component :  m_updateQueue)
     {
-        component.component->update(elapsedMs);
+        if(component.priority >= endPriority)
+        {
+            break;
+        }
+        if(component.priority >= minPriority)
+        {
+            component.component->update(elapsedMs);
+        }
     }
 }
 
@@ -138,6 +285,8 @@ void gpp::GameObject::destroy()
 
     m_components.clear();
     m_updateQueue.resize(0);
+    m_spatialProxy = gep::SpatialGrid::INVALID_PROXY;
+    m_isTransformDirty = false;
 }
 
 gep::mat4 gpp::GameObject::getTransformationMatrix()
@@ -115,6 +115,9 @@ class TestScriptingManager : public gep::IScriptingManager
     virtual gep::int32 memoryUsed() const override { return 0; }
     virtual void collectGarbage() override {}
     virtual void debugBreak(const char*) const override {}
+    virtual void setProfilingEnabled(bool) override {}
+    virtual bool isProfilingEnabled() const override { return false; }
+    virtual void exportProfile(const std::string&, const std::string&) override {}
     virtual void bindEnum(const char* enumName, ...) override {}
     virtual void initialize() override {}
     virtual void destroy() override {}
@@ -0,0 +1,4 @@
+#pragma once
+#include "gep/unittest/UnittestManager.h"
+
+GEP_UNITTEST_GROUP(Memory);
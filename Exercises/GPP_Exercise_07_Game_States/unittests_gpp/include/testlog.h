@@ -62,6 +62,9 @@ namespace gpp
         virtual void deregisterSink(gep::ILogSink* pSink) override
         {
         }
+        virtual void flush() override
+        {
+        }
 
     private:
 
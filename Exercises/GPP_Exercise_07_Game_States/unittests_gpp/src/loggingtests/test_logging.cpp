@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include "Test_Logging.h"
+#include "gepimpl/subsystems/logging.h"
+#include "gep/threading/thread.h"
+#include "gep/timer.h"
+#include "testLog.h"
+#include <stdarg.h>
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// only called by the format thread, read after a flush
+    class CollectingSink : public ILogSink
+    {
+    public:
+        DynamicArray<std::string> messages;
+        DynamicArray<LogChannel> channels;
+
+        virtual void take(LogChannel channel, const char* msg) override
+        {
+            messages.append(msg);
+            channels.append(channel);
+        }
+    };
+
+    class LoggingThread : public Thread
+    {
+    public:
+        LoggingThread(ILogging& logging, uint32 id, uint32 numMessages) :
+            m_logging(logging), m_id(id), m_numMessages(numMessages) {}
+
+        virtual void run() override
+        {
+            for(uint32 i = 0; i < m_numMessages; i++)
+                m_logging.logMessage("thread %u message %u", m_id, i);
+        }
+
+    private:
+        ILogging& m_logging;
+        uint32 m_id;
+        uint32 m_numMessages;
+    };
+
+    std::string formatDirectly(const char* fmt, ...)
+    {
+        char buffer[Logging::MAX_RECORD_SIZE];
+        va_list argptr;
+        va_start(argptr, fmt);
+        vsprintf_s(buffer, fmt, argptr);
+        va_end(argptr);
+        return buffer;
+    }
+}
+
+GEP_UNITTEST_TEST(Logging, DeferredFormatting)
+{
+    CollectingSink sink;
+    DynamicArray<std::string> expected;
+    {
+        Logging logging;
+        logging.registerSink(&sink);
+
+        // the arguments are copied, so the string can change before the format thread gets to it
+        char text[16] = "before";
+        logging.logMessage("%s|%5s|%-5s|%.2s", text, "ab", "cd", "truncated");
+        expected.append(formatDirectly("%s|%5s|%-5s|%.2s", "before", "ab", "cd", "truncated"));
+        strcpy_s(text, "after");
+
+        logging.logMessage("%d %i %u %x %X %o %c %%", -42, 7, 42u, 255, 255, 8, 'z');
+        expected.append(formatDirectly("%d %i %u %x %X %o %c %%", -42, 7, 42u, 255, 255, 8, 'z'));
+        logging.logWarning("%hd %hu %ld %lld %llu", 70000, 70000, -5L, -1234567890123LL, 18446744073709551615ULL);
+        expected.append(formatDirectly("%hd %hu %ld %lld %llu", 70000, 70000, -5L, -1234567890123LL, 18446744073709551615ULL));
+        logging.logMessage("%f %.3f %10.2e %g %-8.1f|", 3.14159, 2.0, 12345.678, 0.0001, -1.5f);
+        expected.append(formatDirectly("%f %.3f %10.2e %g %-8.1f|", 3.14159, 2.0, 12345.678, 0.0001, -1.5f));
+        logging.logMessage("%*d|%-*d|%.*f|%*.*s|", 6, 1, 6, 2, 2, 1.23456, 8, 3, "stars");
+        expected.append(formatDirectly("%*d|%-*d|%.*f|%*.*s|", 6, 1, 6, 2, 2, 1.23456, 8, 3, "stars"));
+        logging.logMessage("%+d % d %05d %#x %s", 5, 5, 42, 255, (const char*)nullptr);
+        expected.append(formatDirectly("%+d % d %05d %#x %s", 5, 5, 42, 255, "(null)"));
+        logging.logMessageUnformatted("unformatted %d %s stays as it is");
+        expected.append("unformatted %d %s stays as it is");
+
+        // strings longer than a record are cut
+        std::string longText(3 * Logging::MAX_RECORD_SIZE, 'x');
+        logging.logMessage("%s", longText.c_str());
+        logging.logErrorUnformatted(longText.c_str());
+
+        logging.flush();
+        GEP_ASSERT(sink.messages.length() == expected.length() + 2, "every message has to arrive", sink.messages.length());
+        for(size_t i = 0; i < expected.length(); i++)
+        {
+            GEP_ASSERT(sink.messages[i] == expected[i], "the deferred formatting has to match printf", i, sink.messages[i], expected[i]);
+        }
+        GEP_ASSERT(sink.channels[2] == LogChannel::warning, "wrong channel");
+        GEP_ASSERT(sink.messages[expected.length()].length() < Logging::MAX_RECORD_SIZE, "long messages have to be cut");
+        GEP_ASSERT(sink.channels[expected.length() + 1] == LogChannel::error, "wrong channel");
+
+        logging.deregisterSink(&sink);
+    }
+}
+
+GEP_UNITTEST_TEST(Logging, ThreadsAndRateLimit)
+{
+    const uint32 numThreads = 4;
+    const uint32 numMessages = 5000;
+    CollectingSink sink;
+    {
+        Logging logging;
+        logging.registerSink(&sink);
+        logging.setMaxRepeatsPerSecond(0);
+
+        // more messages than fit into a ring buffer, so the threads have to wait for the format thread
+        DynamicArray<LoggingThread*> threads;
+        for(uint32 i = 0; i < numThreads; i++)
+            threads.append(new LoggingThread(logging, i, numMessages));
+        for(auto pThread : threads)
+            pThread->start();
+        for(auto pThread : threads)
+        {
+            pThread->join();
+            delete pThread;
+        }
+        logging.flush();
+        GEP_ASSERT(sink.messages.length() == numThreads * numMessages, "every message has to arrive", sink.messages.length());
+
+        // the messages of each thread arrive in order
+        uint32 nextMessage[numThreads] = {};
+        for(auto& message : sink.messages)
+        {
+            unsigned int thread, index;
+            const int numRead = sscanf_s(message.c_str(), "thread %u message %u", &thread, &index);
+            GEP_ASSERT(numRead == 2 && thread < numThreads && index == nextMessage[thread], "wrong message", message);
+            nextMessage[thread] = index + 1;
+        }
+
+        // the same message only gets through a few times per second, however many seconds the loop takes
+        sink.messages.resize(0);
+        logging.setMaxRepeatsPerSecond(5);
+        Timer timer;
+        const double start = timer.getTimeAsDouble();
+        for(uint32 i = 0; i < 1000; i++)
+            logging.logWarning("repeated warning %u", 7u);
+        const double seconds = (timer.getTimeAsDouble() - start) / 1000.0;
+        logging.logMessageUnformatted("another message");
+        logging.flush();
+        GEP_ASSERT(sink.messages.length() >= 6 && sink.messages.length() <= 5 * (size_t(seconds) + 2) + 1,
+            "the repetitions have to be limited", sink.messages.length());
+        GEP_ASSERT(sink.messages.lastElement() == "another message", "other messages are not limited");
+
+        // the same format with other arguments is another message
+        sink.messages.resize(0);
+        const char* names[] = { "a.thModel", "b.thModel", "c.thModel", "d.thModel", "e.thModel", "f.thModel", "g.thModel", "h.thModel" };
+        for(uint32 i = 0; i < 20; i++)
+            logging.logMessage("loaded resource '%s' number %u", names[i % GEP_ARRAY_SIZE(names)], i);
+        logging.flush();
+        GEP_ASSERT(sink.messages.length() == 20, "messages with different arguments are not limited", sink.messages.length());
+
+        logging.deregisterSink(&sink);
+    }
+}
+
+GEP_UNITTEST_TEST(Logging, LoggingBenchmark)
+{
+    // bursts which fit into the ring buffer, so the calls don't wait for the format thread
+    const uint32 numBursts = 200;
+    const uint32 burstSize = 500;
+    const uint32 numMessages = numBursts * burstSize;
+    CollectingSink sink;
+    sink.messages.reserve(numMessages + 1);
+    sink.channels.reserve(numMessages + 1);
+    Logging logging;
+    logging.registerSink(&sink);
+    logging.setMaxRepeatsPerSecond(0);
+
+    Timer timer;
+    double start = timer.getTimeAsDouble();
+    char buffer[Logging::MAX_RECORD_SIZE];
+    size_t checksum = 0;
+    for(uint32 i = 0; i < numMessages; i++)
+    {
+        sprintf_s(buffer, "frame %u took %.3f ms in %s", i, float(i) * 0.01f, "update");
+        checksum += buffer[7];
+    }
+    const double formattingTime = timer.getTimeAsDouble() - start;
+
+    double loggingTime = 0.0;
+    double flushTime = 0.0;
+    for(uint32 burst = 0; burst < numBursts; burst++)
+    {
+        start = timer.getTimeAsDouble();
+        for(uint32 i = burst * burstSize; i < (burst + 1) * burstSize; i++)
+            logging.logMessage("frame %u took %.3f ms in %s", i, float(i) * 0.01f, "update");
+        const double logged = timer.getTimeAsDouble();
+        logging.flush();
+        loggingTime += logged - start;
+        flushTime += timer.getTimeAsDouble() - logged;
+    }
+    GEP_ASSERT(sink.messages.length() == numMessages, "every message has to arrive", sink.messages.length());
+
+    TestLogging::instance().logMessage("%u messages: formatting on the calling thread %.2f ms, logging %.2f ms, waiting for the format thread %.2f ms (%u)",
+        numMessages, formattingTime, loggingTime, flushTime, uint32(checksum & 1));
+    logging.deregisterSink(&sink);
+}
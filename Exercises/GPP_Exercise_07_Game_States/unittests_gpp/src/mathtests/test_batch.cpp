@@ -0,0 +1,292 @@
+#include "stdafx.h"
+#include "Test_Math.h"
+#include "gep/math3d/batch.h"
+#include "gep/math3d/aabb.h"
+#include "gep/math3d/quaternion.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/threading/semaphore.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(54321) {}
+
+        float next(float min, float max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return min + (max - min) * ((m_state >> 8) / float(1 << 24));
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    mat4 randomTransformation(Random& random)
+    {
+        vec3 axis(random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f), random.next(0.1f, 1.0f));
+        vec3 translation(random.next(-100.0f, 100.0f), random.next(-100.0f, 100.0f), random.next(-100.0f, 100.0f));
+        return mat4::translationMatrix(translation)
+             * Quaternion(axis.normalized(), random.next(-180.0f, 180.0f)).toMat4()
+             * mat4::scaleMatrix(vec3(random.next(0.5f, 2.0f), random.next(0.5f, 2.0f), random.next(0.5f, 2.0f)));
+    }
+
+    vec3 randomPoint(Random& random)
+    {
+        return vec3(random.next(-50.0f, 50.0f), random.next(-50.0f, 50.0f), random.next(-50.0f, 50.0f));
+    }
+
+    bool isBitEqual(const vec3& lhs, const vec3& rhs)
+    {
+        return memcmp(lhs.data, rhs.data, sizeof(lhs.data)) == 0;
+    }
+
+    /// the bounds of the 8 transformed corners
+    void transformCorners(const mat4& m, const AABB& box, vec3& min, vec3& max)
+    {
+        vec3 corners[8];
+        box.getVertices(corners);
+        min = vec3(std::numeric_limits<float>::max());
+        max = vec3(-std::numeric_limits<float>::max());
+        for(auto& corner : corners)
+        {
+            vec3 transformed = m.transformPosition(corner);
+            for(int axis = 0; axis < 3; axis++)
+            {
+                min.data[axis] = GEP_MIN(min.data[axis], transformed.data[axis]);
+                max.data[axis] = GEP_MAX(max.data[axis], transformed.data[axis]);
+            }
+        }
+    }
+
+    /// sums the range on the task queue many times in a row
+    size_t sumRepeatedly(TaskQueue& taskQueue, size_t count, size_t numRounds)
+    {
+        size_t numWrong = 0;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            volatile LONG sum = 0;
+            taskQueue.runParallel(count, 16, [&](size_t start, size_t end){
+                LONG partialSum = 0;
+                for(size_t i = start; i < end; i++)
+                    partialSum += LONG(i);
+                InterlockedExchangeAdd(&sum, partialSum);
+            });
+            if(sum != LONG(count * (count - 1) / 2))
+                numWrong++;
+        }
+        return numWrong;
+    }
+
+    /// calls runParallel on its own thread, like a resource loader does
+    class ParallelCaller : public Thread
+    {
+    public:
+        size_t numWrong;
+
+        ParallelCaller(TaskQueue& taskQueue) : numWrong(0), m_taskQueue(taskQueue) {}
+
+        virtual void run() override { numWrong = sumRepeatedly(m_taskQueue, 1000, 2000); }
+
+    private:
+        TaskQueue& m_taskQueue;
+    };
+}
+
+GEP_UNITTEST_TEST(Math, BatchKernels)
+{
+    Random random;
+    // not a multiple of 4, so the scalar tail is tested as well
+    const size_t count = 1023;
+    mat4 m = randomTransformation(random);
+
+    DynamicArray<vec3> points;
+    batch::Vec3StreamArray<> pointStreams, results;
+    for(size_t i=0; i < count; i++)
+    {
+        points.append(randomPoint(random));
+        pointStreams.append(points.lastElement());
+    }
+    results.resize(count);
+
+    batch::transformPositions(m, pointStreams.getStreams(), results.getStreams());
+    for(size_t i=0; i < count; i++)
+        GEP_ASSERT(isBitEqual(results.getStreams().get(i), m.transformPosition(points[i])), "batch transform differs from transformPosition", i);
+
+    // in place
+    batch::transformPositions(m, pointStreams.getStreams(), pointStreams.getStreams());
+    for(size_t i=0; i < count; i++)
+        GEP_ASSERT(isBitEqual(pointStreams.getStreams().get(i), results.getStreams().get(i)), "in place batch transform differs", i);
+
+    // bounds, from both layouts
+    vec3 expectedMin(std::numeric_limits<float>::max()), expectedMax(-std::numeric_limits<float>::max());
+    for(auto& point : points)
+    {
+        for(int axis = 0; axis < 3; axis++)
+        {
+            expectedMin.data[axis] = GEP_MIN(expectedMin.data[axis], point.data[axis]);
+            expectedMax.data[axis] = GEP_MAX(expectedMax.data[axis], point.data[axis]);
+        }
+    }
+    vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+    batch::extendBounds(points.toArray(), min, max);
+    GEP_ASSERT(isBitEqual(min, expectedMin) && isBitEqual(max, expectedMax), "bounds of packed points are wrong");
+    results.clear();
+    for(auto& point : points)
+        results.append(point);
+    min = vec3(std::numeric_limits<float>::max());
+    max = vec3(-std::numeric_limits<float>::max());
+    batch::extendBounds(results.getStreams(), min, max);
+    GEP_ASSERT(isBitEqual(min, expectedMin) && isBitEqual(max, expectedMax), "bounds of streamed points are wrong");
+
+    // boxes, compared to the transformed corners
+    batch::Vec3StreamArray<> boxMin, boxMax;
+    for(size_t i=0; i < count; i++)
+    {
+        vec3 corner = points[i];
+        boxMin.append(corner);
+        boxMax.append(corner + vec3(random.next(0.1f, 10.0f), random.next(0.1f, 10.0f), random.next(0.1f, 10.0f)));
+    }
+    batch::BoxStreams boxes(boxMin.getStreams(), boxMax.getStreams());
+    DynamicArray<AABB> originalBoxes;
+    for(size_t i=0; i < count; i++)
+        originalBoxes.append(AABB(boxes.min.get(i), boxes.max.get(i)));
+    batch::transformBoxes(m, boxes, boxes);
+    for(size_t i=0; i < count; i++)
+    {
+        transformCorners(m, originalBoxes[i], expectedMin, expectedMax);
+        for(int axis = 0; axis < 3; axis++)
+        {
+            GEP_ASSERT(fabsf(boxes.min.get(i).data[axis] - expectedMin.data[axis]) < 1e-3f, "transformed box min is wrong", i, axis);
+            GEP_ASSERT(fabsf(boxes.max.get(i).data[axis] - expectedMax.data[axis]) < 1e-3f, "transformed box max is wrong", i, axis);
+        }
+    }
+
+    // matrices
+    DynamicArray<mat4> locals, concatenated;
+    for(size_t i=0; i < 64; i++)
+        locals.append(randomTransformation(random));
+    concatenated.resize(locals.length());
+    batch::multiply(m, locals.toArray(), concatenated.toArray());
+    for(size_t i=0; i < locals.length(); i++)
+    {
+        mat4 expected = m * locals[i];
+        GEP_ASSERT(memcmp(expected.data, concatenated[i].data, sizeof(expected.data)) == 0, "batch multiply differs", i);
+    }
+    batch::multiply(locals.toArray(), locals.toArray(), concatenated.toArray());
+    for(size_t i=0; i < locals.length(); i++)
+    {
+        mat4 expected = locals[i] * locals[i];
+        GEP_ASSERT(memcmp(expected.data, concatenated[i].data, sizeof(expected.data)) == 0, "pairwise batch multiply differs", i);
+    }
+}
+
+GEP_UNITTEST_TEST(Math, BatchBenchmark)
+{
+    Random random;
+    const size_t count = 1024 * 64;
+    const size_t numRounds = 32;
+    mat4 m = randomTransformation(random);
+
+    DynamicArray<vec3> points, transformed;
+    batch::Vec3StreamArray<> pointStreams, results;
+    for(size_t i=0; i < count; i++)
+    {
+        points.append(randomPoint(random));
+        pointStreams.append(points.lastElement());
+    }
+    transformed.resize(count);
+    results.resize(count);
+
+    Timer timer;
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        for(size_t i=0; i < count; i++)
+            transformed[i] = m.transformPosition(points[i]);
+    }
+    double perPointTime = timer.getTimeAsDouble();
+
+    timer = Timer();
+    for(size_t round = 0; round < numRounds; round++)
+        batch::transformPositions(m, pointStreams.getStreams(), results.getStreams());
+    double batchTime = timer.getTimeAsDouble();
+
+    TaskQueue taskQueue;
+    timer = Timer();
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        auto in = pointStreams.getStreams();
+        auto out = results.getStreams();
+        taskQueue.runParallel(count, 4096, [&](size_t start, size_t end){
+            batch::transformPositions(m, in.slice(start, end), out.slice(start, end));
+        });
+    }
+    double parallelTime = timer.getTimeAsDouble();
+    for(size_t i=0; i < count; i++)
+        GEP_ASSERT(isBitEqual(results.getStreams().get(i), transformed[i]), "parallel batch transform differs", i);
+
+    TestLogging::instance().logMessage("transforming %u points: %.3f ms per point, %.3f ms batched, %.3f ms batched in parallel",
+        count * numRounds, perPointTime, batchTime, parallelTime);
+
+    vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+    timer = Timer();
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        for(auto& point : points)
+        {
+            if(point.x < min.x) min.x = point.x;
+            if(point.y < min.y) min.y = point.y;
+            if(point.z < min.z) min.z = point.z;
+            if(point.x > max.x) max.x = point.x;
+            if(point.y > max.y) max.y = point.y;
+            if(point.z > max.z) max.z = point.z;
+        }
+    }
+    double loopTime = timer.getTimeAsDouble();
+
+    timer = Timer();
+    for(size_t round = 0; round < numRounds; round++)
+        batch::extendBounds(points.toArray(), min, max);
+    batchTime = timer.getTimeAsDouble();
+
+    TestLogging::instance().logMessage("bounds of %u points: %.3f ms with a loop, %.3f ms batched",
+        count * numRounds, loopTime, batchTime);
+}
+
+GEP_UNITTEST_TEST(Math, RunParallelFromTwoThreads)
+{
+    // the groups are recycled right after they finished, while the workers may still be leaving them
+    TaskQueue taskQueue;
+    ParallelCaller caller(taskQueue);
+    caller.start();
+    const size_t numWrong = sumRepeatedly(taskQueue, 1000, 2000);
+    caller.join();
+    GEP_ASSERT(numWrong == 0 && caller.numWrong == 0, "runParallel returned before all chunks were done", numWrong, caller.numWrong);
+}
+
+GEP_UNITTEST_TEST(Math, RunParallelWhileGroupRuns)
+{
+    // a single task goes to the last worker and keeps its group running until it is released
+    TaskQueue taskQueue;
+    Semaphore release(0), finished(0);
+    StandardTask blockingTask([&](){ release.waitAndDecrement(); });
+    auto pGroup = taskQueue.createGroup();
+    pGroup->addTask(&blockingTask);
+    pGroup->setOnFinished([&](ArrayPtr<ITask*>){ finished.increment(); });
+    taskQueue.scheduleForExecution(pGroup);
+
+    // the chunks of the local worker would wait behind the running group
+    const size_t numWrong = sumRepeatedly(taskQueue, 1000, 10);
+    GEP_ASSERT(numWrong == 0, "runParallel returned before all chunks were done", numWrong);
+
+    release.increment();
+    finished.waitAndDecrement();
+    taskQueue.deleteGroup(pGroup);
+}
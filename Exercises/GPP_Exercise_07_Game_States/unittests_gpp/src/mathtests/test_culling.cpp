@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "Test_Math.h"
+#include "gep/cullingHierarchy.h"
+#include "gep/math3d/frustum.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(4711) {}
+
+        float next(float min, float max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return min + (max - min) * ((m_state >> 8) / float(1 << 24));
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    /// the reference: a point is visible if its clip coordinates are in the view volume
+    bool isInViewVolume(const mat4& viewProjection, const vec3& point)
+    {
+        vec4 clip = viewProjection * vec4(point, 1.0f);
+        return clip.w > 0.0f && fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z >= 0.0f && clip.z <= clip.w;
+    }
+
+    mat4 randomViewProjection(Random& random)
+    {
+        vec3 from(random.next(-100.0f, 100.0f), random.next(0.0f, 20.0f), random.next(-100.0f, 100.0f));
+        vec3 to(random.next(-100.0f, 100.0f), 0.0f, random.next(-100.0f, 100.0f));
+        return mat4::projectionMatrix(60.0f, 1.0f, 1.0f, 500.0f) * mat4::lookAtMatrix(from, to, vec3(0.0f, 1.0f, 0.0f));
+    }
+}
+
+GEP_UNITTEST_TEST(Math, FrustumPlanes)
+{
+    Random random;
+    for(int i=0; i < 10; i++)
+    {
+        mat4 viewProjection = randomViewProjection(random);
+        Frustum frustum(viewProjection);
+        for(int j=0; j < 1000; j++)
+        {
+            vec3 point(random.next(-600.0f, 600.0f), random.next(-600.0f, 600.0f), random.next(-600.0f, 600.0f));
+            GEP_ASSERT(frustum.contains(point) == isInViewVolume(viewProjection, point), "frustum and view volume disagree", i, j);
+        }
+    }
+}
+
+GEP_UNITTEST_TEST(Math, CullingHierarchy)
+{
+    Random random;
+
+    // a root with groups of small boxes, like the nodes of a level model
+    CullingHierarchy hierarchy;
+    uint32 root = hierarchy.addNode(CullingHierarchy::NO_PARENT, mat4::translationMatrix(vec3(5.0f, 0.0f, 0.0f)));
+    for(int group = 0; group < 8; group++)
+    {
+        vec3 groupPosition(random.next(-300.0f, 300.0f), random.next(-50.0f, 50.0f), random.next(-300.0f, 300.0f));
+        uint32 groupNode = hierarchy.addNode(root, mat4::translationMatrix(groupPosition));
+        for(int i = 0; i < 20; i++)
+        {
+            vec3 position(random.next(-40.0f, 40.0f), random.next(-10.0f, 10.0f), random.next(-40.0f, 40.0f));
+            uint32 node = hierarchy.addNode(groupNode, mat4::translationMatrix(position));
+            hierarchy.addBounds(node, vec3(-1.0f), vec3(1.0f));
+        }
+    }
+    hierarchy.finish();
+    GEP_ASSERT(hierarchy.getNumNodes() == 1 + 8 * 21, "wrong number of nodes", hierarchy.getNumNodes());
+    GEP_ASSERT(hierarchy.getNumNodesWithBounds() == 8 * 20, "wrong number of nodes with bounds", hierarchy.getNumNodesWithBounds());
+    GEP_ASSERT(!hierarchy.hasBounds(root), "the root has no boxes");
+
+    DynamicArray<uint32> visibleNodes;
+    visibleNodes.resize(hierarchy.getNumNodesWithBounds());
+    DynamicArray<bool> isVisible;
+    uint32 totalVisible = 0, totalCulled = 0;
+    for(int i = 0; i < 20; i++)
+    {
+        mat4 modelMatrix = mat4::translationMatrix(vec3(random.next(-20.0f, 20.0f), 0.0f, random.next(-20.0f, 20.0f)));
+        Frustum frustum(randomViewProjection(random));
+        auto result = hierarchy.cull(frustum.toLocalSpace(modelMatrix), visibleNodes.toArray());
+        GEP_ASSERT(result.numVisible + result.numCulled == hierarchy.getNumNodesWithBounds(), "nodes got lost", i);
+        totalVisible += result.numVisible;
+        totalCulled += result.numCulled;
+
+        isVisible.resize(hierarchy.getNumNodes());
+        for(auto& visible : isVisible)
+            visible = false;
+        for(uint32 j = 0; j < result.numVisible; j++)
+        {
+            GEP_ASSERT(j == 0 || visibleNodes[j - 1] < visibleNodes[j], "the visible nodes are not in order", i, j);
+            isVisible[visibleNodes[j]] = true;
+        }
+
+        // every node on its own against the frustum in world space
+        for(uint32 node = 0; node < hierarchy.getNumNodes(); node++)
+        {
+            if(!hierarchy.hasBounds(node))
+            {
+                GEP_ASSERT(!isVisible[node], "a node without bounds is visible", i, node);
+                continue;
+            }
+            vec3 min, max;
+            hierarchy.getBounds(node, min, max);
+            bool expected = frustum.test(modelMatrix.transformPosition(min), modelMatrix.transformPosition(max)) != FrustumIntersection::Outside;
+            GEP_ASSERT(isVisible[node] == expected, "hierarchical culling differs from testing every node", i, node);
+        }
+    }
+    GEP_ASSERT(totalVisible > 0 && totalCulled > 0, "the cameras did not test both cases", totalVisible, totalCulled);
+    TestLogging::instance().logMessage("culling hierarchy: %u nodes visible, %u culled", totalVisible, totalCulled);
+}
@@ -0,0 +1,215 @@
+#include "stdafx.h"
+#include "Test_Math.h"
+#include "gep/math3d/mat4.h"
+#include "gep/math3d/quaternion.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(12345) {}
+
+        float next(float min, float max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return min + (max - min) * ((m_state >> 8) / float(1 << 24));
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    /// a well conditioned matrix with a translation and random rotation and scale
+    mat4 randomMatrix(Random& random)
+    {
+        mat4 m(DO_NOT_INITIALIZE);
+        for(auto& value : m.data)
+            value = random.next(-1.0f, 1.0f);
+        m.data[0] += 4.0f;
+        m.data[5] += 4.0f;
+        m.data[10] += 4.0f;
+        m.data[12] *= 100.0f;
+        m.data[13] *= 100.0f;
+        m.data[14] *= 100.0f;
+        m.data[3] = m.data[7] = m.data[11] = 0.0f;
+        m.data[15] = 1.0f;
+        return m;
+    }
+
+    Quaternion randomRotation(Random& random)
+    {
+        vec3 axis(random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f), random.next(0.1f, 1.0f));
+        return Quaternion(axis.normalized(), random.next(-180.0f, 180.0f));
+    }
+
+    bool isBitEqual(const float* lhs, const float* rhs, size_t count)
+    {
+        return memcmp(lhs, rhs, sizeof(float) * count) == 0;
+    }
+
+    float maxDifference(const float* lhs, const float* rhs, size_t count)
+    {
+        float result = 0.0f;
+        for(size_t i=0; i < count; i++)
+            result = GEP_MAX(result, fabsf(lhs[i] - rhs[i]));
+        return result;
+    }
+
+    void logTimes(const char* name, size_t count, double scalarTime, double simdTime)
+    {
+        TestLogging::instance().logMessage("%s x %u: %.3f ms scalar, %.3f ms simd (%.2fx)",
+            name, count, scalarTime, simdTime, scalarTime / GEP_MAX(simdTime, 0.001));
+    }
+}
+
+GEP_UNITTEST_TEST(Math, SimdBitAccuracy)
+{
+    TestLogging::instance().logMessage("GEP_MATH_SIMD = %d", GEP_MATH_SIMD);
+    Random random;
+    for(int i=0; i < 1000; i++)
+    {
+        mat4 a = randomMatrix(random);
+        mat4 b = randomMatrix(random);
+        mat4 expected(DO_NOT_INITIALIZE);
+
+        simd::multiply4x4<float>(a.data, b.data, expected.data);
+        mat4 product = a * b;
+        GEP_ASSERT(isBitEqual(product.data, expected.data, 16), "mat4 multiplication differs from the scalar path", i);
+
+        simd::transpose4x4<float>(a.data, expected.data);
+        mat4 transposed = a.transposed();
+        GEP_ASSERT(isBitEqual(transposed.data, expected.data, 16), "transposing differs from the scalar path", i);
+
+        vec4 v(random.next(-10.0f, 10.0f), random.next(-10.0f, 10.0f), random.next(-10.0f, 10.0f), 1.0f);
+        vec4 expectedVector(DO_NOT_INITIALIZE);
+        simd::transform4<float>(a.data, v.data, expectedVector.data);
+        vec4 transformed = a * v;
+        GEP_ASSERT(isBitEqual(transformed.data, expectedVector.data, 4), "mat4 * vec4 differs from the scalar path", i);
+        GEP_ASSERT(maxDifference(transformed.xyz().data, a.transformPosition(v.xyz()).data, 3) < 1e-3f, "mat4 * vec4 differs from transformPosition", i);
+
+        Quaternion q = randomRotation(random);
+        Quaternion normalized = q.normalized();
+        simd::quaternionToMatrix<float>(normalized.data, expected.data);
+        mat4 rotation = q.toMat4();
+        GEP_ASSERT(isBitEqual(rotation.data, expected.data, 16), "quaternion to matrix differs from the scalar path", i);
+
+        // the blockwise inverse rounds differently, compare the result instead of the bits
+        float expectedDet = simd::inverse4x4<float>(a.data, expected.data);
+        GEP_ASSERT(fabsf(expectedDet - a.det()) <= 1e-4f * fabsf(expectedDet), "determinant differs", i, expectedDet, a.det());
+        mat4 inverse = a.inverse();
+        GEP_ASSERT(maxDifference(inverse.data, expected.data, 16) < 1e-4f, "inverse differs from the scalar path", i);
+        mat4 identity = a * inverse;
+        GEP_ASSERT(maxDifference(identity.data, mat4::identity().data, 16) < 1e-4f, "M * inverse(M) is not the identity", i);
+    }
+
+    // singular matrices still give the identity
+    mat4 singular;
+    GEP_ASSERT(isBitEqual(singular.inverse().data, mat4::identity().data, 16), "inverse of a singular matrix is not the identity");
+}
+
+GEP_UNITTEST_TEST(Math, SimdBenchmark)
+{
+    const size_t numMatrices = 1024;
+    const size_t numRounds = 256;
+    const size_t count = numMatrices * numRounds;
+
+    Random random;
+    DynamicArray<mat4> matrices;
+    DynamicArray<vec4> vectors;
+    DynamicArray<mat4> results;
+    results.resize(numMatrices);
+    for(size_t i=0; i < numMatrices; i++)
+    {
+        matrices.append(randomMatrix(random));
+        vectors.append(vec4(random.next(-10.0f, 10.0f), random.next(-10.0f, 10.0f), random.next(-10.0f, 10.0f), 1.0f));
+    }
+
+    // the scalar path is called through the templates, the simd one through the overloads for float
+    double times[2];
+    for(int useSimd = 0; useSimd < 2; useSimd++)
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(size_t i=0; i < numMatrices; i++)
+            {
+                auto& lhs = matrices[i];
+                auto& rhs = matrices[(i + round + 1) % numMatrices];
+                if(useSimd) simd::multiply4x4(lhs.data, rhs.data, results[i].data);
+                else        simd::multiply4x4<float>(lhs.data, rhs.data, results[i].data);
+            }
+        }
+        times[useSimd] = timer.getTimeAsDouble();
+    }
+    logTimes("mat4 * mat4", count, times[0], times[1]);
+
+    for(int useSimd = 0; useSimd < 2; useSimd++)
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(size_t i=0; i < numMatrices; i++)
+            {
+                if(useSimd) simd::transform4(matrices[i].data, vectors[(i + round) % numMatrices].data, results[i].data);
+                else        simd::transform4<float>(matrices[i].data, vectors[(i + round) % numMatrices].data, results[i].data);
+            }
+        }
+        times[useSimd] = timer.getTimeAsDouble();
+    }
+    logTimes("mat4 * vec4", count, times[0], times[1]);
+
+    for(int useSimd = 0; useSimd < 2; useSimd++)
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(size_t i=0; i < numMatrices; i++)
+            {
+                if(useSimd) simd::inverse4x4(matrices[i].data, results[i].data);
+                else        simd::inverse4x4<float>(matrices[i].data, results[i].data);
+            }
+        }
+        times[useSimd] = timer.getTimeAsDouble();
+    }
+    logTimes("inverse", count, times[0], times[1]);
+
+    for(int useSimd = 0; useSimd < 2; useSimd++)
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(size_t i=0; i < numMatrices; i++)
+            {
+                if(useSimd) simd::transpose4x4(matrices[i].data, results[i].data);
+                else        simd::transpose4x4<float>(matrices[i].data, results[i].data);
+            }
+        }
+        times[useSimd] = timer.getTimeAsDouble();
+    }
+    logTimes("transpose", count, times[0], times[1]);
+
+    // the old cofactor expansion, for comparison with the new scalar inverse
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds / 16; round++)
+        {
+            for(size_t i=0; i < numMatrices; i++)
+            {
+                auto& m = matrices[i];
+                float det = m.det();
+                for(int row = 0; row < 4; row++)
+                    for(int column = 0; column < 4; column++)
+                        results[i].data[row + column * 4] = m.submat(row, column).det() * (1 - ((row + column) % 2) * 2) / det;
+            }
+        }
+        TestLogging::instance().logMessage("inverse with cofactor expansion x %u: %.3f ms", count / 16, timer.getTimeAsDouble());
+    }
+}
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+#include "Test_Math.h"
+#include "gep/spatialGrid.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(4711) {}
+
+        float next(float min, float max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return min + (max - min) * ((m_state >> 8) / float(1 << 24));
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    struct Box
+    {
+        vec3 min;
+        vec3 max;
+        uint32 proxy;
+    };
+
+    Box randomBox(Random& random, float worldSize, float maxSize)
+    {
+        Box box;
+        const vec3 center(random.next(-worldSize, worldSize), random.next(-worldSize, worldSize), random.next(-worldSize, worldSize));
+        const vec3 halfSize(random.next(0.0f, maxSize), random.next(0.0f, maxSize), random.next(0.0f, maxSize));
+        box.min = center - halfSize;
+        box.max = center + halfSize;
+        box.proxy = SpatialGrid::INVALID_PROXY;
+        return box;
+    }
+
+    float squaredDistance(const Box& box, const vec3& point)
+    {
+        float result = 0.0f;
+        for(int i = 0; i < 3; i++)
+        {
+            const float d = GEP_MAX(box.min.data[i] - point.data[i], GEP_MAX(point.data[i] - box.max.data[i], 0.0f));
+            result += d * d;
+        }
+        return result;
+    }
+
+    bool overlaps(const Box& box, const vec3& min, const vec3& max)
+    {
+        return box.min.x <= max.x && min.x <= box.max.x &&
+               box.min.y <= max.y && min.y <= box.max.y &&
+               box.min.z <= max.z && min.z <= box.max.z;
+    }
+
+    /// compares the queries of the grid with testing every box
+    void checkQueries(const SpatialGrid& grid, const DynamicArray<Box>& boxes, Random& random)
+    {
+        for(int query = 0; query < 50; query++)
+        {
+            const Box queryBox = randomBox(random, 60.0f, 15.0f);
+            size_t expected = 0;
+            for(auto& box : boxes)
+                expected += overlaps(box, queryBox.min, queryBox.max) ? 1 : 0;
+            size_t found = 0;
+            auto countBox = [&](uint32 proxy) -> bool
+            {
+                const Box& box = *static_cast<const Box*>(grid.getUserData(proxy));
+                GEP_ASSERT(overlaps(box, queryBox.min, queryBox.max), "the box doesn't overlap the query", proxy);
+                found++;
+                return true;
+            };
+            grid.queryAabb(queryBox.min, queryBox.max, countBox);
+            GEP_ASSERT(found == expected, "the box query has to find every overlapping box", query, found, expected);
+
+            const vec3 center = (queryBox.min + queryBox.max) * 0.5f;
+            const float radius = random.next(0.0f, 20.0f);
+            expected = 0;
+            for(auto& box : boxes)
+                expected += squaredDistance(box, center) <= radius * radius ? 1 : 0;
+            found = 0;
+            auto countSphere = [&](uint32 proxy) -> bool { found++; return true; };
+            grid.queryRadius(center, radius, countSphere);
+            GEP_ASSERT(found == expected, "the radius query has to find every overlapping box", query, found, expected);
+
+            uint32 nearest[8];
+            const uint32 numNearest = grid.queryNearest(center, ArrayPtr<uint32>(nearest));
+            GEP_ASSERT(numNearest == GEP_MIN(8, uint32(boxes.length())), "wrong number of nearest boxes", numNearest);
+            float previous = 0.0f;
+            for(uint32 i = 0; i < numNearest; i++)
+            {
+                const float distance = squaredDistance(*static_cast<const Box*>(grid.getUserData(nearest[i])), center);
+                GEP_ASSERT(distance >= previous, "the nearest boxes have to be sorted", i, distance, previous);
+                previous = distance;
+            }
+            size_t closer = 0;
+            for(auto& box : boxes)
+                closer += squaredDistance(box, center) < previous ? 1 : 0;
+            GEP_ASSERT(closer < numNearest, "a closer box was missed", query, closer);
+        }
+    }
+}
+
+GEP_UNITTEST_TEST(Math, SpatialGrid)
+{
+    Random random;
+    SpatialGrid grid(4.0f);
+    DynamicArray<Box> boxes;
+    boxes.reserve(2000);
+    for(int i = 0; i < 2000; i++)
+    {
+        // some boxes are larger than the cells
+        boxes.append(randomBox(random, 50.0f, i % 100 == 0 ? 10.0f : 1.5f));
+        boxes.lastElement().proxy = grid.insert(boxes.lastElement().min, boxes.lastElement().max, &boxes.lastElement());
+    }
+    GEP_ASSERT(grid.getNumProxies() == 2000, "wrong number of proxies", grid.getNumProxies());
+    checkQueries(grid, boxes, random);
+
+    // move every box a little, some of them into other cells
+    for(auto& box : boxes)
+    {
+        const vec3 offset(random.next(-3.0f, 3.0f), random.next(-3.0f, 3.0f), random.next(-3.0f, 3.0f));
+        box.min += offset;
+        box.max += offset;
+        grid.update(box.proxy, box.min, box.max);
+    }
+    checkQueries(grid, boxes, random);
+
+    // remove half of the boxes, the freed proxies are reused
+    DynamicArray<Box> remaining;
+    remaining.reserve(boxes.length());
+    for(size_t i = 0; i < boxes.length(); i++)
+    {
+        if(i % 2 == 0)
+            grid.remove(boxes[i].proxy);
+        else
+            remaining.append(boxes[i]);
+    }
+    for(auto& box : remaining)
+        grid.update(box.proxy, box.min, box.max);
+    // the user data still points to the old array
+    for(size_t i = 0; i < remaining.length(); i++)
+    {
+        grid.remove(remaining[i].proxy);
+        remaining[i].proxy = grid.insert(remaining[i].min, remaining[i].max, &remaining[i]);
+    }
+    GEP_ASSERT(grid.getNumProxies() == 1000, "wrong number of proxies", grid.getNumProxies());
+    checkQueries(grid, remaining, random);
+
+    grid.setCellSize(10.0f);
+    checkQueries(grid, remaining, random);
+
+    // a single box far away is still the nearest one
+    SpatialGrid sparse(1.0f);
+    Box far = { vec3(1000.0f, 0.0f, 0.0f), vec3(1001.0f, 1.0f, 1.0f), SpatialGrid::INVALID_PROXY };
+    far.proxy = sparse.insert(far.min, far.max, &far);
+    uint32 nearest[4];
+    GEP_ASSERT(sparse.queryNearest(vec3(0.0f), ArrayPtr<uint32>(nearest)) == 1 && nearest[0] == far.proxy, "the far box has to be found");
+    sparse.remove(far.proxy);
+    GEP_ASSERT(sparse.getNumCells() == 0, "empty cells have to be removed", sparse.getNumCells());
+}
+
+GEP_UNITTEST_TEST(Math, SpatialGridBenchmark)
+{
+    Random random;
+    const size_t numObjects = 100000;
+    const float worldSize = 500.0f;
+    SpatialGrid grid(8.0f);
+    DynamicArray<Box> boxes;
+    boxes.resize(numObjects);
+
+    Timer timer;
+    double start = timer.getTimeAsDouble();
+    for(size_t i = 0; i < numObjects; i++)
+    {
+        boxes[i] = randomBox(random, worldSize, 2.0f);
+        boxes[i].proxy = grid.insert(boxes[i].min, boxes[i].max, &boxes[i]);
+    }
+    const double insertTime = timer.getTimeAsDouble() - start;
+
+    // a tenth of the objects moves every frame
+    start = timer.getTimeAsDouble();
+    for(size_t i = 0; i < numObjects; i += 10)
+    {
+        const vec3 offset(random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f), random.next(-1.0f, 1.0f));
+        boxes[i].min += offset;
+        boxes[i].max += offset;
+        grid.update(boxes[i].proxy, boxes[i].min, boxes[i].max);
+    }
+    const double updateTime = timer.getTimeAsDouble() - start;
+
+    const size_t numQueries = 10000;
+    size_t numFound = 0;
+    auto count = [&](uint32 proxy) -> bool { numFound++; return true; };
+    start = timer.getTimeAsDouble();
+    for(size_t i = 0; i < numQueries; i++)
+    {
+        const vec3 center(random.next(-worldSize, worldSize), random.next(-worldSize, worldSize), random.next(-worldSize, worldSize));
+        grid.queryRadius(center, 20.0f, count);
+    }
+    const double radiusTime = timer.getTimeAsDouble() - start;
+
+    start = timer.getTimeAsDouble();
+    for(size_t i = 0; i < numQueries; i++)
+    {
+        const vec3 min(random.next(-worldSize, worldSize), random.next(-worldSize, worldSize), random.next(-worldSize, worldSize));
+        grid.queryAabb(min, min + vec3(30.0f), count);
+    }
+    const double aabbTime = timer.getTimeAsDouble() - start;
+
+    uint32 nearest[8];
+    start = timer.getTimeAsDouble();
+    for(size_t i = 0; i < numQueries; i++)
+    {
+        const vec3 position(random.next(-worldSize, worldSize), random.next(-worldSize, worldSize), random.next(-worldSize, worldSize));
+        numFound += grid.queryNearest(position, ArrayPtr<uint32>(nearest));
+    }
+    const double nearestTime = timer.getTimeAsDouble() - start;
+
+    TestLogging::instance().logMessage("spatial grid with %u objects in %u cells: insert %.2f ms, moving a tenth %.2f ms",
+        numObjects, grid.getNumCells(), insertTime, updateTime);
+    TestLogging::instance().logMessage("%u queries: radius %.2f ms, box %.2f ms, 8 nearest %.2f ms, %u objects found",
+        numQueries, radiusTime, aabbTime, nearestTime, numFound);
+}
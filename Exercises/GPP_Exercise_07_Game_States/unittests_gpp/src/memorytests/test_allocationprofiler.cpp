@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "Test_Memory.h"
+#include "gep/memory/allocationProfiler.h"
+#include "gep/timer.h"
+#include "testLog.h"
+#include <sstream>
+#include <cmath>
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// the profiler only looks at the addresses, so the allocations don't have to exist
+    void* fakeAllocation(size_t index)
+    {
+        return (void*)(0x10000 + index * 16);
+    }
+
+    bool isCollapsedStackLine(const std::string& line)
+    {
+        auto space = line.rfind(' ');
+        return space != std::string::npos && space > 0 && space + 1 < line.length()
+            && line.find_first_not_of("0123456789", space + 1) == std::string::npos;
+    }
+}
+
+GEP_UNITTEST_TEST(Memory, AllocationProfiler)
+{
+    // a sample rate of one byte samples every allocation, so the estimates are exact
+    {
+        AllocationProfiler profiler(1);
+        for(size_t i = 0; i < 1000; i++)
+        {
+            profiler.trackAllocation(fakeAllocation(i), 16);
+            if(i % 100 == 0)
+                profiler.trackAllocation(fakeAllocation(1000 + i), 4096);
+        }
+        GEP_ASSERT(profiler.getNumStacks() == 2, "identical callstacks have to be stored once", profiler.getNumStacks());
+        auto totals = profiler.getTotals();
+        GEP_ASSERT(totals.numSamples == 1010, "not every allocation was sampled", totals.numSamples);
+        GEP_ASSERT(fabs(totals.allocatedBytes - (16000.0 + 40960.0)) < 1.0, "wrong allocated bytes", totals.allocatedBytes);
+
+        for(size_t i = 0; i < 500; i++)
+            profiler.trackFree(fakeAllocation(i));
+        profiler.trackFree(fakeAllocation(5000)); // never sampled
+        totals = profiler.getTotals();
+        GEP_ASSERT(fabs(totals.liveBytes - (8000.0 + 40960.0)) < 1.0, "wrong live bytes", totals.liveBytes);
+        GEP_ASSERT(fabs(totals.allocatedBytes - (16000.0 + 40960.0)) < 1.0, "frees must not change the allocated bytes");
+
+        std::stringstream output;
+        profiler.writeLiveBytes(output);
+        std::string line;
+        size_t numLines = 0;
+        while(std::getline(output, line))
+        {
+            GEP_ASSERT(isCollapsedStackLine(line), "not in the collapsed stack format", line);
+            numLines++;
+        }
+        GEP_ASSERT(numLines == 2, "every callstack with live bytes needs a line", numLines);
+
+        profiler.reset(1);
+        GEP_ASSERT(profiler.getNumStacks() == 0 && profiler.getTotals().numSamples == 0, "reset did not discard the samples");
+    }
+
+    // with a real sample rate only a few allocations are sampled, but the estimates stay close
+    {
+        const size_t sampleRate = 4096;
+        const size_t numAllocations = 200000;
+        const size_t size = 64;
+        AllocationProfiler profiler(sampleRate);
+        for(size_t i = 0; i < numAllocations; i++)
+            profiler.trackAllocation(fakeAllocation(i), size);
+        auto totals = profiler.getTotals();
+        const double expectedBytes = double(numAllocations * size);
+        GEP_ASSERT(totals.numSamples < numAllocations / 10, "too many samples", totals.numSamples);
+        GEP_ASSERT(fabs(totals.allocatedBytes - expectedBytes) < 0.1 * expectedBytes, "estimated allocated bytes are off", totals.allocatedBytes, expectedBytes);
+        GEP_ASSERT(fabs(totals.liveBytes - expectedBytes) < 0.1 * expectedBytes, "estimated live bytes are off", totals.liveBytes, expectedBytes);
+        GEP_ASSERT(fabs(totals.allocations - numAllocations) < 0.1 * numAllocations, "estimated allocations are off", totals.allocations);
+
+        for(size_t i = 0; i < numAllocations; i++)
+            profiler.trackFree(fakeAllocation(i));
+        GEP_ASSERT(fabs(profiler.getTotals().liveBytes) < 1.0, "all sampled allocations were freed");
+    }
+}
+
+GEP_UNITTEST_TEST(Memory, AllocationProfilerBenchmark)
+{
+    auto& logging = TestLogging::instance();
+    const size_t numAllocations = 1000000;
+    void* allocations[64];
+
+    auto run = [&]() -> double {
+        Timer timer;
+        for(size_t i = 0; i < numAllocations; i++)
+        {
+            auto& allocation = allocations[i % GEP_ARRAY_SIZE(allocations)];
+            if(i >= GEP_ARRAY_SIZE(allocations))
+                g_stdAllocator.freeMemory(allocation);
+            allocation = g_stdAllocator.allocateMemory(16 + i % 256);
+        }
+        for(auto allocation : allocations)
+            g_stdAllocator.freeMemory(allocation);
+        return timer.getTimeAsDouble();
+    };
+
+    GEP_ASSERT(StdAllocator::getProfiler() == nullptr, "the standard allocator is already being profiled");
+    const double withoutProfiler = run();
+
+    AllocationProfiler profiler;
+    StdAllocator::setProfiler(&profiler);
+    const double withProfiler = run();
+    StdAllocator::setProfiler(nullptr);
+
+    auto totals = profiler.getTotals();
+    logging.logMessage("%u allocations: %.2f ms without profiler, %.2f ms with a sample rate of %u bytes, %u samples in %u callstacks",
+        uint32(numAllocations), withoutProfiler, withProfiler, uint32(profiler.getSampleRate()), totals.numSamples, uint32(profiler.getNumStacks()));
+}
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "Test_Memory.h"
+#include "gepimpl/subsystems/memoryManager.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    class WarningCounter : public TestLogging
+    {
+    public:
+        size_t numWarnings;
+
+        WarningCounter() : numWarnings(0) {}
+
+        virtual void logWarning(GEP_PRINTF_FORMAT_STRING const char* fmt, ...) override
+        {
+            numWarnings++;
+        }
+    };
+}
+
+GEP_UNITTEST_TEST(Memory, MemoryBudgets)
+{
+    WarningCounter warningCounter;
+    MemoryManager memoryManager(&warningCounter);
+    memoryManager.initialize();
+    memoryManager.setBudget(MemoryCategory::Events, 4096);
+    auto pAllocator = memoryManager.getAllocator(MemoryCategory::Events);
+
+    // two frames below the budget, the third one goes over it
+    void* allocations[3];
+    for(size_t i = 0; i < GEP_ARRAY_SIZE(allocations); i++)
+    {
+        allocations[i] = pAllocator->allocateMemory(2000);
+        memoryManager.update(16.0f);
+    }
+    auto statistics = memoryManager.getStatistics(MemoryCategory::Events);
+    GEP_ASSERT(statistics.bytesUsed == 6000, "wrong number of bytes used", statistics.bytesUsed);
+    GEP_ASSERT(pAllocator->getNumBytesReserved() > 6000, "the reserved bytes have to include the headers", pAllocator->getNumBytesReserved());
+    GEP_ASSERT(statistics.lastFrameDelta == 2000, "wrong delta", statistics.lastFrameDelta);
+    GEP_ASSERT(statistics.isOverBudget && warningCounter.numWarnings == 1, "going over the budget has to be reported once", warningCounter.numWarnings);
+
+    // staying over the budget does not warn again
+    memoryManager.update(16.0f);
+    GEP_ASSERT(warningCounter.numWarnings == 1, "the warning was repeated", warningCounter.numWarnings);
+    GEP_ASSERT(memoryManager.getStatistics(MemoryCategory::Events).lastFrameDelta == 0, "nothing was allocated during the frame");
+
+    // other categories are not affected
+    GEP_ASSERT(memoryManager.getStatistics(MemoryCategory::Physics).bytesUsed == 0, "the allocations ended up in the wrong category");
+
+    for(auto allocation : allocations)
+        pAllocator->freeMemory(allocation);
+    memoryManager.update(16.0f);
+    statistics = memoryManager.getStatistics(MemoryCategory::Events);
+    GEP_ASSERT(statistics.bytesUsed == 0 && !statistics.isOverBudget, "the category did not recover", statistics.bytesUsed);
+    GEP_ASSERT(statistics.lastFrameDelta == -6000, "wrong delta", statistics.lastFrameDelta);
+    GEP_ASSERT(statistics.highWaterMark == 6000, "wrong high water mark", statistics.highWaterMark);
+    GEP_ASSERT(pAllocator->getNumBytesReserved() == 0, "the freed memory is still reserved", pAllocator->getNumBytesReserved());
+
+    int64 deltas[IMemoryManager::NUM_TRACKED_FRAMES];
+    const int64 expectedDeltas[] = { 2000, 2000, 2000, 0, -6000 };
+    const size_t numFrames = memoryManager.getFrameDeltas(MemoryCategory::Events, ArrayPtr<int64>(deltas));
+    GEP_ASSERT(numFrames == GEP_ARRAY_SIZE(expectedDeltas), "wrong number of frames", numFrames);
+    for(size_t i = 0; i < numFrames; i++)
+        GEP_ASSERT(deltas[i] == expectedDeltas[i], "wrong delta, the oldest frame has to come first", i, deltas[i]);
+
+    // only the most recent frames are kept
+    for(size_t i = 0; i < IMemoryManager::NUM_TRACKED_FRAMES; i++)
+        memoryManager.update(16.0f);
+    GEP_ASSERT(memoryManager.getFrameDeltas(MemoryCategory::Events, ArrayPtr<int64>(deltas)) == IMemoryManager::NUM_TRACKED_FRAMES);
+    GEP_ASSERT(deltas[0] == 0, "an old delta was not overwritten", deltas[0]);
+
+    memoryManager.destroy();
+}
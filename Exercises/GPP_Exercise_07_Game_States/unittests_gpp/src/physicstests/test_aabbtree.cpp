@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "Test_Physics.h"
+#include "gepimpl/subsystems/physics/native/aabbTree.h"
+
+using namespace gep;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(12345) {}
+
+        float next(float min, float max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return min + (max - min) * ((m_state >> 8) / float(1 << 24));
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    struct Box
+    {
+        vec3 min;
+        vec3 max;
+        uint32 proxy;
+        bool isInTree;
+    };
+
+    void randomBox(Random& random, Box& box)
+    {
+        vec3 center(random.next(-100.0f, 100.0f), random.next(-100.0f, 100.0f), random.next(-100.0f, 100.0f));
+        vec3 halfExtents(random.next(0.5f, 5.0f), random.next(0.5f, 5.0f), random.next(0.5f, 5.0f));
+        box.min = center - halfExtents;
+        box.max = center + halfExtents;
+    }
+
+    struct QueryCollector
+    {
+        DynamicArray<uint32> proxies;
+
+        bool operator()(uint32 proxy)
+        {
+            proxies.append(proxy);
+            return true;
+        }
+    };
+}
+
+GEP_UNITTEST_TEST(Physics, AabbTree)
+{
+    Random random;
+    const size_t count = 1000;
+    const float margin = 0.5f;
+    AabbTree tree(margin);
+
+    DynamicArray<Box> boxes;
+    boxes.resize(count);
+    for(size_t i=0; i < count; i++)
+    {
+        randomBox(random, boxes[i]);
+        boxes[i].proxy = tree.insert(boxes[i].min, boxes[i].max, &boxes[i]);
+        boxes[i].isInTree = true;
+    }
+    tree.validate();
+    GEP_ASSERT(tree.getNumProxies() == count, "wrong number of proxies", tree.getNumProxies());
+    // a balanced tree of 1000 leaves is about 10 levels deep
+    GEP_ASSERT(tree.getHeight() < 20, "the tree is not balanced", tree.getHeight());
+
+    // move some boxes a little and some far, remove and reinsert others
+    for(size_t round = 0; round < 10; round++)
+    {
+        for(size_t i=0; i < count; i++)
+        {
+            Box& box = boxes[(i * 7 + round) % count];
+            if(i % 5 == 0)
+            {
+                if(box.isInTree)
+                    tree.remove(box.proxy);
+                else
+                    box.proxy = tree.insert(box.min, box.max, &box);
+                box.isInTree = !box.isInTree;
+            }
+            else if(box.isInTree)
+            {
+                vec3 displacement = i % 3 == 0
+                    ? vec3(random.next(-20.0f, 20.0f), random.next(-20.0f, 20.0f), random.next(-20.0f, 20.0f))
+                    : vec3(random.next(-0.1f, 0.1f), random.next(-0.1f, 0.1f), random.next(-0.1f, 0.1f));
+                box.min += displacement;
+                box.max += displacement;
+                tree.update(box.proxy, box.min, box.max, displacement);
+            }
+        }
+        tree.validate();
+    }
+
+    size_t numInTree = 0;
+    for(auto& box : boxes)
+    {
+        if(!box.isInTree)
+            continue;
+        numInTree++;
+        GEP_ASSERT(tree.getUserData(box.proxy) == &box, "wrong user data", box.proxy);
+        const vec3& fatMin = tree.getFatMin(box.proxy);
+        const vec3& fatMax = tree.getFatMax(box.proxy);
+        GEP_ASSERT(fatMin.x <= box.min.x && fatMin.y <= box.min.y && fatMin.z <= box.min.z
+                && fatMax.x >= box.max.x && fatMax.y >= box.max.y && fatMax.z >= box.max.z,
+                "the fat box has to contain the tight box", box.proxy);
+    }
+    GEP_ASSERT(tree.getNumProxies() == numInTree, "wrong number of proxies", tree.getNumProxies(), numInTree);
+
+    // the queries have to find exactly the fat boxes a brute force search finds
+    for(size_t i=0; i < 100; i++)
+    {
+        Box queryBox;
+        randomBox(random, queryBox);
+        QueryCollector collector;
+        tree.query(queryBox.min, queryBox.max, collector);
+
+        size_t expected = 0;
+        for(auto& box : boxes)
+        {
+            if(!box.isInTree || !AabbTree::overlaps(tree.getFatMin(box.proxy), tree.getFatMax(box.proxy), queryBox.min, queryBox.max))
+                continue;
+            expected++;
+            bool found = false;
+            for(auto proxy : collector.proxies)
+                found = found || proxy == box.proxy;
+            GEP_ASSERT(found, "the query missed a proxy", box.proxy);
+        }
+        GEP_ASSERT(collector.proxies.length() == expected, "the query found proxies which don't overlap",
+            collector.proxies.length(), expected);
+    }
+
+    // ray casts which don't clip have to hit every fat box on the segment
+    for(size_t i=0; i < 100; i++)
+    {
+        vec3 from(random.next(-150.0f, 150.0f), random.next(-150.0f, 150.0f), -150.0f);
+        vec3 to(random.next(-150.0f, 150.0f), random.next(-150.0f, 150.0f), 150.0f);
+        DynamicArray<uint32> hits;
+        auto callback = [&](uint32 proxy, float maxFraction) -> float
+        {
+            hits.append(proxy);
+            return maxFraction;
+        };
+        tree.castRay(from, to, 1.0f, callback);
+
+        size_t expected = 0;
+        for(auto& box : boxes)
+        {
+            if(box.isInTree && AabbTree::intersectsRay(tree.getFatMin(box.proxy), tree.getFatMax(box.proxy), from, to - from, 1.0f))
+                expected++;
+        }
+        GEP_ASSERT(hits.length() == expected, "the ray cast missed boxes", hits.length(), expected);
+
+        // returning 0 stops the cast
+        size_t numCalls = 0;
+        auto stop = [&](uint32 proxy, float maxFraction) -> float
+        {
+            numCalls++;
+            return 0.0f;
+        };
+        tree.castRay(from, to, 1.0f, stop);
+        GEP_ASSERT(numCalls == (expected > 0 ? 1 : 0), "the ray cast has to stop", numCalls);
+    }
+
+    for(auto& box : boxes)
+    {
+        if(box.isInTree)
+            tree.remove(box.proxy);
+    }
+    GEP_ASSERT(tree.getNumProxies() == 0, "all proxies were removed", tree.getNumProxies());
+    GEP_ASSERT(tree.getHeight() == 0, "the empty tree has no height", tree.getHeight());
+}
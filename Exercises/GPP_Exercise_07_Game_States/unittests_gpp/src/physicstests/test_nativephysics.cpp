@@ -0,0 +1,260 @@
+#include "stdafx.h"
+#include "Test_Physics.h"
+#include "gepimpl/subsystems/physics/nativePhysics.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gep::native;
+using namespace gpp;
+
+namespace
+{
+    class CountingListener : public IContactListener
+    {
+    public:
+        IRigidBody* pBody;
+        IRigidBody* pLastOther;
+        size_t numCallbacks;
+
+        CountingListener(IRigidBody* pBody) : pBody(pBody), pLastOther(nullptr), numCallbacks(0) {}
+
+        virtual void contactPointCallback(const ContactPointArgs& evt) override
+        {
+            auto& args = const_cast<ContactPointArgs&>(evt);
+            GEP_ASSERT(args.getBody(0) == pBody, "the first body has to be the one the listener is attached to");
+            pLastOther = args.getBody(1);
+            numCallbacks++;
+        }
+        virtual void collisionAddedCallback(const CollisionArgs& evt) override {}
+        virtual void collisionRemovedCallback(const CollisionArgs& evt) override {}
+    };
+
+    SmartPtr<IRigidBody> addBody(IPhysicsFactory& factory, IWorld& world, IShape* shape,
+                                 MotionType::Enum motionType, const vec3& position)
+    {
+        RigidBodyCInfo cinfo;
+        cinfo.shape = shape;
+        cinfo.motionType = motionType;
+        cinfo.mass = 1.0f;
+        cinfo.position = position;
+        SmartPtr<IRigidBody> pBody = factory.createRigidBody(cinfo);
+        world.addEntity(pBody.get());
+        return pBody;
+    }
+
+    /// columns of 5 unit boxes on the ground, returns the number of simulated bodies per millisecond
+    double simulateStacks(IPhysicsFactory& factory, TaskQueue* pTaskQueue, size_t numBodies, size_t numSteps)
+    {
+        WorldCInfo worldCInfo;
+        worldCInfo.gravity = vec3(0.0f, 0.0f, -9.81f);
+        SmartPtr<NativeWorld> pWorld = static_cast<NativeWorld*>(factory.createWorld(worldCInfo));
+        pWorld->setTaskQueue(pTaskQueue);
+
+        SmartPtr<IShape> pGroundShape = factory.createBox(vec3(500.0f, 500.0f, 1.0f));
+        SmartPtr<IShape> pBoxShape = factory.createBox(vec3(0.5f, 0.5f, 0.5f));
+        auto pGround = addBody(factory, *pWorld, pGroundShape.get(), MotionType::Fixed, vec3(0.0f, 0.0f, -1.0f));
+
+        DynamicArray< SmartPtr<IRigidBody> > bodies;
+        const size_t side = size_t(sqrtf(numBodies / 5.0f)) + 1;
+        for(size_t i=0; i < numBodies; i++)
+        {
+            const size_t column = i / 5;
+            const vec3 position(float(column % side) * 3.0f, float(column / side) * 3.0f, 0.5f + float(i % 5));
+            bodies.append(addBody(factory, *pWorld, pBoxShape.get(), MotionType::Dynamic, position));
+        }
+
+        Timer timer;
+        for(size_t step = 0; step < numSteps; step++)
+            pWorld->step(1.0f / 60.0f);
+        const double time = timer.getTimeAsDouble();
+
+        for(size_t i=4; i < numBodies; i += 5)
+        {
+            const float z = bodies[i]->getPosition().z;
+            GEP_ASSERT(z > 4.3f && z < 4.6f, "the stack fell over", i, z);
+        }
+        return double(numBodies * numSteps) / time;
+    }
+}
+
+GEP_UNITTEST_TEST(Physics, NativeCollision)
+{
+    Hull box;
+    box.setBox(vec3(1.0f, 2.0f, 3.0f));
+    GEP_ASSERT(box.vertices.length() == 8 && box.faces.length() == 6 && box.edges.length() == 12,
+        "wrong box hull", box.vertices.length(), box.faces.length(), box.edges.length());
+
+    vec3 corners[8];
+    for(int i=0; i < 8; i++)
+        corners[i] = vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 2.0f : -2.0f, i & 4 ? 3.0f : -3.0f);
+    Hull hull;
+    GEP_ASSERT(hull.setConvexHull(ArrayPtr<vec3>(corners)) == SUCCESS, "the hull of a box has to succeed");
+    GEP_ASSERT(hull.vertices.length() == 8 && hull.faces.length() == 6 && hull.edges.length() == 12,
+        "the hull of the corners of a box is a box", hull.vertices.length(), hull.faces.length(), hull.edges.length());
+
+    vec3 flat[4] = { vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f) };
+    GEP_ASSERT(hull.setConvexHull(ArrayPtr<vec3>(flat)) == FAILURE, "points in a plane have no hull");
+
+    Hull groundHull, cubeHull;
+    groundHull.setBox(vec3(100.0f, 100.0f, 10.0f));
+    cubeHull.setBox(vec3(1.0f, 1.0f, 1.0f));
+    CollisionShape ground = { ShapeType::Box, 0.0f, &groundHull };
+    CollisionShape cube = { ShapeType::Box, 0.0f, &cubeHull };
+    CollisionShape sphere = { ShapeType::Sphere, 1.0f, nullptr };
+    Transform groundTransform = { vec3(0.0f, 0.0f, -10.0f), mat3::identity() };
+    Transform restingTransform = { vec3(0.0f, 0.0f, 0.99f), mat3::identity() };
+    Manifold manifold;
+
+    GEP_ASSERT(collide(cube, restingTransform, ground, groundTransform, 0.1f, 0.01f, manifold), "the cube touches the ground");
+    GEP_ASSERT(manifold.numPoints == 4, "a face contact has 4 points", manifold.numPoints);
+    GEP_ASSERT(manifold.normal.z < -0.99f, "the normal points from the cube to the ground", manifold.normal.z);
+    for(uint32 i=0; i < manifold.numPoints; i++)
+        GEP_ASSERT(fabsf(manifold.points[i].separation + 0.01f) < 0.001f, "wrong separation", i, manifold.points[i].separation);
+
+    GEP_ASSERT(collide(sphere, restingTransform, ground, groundTransform, 0.1f, 0.01f, manifold), "the sphere touches the ground");
+    GEP_ASSERT(manifold.numPoints == 1 && fabsf(manifold.points[0].separation + 0.01f) < 0.001f, "wrong sphere contact", manifold.points[0].separation);
+    GEP_ASSERT(collide(ground, groundTransform, sphere, restingTransform, 0.1f, 0.01f, manifold), "the ground touches the sphere");
+    GEP_ASSERT(manifold.normal.z > 0.99f, "swapping the shapes flips the normal", manifold.normal.z);
+
+    Transform farTransform = { vec3(0.0f, 0.0f, 5.0f), mat3::identity() };
+    GEP_ASSERT(!collide(cube, farTransform, ground, groundTransform, 0.1f, 0.01f, manifold), "the cube is far above the ground");
+    // within the margin the contact is speculative
+    Transform closeTransform = { vec3(0.0f, 0.0f, 1.05f), mat3::identity() };
+    GEP_ASSERT(collide(cube, closeTransform, ground, groundTransform, 0.1f, 0.01f, manifold), "the gap is smaller than the margin");
+    GEP_ASSERT(manifold.points[0].separation > 0.0f, "speculative contacts have a positive separation", manifold.points[0].separation);
+
+    // a cube standing on an edge touches the ground with 2 points
+    Transform edgeTransform = { vec3(0.0f, 0.0f, 1.4f), Quaternion(vec3(1.0f, 0.0f, 0.0f), 45.0f).toMat3() };
+    GEP_ASSERT(collide(cube, edgeTransform, ground, groundTransform, 0.1f, 0.01f, manifold), "the edge touches the ground");
+    GEP_ASSERT(manifold.numPoints == 2, "an edge contact has 2 points", manifold.numPoints);
+
+    float fraction;
+    GEP_ASSERT(castRay(cube, restingTransform, vec3(0.0f, 0.0f, 10.0f), vec3(0.0f, 0.0f, -10.0f), 1.0f, fraction), "the ray hits the cube");
+    GEP_ASSERT(fabsf(fraction - (10.0f - 1.99f) / 20.0f) < 0.001f, "wrong fraction", fraction);
+    GEP_ASSERT(castRay(sphere, restingTransform, vec3(0.0f, 0.0f, 10.0f), vec3(0.0f, 0.0f, -10.0f), 1.0f, fraction), "the ray hits the sphere");
+    GEP_ASSERT(fabsf(fraction - (10.0f - 1.99f) / 20.0f) < 0.001f, "wrong fraction", fraction);
+    GEP_ASSERT(!castRay(cube, restingTransform, vec3(5.0f, 0.0f, 10.0f), vec3(5.0f, 0.0f, -10.0f), 1.0f, fraction), "the ray misses the cube");
+}
+
+GEP_UNITTEST_TEST(Physics, NativeWorld)
+{
+    NativePhysicsFactory factory(&g_stdAllocator);
+    factory.initialize();
+
+    WorldCInfo worldCInfo;
+    worldCInfo.gravity = vec3(0.0f, 0.0f, -9.81f);
+    SmartPtr<NativeWorld> pWorld = static_cast<NativeWorld*>(factory.createWorld(worldCInfo));
+
+    SmartPtr<IShape> pGroundShape = factory.createBox(vec3(50.0f, 50.0f, 1.0f));
+    SmartPtr<IShape> pBoxShape = factory.createBox(vec3(0.5f, 0.5f, 0.5f));
+    SmartPtr<IShape> pSphereShape = factory.createSphere(0.5f);
+    auto pGround = addBody(factory, *pWorld, pGroundShape.get(), MotionType::Fixed, vec3(0.0f, 0.0f, -1.0f));
+    auto pBox = addBody(factory, *pWorld, pBoxShape.get(), MotionType::Dynamic, vec3(0.0f, 0.0f, 3.0f));
+    auto pSphere = addBody(factory, *pWorld, pSphereShape.get(), MotionType::Dynamic, vec3(5.0f, 0.0f, 3.0f));
+    CountingListener listener(pSphere.get());
+    pSphere->addContactListener(&listener);
+
+    // falls for about 0.6 seconds and then rests on the ground
+    for(int step = 0; step < 180; step++)
+        pWorld->step(1.0f / 60.0f);
+    GEP_ASSERT(fabsf(pBox->getPosition().z - 0.5f) < 0.05f, "the box has to rest on the ground", pBox->getPosition().z);
+    GEP_ASSERT(fabsf(pSphere->getPosition().z - 0.5f) < 0.05f, "the sphere has to rest on the ground", pSphere->getPosition().z);
+    GEP_ASSERT(listener.numCallbacks > 0 && listener.pLastOther == pGround.get(), "the sphere has to report hitting the ground", listener.numCallbacks);
+
+    for(int step = 0; step < 60; step++)
+        pWorld->step(1.0f / 60.0f);
+    GEP_ASSERT(!pBox->isActive() && !pSphere->isActive(), "resting bodies have to fall asleep");
+
+    pBox->applyLinearImpulse(vec3(0.0f, 0.0f, 5.0f));
+    GEP_ASSERT(pBox->isActive(), "impulses wake bodies up");
+    pWorld->step(1.0f / 60.0f);
+    GEP_ASSERT(pBox->getPosition().z > 0.55f, "the box has to jump", pBox->getPosition().z);
+
+    RayCastInput input;
+    input.from = vec3(5.0f, 0.0f, 10.0f);
+    input.to = vec3(5.0f, 0.0f, -10.0f);
+    RayCastOutput output;
+    pWorld->castRay(input, output);
+    GEP_ASSERT(output.hitEntity != nullptr && output.hitEntity->getOwner() == pSphere.get(), "the ray has to hit the sphere");
+    GEP_ASSERT(fabsf(output.hitFraction - 0.45f) < 0.01f, "wrong hit fraction", output.hitFraction);
+
+    pSphere->removeContactListener(&listener);
+    pWorld->removeEntity(pSphere.get());
+    pWorld->castRay(input, output);
+    GEP_ASSERT(output.hitEntity != nullptr && output.hitEntity->getOwner() == pGround.get(), "the ray has to hit the ground");
+    GEP_ASSERT(pWorld->getNumBodies() == 2, "wrong number of bodies", pWorld->getNumBodies());
+
+    pWorld->removeEntity(pBox.get());
+    pWorld->removeEntity(pGround.get());
+    pWorld = nullptr;
+    factory.destroy();
+}
+
+GEP_UNITTEST_TEST(Physics, NativeWorldTransforms)
+{
+    NativePhysicsFactory factory(&g_stdAllocator);
+    factory.initialize();
+
+    WorldCInfo worldCInfo;
+    worldCInfo.gravity = vec3(0.0f, 0.0f, -9.81f);
+    SmartPtr<NativeWorld> pWorld = static_cast<NativeWorld*>(factory.createWorld(worldCInfo));
+    SmartPtr<IShape> pSphereShape = factory.createSphere(0.1f);
+
+    // projectiles spawned and despawned out of order
+    const size_t numProjectiles = 5000;
+    DynamicArray< SmartPtr<IRigidBody> > projectiles;
+    Timer timer;
+    double start = timer.getTimeAsDouble();
+    for(size_t i=0; i < numProjectiles; i++)
+    {
+        projectiles.append(addBody(factory, *pWorld, pSphereShape.get(), MotionType::Dynamic, vec3(float(i), 0.0f, 10.0f)));
+        projectiles.lastElement()->setLinearVelocity(vec3(0.0f, 10.0f, 0.0f));
+    }
+    const double spawnTime = timer.getTimeAsDouble() - start;
+    pWorld->step(1.0f / 60.0f);
+
+    start = timer.getTimeAsDouble();
+    for(size_t i=0; i < numProjectiles; i += 2)
+        pWorld->removeEntity(projectiles[i].get());
+    const double despawnTime = timer.getTimeAsDouble() - start;
+    GEP_ASSERT(pWorld->getTransforms().length() == numProjectiles / 2, "wrong number of transforms", pWorld->getTransforms().length());
+    GEP_ASSERT(projectiles[0]->getWorldIndex() == IRigidBody::INVALID_WORLD_INDEX, "removed bodies have no index");
+
+    projectiles[1]->setPosition(vec3(-5.0f, -5.0f, -5.0f));
+    pWorld->step(1.0f / 60.0f);
+    for(size_t i=1; i < numProjectiles; i += 2)
+    {
+        const uint32 index = projectiles[i]->getWorldIndex();
+        const auto& transform = pWorld->getTransforms()[index];
+        GEP_ASSERT(transform.position.x == projectiles[i]->getPosition().x &&
+            transform.position.y == projectiles[i]->getPosition().y &&
+            transform.position.z == projectiles[i]->getPosition().z, "the transform does not match the body", i, index);
+    }
+    GEP_ASSERT(projectiles[3]->getPosition().y > 0.3f, "the projectiles have to move", projectiles[3]->getPosition().y);
+
+    TestLogging::instance().logMessage("spawning %u projectiles: %.2f ms, despawning half of them: %.2f ms",
+        numProjectiles, spawnTime, despawnTime);
+
+    for(size_t i=1; i < numProjectiles; i += 2)
+        pWorld->removeEntity(projectiles[i].get());
+    pWorld = nullptr;
+    factory.destroy();
+}
+
+GEP_UNITTEST_TEST(Physics, NativeWorldBenchmark)
+{
+    NativePhysicsFactory factory(&g_stdAllocator);
+    factory.initialize();
+    const size_t numBodies = 2000;
+    const size_t numSteps = 60;
+
+    double serial = simulateStacks(factory, nullptr, numBodies, numSteps);
+    TaskQueue taskQueue;
+    double parallel = simulateStacks(factory, &taskQueue, numBodies, numSteps);
+
+    TestLogging::instance().logMessage("simulating %u stacked boxes: %.1f bodies per ms, %.1f bodies per ms on the task queue",
+        numBodies, serial, parallel);
+    factory.destroy();
+}
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+#include "Test_Physics.h"
+#include "gepimpl/subsystems/physics/nativePhysics.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    SmartPtr<IRigidBody> addFixedBody(IPhysicsFactory& factory, IWorld& world, IShape* shape, const vec3& position)
+    {
+        RigidBodyCInfo cinfo;
+        cinfo.shape = shape;
+        cinfo.motionType = MotionType::Fixed;
+        cinfo.position = position;
+        SmartPtr<IRigidBody> pBody = factory.createRigidBody(cinfo);
+        world.addEntity(pBody.get());
+        return pBody;
+    }
+
+    /// downward rays on a grid over the ground
+    void fillRays(ArrayPtr<RayCastInput> rays, float extent)
+    {
+        const size_t side = size_t(sqrtf(float(rays.length()))) + 1;
+        for(size_t i=0; i < rays.length(); i++)
+        {
+            const float x = (float(i % side) / float(side) - 0.5f) * extent;
+            const float y = (float(i / side) / float(side) - 0.5f) * extent;
+            rays[i].from = vec3(x, y, 20.0f);
+            rays[i].to = vec3(x, y, -20.0f);
+        }
+    }
+}
+
+GEP_UNITTEST_TEST(Physics, NativeWorldQueries)
+{
+    NativePhysicsFactory factory(&g_stdAllocator);
+    factory.initialize();
+
+    WorldCInfo worldCInfo;
+    SmartPtr<IWorld> pWorld = factory.createWorld(worldCInfo);
+
+    SmartPtr<IShape> pGroundShape = factory.createBox(vec3(50.0f, 50.0f, 1.0f));
+    SmartPtr<IShape> pBoxShape = factory.createBox(vec3(0.5f, 0.5f, 0.5f));
+    SmartPtr<IShape> pSphereShape = factory.createSphere(0.5f);
+    auto pGround = addFixedBody(factory, *pWorld, pGroundShape.get(), vec3(0.0f, 0.0f, -1.0f));
+    auto pBox = addFixedBody(factory, *pWorld, pBoxShape.get(), vec3(0.0f, 0.0f, 0.5f));
+    auto pSphere = addFixedBody(factory, *pWorld, pSphereShape.get(), vec3(5.0f, 0.0f, 0.5f));
+
+    // a batch gives the same results as casting every ray on its own
+    RayCastInput rays[64];
+    fillRays(ArrayPtr<RayCastInput>(rays), 20.0f);
+    rays[0].from = vec3(200.0f, 0.0f, 20.0f);
+    rays[0].to = vec3(200.0f, 0.0f, -20.0f);
+    RayCastOutput batchHits[64];
+    pWorld->castRays(ArrayPtr<RayCastInput>(rays), ArrayPtr<RayCastOutput>(batchHits));
+    GEP_ASSERT(batchHits[0].hitEntity == nullptr && batchHits[0].hitFraction == 1.0f, "the first ray misses everything");
+    for(size_t i=0; i < 64; i++)
+    {
+        RayCastOutput single;
+        pWorld->castRay(rays[i], single);
+        GEP_ASSERT(single.hitEntity == batchHits[i].hitEntity && single.hitFraction == batchHits[i].hitFraction,
+            "the batch has to match the single ray", i, single.hitFraction, batchHits[i].hitFraction);
+    }
+
+    // a box swept down onto the sphere stops on top of it
+    ShapeCastInput casts[2];
+    casts[0].shape = pBoxShape.get();
+    casts[0].from = vec3(5.0f, 0.0f, 10.0f);
+    casts[0].to = vec3(5.0f, 0.0f, -10.0f);
+    casts[1].shape = pSphereShape.get();
+    casts[1].from = vec3(-20.0f, 20.0f, 10.0f);
+    casts[1].to = vec3(-20.0f, 20.0f, 5.0f);
+    RayCastOutput castHits[2];
+    pWorld->castShapes(ArrayPtr<ShapeCastInput>(casts), ArrayPtr<RayCastOutput>(castHits));
+    GEP_ASSERT(castHits[0].hitEntity != nullptr && castHits[0].hitEntity->getOwner() == pSphere.get(), "the box has to hit the sphere");
+    GEP_ASSERT(fabsf(castHits[0].hitFraction - 0.425f) < 0.01f, "wrong shape cast fraction", castHits[0].hitFraction);
+    GEP_ASSERT(castHits[1].hitEntity == nullptr && castHits[1].hitFraction == 1.0f, "the sphere stays above the ground");
+
+    // a box between the box and the sphere overlaps both and the ground
+    SmartPtr<IShape> pOverlapShape = factory.createBox(vec3(3.0f, 1.0f, 1.0f));
+    OverlapInput overlaps[2];
+    overlaps[0].shape = pOverlapShape.get();
+    overlaps[0].position = vec3(2.5f, 0.0f, 0.5f);
+    overlaps[1].shape = pSphereShape.get();
+    overlaps[1].position = vec3(-20.0f, 20.0f, 5.0f);
+    const ICollidable* hits[2];
+    OverlapOutput overlapHits[2];
+    overlapHits[0].hits = ArrayPtr<const ICollidable*>(hits);
+    pWorld->overlapShapes(ArrayPtr<OverlapInput>(overlaps), ArrayPtr<OverlapOutput>(overlapHits));
+    GEP_ASSERT(overlapHits[0].numHits == 3, "wrong number of overlaps", overlapHits[0].numHits);
+    GEP_ASSERT(hits[0] != nullptr && hits[1] != nullptr && hits[0] != hits[1], "the first two hits have to be filled in");
+    GEP_ASSERT(overlapHits[1].numHits == 0, "the sphere overlaps nothing", overlapHits[1].numHits);
+
+    pWorld->removeEntity(pSphere.get());
+    pWorld->removeEntity(pBox.get());
+    pWorld->removeEntity(pGround.get());
+    pWorld = nullptr;
+    factory.destroy();
+}
+
+GEP_UNITTEST_TEST(Physics, NativeWorldQueriesBenchmark)
+{
+    NativePhysicsFactory factory(&g_stdAllocator);
+    factory.initialize();
+
+    WorldCInfo worldCInfo;
+    SmartPtr<IWorld> pWorld = factory.createWorld(worldCInfo);
+    SmartPtr<IShape> pGroundShape = factory.createBox(vec3(500.0f, 500.0f, 1.0f));
+    SmartPtr<IShape> pBoxShape = factory.createBox(vec3(0.5f, 0.5f, 0.5f));
+    auto pGround = addFixedBody(factory, *pWorld, pGroundShape.get(), vec3(0.0f, 0.0f, -1.0f));
+    DynamicArray< SmartPtr<IRigidBody> > bodies;
+    for(size_t i=0; i < 2000; i++)
+        bodies.append(addFixedBody(factory, *pWorld, pBoxShape.get(), vec3(float(i % 45) * 4.0f - 90.0f, float(i / 45) * 4.0f - 90.0f, 0.5f)));
+
+    const size_t numRays = 10000;
+    DynamicArray<RayCastInput> rays;
+    DynamicArray<RayCastOutput> hits;
+    rays.resize(numRays);
+    hits.resize(numRays);
+    fillRays(rays.toArray(), 200.0f);
+
+    Timer timer;
+    double start = timer.getTimeAsDouble();
+    for(size_t i=0; i < numRays; i++)
+        pWorld->castRay(rays[i], hits[i]);
+    const double single = timer.getTimeAsDouble() - start;
+
+    start = timer.getTimeAsDouble();
+    pWorld->castRays(rays.toArray(), hits.toArray());
+    const double batch = timer.getTimeAsDouble() - start;
+
+    // the queries are const, slices of one batch can run on different workers
+    TaskQueue taskQueue;
+    start = timer.getTimeAsDouble();
+    taskQueue.runParallel(numRays, 512, [&](size_t first, size_t last){
+        pWorld->castRays(rays.toArray()(first, last), hits.toArray()(first, last));
+    });
+    const double parallel = timer.getTimeAsDouble() - start;
+
+    size_t numHits = 0;
+    for(auto& hit : hits)
+        numHits += hit.hitEntity != nullptr ? 1 : 0;
+    GEP_ASSERT(numHits == numRays, "every ray has to hit the ground or a box", numHits);
+
+    TestLogging::instance().logMessage("casting %u rays: %.2f ms one by one, %.2f ms batched, %.2f ms batched on the task queue",
+        numRays, single, batch, parallel);
+
+    for(auto& pBody : bodies)
+        pWorld->removeEntity(pBody.get());
+    pWorld->removeEntity(pGround.get());
+    pWorld = nullptr;
+    factory.destroy();
+}
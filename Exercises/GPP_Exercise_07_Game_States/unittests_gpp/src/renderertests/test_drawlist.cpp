@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "Test_Renderer.h"
+#include "gep/drawList.h"
+#include "gep/timer.h"
+#include "testLog.h"
+#include <algorithm>
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// deterministic numbers so that failures can be reproduced
+    class Random
+    {
+    public:
+        Random() : m_state(4711) {}
+
+        uint32 next(uint32 max)
+        {
+            m_state = m_state * 1664525 + 1013904223;
+            return (m_state >> 8) % max;
+        }
+
+    private:
+        uint32 m_state;
+    };
+
+    /// a scene with a few shaders and texture sets and many instances of the same meshes
+    uint64 randomKey(Random& random)
+    {
+        uint32 mesh = random.next(200);
+        uint32 material = mesh % 30;
+        return DrawList::makeKey(material % 4, material, material, mesh, random.next(100000) * 0.01f);
+    }
+
+    bool isKeyLess(const DrawList::Entry& lhs, const DrawList::Entry& rhs)
+    {
+        return lhs.key < rhs.key;
+    }
+}
+
+GEP_UNITTEST_TEST(Renderer, DrawListKeys)
+{
+    // the depth has to keep its order
+    for(float depth = 0.001f; depth < 100000.0f; depth *= 1.5f)
+    {
+        GEP_ASSERT(DrawList::quantizeDepth(depth) <= DrawList::quantizeDepth(depth * 1.5f), "the depth order is not kept", depth);
+    }
+    GEP_ASSERT(DrawList::quantizeDepth(-5.0f) == 0, "negative depths have to be clamped");
+
+    // every field has to end up in its own bits and more important state has to sort first
+    uint64 key = DrawList::makeKey(1, 2, 3, 4, 0.0f);
+    GEP_ASSERT(key == ((1ULL << 56) | (2ULL << 44) | (3ULL << 32) | (4ULL << 16)), "wrong key layout");
+    GEP_ASSERT(DrawList::makeKey(1, 0, 0, 0, 0.0f) > DrawList::makeKey(0, 0xFFF, 0xFFF, 0xFFFF, 1000.0f), "the shader has to sort first");
+    GEP_ASSERT(DrawList::makeKey(0x1FF, 0, 0, 0, 0.0f) == DrawList::makeKey(0xFF, 0, 0, 0, 0.0f), "ids have to wrap");
+    GEP_ASSERT(DrawList::getBatchKey(DrawList::makeKey(1, 2, 3, 4, 1.0f)) == DrawList::getBatchKey(DrawList::makeKey(1, 2, 3, 4, 50.0f)),
+        "the depth must not split batches");
+}
+
+GEP_UNITTEST_TEST(Renderer, DrawListSort)
+{
+    Random random;
+    DrawList drawList;
+    DynamicArray<DrawList::Entry> expected;
+    for(uint32 i = 0; i < 5000; i++)
+    {
+        uint64 key = randomKey(random);
+        drawList.add(key, i);
+        DrawList::Entry entry;
+        entry.key = key;
+        entry.index = i;
+        expected.append(entry);
+    }
+    drawList.sort();
+    std::stable_sort(expected.begin(), expected.end(), isKeyLess);
+
+    GEP_ASSERT(drawList.length() == expected.length(), "entries got lost");
+    for(size_t i = 0; i < expected.length(); i++)
+    {
+        GEP_ASSERT(drawList[i].key == expected[i].key && drawList[i].index == expected[i].index, "radix sort differs from a stable sort", i);
+    }
+
+    size_t numDraws = 0;
+    for(size_t i = 0; i < drawList.length(); )
+    {
+        size_t batchLength = drawList.getBatchLength(i, 64);
+        GEP_ASSERT(batchLength > 0 && batchLength <= 64, "invalid batch length", i, batchLength);
+        for(size_t j = i; j < i + batchLength; j++)
+        {
+            GEP_ASSERT(DrawList::getBatchKey(drawList[j].key) == DrawList::getBatchKey(drawList[i].key), "batch with different state", i, j);
+        }
+        GEP_ASSERT(i + batchLength == drawList.length() || batchLength == 64 ||
+            DrawList::getBatchKey(drawList[i + batchLength].key) != DrawList::getBatchKey(drawList[i].key), "batch ended too early", i);
+        i += batchLength;
+        numDraws++;
+    }
+    GEP_ASSERT(numDraws < drawList.length() / 10, "the meshes should have been batched", numDraws);
+
+    // sorting again must not change anything
+    drawList.sort();
+    for(size_t i = 0; i < expected.length(); i++)
+    {
+        GEP_ASSERT(drawList[i].index == expected[i].index, "sorting a sorted list changed it", i);
+    }
+}
+
+GEP_UNITTEST_TEST(Renderer, DrawListBenchmark)
+{
+    Random random;
+    const uint32 count = 100000;
+    const size_t numRounds = 16;
+    DynamicArray<uint64> keys;
+    keys.reserve(count);
+    for(uint32 i = 0; i < count; i++)
+        keys.append(randomKey(random));
+
+    DrawList drawList;
+    Timer timer;
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        drawList.clear();
+        for(uint32 i = 0; i < count; i++)
+            drawList.add(keys[i], i);
+        drawList.sort();
+    }
+    double radixTime = timer.getTimeAsDouble() / numRounds;
+
+    DynamicArray<DrawList::Entry> entries;
+    timer = Timer();
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        entries.resize(0);
+        for(uint32 i = 0; i < count; i++)
+        {
+            DrawList::Entry entry;
+            entry.key = keys[i];
+            entry.index = i;
+            entries.append(entry);
+        }
+        std::stable_sort(entries.begin(), entries.end(), isKeyLess);
+    }
+    double comparisonTime = timer.getTimeAsDouble() / numRounds;
+
+    size_t numDraws = 0;
+    for(size_t i = 0; i < drawList.length(); i += drawList.getBatchLength(i, 64))
+        numDraws++;
+
+    TestLogging::instance().logMessage("sorting %u draws: %.3f ms radix sort, %.3f ms std::stable_sort, %u draw calls after instancing",
+        count, radixTime, comparisonTime, (uint32)numDraws);
+}
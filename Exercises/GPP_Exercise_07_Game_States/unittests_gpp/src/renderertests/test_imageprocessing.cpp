@@ -0,0 +1,249 @@
+#include "stdafx.h"
+#include "Test_Renderer.h"
+#include "gep/imageProcessing.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/timer.h"
+#include "testLog.h"
+#include <math.h>
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    void decodeColors(const uint8* block, uint8* pixels)
+    {
+        int colors[4][3];
+        const uint16 color0 = uint16(block[0] | (block[1] << 8));
+        const uint16 color1 = uint16(block[2] | (block[3] << 8));
+        const uint16 endpoints[2] = { color0, color1 };
+        for(int i = 0; i < 2; i++)
+        {
+            const int r = (endpoints[i] >> 11) & 31, g = (endpoints[i] >> 5) & 63, b = endpoints[i] & 31;
+            colors[i][0] = (r << 3) | (r >> 2);
+            colors[i][1] = (g << 2) | (g >> 4);
+            colors[i][2] = (b << 3) | (b >> 2);
+        }
+        for(int c = 0; c < 3; c++)
+        {
+            colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+            colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+        }
+        const uint32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32(block[7]) << 24);
+        for(int i = 0; i < 16; i++)
+        {
+            for(int c = 0; c < 3; c++)
+                pixels[i * 4 + c] = uint8(colors[(indices >> (2 * i)) & 3][c]);
+        }
+    }
+
+    void decodeSingleChannel(const uint8* block, uint8* values, uint32 stride)
+    {
+        int palette[8] = { block[0], block[1] };
+        for(int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * block[0] + i * block[1]) / 7;
+        uint64 indices = 0;
+        for(int i = 0; i < 6; i++)
+            indices |= uint64(block[2 + i]) << (8 * i);
+        for(int i = 0; i < 16; i++)
+            values[i * stride] = uint8(palette[(indices >> (3 * i)) & 7]);
+    }
+
+    /// decodes a BC1 or BC3 image back to RGBA8, BC1 pixels get an alpha of 255
+    void decode(image::BlockCompression compression, const uint8* blocks, uint32 width, uint32 height, DynamicArray<uint8>& result)
+    {
+        result.resize(width * height * 4);
+        const uint32 numBlocksX = (width + 3) / 4;
+        uint8 pixels[64];
+        for(uint32 blockY = 0; blockY < (height + 3) / 4; blockY++)
+        {
+            for(uint32 blockX = 0; blockX < numBlocksX; blockX++)
+            {
+                const uint8* block = blocks + (blockY * numBlocksX + blockX) * ((compression == image::BlockCompression::BC3) ? 16 : 8);
+                if(compression == image::BlockCompression::BC3)
+                {
+                    decodeSingleChannel(block, pixels + 3, 4);
+                    decodeColors(block + 8, pixels);
+                }
+                else
+                {
+                    decodeColors(block, pixels);
+                    for(int i = 0; i < 16; i++)
+                        pixels[i * 4 + 3] = 255;
+                }
+                for(uint32 y = 0; y < 4 && blockY * 4 + y < height; y++)
+                {
+                    for(uint32 x = 0; x < 4 && blockX * 4 + x < width; x++)
+                        memcpy(&result[((blockY * 4 + y) * width + blockX * 4 + x) * 4], pixels + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+
+    /// peak signal to noise ratio of the channels [firstChannel, endChannel) in dB
+    double getPSNR(const uint8* a, const uint8* b, size_t numPixels, int firstChannel, int endChannel)
+    {
+        double squaredError = 0.0;
+        for(size_t i = 0; i < numPixels; i++)
+        {
+            for(int c = firstChannel; c < endChannel; c++)
+            {
+                const double diff = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+                squaredError += diff * diff;
+            }
+        }
+        if(squaredError == 0.0)
+            return 1000.0;
+        const double meanSquaredError = squaredError / double(numPixels * (endChannel - firstChannel));
+        return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+    }
+
+    /// smooth gradients with a bit of noise, like the generated textures tend to be
+    void createTestImage(uint32 width, uint32 height, DynamicArray<uint8>& pixels)
+    {
+        pixels.resize(width * height * 4);
+        uint32 random = 12345;
+        for(uint32 y = 0; y < height; y++)
+        {
+            for(uint32 x = 0; x < width; x++)
+            {
+                random = random * 1103515245 + 12345;
+                const int noise = int((random >> 16) & 7) - 4;
+                uint8* pixel = &pixels[(y * width + x) * 4];
+                pixel[0] = uint8(GEP_MIN(GEP_MAX(int(x * 255 / width) + noise, 0), 255));
+                pixel[1] = uint8(GEP_MIN(GEP_MAX(int(y * 255 / height) + noise, 0), 255));
+                pixel[2] = uint8(128 + int(100.0 * sin(x * 0.05) * cos(y * 0.07)));
+                pixel[3] = uint8((x + y) * 255 / (width + height));
+            }
+        }
+    }
+
+    void freeMipmaps(ArrayPtr<ArrayPtr<uint8>> mipmaps)
+    {
+        for(auto mipmap : mipmaps)
+            g_stdAllocator.freeMemory(mipmap.getPtr());
+        g_stdAllocator.freeMemory(mipmaps.getPtr());
+    }
+}
+
+GEP_UNITTEST_TEST(Renderer, ImageDownsampling)
+{
+    GEP_ASSERT(image::getNumMipmaps(256, 256) == 9);
+    GEP_ASSERT(image::getNumMipmaps(256, 64) == 9, "the mipmaps go on until both sides are 1");
+    GEP_ASSERT(image::getNumMipmaps(1, 1) == 1);
+    GEP_ASSERT(image::getMipmapBytes(2, 2, image::BlockCompression::BC3) == 16, "small mipmaps are still a whole block");
+    GEP_ASSERT(image::getMipmapBytes(12, 8, image::BlockCompression::BC1) == 6 * 8);
+
+    // odd sizes and sides of 1 pixel, wide enough for the SSE path
+    const uint32 sizes[][2] = { { 37, 9 }, { 16, 16 }, { 1, 7 }, { 21, 1 }, { 2, 2 } };
+    for(auto& size : sizes)
+    {
+        const uint32 width = size[0], height = size[1];
+        DynamicArray<uint8> src;
+        createTestImage(width, height, src);
+        const uint32 dstWidth = image::getMipmapSize(width, 1), dstHeight = image::getMipmapSize(height, 1);
+        DynamicArray<uint8> dst;
+        dst.resize(dstWidth * dstHeight * 4);
+        image::downsampleRGBA8(src.toArray().getPtr(), width, height, dst.toArray().getPtr(), 0, dstHeight);
+
+        for(uint32 y = 0; y < dstHeight; y++)
+        {
+            for(uint32 x = 0; x < dstWidth; x++)
+            {
+                const uint32 x0 = 2 * x, x1 = GEP_MIN(2 * x + 1, width - 1);
+                const uint32 y0 = 2 * y, y1 = GEP_MIN(2 * y + 1, height - 1);
+                for(uint32 c = 0; c < 4; c++)
+                {
+                    const uint32 sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+                                       src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                    GEP_ASSERT(dst[(y * dstWidth + x) * 4 + c] == (sum + 2) / 4, "wrong average", width, height, x, y, c);
+                }
+            }
+        }
+    }
+
+    // the whole chain, with and without the task queue
+    DynamicArray<uint8> src;
+    createTestImage(64, 16, src);
+    TaskQueue taskQueue;
+    auto serial = image::createMipmaps(&g_stdAllocator, src.toArray(), 64, 16, image::BlockCompression::None);
+    auto parallel = image::createMipmaps(&g_stdAllocator, src.toArray(), 64, 16, image::BlockCompression::None, &taskQueue);
+    GEP_ASSERT(serial.length() == 7 && parallel.length() == 7);
+    GEP_ASSERT(serial[6].length() == 4, "the last mipmap is a single pixel");
+    for(size_t i = 0; i < serial.length(); i++)
+        GEP_ASSERT(memcmp(serial[i].getPtr(), parallel[i].getPtr(), serial[i].length()) == 0, "the task queue changed the result", i);
+    GEP_ASSERT(memcmp(serial[0].getPtr(), src.toArray().getPtr(), serial[0].length()) == 0);
+    freeMipmaps(serial);
+    freeMipmaps(parallel);
+}
+
+GEP_UNITTEST_TEST(Renderer, ImageBlockCompression)
+{
+    // a single color is kept as exactly as RGB565 allows, alpha is kept exactly
+    {
+        uint8 pixels[4 * 4 * 4];
+        for(int i = 0; i < 16; i++)
+        {
+            pixels[i * 4] = 255; pixels[i * 4 + 1] = 0; pixels[i * 4 + 2] = 0; pixels[i * 4 + 3] = (i % 2) ? 0 : 255;
+        }
+        uint8 block[16];
+        image::compressBlocks(image::BlockCompression::BC3, pixels, 4, 4, block, 0, 1);
+        DynamicArray<uint8> decoded;
+        decode(image::BlockCompression::BC3, block, 4, 4, decoded);
+        GEP_ASSERT(memcmp(decoded.toArray().getPtr(), pixels, sizeof(pixels)) == 0, "solid red with binary alpha was not kept");
+    }
+
+    // BC4 keeps the extremes of a single channel
+    {
+        uint8 values[16];
+        for(int i = 0; i < 16; i++)
+            values[i] = uint8(i * 17);
+        uint8 block[8], decoded[16];
+        image::compressBlocks(image::BlockCompression::BC4, values, 4, 4, block, 0, 1);
+        decodeSingleChannel(block, decoded, 1);
+        GEP_ASSERT(decoded[0] == 0 && decoded[15] == 255);
+        for(int i = 0; i < 16; i++)
+            GEP_ASSERT(abs(decoded[i] - values[i]) <= 255 / 14 + 1, "BC4 value too far off", i, decoded[i], values[i]);
+    }
+
+    // quality on a typical image, the size is no multiple of 4 so that the edge blocks are tested too
+    const uint32 width = 126, height = 70;
+    DynamicArray<uint8> src, decoded, blocks;
+    createTestImage(width, height, src);
+    blocks.resize(image::getMipmapBytes(width, height, image::BlockCompression::BC3));
+    image::compressBlocks(image::BlockCompression::BC1, src.toArray().getPtr(), width, height, blocks.toArray().getPtr(), 0, (height + 3) / 4);
+    decode(image::BlockCompression::BC1, blocks.toArray().getPtr(), width, height, decoded);
+    const double bc1PSNR = getPSNR(src.toArray().getPtr(), decoded.toArray().getPtr(), width * height, 0, 3);
+
+    image::compressBlocks(image::BlockCompression::BC3, src.toArray().getPtr(), width, height, blocks.toArray().getPtr(), 0, (height + 3) / 4);
+    decode(image::BlockCompression::BC3, blocks.toArray().getPtr(), width, height, decoded);
+    const double bc3PSNR = getPSNR(src.toArray().getPtr(), decoded.toArray().getPtr(), width * height, 0, 3);
+    const double alphaPSNR = getPSNR(src.toArray().getPtr(), decoded.toArray().getPtr(), width * height, 3, 4);
+
+    TestLogging::instance().logMessage("PSNR: BC1 %.2f dB, BC3 %.2f dB color, %.2f dB alpha", bc1PSNR, bc3PSNR, alphaPSNR);
+    GEP_ASSERT(bc1PSNR > 35.0, "BC1 quality too low", bc1PSNR);
+    GEP_ASSERT(bc3PSNR == bc1PSNR, "BC3 colors should be the same as BC1", bc3PSNR, bc1PSNR);
+    GEP_ASSERT(alphaPSNR > 45.0, "BC3 alpha quality too low", alphaPSNR);
+}
+
+GEP_UNITTEST_TEST(Renderer, ImageProcessingBenchmark)
+{
+    const uint32 size = 1024;
+    const size_t numRounds = 4;
+    DynamicArray<uint8> src;
+    createTestImage(size, size, src);
+    TaskQueue taskQueue;
+
+    double times[2];
+    TaskQueue* taskQueues[2] = { nullptr, &taskQueue };
+    for(int i = 0; i < 2; i++)
+    {
+        Timer timer;
+        for(size_t round = 0; round < numRounds; round++)
+            freeMipmaps(image::createMipmaps(&g_stdAllocator, src.toArray(), size, size, image::BlockCompression::BC3, taskQueues[i]));
+        times[i] = timer.getTimeAsDouble() / numRounds;
+    }
+    const double numPixels = size * size * 4.0 / 3.0;
+    TestLogging::instance().logMessage("mipmaps of a %ux%u texture as BC3: %.3f ms (%.1f MPixel/s), %.3f ms (%.1f MPixel/s) in parallel",
+        size, size, times[0], numPixels / times[0] / 1000.0, times[1], numPixels / times[1] / 1000.0);
+}
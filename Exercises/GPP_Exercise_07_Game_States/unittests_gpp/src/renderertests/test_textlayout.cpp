@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "Test_Renderer.h"
+#include "gep/glyphAtlas.h"
+#include "gep/textLayout.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    /// a font without freetype, every code point gets a glyph whose size depends on it
+    class TestGlyphSource : public ITextGlyphSource
+    {
+    public:
+        TestGlyphSource(uint32 atlasSize) : m_atlas(atlasSize, atlasSize), m_numRendered(0) {}
+
+        virtual const TextGlyph* getGlyph(uint32 codepoint) override
+        {
+            if(codepoint == ' ')
+            {
+                memset(&m_glyph, 0, sizeof(m_glyph));
+                m_glyph.advance = 4.0f;
+                return &m_glyph;
+            }
+            GlyphAtlas::Region region;
+            if(!m_atlas.find(codepoint, region))
+            {
+                if(!m_atlas.insert(codepoint, getWidth(codepoint), getHeight(codepoint), region))
+                    return nullptr;
+                m_numRendered++;
+            }
+            const float step = 1.0f / (float)m_atlas.getWidth();
+            m_glyph.left = 1.0f;
+            m_glyph.top = (float)(12 - region.height);
+            m_glyph.width = (float)region.width;
+            m_glyph.height = (float)region.height;
+            m_glyph.advance = 1.0f;
+            m_glyph.minTexX = region.x * step;
+            m_glyph.maxTexX = (region.x + region.width) * step;
+            m_glyph.minTexY = region.y * step;
+            m_glyph.maxTexY = (region.y + region.height) * step;
+            m_glyph.shelf = region.shelf;
+            return &m_glyph;
+        }
+
+        virtual float getLineHeight() const override { return 12.0f; }
+        virtual uint32 getGlyphGeneration() const override { return m_atlas.getGeneration(); }
+        virtual void markShelvesUsed(uint64 shelfMask) override { m_atlas.markShelvesUsed(shelfMask); }
+
+        static uint32 getWidth(uint32 codepoint) { return 4 + codepoint % 7; }
+        static uint32 getHeight(uint32 codepoint) { return 6 + codepoint % 5; }
+
+        GlyphAtlas m_atlas;
+        uint32 m_numRendered;
+
+    private:
+        TextGlyph m_glyph;
+    };
+
+    /// lines like the ones of the debug overlay, some of them change every frame
+    void makeText(char* buffer, size_t bufferSize, uint32 line, uint32 frame)
+    {
+        if(line % 4 == 0)
+            sprintf_s(buffer, bufferSize, "entity %u: position (%u.%02u, %u.%02u) \xC3\xA4\xC3\xB6\xC3\xBC", line, frame % 100, line % 100, frame % 7, frame % 13);
+        else
+            sprintf_s(buffer, bufferSize, "entity %u: static text which does not change \xE2\x82\xAC", line);
+    }
+}
+
+GEP_UNITTEST_TEST(Renderer, Utf8Decode)
+{
+    const char* text = "a\xC3\xA4\xE2\x82\xAC\xF0\x9F\x98\x80";
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 'a');
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0xE4, "2 byte sequence");
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0x20AC, "3 byte sequence");
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0x1F600, "4 byte sequence");
+    GEP_ASSERT(*text == '\0', "did not stop at the end");
+
+    // invalid input must neither be decoded as something else nor skip the terminating 0
+    text = "\xC3";
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0xFFFD && *text == '\0', "truncated sequence");
+    text = "\xC0\xAFx";
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0xFFFD && *text == 'x', "overlong encoding");
+    text = "\xED\xA0\x80x";
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0xFFFD && *text == 'x', "surrogate");
+    text = "\x80x";
+    GEP_ASSERT(TextLayoutCache::decodeUtf8(text) == 0xFFFD && *text == 'x', "continuation byte without a start");
+}
+
+GEP_UNITTEST_TEST(Renderer, GlyphAtlas)
+{
+    GlyphAtlas atlas(64, 64);
+    GlyphAtlas::Region regions[64];
+    uint32 numInserted = 0;
+    for(uint32 key = 0; key < 64; key++)
+    {
+        if(!atlas.insert(key, TestGlyphSource::getWidth(key), TestGlyphSource::getHeight(key), regions[key]))
+            break;
+        numInserted++;
+    }
+    GEP_ASSERT(numInserted < 64, "everything fit, the test does not fill the atlas");
+    GEP_ASSERT(atlas.getNumEvictions() == 0, "nothing may be evicted in the frame the regions were inserted in");
+
+    // the regions must be inside the atlas and must not overlap, including the padding
+    for(uint32 i = 0; i < numInserted; i++)
+    {
+        const GlyphAtlas::Region& a = regions[i];
+        GEP_ASSERT(a.x + a.width + GlyphAtlas::PADDING <= 64 && a.y + a.height + GlyphAtlas::PADDING <= 64, "region outside of the atlas", i);
+        for(uint32 j = 0; j < i; j++)
+        {
+            const GlyphAtlas::Region& b = regions[j];
+            bool isSeparate = a.x + a.width + GlyphAtlas::PADDING <= b.x || b.x + b.width + GlyphAtlas::PADDING <= a.x ||
+                              a.y + a.height + GlyphAtlas::PADDING <= b.y || b.y + b.height + GlyphAtlas::PADDING <= a.y;
+            GEP_ASSERT(isSeparate, "regions overlap", i, j);
+        }
+    }
+
+    // in the next frame only the shelf of the first region is used, another one has to make room
+    atlas.nextFrame();
+    GlyphAtlas::Region region;
+    GEP_ASSERT(atlas.find(0, region) && region.x == regions[0].x && region.y == regions[0].y, "region got lost");
+    const uint32 generation = atlas.getGeneration();
+    GEP_ASSERT(atlas.insert(1000, 4, 6, region), "no shelf was evicted");
+    GEP_ASSERT(atlas.getNumEvictions() == 1 && atlas.getGeneration() != generation, "the eviction was not reported");
+    const uint32 evictedShelf = region.shelf;
+    GEP_ASSERT(evictedShelf != regions[0].shelf, "the shelf used in this frame was evicted");
+    for(uint32 i = 0; i < numInserted; i++)
+    {
+        GEP_ASSERT(atlas.find(i, region) == (regions[i].shelf != evictedShelf), "wrong regions were evicted", i);
+    }
+
+    atlas.clear();
+    GEP_ASSERT(atlas.getNumEntries() == 0 && !atlas.find(0, region), "clear did not remove everything");
+}
+
+GEP_UNITTEST_TEST(Renderer, TextLayoutCache)
+{
+    TestGlyphSource source(128);
+    TextLayoutCache cache;
+
+    const char* text = "ab \xC3\xA4\ncd";
+    auto& layout = cache.getLayout(source, text, FontHorizontalOrientation::Left);
+    GEP_ASSERT(layout.quads.length() == 5 * TextLayoutCache::FLOATS_PER_QUAD, "the space must not have a quad", layout.quads.length());
+    GEP_ASSERT(layout.quads[0] == 1.0f, "wrong position of the first glyph", layout.quads[0]);
+    GEP_ASSERT(layout.quads[3 * TextLayoutCache::FLOATS_PER_QUAD] == 1.0f && layout.quads[3 * TextLayoutCache::FLOATS_PER_QUAD + 1] > 12.0f,
+        "the glyph after the line break has to start a new line");
+    const float width = layout.width;
+    GEP_ASSERT(cache.getNumMisses() == 1 && cache.getNumHits() == 0);
+
+    auto& cachedLayout = cache.getLayout(source, text, FontHorizontalOrientation::Left);
+    GEP_ASSERT(&cachedLayout == &layout && cache.getNumHits() == 1, "the layout was not cached");
+    auto& centeredLayout = cache.getLayout(source, text, FontHorizontalOrientation::Centered);
+    GEP_ASSERT(cache.getNumMisses() == 2, "the orientation has to be part of the key");
+    GEP_ASSERT(centeredLayout.quads[0] == 1.0f - floor(width / 2.0f), "the text is not centered", centeredLayout.quads[0]);
+
+    // evicting glyphs invalidates the texture coordinates of all cached layouts
+    source.m_atlas.clear();
+    cache.getLayout(source, text, FontHorizontalOrientation::Left);
+    GEP_ASSERT(cache.getNumMisses() == 3, "the layout was not made again after the atlas changed");
+
+    for(uint32 frame = 0; frame <= TextLayoutCache::MAX_UNUSED_FRAMES; frame++)
+    {
+        cache.getLayout(source, "still used", FontHorizontalOrientation::Left);
+        cache.nextFrame();
+    }
+    GEP_ASSERT(cache.getNumLayouts() == 1, "unused layouts were not dropped", cache.getNumLayouts());
+}
+
+GEP_UNITTEST_TEST(Renderer, TextLayoutBenchmark)
+{
+    const uint32 numLines = 200;
+    const uint32 numFrames = 100;
+    char buffer[256];
+
+    TestGlyphSource source(512);
+    TextLayoutCache::Layout layout;
+    size_t numQuads = 0;
+    Timer timer;
+    for(uint32 frame = 0; frame < numFrames; frame++)
+    {
+        for(uint32 line = 0; line < numLines; line++)
+        {
+            makeText(buffer, sizeof(buffer), line, frame);
+            TextLayoutCache::layout(source, buffer, FontHorizontalOrientation::Left, layout);
+            numQuads += layout.quads.length() / TextLayoutCache::FLOATS_PER_QUAD;
+        }
+        source.m_atlas.nextFrame();
+    }
+    double uncachedTime = timer.getTimeAsDouble() / numFrames;
+
+    TextLayoutCache cache;
+    timer = Timer();
+    for(uint32 frame = 0; frame < numFrames; frame++)
+    {
+        for(uint32 line = 0; line < numLines; line++)
+        {
+            makeText(buffer, sizeof(buffer), line, frame);
+            numQuads -= cache.getLayout(source, buffer, FontHorizontalOrientation::Left).quads.length() / TextLayoutCache::FLOATS_PER_QUAD;
+        }
+        source.m_atlas.nextFrame();
+        cache.nextFrame();
+    }
+    double cachedTime = timer.getTimeAsDouble() / numFrames;
+    GEP_ASSERT(numQuads == 0, "the cached layouts differ from the uncached ones");
+
+    TestLogging::instance().logMessage("laying out %u lines: %.3f ms per frame without cache, %.3f ms with cache (%u hits, %u misses), %u glyphs in the atlas",
+        numLines, uncachedTime, cachedTime, cache.getNumHits(), cache.getNumMisses(), source.m_numRendered);
+}
@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "Test_Renderer.h"
+#include "gep/textureStreamer.h"
+
+using namespace gep;
+
+namespace
+{
+    const uint32 SIZE = 1024;
+    const uint32 NUM_MIPS = 11;
+    const uint32 BYTES_PER_BLOCK = 16;
+
+    size_t getTextureSize(uint32 firstMip)
+    {
+        return TextureStreamer::getSize(SIZE, SIZE, NUM_MIPS, BYTES_PER_BLOCK, firstMip);
+    }
+
+    void finishLoads(TextureStreamer& streamer, DynamicArray<TextureStreamer::Request>& loads)
+    {
+        for(auto& load : loads)
+            streamer.finishLoad(load.id, load.firstMip);
+        loads.resize(0);
+    }
+}
+
+GEP_UNITTEST_TEST(Renderer, TextureStreamerMipSelection)
+{
+    GEP_ASSERT(TextureStreamer::getMinResidentMip(SIZE, SIZE, NUM_MIPS) == 4, "1024 >> 4 is the first mipmap of at most 64 pixels");
+    GEP_ASSERT(TextureStreamer::getMinResidentMip(SIZE, 32, NUM_MIPS) == 4, "the larger side has to be used");
+    GEP_ASSERT(TextureStreamer::getMinResidentMip(SIZE, SIZE, 2) == 1, "the mipmap has to exist");
+
+    GEP_ASSERT(TextureStreamer::getMipSize(SIZE, SIZE, BYTES_PER_BLOCK, 0) == 256 * 256 * 16);
+    GEP_ASSERT(TextureStreamer::getMipSize(SIZE, SIZE, BYTES_PER_BLOCK, 10) == 16, "the smallest mipmap is still a whole block");
+    GEP_ASSERT(getTextureSize(9) == 32, "size of the last two mipmaps");
+
+    GEP_ASSERT(TextureStreamer::getMipForScreenSize(SIZE, SIZE, NUM_MIPS, 2000.0f) == 0);
+    GEP_ASSERT(TextureStreamer::getMipForScreenSize(SIZE, SIZE, NUM_MIPS, 512.0f) == 1, "a mipmap with exactly enough pixels is good enough");
+    GEP_ASSERT(TextureStreamer::getMipForScreenSize(SIZE, SIZE, NUM_MIPS, 300.0f) == 1, "the smaller mipmap would be blurry");
+    GEP_ASSERT(TextureStreamer::getMipForScreenSize(SIZE, SIZE, NUM_MIPS, 0.0f) == NUM_MIPS - 1);
+}
+
+GEP_UNITTEST_TEST(Renderer, TextureStreamerBudget)
+{
+    const uint32 minMip = TextureStreamer::getMinResidentMip(SIZE, SIZE, NUM_MIPS);
+    // room for the whole first texture but only the third mipmap of the second one
+    const size_t budget = 2 * getTextureSize(minMip) + getTextureSize(0) - getTextureSize(minMip) + getTextureSize(3) - getTextureSize(minMip);
+    TextureStreamer streamer(budget);
+    const uint32 near = streamer.addTexture(SIZE, SIZE, NUM_MIPS, BYTES_PER_BLOCK, minMip);
+    const uint32 far = streamer.addTexture(SIZE, SIZE, NUM_MIPS, BYTES_PER_BLOCK, minMip);
+    GEP_ASSERT(streamer.getResidentBytes() == 2 * getTextureSize(minMip));
+
+    DynamicArray<TextureStreamer::Request> loads, evictions;
+    streamer.addUsage(far, 200.0f);
+    streamer.addUsage(near, 100.0f);
+    streamer.addUsage(near, 1024.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(streamer.getWantedMip(near) == 0 && streamer.getWantedMip(far) == 2, "wrong mipmaps wanted");
+    GEP_ASSERT(evictions.length() == 0, "nothing has to be evicted");
+    GEP_ASSERT(loads.length() == 2, "both textures have to be loaded", loads.length());
+    GEP_ASSERT(loads[0].id == near && loads[0].firstMip == 0, "the texture which gains the most detail has to be loaded first");
+    GEP_ASSERT(loads[1].id == far && loads[1].firstMip == 3, "the second texture gets what still fits into the budget", loads[1].firstMip);
+    GEP_ASSERT(streamer.getPendingBytes() + streamer.getResidentBytes() == budget);
+    finishLoads(streamer, loads);
+    GEP_ASSERT(streamer.getPendingBytes() == 0 && streamer.getResidentBytes() == budget);
+
+    // both visible: the near texture must not lose mipmaps it needs
+    streamer.addUsage(far, 1024.0f);
+    streamer.addUsage(near, 1024.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(loads.length() == 0 && evictions.length() == 0, "a visible texture was evicted");
+
+    // only the far texture is visible, the other one is evicted to make room
+    streamer.addUsage(far, 1024.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(evictions.length() == 1 && evictions[0].id == near && evictions[0].firstMip == minMip, "the invisible texture was not evicted");
+    GEP_ASSERT(loads.length() == 1 && loads[0].id == far && loads[0].firstMip == 0);
+    finishLoads(streamer, loads);
+    GEP_ASSERT(streamer.getResidentBytes() <= budget && streamer.getFirstResidentMip(near) == minMip && streamer.getFirstResidentMip(far) == 0);
+
+    // a load which failed is not requested again
+    evictions.resize(0);
+    streamer.addUsage(near, 1024.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(evictions.length() == 1 && evictions[0].id == far, "the far texture was not evicted");
+    GEP_ASSERT(loads.length() == 1 && loads[0].id == near);
+    streamer.finishLoad(near, minMip);
+    loads.resize(0);
+    streamer.addUsage(near, 1024.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(loads.length() == 0 && streamer.getWantedMip(near) == minMip, "a mipmap which failed to load was requested again");
+
+    streamer.removeTexture(near);
+    streamer.removeTexture(far);
+    GEP_ASSERT(streamer.getNumTextures() == 0 && streamer.getResidentBytes() == 0);
+}
+
+GEP_UNITTEST_TEST(Renderer, TextureStreamerUnusedTextures)
+{
+    const uint32 minMip = TextureStreamer::getMinResidentMip(SIZE, SIZE, NUM_MIPS);
+    TextureStreamer streamer(4 * getTextureSize(0));
+    const uint32 id = streamer.addTexture(SIZE, SIZE, NUM_MIPS, BYTES_PER_BLOCK, 0);
+    DynamicArray<TextureStreamer::Request> loads, evictions;
+
+    // without pressure on the budget nothing is evicted, no matter how long it was not used
+    for(uint32 frame = 0; frame <= TextureStreamer::MAX_UNUSED_FRAMES + 1; frame++)
+        streamer.update(loads, evictions);
+    GEP_ASSERT(evictions.length() == 0 && streamer.getFirstResidentMip(id) == 0);
+    GEP_ASSERT(streamer.getWantedMip(id) == minMip, "unused textures only need their smallest mipmaps");
+
+    // the unused texture makes room for a visible one
+    const uint32 otherId = streamer.addTexture(SIZE, SIZE, NUM_MIPS, BYTES_PER_BLOCK, minMip);
+    streamer.setBudget(getTextureSize(0) + getTextureSize(minMip));
+    streamer.addUsage(otherId, 2000.0f);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(evictions.length() == 1 && evictions[0].id == id && streamer.getFirstResidentMip(id) == minMip);
+    GEP_ASSERT(loads.length() == 1 && loads[0].id == otherId && loads[0].firstMip == 0);
+    finishLoads(streamer, loads);
+
+    // a lower budget evicts what is not visible right now
+    streamer.setBudget(2 * getTextureSize(minMip));
+    evictions.resize(0);
+    streamer.update(loads, evictions);
+    GEP_ASSERT(evictions.length() == 1 && evictions[0].id == otherId, "the budget was not enforced");
+    GEP_ASSERT(streamer.getResidentBytes() == 2 * getTextureSize(minMip), "too much is resident", streamer.getResidentBytes());
+
+    // ids are reused
+    streamer.removeTexture(id);
+    GEP_ASSERT(streamer.addTexture(64, 64, 5, 8, 0) == id);
+}
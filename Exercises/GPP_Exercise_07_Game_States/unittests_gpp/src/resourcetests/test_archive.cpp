@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "Test_Resources.h"
+#include "gep/archive.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+#include "gep/file.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    const char* const g_archiveFilename = "unittest_archive.gpak";
+
+    const char* const g_baseFiles[] = {
+        "dejavusans.ttf",
+        "dummy.fx",
+        "dummy.thmodel",
+        "font.fx",
+        "fontbillboard.fx",
+        "lines.fx",
+        "lines2d.fx",
+    };
+
+    std::string findBaseDirectory()
+    {
+        if(fileExists("data/base/dummy.fx"))
+            return "data/base/";
+        return "../data/base/";
+    }
+
+    uint32 checksum(const uint8* data, size_t length)
+    {
+        uint32 result = 0;
+        for(size_t i=0; i < length; i++)
+            result = result * 31 + data[i];
+        return result;
+    }
+
+    uint32 checksumOfLooseFile(const std::string& filename)
+    {
+        RawFile file(filename.c_str(), "rb");
+        GEP_ASSERT(file.isOpen(), "Could not open file", filename);
+        DynamicArray<uint8> data;
+        data.resize(file.getSize());
+        file.readArray(data.toArray().getPtr(), data.length());
+        return checksum(data.toArray().getPtr(), data.length());
+    }
+
+    void writeTestArchive(const std::string& directory)
+    {
+        ArchiveWriter writer;
+        for(auto filename : g_baseFiles)
+        {
+            auto path = directory + filename;
+            writer.addFile(path.c_str(), path.c_str());
+        }
+        writer.write(g_archiveFilename);
+    }
+
+    /// \brief Changes the first entry of the table of contents and checks that the archive is rejected.
+    template <typename Corrupt>
+    void checkCorruptEntryIsRejected(const Corrupt& corrupt)
+    {
+        {
+            RawFile file(g_archiveFilename, "r+b");
+            GEP_ASSERT(file.isOpen(), "Could not open the archive");
+            const size_t fileSize = file.getSize();
+            archive::Header header;
+            file.read(header);
+            archive::Entry entry;
+            file.seek(static_cast<size_t>(header.entriesOffset));
+            file.read(entry);
+            corrupt(entry, fileSize);
+            file.seek(static_cast<size_t>(header.entriesOffset));
+            file.write(entry);
+        }
+
+        bool rejected = false;
+        PackedArchive archive;
+        try
+        {
+            archive.open(g_archiveFilename);
+        }
+        catch(LoadingError&)
+        {
+            rejected = true;
+        }
+        GEP_ASSERT(rejected && !archive.isOpen(), "An entry pointing outside of the archive was accepted");
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, PackedArchive)
+{
+    auto directory = findBaseDirectory();
+    writeTestArchive(directory);
+    SCOPE_EXIT{ DeleteFileA(g_archiveFilename); });
+
+    PackedArchive archive;
+    archive.open(g_archiveFilename);
+    GEP_ASSERT(archive.getNumFiles() == GEP_ARRAY_SIZE(g_baseFiles), "Wrong number of files in archive", archive.getNumFiles());
+
+    for(auto filename : g_baseFiles)
+    {
+        auto path = directory + filename;
+        ArrayPtr<uint8> data;
+        GEP_ASSERT(archive.tryGetFile(path.c_str(), data) == SUCCESS, "File is missing in archive", path);
+        GEP_ASSERT(((size_t)data.getPtr() % archive::DEFAULT_ALIGNMENT) == 0, "File data is not aligned", path);
+        GEP_ASSERT(checksum(data.getPtr(), data.length()) == checksumOfLooseFile(path), "File content differs", path);
+    }
+
+    // paths are case insensitive and both separators work
+    std::string upperCasePath = directory + "DUMMY.fx";
+    for(auto& c : upperCasePath)
+    {
+        if(c == '/')
+            c = '\\';
+    }
+    GEP_ASSERT(archive.contains(upperCasePath.c_str()), "Case insensitive lookup failed", upperCasePath);
+    GEP_ASSERT(!archive.contains((directory + "missing.fx").c_str()), "Found a file that was not packed");
+    archive.close();
+
+    // corrupt entries must not hand out memory behind the mapped file
+    checkCorruptEntryIsRejected([](archive::Entry& entry, size_t fileSize){ entry.size = fileSize; });
+    writeTestArchive(directory);
+    checkCorruptEntryIsRejected([](archive::Entry& entry, size_t){ entry.offset = ~uint64(0) - 4; });
+    writeTestArchive(directory);
+    checkCorruptEntryIsRejected([](archive::Entry& entry, size_t fileSize){ entry.nameLength = static_cast<uint32>(fileSize); });
+}
+
+GEP_UNITTEST_TEST(Resources, VirtualFileSystem)
+{
+    auto& logging = TestLogging::instance();
+
+    auto directory = findBaseDirectory();
+    writeTestArchive(directory);
+    SCOPE_EXIT{ DeleteFileA(g_archiveFilename); });
+
+    {
+        VirtualFileSystem fileSystem;
+        fileSystem.mountArchive(g_archiveFilename);
+
+        auto path = directory + "font.fx";
+        FileView view;
+
+        fileSystem.setLooseFilesFirst(true);
+        GEP_ASSERT(fileSystem.open(path.c_str(), view) == SUCCESS);
+        GEP_ASSERT(!view.isFromArchive(), "Loose files should shadow the archive");
+
+        fileSystem.setLooseFilesFirst(false);
+        GEP_ASSERT(fileSystem.open(path.c_str(), view) == SUCCESS);
+        GEP_ASSERT(view.isFromArchive(), "File should come from the archive");
+
+        GEP_ASSERT(fileSystem.open("does/not/exist.fx", view) == FAILURE);
+        GEP_ASSERT(!fileSystem.exists("does/not/exist.fx"));
+    }
+
+    // compare reading every file through the archive with opening the loose files
+    const size_t numRounds = 100;
+    VirtualFileSystem looseFiles;
+    VirtualFileSystem packedFiles;
+    packedFiles.mountArchive(g_archiveFilename);
+    packedFiles.setLooseFilesFirst(false);
+
+    auto readAll = [&](VirtualFileSystem& fileSystem) -> double
+    {
+        Timer timer;
+        uint32 sum = 0;
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(auto filename : g_baseFiles)
+            {
+                FileView view;
+                fileSystem.open((directory + filename).c_str(), view);
+                sum += checksum(view.getData().getPtr(), view.length());
+            }
+        }
+        GEP_UNUSED(sum);
+        return timer.getTimeAsDouble();
+    };
+
+    auto looseTime = readAll(looseFiles);
+    auto packedTime = readAll(packedFiles);
+    logging.logMessage("Reading %u files %u times: %.2f ms from loose files, %.2f ms from the archive",
+        GEP_ARRAY_SIZE(g_baseFiles), numRounds, looseTime, packedTime);
+}
@@ -0,0 +1,366 @@
+#include "stdafx.h"
+#include "Test_Resources.h"
+#include "gep/chunkfile.h"
+#include "gep/container/DynamicArray.h"
+#include "gep/file.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    const char* const g_chunkFilename = "unittest_chunkfile.chunk";
+    const uint32 VALUES_PER_ITEM = 256;
+
+    float valueOf(uint32 item, uint32 value)
+    {
+        return (float)item + (float)value / VALUES_PER_ITEM;
+    }
+
+    /// chunktest
+    ///   header: numItems
+    ///   items: item * numItems, each with its id and VALUES_PER_ITEM floats
+    ///   footer
+    ///     checksum: sum of all ids
+    void writeTestFile(uint32 numItems)
+    {
+        Chunkfile file(g_chunkFilename, Chunkfile::Operation::write);
+        file.startWriting("chunktest", 1);
+
+        file.startWriteChunk("header");
+        file.write(numItems);
+        file.endWriteChunk();
+
+        DynamicArray<float> values;
+        values.resize(VALUES_PER_ITEM);
+        file.startWriteChunk("items");
+        for(uint32 i = 0; i < numItems; i++)
+        {
+            for(uint32 v = 0; v < VALUES_PER_ITEM; v++)
+                values[v] = valueOf(i, v);
+            file.startWriteChunk("item");
+            file.write(i);
+            file.writeArray(values.toArray());
+            file.endWriteChunk();
+        }
+        file.endWriteChunk();
+
+        file.startWriteChunk("footer");
+        file.startWriteChunk("checksum");
+        file.write(numItems * (numItems - 1) / 2);
+        file.endWriteChunk();
+        file.endWriteChunk();
+
+        file.endWriting();
+    }
+
+    void readFile(const char* filename, DynamicArray<uint8>& data)
+    {
+        RawFile file(filename, "rb");
+        GEP_ASSERT(file.isOpen(), "Could not open file", filename);
+        data.resize(file.getSize());
+        file.readArray(data.toArray().getPtr(), data.length());
+    }
+
+    /// the size of the file without the chunk index
+    uint32 getIndexOffset(DynamicArray<uint8>& data)
+    {
+        uint32 indexOffset = 0;
+        memcpy(&indexOffset, &data[data.length() - 2 * sizeof(uint32)], sizeof(indexOffset));
+        GEP_ASSERT(indexOffset < data.length(), "Invalid index offset", indexOffset);
+        return indexOffset;
+    }
+
+    /// counts the failed asserts instead of failing the test, for checks of invalid files
+    /// \remarks The asserts of the test itself have to come after restore, they would be ignored as well.
+    class CountingAssertHandler : public IFailedAssertCallback
+    {
+    public:
+        uint32 numFailedAsserts;
+
+        CountingAssertHandler() : numFailedAsserts(0), m_pPreviousHandler(getFailedAssertHandler()), m_isRestored(false)
+        {
+            setFailedAssertHandler(this);
+        }
+
+        ~CountingAssertHandler()
+        {
+            restore();
+        }
+
+        void restore()
+        {
+            if(!m_isRestored)
+                setFailedAssertHandler(m_pPreviousHandler);
+            m_isRestored = true;
+        }
+
+        virtual AssertCallbackResult failedAssert(const char* sourceFile, unsigned int line, const char* function, const char* expression, const char* msg, const char* additional) override
+        {
+            numFailedAsserts++;
+            return AssertCallbackResult::ignore;
+        }
+
+    private:
+        IFailedAssertCallback* m_pPreviousHandler;
+        bool m_isRestored;
+    };
+
+    void expectChunk(Chunkfile& file, const char* name)
+    {
+        auto result = file.startReadChunk();
+        GEP_ASSERT(result == SUCCESS, "Could not read chunk", name);
+        GEP_ASSERT(file.getCurrentChunkName() == name, "Unexpected chunk", name, file.getCurrentChunkName());
+    }
+
+    /// Reads the whole file sequentially and returns the sum of all values.
+    /// \param bulk
+    ///   reads the values of a item with one readArray call instead of one read call per value
+    double readSequentially(Chunkfile& file, bool bulk)
+    {
+        double sum = 0.0;
+        auto result = file.startReading("chunktest");
+        GEP_ASSERT(result == SUCCESS, "Could not start reading");
+        uint32 numItems = 0;
+        expectChunk(file, "header");
+        file.read(numItems);
+        file.endReadChunk();
+
+        float values[VALUES_PER_ITEM];
+        expectChunk(file, "items");
+        for(uint32 i = 0; i < numItems; i++)
+        {
+            expectChunk(file, "item");
+            uint32 id = 0;
+            file.read(id);
+            GEP_ASSERT(id == i, "Wrong item id", id, i);
+            if(bulk)
+            {
+                file.readArray(ArrayPtr<float>(values, VALUES_PER_ITEM));
+            }
+            else
+            {
+                for(auto& value : values)
+                    file.read(value);
+            }
+            for(auto value : values)
+                sum += value;
+            file.endReadChunk();
+        }
+        file.endReadChunk();
+
+        expectChunk(file, "footer");
+        expectChunk(file, "checksum");
+        uint32 checksum = 0;
+        file.read(checksum);
+        GEP_ASSERT(checksum == numItems * (numItems - 1) / 2, "Wrong checksum", checksum);
+        file.endReadChunk();
+        file.endReadChunk();
+        file.endReading();
+        return sum;
+    }
+
+    void checkItem(Chunkfile& file, uint32 item)
+    {
+        auto result = file.seekToChunk("chunktest/items/item", item);
+        GEP_ASSERT(result == SUCCESS, "Could not seek to item", item);
+        expectChunk(file, "item");
+        uint32 id = 0;
+        file.read(id);
+        GEP_ASSERT(id == item, "Seeked to the wrong item", id, item);
+        auto values = file.readArrayView<float>(VALUES_PER_ITEM);
+        GEP_ASSERT(values.length() == VALUES_PER_ITEM, "Could not read values", item);
+        GEP_ASSERT(values[VALUES_PER_ITEM - 1] == valueOf(item, VALUES_PER_ITEM - 1), "Wrong value", item);
+        file.endReadChunk();
+        file.skipCurrentChunk(); // items
+        file.skipCurrentChunk(); // chunktest
+    }
+
+    double toMegabytesPerSecond(size_t bytes, double milliseconds)
+    {
+        return (bytes / (1024.0 * 1024.0)) / (GEP_MAX(milliseconds, 0.001) / 1000.0);
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, ChunkfileIndex)
+{
+    const uint32 numItems = 100;
+    writeTestFile(numItems);
+    SCOPE_EXIT{ DeleteFileA(g_chunkFilename); });
+
+    {
+        Chunkfile file(g_chunkFilename, Chunkfile::Operation::read);
+        GEP_ASSERT(file.hasChunkIndex(), "The written file has no chunk index");
+        readSequentially(file, false);
+    }
+
+    {
+        Chunkfile file(g_chunkFilename, Chunkfile::Operation::read);
+        GEP_ASSERT(file.getNumChunks("chunktest") == 1, "Wrong number of top level chunks");
+        GEP_ASSERT(file.getNumChunks("chunktest/items/item") == numItems, "Wrong number of items", file.getNumChunks("chunktest/items/item"));
+        GEP_ASSERT(file.getNumChunks("chunktest/item") == 0, "Found a chunk that does not exist");
+        GEP_ASSERT(file.seekToChunk("chunktest/items/item", numItems) == FAILURE, "Seeked behind the last item");
+        GEP_ASSERT(file.seekToChunk("chunktest/missing") == FAILURE, "Seeked to a chunk that does not exist");
+
+        checkItem(file, 42);
+        checkItem(file, 0);
+        checkItem(file, numItems - 1);
+
+        // continuing sequentially after the seeked chunk
+        auto result = file.seekToChunk("chunktest/footer");
+        GEP_ASSERT(result == SUCCESS, "Could not seek to footer");
+        expectChunk(file, "footer");
+        expectChunk(file, "checksum");
+        uint32 checksum = 0;
+        file.read(checksum);
+        GEP_ASSERT(checksum == numItems * (numItems - 1) / 2, "Wrong checksum after seeking", checksum);
+        file.endReadChunk();
+        file.endReadChunk();
+        file.endReading();
+    }
+
+    // files without index, like the ones written before it existed, read the same
+    DynamicArray<uint8> data;
+    readFile(g_chunkFilename, data);
+    auto indexOffset = getIndexOffset(data);
+    {
+        Chunkfile file(g_chunkFilename, data.toArray());
+        GEP_ASSERT(file.hasChunkIndex(), "The in memory file has no chunk index");
+        readSequentially(file, true);
+    }
+    {
+        Chunkfile file(g_chunkFilename, ArrayPtr<uint8>(data.toArray().getPtr(), indexOffset));
+        GEP_ASSERT(!file.hasChunkIndex(), "The file without index has a chunk index");
+        GEP_ASSERT(file.seekToChunk("chunktest/footer") == FAILURE, "Seeked without chunk index");
+        readSequentially(file, true);
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, ChunkfileCorruptIndex)
+{
+    const uint32 numItems = 3;
+    writeTestFile(numItems);
+    SCOPE_EXIT{ DeleteFileA(g_chunkFilename); });
+    DynamicArray<uint8> data;
+    readFile(g_chunkFilename, data);
+
+    // skip the header of the chunkindex chunk and all entries but the last one (the checksum)
+    size_t position = getIndexOffset(data);
+    position += 1 + data[position] + sizeof(uint32);
+    uint32 numEntries = 0;
+    memcpy(&numEntries, &data[position], sizeof(numEntries));
+    position += sizeof(numEntries);
+    for(uint32 i = 0; i + 1 < numEntries; i++)
+        position += 1 + data[position] + sizeof(int32) + 2 * sizeof(uint32);
+
+    // a length which makes the end of the chunk wrap around to 0 in 32 bit
+    const uint8 nameLength = data[position];
+    const size_t headerOffsetPosition = position + 1 + nameLength + sizeof(int32);
+    uint32 headerOffset = 0;
+    memcpy(&headerOffset, &data[headerOffsetPosition], sizeof(headerOffset));
+    const uint32 wrappingLength = 0u - (headerOffset + 1 + nameLength + static_cast<uint32>(sizeof(uint32)));
+    memcpy(&data[headerOffsetPosition + sizeof(uint32)], &wrappingLength, sizeof(wrappingLength));
+
+    CountingAssertHandler asserts;
+    Chunkfile file(g_chunkFilename, data.toArray());
+    asserts.restore();
+    GEP_ASSERT(asserts.numFailedAsserts == 1, "The corrupt index was not reported", asserts.numFailedAsserts);
+    GEP_ASSERT(!file.hasChunkIndex(), "The corrupt index was accepted");
+    GEP_ASSERT(file.seekToChunk("chunktest/footer/checksum") == FAILURE, "Seeked with a corrupt index");
+
+    // the chunks themselves are fine, so the file can still be read sequentially
+    readSequentially(file, true);
+}
+
+GEP_UNITTEST_TEST(Resources, ChunkfileThroughput)
+{
+    auto& logging = TestLogging::instance();
+    const uint32 numItems = 4096;
+    const size_t numRounds = 4;
+    writeTestFile(numItems);
+    SCOPE_EXIT{ DeleteFileA(g_chunkFilename); });
+
+    size_t fileSize = 0;
+    {
+        RawFile file(g_chunkFilename, "rb");
+        fileSize = file.getSize();
+    }
+
+    // one fread per value, what the reader did before
+    Timer timer;
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        RawFile file(g_chunkFilename, "rb");
+        uint32 value = 0, sum = 0;
+        for(size_t i = 0; i < fileSize / sizeof(value); i++)
+        {
+            file.read(value);
+            sum += value;
+        }
+        GEP_UNUSED(sum);
+    }
+    auto freadTime = timer.getTimeAsDouble();
+
+    double sums[2] = {};
+    double times[2] = {};
+    for(int bulk = 0; bulk < 2; bulk++)
+    {
+        timer = Timer();
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            Chunkfile file(g_chunkFilename, Chunkfile::Operation::read);
+            sums[bulk] = readSequentially(file, bulk != 0);
+        }
+        times[bulk] = timer.getTimeAsDouble();
+    }
+    GEP_ASSERT(sums[0] == sums[1], "Reading per value and in bulk gives different results", sums[0], sums[1]);
+
+    size_t totalBytes = fileSize * numRounds;
+    logging.logMessage("Parsing %.1f MB: %.1f MB/s with fread per value, %.1f MB/s with Chunkfile::read, %.1f MB/s with Chunkfile::readArray",
+        fileSize / (1024.0 * 1024.0), toMegabytesPerSecond(totalBytes, freadTime),
+        toMegabytesPerSecond(totalBytes, times[0]), toMegabytesPerSecond(totalBytes, times[1]));
+
+    // finding the last items by walking the file vs. with the chunk index
+    const uint32 numLookups = 64;
+    DynamicArray<uint8> data;
+    readFile(g_chunkFilename, data);
+    ArrayPtr<uint8> withoutIndex(data.toArray().getPtr(), getIndexOffset(data));
+    timer = Timer();
+    for(uint32 i = 0; i < numLookups; i++)
+    {
+        uint32 item = numItems - 1 - i;
+        Chunkfile file(g_chunkFilename, withoutIndex);
+        auto result = file.startReading("chunktest");
+        GEP_ASSERT(result == SUCCESS, "Could not start reading");
+        expectChunk(file, "header");
+        file.skipCurrentChunk();
+        expectChunk(file, "items");
+        for(uint32 skipped = 0; skipped < item; skipped++)
+        {
+            result = file.startReadChunk();
+            GEP_ASSERT(result == SUCCESS, "Could not read item", skipped);
+            file.skipCurrentChunk();
+        }
+        expectChunk(file, "item");
+        uint32 id = 0;
+        file.read(id);
+        GEP_ASSERT(id == item, "Walked to the wrong item", id, item);
+        file.skipCurrentChunk(); // item
+        file.skipCurrentChunk(); // items
+        file.skipCurrentChunk(); // chunktest
+    }
+    auto walkTime = timer.getTimeAsDouble();
+
+    timer = Timer();
+    {
+        Chunkfile file(g_chunkFilename, data.toArray());
+        for(uint32 i = 0; i < numLookups; i++)
+            checkItem(file, numItems - 1 - i);
+    }
+    auto seekTime = timer.getTimeAsDouble();
+
+    logging.logMessage("Finding %u items: %.3f ms walking the chunks, %.3f ms with seekToChunk (including reading the index)",
+        numLookups, walkTime, seekTime);
+}
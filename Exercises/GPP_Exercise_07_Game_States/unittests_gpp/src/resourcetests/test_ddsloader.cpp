@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "Test_Resources.h"
+#include "gepimpl/subsystems/renderer/ddsLoader.h"
+#include "gep/archive.h"
+#include "gep/exception.h"
+#include "gep/file.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    const char* const g_sponzaTextures[] = {
+        "spnza_bricks_a_diff.dds",
+        "sponza_arch_diff.dds",
+        "sponza_ceiling_a_diff.dds",
+        "sponza_column_a_diff.dds",
+        "sponza_curtain_blue_diff.dds",
+        "sponza_curtain_diff.dds",
+        "sponza_details_diff.dds",
+        "sponza_floor_a_diff.dds",
+        "sponza_roof_diff.dds",
+    };
+
+    std::string findSponzaDirectory()
+    {
+        if(fileExists("data/sponza/sponza_roof_diff.dds"))
+            return "data/sponza/";
+        return "../data/sponza/";
+    }
+
+    void appendDword(DynamicArray<uint8>& file, uint32 value)
+    {
+        for(int i = 0; i < 4; i++)
+            file.append(uint8(value >> (8 * i)));
+    }
+
+    /// writes a compressed dds file, every byte of the image data is the low byte of its offset in the file
+    void createDDSFile(DynamicArray<uint8>& file, uint32 width, uint32 height, uint32 numMipmaps, const char* fourCC, size_t imageSize)
+    {
+        const uint32 flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // caps, height, width, pixel format, mipmap count
+        appendDword(file, 0x20534444); // "DDS "
+        appendDword(file, 124);
+        appendDword(file, flags);
+        appendDword(file, height);
+        appendDword(file, width);
+        appendDword(file, 0);
+        appendDword(file, 0);
+        appendDword(file, numMipmaps);
+        for(int i = 0; i < 11; i++)
+            appendDword(file, 0);
+        // pixel format
+        appendDword(file, 32);
+        appendDword(file, 0x4);
+        appendDword(file, fourCC[0] | (fourCC[1] << 8) | (fourCC[2] << 16) | (fourCC[3] << 24));
+        for(int i = 0; i < 5; i++)
+            appendDword(file, 0);
+        appendDword(file, 0x1000 | 0x400000 | 0x8); // texture, mipmap, complex
+        for(int i = 0; i < 4; i++)
+            appendDword(file, 0);
+        GEP_ASSERT(file.length() == 128, "wrong header size", file.length());
+        for(size_t i = 0; i < imageSize; i++)
+            file.append(uint8(file.length()));
+    }
+
+    uint32 checksum(DDSData* pData)
+    {
+        uint32 result = 0;
+        for(auto& mipmap : pData->imageData)
+        {
+            for(auto value : mipmap)
+                result = result * 31 + value;
+        }
+        return result;
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, DDSLoader)
+{
+    // 64x32 DXT1 with all 7 mipmaps: 16x8, 8x4, 4x2, 2x1, 1x1, 1x1, 1x1 blocks of 8 bytes
+    const size_t mipmapSizes[] = { 1024, 256, 64, 16, 8, 8, 8 };
+    size_t imageSize = 0;
+    for(auto size : mipmapSizes)
+        imageSize += size;
+    DynamicArray<uint8> file;
+    createDDSFile(file, 64, 32, 7, "DXT1", imageSize);
+
+    {
+        DDSLoader loader(&g_stdAllocator);
+        loader.loadFromMemory(file.toArray(), "test.dds");
+        GEP_ASSERT(loader.getWidth() == 64 && loader.getHeight() == 32 && loader.getNumMipmaps() == 7 && loader.getFirstMipmap() == 0);
+        GEP_ASSERT(loader.getDataFormat() == DDSLoader::D3DFORMAT::DXT1 && !loader.isCubemap());
+        GEP_ASSERT(loader.getImages().length() == 1 && loader.getImages()[0].length() == 7);
+        size_t offset = 128;
+        for(size_t i = 0; i < 7; i++)
+        {
+            auto mipmap = loader.getImages()[0][i];
+            GEP_ASSERT(mipmap.getPtr() == file.toArray().getPtr() + offset, "the mipmap was copied", i);
+            GEP_ASSERT(mipmap.length() == mipmapSizes[i], "wrong mipmap size", i, mipmap.length());
+            offset += mipmapSizes[i];
+        }
+    }
+
+    // skipping the large mipmaps
+    {
+        DDSLoader loader(&g_stdAllocator);
+        loader.loadFromMemory(file.toArray(), "test.dds", 16);
+        GEP_ASSERT(loader.getFirstMipmap() == 2 && loader.getNumMipmaps() == 7);
+        GEP_ASSERT(loader.getData()->width == 16 && loader.getData()->height == 8);
+        GEP_ASSERT(loader.getImages()[0].length() == 5);
+        GEP_ASSERT(loader.getImages()[0][0].getPtr() == file.toArray().getPtr() + 128 + 1024 + 256, "wrong first mipmap");
+    }
+
+    // DXT5 has 16 byte blocks
+    {
+        DynamicArray<uint8> dxt5File;
+        createDDSFile(dxt5File, 64, 32, 7, "DXT5", imageSize * 2);
+        DDSLoader loader(&g_stdAllocator);
+        loader.loadFromMemory(dxt5File.toArray(), "test.dds");
+        GEP_ASSERT(loader.getDataFormat() == DDSLoader::D3DFORMAT::DXT5 && loader.getImages()[0][0].length() == 2048);
+    }
+
+    // a file which is one byte too short is rejected before any mipmap is looked at
+    {
+        DDSLoader loader(&g_stdAllocator);
+        bool hasThrown = false;
+        try
+        {
+            loader.loadFromMemory(file.toArray()(0, file.length() - 1), "truncated.dds");
+        }
+        catch(DDSLoadingException&)
+        {
+            hasThrown = true;
+        }
+        GEP_ASSERT(hasThrown, "the truncated file was not rejected");
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, DDSLoaderBenchmark)
+{
+    auto& logging = TestLogging::instance();
+    auto directory = findSponzaDirectory();
+    const size_t numFiles = GEP_ARRAY_SIZE(g_sponzaTextures);
+    const size_t numRounds = 4;
+
+    // like the file system does it for loose files: read into memory, the mipmaps are still not copied again
+    uint32 expectedChecksum = 0;
+    size_t numBytes = 0;
+    Timer timer;
+    for(size_t round = 0; round < numRounds; round++)
+    {
+        for(auto filename : g_sponzaTextures)
+        {
+            auto path = directory + filename;
+            RawFile file(path.c_str(), "rb");
+            GEP_ASSERT(file.isOpen(), "Could not open file", path);
+            DynamicArray<uint8> data;
+            data.resize(file.getSize());
+            file.readArray(data.toArray().getPtr(), data.length());
+            DDSLoader loader(&g_stdAllocator);
+            loader.loadFromMemory(data.toArray(), path.c_str());
+            expectedChecksum += checksum(loader.getData());
+            numBytes += data.length();
+        }
+    }
+    const double readTime = timer.getTimeAsDouble();
+
+    // mapped files touched by a single thread and by the task queue, like textures from an archive
+    TaskQueue taskQueue;
+    double mappedTimes[2];
+    for(int parallel = 0; parallel < 2; parallel++)
+    {
+        volatile LONG sum = 0;
+        timer = Timer();
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            auto work = [&](size_t start, size_t end){
+                for(size_t i = start; i < end; i++)
+                {
+                    auto path = directory + g_sponzaTextures[i];
+                    MemoryMappedFile file;
+                    auto result = file.open(path.c_str());
+                    GEP_ASSERT(result == SUCCESS, "Could not map file", path);
+                    DDSLoader loader(&g_stdAllocator);
+                    loader.loadFromMemory(file.getData(), path.c_str());
+                    InterlockedExchangeAdd(&sum, LONG(checksum(loader.getData())));
+                }
+            };
+            if(parallel)
+                taskQueue.runParallel(numFiles, 1, work);
+            else
+                work(0, numFiles);
+        }
+        mappedTimes[parallel] = timer.getTimeAsDouble();
+        GEP_ASSERT(uint32(sum) == expectedChecksum, "mapped files have a different content", parallel);
+    }
+
+    const double megabytes = numBytes / (1024.0 * 1024.0);
+    logging.logMessage("Parsing %.1f MB of dds files: read %.2f ms (%.0f MB/s), mapped %.2f ms (%.0f MB/s), mapped in parallel %.2f ms (%.0f MB/s)",
+        megabytes, readTime, megabytes / readTime * 1000.0, mappedTimes[0], megabytes / mappedTimes[0] * 1000.0,
+        mappedTimes[1], megabytes / mappedTimes[1] * 1000.0);
+}
@@ -0,0 +1,198 @@
+#include "stdafx.h"
+#include "Test_Resources.h"
+#include "gepimpl/subsystems/resourceLoaderPool.h"
+#include "gep/exception.h"
+#include "gep/utils.h"
+#include "gep/file.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gep;
+using namespace gpp;
+
+namespace
+{
+    const char* const g_sponzaTextures[] = {
+        "spnza_bricks_a_diff.dds",
+        "sponza_arch_diff.dds",
+        "sponza_ceiling_a_diff.dds",
+        "sponza_column_a_diff.dds",
+        "sponza_column_b_diff.dds",
+        "sponza_column_c_diff.dds",
+        "sponza_curtain_blue_diff.dds",
+        "sponza_curtain_diff.dds",
+        "sponza_curtain_green_diff.dds",
+        "sponza_details_diff.dds",
+        "sponza_fabric_blue_diff.dds",
+        "sponza_fabric_diff.dds",
+        "sponza_fabric_green_diff.dds",
+        "sponza_flagpole_diff.dds",
+        "sponza_floor_a_diff.dds",
+        "sponza_roof_diff.dds",
+    };
+
+    class TestResource : public IResource
+    {
+        IResourceLoader* m_pLoader;
+    public:
+        uint32 checksum;
+
+        TestResource() : m_pLoader(nullptr), checksum(0) {}
+
+        virtual IResourceLoader* getLoader() override { return m_pLoader; }
+        virtual void setLoader(IResourceLoader* loader) override { m_pLoader = loader; }
+        virtual void unload() override {}
+        virtual void finalize() override {}
+        virtual uint32 getFinalizeOptions() override { return ResourceFinalize::NotRequired; }
+        virtual bool isLoaded() override { return checksum != 0; }
+        virtual IResource* getSuperResource() override { return nullptr; }
+        virtual const char* getResourceType() override { return "TestResource"; }
+    };
+
+    /// Reads the whole file and touches every byte, like a texture loader would.
+    class TestFileLoader : public IResourceLoader
+    {
+        std::string m_filename;
+    public:
+        TestFileLoader(const std::string& filename) : m_filename(filename) {}
+
+        virtual IResource* loadResource(IResource* pInPlace) override
+        {
+            RawFile file(m_filename.c_str(), "rb");
+            if(!file.isOpen())
+                throw LoadingError(format("Could not open '%s'", m_filename.c_str()));
+
+            auto pResult = new TestResource();
+            uint8 buffer[4096];
+            size_t bytesRead = 0;
+            while((bytesRead = fread(buffer, 1, sizeof(buffer), file.m_pHandle)) > 0)
+            {
+                for(size_t i=0; i < bytesRead; i++)
+                    pResult->checksum = pResult->checksum * 31 + buffer[i];
+            }
+            pResult->checksum |= 1;
+            return pResult;
+        }
+        virtual const char* getResourceType() override { return "TestResource"; }
+        virtual const char* getResourceId() override { return m_filename.c_str(); }
+        virtual void deleteResource(IResource* pResource) override { delete pResource; }
+        virtual IResourceLoader* moveToHeap() override { return new TestFileLoader(*this); }
+        virtual void release() override { delete this; }
+        virtual void postLoad(ResourcePtr<IResource> pResource) override {}
+    };
+
+    std::string findSponzaDirectory()
+    {
+        if(fileExists("data/sponza/sponza_roof_diff.dds"))
+            return "data/sponza/";
+        return "../data/sponza/";
+    }
+
+    /// Loads all textures numRounds times and returns the time it took in ms.
+    /// Each round needs its own dummy, requests for the same resource are only queued once.
+    double loadAll(uint32 numThreads, size_t numRounds, IResource* dummies)
+    {
+        volatile LONG numFinished = 0;
+        ResourceLoaderPool pool(numThreads, [&](ResourcePtr<IResource>, IResource* pResource, IResourceLoader* pLoader){
+            GEP_ASSERT(pResource->isLoaded());
+            pLoader->deleteResource(pResource);
+            pLoader->release();
+            InterlockedIncrement(&numFinished);
+        });
+
+        auto directory = findSponzaDirectory();
+        const LONG numRequests = LONG(GEP_ARRAY_SIZE(g_sponzaTextures) * numRounds);
+
+        Timer timer;
+        pool.start();
+        for(size_t round = 0; round < numRounds; round++)
+        {
+            for(auto filename : g_sponzaTextures)
+            {
+                TestFileLoader loader(directory + filename);
+                pool.loadResource(dummies[round].makeResourcePtrFromThis<IResource>(), loader.moveToHeap(), LoadPriority::Normal);
+            }
+        }
+        while(numFinished < numRequests)
+        {
+            Sleep(1);
+        }
+        auto time = timer.getTimeAsDouble();
+        pool.stop();
+        return time;
+    }
+}
+
+GEP_UNITTEST_TEST(Resources, LoaderPool)
+{
+    auto& logging = TestLogging::instance();
+
+    const size_t numRounds = 4;
+    TestResource dummies[numRounds];
+
+    auto serialTime = loadAll(1, numRounds, dummies);
+    auto parallelTime = loadAll(8, numRounds, dummies);
+
+    logging.logMessage("Loading the sponza textures %u times: %.2f ms with 1 thread, %.2f ms with 8 threads",
+        numRounds, serialTime, parallelTime);
+}
+
+GEP_UNITTEST_TEST(Resources, LoaderPoolCancellation)
+{
+    volatile LONG numFinished = 0;
+    ResourceLoaderPool pool(1, [&](ResourcePtr<IResource>, IResource* pResource, IResourceLoader* pLoader){
+        pLoader->deleteResource(pResource);
+        pLoader->release();
+        InterlockedIncrement(&numFinished);
+    });
+
+    auto directory = findSponzaDirectory();
+    TestResource kept;
+    auto pCanceled = new TestResource();
+
+    // queue everything before starting, so the canceled request is still pending
+    TestFileLoader loader(directory + g_sponzaTextures[0]);
+    pool.loadResource(pCanceled->makeResourcePtrFromThis<IResource>(), loader.moveToHeap(), LoadPriority::Low);
+    pool.loadResource(kept.makeResourcePtrFromThis<IResource>(), loader.moveToHeap(), LoadPriority::High);
+
+    // all resource pointers to a deleted object become invalid
+    delete pCanceled;
+
+    pool.start();
+    for(int i=0; i < 1000 && numFinished < 1; i++)
+    {
+        Sleep(1);
+    }
+    Sleep(50);
+    pool.stop();
+
+    GEP_ASSERT(numFinished == 1, "The canceled request was loaded anyway!", numFinished);
+}
+
+GEP_UNITTEST_TEST(Resources, LoaderPoolDeduplication)
+{
+    volatile LONG numFinished = 0;
+    ResourceLoaderPool pool(1, [&](ResourcePtr<IResource>, IResource* pResource, IResourceLoader* pLoader){
+        pLoader->deleteResource(pResource);
+        pLoader->release();
+        InterlockedIncrement(&numFinished);
+    });
+
+    auto directory = findSponzaDirectory();
+    TestResource requested;
+
+    // the second request for the same resource only raises the priority of the first one
+    TestFileLoader loader(directory + g_sponzaTextures[0]);
+    pool.loadResource(requested.makeResourcePtrFromThis<IResource>(), loader.moveToHeap(), LoadPriority::Low);
+    pool.loadResource(requested.makeResourcePtrFromThis<IResource>(), loader.moveToHeap(), LoadPriority::High);
+
+    pool.start();
+    for(int i=0; i < 1000 && numFinished < 1; i++)
+    {
+        Sleep(1);
+    }
+    Sleep(50);
+    pool.stop();
+
+    GEP_ASSERT(numFinished == 1, "The resource was loaded more than once!", numFinished);
+}
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "Test_Scripting.h"
+#include "gep/scripting/luaBatchCall.h"
+#include "gep/timer.h"
+#include "testLog.h"
+
+using namespace gpp;
+
+namespace
+{
+    const char* const g_script =
+        "numCalls = 0\n"
+        "function update(guid, elapsedTime)\n"
+        "    numCalls = numCalls + 1\n"
+        "end\n";
+
+    int getNumCalls(lua_State* L)
+    {
+        lua_getglobal(L, "numCalls");
+        auto result = lua::pop<int>(L, -1);
+        lua_pop(L, 1);
+        return result;
+    }
+
+    void resetNumCalls(lua_State* L)
+    {
+        lua_pushinteger(L, 0);
+        lua_setglobal(L, "numCalls");
+    }
+}
+
+GEP_UNITTEST_TEST(Scripting, BatchCall)
+{
+    auto& logging = TestLogging::instance();
+
+    const int numObjects = 10000;
+    const int numFrames = 20;
+    const float elapsedTime = 16.0f;
+
+    auto L = luaL_newstate();
+    SCOPE_EXIT{ lua_close(L); });
+    luaL_openlibs(L);
+
+    auto err = luaL_dostring(L, g_script);
+    GEP_ASSERT(err == LUA_OK, "Failed to load the test script.", lua_tostring(L, -1));
+    GEP_UNUSED(err);
+
+    lua_getglobal(L, "update");
+    lua::FunctionWrapper update(L, -1);
+    lua_pop(L, 1);
+
+    gep::DynamicArray<std::string> names;
+    names.resize(numObjects);
+    for (int i = 0; i < numObjects; ++i)
+    {
+        names[i] = gep::format("object%d", i);
+    }
+
+    gep::Timer timer;
+
+    // One call per object, the way ScriptComponent::update used to do it
+    resetNumCalls(L);
+    auto start = timer.getTimeAsDouble();
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        for (auto& name : names)
+        {
+            update.push();
+            lua::push(L, name);
+            lua::push(L, elapsedTime);
+            lua_call(L, 2, 0);
+        }
+    }
+    auto perObjectTime = (timer.getTimeAsDouble() - start) / numFrames;
+    GEP_ASSERT(getNumCalls(L) == numObjects * numFrames, "Wrong number of calls!", getNumCalls(L));
+
+    // Everything in one batch
+    lua::BatchCall batch(L);
+    batch.setFunction(update);
+    for (auto& name : names)
+    {
+        batch.append(name);
+    }
+    GEP_ASSERT(batch.getNumArguments() == numObjects);
+
+    resetNumCalls(L);
+    start = timer.getTimeAsDouble();
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        batch.call(elapsedTime);
+    }
+    auto batchedTime = (timer.getTimeAsDouble() - start) / numFrames;
+    GEP_ASSERT(getNumCalls(L) == numObjects * numFrames, "Wrong number of calls!", getNumCalls(L));
+
+    // An empty batch must not call anything
+    batch.clear();
+    resetNumCalls(L);
+    batch.call(elapsedTime);
+    GEP_ASSERT(getNumCalls(L) == 0, "An empty batch called the function!", getNumCalls(L));
+
+    logging.logMessage("%d script updates: %.3f ms/frame one by one, %.3f ms/frame batched",
+        numObjects, perObjectTime, batchedTime);
+}
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+#include "Test_Scripting.h"
+#include "gep/scripting/luaHelper.h"
+#include "gep/scripting/luaProfiler.h"
+#include "testLog.h"
+
+using namespace gpp;
+
+namespace
+{
+    const char* const g_script =
+        "function inner(x)\n"
+        "    local y = math.sin(x)\n"
+        "    return y\n"
+        "end\n"
+        "function outer()\n"
+        "    local sum = 0\n"
+        "    for i = 1, 100000 do\n"
+        "        sum = sum + inner(i)\n"
+        "    end\n"
+        "    return sum\n"
+        "end\n";
+
+    void runOuter(lua_State* L)
+    {
+        lua_getglobal(L, "outer");
+        lua_call(L, 0, 0);
+    }
+}
+
+GEP_UNITTEST_TEST(Scripting, Profiler)
+{
+    auto& logging = TestLogging::instance();
+
+    auto L = luaL_newstate();
+    SCOPE_EXIT{ lua_close(L); });
+    luaL_openlibs(L);
+
+    auto err = luaL_dostring(L, g_script);
+    GEP_ASSERT(err == LUA_OK, "Failed to load the test script.", lua_tostring(L, -1));
+    GEP_UNUSED(err);
+
+    lua::Profiler profiler(L);
+
+    // Nothing is recorded while the profiler is stopped.
+    runOuter(L);
+    {
+        std::stringstream samples;
+        profiler.writeSamples(samples);
+        GEP_ASSERT(samples.str().empty(), "The stopped profiler recorded samples!", samples.str());
+    }
+
+    profiler.start(100, true);
+    runOuter(L);
+    profiler.stop();
+
+    std::stringstream samples;
+    profiler.writeSamples(samples);
+    std::stringstream cFunctionTimes;
+    profiler.writeCFunctionTimes(cFunctionTimes);
+
+    GEP_ASSERT(samples.str().find("outer (") != std::string::npos, "No samples in 'outer'!", samples.str());
+    GEP_ASSERT(cFunctionTimes.str().find("inner (") != std::string::npos, "Call stack of the C function is missing!", cFunctionTimes.str());
+    GEP_ASSERT(cFunctionTimes.str().find("sin [C]") != std::string::npos, "C function was not timed!", cFunctionTimes.str());
+
+    logging.logMessage("Samples:\n%s\nC function times:\n%s", samples.str().c_str(), cFunctionTimes.str().c_str());
+
+    profiler.reset();
+    std::stringstream empty;
+    profiler.writeSamples(empty);
+    GEP_ASSERT(empty.str().empty(), "reset() did not discard the samples!");
+}
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "Test_Scripting.h"
+#include "gep/scripting/scriptStatePool.h"
+#include "gep/threading/taskQueue.h"
+#include "gep/timer.h"
+#include "gep/exception.h"
+#include "gep/interfaces/logging.h"
+#include "gep/math3d/vec3.h"
+#include "testLog.h"
+
+using namespace gpp;
+
+namespace
+{
+    // Reads "world state" and does some math, like a simple AI script would.
+    const char* const g_script =
+        "numUpdates = 0\n"
+        "function think(guid, elapsedTime)\n"
+        "    local x = 0\n"
+        "    for i = 1, 200 do\n"
+        "        x = x + math.sin(i * elapsedTime)\n"
+        "    end\n"
+        "    numUpdates = numUpdates + 1\n"
+        "end\n"
+        "function onMessage(guid, name, data)\n"
+        "    postMessage(guid, 'reply', name .. data)\n"
+        "end\n";
+
+    int countUpdates(gep::ScriptStatePool& pool)
+    {
+        int result = 0;
+        for (size_t i = 0; i < pool.getNumStates(); ++i)
+        {
+            auto L = pool.getState(i);
+            lua_getglobal(L, "numUpdates");
+            result += lua::pop<int>(L, -1);
+            lua_pop(L, 1);
+        }
+        return result;
+    }
+
+    size_t countStatesWhereTrue(gep::ScriptStatePool& pool, const char* globalName)
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < pool.getNumStates(); ++i)
+        {
+            auto L = pool.getState(i);
+            lua_getglobal(L, globalName);
+            if (lua_toboolean(L, -1))
+            {
+                ++result;
+            }
+            lua_pop(L, 1);
+        }
+        return result;
+    }
+}
+
+GEP_UNITTEST_TEST(Scripting, ScriptStatePool)
+{
+    auto& logging = TestLogging::instance();
+
+    const int numObjects = 2000;
+    const int numFrames = 10;
+    const size_t stateCounts[] = { 1, 2, 4, 8 };
+
+    gep::TaskQueue taskQueue;
+    gep::Timer timer;
+    double singleStateTime = 0.0;
+
+    for (auto numStates : stateCounts)
+    {
+        gep::ScriptStatePool pool(numStates);
+        pool.executeString(g_script);
+
+        for (int i = 0; i < numObjects; ++i)
+        {
+            pool.addObject(gep::format("object%d", i), "think");
+        }
+
+        auto start = timer.getTimeAsDouble();
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            pool.update(taskQueue, 16.0f);
+        }
+        auto frameTime = (timer.getTimeAsDouble() - start) / numFrames;
+        if (numStates == 1)
+        {
+            singleStateTime = frameTime;
+        }
+
+        auto numUpdates = countUpdates(pool);
+        GEP_ASSERT(numUpdates == numObjects * numFrames, "Wrong number of updates!", numStates, numUpdates);
+
+        logging.logMessage("%u states: %.3f ms/frame, speedup %.2f",
+            numStates, frameTime, singleStateTime / frameTime);
+    }
+
+    // messages travel to the owning state and back to the game thread
+    {
+        gep::ScriptStatePool pool(4);
+        pool.executeString(g_script);
+        pool.addObject("a", "think");
+        pool.addObject("b", "think");
+
+        gep::ScriptMessage message;
+        message.objectName = "b";
+        message.name = "ping";
+        message.data = "42";
+        pool.sendMessage(message);
+        pool.update(taskQueue, 16.0f);
+
+        int numReplies = 0;
+        pool.dispatchMessages([&](const gep::ScriptMessage& reply){
+            GEP_ASSERT(reply.objectName == "b", "The reply came from the wrong object.", reply.objectName);
+            GEP_ASSERT(reply.name == "reply" && reply.data == "ping42", "Unexpected reply.", reply.name, reply.data);
+            ++numReplies;
+        });
+        GEP_ASSERT(numReplies == 1, "Wrong number of replies!", numReplies);
+    }
+
+    // a message whose handler fails is reported once and not delivered again
+    {
+        gep::ScriptStatePool pool(2);
+        pool.executeString("function onMessage(guid, name, data) error('broken handler') end");
+        pool.addObject("a", "tostring");
+
+        gep::ScriptMessage message;
+        message.objectName = "a";
+        message.name = "ping";
+        pool.sendMessage(message);
+
+        bool failed = false;
+        try
+        {
+            pool.update(taskQueue, 16.0f);
+        }
+        catch (gep::ScriptExecutionException&)
+        {
+            failed = true;
+        }
+        GEP_ASSERT(failed, "The error of the message handler was not reported!");
+        pool.update(taskQueue, 16.0f);
+    }
+}
+
+GEP_UNITTEST_TEST(Scripting, ScriptStatePoolBindings)
+{
+    // The pooled states run on the workers in parallel, binding the type of an
+    // engine singleton must not make the singleton itself reachable from them.
+    gep::ScriptStatePool pool(2);
+    pool.bind<gep::ILogging>("Log");
+    pool.bind<gep::vec3>("Vec3");
+    pool.executeString("singletonReachable = (Log ~= nil)\n"
+                       "valueTypeBound = (Vec3 ~= nil)\n");
+
+    GEP_ASSERT(countStatesWhereTrue(pool, "singletonReachable") == 0, "A pooled state can reach the logging singleton!");
+    GEP_ASSERT(countStatesWhereTrue(pool, "valueTypeBound") == pool.getNumStates(), "The value type was not bound in the pooled states!");
+}